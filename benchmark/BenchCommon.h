@@ -0,0 +1,147 @@
+﻿#ifndef HGL_NETWORK_BENCHMARK_COMMON_INCLUDE
+#define HGL_NETWORK_BENCHMARK_COMMON_INCLUDE
+
+#include<stdint.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<chrono>
+#include<vector>
+#include<string>
+#include<algorithm>
+
+/**
+ * 基准测试程序共用的小工具(命令行参数、计时、百分位统计)<br>
+ * 只供benchmark目录下的程序使用，不属于CMNetwork库
+ */
+namespace bench
+{
+    inline uint64_t NowNS()                                         ///<单调时钟(纳秒)
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * 简单的命令行参数，格式为--name=value、--name value或开关--name
+     */
+    class Args
+    {
+        int argc;
+        char **argv;
+
+    public:
+
+        Args(int c,char **v):argc(c),argv(v){}
+
+        const char *Get(const char *name,const char *def)const
+        {
+            const size_t len=strlen(name);
+
+            for(int i=1;i<argc;i++)
+            {
+                const char *a=argv[i];
+
+                if(a[0]!='-'||a[1]!='-')continue;
+                if(strncmp(a+2,name,len))continue;
+
+                if(a[2+len]=='=')return a+3+len;
+                if(a[2+len]==0)                                     //不带值的开关(如--shard)返回空串
+                    return(i+1<argc&&argv[i+1][0]!='-')?argv[i+1]:"";
+            }
+
+            return def;
+        }
+
+        int         GetInt  (const char *name,int def)const     {const char *v=Get(name,nullptr);return(v&&*v)?atoi(v):def;}
+        double      GetFloat(const char *name,double def)const  {const char *v=Get(name,nullptr);return(v&&*v)?atof(v):def;}
+        bool        Has     (const char *name)const             {return Get(name,nullptr)!=nullptr;}
+
+        std::vector<int> GetIntList(const char *name,const char *def)const     ///<逗号分隔的整数列表，如--conn=1,16,256
+        {
+            std::vector<int> result;
+
+            const char *v=Get(name,def);
+
+            while(v&&*v)
+            {
+                result.push_back(atoi(v));
+
+                v=strchr(v,',');
+
+                if(v)++v;
+            }
+
+            return result;
+        }
+    };//class Args
+
+    /**
+     * 延迟样本，测试结束后排序取百分位
+     */
+    class LatencySamples
+    {
+        std::vector<uint64_t> samples;                              ///<纳秒
+
+    public:
+
+        void Reserve(size_t n){samples.reserve(n);}
+        void Add(uint64_t ns){samples.push_back(ns);}
+        void Merge(const LatencySamples &ls){samples.insert(samples.end(),ls.samples.begin(),ls.samples.end());}
+        void Clear(){samples.clear();}
+
+        size_t GetCount()const{return samples.size();}
+
+        void Sort(){std::sort(samples.begin(),samples.end());}
+
+        double GetPercentileUS(double p)const                       ///<需先Sort
+        {
+            if(samples.empty())return 0;
+
+            size_t index=size_t(p*double(samples.size()));
+
+            if(index>=samples.size())
+                index=samples.size()-1;
+
+            return double(samples[index])/1000.0;
+        }
+    };//class LatencySamples
+
+    /**
+     * 一组测试的结果
+     */
+    struct RunResult
+    {
+        uint64_t messages=0;                                        ///<完成往返的消息数
+        uint64_t bytes=0;                                           ///<回显的负载字节数(单向)
+        uint64_t errors=0;                                          ///<出错/断开/丢失的次数
+        double   seconds=0;                                         ///<统计时长
+
+        LatencySamples latency;
+
+    public:
+
+        static void PrintHeader()
+        {
+            printf("%-6s %8s %8s %12s %10s %10s %10s %10s %8s\n",
+                   "mode","conn","size","msgs/s","MB/s","p50(us)","p99(us)","p999(us)","errors");
+        }
+
+        void Print(const char *mode,int conn,int size)
+        {
+            latency.Sort();
+
+            const double mps=seconds>0?messages/seconds:0;
+            const double mbs=seconds>0?bytes/seconds/(1024.0*1024.0):0;
+
+            printf("%-6s %8d %8d %12.0f %10.2f %10.1f %10.1f %10.1f %8llu\n",
+                   mode,conn,size,mps,mbs,
+                   latency.GetPercentileUS(0.50),
+                   latency.GetPercentileUS(0.99),
+                   latency.GetPercentileUS(0.999),
+                   (unsigned long long)errors);
+
+            fflush(stdout);
+        }
+    };//struct RunResult
+}//namespace bench
+#endif//HGL_NETWORK_BENCHMARK_COMMON_INCLUDE
@@ -0,0 +1,154 @@
+﻿#ifndef HGL_NETWORK_BENCHMARK_SOCKET_INCLUDE
+#define HGL_NETWORK_BENCHMARK_SOCKET_INCLUDE
+
+#include<stdint.h>
+#include<stdio.h>
+#include<string.h>
+#include<string>
+#include<vector>
+
+#include<unistd.h>
+#include<fcntl.h>
+#include<errno.h>
+#include<netdb.h>
+#include<sys/socket.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<arpa/inet.h>
+
+/**
+ * 测试客户端共用的POSIX socket小工具(仅POSIX)<br>
+ * 直接使用系统socket，不使用CMNetwork，避免测试客户端与被测对象共用同一套代码
+ */
+namespace bench
+{
+    inline bool ResolveAddress(sockaddr_storage &addr,socklen_t &addr_len,const char *host,int port,bool udp)
+    {
+        addrinfo hints,*res=nullptr;
+
+        memset(&hints,0,sizeof(hints));
+        hints.ai_family=AF_UNSPEC;
+        hints.ai_socktype=udp?SOCK_DGRAM:SOCK_STREAM;
+
+        char port_str[16];
+
+        snprintf(port_str,sizeof(port_str),"%d",port);
+
+        if(getaddrinfo(host,port_str,&hints,&res)||!res)
+            return(false);
+
+        memcpy(&addr,res->ai_addr,res->ai_addrlen);
+        addr_len=res->ai_addrlen;
+
+        freeaddrinfo(res);
+        return(true);
+    }
+
+    inline bool SetNonBlock(int fd)
+    {
+        const int flags=fcntl(fd,F_GETFL,0);
+
+        return fcntl(fd,F_SETFL,flags|O_NONBLOCK)==0;
+    }
+
+    inline bool WriteAll(int fd,const void *data,size_t size)
+    {
+        const char *p=(const char *)data;
+
+        while(size>0)
+        {
+            const ssize_t n=send(fd,p,size,MSG_NOSIGNAL);
+
+            if(n<=0)
+            {
+                if(n<0&&errno==EINTR)continue;
+                return(false);
+            }
+
+            p+=n;
+            size-=n;
+        }
+
+        return(true);
+    }
+
+    /**
+     * 阻塞方式完成WebSocket握手(只检查101状态码)
+     */
+    inline bool WebSocketHandshake(int fd,const char *host)
+    {
+        char req[512];
+
+        const int len=snprintf(req,sizeof(req),
+                               "GET / HTTP/1.1\r\n"
+                               "Host: %s\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Connection: Upgrade\r\n"
+                               "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                               "Sec-WebSocket-Version: 13\r\n"
+                               "\r\n",host);
+
+        if(!WriteAll(fd,req,len))
+            return(false);
+
+        std::string resp;
+        char buf[1024];
+
+        while(resp.find("\r\n\r\n")==std::string::npos)
+        {
+            const ssize_t n=recv(fd,buf,sizeof(buf),0);
+
+            if(n<=0)return(false);
+
+            resp.append(buf,n);
+
+            if(resp.size()>8192)return(false);
+        }
+
+        return resp.compare(0,12,"HTTP/1.1 101")==0;
+    }
+
+    /**
+     * 编码一个客户端WebSocket帧(带掩码)加到out后面
+     * @param opcode 0继续帧,1文本,2二进制
+     */
+    inline void AppendWebSocketFrame(std::vector<char> &out,uint8_t opcode,bool fin,const void *data,uint64_t size)
+    {
+        uint8_t head[14];
+        int hs=0;
+
+        head[hs++]=(fin?0x80:0)|opcode;
+
+        if(size<126)
+            head[hs++]=0x80|uint8_t(size);
+        else
+        if(size<65536)
+        {
+            head[hs++]=0x80|126;
+            head[hs++]=uint8_t(size>>8);
+            head[hs++]=uint8_t(size);
+        }
+        else
+        {
+            head[hs++]=0x80|127;
+
+            for(int i=7;i>=0;i--)
+                head[hs++]=uint8_t(size>>(i*8));
+        }
+
+        const uint8_t mask[4]={0x12,0x34,0x56,0x78};
+
+        memcpy(head+hs,mask,4);
+        hs+=4;
+
+        out.insert(out.end(),(char *)head,(char *)head+hs);
+
+        const size_t start=out.size();
+
+        out.insert(out.end(),(const char *)data,(const char *)data+size);
+
+        for(size_t i=0;i<size;i++)
+            out[start+i]^=mask[i&3];
+    }
+}//namespace bench
+#endif//HGL_NETWORK_BENCHMARK_SOCKET_INCLUDE
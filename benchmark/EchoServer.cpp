@@ -0,0 +1,108 @@
+﻿/**
+ * TCP回显服务器(MTTCPServerStd<TCPAcceptPacket>)<br>
+ * 收到的每个包原样发回，配合LoadGenerator --mode=tcp使用<br>
+ * 用法: BenchEchoServer --port=9000 --threads=4 --max_user=10000 [--placement=0-3] [--affinity] [--shard] [--capture=traffic.cap]
+ *   --capture  录制收到的包，供BenchTrafficReplay重放(--capture_max=文件最大MB数)
+ */
+#include<hgl/network/MTTCPServer.h>
+#include<hgl/Time.h>
+#include"BenchCommon.h"
+
+using namespace hgl;
+using namespace hgl::network;
+
+namespace
+{
+    class EchoAccept:public TCPAcceptPacket
+    {
+    public:
+
+        using TCPAcceptPacket::TCPAcceptPacket;
+
+        bool OnRecvPacket(void *data,const PACKET_SIZE_TYPE &size) override
+        {
+            return SendPacket(data,size);
+        }
+
+        void OnSocketError(int) override{}
+    };//class EchoAccept
+
+    /**
+     * 每秒输出一次统计数据
+     */
+    template<typename SERVER> void RunStats(SERVER &server,TrafficCapture *capture)
+    {
+        SocketManageMetricsSnapshot last,cur;
+        AcceptMetricsSnapshot am;
+
+        server.GetMetricsSnapshot(last,&am);
+
+        double last_time=GetDoubleTime();
+
+        while(server.IsLive()>0)
+        {
+            WaitTime(1);
+
+            server.GetMetricsSnapshot(cur,&am);
+
+            const double now=GetDoubleTime();
+            const double t=now-last_time;
+
+            printf("conn %6llu  update/s %9.0f  event/s %9.0f  recv MB/s %8.2f  send MB/s %8.2f  bytes/send %8.0f  dispatch p99 %8.1fus  accept %llu\n",
+                   (unsigned long long)cur.connection_count,
+                   (cur.update_count-last.update_count)/t,
+                   (cur.event_count-last.event_count)/t,
+                   (cur.recv_bytes-last.recv_bytes)/t/(1024.0*1024.0),
+                   (cur.send_bytes-last.send_bytes)/t/(1024.0*1024.0),
+                   cur.send_call_count>last.send_call_count?double(cur.send_bytes-last.send_bytes)/(cur.send_call_count-last.send_call_count):0.0,
+                   cur.dispatch_time.GetPercentile(0.99)*1000000.0,
+                   (unsigned long long)am.accept_count);
+
+            fflush(stdout);
+
+            if(capture)
+                capture->Flush();                                   //随时中断也只丢最后一秒
+
+            last=cur;
+            last_time=now;
+        }
+    }
+}//namespace
+
+int main(int argc,char **argv)
+{
+    bench::Args args(argc,argv);
+
+    TrafficCapture capture;                                         //须在server之后释放
+
+    const char *capture_file=args.Get("capture",nullptr);
+
+    if(capture_file&&!capture.Create(capture_file,uint64(args.GetInt("capture_max",0))*HGL_SIZE_1MB))
+    {
+        printf("create capture file failed.\n");
+        return 1;
+    }
+
+    MTTCPServerStd<EchoAccept> server;
+    MTTCPServerStd<EchoAccept>::InitInfomation info;
+
+    info.server_ip          =CreateIPv4TCP(ushort(args.GetInt("port",9000)));
+    info.thread_count       =args.GetInt("threads",4);
+    info.max_user           =args.GetInt("max_user",10000);
+    info.port_reuse         =true;
+    info.reuse_port_shard   =args.Has("shard");
+    info.cpu_affinity       =args.Has("affinity");
+    info.placement          =SocketPlacementPolicy(args.GetInt("placement",0));
+    info.traffic_capture    =capture.IsOpen()?&capture:nullptr;
+
+    if(!server.Init(info))
+    {
+        printf("init echo server failed.\n");
+        return 1;
+    }
+
+    printf("tcp echo server listen on port %d, %d threads.\n",args.GetInt("port",9000),info.thread_count);
+
+    RunStats(server,info.traffic_capture);
+    return 0;
+}
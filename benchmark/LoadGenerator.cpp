@@ -0,0 +1,554 @@
+﻿/**
+ * 多连接压力测试客户端<br>
+ * 对每一组(连接数,包长)建立新连接，预热后统计吞吐与往返延迟，输出msgs/s、MB/s与p50/p99/p999<br>
+ * 每条消息的前8字节是发送时间，回显后据此计算延迟，所以服务端必须原样返回。<br>
+ * 独立于CMNetwork库，直接使用POSIX socket与poll，避免测试客户端与被测对象共用同一套代码。
+ *
+ * 用法: BenchLoadGenerator --mode=tcp|ws|udp --host=127.0.0.1 --port=9000
+ *                          --conn=1,16,256 --size=64,1024,16384
+ *                          --duration=5 --warmup=1 --threads=4 --pipeline=1
+ */
+#include"BenchCommon.h"
+#include"BenchSocket.h"
+
+#include<thread>
+#include<atomic>
+
+#include<poll.h>
+
+namespace
+{
+    enum class Mode
+    {
+        TCP,
+        WebSocket,
+        UDP
+    };
+
+    struct Config
+    {
+        Mode        mode=Mode::TCP;
+        const char *mode_name="tcp";
+
+        sockaddr_storage addr;
+        socklen_t   addr_len=0;
+
+        int         size=64;                                        ///<负载长度(不含帧头)
+        int         pipeline=1;                                     ///<每个连接同时在途的消息数
+        double      udp_timeout=0.2;                                ///<UDP超过此时间未收到回显视为丢失(秒)
+    };
+
+    std::atomic<bool> measuring(false);                             ///<是否已过预热期
+    std::atomic<bool> running(false);
+
+    /**
+     * 一个测试连接
+     */
+    struct Connection
+    {
+        int fd=-1;
+
+        std::vector<char> out;                                      ///<尚未发出的数据
+        size_t out_pos=0;
+
+        std::vector<char> in;                                       ///<收到但还未处理完的数据
+
+        int in_flight=0;                                            ///<在途消息数
+        uint64_t last_send=0;                                       ///<UDP最后一次发送时间(判定丢失)
+
+        bool closed=false;
+    };
+
+    /**
+     * 每个线程一个，管理一部分连接
+     */
+    class Worker
+    {
+        const Config &cfg;
+
+        std::vector<Connection> conn_list;
+        std::vector<pollfd> poll_list;
+
+        std::vector<char> payload;
+
+    public:
+
+        bench::RunResult result;
+
+    private:
+
+        /**
+         * 按模式编码一条消息加到发送缓冲区
+         */
+        void AppendMessage(Connection &c)
+        {
+            const uint64_t now=bench::NowNS();
+
+            memcpy(payload.data(),&now,sizeof(now));
+
+            const uint32_t size=uint32_t(payload.size());
+
+            if(cfg.mode==Mode::TCP)
+            {
+                const char *h=(const char *)&size;                  //与TCPAcceptPacket一致，本机字节序的uint32包长
+
+                c.out.insert(c.out.end(),h,h+sizeof(size));
+                c.out.insert(c.out.end(),payload.begin(),payload.end());
+            }
+            else
+            if(cfg.mode==Mode::WebSocket)
+            {
+                bench::AppendWebSocketFrame(c.out,0x02,true,payload.data(),size);              //FIN+Binary
+            }
+
+            ++c.in_flight;
+        }
+
+        /**
+         * 记录一条收到的回显
+         */
+        void OnEcho(Connection &c,const char *data,size_t size)
+        {
+            --c.in_flight;
+
+            if(size<sizeof(uint64_t))
+            {
+                ++result.errors;
+                return;
+            }
+
+            if(!measuring.load(std::memory_order_relaxed))
+                return;
+
+            uint64_t send_time;
+
+            memcpy(&send_time,data,sizeof(send_time));
+
+            ++result.messages;
+            result.bytes+=size;
+            result.latency.Add(bench::NowNS()-send_time);
+        }
+
+        /**
+         * 从接收缓冲区中取出完整的消息
+         */
+        void ParseStream(Connection &c)
+        {
+            size_t pos=0;
+
+            while(true)
+            {
+                const size_t remain=c.in.size()-pos;
+                const char *p=c.in.data()+pos;
+
+                size_t head_size;
+                uint64_t body_size;
+
+                if(cfg.mode==Mode::TCP)
+                {
+                    if(remain<sizeof(uint32_t))break;
+
+                    uint32_t s;
+
+                    memcpy(&s,p,sizeof(s));
+
+                    head_size=sizeof(uint32_t);
+                    body_size=s;
+                }
+                else
+                {
+                    if(remain<2)break;
+
+                    const uint8_t *h=(const uint8_t *)p;
+                    const uint8_t len=h[1]&0x7F;
+
+                    if(len==126)
+                    {
+                        if(remain<4)break;
+
+                        head_size=4;
+                        body_size=(uint64_t(h[2])<<8)|h[3];
+                    }
+                    else
+                    if(len==127)
+                    {
+                        if(remain<10)break;
+
+                        head_size=10;
+                        body_size=0;
+
+                        for(int i=0;i<8;i++)
+                            body_size=(body_size<<8)|h[2+i];
+                    }
+                    else
+                    {
+                        head_size=2;
+                        body_size=len;
+                    }
+
+                    if(h[1]&0x80)                                   //服务端帧不应带掩码
+                    {
+                        ++result.errors;
+                        c.closed=true;
+                        return;
+                    }
+                }
+
+                if(remain<head_size+body_size)break;
+
+                if(cfg.mode==Mode::TCP||(uint8_t(p[0])&0x0F)==0x02)  //WebSocket只统计Binary帧，Ping等控制帧忽略
+                    OnEcho(c,p+head_size,size_t(body_size));
+
+                pos+=head_size+size_t(body_size);
+            }
+
+            if(pos>0)
+                c.in.erase(c.in.begin(),c.in.begin()+pos);
+        }
+
+        bool FlushOut(Connection &c)
+        {
+            while(c.out_pos<c.out.size())
+            {
+                const ssize_t n=send(c.fd,c.out.data()+c.out_pos,c.out.size()-c.out_pos,MSG_NOSIGNAL);
+
+                if(n<0)
+                {
+                    if(errno==EINTR)continue;
+                    if(errno==EAGAIN||errno==EWOULDBLOCK)return(true);
+                    return(false);
+                }
+
+                c.out_pos+=n;
+            }
+
+            c.out.clear();
+            c.out_pos=0;
+            return(true);
+        }
+
+        bool RecvStream(Connection &c)
+        {
+            char buf[65536];
+
+            while(true)
+            {
+                const ssize_t n=recv(c.fd,buf,sizeof(buf),0);
+
+                if(n==0)return(false);
+
+                if(n<0)
+                {
+                    if(errno==EINTR)continue;
+                    if(errno==EAGAIN||errno==EWOULDBLOCK)break;
+                    return(false);
+                }
+
+                c.in.insert(c.in.end(),buf,buf+n);
+            }
+
+            ParseStream(c);
+            return !c.closed;
+        }
+
+        void SendUDP(Connection &c)
+        {
+            const uint64_t now=bench::NowNS();
+
+            memcpy(payload.data(),&now,sizeof(now));
+
+            if(send(c.fd,payload.data(),payload.size(),0)==ssize_t(payload.size()))
+            {
+                ++c.in_flight;
+                c.last_send=now;
+            }
+            else
+                ++result.errors;
+        }
+
+        void RecvUDP(Connection &c)
+        {
+            char buf[65536];
+
+            while(true)
+            {
+                const ssize_t n=recv(c.fd,buf,sizeof(buf),0);
+
+                if(n<0)break;
+
+                if(c.in_flight>0)
+                    OnEcho(c,buf,n);
+            }
+        }
+
+        void CloseConnection(Connection &c)
+        {
+            if(c.fd>=0)
+                close(c.fd);
+
+            c.fd=-1;
+            c.closed=true;
+        }
+
+    public:
+
+        Worker(const Config &c):cfg(c)
+        {
+            payload.resize(std::max<size_t>(size_t(cfg.size),sizeof(uint64_t)));        //至少放得下发送时间
+
+            for(size_t i=0;i<payload.size();i++)
+                payload[i]=char(i);
+        }
+
+        ~Worker()
+        {
+            for(Connection &c:conn_list)
+                CloseConnection(c);
+        }
+
+        /**
+         * 建立指定数量的连接(阻塞connect与握手，完成后转为非阻塞)
+         */
+        bool Connect(int count,const char *host)
+        {
+            conn_list.resize(count);
+
+            for(Connection &c:conn_list)
+            {
+                c.fd=socket(cfg.addr.ss_family,cfg.mode==Mode::UDP?SOCK_DGRAM:SOCK_STREAM,0);
+
+                if(c.fd<0)return(false);
+
+                if(connect(c.fd,(const sockaddr *)&cfg.addr,cfg.addr_len))
+                    return(false);
+
+                if(cfg.mode!=Mode::UDP)
+                {
+                    const int on=1;
+
+                    setsockopt(c.fd,IPPROTO_TCP,TCP_NODELAY,&on,sizeof(on));
+
+                    if(cfg.mode==Mode::WebSocket&&!bench::WebSocketHandshake(c.fd,host))
+                        return(false);
+                }
+
+                bench::SetNonBlock(c.fd);
+            }
+
+            return(true);
+        }
+
+        void Run()
+        {
+            poll_list.resize(conn_list.size());
+
+            for(Connection &c:conn_list)
+            {
+                for(int i=0;i<cfg.pipeline;i++)
+                {
+                    if(cfg.mode==Mode::UDP)
+                        SendUDP(c);
+                    else
+                        AppendMessage(c);
+                }
+            }
+
+            const uint64_t udp_timeout_ns=uint64_t(cfg.udp_timeout*1e9);
+
+            while(running.load(std::memory_order_relaxed))
+            {
+                for(size_t i=0;i<conn_list.size();i++)
+                {
+                    Connection &c=conn_list[i];
+
+                    if(cfg.mode!=Mode::UDP&&!c.closed&&!FlushOut(c))
+                    {
+                        ++result.errors;
+                        CloseConnection(c);
+                    }
+
+                    poll_list[i].fd=c.closed?-1:c.fd;
+                    poll_list[i].events=POLLIN|(c.out.empty()?0:POLLOUT);
+                    poll_list[i].revents=0;
+                }
+
+                const int n=poll(poll_list.data(),nfds_t(poll_list.size()),10);
+
+                if(n<0&&errno!=EINTR)
+                    break;
+
+                const uint64_t now=bench::NowNS();
+
+                for(size_t i=0;i<conn_list.size();i++)
+                {
+                    Connection &c=conn_list[i];
+
+                    if(c.closed)continue;
+
+                    const short ev=poll_list[i].revents;
+
+                    if(cfg.mode==Mode::UDP)
+                    {
+                        if(ev&POLLIN)
+                            RecvUDP(c);
+
+                        if(c.in_flight>0&&now-c.last_send>udp_timeout_ns)         //判定为丢失，重新发送一组
+                        {
+                            result.errors+=c.in_flight;
+                            c.in_flight=0;
+                        }
+
+                        while(c.in_flight<cfg.pipeline)
+                            SendUDP(c);
+
+                        continue;
+                    }
+
+                    if(ev&(POLLERR|POLLHUP|POLLNVAL))
+                        if(!(ev&POLLIN))
+                        {
+                            ++result.errors;
+                            CloseConnection(c);
+                            continue;
+                        }
+
+                    if(ev&POLLIN)
+                    {
+                        if(!RecvStream(c))
+                        {
+                            ++result.errors;
+                            CloseConnection(c);
+                            continue;
+                        }
+
+                        while(c.in_flight<cfg.pipeline)
+                            AppendMessage(c);
+                    }
+                }
+            }
+        }
+    };//class Worker
+
+    /**
+     * 以指定连接数与包长跑一组测试
+     */
+    bool RunOnce(const Config &cfg,const char *host,int conn_count,int thread_count,double warmup,double duration,bench::RunResult &total)
+    {
+        if(thread_count>conn_count)
+            thread_count=conn_count;
+
+        std::vector<Worker *> worker_list;
+
+        for(int i=0;i<thread_count;i++)
+        {
+            Worker *w=new Worker(cfg);
+
+            const int count=conn_count/thread_count+(i<conn_count%thread_count?1:0);
+
+            worker_list.push_back(w);
+
+            if(!w->Connect(count,host))
+            {
+                printf("connect failed: %s\n",strerror(errno));
+
+                for(Worker *ow:worker_list)
+                    delete ow;
+
+                return(false);
+            }
+        }
+
+        measuring=false;
+        running=true;
+
+        std::vector<std::thread> thread_list;
+
+        for(Worker *w:worker_list)
+            thread_list.emplace_back([w]{w->Run();});
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(warmup));
+
+        measuring=true;
+        const uint64_t start=bench::NowNS();
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+
+        measuring=false;
+        const uint64_t stop=bench::NowNS();
+
+        running=false;
+
+        for(std::thread &t:thread_list)
+            t.join();
+
+        total=bench::RunResult();
+        total.seconds=double(stop-start)/1e9;
+
+        for(Worker *w:worker_list)
+        {
+            total.messages+=w->result.messages;
+            total.bytes+=w->result.bytes;
+            total.errors+=w->result.errors;
+            total.latency.Merge(w->result.latency);
+
+            delete w;
+        }
+
+        return(true);
+    }
+}//namespace
+
+int main(int argc,char **argv)
+{
+    bench::Args args(argc,argv);
+
+    Config cfg;
+
+    const char *mode=args.Get("mode","tcp");
+
+    if(!strcmp(mode,"ws"))  {cfg.mode=Mode::WebSocket;cfg.mode_name="ws";}else
+    if(!strcmp(mode,"udp")) {cfg.mode=Mode::UDP;cfg.mode_name="udp";}else
+                            {cfg.mode=Mode::TCP;cfg.mode_name="tcp";}
+
+    const char *host=args.Get("host","127.0.0.1");
+    const int port=args.GetInt("port",cfg.mode==Mode::WebSocket?9001:(cfg.mode==Mode::UDP?9002:9000));
+
+    if(!bench::ResolveAddress(cfg.addr,cfg.addr_len,host,port,cfg.mode==Mode::UDP))
+    {
+        printf("can't resolve %s:%d\n",host,port);
+        return 1;
+    }
+
+    const std::vector<int> conn_list=args.GetIntList("conn","1,16,256");
+    const std::vector<int> size_list=args.GetIntList("size","64,1024,16384");
+
+    const double duration   =args.GetFloat("duration",5);
+    const double warmup     =args.GetFloat("warmup",1);
+    const int thread_count  =std::max(1,args.GetInt("threads",int(std::thread::hardware_concurrency())));
+
+    cfg.pipeline            =args.GetInt("pipeline",1);
+    cfg.udp_timeout         =args.GetFloat("udp_timeout",0.2);
+
+    if(cfg.pipeline<1)cfg.pipeline=1;
+
+    bench::RunResult::PrintHeader();
+
+    for(int conn:conn_list)
+    {
+        for(int size:size_list)
+        {
+            if(conn<=0||size<=0)continue;
+
+            cfg.size=size;
+
+            bench::RunResult result;
+
+            if(!RunOnce(cfg,host,conn,thread_count,warmup,duration,result))
+                return 1;
+
+            result.Print(cfg.mode_name,conn,size);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+﻿#ifndef HGL_NETWORK_BENCHMARK_MEMORY_SOCKET_INPUT_STREAM_INCLUDE
+#define HGL_NETWORK_BENCHMARK_MEMORY_SOCKET_INPUT_STREAM_INCLUDE
+
+#include<hgl/network/SocketInputStream.h>
+#include<string.h>
+
+namespace bench
+{
+    /**
+     * 从内存读取的SocketInputStream，替换TCPAccept::sis后即可不经过socket测试收包解析<br>
+     * 每次Read最多返回chunk_size字节以模拟recv被拆开的情况，数据读完返回0(与非阻塞socket暂无数据时相同)
+     */
+    class MemorySocketInputStream:public hgl::network::SocketInputStream
+    {
+        const char *data=nullptr;
+        hgl::int64 size=0;
+        hgl::int64 pos=0;
+
+        hgl::int64 chunk_size;
+
+    public:
+
+        MemorySocketInputStream(hgl::int64 cs=0):SocketInputStream(-1),chunk_size(cs){}
+
+        void Set(const void *d,hgl::int64 s)                        ///<设置数据并从头开始
+        {
+            data=(const char *)d;
+            size=s;
+            pos=0;
+        }
+
+        void Reset(){pos=0;}                                        ///<从头开始
+
+        hgl::int64 Read(void *buf,hgl::int64 bytes) override
+        {
+            hgl::int64 n=size-pos;
+
+            if(n>bytes)n=bytes;
+            if(chunk_size>0&&n>chunk_size)n=chunk_size;
+            if(n<=0)return 0;
+
+            memcpy(buf,data+pos,size_t(n));
+            pos+=n;
+            total+=n;
+            return n;
+        }
+
+        hgl::int64 Peek(void *buf,hgl::int64 bytes) override
+        {
+            const hgl::int64 old=pos;
+            const hgl::int64 n=Read(buf,bytes);
+
+            pos=old;
+            total-=n;
+            return n;
+        }
+
+        hgl::int64 ReadFully(void *buf,hgl::int64 bytes) override{return Read(buf,bytes);}
+        hgl::int64 Skip(hgl::int64 bytes) override{const hgl::int64 n=(bytes<size-pos?bytes:size-pos);pos+=n;return n;}
+        hgl::int64 Available()const override{return size-pos;}
+    };//class MemorySocketInputStream
+}//namespace bench
+#endif//HGL_NETWORK_BENCHMARK_MEMORY_SOCKET_INPUT_STREAM_INCLUDE
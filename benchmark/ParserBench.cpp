@@ -0,0 +1,320 @@
+﻿/**
+ * 协议解析微基准测试<br>
+ * 不使用socket，数据全部来自内存(MemorySocketInputStream)，输出每次操作与每字节的耗时，便于在CI中对比解析性能的变化<br>
+ * 用法: BenchParser [--time=0.2] [--chunk=0] [--csv]
+ *      --time  每项至少运行的时间(秒)
+ *      --chunk 每次Read最多返回的字节数(0表示不限制)，用于模拟recv被拆开
+ *      --csv   以CSV格式输出
+ */
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/WebSocket.h>
+#include<hgl/network/WebSocketAccept.h>
+#include<hgl/network/HTTPInputStream.h>
+#include"BenchCommon.h"
+#include"MemorySocketInputStream.h"
+
+using namespace hgl;
+using namespace hgl::network;
+
+namespace
+{
+    bool csv_output=false;
+    double min_time=0.2;
+    int64 chunk_size=0;
+
+    volatile uint64 sink=0;                                         ///<防止被优化掉
+
+    /**
+     * 重复运行直到超过min_time，输出一项结果
+     * @param name 测试项名称
+     * @param size 参数(包长等)
+     * @param bytes 每次操作处理的字节数
+     * @param func 一次操作
+     */
+    template<typename F> void Measure(const char *name,uint size,uint64 bytes,F func)
+    {
+        func();                                                     //预热一次，分配好缓冲区
+
+        uint64 count=0;
+        uint64 batch=1;
+
+        const uint64 start=bench::NowNS();
+        uint64 elapsed=0;
+
+        while(elapsed<uint64(min_time*1e9))
+        {
+            for(uint64 i=0;i<batch;i++)
+                func();
+
+            count+=batch;
+            elapsed=bench::NowNS()-start;
+
+            if(batch<(1u<<20))
+                batch*=2;
+        }
+
+        const double ns_op=double(elapsed)/double(count);
+        const double ns_byte=bytes>0?ns_op/double(bytes):0;
+        const double mbs=bytes>0?double(bytes)*double(count)/(double(elapsed)/1e9)/(1024.0*1024.0):0;
+
+        if(csv_output)
+            printf("%s,%u,%llu,%.2f,%.4f,%.2f\n",name,size,(unsigned long long)bytes,ns_op,ns_byte,mbs);
+        else
+            printf("%-24s %8u %10llu %12.1f %10.4f %10.1f\n",name,size,(unsigned long long)bytes,ns_op,ns_byte,mbs);
+
+        fflush(stdout);
+    }
+
+    void PrintHeader()
+    {
+        if(csv_output)
+            printf("case,size,bytes,ns/op,ns/byte,MB/s\n");
+        else
+            printf("%-24s %8s %10s %12s %10s %10s\n","case","size","bytes","ns/op","ns/byte","MB/s");
+    }
+
+    /**
+     * TCPAcceptPacket收包测试对象，输入来自内存
+     */
+    class PacketParser:public TCPAcceptPacket
+    {
+    public:
+
+        bench::MemorySocketInputStream *ms;
+        uint64 packet_count=0;
+
+    public:
+
+        PacketParser()
+        {
+            ms=new bench::MemorySocketInputStream(chunk_size);
+            sis=ms;                                                 //由TCPAccept析构时释放
+        }
+
+        int Feed()
+        {
+            ms->Reset();
+            return OnSocketRecv(0);
+        }
+
+        bool OnRecvPacket(void *,const PACKET_SIZE_TYPE &) override
+        {
+            ++packet_count;
+            return(true);
+        }
+
+        void OnSocketError(int) override{}
+    };//class PacketParser
+
+    /**
+     * WebSocketAccept收帧测试对象，跳过握手，输入来自内存
+     */
+    class FrameParser:public WebSocketAccept
+    {
+    public:
+
+        bench::MemorySocketInputStream *ms;
+        uint64 frame_count=0;
+
+    public:
+
+        FrameParser()
+        {
+            ms=new bench::MemorySocketInputStream(chunk_size);
+            sis=ms;
+            handshake_done=true;
+        }
+
+        int Feed()
+        {
+            ms->Reset();
+            return OnSocketRecv(0);
+        }
+
+        bool OnBinary(void *data,uint32,bool) override
+        {
+            sink+=*(uint8 *)data;
+            ++frame_count;
+            return(true);
+        }
+
+        bool OnText(char *,uint32,bool) override
+        {
+            ++frame_count;
+            return(true);
+        }
+
+        void OnSocketError(int) override{}
+    };//class FrameParser
+
+    constexpr uint BATCH_BYTES=HGL_SIZE_1KB*256;                    ///<每次Feed的数据量(约)
+
+    void BenchPacket(uint size)
+    {
+        const uint count=hgl_max<uint>(1,BATCH_BYTES/(size+PACKET_SIZE_TYPE_BYTES));
+
+        std::vector<uint8> stream;
+
+        for(uint i=0;i<count;i++)
+        {
+            const PACKET_SIZE_TYPE ps=size;
+            const uint8 *h=(const uint8 *)&ps;
+
+            stream.insert(stream.end(),h,h+PACKET_SIZE_TYPE_BYTES);
+            stream.insert(stream.end(),size,uint8(i));
+        }
+
+        PacketParser pp;
+
+        pp.ms->Set(stream.data(),stream.size());
+
+        Measure("TCPAcceptPacket",size,stream.size(),[&pp]{pp.Feed();});
+
+        if(pp.packet_count%count)
+            printf("  packet count mismatch!\n");
+    }
+
+    /**
+     * 生成客户端发出的帧(带掩码)
+     */
+    void AppendClientFrame(std::vector<uint8> &stream,uint size,uint32 mask)
+    {
+        uint8 header[HGL_WEBSOCKET_FRAME_HEADER_MAX_SIZE];
+
+        uint header_size=MakeWebSocketFrameHeader(header,2,size,true);
+
+        header[1]|=0x80;                                            //加上掩码标记，掩码紧跟在长度之后
+
+        stream.insert(stream.end(),header,header+header_size);
+        stream.insert(stream.end(),(const uint8 *)&mask,(const uint8 *)&mask+4);
+
+        const size_t start=stream.size();
+
+        stream.insert(stream.end(),size,uint8(0x5A));
+
+        WebSocketMask(stream.data()+start,size,mask);
+    }
+
+    void BenchFrame(uint size)
+    {
+        const uint count=hgl_max<uint>(1,BATCH_BYTES/(size+14));
+
+        std::vector<uint8> stream;
+
+        for(uint i=0;i<count;i++)
+            AppendClientFrame(stream,size,0x12345678u+i);
+
+        FrameParser fp;
+
+        fp.ms->Set(stream.data(),stream.size());
+
+        Measure("WebSocketAccept frame",size,stream.size(),[&fp]{fp.Feed();});
+
+        if(fp.frame_count%count)
+            printf("  frame count mismatch!\n");
+    }
+
+    void BenchMask(uint size)
+    {
+        std::vector<uint8> data(size,uint8(0x5A));
+
+        Measure("WebSocketMask",size,size,[&data]{WebSocketMask(data.data(),data.size(),0x12345678u);sink+=data[0];});
+    }
+
+    constexpr char WEBSOCKET_REQUEST[]= "GET /chat HTTP/1.1\r\n"
+                                        "Host: server.example.com\r\n"
+                                        "Upgrade: websocket\r\n"
+                                        "Connection: Upgrade\r\n"
+                                        "Origin: http://example.com\r\n"
+                                        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                        "Sec-WebSocket-Protocol: chat, superchat\r\n"
+                                        "Sec-WebSocket-Version: 13\r\n"
+                                        "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+                                        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+                                        "Accept-Encoding: gzip, deflate, br\r\n"
+                                        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+                                        "\r\n";
+
+    void BenchHandshake()
+    {
+        const uint size=sizeof(WEBSOCKET_REQUEST)-1;
+
+        U8String key,protocol,extensions;
+        uint version;
+
+        Measure("GetWebSocketInfo",size,size,[&]
+        {
+            GetWebSocketInfo(key,protocol,version,(const u8char *)WEBSOCKET_REQUEST,size,&extensions);
+        });
+
+        U8String result;
+
+        Measure("MakeWebSocketAccept",0,0,[&]
+        {
+            MakeWebSocketAccept(result,key,protocol,&extensions);
+            sink+=result.Length();
+        });
+    }
+
+    constexpr char HTTP_RESPONSE[]= "HTTP/1.1 200 OK\r\n"
+                                    "Date: Mon, 12 Oct 2026 08:00:00 GMT\r\n"
+                                    "Server: nginx/1.24.0\r\n"
+                                    "Content-Type: application/octet-stream\r\n"
+                                    "Content-Length: 1048576\r\n"
+                                    "Last-Modified: Sun, 11 Oct 2026 08:00:00 GMT\r\n"
+                                    "Connection: keep-alive\r\n"
+                                    "ETag: \"5f8c2a1b-100000\"\r\n"
+                                    "Accept-Ranges: bytes\r\n"
+                                    "\r\n"
+                                    "body";
+
+    void BenchHttpHeader()
+    {
+        const uint size=sizeof(HTTP_RESPONSE)-1;
+
+        bench::MemorySocketInputStream ms(chunk_size);
+        HTTPInputStream his;
+        char buf[HGL_SIZE_1KB];
+
+        ms.Set(HTTP_RESPONSE,size);
+
+        Measure("HTTPInputStream header",size,size,[&]
+        {
+            ms.Reset();
+            his.Open(&ms);
+
+            while(his.GetResponseCode()==0)
+                if(his.Read(buf,sizeof(buf))<0)
+                    break;
+
+            sink+=his.GetResponseCode();
+        });
+
+        his.Close();
+    }
+}//namespace
+
+int main(int argc,char **argv)
+{
+    bench::Args args(argc,argv);
+
+    csv_output  =args.Has("csv");
+    min_time    =args.GetFloat("time",0.2);
+    chunk_size  =args.GetInt("chunk",0);
+
+    PrintHeader();
+
+    for(uint size:{16u,64u,256u,1024u,4096u,16384u,65536u})
+        BenchPacket(size);
+
+    for(uint size:{16u,125u,1024u,4096u,65536u})
+        BenchFrame(size);
+
+    for(uint size:{16u,64u,1024u,65536u})
+        BenchMask(size);
+
+    BenchHandshake();
+    BenchHttpHeader();
+
+    return 0;
+}
@@ -0,0 +1,574 @@
+﻿/**
+ * 流量重放<br>
+ * 读取TrafficCapture录制的文件(服务器开启InitInfomation::traffic_capture，或BenchEchoServer --capture)，
+ * 按录制时的时间间隔(可加速)在多个连接上重新发出服务器当时收到的包/消息，统计吞吐、发送滞后与回应延迟，
+ * 用于以真实的消息构成对比不同版本的吞吐与尾延迟。<br>
+ * Packet记录含包头原样发出(与录制时的封包格式无关)，WebSocket记录重新编码为带掩码的客户端帧，
+ * 录制中出现过WebSocket记录的连接会先完成握手。连接在开始前全部建立，按录制中连接结束的时间关闭。<br>
+ * 回应延迟为一个连接上最早一个未得到回应的消息发出到收到下一段数据的时间(不要求服务器一问一答)。<br>
+ * 发送与接收直接使用POSIX socket与poll，录制文件使用CMNetwork的TrafficCaptureReader读取。
+ *
+ * 用法: BenchTrafficReplay --file=traffic.cap --host=127.0.0.1 --port=9000
+ *                          --speed=1 --scale=1 --threads=4 --drain=1
+ *   --speed    时间倍率(2表示两倍速，0表示不等待录制中的间隔，尽快发出)
+ *   --scale    每个录制的连接用几个连接重放(同时放大连接数与负载)
+ *   --drain    全部发出后继续接收回应的时间(秒)
+ */
+#include<hgl/network/TrafficCapture.h>
+#include"BenchCommon.h"
+#include"BenchSocket.h"
+
+#include<thread>
+#include<unordered_map>
+
+#include<poll.h>
+
+using namespace hgl::network;
+
+namespace
+{
+    constexpr size_t MAX_PENDING_OUT=4*1024*1024;                   ///<一个连接未发出的数据超过此长度时暂停分发(之后的消息计入滞后)
+
+    struct Config
+    {
+        sockaddr_storage addr;
+        socklen_t   addr_len=0;
+
+        const char *host="127.0.0.1";
+
+        double      speed=1;
+        double      drain=1;
+    };
+
+    /**
+     * 录制中的一个连接
+     */
+    struct CaptureConnection
+    {
+        bool websocket=false;                                       ///<出现过WebSocket记录
+        bool has_data=false;
+    };
+
+    /**
+     * 一个要在指定时间发出的记录
+     */
+    struct ReplayEvent
+    {
+        uint64_t time;                                              ///<距第一条数据记录的时间(纳秒，已按speed换算)
+        uint32_t slot;                                              ///<Worker中的连接序号
+        const TrafficCaptureRecord *rec;
+    };
+
+    struct Connection
+    {
+        int fd=-1;
+
+        bool websocket=false;
+        bool ws_partial=false;                                      ///<上一个WebSocket消息还没结束(下一段用继续帧)
+
+        std::vector<char> out;
+        size_t out_pos=0;
+
+        uint64_t wait_since=0;                                      ///<最早一个未得到回应的消息的发出时间(0表示没有)
+
+        bool close_after_send=false;                                ///<录制中连接已结束，发完后关闭发送方向
+        bool shutdown_send=false;                                   ///<已关闭发送方向，等服务器关闭
+        bool closed=false;
+
+        size_t GetPending()const{return out.size()-out_pos;}
+    };
+
+    struct ReplayResult
+    {
+        uint64_t messages=0;                                        ///<发出的包/消息数
+        uint64_t send_bytes=0;                                      ///<发出的字节数(含帧头)
+        uint64_t recv_bytes=0;                                      ///<收到的字节数
+        uint64_t errors=0;                                          ///<连接失败或被服务器断开的次数
+        uint64_t send_end=0;                                        ///<全部发出的时间
+
+        bench::LatencySamples lag;                                  ///<实际发出时间比录制的时间晚了多少
+        bench::LatencySamples reply;                                ///<回应延迟
+
+        void Merge(const ReplayResult &r)
+        {
+            messages+=r.messages;
+            send_bytes+=r.send_bytes;
+            recv_bytes+=r.recv_bytes;
+            errors+=r.errors;
+            send_end=std::max(send_end,r.send_end);
+
+            lag.Merge(r.lag);
+            reply.Merge(r.reply);
+        }
+    };
+
+    /**
+     * 每个线程一个，按时间顺序重放分给它的连接上的记录
+     */
+    class Worker
+    {
+        const Config &cfg;
+
+        std::vector<Connection> conn_list;
+        std::vector<ReplayEvent> event_list;
+        std::vector<pollfd> poll_list;
+
+    public:
+
+        ReplayResult result;
+
+    private:
+
+        void CloseConnection(Connection &c)
+        {
+            if(c.fd>=0)
+                close(c.fd);
+
+            c.fd=-1;
+            c.closed=true;
+        }
+
+        /**
+         * 将一条记录编码到连接的发送缓冲区
+         * @return 是否为有数据的记录
+         */
+        bool Dispatch(Connection &c,const TrafficCaptureRecord *rec,uint64_t now)
+        {
+            const TrafficCaptureKind kind=TrafficCaptureKind(rec->kind);
+
+            if(kind==TrafficCaptureKind::Close)
+            {
+                c.close_after_send=true;
+                return(false);
+            }
+
+            const size_t before=c.out.size();
+
+            if(kind==TrafficCaptureKind::Packet)
+            {
+                c.out.insert(c.out.end(),(const char *)rec->GetData(),(const char *)rec->GetData()+rec->size);
+            }
+            else
+            if(kind==TrafficCaptureKind::WebSocketBinary
+             ||kind==TrafficCaptureKind::WebSocketText)
+            {
+                const uint8_t opcode=(c.ws_partial?0x00:(kind==TrafficCaptureKind::WebSocketText?0x01:0x02));
+
+                bench::AppendWebSocketFrame(c.out,opcode,rec->IsFin(),rec->GetData(),rec->size);
+
+                c.ws_partial=!rec->IsFin();
+            }
+            else
+                return(false);                                      //Open等没有数据的记录
+
+            ++result.messages;
+            result.send_bytes+=c.out.size()-before;
+
+            if(!c.wait_since)
+                c.wait_since=now;
+
+            return(true);
+        }
+
+        bool FlushOut(Connection &c)
+        {
+            while(c.out_pos<c.out.size())
+            {
+                const ssize_t n=send(c.fd,c.out.data()+c.out_pos,c.out.size()-c.out_pos,MSG_NOSIGNAL);
+
+                if(n<0)
+                {
+                    if(errno==EINTR)continue;
+                    if(errno==EAGAIN||errno==EWOULDBLOCK)return(true);
+                    return(false);
+                }
+
+                c.out_pos+=n;
+            }
+
+            c.out.clear();
+            c.out_pos=0;
+            return(true);
+        }
+
+        bool RecvStream(Connection &c)
+        {
+            char buf[65536];
+
+            while(true)
+            {
+                const ssize_t n=recv(c.fd,buf,sizeof(buf),0);
+
+                if(n==0)return(false);
+
+                if(n<0)
+                {
+                    if(errno==EINTR)continue;
+                    if(errno==EAGAIN||errno==EWOULDBLOCK)break;
+                    return(false);
+                }
+
+                if(c.wait_since)
+                {
+                    result.reply.Add(bench::NowNS()-c.wait_since);
+                    c.wait_since=0;
+                }
+
+                result.recv_bytes+=n;
+            }
+
+            return(true);
+        }
+
+        /**
+         * 发送缓冲区中的数据并处理收到的回应
+         * @param timeout_ms poll超时时间
+         */
+        void Poll(int timeout_ms)
+        {
+            for(size_t i=0;i<conn_list.size();i++)
+            {
+                Connection &c=conn_list[i];
+
+                if(!c.closed&&c.GetPending()>0&&!FlushOut(c))
+                {
+                    ++result.errors;
+                    CloseConnection(c);
+                }
+
+                if(!c.closed&&c.close_after_send&&!c.shutdown_send&&c.GetPending()==0)
+                {
+                    shutdown(c.fd,SHUT_WR);                         //直接close会在还有未读的回应时发出RST
+                    c.shutdown_send=true;
+                }
+
+                poll_list[i].fd=c.closed?-1:c.fd;
+                poll_list[i].events=POLLIN|(c.GetPending()>0?POLLOUT:0);
+                poll_list[i].revents=0;
+            }
+
+            if(poll(poll_list.data(),nfds_t(poll_list.size()),timeout_ms)<=0)
+                return;
+
+            for(size_t i=0;i<conn_list.size();i++)
+            {
+                Connection &c=conn_list[i];
+
+                if(c.closed)continue;
+
+                const short ev=poll_list[i].revents;
+
+                if((ev&POLLIN)?!RecvStream(c):(ev&(POLLERR|POLLHUP|POLLNVAL))!=0)
+                {
+                    if(!c.shutdown_send)                            //不是在等待服务器关闭
+                        ++result.errors;
+
+                    CloseConnection(c);
+                }
+            }
+        }
+
+        bool HasPending()const
+        {
+            for(const Connection &c:conn_list)
+                if(!c.closed&&c.GetPending()>0)
+                    return(true);
+
+            return(false);
+        }
+
+    public:
+
+        Worker(const Config &c):cfg(c){}
+
+        ~Worker()
+        {
+            for(Connection &c:conn_list)
+                CloseConnection(c);
+        }
+
+        uint32_t AddConnection(bool websocket)
+        {
+            conn_list.emplace_back();
+            conn_list.back().websocket=websocket;
+
+            return uint32_t(conn_list.size()-1);
+        }
+
+        void AddEvent(uint64_t time,uint32_t slot,const TrafficCaptureRecord *rec)
+        {
+            event_list.push_back({time,slot,rec});
+        }
+
+        size_t GetConnectionCount()const{return conn_list.size();}
+
+        /**
+         * 建立全部连接(阻塞connect与握手，完成后转为非阻塞)
+         */
+        bool Connect()
+        {
+            for(Connection &c:conn_list)
+            {
+                c.fd=socket(cfg.addr.ss_family,SOCK_STREAM,0);
+
+                if(c.fd<0)return(false);
+
+                if(connect(c.fd,(const sockaddr *)&cfg.addr,cfg.addr_len))
+                    return(false);
+
+                const int on=1;
+
+                setsockopt(c.fd,IPPROTO_TCP,TCP_NODELAY,&on,sizeof(on));
+
+                if(c.websocket&&!bench::WebSocketHandshake(c.fd,cfg.host))
+                    return(false);
+
+                bench::SetNonBlock(c.fd);
+            }
+
+            return(true);
+        }
+
+        void Run(uint64_t start)
+        {
+            poll_list.resize(conn_list.size());
+
+            result.lag.Reserve(event_list.size());
+
+            size_t cursor=0;
+
+            while(cursor<event_list.size())
+            {
+                uint64_t now=bench::NowNS();
+
+                while(cursor<event_list.size())
+                {
+                    const ReplayEvent &e=event_list[cursor];
+                    const uint64_t due=start+e.time;
+
+                    if(due>now)break;
+
+                    Connection &c=conn_list[e.slot];
+
+                    if(!c.closed)
+                    {
+                        if(c.GetPending()>=MAX_PENDING_OUT)         //服务器收不动了，后面的消息跟着等待
+                            break;
+
+                        if(Dispatch(c,e.rec,now))
+                            result.lag.Add(now-due);
+                    }
+
+                    ++cursor;
+                }
+
+                int timeout_ms=0;
+
+                if(cursor<event_list.size())
+                {
+                    const uint64_t due=start+event_list[cursor].time;
+
+                    now=bench::NowNS();
+
+                    if(due>now)
+                        timeout_ms=int(std::min<uint64_t>((due-now)/1000000,100));          //不足1毫秒时不等待
+                }
+
+                Poll(timeout_ms);
+            }
+
+            while(HasPending())
+                Poll(10);
+
+            result.send_end=bench::NowNS();
+
+            const uint64_t drain_end=bench::NowNS()+uint64_t(cfg.drain*1e9);
+
+            while(bench::NowNS()<drain_end)
+                Poll(10);
+        }
+    };//class Worker
+
+    void PrintPercentile(const char *name,bench::LatencySamples &ls)
+    {
+        ls.Sort();
+
+        printf("%-10s %10zu %10.1f %10.1f %10.1f %10.1f\n",
+               name,ls.GetCount(),
+               ls.GetPercentileUS(0.50),
+               ls.GetPercentileUS(0.99),
+               ls.GetPercentileUS(0.999),
+               ls.GetPercentileUS(1.0));
+    }
+}//namespace
+
+int main(int argc,char **argv)
+{
+    bench::Args args(argc,argv);
+
+    Config cfg;
+
+    const char *filename=args.Get("file",nullptr);
+
+    if(!filename||!*filename)
+    {
+        printf("usage: BenchTrafficReplay --file=traffic.cap [--host=127.0.0.1] [--port=9000] [--speed=1] [--scale=1] [--threads=4] [--drain=1]\n");
+        return 1;
+    }
+
+    cfg.host                =args.Get("host","127.0.0.1");
+    cfg.speed               =args.GetFloat("speed",1);
+    cfg.drain               =args.GetFloat("drain",1);
+
+    const int port          =args.GetInt("port",9000);
+    const int scale         =std::max(1,args.GetInt("scale",1));
+    const int thread_count  =std::max(1,args.GetInt("threads",int(std::thread::hardware_concurrency())));
+
+    if(!bench::ResolveAddress(cfg.addr,cfg.addr_len,cfg.host,port,false))
+    {
+        printf("can't resolve %s:%d\n",cfg.host,port);
+        return 1;
+    }
+
+    TrafficCaptureReader reader;
+
+    if(!reader.Open(filename))
+    {
+        printf("can't open capture file %s\n",filename);
+        return 1;
+    }
+
+    //第一遍：找出有数据的连接与类型
+    std::unordered_map<uint32_t,CaptureConnection> capture_map;
+
+    uint64_t first_time=UINT64_MAX,last_time=0;
+    uint64_t record_count=0;
+
+    for(uint64_t pos=reader.GetFirst();const TrafficCaptureRecord *rec=reader.Next(pos);)
+    {
+        const TrafficCaptureKind kind=TrafficCaptureKind(rec->kind);
+
+        if(kind==TrafficCaptureKind::Open||kind==TrafficCaptureKind::Close)
+            continue;
+
+        CaptureConnection &cc=capture_map[rec->connection];
+
+        cc.has_data=true;
+
+        if(kind!=TrafficCaptureKind::Packet)
+            cc.websocket=true;
+
+        first_time=std::min(first_time,rec->time);
+        last_time=std::max(last_time,rec->time);
+        ++record_count;
+    }
+
+    if(record_count==0)
+    {
+        printf("capture file %s has no data record.\n",filename);
+        return 1;
+    }
+
+    //第二遍：分配连接，生成每个线程的时间线
+    std::vector<Worker *> worker_list;
+
+    for(int i=0;i<thread_count;i++)
+        worker_list.push_back(new Worker(cfg));
+
+    std::unordered_map<uint32_t,std::vector<std::pair<Worker *,uint32_t>>> slot_map;        ///<录制中的连接编号 → 重放用的(线程,连接)列表
+
+    uint32_t next_worker=0;
+
+    for(uint64_t pos=reader.GetFirst();const TrafficCaptureRecord *rec=reader.Next(pos);)
+    {
+        auto cc=capture_map.find(rec->connection);
+
+        if(cc==capture_map.end())                                   //没有数据的连接不重放
+            continue;
+
+        auto it=slot_map.find(rec->connection);
+
+        if(it==slot_map.end())
+        {
+            std::vector<std::pair<Worker *,uint32_t>> &sl=slot_map[rec->connection];
+
+            for(int i=0;i<scale;i++)
+            {
+                Worker *w=worker_list[next_worker++%worker_list.size()];
+
+                sl.push_back({w,w->AddConnection(cc->second.websocket)});
+            }
+
+            it=slot_map.find(rec->connection);
+        }
+
+        const TrafficCaptureKind kind=TrafficCaptureKind(rec->kind);
+
+        if(kind==TrafficCaptureKind::Open)
+            continue;
+
+        const uint64_t t=(rec->time>first_time?rec->time-first_time:0);
+        const uint64_t time=(cfg.speed>0?uint64_t(double(t)/cfg.speed):0);
+
+        for(const auto &ws:it->second)
+            ws.first->AddEvent(time,ws.second,rec);
+    }
+
+    size_t conn_count=0;
+
+    for(Worker *w:worker_list)
+    {
+        if(!w->Connect())
+        {
+            printf("connect failed: %s\n",strerror(errno));
+
+            for(Worker *ow:worker_list)
+                delete ow;
+
+            return 1;
+        }
+
+        conn_count+=w->GetConnectionCount();
+    }
+
+    printf("replay %s: %llu records, %zu connections(x%d), capture %.3fs, speed %g\n",
+           filename,(unsigned long long)record_count,capture_map.size(),scale,
+           double(last_time-first_time)/1e9,cfg.speed);
+
+    fflush(stdout);
+
+    const uint64_t start=bench::NowNS()+10000000;                   //留10毫秒让所有线程就绪
+
+    std::vector<std::thread> thread_list;
+
+    for(Worker *w:worker_list)
+        thread_list.emplace_back([w,start]{w->Run(start);});
+
+    for(std::thread &t:thread_list)
+        t.join();
+
+    ReplayResult total;
+
+    for(Worker *w:worker_list)
+    {
+        total.Merge(w->result);
+        delete w;
+    }
+
+    const double seconds=(total.send_end>start?double(total.send_end-start)/1e9:0);     //不含drain时间
+
+    printf("%8s %8s %12s %12s %12s %12s %8s\n","conn","seconds","msgs","msgs/s","send MB/s","recv MB/s","errors");
+    printf("%8zu %8.3f %12llu %12.0f %12.2f %12.2f %8llu\n",
+           conn_count,seconds,
+           (unsigned long long)total.messages,
+           seconds>0?total.messages/seconds:0,
+           seconds>0?total.send_bytes/seconds/(1024.0*1024.0):0,
+           seconds>0?total.recv_bytes/seconds/(1024.0*1024.0):0,
+           (unsigned long long)total.errors);
+
+    printf("%-10s %10s %10s %10s %10s %10s\n","","samples","p50(us)","p99(us)","p999(us)","max(us)");
+    PrintPercentile("lag",total.lag);
+    PrintPercentile("reply",total.reply);
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+﻿/**
+ * UDP回显服务器(UDPSocket)<br>
+ * 收到的每个数据报原样发回来源地址，配合LoadGenerator --mode=udp使用<br>
+ * 用法: BenchUDPPingPong --port=9002 [--batch=32]
+ *      --batch 大于1时使用RecvPackets/SendPackets批量收发
+ */
+#include<hgl/network/UdpSocket.h>
+#include"BenchCommon.h"
+
+using namespace hgl;
+using namespace hgl::network;
+
+int main(int argc,char **argv)
+{
+    bench::Args args(argc,argv);
+
+    const int port=args.GetInt("port",9002);
+
+    IPAddress *bind_addr=CreateIPv4UDP(ushort(port));
+    IPAddress *from=bind_addr->Create();
+
+    UDPSocket udp;
+
+    if(!udp.Create(bind_addr))
+    {
+        printf("create udp socket failed.\n");
+        return 1;
+    }
+
+    printf("udp ping-pong server listen on port %d.\n",port);
+
+    const int batch=args.GetInt("batch",1);
+
+    std::vector<char> buf(65536*size_t(batch>1?batch:1));
+    std::vector<UDPPacket> pack_list(batch>1?batch:0);
+    std::vector<IPAddress *> addr_list;
+
+    for(int i=0;i<int(pack_list.size());i++)
+    {
+        addr_list.push_back(bind_addr->Create());
+
+        pack_list[i].data=buf.data()+size_t(i)*65536;
+        pack_list[i].addr=addr_list[i];
+    }
+
+    uint64_t count=0;
+    uint64_t last_time=bench::NowNS();
+
+    while(true)
+    {
+        if(batch>1)
+        {
+            for(UDPPacket &up:pack_list)
+                up.size=65536;
+
+            const int n=udp.RecvPackets(pack_list.data(),batch);
+
+            if(n<=0)continue;
+
+            for(int i=0;i<n;i++)
+                pack_list[i].size=pack_list[i].result;
+
+            udp.SendPackets(pack_list.data(),n);
+
+            count+=n;
+        }
+        else
+        {
+            const int size=udp.RecvPacket(buf.data(),int(buf.size()),from);
+
+            if(size<=0)continue;
+
+            udp.SendPacket(from,buf.data(),size);
+
+            ++count;
+        }
+
+        const uint64_t now=bench::NowNS();
+
+        if(now-last_time>=1000000000ull)
+        {
+            printf("packets/s %llu\n",(unsigned long long)count);
+            fflush(stdout);
+
+            count=0;
+            last_time=now;
+        }
+    }
+
+    for(IPAddress *addr:addr_list)
+        delete addr;
+
+    delete from;
+    return 0;
+}
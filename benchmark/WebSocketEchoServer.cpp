@@ -0,0 +1,103 @@
+﻿/**
+ * WebSocket回显服务器(WebSocketAccept)<br>
+ * 收到的每个消息(分段时逐段)原样发回，配合LoadGenerator --mode=ws使用<br>
+ * 用法: BenchWebSocketEchoServer --port=9001 --threads=4 --max_user=10000 [--deflate] [--capture=traffic.cap]
+ *   --capture  录制收到的消息，供BenchTrafficReplay重放(--capture_max=文件最大MB数)
+ */
+#include<hgl/network/MTTCPServer.h>
+#include<hgl/network/WebSocketAccept.h>
+#include<hgl/Time.h>
+#include"BenchCommon.h"
+
+using namespace hgl;
+using namespace hgl::network;
+
+namespace
+{
+    bool use_deflate=false;
+
+    class WebSocketEchoAccept:public WebSocketAccept
+    {
+    public:
+
+        WebSocketEchoAccept(int sock,const IPAddress *addr):WebSocketAccept(sock,addr)
+        {
+            if(use_deflate)
+            {
+                WebSocketDeflateConfig cfg;
+
+                cfg.enable=true;
+                SetDeflate(cfg);
+            }
+        }
+
+        bool OnBinary(void *data,uint32 size,bool fin) override
+        {
+            return SendBinary(data,size,fin);
+        }
+
+        bool OnText(char *data,uint32 size,bool fin) override
+        {
+            return SendText(data,size,fin);
+        }
+
+        void OnSocketError(int) override{}
+    };//class WebSocketEchoAccept
+}//namespace
+
+int main(int argc,char **argv)
+{
+    bench::Args args(argc,argv);
+
+    use_deflate=args.Has("deflate");
+
+    TrafficCapture capture;                                         //须在server之后释放
+
+    const char *capture_file=args.Get("capture",nullptr);
+
+    if(capture_file&&!capture.Create(capture_file,uint64(args.GetInt("capture_max",0))*HGL_SIZE_1MB))
+    {
+        printf("create capture file failed.\n");
+        return 1;
+    }
+
+    MTTCPServerStd<WebSocketEchoAccept> server;
+    MTTCPServerStd<WebSocketEchoAccept>::InitInfomation info;
+
+    info.server_ip          =CreateIPv4TCP(ushort(args.GetInt("port",9001)));
+    info.thread_count       =args.GetInt("threads",4);
+    info.max_user           =args.GetInt("max_user",10000);
+    info.port_reuse         =true;
+    info.reuse_port_shard   =args.Has("shard");
+    info.traffic_capture    =capture.IsOpen()?&capture:nullptr;
+
+    if(!server.Init(info))
+    {
+        printf("init websocket echo server failed.\n");
+        return 1;
+    }
+
+    printf("websocket echo server listen on port %d, %d threads%s.\n",args.GetInt("port",9001),info.thread_count,use_deflate?", deflate":"");
+
+    while(server.IsLive()>0)
+    {
+        WaitTime(1);
+
+        SocketManageMetricsSnapshot sm;
+
+        server.GetMetricsSnapshot(sm);
+
+        printf("conn %6llu  events %12llu  recv %12llu bytes  send %12llu bytes\n",
+               (unsigned long long)sm.connection_count,
+               (unsigned long long)sm.event_count,
+               (unsigned long long)sm.recv_bytes,
+               (unsigned long long)sm.send_bytes);
+
+        fflush(stdout);
+
+        if(capture.IsOpen())
+            capture.Flush();
+    }
+
+    return 0;
+}
@@ -11,8 +11,6 @@ namespace hgl
          */
         class AcceptServer:public ServerSocket                                                      ///使用Accept创建接入的服务器基类
         {
-            char *ipstr;
-
             fd_set accept_set;
             struct timeval accept_timeout,ato;
 
@@ -29,7 +27,6 @@ namespace hgl
             AcceptServer()
             {
                 overload_wait=HGL_SERVER_OVERLOAD_RESUME_TIME;
-                ipstr = nullptr;
 
                 FD_ZERO(&accept_set);
                 hgl_zero(accept_timeout);
@@ -37,11 +34,12 @@ namespace hgl
                 SetTimeOut(HGL_NETWORK_TIME_OUT);
             }
 
-            virtual ~AcceptServer(){SAFE_CLEAR(ipstr);}
+            virtual ~AcceptServer()=default;
 
                     void SetTimeOut(const double);
 
             virtual int Accept(IPAddress *);                                                        ///<接入一个socket连接
+            virtual int AcceptNonBlock(IPAddress *);                                                ///<以非阻塞方式接入一个socket连接(由SocketManage在监听socket就绪时调用)
         };//class AcceptServer
     }//namespace network
 }//namespace hgl
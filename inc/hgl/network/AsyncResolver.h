@@ -0,0 +1,98 @@
+﻿#ifndef HGL_NETWORK_ASYNC_RESOLVER_INCLUDE
+#define HGL_NETWORK_ASYNC_RESOLVER_INCLUDE
+
+#include<hgl/network/DatagramSocket.h>
+#include<hgl/network/IP.h>
+#include<hgl/thread/ThreadMutex.h>
+#include<hgl/thread/Semaphore.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 一个异步域名解析请求<br>
+         * 由调用者创建并持有，提交后直到OnResolved被调用之前不可修改或释放。
+         */
+        class DNSRequest
+        {
+        public:
+
+            AnsiString name;                                                                        ///<域名或地址字符串
+            int family=AF_UNSPEC;                                                                   ///<AF_INET、AF_INET6或AF_UNSPEC(两种都解析)
+            int socktype=SOCK_STREAM;
+            int protocol=IPPROTO_TCP;
+            bool use_cache=true;                                                                    ///<经过DNSCache
+
+        public: //结果
+
+            List<in_addr> ipv4;
+            List<in6_addr> ipv6;
+            int result=0;                                                                           ///<地址总数，-1表示解析失败
+
+        public:
+
+            virtual ~DNSRequest()=default;
+
+            /**
+             * 解析完成(在AsyncResolver::Update/ProcRecv所在线程中调用，可以在这里释放自身)
+             */
+            virtual void OnResolved(){}
+        };//class DNSRequest
+
+        class ResolverThread;
+
+        /**
+         * 异步域名解析器<br>
+         * 由一组解析线程调用getaddrinfo(可经过DNSCache)，调用者线程不会被慢速解析阻塞。
+         * 解析完成后通过一个可读的通知句柄(Linux为eventfd，其它UNIX为pipe)唤醒，
+         * 可以用SocketManage::JoinDatagram加入轮循，在SocketManage所在线程中回调DNSRequest::OnResolved；
+         * 也可以不加入SocketManage，由使用者在自己的线程中定时调用Update。Windows下只能使用Update。
+         */
+        class AsyncResolver:public DatagramSocket
+        {
+            friend class ResolverThread;
+
+            int wake_fd;                                                                            ///<写入端(eventfd时与ThisSocket相同)
+
+            ThreadMutex request_lock;
+            List<DNSRequest *> request_list;                                                        ///<等待解析的请求
+            Semaphore request_sem;
+
+            ThreadMutex done_lock;
+            List<DNSRequest *> done_list;                                                           ///<已解析完成，等待回调的请求
+
+            List<ResolverThread *> thread_list;
+            std::atomic<bool> exit_flag{false};
+
+        private:
+
+            DNSRequest *PopRequest();
+            void PushDone(DNSRequest *);
+            void Notify();
+            void ClearNotify();
+
+        public:
+
+            AsyncResolver();
+            virtual ~AsyncResolver();
+
+            bool Init(const uint thread_count=2);                                                   ///<创建通知句柄与解析线程
+            void Close();                                                                           ///<关闭解析线程(未完成的请求以失败回调)
+
+            bool Resolve(DNSRequest *);                                                             ///<提交一个请求(任意线程调用)
+
+            /**
+             * 回调已完成的请求(只能在一个线程中调用)
+             * @return 回调的请求数量
+             */
+            int Update();
+
+        public: //DatagramSocket
+
+            int ProcRecv(int=-1) override;                                                          ///<通知句柄可读时回调已完成的请求
+            double ProcUpdate(const double) override{Update();return(-1);}
+        };//class AsyncResolver:public DatagramSocket
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_ASYNC_RESOLVER_INCLUDE
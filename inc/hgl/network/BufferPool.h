@@ -0,0 +1,58 @@
+﻿#ifndef HGL_NETWORK_BUFFER_POOL_INCLUDE
+#define HGL_NETWORK_BUFFER_POOL_INCLUDE
+
+#include<hgl/type/List.h>
+namespace hgl
+{
+    namespace network
+    {
+        constexpr uint HGL_BUFFER_POOL_MIN_LEVEL    =8;                                             ///<最小级别(2^8=256字节)
+        constexpr uint HGL_BUFFER_POOL_MAX_LEVEL    =22;                                            ///<最大级别(2^22=4MB)，更大的缓冲区直接分配不入池
+        constexpr uint HGL_BUFFER_POOL_LEVEL_COUNT  =HGL_BUFFER_POOL_MAX_LEVEL-HGL_BUFFER_POOL_MIN_LEVEL+1;
+        constexpr int64 HGL_BUFFER_POOL_MAX_CACHE   =HGL_SIZE_1MB*64;                               ///<缺省最大缓存字节数
+
+        /**
+         * 缓冲区池统计数据
+         */
+        struct BufferPoolStats
+        {
+            uint64 acquire_count;                                                                   ///<借出次数
+            uint64 release_count;                                                                   ///<归还次数
+            uint64 hit_count;                                                                       ///<直接从池中取得的次数
+            uint64 miss_count;                                                                      ///<需要新分配的次数
+            uint64 over_size_count;                                                                 ///<超过最大级别直接分配的次数
+
+            int64 lend_bytes;                                                                       ///<当前借出字节数
+            int64 peak_lend_bytes;                                                                  ///<借出字节数峰值
+            int64 cache_bytes;                                                                      ///<当前池中缓存的字节数
+        };//struct BufferPoolStats
+
+        /**
+         * 多级缓冲区池<br>
+         * 按2的幂分级缓存缓冲区，借出时按所需大小向上取整到对应级别。<br>
+         * 每个SocketManage(即每个SocketManageThread)拥有一个，只在本线程内使用，所以不加锁。
+         */
+        class BufferPool
+        {
+            List<uchar *> free_list[HGL_BUFFER_POOL_LEVEL_COUNT];
+
+            int64 max_cache_bytes;
+
+            BufferPoolStats stats;
+
+        public:
+
+            BufferPool(int64 mcb=HGL_BUFFER_POOL_MAX_CACHE);
+            ~BufferPool();
+
+            void    SetMaxCacheBytes(int64 mcb){max_cache_bytes=mcb;}                               ///<设置最大缓存字节数
+            const   BufferPoolStats &GetStats()const{return stats;}                                 ///<取得统计数据
+
+            uchar * Acquire(uint size,uint &capacity);                                              ///<借出一个缓冲区
+            void    Release(uchar *,uint capacity);                                                 ///<归还一个缓冲区
+
+            void    Clear();                                                                        ///<释放池中所有缓存的缓冲区
+        };//class BufferPool
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_BUFFER_POOL_INCLUDE
@@ -0,0 +1,24 @@
+﻿#ifndef HGL_NETWORK_CPU_AFFINITY_INCLUDE
+#define HGL_NETWORK_CPU_AFFINITY_INCLUDE
+
+#include<hgl/platform/Platform.h>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 线程CPU/NUMA放置相关的辅助函数<br>
+         * 多路服务器上网卡中断、接收线程、缓冲区内存如果不在同一个NUMA节点，每个包都要跨节点访问内存。<br>
+         * 这里只提供最基本的操作，具体如何分配由MTTCPServer/SocketManageThread决定。
+         */
+        int  GetCPUCount();                                                                         ///<取得可用的CPU数量
+        int  GetCPUNumaNode(const int cpu);                                                         ///<取得CPU所在的NUMA节点(<0表示未知)
+
+        bool BindThreadToCPU(const int cpu);                                                        ///<将当前线程绑定到指定CPU
+        bool SetThreadMemoryNode(const int node);                                                   ///<当前线程之后分配的内存优先放在指定NUMA节点(<0恢复缺省)
+
+        int  GetSocketIncomingCPU(const int sock);                                                  ///<取得socket最近一次收包所在的CPU(仅Linux，<0表示未知)
+        int  GetSocketNapiID(const int sock);                                                       ///<取得socket所在接收队列的NAPI ID(仅Linux，<=0表示未知)
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_CPU_AFFINITY_INCLUDE
@@ -0,0 +1,85 @@
+﻿#ifndef HGL_NETWORK_CONNECTION_TABLE_INCLUDE
+#define HGL_NETWORK_CONNECTION_TABLE_INCLUDE
+
+#include<hgl/type/List.h>
+#include<hgl/type/DataArray.h>
+namespace hgl
+{
+    namespace network
+    {
+        class TCPAccept;
+
+        using TCPAcceptList=List<TCPAccept *>;
+
+        /**
+         * 连接句柄<br>
+         * 低32位为槽位(即socket)，32-55位为槽位的代数，56-63位为所属管理器编号。<br>
+         * 连接分离后槽位代数加一，所以旧句柄不会误指向复用了同一socket的新连接，可以放心地在其它线程保存和使用
+         */
+        using ConnectionHandle=uint64;
+
+        constexpr ConnectionHandle HGL_INVALID_CONNECTION_HANDLE=0;
+
+        constexpr uint HGL_CONNECTION_GENERATION_MASK=0xFFFFFF;
+
+        inline const int  GetConnectionSlot      (const ConnectionHandle h){return int(h&0xFFFFFFFF);}
+        inline const uint GetConnectionGeneration(const ConnectionHandle h){return uint(h>>32)&HGL_CONNECTION_GENERATION_MASK;}
+        inline const uint GetConnectionOwner     (const ConnectionHandle h){return uint(h>>56);}
+
+        inline const ConnectionHandle MakeConnectionHandle(const uint owner,const uint generation,const int slot)
+        {
+            return (ConnectionHandle(owner&0xFF)<<56)
+                  |(ConnectionHandle(generation&HGL_CONNECTION_GENERATION_MASK)<<32)
+                  | ConnectionHandle(uint32(slot));
+        }
+
+        /**
+         * 以socket为下标的连接表<br>
+         * 取代Map<int,TCPAccept *>查重表与SortedSet错误表：查找、加入、删除都是O(1)，另外维护一个紧凑列表供遍历
+         */
+        class ConnectionTable
+        {
+            struct Slot
+            {
+                TCPAccept *accept;
+                uint generation;                                                                    ///<槽位代数(0不使用)
+                int index;                                                                          ///<在active_list中的位置
+                bool error;                                                                         ///<已加入错误列表
+            };
+
+            DataArray<Slot> slot_list;
+            TCPAcceptList active_list;                                                              ///<当前所有连接(紧凑存放，删除时用最后一个填补)
+            TCPAcceptList error_list;                                                               ///<本次Update中出错的连接
+
+            uint owner_id=0;
+
+        private:
+
+            Slot *GetSlot(const int sock);
+            const Slot *GetSlot(const int sock)const;
+
+        public:
+
+            void SetOwner(const uint id){owner_id=id;}                                              ///<设置所属管理器编号(写入句柄)
+            const uint GetOwner()const{return owner_id;}
+
+            const int GetCount()const{return active_list.GetCount();}                               ///<取得连接数量
+            TCPAccept **GetData(){return active_list.GetData();}                                    ///<取得所有连接(遍历期间不可加入/删除)
+
+            void PreAlloc(const int count){active_list.PreAlloc(count);}
+
+            ConnectionHandle Add(TCPAccept *);                                                      ///<加入一个连接，socket已被占用时返回HGL_INVALID_CONNECTION_HANDLE
+            bool Remove(TCPAccept *);                                                               ///<删除一个连接(代数加一)
+
+            TCPAccept *Get(const int sock)const;                                                    ///<按socket取得连接
+            TCPAccept *Get(const ConnectionHandle)const;                                            ///<按句柄取得连接(已失效返回nullptr)
+
+            bool MarkError(TCPAccept *);                                                            ///<将连接加入错误列表(重复加入会被忽略)
+            const TCPAcceptList &GetErrorList()const{return error_list;}
+            void ClearErrorList(){error_list.Clear();}                                              ///<清空错误列表(其中的连接已在出错时被删除，标记也随之清除，这里不再访问它们)
+
+            void Clear();                                                                           ///<删除所有连接
+        };//class ConnectionTable
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_CONNECTION_TABLE_INCLUDE
@@ -0,0 +1,443 @@
+﻿#ifndef HGL_NETWORK_COROUTINE_ACCEPT_INCLUDE
+#define HGL_NETWORK_COROUTINE_ACCEPT_INCLUDE
+
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/SocketManage.h>
+
+#if !defined(__cpp_impl_coroutine)
+#error CoroutineAccept.h need C++20 coroutine support.
+#endif//!defined(__cpp_impl_coroutine)
+
+#include<coroutine>
+#include<exception>
+#include<optional>
+#include<utility>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 协程任务<br>
+         * 创建后不立即执行，被co_await时才开始，结束时直接切回等待它的协程(不经过调度，不会增加栈深度)。
+         * 对象析构时销毁协程帧，协程中的局部对象随之析构。不使用异常，协程中抛出的异常会结束进程。
+         */
+        template<typename T=void> class CoTask;
+
+        namespace coroutine_detail
+        {
+            struct PromiseBase
+            {
+                std::coroutine_handle<> continuation;                           ///<等待本任务结束的协程
+
+                std::suspend_always initial_suspend()noexcept{return{};}
+
+                struct FinalAwaiter
+                {
+                    bool await_ready()noexcept{return(false);}
+
+                    template<typename P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h)noexcept
+                    {
+                        std::coroutine_handle<> c=h.promise().continuation;
+
+                        return(c?c:std::noop_coroutine());
+                    }
+
+                    void await_resume()noexcept{}
+                };
+
+                FinalAwaiter final_suspend()noexcept{return{};}
+
+                void unhandled_exception()noexcept{std::terminate();}
+            };//struct PromiseBase
+
+            template<typename T> struct Promise:public PromiseBase
+            {
+                std::optional<T> value;
+
+                CoTask<T> get_return_object();
+
+                template<typename V> void return_value(V &&v){value.emplace(std::forward<V>(v));}
+
+                T GetResult(){return std::move(*value);}
+            };
+
+            template<> struct Promise<void>:public PromiseBase
+            {
+                CoTask<void> get_return_object();
+
+                void return_void(){}
+
+                void GetResult(){}
+            };
+        }//namespace coroutine_detail
+
+        template<typename T> class CoTask
+        {
+        public:
+
+            using promise_type=coroutine_detail::Promise<T>;
+            using Handle=std::coroutine_handle<promise_type>;
+
+        private:
+
+            Handle handle;
+
+        public:
+
+            CoTask():handle(nullptr){}
+            explicit CoTask(Handle h):handle(h){}
+            CoTask(CoTask &&t)noexcept:handle(std::exchange(t.handle,nullptr)){}
+            CoTask(const CoTask &)=delete;
+
+            CoTask &operator=(CoTask &&t)noexcept
+            {
+                if(this!=&t)
+                {
+                    Destroy();
+                    handle=std::exchange(t.handle,nullptr);
+                }
+
+                return *this;
+            }
+
+            CoTask &operator=(const CoTask &)=delete;
+
+            ~CoTask(){Destroy();}
+
+            void Destroy()                                                      ///<销毁协程帧(不能在协程自身之中调用)
+            {
+                if(handle)
+                {
+                    handle.destroy();
+                    handle=nullptr;
+                }
+            }
+
+            const bool IsValid()const{return bool(handle);}
+            const bool IsDone()const{return !handle||handle.done();}            ///<是否已结束(没有任务也视为结束)
+
+            void Start()                                                        ///<作为最外层任务开始执行(执行到第一次挂起时返回)
+            {
+                if(handle&&!handle.done())
+                    handle.resume();
+            }
+
+        public: //co_await
+
+            bool await_ready()const noexcept{return IsDone();}
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> h)noexcept
+            {
+                handle.promise().continuation=h;
+                return handle;                                                  //直接切到子任务
+            }
+
+            T await_resume(){return handle.promise().GetResult();}
+        };//template<typename T> class CoTask
+
+        namespace coroutine_detail
+        {
+            template<typename T> inline CoTask<T> Promise<T>::get_return_object()
+            {
+                return CoTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+            }
+
+            inline CoTask<void> Promise<void>::get_return_object()
+            {
+                return CoTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+            }
+        }//namespace coroutine_detail
+
+        constexpr uint64 HGL_COROUTINE_SEND_HIGH_WATERMARK=HGL_SIZE_1KB*1024;    ///<协程连接缺省的发送队列高水位
+
+        /**
+         * 以协程方式顺序编写协议处理的连接对象<br>
+         * 每个连接一个协程(Run)，只在所属SocketManage的线程中、由它的收包/可写/定时器事件恢复执行，不占用独立线程：
+         * <pre>
+         *  CoTask<> Run() override
+         *  {
+         *      while(true)
+         *      {
+         *          PacketRef pr=co_await ReadPacket();
+         *
+         *          if(pr.IsEmpty())co_return;                  //连接已断开
+         *
+         *          if(!co_await Write(pr.GetData(),pr.GetSize()))
+         *              co_return;
+         *      }
+         *  }
+         * </pre>
+         * 收到的包以PacketRef交出(接收缓冲区使用SetPacketRef模式)，可以保存或转发。协程没有在等待包时不再解析后面的包并暂停接收，
+         * 由TCP流控挡住对方，所以不需要额外的包队列。<br>
+         * Write在发送队列达到高水位时挂起，降到低水位后再发出(缺省高水位HGL_COROUTINE_SEND_HIGH_WATERMARK)。<br>
+         * Sleep使用连接的周期定时器(SetTimer)，协程中不要再另行使用SetTimer/OnTimer。<br>
+         * Run结束(co_return)后连接在本次Update中被移出；连接断开时正在等待的操作以失败返回，协程应随之结束，
+         * 否则在连接被清理(CloseSocket)或复用时直接销毁协程帧。
+         * @param FRAMER 封包格式(PacketFramer)
+         */
+        template<typename FRAMER> class CoroutineFramedAccept:public TCPAcceptFramedPacket<FRAMER>
+        {
+            using Base=TCPAcceptFramedPacket<FRAMER>;
+
+            enum class WaitType
+            {
+                None,
+                Read,
+                Write,
+                Sleep,
+            };
+
+            CoTask<> main_task;                                                 ///<Run返回的最外层任务
+            bool started=false;
+            bool closed=false;                                                  ///<连接已断开
+
+            std::coroutine_handle<> waiter;                                     ///<正在等待事件的协程(同一时间只会有一个)
+            WaitType wait_type=WaitType::None;
+
+            PacketRef recv_packet;                                              ///<已收到还未被ReadPacket取走的包
+            uint recv_type=0;
+
+        private:
+
+            void Wake()
+            {
+                std::coroutine_handle<> h=waiter;
+
+                waiter=nullptr;
+                wait_type=WaitType::None;
+
+                h.resume();                                                     //执行到下一次挂起或结束时返回
+            }
+
+            void Reset()
+            {
+                main_task.Destroy();
+
+                started=false;
+                closed=false;
+                waiter=nullptr;
+                wait_type=WaitType::None;
+                recv_packet.Clear();
+                recv_type=0;
+            }
+
+            void Schedule()                                                     ///<在下一次Update中开始执行协程
+            {
+                if(!started&&this->sock_manage)
+                    this->sock_manage->ScheduleRecv(this);
+            }
+
+            void Start()
+            {
+                started=true;
+
+                if(this->send_high_watermark==0)
+                    this->SetSendWatermark(HGL_COROUTINE_SEND_HIGH_WATERMARK);
+
+                main_task=Run();
+                main_task.Start();
+            }
+
+            void OnPacket(const uint type,const PacketRef &pr)
+            {
+                recv_packet=pr;
+                recv_type=type;
+
+                if(wait_type==WaitType::Read)
+                    Wake();
+                else
+                    this->PauseRecv();                                          //协程还没来取，后面的包留在缓冲区与socket中
+            }
+
+        public: //等待对象
+
+            struct ReadAwaiter
+            {
+                CoroutineFramedAccept *accept;
+                uint *type;
+
+                bool await_ready()const{return accept->closed||!accept->recv_packet.IsEmpty();}
+
+                void await_suspend(std::coroutine_handle<> h)
+                {
+                    accept->waiter=h;
+                    accept->wait_type=WaitType::Read;
+                    accept->ResumeRecv();                                       //暂停期间留下的包在本次Update中继续解析
+                }
+
+                PacketRef await_resume()
+                {
+                    if(type)
+                        *type=accept->recv_type;
+
+                    return std::move(accept->recv_packet);
+                }
+            };//struct ReadAwaiter
+
+            struct WriteAwaiter
+            {
+                CoroutineFramedAccept *accept;
+                uint type;
+                const void *data;
+                uint size;
+
+                bool await_ready()const{return accept->closed||!accept->IsSendQueueFull();}
+
+                void await_suspend(std::coroutine_handle<> h)
+                {
+                    accept->waiter=h;
+                    accept->wait_type=WaitType::Write;
+                }
+
+                bool await_resume()
+                {
+                    if(accept->closed)
+                        return(false);
+
+                    return accept->SendFramedPacket(type,data,size);
+                }
+            };//struct WriteAwaiter
+
+            struct SleepAwaiter
+            {
+                CoroutineFramedAccept *accept;
+                double time;
+
+                bool await_ready()const{return accept->closed||time<=0;}
+
+                void await_suspend(std::coroutine_handle<> h)
+                {
+                    accept->waiter=h;
+                    accept->wait_type=WaitType::Sleep;
+                    accept->SetTimer(time);
+                }
+
+                bool await_resume()const{return !accept->closed;}
+            };//struct SleepAwaiter
+
+        protected: //供协程中co_await使用
+
+            ReadAwaiter ReadPacket(){return ReadAwaiter{this,nullptr};}         ///<等待下一个包(连接断开时返回空的PacketRef)
+            ReadAwaiter ReadPacket(uint &type){return ReadAwaiter{this,&type};} ///<等待下一个包及其类型(封包格式需有类型字段)
+
+            /**
+             * 发出一个包，发送队列达到高水位时先等它降到低水位
+             * @return 是否成功(连接已断开返回false)，data在co_await期间需保持有效
+             */
+            WriteAwaiter Write(const void *data,const uint size){return WriteAwaiter{this,0,data,size};}
+            WriteAwaiter Write(const uint type,const void *data,const uint size)
+            {
+                static_assert(FRAMER::HAS_TYPE,"framer has no type field");
+
+                return WriteAwaiter{this,type,data,size};
+            }
+
+            SleepAwaiter Sleep(const double time){return SleepAwaiter{this,time};}  ///<等待一段时间(秒，连接已断开返回false)
+
+            const bool IsClosed()const{return closed;}                          ///<连接是否已断开
+
+            /**
+             * 连接的协程主体，加入SocketManage(客户端为连接/TLS握手完成)后在其线程中开始执行
+             */
+            virtual CoTask<> Run()=0;
+
+        protected: //TCPAccept事件
+
+            virtual void OnSocketJoin() override
+            {
+                if(!this->connecting&&!this->tls)
+                    Schedule();
+            }
+
+            virtual bool OnTLSReady() override
+            {
+                if(!this->connecting)                                           //客户端在OnConnected中开始
+                    Schedule();
+
+                return(true);
+            }
+
+            virtual bool OnConnected() override
+            {
+                Schedule();
+                return(true);
+            }
+
+            virtual int OnSocketRecv(int size) override
+            {
+                if(!started)
+                    Start();
+
+                if(main_task.IsDone())
+                    return(-1);
+
+                const int result=Base::OnSocketRecv(size);
+
+                return(main_task.IsDone()?-1:result);
+            }
+
+            virtual int OnSocketSend(int size) override
+            {
+                const int result=Base::OnSocketSend(size);
+
+                return(started&&main_task.IsDone()?-1:result);
+            }
+
+            virtual void OnSocketError(int) override
+            {
+                closed=true;
+
+                if(waiter)
+                    Wake();
+            }
+
+            virtual void OnSendQueueDrained() override
+            {
+                if(wait_type==WaitType::Write)
+                    Wake();
+            }
+
+            virtual bool OnTimer() override
+            {
+                if(wait_type==WaitType::Sleep)
+                {
+                    this->SetTimer(0);
+                    Wake();
+                }
+
+                return !(started&&main_task.IsDone());
+            }
+
+            virtual bool OnRecvPacket(const PacketRef &pr) override{OnPacket(0,pr);return(true);}
+            virtual bool OnRecvPacket(const uint type,const PacketRef &pr) override{OnPacket(type,pr);return(true);}
+
+        public:
+
+            CoroutineFramedAccept():Base(){this->packet_ref=true;}
+            CoroutineFramedAccept(int s,const IPAddress *ip):Base(s,ip){this->packet_ref=true;}
+            virtual ~CoroutineFramedAccept()
+            {
+                main_task.Destroy();                                            //先于接收缓冲区等成员销毁协程帧
+            }
+
+            virtual bool UseSocket(int sock,const IPAddress *addr) override
+            {
+                Reset();
+
+                return Base::UseSocket(sock,addr);
+            }
+
+            virtual void CloseSocket() override
+            {
+                Reset();
+
+                Base::CloseSocket();
+            }
+
+            virtual bool SaveHandoffState(DataArray<uchar> &) override{return(false);}    ///<协程帧无法转交给其它进程，热重启时留在旧进程中
+        };//template<typename FRAMER> class CoroutineFramedAccept
+
+        using CoroutineAccept=CoroutineFramedAccept<DefaultPacketFramer>;      ///<使用缺省封包格式的协程连接
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_COROUTINE_ACCEPT_INCLUDE
@@ -0,0 +1,107 @@
+﻿#ifndef HGL_NETWORK_DNS_CACHE_INCLUDE
+#define HGL_NETWORK_DNS_CACHE_INCLUDE
+
+#include<hgl/network/IP.h>
+#include<hgl/thread/ThreadMutex.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 域名解析缓存参数
+         */
+        struct DNSCacheConfig
+        {
+            double  ttl                 =60;                                ///<解析成功的结果保留时间(秒，getaddrinfo不提供记录本身的TTL)
+            double  negative_ttl        =5;                                 ///<解析失败的结果保留时间(秒，期间同一域名直接返回失败)
+            uint    max_entries         =256;                               ///<最多缓存的记录数(满时淘汰最久没用过的)
+
+            double  refresh_ahead       =10;                                ///<后台刷新：到期前多少秒重新解析
+            double  refresh_idle        =300;                               ///<后台刷新：超过这么久没被使用的记录不再刷新，到期后淘汰
+            double  refresh_interval    =1;                                 ///<后台刷新线程检查间隔(秒)
+        };//struct DNSCacheConfig
+
+        class DNSRefreshThread;
+
+        /**
+         * 进程级域名解析缓存(线程安全)<br>
+         * IPv4Address/IPv6Address按域名创建、GetDomainIPList都经过这里，按(协议家族,域名,socket类型,协议)缓存getaddrinfo的结果。
+         * 数字形式的地址不进缓存。同一域名同时未命中时可能各自解析一次，结果以后到的为准。<br>
+         * 开启后台刷新时，最近用过的记录在到期前由刷新线程重新解析，使用者几乎不会遇到阻塞的解析。
+         */
+        class DNSCache
+        {
+            struct Entry
+            {
+                AnsiString name;
+                int family;
+                int socktype;
+                int protocol;
+
+                List<in_addr> ipv4;
+                List<in6_addr> ipv6;
+                bool negative;                                              ///<解析失败的记录
+
+                double expire_time;
+                double last_use_time;
+                bool refreshing;                                            ///<刷新线程正在解析
+            };
+
+            ThreadMutex lock;
+
+            DNSCacheConfig config;
+            bool enable=true;
+
+            List<Entry *> entry_list;
+
+            DNSRefreshThread *refresh_thread=nullptr;
+
+            std::atomic<uint64> hit_count{0};
+            std::atomic<uint64> miss_count{0};
+
+        private:
+
+            friend class DNSRefreshThread;
+
+            Entry *Find(int,const char *,int,int);
+            Entry *Create(int,const char *,int,int,const double);
+
+            template<int FAMILY,typename InAddr> int Lookup(List<InAddr> &,const char *,int,int);
+
+            void Refresh();
+
+        public:
+
+            DNSCache()=default;
+            ~DNSCache();
+
+            void SetConfig(const DNSCacheConfig &);
+            const DNSCacheConfig &GetConfig()const{return config;}
+
+            void SetEnable(bool e){enable=e;}                               ///<关闭后直接调用getaddrinfo
+
+            /**
+             * 解析域名(结果追加到列表中)
+             * @return 地址个数，-1表示出错
+             */
+            int Resolve(List<in_addr> &addr_list,const char *name,int socktype,int protocol);
+            int Resolve(List<in6_addr> &addr_list,const char *name,int socktype,int protocol);
+
+            void Remove(const char *name);                                  ///<删除一个域名的所有记录
+            void Clear();                                                   ///<清空缓存
+
+            bool StartRefresh();                                            ///<开启后台刷新线程
+            void StopRefresh();                                             ///<关闭后台刷新线程
+
+            const uint64 GetHitCount()const{return hit_count.load(std::memory_order_relaxed);}
+            const uint64 GetMissCount()const{return miss_count.load(std::memory_order_relaxed);}
+        };//class DNSCache
+
+        DNSCache *GetDNSCache();                                            ///<取得进程级域名解析缓存
+
+        int GetAddrList(List<in_addr> &addr_list,const char *name,int socktype,int protocol);      ///<直接调用getaddrinfo解析IPv4地址(不经过缓存)
+        int GetAddrList(List<in6_addr> &addr_list,const char *name,int socktype,int protocol);     ///<直接调用getaddrinfo解析IPv6地址(不经过缓存)
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_DNS_CACHE_INCLUDE
@@ -0,0 +1,27 @@
+﻿#ifndef HGL_NETWORK_DATAGRAM_SOCKET_INCLUDE
+#define HGL_NETWORK_DATAGRAM_SOCKET_INCLUDE
+
+#include<hgl/network/Socket.h>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 以消息为单位收发的socket基类(UDP、SCTP)<br>
+         * 可通过SocketManage::JoinDatagram与TCP连接在同一个轮循中处理：可读时反复调用ProcRecv直到返回<=0，每次Update调用一次ProcUpdate
+         */
+        class DatagramSocket:public Socket
+        {
+        public: //事件函数
+
+            virtual int ProcRecv(int=-1){return -1;}                                                ///<可读时调用，返回>0表示还可能有数据，0表示已读完，<0表示出错
+            virtual double ProcUpdate(const double){return -1;}                                     ///<由SocketManage每次Update时调用，返回距离下一次需要调用的时间(秒，<0表示不需要)
+
+        public:
+
+            using Socket::Socket;
+            virtual ~DatagramSocket()=default;
+        };//class DatagramSocket
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_DATAGRAM_SOCKET_INCLUDE
@@ -42,6 +42,8 @@ namespace hgl
 
             double wait_time;                                                                       ///<数据等待时间
 
+            uint recv_buffer_size;                                                                  ///<输入流预读缓冲区大小(0表示不预读，每次读取都直接recv)
+
         public:
 
             DirectSocketIOUserThread(int s,const IPAddress *sa)
@@ -54,6 +56,8 @@ namespace hgl
                 block_send_time=1;
 
                 wait_time=10;
+
+                recv_buffer_size=HGL_SOCKET_INPUT_BUFFER_SIZE;
             }
 
             virtual bool ProcStartThread() override
@@ -62,6 +66,9 @@ namespace hgl
 
                 sis=new SocketInputStream(sock);
                 sos=new SocketOutputStream(sock);
+
+                if(recv_buffer_size>0)
+                    sis->SetBuffer(recv_buffer_size);                   //逐个字段读取时不再每个字段一次recv
                 dis=new DIS(sis);
                 dos=new DOS(sos);
 
@@ -85,6 +92,9 @@ namespace hgl
 
             virtual bool Execute() override
             {
+                if(sis->GetBufferedBytes()>0)                           //数据已经预读到缓冲区中，socket不一定还可读
+                    return Update();
+
                 int wr=s->WaitRecv(wait_time);
 
                 if(wr<0)
@@ -0,0 +1,87 @@
+﻿#ifndef HGL_NETWORK_HTTP_ACCEPT_INCLUDE
+#define HGL_NETWORK_HTTP_ACCEPT_INCLUDE
+
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/HTTPRequest.h>
+namespace hgl
+{
+    namespace network
+    {
+        constexpr uint HGL_HTTP_DEFAULT_MAX_BODY_SIZE   =HGL_SIZE_1MB;                              ///<缺省的请求体最大长度
+        constexpr uint HGL_HTTP_MAX_PIPELINE_REQUESTS   =16;                                        ///<未回应的管线请求达到此数量时暂停接收
+
+        /**
+         * HTTP/1.1服务器接入(与TCPAcceptPacket/WebSocketAccept一样由SocketManage驱动)<br>
+         * 请求在接收缓冲区上原地解析，头、请求体都直接指向缓冲区，不复制，完整的请求(含Content-Length长度的请求体)逐个回调OnRequest。<br>
+         * 支持keep-alive与管线：同一连接上的多个请求按顺序回调，回应也必须按请求的顺序发出(可以在OnRequest中直接回应，也可以之后再回应)，
+         * 未回应的请求过多时暂停接收。回应经TCPAccept的发送队列发出，不会阻塞。<br>
+         * 不支持分块(chunked)上传的请求体，收到时回应501并关闭连接。
+         */
+        class HTTPAccept:public TCPAcceptPacketBase
+        {
+        protected:
+
+            HTTPRequest     request;                                            ///<当前解析的请求
+            uint            max_body_size=HGL_HTTP_DEFAULT_MAX_BODY_SIZE;       ///<请求体最大长度
+
+            uint            head_scan_pos=0;                                    ///<不完整的请求头已查找过的位置
+            uint            request_need=0;                                     ///<不完整的请求共需要的字节数(0表示头还没收完整)
+            bool            continue_sent=false;                                ///<是否已为当前请求发送过100 Continue
+
+            uint64          request_count=0;                                    ///<已回调的请求数
+            uint64          response_count=0;                                   ///<已发出的回应数
+            bool            last_request=false;                                 ///<已收到不保持连接的请求(或出错)，之后的数据全部丢弃
+            bool            pipeline_pause=false;                               ///<因未回应的请求过多而暂停了接收
+
+        protected:
+
+            int  ParsePacket(uchar *,uint) override;
+            uint64 GetPacketNeed(const uchar *,uint)const override{return request_need;}
+
+                    void ProcRequestError(const uint status);                   ///<回应错误并在发出后关闭连接
+                    bool SendResponseData(const uint,const uint64,const char *,const char *,const void *,const uint);
+
+        public:
+
+            using TCPAcceptPacketBase::TCPAcceptPacketBase;
+            virtual ~HTTPAccept()=default;
+
+            virtual bool UseSocket(int,const IPAddress *) override;             ///<使用指定socket(重置请求状态)
+            virtual bool SaveHandoffState(DataArray<uchar> &) override;         ///<热重启时保存状态(还有未回应的请求时不能转交)
+
+            void SetMaxBodySize(const uint size)                                ///<设置请求体最大长度(超出回应413并关闭连接)
+            {
+                max_body_size=size;
+
+                if(uint64(size)+HGL_HTTP_REQUEST_HEAD_MAX_SIZE>max_packet_size) //接收缓冲区要能放下整个请求
+                    max_packet_size=uint(hgl_min<uint64>(uint64(size)+HGL_HTTP_REQUEST_HEAD_MAX_SIZE,0xFFFFFFFFu));
+            }
+
+            const uint64 GetPendingResponseCount()const{return request_count-response_count;}  ///<取得还未回应的请求数
+
+            /**
+             * 收到一个完整的请求<br>
+             * request中的数据都指向接收缓冲区，只在回调期间有效
+             * @return 是否正常，返回false则立即关闭连接
+             */
+            virtual bool OnRequest(const HTTPRequest &)=0;
+
+            /**
+             * 发出最早一个未回应请求的回应头<br>
+             * 之后可以继续用Send/SendShared/SendFile发出content_length字节的回应体，
+             * 如果这是不保持连接的最后一个请求，回应发出后关闭连接(回应体需在同一回调中交给发送队列)
+             * @param status 状态码
+             * @param content_length 回应体长度
+             * @param content_type 回应体类型(可以为nullptr)
+             * @param extra_headers 附加的头(每行以\r\n结尾，可以为nullptr)
+             */
+            bool SendResponseHead(const uint status,const uint64 content_length,const char *content_type=nullptr,const char *extra_headers=nullptr);
+
+            /**
+             * 发出最早一个未回应请求的完整回应，回应头与回应体合并为一次writev
+             */
+            bool SendResponse(const uint status,const void *body,const uint size,const char *content_type=nullptr,const char *extra_headers=nullptr);
+        };//class HTTPAccept:public TCPAcceptPacketBase
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_HTTP_ACCEPT_INCLUDE
@@ -0,0 +1,195 @@
+﻿#ifndef HGL_NETWORK_HTTP_ASYNC_CLIENT_INCLUDE
+#define HGL_NETWORK_HTTP_ASYNC_CLIENT_INCLUDE
+
+#include<hgl/network/MPSCQueue.h>
+#include<hgl/type/BaseString.h>
+#include<hgl/type/List.h>
+#include<hgl/type/DataArray.h>
+#include<hgl/io/OutputStream.h>
+#include<hgl/thread/Thread.h>
+#include<hgl/thread/Semaphore.h>
+#include<hgl/thread/ThreadMutex.h>
+namespace hgl
+{
+    namespace network
+    {
+        namespace http
+        {
+            constexpr uint HGL_HTTP_ASYNC_QUEUE_SIZE=1024;                                          ///<缺省提交队列长度
+
+            /**
+             * 一个异步HTTP/HTTPS请求<br>
+             * 由调用者创建并持有，提交后直到完成(OnFinish调用完毕或Wait返回true)之前不可修改或释放。
+             */
+            class AsyncRequest
+            {
+                friend class AsyncClient;
+
+                Semaphore done_sem;
+                std::atomic<bool> finished{false};
+
+            public:
+
+                UTF8String url;
+                UTF8String user_agent;                                                              ///<可以为空
+
+                const void *post_data=nullptr;                                                      ///<POST数据(nullptr表示GET，数据由调用者保持到请求完成)
+                int post_data_size=0;
+
+                io::OutputStream *os=nullptr;                                                       ///<收到的数据写入此流(nullptr表示保存到response)
+
+                long time_out=30;                                                                   ///<整个请求的超时时间(秒)
+
+            public: //结果
+
+                DataArray<char> response;                                                           ///<收到的数据(os为nullptr时)
+                long response_code=0;                                                               ///<HTTP响应代码
+                int error=0;                                                                        ///<CURLcode，0表示传输成功
+                UTF8String error_info;
+
+            public:
+
+                virtual ~AsyncRequest()=default;
+
+                /**
+                 * 请求完成(在AsyncClient所在线程中调用，不要在这里阻塞或释放自身)
+                 */
+                virtual void OnFinish(){}
+
+                const bool IsFinished()const{return finished.load(std::memory_order_acquire);}
+                const bool IsSucceed()const{return IsFinished()&&error==0&&response_code>=200&&response_code<300;}
+
+                /**
+                 * 等待请求完成
+                 * @param time_out 最长等待时间(秒)，0表示一直等待
+                 */
+                bool Wait(const double time_out=0)
+                {
+                    if(IsFinished())return(true);
+
+                    return done_sem.Acquire(time_out);
+                }
+
+                /**
+                 * 清除上一次的结果，以便再次提交
+                 */
+                void Reset()
+                {
+                    while(done_sem.TryAcquire());                                                   //之前完成时未被Wait取走的信号
+
+                    response.SetCount(0);
+                    response_code=0;
+                    error=0;
+                    error_info.Clear();
+                    finished.store(false,std::memory_order_relaxed);
+                }
+            };//class AsyncRequest
+
+            /**
+             * 异步HTTP客户端参数
+             */
+            struct AsyncClientConfig
+            {
+                uint    max_concurrent          =64;                                                ///<同时进行的传输数量(超过的请求排队)
+                uint    max_host_connections    =6;                                                 ///<每个服务器最多的连接数(0表示不限)
+                uint    max_total_connections   =0;                                                 ///<总连接数上限(0表示不限)
+                uint    easy_cache              =16;                                                ///<缓存的空闲easy句柄数量
+                uint    queue_size              =HGL_HTTP_ASYNC_QUEUE_SIZE;                         ///<跨线程提交队列长度
+                bool    multiplex               =true;                                              ///<HTTP/2时在一个连接上复用多个请求
+                int     poll_time               =100;                                               ///<线程中每次等待事件的最长时间(毫秒)
+            };//struct AsyncClientConfig
+
+            /**
+             * 基于curl multi的异步HTTP客户端<br>
+             * 每个AsyncClient持有一个CURLM，在一个线程中同时驱动所有传输：连接、DNS缓存由同一个CURLM下的请求共用，
+             * 用过的easy句柄reset后复用，不会每个请求重新创建。<br>
+             * 可以作为线程启动(Start)，也可以由使用者在自己的线程中反复调用Update。Submit可在任意线程调用。
+             */
+            class AsyncClient:public Thread
+            {
+                void *multi;                                                                        ///<CURLM
+                void *share;                                                                        ///<CURLSH(不持有，可以为nullptr)
+
+                AsyncClientConfig config;
+
+                MPSCQueue<AsyncRequest *> submit_queue;                                             ///<其它线程提交的请求
+                List<AsyncRequest *> wait_list;                                                     ///<超过并发数，等待开始的请求
+                List<void *> active_list;                                                           ///<正在进行的传输
+                List<void *> easy_pool;                                                             ///<空闲的easy句柄
+
+            private:
+
+                void *AcquireEasy();
+                void ReleaseEasy(void *);
+
+                bool StartRequest(AsyncRequest *);
+                void FinishRequest(AsyncRequest *,int);
+                void ProcSubmit();
+                void ProcDone();
+
+            public:
+
+                /**
+                 * @param cfg 参数
+                 * @param sh 与其它AsyncClient共用的CURLSH(由AsyncClientGroup提供，需已设置好锁)
+                 */
+                AsyncClient(const AsyncClientConfig &cfg=AsyncClientConfig(),void *sh=nullptr);
+                virtual ~AsyncClient();
+
+                const bool IsValid()const{return multi;}
+
+                bool Submit(AsyncRequest *);                                                        ///<提交一个请求(任意线程调用，队列满时返回false)
+
+                /**
+                 * 处理一轮传输(只能在一个线程中调用)
+                 * @param wait_ms 没有事件时最长等待时间(毫秒)，Submit会提前唤醒
+                 * @return 仍在进行及排队的请求数量
+                 */
+                int Update(int wait_ms=0);
+
+                void Cancel();                                                                      ///<中止所有请求(以CURLE_ABORTED_BY_CALLBACK完成，只能在Update所在线程或线程结束后调用)
+
+                const int GetRunningCount()const{return active_list.GetCount();}
+                const int GetWaitCount()const{return wait_list.GetCount();}
+
+            public: //Thread
+
+                bool Execute() override
+                {
+                    Update(config.poll_time);
+                    return(true);
+                }
+
+                void ProcEndThread() override{Cancel();}
+            };//class AsyncClient:public Thread
+
+            /**
+             * 多线程异步HTTP客户端<br>
+             * 每个线程一个AsyncClient(各自一个CURLM)，请求轮流分配给各线程；所有线程共用一个CURLSH，DNS缓存与TLS会话在线程间共享。
+             */
+            class AsyncClientGroup
+            {
+                void *share;                                                                        ///<CURLSH
+                ThreadMutex *share_lock;
+
+                MultiThreadManage<AsyncClient> client_manage;
+                List<AsyncClient *> client_list;
+
+                std::atomic<uint> next_client{0};
+
+            public:
+
+                AsyncClientGroup();
+                ~AsyncClientGroup();
+
+                bool Init(const uint thread_count,const AsyncClientConfig &cfg=AsyncClientConfig());
+                void Close();
+
+                bool Submit(AsyncRequest *);                                                        ///<提交一个请求(任意线程调用)
+
+                const int GetThreadCount()const{return client_list.GetCount();}
+            };//class AsyncClientGroup
+        }//namespace http
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_HTTP_ASYNC_CLIENT_INCLUDE
@@ -0,0 +1,79 @@
+﻿#ifndef HGL_NETWORK_HTTP_CONNECTION_POOL_INCLUDE
+#define HGL_NETWORK_HTTP_CONNECTION_POOL_INCLUDE
+
+#include<hgl/type/List.h>
+#include<hgl/network/IP.h>
+namespace hgl
+{
+    namespace network
+    {
+        class TCPClient;
+
+        /**
+         * HTTP连接池参数
+         */
+        struct HTTPConnectionPoolConfig
+        {
+            uint    max_idle_per_host   =6;                                                         ///<每个服务器最多保留的空闲连接数
+            uint    max_idle_total      =64;                                                        ///<最多保留的空闲连接总数
+            double  idle_time_out       =15;                                                        ///<空闲多久后关闭(秒，应小于服务器的Keep-Alive超时)
+        };//struct HTTPConnectionPoolConfig
+
+        /**
+         * HTTP Keep-Alive连接池<br>
+         * 按服务器地址(IP与端口)保存响应已完整读完的连接，下次访问同一服务器时直接复用，省去TCP握手。<br>
+         * 取出时会检查连接是否已被服务器关闭，空闲超时的连接在每次Acquire/Release时清理。<br>
+         * 连接池不加锁，一个下载线程使用一个连接池。
+         */
+        class HTTPConnectionPool
+        {
+            struct IdleConnection
+            {
+                TCPClient *tcp;
+                double release_time;
+            };
+
+            HTTPConnectionPoolConfig config;
+
+            List<IdleConnection> idle_list;                                                         ///<空闲连接(按放入时间排列，最早的在前)
+
+            uint64 create_count=0;
+            uint64 reuse_count=0;
+
+        private:
+
+            void Remove(int);
+            int  GetHostIdleCount(const IPAddress *)const;
+
+        public:
+
+            HTTPConnectionPool()=default;
+            HTTPConnectionPool(const HTTPConnectionPoolConfig &cfg){config=cfg;}
+            ~HTTPConnectionPool(){Clear();}
+
+            const HTTPConnectionPoolConfig &GetConfig()const{return config;}
+            void SetConfig(const HTTPConnectionPoolConfig &cfg){config=cfg;}
+
+            /**
+             * 取得一个到指定服务器的连接，有可用的空闲连接时复用，否则新建
+             * @param addr 服务器地址
+             * @param reused 返回是否是复用的连接(可为nullptr)
+             * @return 连接(用完后交给Release或直接delete)，nullptr表示连接失败
+             */
+            TCPClient *Acquire(IPAddress *addr,bool *reused=nullptr);
+
+            /**
+             * 归还一个连接(响应必须已完整读完)，超出限制时直接关闭
+             */
+            void Release(TCPClient *);
+
+            void ClearTimeOut();                                                                    ///<关闭空闲超时的连接
+            void Clear();                                                                           ///<关闭所有空闲连接
+
+            const int    GetIdleCount()const{return idle_list.GetCount();}                          ///<取得空闲连接数量
+            const uint64 GetCreateCount()const{return create_count;}                                ///<取得新建连接次数
+            const uint64 GetReuseCount()const{return reuse_count;}                                  ///<取得复用连接次数
+        };//class HTTPConnectionPool
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_HTTP_CONNECTION_POOL_INCLUDE
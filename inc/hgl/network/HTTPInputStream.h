@@ -10,6 +10,7 @@ namespace hgl
     {
         using namespace io;
         class TCPClient;
+        class HTTPConnectionPool;
 
         /**
         * HTTPInputStream流是一个针对HTTP服务器的流式访问类，用它可以从HTTP服务器上下载文件，它从InputStream类派生。<br>
@@ -21,20 +22,44 @@ namespace hgl
 
             InputStream *tcp_is;
 
+            HTTPConnectionPool *pool;           //连接池(为nullptr时每次新建连接)
+            bool keep_alive;                    //服务器是否允许继续使用这个连接
+
         private:
 
             char *http_header;
             uint http_header_size;
 
+            enum class ChunkState
+            {
+                Size,                           //正在读取分块长度行
+                Data,                           //正在读取分块数据
+                DataEnd,                        //分块数据后的CRLF
+                Trailer,                        //最后一个分块之后的尾部字段
+                Finish                          //全部读完
+            };
+
+            bool chunked;                       //是否是分块传输(Transfer-Encoding: chunked)
+            ChunkState chunk_state;
+            int64 chunk_left;                   //当前分块剩余的数据长度(读取长度行时为正在累计的长度)
+            uint chunk_line;                    //长度行中已读的数字个数/尾部字段当前行的长度
+            bool chunk_ext;                     //长度行中已到扩展部分(;之后)
+            uint raw_pos,raw_size;              //分块模式下http_header中尚未解码的原始数据
+
             void ParseHttpResponse();
             int PraseHttpHeader();
 
             int ReturnError();
 
+            bool IsReusable()const;
+
+            int64 ReadChunked(void *,int64);
+
         protected:
 
             int64 pos;
             int64 filelength;
+            int64 total_length;                 //整个资源的长度(206时来自Content-Range，<0表示未知)
 
             uint response_code;                 //HTTP响应代码
             AnsiString response_info;           //HTTP响应信息
@@ -46,13 +71,29 @@ namespace hgl
             HTTPInputStream();
             ~HTTPInputStream();
 
-            bool    Open(IPAddress *,const AnsiString &,const AnsiString &);                        ///<打开一个网址
+            void    SetConnectionPool(HTTPConnectionPool *p){pool=p;}                                ///<设置连接池(之后Open时从中取得连接，响应读完后Close时归还)
+
+            /**
+             * 打开一个网址
+             * @param host_ip 服务器地址
+             * @param host_name 服务器名称(Host)
+             * @param filename 路径及文件名
+             * @param range_start 请求的起始字节(<0表示请求整个文件)
+             * @param range_end 请求的结束字节(含，<0表示到文件结尾)
+             */
+            bool    Open(IPAddress *host_ip,const AnsiString &host_name,const AnsiString &filename,int64 range_start=-1,int64 range_end=-1);
+            bool    Open(InputStream *);                                                            ///<从一个已发出请求的流中读取响应(流由调用者管理，可以是内存流)
             void    Close() override;                                                               ///<
 
             uint                    GetResponseCode()const{return response_code;}                   ///<返回HTTP响应代码
             const AnsiString &      GetResponseInfo()const{return response_info;}                   ///<返回HTTP响应信息
             const AnsiPAttribSet &  GetResponseList()const{return response_list;}                   ///<返回HTTP响应信息列表
 
+            const bool              IsChunked()const{return chunked;}                               ///<是否是分块传输
+            const bool              IsFinished()const;                                              ///<响应体是否已完整读完
+            const int64             GetTotalSize()const{return total_length;}                       ///<取得整个资源的长度(分段请求时与GetSize不同，<0表示未知)
+            const int               GetSocket()const;                                               ///<取得连接的socket(用于等待可读，没有时返回-1)
+
             int64   Read(void *,int64) override;                                                    ///<读取数据
             int64   Peek(void *,int64) override{return 0;}                                          ///<预览数据
             int64   ReadFully(void *buf,int64 buf_size)override{return Read(buf,buf_size);}         ///<充分读取,保证读取到指定长度的数据(不计算超时)
@@ -63,7 +104,7 @@ namespace hgl
             bool    CanPeek()const override{return false;}                                          ///<是否可以预览数据
 
             bool    Restart() override{return false;}                                               ///<复位访问指针
-            int64   Skip(int64) override{return 0;}                                                 ///<跳过指定字节不访问
+            int64   Skip(int64) override;                                                           ///<跳过指定字节不访问(读出后丢弃，非阻塞时可能少于要求)
             int64   Seek(int64,SeekOrigin so=SeekOrigin::Begin) override {return false;}            ///<移动访问指针
             int64   Tell()const override{return pos;}                                               ///<返回当前访问位置
             int64   GetSize()const override{return filelength;}                                     ///<取得流长度
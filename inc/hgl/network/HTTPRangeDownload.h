@@ -0,0 +1,105 @@
+﻿#ifndef HGL_NETWORK_HTTP_RANGE_DOWNLOAD_INCLUDE
+#define HGL_NETWORK_HTTP_RANGE_DOWNLOAD_INCLUDE
+
+#include<hgl/network/HTTPInputStream.h>
+#include<hgl/network/Socket.h>
+#include<hgl/type/List.h>
+#include<hgl/type/DataArray.h>
+#include<hgl/io/OutputStream.h>
+namespace hgl
+{
+    namespace network
+    {
+        class HTTPConnectionPool;
+
+        /**
+         * 分段并行下载参数
+         */
+        struct HTTPRangeDownloadConfig
+        {
+            uint    connection_count    =4;                                                         ///<同时使用的连接数
+            uint64  block_size          =HGL_SIZE_1MB*2;                                            ///<每个分段的长度(内存中最多同时缓存connection_count*2个分段)
+            uint    max_retry           =3;                                                         ///<每个分段出错后最多重试几次(从已收到的位置继续)
+            double  time_out            =HGL_NETWORK_TIME_OUT;                                      ///<所有连接都没有收到数据的最长时间(秒)
+        };//struct HTTPRangeDownloadConfig
+
+        /**
+         * HTTP分段并行下载<br>
+         * 先用第一个分段的Range请求探测资源长度，服务器支持Range(返回206)时把资源按block_size分段，
+         * 通过多个连接(从连接池取得，每段结束后归还再取)同时下载，按顺序写入OutputStream：
+         * 排在最前面的分段收到就写出，后面的分段先缓存，轮到时再写出。<br>
+         * 服务器不支持Range时退化为单连接顺序下载。所有连接在调用线程中以非阻塞方式轮流处理。
+         */
+        class HTTPRangeDownload
+        {
+            struct Block
+            {
+                int64 start;                                                                        ///<在资源中的起始位置
+                int64 size;
+                int64 recv;                                                                         ///<已收到的字节数
+                int64 written;                                                                      ///<已写出的字节数
+                uint  retry;
+
+                DataArray<char> *buffer;                                                            ///<缓存(只有正在下载或等待写出的分段才有)
+            };
+
+            struct Worker
+            {
+                HTTPInputStream stream;
+                int block;                                                                          ///<正在下载的分段(<0表示空闲)
+                bool checked;                                                                       ///<已检查过响应头
+                bool ready;                                                                         ///<上一次WaitRecv时可读
+            };
+
+            HTTPConnectionPool *pool;
+            HTTPRangeDownloadConfig config;
+
+            IPAddress *addr;
+            AnsiString host_name;
+            AnsiString filename;
+            io::OutputStream *os;
+
+            int64 total_size;
+            int64 total_written;
+
+            List<Block> block_list;
+            int next_block;                                                                         ///<下一个要分配的分段
+            int write_block;                                                                        ///<下一个要写出的分段
+
+            List<Worker *> worker_list;
+            List<DataArray<char> *> buffer_pool;
+
+        private:
+
+            DataArray<char> *AllocBuffer(int64);
+            void ReleaseBuffer(Block &);
+
+            bool OpenBlock(Worker *,int);
+            bool RetryBlock(Worker *);
+            int  ProcWorker(Worker *);
+            bool WriteBlocks();
+            int  WaitRecv(double);
+
+            int64 DownloadWhole(Worker *);
+            void Clear();
+
+        public:
+
+            HTTPRangeDownload(HTTPConnectionPool *,const HTTPRangeDownloadConfig &cfg=HTTPRangeDownloadConfig());
+            ~HTTPRangeDownload();
+
+            /**
+             * 下载一个资源
+             * @param os 输出流(按顺序写入)
+             * @param host_ip 服务器地址
+             * @param host_name 服务器名称(Host)
+             * @param filename 路径及文件名
+             * @return 写出的字节数，<0表示失败
+             */
+            int64 Download(io::OutputStream *os,IPAddress *host_ip,const AnsiString &host_name,const AnsiString &filename);
+
+            const int64 GetTotalSize()const{return total_size;}                                     ///<取得资源长度(<0表示未知)
+        };//class HTTPRangeDownload
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_HTTP_RANGE_DOWNLOAD_INCLUDE
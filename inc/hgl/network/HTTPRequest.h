@@ -0,0 +1,98 @@
+﻿#ifndef HGL_NETWORK_HTTP_REQUEST_INCLUDE
+#define HGL_NETWORK_HTTP_REQUEST_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<string.h>
+namespace hgl
+{
+    namespace network
+    {
+        constexpr uint HGL_HTTP_REQUEST_HEAD_MAX_SIZE   =HGL_SIZE_1KB*8;                            ///<HTTP请求头最大长度(含请求行)
+        constexpr uint HGL_HTTP_REQUEST_HEADER_MAX_COUNT=64;                                        ///<HTTP请求头字段最大个数
+        constexpr uint HGL_HTTP_RESPONSE_HEAD_MAX_SIZE  =HGL_SIZE_1KB*2;                            ///<MakeHTTPResponseHead生成的回应头最大长度
+
+        /**
+         * 指向接收缓冲区中的一段字符(不以0结尾，只在回调期间有效)
+         */
+        struct HTTPString
+        {
+            const char *data=nullptr;
+            uint size=0;
+
+            const bool IsEmpty()const{return size==0;}
+
+            bool Equal(const char *str)const                                                        ///<是否与str相同(区分大小写)
+            {
+                return uint(strlen(str))==size&&memcmp(data,str,size)==0;
+            }
+
+            bool EqualNoCase(const char *str)const;                                                 ///<是否与str相同(不区分大小写，str需为小写)
+        };//struct HTTPString
+
+        struct HTTPHeaderField
+        {
+            HTTPString name;
+            HTTPString value;
+        };//struct HTTPHeaderField
+
+        /**
+         * 解析出的HTTP/1.x请求<br>
+         * 所有字符串都直接指向接收缓冲区，不复制，只在回调期间有效
+         */
+        struct HTTPRequest
+        {
+            HTTPString      method;                                                                 ///<请求方法(GET/POST等)
+            HTTPString      target;                                                                 ///<完整的请求目标
+            HTTPString      path;                                                                   ///<target中?之前的部分
+            HTTPString      query;                                                                  ///<target中?之后的部分(不含?)
+            uint            version_minor=1;                                                        ///<HTTP/1.x中的x
+
+            HTTPHeaderField header[HGL_HTTP_REQUEST_HEADER_MAX_COUNT];
+            uint            header_count=0;
+
+            uint            head_size=0;                                                            ///<请求行与头的总长度(含结尾空行)
+            uint64          content_length=0;                                                       ///<Content-Length(没有时为0)
+            bool            keep_alive=true;                                                        ///<回应后是否保持连接
+            bool            upgrade_websocket=false;                                                ///<是否为WebSocket握手请求(Connection: Upgrade且Upgrade: websocket)
+            bool            expect_continue=false;                                                  ///<是否带有Expect: 100-continue
+
+            const char *    body=nullptr;                                                           ///<请求体(content_length字节)
+
+            bool IsMethod(const char *m)const{return method.Equal(m);}
+
+            const HTTPString *GetHeader(const char *lower_name)const;                               ///<取得指定头的值(名称不区分大小写，参数需为小写)
+        };//struct HTTPRequest
+
+        /**
+         * 查找HTTP头结尾的空行(SIMD批量查找换行符)
+         * @param data 数据
+         * @param size 数据长度
+         * @param scan_pos [in,out] 从这里开始查找，没找到时更新为下次可以开始的位置(已查找过的不再重复查找)
+         * @return 含结尾空行的头长度，0表示还没收完整
+         */
+        uint FindHTTPHeadEnd(const char *data,const uint size,uint &scan_pos);
+
+        /**
+         * 解析一个完整的HTTP/1.x请求头(由FindHTTPHeadEnd确定长度)，不处理请求体
+         * @return >0 成功
+         * @return <0 格式错误或不支持，绝对值为应回应的HTTP状态码(400/431/501/505)
+         */
+        int ParseHTTPRequestHead(HTTPRequest &req,const char *data,const uint head_size);
+
+        const char *GetHTTPStatusText(const uint status);                                          ///<取得状态码对应的说明文字
+
+        /**
+         * 生成HTTP回应头(总是带Content-Length)
+         * @param buf 输出缓冲区
+         * @param buf_size 输出缓冲区长度
+         * @param status 状态码
+         * @param content_length 回应体长度
+         * @param content_type 回应体类型(可以为nullptr)
+         * @param keep_alive 是否保持连接(false时写入Connection: close)
+         * @param extra_headers 附加的头(每行以\r\n结尾，可以为nullptr)
+         * @return 回应头长度，0表示buf放不下
+         */
+        uint MakeHTTPResponseHead(char *buf,const uint buf_size,const uint status,const uint64 content_length,const char *content_type,const bool keep_alive,const char *extra_headers);
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_HTTP_REQUEST_INCLUDE
@@ -0,0 +1,105 @@
+﻿#ifndef HGL_NETWORK_HOT_RESTART_INCLUDE
+#define HGL_NETWORK_HOT_RESTART_INCLUDE
+
+#include<hgl/network/Socket.h>
+#include<hgl/type/DataArray.h>
+#include<mutex>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 热重启转交项类型
+         */
+        enum class HandoffType:uint32
+        {
+            Listen=1,                                                           ///<监听socket
+            Connection,                                                         ///<已建立的连接
+            End,                                                                ///<转交结束
+        };//enum class HandoffType
+
+        /**
+         * 收到的一个转交项
+         */
+        struct HandoffItem
+        {
+            HandoffType         type;
+            uint                tag;                                            ///<监听socket为分片序号，连接为原所属SocketManageThread编号
+            int                 sock=-1;                                        ///<socket(所有权归接收者)
+            SocketAddress       address;                                        ///<连接的对方地址
+            DataArray<uchar>    state;                                          ///<连接的收包状态(TCPAccept::SaveHandoffState)
+        };//struct HandoffItem
+
+        /**
+         * 热重启发送端(旧进程)<br>
+         * 在一个Unix socket上等待新进程连接，之后以SCM_RIGHTS逐个把监听socket、连接连同收包状态交给它。<br>
+         * 交出去的socket与新进程中的共用同一个内核对象，旧进程只能直接close，不能shutdown(参见CloseHandoffSocket)；
+         * kTLS的加解密状态保存在内核socket中，随之一并转交，不需要重新握手。<br>
+         * 各SocketManageThread可同时调用SendConnection
+         */
+        class HotRestartSender
+        {
+            int listen_sock=-1;
+            int peer_sock=-1;
+            AnsiString path;
+
+            std::mutex lock;
+            std::atomic<bool> finished{false};
+
+            bool SendItem(HandoffType,uint,int,const SocketAddress *,const void *,uint);
+
+        public:
+
+            ~HotRestartSender(){Close();}
+
+            bool Listen(const char *);                                          ///<在指定路径上建立Unix socket等待新进程连接
+            bool WaitReceiver(const double time_out=HGL_NETWORK_TIME_OUT);      ///<等待新进程连接
+            void Close();
+
+            const bool IsConnected()const{return peer_sock!=-1;}
+            const bool IsFinished()const{return finished.load();}               ///<是否已结束转交(Finish或出错)
+
+            bool SendListen(int sock,const uint tag);                           ///<转交一个监听socket(本进程仍需自行CloseHandoffSocket)
+
+            /**
+             * 转交一个连接
+             * @param sock 连接socket(本进程仍需自行CloseHandoffSocket)
+             * @param tag 所属SocketManageThread编号
+             * @param addr 对方地址
+             * @param state 收包状态
+             * @param size 收包状态字节数
+             */
+            bool SendConnection(int sock,const uint tag,const SocketAddress *addr,const void *state,const uint size);
+
+            bool Finish();                                                      ///<通知新进程转交结束，之后的Send全部失败
+        };//class HotRestartSender
+
+        /**
+         * 热重启接收端(新进程)
+         */
+        class HotRestartReceiver
+        {
+            int sock=-1;
+
+        public:
+
+            ~HotRestartReceiver(){Close();}
+
+            bool Connect(const char *,const double time_out=HGL_NETWORK_TIME_OUT);  ///<连接旧进程的Unix socket
+            void Close();
+
+            const bool IsConnected()const{return sock!=-1;}
+
+            /**
+             * 接收一个转交项(阻塞)
+             * @param time_out 超时时间(秒，<=0表示一直等待)
+             * @return 是否成功，旧进程退出或超时返回false
+             */
+            bool Recv(HandoffItem &,const double time_out=HGL_NETWORK_TIME_OUT);
+        };//class HotRestartReceiver
+
+        void CloseHandoffSocket(int);                                           ///<关闭已转交出去的socket(只close，不shutdown)
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_HOT_RESTART_INCLUDE
@@ -405,6 +405,64 @@ namespace hgl
             bool Comp(const IPAddress *ipa)const override;
         };//class IPv6Address
 
+        /**
+         * 值类型的IP地址(IPv4/IPv6)<br>
+         * 地址直接存放在对象内的sockaddr_storage中，可以作为成员或放在栈上使用，复制时不需要分配内存，
+         * 用于Socket/TCPAccept保存对方地址以及接入流程中传递新连接的地址。<br>
+         * 可视字符串只在第一次调用GetString()时生成，之后缓存在对象内，地址改变时失效。
+         */
+        class SocketAddress final:public IPAddress
+        {
+            sockaddr_storage addr;
+
+            mutable char str[INET6_ADDRSTRLEN+8];                                                           ///<缓存的可视字符串(str[0]==0表示还未生成)
+
+        public:
+
+            SocketAddress(){Clear();}
+            SocketAddress(int _socktype,int _protocol):IPAddress(_socktype,_protocol){Clear();}
+            SocketAddress(const IPAddress *src){Clear();Set(src);}
+
+            void Clear()
+            {
+                hgl_zero(addr);
+                str[0]=0;
+            }
+
+            const bool IsValid()const{return addr.ss_family==AF_INET||addr.ss_family==AF_INET6;}           ///<是否已设置地址
+
+            bool Set(const IPAddress *);                                                                    ///<从另一个地址复制
+
+            const int GetFamily()const override{return addr.ss_family;}
+            const uint GetIPSize()const override{return addr.ss_family==AF_INET6?sizeof(in6_addr):sizeof(in_addr);}
+            const uint GetSockAddrInSize()const override{return addr.ss_family==AF_INET6?sizeof(sockaddr_in6):sizeof(sockaddr_in);}
+            const uint GetIPStringMaxSize()const override{return addr.ss_family==AF_INET6?INET6_ADDRSTRLEN+6:INET_ADDRSTRLEN+6;}
+
+            const bool IsBoradcast()const override{return addr.ss_family==AF_INET&&((const sockaddr_in *)&addr)->sin_addr.s_addr==htonl(INADDR_BROADCAST);}
+
+            bool Set(const char *name,ushort port,int _socktype,int _protocol) override;
+            void Set(ushort port) override;
+            bool Bind(int ThisSocket,int reuse=1)const override;
+            bool GetHostname(AnsiString &)const override;
+
+            sockaddr *GetSockAddr() override{str[0]=0;return (sockaddr *)&addr;}                            ///<调用者可能直接写入(如accept)，所以同时清除缓存的字符串
+            const sockaddr *GetSockAddr()const{return (const sockaddr *)&addr;}
+
+            void *GetIP() override;
+            void GetIP(void *data) override{memcpy(data,GetIP(),GetIPSize());}
+
+            const ushort GetPort()const override;
+
+            void ToString(char *,const int)const override;
+
+            const char *GetString()const;                                                                   ///<取得可视字符串(首次调用时生成，对象内缓存)
+
+            IPAddress *CreateCopy()const override{return(new SocketAddress(*this));}
+            IPAddress *Create()const override{return(new SocketAddress(socktype,protocol));}
+
+            bool Comp(const IPAddress *ipa)const override;
+        };//class SocketAddress
+
         inline IPv4Address *CreateIPv4TCP       (const char *name,ushort port){return(new IPv4Address(name,port,SOCK_STREAM,    IPPROTO_TCP));}
         inline IPv6Address *CreateIPv6TCP       (const char *name,ushort port){return(new IPv6Address(name,port,SOCK_STREAM,    IPPROTO_TCP));}
         inline IPv4Address *CreateIPv4UDP       (const char *name,ushort port){return(new IPv4Address(name,port,SOCK_DGRAM,     IPPROTO_UDP));}
@@ -0,0 +1,105 @@
+﻿#ifndef HGL_NETWORK_MPSC_QUEUE_INCLUDE
+#define HGL_NETWORK_MPSC_QUEUE_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 多生产者单消费者无锁环形队列<br>
+         * 每个格子带一个序号，生产者通过CAS抢占写入位置，写完后更新序号通知消费者；Push可在任意线程调用，Pop只能在一个线程中调用
+         */
+        template<typename T> class MPSCQueue
+        {
+            struct Cell
+            {
+                std::atomic<uint> sequence;
+                T data;
+            };
+
+            Cell *ring;
+            uint capacity;                                                                          ///<容量(2的幂)
+            uint mask;
+
+            alignas(64) std::atomic<uint> tail;                                                     ///<生产者抢占的写入位置
+            alignas(64) uint head;                                                                  ///<消费者读取位置(仅消费者线程访问)
+
+        public:
+
+            MPSCQueue(uint count)
+            {
+                capacity=1;
+
+                while(capacity<count)
+                    capacity<<=1;
+
+                mask=capacity-1;
+                ring=new Cell[capacity];
+
+                for(uint i=0;i<capacity;i++)
+                    ring[i].sequence.store(i,std::memory_order_relaxed);
+
+                head=0;
+                tail.store(0,std::memory_order_relaxed);
+            }
+
+            ~MPSCQueue()
+            {
+                delete[] ring;
+            }
+
+            const uint GetCapacity()const{return capacity;}                                         ///<取得容量
+
+            /**
+             * 压入一个数据(任意线程调用)
+             * @return 队列已满时返回false
+             */
+            bool Push(const T &value)
+            {
+                uint pos=tail.load(std::memory_order_relaxed);
+
+                while(true)
+                {
+                    Cell *cell=ring+(pos&mask);
+
+                    const int diff=int(cell->sequence.load(std::memory_order_acquire)-pos);
+
+                    if(diff==0)                                                                     //格子空闲，抢占它
+                    {
+                        if(tail.compare_exchange_weak(pos,pos+1,std::memory_order_relaxed))
+                        {
+                            cell->data=value;
+                            cell->sequence.store(pos+1,std::memory_order_release);
+                            return(true);
+                        }
+                    }
+                    else
+                    if(diff<0)                                                                      //消费者还没读走，队列已满
+                        return(false);
+                    else
+                        pos=tail.load(std::memory_order_relaxed);                                   //被其它生产者抢先了
+                }
+            }
+
+            /**
+             * 弹出一个数据(消费者线程调用)
+             * @return 队列为空(或下一个格子还在写入中)时返回false
+             */
+            bool Pop(T &value)
+            {
+                Cell *cell=ring+(head&mask);
+
+                if(int(cell->sequence.load(std::memory_order_acquire)-(head+1))<0)
+                    return(false);
+
+                value=cell->data;
+                cell->sequence.store(head+capacity,std::memory_order_release);
+                ++head;
+                return(true);
+            }
+        };//template<typename T> class MPSCQueue
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_MPSC_QUEUE_INCLUDE
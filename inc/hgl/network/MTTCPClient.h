@@ -0,0 +1,578 @@
+﻿#ifndef HGL_NETWORK_MULTI_THREAD_TCP_CLIENT_INCLUDE
+#define HGL_NETWORK_MULTI_THREAD_TCP_CLIENT_INCLUDE
+
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/SocketManageThread.h>
+#include<hgl/Time.h>
+#include<hgl/log/LogInfo.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 多线程TCP客户端(SocketManage/MTTCPServer的主动连接版本)
+         *
+         * TCPConnectPacket:        主动连接的封包收发对象，收发与TCPAcceptPacket完全相同
+         * TCPConnectManageThread:  在一个SocketManage中发起非阻塞连接、收发数据，断线后按退避时间重连
+         * MTTCPClient:             一组TCPConnectManageThread，新连接轮流分配给各线程
+         *
+         * 连接流程:
+         *          1.创建非阻塞socket发起连接，不等待结果，直接加入SocketManage并关注可写事件
+         *          2.第一次可写时由TCPAccept::OnSocketSend取得连接结果，成功则调用OnConnected，并发出连接期间存入队列的数据
+         *            (在OnPrepareConnect中StartTLS的连接先完成TLS握手再调用OnConnected)
+         *          3.连接失败、超时或断线后，对象从SocketManage分离，调用OnDisconnected决定是否重连
+         *          4.重连等待时间从min_delay开始每次连续失败乘以factor，最长max_delay，连接成功一次后重新计算
+         */
+
+        /**
+         * 连接与重连参数
+         */
+        struct ReconnectConfig
+        {
+            double  connect_time_out    =10;                                ///<单次连接超时时间(秒，<=0表示由系统决定)
+            bool    reconnect           =true;                              ///<连接失败或断线后自动重连
+            double  min_delay           =0.5;                               ///<第一次重连前的等待时间(秒)
+            double  max_delay           =30;                                ///<最长等待时间(秒)
+            double  factor              =2;                                 ///<每次连续失败后等待时间的倍数
+            double  jitter              =0.2;                               ///<等待时间随机减少的最大比例(0-1)，避免大量连接同时重连
+            uint    max_retry           =0;                                 ///<连续失败最大次数(0表示不限)
+            bool    no_delay            =true;                              ///<设置TCP_NODELAY
+        };//struct ReconnectConfig
+
+        template<typename> class TCPConnectManageThread;
+        template<typename,typename> class MTTCPClient;
+
+        /**
+         * 主动连接的TCP封包收发对象<br>
+         * 对象由所属的TCPConnectManageThread持有，不再重连时由它释放。
+         * 重连期间对象保持不变，但socket与连接句柄会改变，发送队列中未发完的数据会被丢弃。
+         */
+        class TCPConnectPacket:public TCPAcceptPacket
+        {
+        protected:
+
+            template<typename> friend class TCPConnectManageThread;
+            template<typename,typename> friend class MTTCPClient;
+
+            IPAddress *     target=nullptr;                                 ///<连接目标
+            ReconnectConfig reconnect_config;
+
+            TimerNode       connect_timer;                                  ///<连接超时/重连等待定时器(由TCPConnectManageThread的时间轮驱动)
+            uint            retry_count=0;                                  ///<连续失败次数
+            bool            closing=false;                                  ///<已要求关闭，不再重连
+
+            int             owner_index=-1;                                 ///<在所属线程连接列表中的位置
+            int             thread_index=-1;                                ///<所属线程在MTTCPClient中的序号
+
+                    double  GetRetryDelay();                                ///<计算下一次重连前的等待时间
+
+        protected:
+
+            /**
+             * 连接失败、超时或断线(在所属线程中调用，socket已关闭)
+             * @param established 是否是已经建立的连接断开
+             * @return 是否重连，返回false则对象被释放
+             */
+            virtual bool OnDisconnected(bool established){return(true);}
+
+            /**
+             * socket已创建、即将加入SocketManage(在所属线程中调用)，需要TLS时在这里调用StartTLS
+             * @return 是否继续，返回false则视为本次连接失败
+             */
+            virtual bool OnPrepareConnect(){return(true);}
+
+            virtual void OnSocketError(int) override{}
+
+        public:
+
+            TCPConnectPacket()=default;
+            TCPConnectPacket(int sock,const IPAddress *addr):TCPAcceptPacket(sock,addr){}
+            virtual ~TCPConnectPacket();
+
+                    bool SetTarget(const IPAddress *);                      ///<设置连接目标(连接开始前调用)
+            const   IPAddress *GetTarget()const{return target;}             ///<取得连接目标
+
+                    void SetReconnectConfig(const ReconnectConfig &rc){reconnect_config=rc;}    ///<设置重连参数(连接开始前调用)
+            const   ReconnectConfig &GetReconnectConfig()const{return reconnect_config;}
+
+                    void StopReconnect(){closing=true;}                     ///<不再重连(本线程中调用，当前连接断开后对象即被释放)
+
+            const   bool IsConnected()const{return sock_manage&&!connecting;}  ///<是否已连接
+            const   uint GetRetryCount()const{return retry_count;}          ///<取得连续失败次数
+
+            virtual bool SendPacket(void *,const PACKET_SIZE_TYPE &) override;   ///<发包(等待重连期间返回false)
+            using TCPAcceptPacket::SendShared;
+            virtual bool SendShared(SharedBuffer *,const uint,const uint) override;    ///<发送共享数据块(等待重连期间返回false)
+        };//class TCPConnectPacket:public TCPAcceptPacket
+
+        /**
+         * 主动连接管理线程<br>
+         * 在SocketManageThread之上增加连接发起、连接超时与重连，其它线程通过ConnectBegin/ConnectEnd、CloseBegin/CloseEnd转交请求。
+         * 本线程持有所有转交进来的USER_CONNECT对象，线程结束时全部释放。
+         */
+        template<typename USER_CONNECT> class TCPConnectManageThread:public SocketManageThread<USER_CONNECT>
+        {
+            using BaseThread=SocketManageThread<USER_CONNECT>;
+
+        public:
+
+            using ConnectList=List<USER_CONNECT *>;
+
+        protected:
+
+            using BaseThread::sock_manage;
+            using BaseThread::wait_time;
+
+            SemSwapData<ConnectList> connect_list;                          ///<其它线程提交的新连接
+            SemSwapData<ConnectList> close_list;                            ///<其它线程提交的关闭请求
+
+            ConnectList owner_list;                                         ///<本线程持有的所有连接对象
+
+            TimerWheel connect_timer_wheel;                                 ///<连接超时与重连等待
+            TimerNodeList timer_expired_list;
+
+            double max_wait_time=HGL_SOCKET_MANAGE_WAIT_TIME;               ///<Update最长等待时间
+
+        protected:
+
+            /**
+             * 释放一个不再使用的连接对象
+             */
+            void OnSocketClear(USER_CONNECT *us) override
+            {
+                connect_timer_wheel.Remove(&us->connect_timer);
+
+                const int index=us->owner_index;
+
+                if(index>=0&&index<owner_list.GetCount()&&owner_list.GetData()[index]==us)
+                {
+                    owner_list.Delete(index);                               //与最后一项交换
+
+                    if(index<owner_list.GetCount())
+                        owner_list.GetData()[index]->owner_index=index;
+                }
+
+                us->owner_index=-1;
+                us->CloseSocket();
+                delete us;
+            }
+
+            USER_CONNECT *CreateUserAccept(int,const IPAddress *) override{return(nullptr);}    ///<不接入连接
+
+            /**
+             * 连接失败/超时/断线，对象已不在SocketManage中
+             */
+            void OnSocketError(USER_CONNECT *us) override
+            {
+                const bool established=!us->connecting;
+
+                us->connecting=false;
+
+                OnConnectLost(us,established);
+            }
+
+            /**
+             * 关闭socket，按重连设置等待重连或释放对象
+             */
+            void OnConnectLost(USER_CONNECT *us,const bool established)
+            {
+                us->CloseSocket();
+
+                if(established)
+                    us->retry_count=0;
+                else
+                    ++us->retry_count;
+
+                if(!us->OnDisconnected(established)||us->closing)
+                {
+                    OnSocketClear(us);
+                    return;
+                }
+
+                const ReconnectConfig &rc=us->reconnect_config;
+
+                if(!rc.reconnect
+                 ||(rc.max_retry>0&&us->retry_count>=rc.max_retry))
+                {
+                    OnSocketClear(us);
+                    return;
+                }
+
+                connect_timer_wheel.Add(&us->connect_timer,GetDoubleTime()+us->GetRetryDelay());
+            }
+
+            /**
+             * 创建socket并发起非阻塞连接，直接加入SocketManage，连接结果在第一次可写时取得
+             */
+            bool StartConnect(USER_CONNECT *us)
+            {
+                const IPAddress *addr=us->target;
+                const ReconnectConfig &rc=us->reconnect_config;
+
+                const int sock=CreateSocket(addr);
+
+                if(sock<0)
+                    return(false);
+
+#if HGL_OS == HGL_OS_Windows
+                if(!Connect(sock,(IPAddress *)addr,rc.connect_time_out))   //IOCP不能关注未完成连接的可写事件，限时阻塞连接
+                {
+                    CloseSocket(sock);
+                    return(false);
+                }
+
+                SetSocketNonBlock(sock,true);
+#else
+                SetSocketNonBlock(sock,true);
+
+                if(network::StartConnect(sock,(IPAddress *)addr)<0)
+                {
+                    CloseSocket(sock);
+                    return(false);
+                }
+#endif//HGL_OS == HGL_OS_Windows
+
+                if(!us->UseSocket(sock,addr))
+                {
+                    CloseSocket(sock);
+                    return(false);
+                }
+
+                if(rc.no_delay)
+                    us->SetNodelay(true);
+
+                if(!us->OnPrepareConnect())
+                {
+                    us->CloseSocket();
+                    return(false);
+                }
+
+                us->connecting=true;                                        //已连接上的也一样，加入后马上就会可写
+
+                if(!sock_manage->Join(us))
+                {
+                    us->connecting=false;
+                    us->CloseSocket();
+                    return(false);
+                }
+
+                if(rc.connect_time_out>0)
+                    connect_timer_wheel.Add(&us->connect_timer,GetDoubleTime()+rc.connect_time_out);
+
+                return(true);
+            }
+
+            void TryConnect(USER_CONNECT *us)
+            {
+                if(!StartConnect(us))
+                    OnConnectLost(us,false);
+            }
+
+            /**
+             * 处理其它线程提交的新连接
+             */
+            void ProcConnectList()
+            {
+                ConnectList &cl=connect_list.GetReceive();
+
+                for(USER_CONNECT *us:cl)
+                {
+                    us->owner_index=owner_list.GetCount();
+                    us->retry_count=0;
+                    us->closing=false;
+                    us->connect_timer.owner=us;
+
+                    owner_list.Add(us);
+
+                    TryConnect(us);
+                }
+
+                cl.Clear();
+            }
+
+            /**
+             * 处理其它线程提交的关闭请求
+             */
+            void ProcCloseList()
+            {
+                ConnectList &cl=close_list.GetReceive();
+
+                for(USER_CONNECT *us:cl)
+                {
+                    if(us->GetSocketManage()==sock_manage)
+                        sock_manage->Unjoin(us);
+
+                    OnSocketClear(us);
+                }
+
+                cl.Clear();
+            }
+
+            /**
+             * 处理到期的连接超时与重连定时器
+             */
+            void ProcConnectTimer()
+            {
+                if(connect_timer_wheel.GetCount()<=0)return;
+
+                timer_expired_list.Clear();
+
+                const int count=connect_timer_wheel.Update(GetDoubleTime(),timer_expired_list);
+
+                TimerNode **tp=timer_expired_list.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    USER_CONNECT *us=(USER_CONNECT *)((*tp)->owner);
+
+                    ++tp;
+
+                    if(us->GetSocketManage()!=sock_manage)                  //等待重连
+                    {
+                        TryConnect(us);
+                        continue;
+                    }
+
+                    if(!us->connecting&&!us->IsTLSHandshaking())            //已连接成功(TLS握手也计入连接超时)
+                        continue;
+
+                    LOG_INFO(OS_TEXT("Connect timeout,sock:")+OSString::numberOf(us->ThisSocket));
+
+                    sock_manage->Unjoin(us);
+                    OnSocketError(us);
+                }
+
+                timer_expired_list.Clear();
+            }
+
+            template<typename ST>
+            void DeleteConnectList(ST &cl)
+            {
+                for(USER_CONNECT *us:cl)
+                    delete us;
+
+                cl.Clear();
+            }
+
+        public:
+
+            TCPConnectManageThread(SocketManage *sm):BaseThread(sm)
+            {
+                connect_timer_wheel.Start(GetDoubleTime());
+            }
+
+            virtual ~TCPConnectManageThread()=default;
+
+            void SetWaitTime(const double t){max_wait_time=t;}              ///<设置Update最长等待时间(有定时器将要到期时会等待更短的时间)
+
+            void ProcEndThread() override
+            {
+                BaseThread::ProcEndThread();                                //已加入SocketManage的连接在这里被分离
+
+                DeleteConnectList(connect_list.GetReceive());
+                connect_list.Swap();
+                DeleteConnectList(connect_list.GetReceive());
+
+                close_list.GetReceive().Clear();                            //对象都在owner_list中
+                close_list.Swap();
+                close_list.GetReceive().Clear();
+
+                for(USER_CONNECT *us:owner_list)
+                {
+                    us->CloseSocket();
+                    delete us;
+                }
+
+                owner_list.Clear();
+            }
+
+            bool Execute() override
+            {
+                if(connect_list.TrySemSwap())
+                    ProcConnectList();
+
+                if(close_list.TrySemSwap())
+                    ProcCloseList();
+
+                ProcConnectTimer();
+
+                const double next=connect_timer_wheel.GetNextTimeOut(GetDoubleTime());
+
+                if(next>=0&&(max_wait_time<0||next<max_wait_time))
+                    wait_time=next;
+                else
+                    wait_time=max_wait_time;
+
+                return BaseThread::Execute();
+            }
+
+        public:
+
+            /**
+             * 开始提交新连接(任意线程调用)，对象需已设置连接目标，提交后所有权转交本线程
+             */
+            virtual ConnectList &   ConnectBegin(){return connect_list.GetPost();}
+            virtual void            ConnectEnd()                            ///<结束提交新连接
+            {
+                connect_list.ReleasePost();
+                connect_list.PostSem();
+                sock_manage->Wake();
+            }
+
+            /**
+             * 开始提交关闭请求(任意线程调用)<br>
+             * 对象在不再重连时就会被本线程释放，所以只能关闭确定还存在的对象(如OnDisconnected总是返回true的连接)，且同一对象只能关闭一次
+             */
+            virtual ConnectList &   CloseBegin(){return close_list.GetPost();}
+            virtual void            CloseEnd()                              ///<结束提交关闭请求
+            {
+                close_list.ReleasePost();
+                close_list.PostSem();
+                sock_manage->Wake();
+            }
+        };//template<typename USER_CONNECT> class TCPConnectManageThread
+
+        /**
+         * 多线程TCP客户端<br>
+         * 大量主动连接由少数几个线程轮循处理，不再为每个连接创建收发线程
+         */
+        template<typename USER_CONNECT,typename CONNECT_MANAGE_THREAD=TCPConnectManageThread<USER_CONNECT>> class MTTCPClient
+        {
+        protected:
+
+            MultiThreadManage<CONNECT_MANAGE_THREAD> sock_manage;
+
+            int sock_thread_count=0;
+            std::atomic<uint> next_thread{0};
+
+        protected:
+
+            virtual CONNECT_MANAGE_THREAD *CreateConnectManageThread(int max_connect)
+            {
+                SocketManage *sm=new SocketManage(max_connect);
+
+                return(new CONNECT_MANAGE_THREAD(sm));
+            }
+
+        public:
+
+            /**
+             * 客户端初始化信息结构
+             */
+            struct InitInfomation
+            {
+                uint        max_connect         =1024;                  ///<每个线程最大连接数量
+                uint        thread_count        =4;                     ///<线程数量
+                double      idle_time_out       =0;                     ///<缺省接收超时时间(秒，<=0表示不检测)
+                bool        defer_send          =false;                 ///<延迟发送模式(一次循环中发给同一连接的包合并为一次writev)
+
+                bool        cpu_affinity        =false;                 ///<将第N个线程绑定到一个CPU
+                const int * cpu_list            =nullptr;               ///<绑定使用的CPU(thread_count个，nullptr表示第N个CPU)
+            };//struct InitInfomation
+
+        public:
+
+            virtual ~MTTCPClient()
+            {
+                Close();
+            }
+
+            bool Init(const InitInfomation &info)
+            {
+                if(sock_thread_count>0)return(false);
+                if(info.max_connect<=0)return(false);
+                if(info.thread_count<=0)return(false);
+
+                for(uint i=0;i<info.thread_count;i++)
+                {
+                    CONNECT_MANAGE_THREAD *smt=CreateConnectManageThread(info.max_connect);
+
+                    if(!smt)
+                        return(false);
+
+                    if(info.cpu_affinity)
+                        smt->SetCPU(info.cpu_list?info.cpu_list[i]:int(i%GetCPUCount()));
+
+                    smt->SetOwnerID(i);
+                    smt->SetIdleTimeOut(info.idle_time_out);
+                    smt->SetDeferSend(info.defer_send);
+
+                    sock_manage.Add(smt);
+                }
+
+                if(!sock_manage.Start())
+                    return(false);
+
+                sock_thread_count=info.thread_count;
+                return(true);
+            }
+
+            void Close()
+            {
+                sock_manage.Close();
+                sock_thread_count=0;
+            }
+
+            const int GetThreadCount()const{return sock_thread_count;}
+            CONNECT_MANAGE_THREAD *GetThread(const int index){return sock_manage.GetThread(index);}
+
+            /**
+             * 提交一个连接(任意线程调用)，对象需已设置连接目标，提交后所有权转交所属线程
+             * @return 是否提交成功(失败时对象仍由调用者持有)
+             */
+            bool Connect(USER_CONNECT *us)
+            {
+                if(!us||!us->GetTarget())return(false);
+                if(sock_thread_count<=0)return(false);
+
+                const int index=int(next_thread.fetch_add(1,std::memory_order_relaxed)%sock_thread_count);
+
+                CONNECT_MANAGE_THREAD *smt=sock_manage.GetThread(index);
+
+                us->thread_index=index;
+
+                smt->ConnectBegin().Add(us);
+                smt->ConnectEnd();
+                return(true);
+            }
+
+            /**
+             * 创建并提交一个连接
+             * @param addr 连接目标
+             * @param rc 连接与重连参数
+             * @return 连接对象(由所属线程持有)
+             */
+            USER_CONNECT *Connect(const IPAddress *addr,const ReconnectConfig &rc=ReconnectConfig())
+            {
+                if(!addr)return(nullptr);
+
+                USER_CONNECT *us=new USER_CONNECT();
+
+                us->SetReconnectConfig(rc);
+
+                if(!us->SetTarget(addr)||!Connect(us))
+                {
+                    delete us;
+                    return(nullptr);
+                }
+
+                return us;
+            }
+
+            /**
+             * 关闭一个连接，不再重连(任意线程调用，对象需确定还存在，参见TCPConnectManageThread::CloseBegin)
+             */
+            void Close(USER_CONNECT *us)
+            {
+                if(!us||us->thread_index<0||us->thread_index>=sock_thread_count)return;
+
+                CONNECT_MANAGE_THREAD *smt=sock_manage.GetThread(us->thread_index);
+
+                smt->CloseBegin().Add(us);
+                smt->CloseEnd();
+            }
+        };//template<typename USER_CONNECT,typename CONNECT_MANAGE_THREAD> class MTTCPClient
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_MULTI_THREAD_TCP_CLIENT_INCLUDE
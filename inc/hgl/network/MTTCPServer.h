@@ -5,6 +5,7 @@
 #include<hgl/network/TCPServer.h>
 #include<hgl/network/MultiThreadAccept.h>
 #include<hgl/network/SocketManageThread.h>
+#include<hgl/network/HotRestart.h>
 #include<hgl/Time.h>
 
 namespace hgl
@@ -20,30 +21,34 @@ namespace hgl
 
             class Accept2SocketManageThread:public AcceptThread
             {
-                SOCKET_MANAGE_THREAD *sm_thread;
+                MTTCPServer *mt_server=nullptr;
+                int index=0;
 
             public:
 
                 using AcceptThread::AcceptThread;
 
-                void SetSocketManage(SOCKET_MANAGE_THREAD *smt)
+                void SetServer(MTTCPServer *mts,const int i)
                 {
-                    sm_thread=smt;
+                    mt_server=mts;
+                    index=i;
                 }
 
-                bool OnAccept(int client_sock,IPAddress *ip_address) override
+                bool OnAccept(int client_sock,const SocketAddress &ip_address) override
                 {
-                    if(!sm_thread)return(false);
+                    if(!mt_server)return(false);
 
-                    USER_ACCEPT *us;
+                    SOCKET_MANAGE_THREAD *sm_thread=mt_server->SelectSocketManageThread(index);
 
-                    us=new USER_ACCEPT(client_sock,ip_address);      //这个new非常占时间，未来放到各自的线程去做
+                    if(!sm_thread)return(false);
 
-                    auto &sl=sm_thread->JoinBegin();
+                    AcceptedSocket as;                                  //USER_ACCEPT由SocketManageThread在自己的线程中从对象池取得
 
-                    sl.Add(us);
+                    as.sock=client_sock;
+                    as.address=ip_address;                          //值复制，不分配内存
 
-                    sm_thread->JoinEnd();
+                    sm_thread->AcceptBegin().Add(as);
+                    sm_thread->AcceptEnd();
 
                     return(true);
                 }
@@ -57,6 +62,27 @@ namespace hgl
             MultiThreadAccept<Accept2SocketManageThread>    accept_manage;
             MultiThreadManage<SOCKET_MANAGE_THREAD>         sock_manage;
 
+            List<TCPServer *>                               shard_server_list;              ///<分片模式下每个SocketManageThread独占的监听Server
+
+            int                                             sock_thread_count=0;            ///<SocketManageThread数量
+
+            SocketManagePlacement                           placement;                      ///<新连接分配器
+
+        protected:
+
+            /**
+             * 为接入线程接入的新连接选择一个SocketManageThread(多个接入线程同时调用)
+             * @param accept_index 接入线程序号
+             */
+            SOCKET_MANAGE_THREAD *SelectSocketManageThread(const int accept_index)
+            {
+                const int index=placement.Select(accept_index);
+
+                if(index<0)return(nullptr);
+
+                return sock_manage.GetThread(index);
+            }
+
         protected:
 
             virtual SOCKET_MANAGE_THREAD *CreateSocketManageThread(int max_user)
@@ -83,15 +109,253 @@ namespace hgl
 
                 uint        max_user            =1024;                  ///<最大用户数量
                 uint        thread_count        =4;                     ///<线程数量
+
+                bool        reuse_port_shard    =false;                 ///<分片模式：每个SocketManageThread使用独立的SO_REUSEPORT监听socket，自行接入，不再使用接入线程
+                bool        incoming_cpu        =false;                 ///<分片模式下，第N个监听socket设置SO_INCOMING_CPU为第N个线程的CPU(仅Linux)
+
+                bool        cpu_affinity        =false;                 ///<将第N个SocketManageThread及对应的接入线程绑定到一个CPU
+                const int * cpu_list            =nullptr;               ///<绑定使用的CPU(thread_count个，nullptr表示第N个CPU)，建议与网卡接收队列(RSS)中断所在CPU一一对应
+                bool        numa_local          =true;                  ///<绑定CPU时，SocketManage的缓冲区池与事件数组在该CPU所在NUMA节点分配
+
+                bool        defer_send          =false;                 ///<延迟发送模式：一次循环中发给同一连接的包合并为一次writev(适合每帧发很多小包的游戏服务器)
+
+                uint        busy_poll_thread_count=0;                   ///<前N个SocketManageThread使用忙轮循模式(每个会占满一个CPU，建议同时开启cpu_affinity)
+                SocketBusyPollConfig busy_poll;                         ///<忙轮循参数
+
+                double      tcp_info_interval   =0;                     ///<每个连接TCP_INFO(RTT、拥塞窗口、重传)采样间隔，单位:秒(<=0表示不采样，见SocketManage::SetTCPInfoInterval)
+                bool        latency_trace       =false;                 ///<延迟跟踪模式：记录内核接收时间戳，统计每个包的排队与回复耗时(见SocketManage::SetLatencyTrace)
+                TrafficCapture *traffic_capture =nullptr;               ///<流量录制：记录每个连接收到的包/消息，供TrafficReplay重放(需已Create，且在服务器释放之后才能销毁)
+
+                SocketPlacementPolicy placement =SocketPlacementPolicy::Fixed;  ///<新连接分配策略(分片模式下由内核按SO_REUSEPORT分配，不使用)
+
+                HotRestartReceiver *hot_restart =nullptr;               ///<热重启：已连接到旧进程的接收端，监听socket使用旧进程转交的，Init会一直接收旧进程转交的连接直到转交结束
+                double      hot_restart_time_out=30;                    ///<热重启时等待旧进程每个转交项的超时时间,单位:秒
             };//struct MTTCPServerInitInfomation
 
+        protected:
+
+            /**
+             * 取得第N个线程绑定的CPU
+             * @return <0 不绑定
+             */
+            int GetThreadCPU(const InitInfomation &info,const uint index)const
+            {
+                if(!info.cpu_affinity)return(-1);
+
+                if(info.cpu_list)
+                    return info.cpu_list[index];
+
+                return int(index%GetCPUCount());
+            }
+
+            /**
+             * 创建一个SocketManageThread，并让它的内存分配在目标CPU所在的NUMA节点<br>
+             * SocketManage是在当前线程中创建的，所以临时把当前线程的内存节点切过去，创建完成后恢复缺省
+             */
+            SOCKET_MANAGE_THREAD *CreateLocalSocketManageThread(const InitInfomation &info,const uint index,const int cpu)
+            {
+                const int node=(cpu>=0&&info.numa_local)?GetCPUNumaNode(cpu):-1;
+
+                const bool local=(node>=0&&SetThreadMemoryNode(node));
+
+                SOCKET_MANAGE_THREAD *smt=CreateSocketManageThread(info.max_user);
+
+                if(local)
+                    SetThreadMemoryNode(-1);
+
+                if(smt&&cpu>=0)
+                    smt->SetCPU(cpu,node);
+
+                if(smt)
+                {
+                    smt->SetDeferSend(info.defer_send);
+                    smt->SetLatencyTrace(info.latency_trace);
+                    smt->SetTrafficCapture(info.traffic_capture);
+                    smt->SetTCPInfoInterval(info.tcp_info_interval);
+
+                    if(index<info.busy_poll_thread_count)
+                        smt->SetBusyPoll(info.busy_poll);
+                }
+
+                return smt;
+            }
+
+            /**
+             * 热重启时接收旧进程转交的监听socket
+             * @param listen_list 收到的监听socket
+             * @param item 第一个不是监听socket的转交项
+             * @return 是否收到了item
+             */
+            bool RecvHandoffListen(const InitInfomation &info,List<int> &listen_list,HandoffItem &item)
+            {
+                if(!info.hot_restart)
+                    return(false);
+
+                while(info.hot_restart->Recv(item,info.hot_restart_time_out))
+                {
+                    if(item.type!=HandoffType::Listen)
+                        return(true);
+
+                    listen_list.Add(item.sock);
+                }
+
+                return(false);
+            }
+
+            /**
+             * 使用旧进程转交的第index个监听socket，没有则新建
+             */
+            bool CreateOrAttachServer(TCPServer *s,List<int> &listen_list,const uint index,const InitInfomation &info,const uint max_listen,const bool reuse_port)
+            {
+                if(int(index)<listen_list.GetCount())
+                {
+                    int &sock=listen_list.GetData()[index];
+
+                    const bool result=s->AttachServer(sock,info.server_ip);
+
+                    sock=-1;
+                    return result;
+                }
+
+                return s->CreateServer(info.server_ip,max_listen,info.port_reuse,reuse_port);
+            }
+
+            void CloseHandoffListen(List<int> &listen_list)
+            {
+                for(int sock:listen_list)
+                    CloseHandoffSocket(sock);                           //多余的(旧进程的分片数量更多)，新进程中不再使用
+
+                listen_list.Clear();
+            }
+
+            /**
+             * 热重启时接收旧进程转交的连接，按原来所属的线程编号分配，直到旧进程转交结束
+             * @return 加入的连接数量
+             */
+            int RecvHandoffConnection(const InitInfomation &info,HandoffItem &item,bool has_item)
+            {
+                int count=0;
+
+                while(has_item)
+                {
+                    if(item.type==HandoffType::End)
+                        break;
+
+                    if(item.type==HandoffType::Connection)
+                    {
+                        if(sock_manage.GetThread(item.tag%sock_thread_count)->JoinHandoff(item))
+                            ++count;
+                    }
+                    else
+                    {
+                        CloseHandoffSocket(item.sock);
+                    }
+
+                    has_item=info.hot_restart->Recv(item,info.hot_restart_time_out);
+                }
+
+                info.hot_restart->Close();
+                return count;
+            }
+
+            /**
+             * 分片模式初始化，每个SocketManageThread一个SO_REUSEPORT监听socket
+             */
+            bool InitShard(InitInfomation &info)
+            {
+                List<int> listen_list;
+                HandoffItem item;
+
+                const bool has_item=RecvHandoffListen(info,listen_list,item);
+
+                for(uint i=0;i<info.thread_count;i++)
+                {
+                    TCPServer *shard=new TCPServer;
+
+                    shard_server_list.Add(shard);
+
+                    if(!CreateOrAttachServer(shard,listen_list,i,info,HGL_SERVER_LISTEN_COUNT,true))
+                    {
+                        CloseHandoffListen(listen_list);
+                        return(false);
+                    }
+
+                    if(info.server_ip->GetFamily()==AF_INET6)
+                        shard->SetIPv6Only(info.ipv6_only);
+
+
+#if HGL_OS != HGL_OS_Windows
+                    shard->SetDeferAccept(info.defer_accept_time);
+#endif
+
+                    const int cpu=GetThreadCPU(info,i);
+
+#if HGL_OS == HGL_OS_Linux
+                    if(info.incoming_cpu)
+                        shard->SetIncomingCPU(cpu>=0?cpu:i);
+#endif//HGL_OS == HGL_OS_Linux
+
+                    SOCKET_MANAGE_THREAD *smt=CreateLocalSocketManageThread(info,i,cpu);
+
+                    smt->SetOwnerID(i);
+                    sock_manage.Add(smt);
+
+                    if(!smt->SetAcceptServer(shard))                    //监听socket加入该线程的SocketManage，由轮循驱动接入
+                    {
+                        CloseHandoffListen(listen_list);
+                        return(false);
+                    }
+                }
+
+                CloseHandoffListen(listen_list);
+
+                if(!sock_manage.Start())
+                    return(false);
+
+                sock_thread_count=info.thread_count;
+                server_ip=info.server_ip;
+
+                if(info.hot_restart)
+                    RecvHandoffConnection(info,item,has_item);
+
+                return(true);
+            }
+
+        public:
+
+            virtual ~MTTCPServer()
+            {
+                sock_manage.Close();
+
+                const int count=shard_server_list.GetCount();
+                TCPServer **ss=shard_server_list.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    delete *ss;
+                    ++ss;
+                }
+            }
+
             bool Init(InitInfomation &info)
             {
                 if(!info.server_ip)return(false);
                 if(info.max_user<=0)return(false);
                 if(info.thread_count<=0)return(false);
 
-                if(!server.CreateServer(info.server_ip,info.max_user,info.port_reuse))
+                if(info.reuse_port_shard)
+                    return InitShard(info);
+
+                List<int> listen_list;
+                HandoffItem item;
+
+                const bool has_item=RecvHandoffListen(info,listen_list,item);
+
+                const bool created=CreateOrAttachServer(&server,listen_list,0,info,info.max_user,false);
+
+                CloseHandoffListen(listen_list);
+
+                if(!created)
                     return(false);
 
                 if(info.server_ip->GetFamily()==AF_INET6)               //如果是IPv6地址
@@ -108,15 +372,23 @@ namespace hgl
                 if(!accept_manage.Init(&server,info.thread_count))
                     return(false);
 
+                placement.SetPolicy(info.placement);
+
                 for(int i=0;i<info.thread_count;i++)
                 {
                     Accept2SocketManageThread *at=accept_manage.GetAcceptThread(i);
 
-                    SOCKET_MANAGE_THREAD *smt=CreateSocketManageThread(info.max_user);
+                    const int cpu=GetThreadCPU(info,i);
+
+                    SOCKET_MANAGE_THREAD *smt=CreateLocalSocketManageThread(info,i,cpu);
+
+                    at->SetCPU(cpu);
 
-                    at->SetSocketManage(smt);
+                    at->SetServer(this,i);
+                    smt->SetOwnerID(i);
 
                     sock_manage.Add(smt);
+                    placement.Add(smt->GetLoad());
                 }
 
                 if(!sock_manage.Start())
@@ -128,11 +400,140 @@ namespace hgl
                     return(false);
                 }
 
+                sock_thread_count=info.thread_count;
                 server_ip=info.server_ip;
 
+                if(info.hot_restart)
+                    RecvHandoffConnection(info,item,has_item);
+
                 return(true);
             }
 
+            /**
+             * 热重启：把监听socket与连接转交给新进程(hs需已等到新进程连接)<br>
+             * 先转交监听socket，新进程随即开始接入，本进程停止接入后由各SocketManageThread转交发送队列已发完的连接。
+             * 超时未转交的，以及不能转交的连接(见TCPAccept::SaveHandoffState)恢复接收留在本进程，由调用者决定何时关闭
+             * @param time_out 等待连接发送队列发完的最长时间(秒)
+             * @return 转交的连接数量，<0表示出错
+             */
+            int HotRestart(HotRestartSender &hs,const double time_out=HGL_NETWORK_TIME_OUT)
+            {
+                if(!hs.IsConnected()||sock_thread_count<=0)
+                    return(-1);
+
+                const int shard_count=shard_server_list.GetCount();
+                TCPServer **ss=shard_server_list.GetData();
+
+                if(shard_count>0)
+                {
+                    for(int i=0;i<shard_count;i++)
+                        if(!hs.SendListen(ss[i]->GetSocket(),i))
+                            return(-1);
+                }
+                else
+                {
+                    if(!hs.SendListen(server.GetSocket(),0))
+                        return(-1);
+
+                    accept_manage.Close();                              //接入线程在accept超时后退出，之后的新连接都由新进程接入
+                }
+
+                for(int i=0;i<sock_thread_count;i++)
+                    sock_manage.GetThread(i)->Handoff(&hs);             //分片模式下各线程同时分离自己的监听socket
+
+                const double end_time=GetDoubleTime()+time_out;
+
+                while(true)
+                {
+                    int done=0;
+
+                    for(int i=0;i<sock_thread_count;i++)
+                        if(sock_manage.GetThread(i)->IsHandoffDone())
+                            ++done;
+
+                    if(done>=sock_thread_count||GetDoubleTime()>=end_time)
+                        break;
+
+                    WaitTime(0.01);
+                }
+
+                hs.Finish();                                            //之后各线程的转交都会失败，还在等待的连接恢复接收
+
+                int count=0;
+
+                for(int i=0;i<sock_thread_count;i++)
+                    count+=sock_manage.GetThread(i)->GetHandoffCount();
+
+                if(shard_count>0)                                       //监听socket不能shutdown，否则新进程中的也会停止监听
+                {
+                    for(int i=0;i<shard_count;i++)
+                        CloseHandoffSocket(ss[i]->DetachServer());
+                }
+                else
+                {
+                    CloseHandoffSocket(server.DetachServer());
+                }
+
+                return count;
+            }
+
+            /**
+             * 将共享数据块广播给所有连接<br>
+             * 数据只编码一次(参见MakeWebSocketFrame/TCPAcceptPacket::MakeSharedPacket)，每个SocketManageThread在自己的线程中一次性处理
+             * @param sb 共享数据块(各线程会自行增加引用，调用者仍需释放自己的引用)
+             */
+            void Broadcast(SharedBuffer *sb)
+            {
+                if(!sb)return;
+
+                for(int i=0;i<sock_thread_count;i++)
+                    sock_manage.GetThread(i)->Broadcast(sb);
+            }
+
+            /**
+             * 向指定连接发送共享数据块(可在任意线程调用)，按句柄中的编号交给所属的SocketManageThread
+             * @param h 连接句柄(TCPAccept::GetHandle)
+             * @param sb 共享数据块(调用者仍需释放自己的引用)
+             */
+            bool Send(const ConnectionHandle h,SharedBuffer *sb)
+            {
+                const uint owner=GetConnectionOwner(h);
+
+                if(int(owner)>=sock_thread_count)return(false);
+
+                return sock_manage.GetThread(owner)->Send(h,sb);
+            }
+
+            /**
+             * 取得所有线程的统计数据快照(可在任意线程调用，数据由各线程自行更新，只作参考)
+             * @param sm 所有SocketManageThread的合计
+             * @param am 所有接入线程的合计(可为nullptr)
+             */
+            void GetMetricsSnapshot(SocketManageMetricsSnapshot &sm,AcceptMetricsSnapshot *am=nullptr)
+            {
+                SocketManageMetricsSnapshot one;
+
+                hgl_zero(sm);
+
+                for(int i=0;i<sock_thread_count;i++)
+                {
+                    sock_manage.GetThread(i)->GetMetricsSnapshot(one);
+                    sm.Merge(one);
+                }
+
+                if(!am)return;
+
+                AcceptMetricsSnapshot aone;
+
+                hgl_zero(*am);
+
+                for(int i=0;i<accept_manage.GetCount();i++)
+                {
+                    accept_manage.GetAcceptThread(i)->GetMetricsSnapshot(aone);
+                    am->Merge(aone);
+                }
+            }
+
             int IsLive()
             {
                 return(sock_manage.IsLive()+accept_manage.IsLive());
@@ -0,0 +1,184 @@
+﻿#ifndef HGL_NETWORK_MULTI_THREAD_UDP_SERVER_INCLUDE
+#define HGL_NETWORK_MULTI_THREAD_UDP_SERVER_INCLUDE
+
+#include<hgl/network/UdpSocket.h>
+#include<hgl/network/SocketManageThread.h>
+#include<hgl/Time.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 多线程UDP服务器(SO_REUSEPORT分片)<br>
+         * 每个SocketManageThread独占一个绑定在同一地址上的UDP_SOCKET，由内核按来源地址把数据报分配给它们，
+         * 同一来源始终落在同一个socket上。各线程的收发路径互不共享可写数据，接收能力可以随线程数线性增长。<br>
+         * UDP_SOCKET需从UDPSocket派生(如RUDPEndpoint)，数据报在所属线程的ProcRecv中处理。
+         */
+        template<typename UDP_SOCKET,typename SOCKET_MANAGE_THREAD> class MTUDPServer
+        {
+        protected:
+
+            IPAddress *                                     server_ip=nullptr;
+
+            MultiThreadManage<SOCKET_MANAGE_THREAD>         sock_manage;
+
+            List<UDP_SOCKET *>                              shard_socket_list;              ///<每个SocketManageThread独占的UDP socket
+
+            int                                             sock_thread_count=0;            ///<SocketManageThread数量
+
+        protected:
+
+            virtual SOCKET_MANAGE_THREAD *CreateSocketManageThread(int max_user)
+            {
+                SocketManage *sm=new SocketManage(max_user);
+                SOCKET_MANAGE_THREAD *smt=new SOCKET_MANAGE_THREAD(sm);
+
+                return smt;
+            }
+
+            /**
+             * 创建第N个分片的UDP socket(还未调用Create)，可重载后设置参数
+             */
+            virtual UDP_SOCKET *CreateUDPSocket(const uint index)
+            {
+                return(new UDP_SOCKET);
+            }
+
+        public:
+
+            /**
+            * 服务器初始化信息结构
+            */
+            struct InitInfomation
+            {
+                IPAddress * server_ip           =nullptr;               ///<服务器IP地址
+
+                uint        max_user            =64;                    ///<每个SocketManage的容量(只承载UDP socket时不需要很大)
+                uint        thread_count        =4;                     ///<线程数量(即socket数量)
+
+                bool        incoming_cpu        =false;                 ///<第N个socket设置SO_INCOMING_CPU为第N个线程的CPU(仅Linux)
+
+                bool        cpu_affinity        =false;                 ///<将第N个SocketManageThread绑定到一个CPU
+                const int * cpu_list            =nullptr;               ///<绑定使用的CPU(thread_count个，nullptr表示第N个CPU)，建议与网卡接收队列(RSS)中断所在CPU一一对应
+                bool        numa_local          =true;                  ///<绑定CPU时，SocketManage的缓冲区池与事件数组在该CPU所在NUMA节点分配
+            };//struct InitInfomation
+
+        protected:
+
+            /**
+             * 取得第N个线程绑定的CPU
+             * @return <0 不绑定
+             */
+            int GetThreadCPU(const InitInfomation &info,const uint index)const
+            {
+                if(!info.cpu_affinity)return(-1);
+
+                if(info.cpu_list)
+                    return info.cpu_list[index];
+
+                return int(index%GetCPUCount());
+            }
+
+            /**
+             * 创建一个SocketManageThread，并让它的内存分配在目标CPU所在的NUMA节点
+             */
+            SOCKET_MANAGE_THREAD *CreateLocalSocketManageThread(const InitInfomation &info,const int cpu)
+            {
+                const int node=(cpu>=0&&info.numa_local)?GetCPUNumaNode(cpu):-1;
+
+                const bool local=(node>=0&&SetThreadMemoryNode(node));
+
+                SOCKET_MANAGE_THREAD *smt=CreateSocketManageThread(info.max_user);
+
+                if(local)
+                    SetThreadMemoryNode(-1);
+
+                if(smt&&cpu>=0)
+                    smt->SetCPU(cpu,node);
+
+                return smt;
+            }
+
+        public:
+
+            virtual ~MTUDPServer()
+            {
+                sock_manage.Close();                                    //线程退出后socket才不再被使用
+
+                for(UDP_SOCKET *us:shard_socket_list)
+                    delete us;
+            }
+
+            bool Init(InitInfomation &info)
+            {
+                if(!info.server_ip)return(false);
+                if(!info.server_ip->IsUDP())return(false);
+                if(info.thread_count<=0)return(false);
+
+                for(uint i=0;i<info.thread_count;i++)
+                {
+                    UDP_SOCKET *us=CreateUDPSocket(i);
+
+                    if(!us)return(false);
+
+                    shard_socket_list.Add(us);
+
+                    us->SetReusePort(info.thread_count>1);
+
+                    if(!us->Create(info.server_ip))
+                        return(false);
+
+                    const int cpu=GetThreadCPU(info,i);
+
+#if HGL_OS == HGL_OS_Linux
+                    if(info.incoming_cpu)
+                        us->SetIncomingCPU(cpu>=0?cpu:i);
+#endif//HGL_OS == HGL_OS_Linux
+
+                    SOCKET_MANAGE_THREAD *smt=CreateLocalSocketManageThread(info,cpu);
+
+                    smt->SetOwnerID(i);
+                    sock_manage.Add(smt);
+
+                    if(!smt->JoinDatagram(us))                          //之后只在该线程中收发
+                        return(false);
+                }
+
+                if(!sock_manage.Start())
+                    return(false);
+
+                sock_thread_count=info.thread_count;
+                server_ip=info.server_ip;
+                return(true);
+            }
+
+            const int GetThreadCount()const{return sock_thread_count;}
+
+            SOCKET_MANAGE_THREAD *GetThread(const int index){return sock_manage.GetThread(index);}
+
+            /**
+             * 取得第N个分片的socket(只能在对应线程中收发)
+             */
+            UDP_SOCKET *GetSocket(const int index)
+            {
+                if(index<0||index>=shard_socket_list.GetCount())return(nullptr);
+
+                return shard_socket_list.GetData()[index];
+            }
+
+            int IsLive()
+            {
+                return(sock_manage.IsLive());
+            }
+
+            bool Wait(const double &time_out=HGL_NETWORK_TIME_OUT)
+            {
+                WaitTime(time_out);
+
+                return(sock_manage.IsLive()>0);
+            }
+        };//template<typename UDP_SOCKET,typename SOCKET_MANAGE_THREAD> class MTUDPServer
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_MULTI_THREAD_UDP_SERVER_INCLUDE
@@ -2,17 +2,15 @@
 #define HGL_NETWORK_MULTI_THREAD_ACCEPT_INCLUDE
 
 #include<hgl/thread/Thread.h>
-#include<hgl/type/Stack.h>
 #include<hgl/thread/Semaphore.h>
+#include<hgl/network/IP.h>
+#include<hgl/network/NetworkMetrics.h>
 namespace hgl
 {
     namespace network
     {
-        class IPAddress;
         class AcceptServer;
 
-        using IPAddressStack=Stack<IPAddress *>;
-
         /**
          * Socket接入线程
          */
@@ -23,13 +21,23 @@ namespace hgl
 
         protected:
 
-            IPAddressStack ip_stack;                                            ///<IP地址空间堆栈，会提前分配好空间供未来使用
+            SocketAddress client_ip;                                            ///<accept直接写入的地址空间(值类型，每次接入复用)
+
+            int bind_cpu=-1;                                                    ///<绑定的CPU(<0表示不绑定)
+
+            AcceptMetrics metrics;                                              ///<统计数据(本线程写入)
 
         public:
 
             AcceptThread(AcceptServer *,Semaphore *);
             virtual ~AcceptThread()=default;
 
+            void SetCPU(const int cpu){bind_cpu=cpu;}                           ///<设置绑定的CPU(需在线程启动前调用)
+            const int GetCPU()const{return bind_cpu;}
+
+            void GetMetricsSnapshot(AcceptMetricsSnapshot &am)const{metrics.GetSnapshot(am);}  ///<取得统计数据快照(可在其它线程调用)
+
+            bool ProcStartThread() override;
             bool Execute() override;
 
         public:
@@ -37,9 +45,9 @@ namespace hgl
             /**
              * 接受一个接入
              * @param sock Socket值
-             * @param addr ip地址(注:需自行delete)
+             * @param addr ip地址(只在本次调用中有效，需要保留请复制)
              */
-            virtual bool OnAccept(int sock,IPAddress *addr)=0;                  ///<接入一个新Socket
+            virtual bool OnAccept(int sock,const SocketAddress &addr)=0;        ///<接入一个新Socket
         };//class AcceptThread:public Thread
 
         /**
@@ -51,18 +59,22 @@ namespace hgl
 
             Semaphore active_semaphore;
 
+            int thread_count=0;
+
         public:
 
             virtual ~MultiThreadAccept()=default;
 
-            bool Init(AcceptServer *server,const uint thread_count)
+            bool Init(AcceptServer *server,const uint tc)
             {
                 if(!server)return(false);
-                if(thread_count<=0)return(false);
+                if(tc<=0)return(false);
 
-                for(int i=0;i<thread_count;i++)
+                for(int i=0;i<tc;i++)
                     accept_thread_manage.Add(new ACCEPT_THREAD(server,&active_semaphore));
 
+                thread_count=tc;
+
                 return(true);
             }
 
@@ -71,6 +83,8 @@ namespace hgl
                 return accept_thread_manage.GetThread(index);
             }
 
+            const int GetCount()const{return thread_count;}
+
             bool Start  (){return accept_thread_manage.Start()>0;}
              int IsLive (){return accept_thread_manage.IsLive();}
             bool Close  (){return accept_thread_manage.Close();}
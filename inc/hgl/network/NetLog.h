@@ -0,0 +1,86 @@
+﻿#ifndef HGL_NETWORK_LOG_INCLUDE
+#define HGL_NETWORK_LOG_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<atomic>
+#include<type_traits>
+
+/**
+ * 编译期最低日志等级(0:Info 1:Hint 2:Problem 3:Error 4:全部关闭)<br>
+ * 低于此等级的NET_LOG_*在编译期被整个去掉，参数也不会被求值
+ */
+#ifndef HGL_NETWORK_LOG_LEVEL
+#define HGL_NETWORK_LOG_LEVEL   0
+#endif//HGL_NETWORK_LOG_LEVEL
+
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 网络日志等级，与LOG_INFO/LOG_HINT/LOG_PROBLEM/LOG_ERROR一一对应
+         */
+        enum class NetLogLevel:uint8
+        {
+            Info=0,
+            Hint,
+            Problem,
+            Error,
+        };//enum class NetLogLevel
+
+        constexpr uint HGL_NETWORK_LOG_MAX_ARGS     =4;                     ///<一条日志最多的参数个数
+        constexpr uint HGL_NETWORK_LOG_RING_SIZE    =1024;                  ///<每个线程的日志环形队列长度(满了之后丢弃并计数)
+        constexpr uint HGL_NETWORK_LOG_SITE_RATE    =16;                    ///<每个调用点每秒最多记录的条数
+
+        /**
+         * 日志调用点(每处NET_LOG_*一个静态对象，常量初始化，没有构造开销)<br>
+         * 格式中的{}依次替换为参数，格式化在后台线程中进行
+         */
+        struct NetLogSite
+        {
+            NetLogLevel         level;
+            const os_char *     format;
+            uint                rate;                                       ///<每秒最多记录的条数(0表示不限制)
+
+            std::atomic<int64>  window{0};                                  ///<当前计数的秒
+            std::atomic<uint>   count{0};                                   ///<这一秒已记录的条数
+            std::atomic<uint>   suppressed{0};                              ///<被限流丢弃的条数(随下一条记录一起写出)
+        };//struct NetLogSite
+
+        /**
+         * 排入一条日志(只复制参数，不格式化)<br>
+         * 先按调用点限流，再放入本线程的无锁环形队列，由后台线程取出、格式化后交给LOG_*写出
+         */
+        void PostNetLog(NetLogSite *,const int64 *args,const uint arg_count);
+
+        void FlushNetLog();                                                 ///<立即写出所有线程中已排入的日志(如进程退出前)
+        void StopNetLog();                                                  ///<写完剩余日志并停止后台线程，之后的日志在调用线程中同步写出
+
+        template<typename ...ARGS> inline void NetLog(NetLogSite *site,const ARGS &...args)
+        {
+            static_assert(sizeof...(ARGS)<=HGL_NETWORK_LOG_MAX_ARGS,"too many network log arguments");
+            static_assert((...&&(std::is_integral_v<ARGS>||std::is_enum_v<ARGS>)),"network log arguments must be integers");
+
+            const int64 values[sizeof...(ARGS)+1]={int64(args)...};
+
+            PostNetLog(site,values,sizeof...(ARGS));
+        }
+    }//namespace network
+}//namespace hgl
+
+#define HGL_NETWORK_LOG(lv,fmt,...) do{                                                                             \
+                                        if constexpr(int(hgl::network::NetLogLevel::lv)>=HGL_NETWORK_LOG_LEVEL)     \
+                                        {                                                                           \
+                                            static hgl::network::NetLogSite _net_log_site                           \
+                                                {hgl::network::NetLogLevel::lv,OS_TEXT(fmt),hgl::network::HGL_NETWORK_LOG_SITE_RATE};  \
+                                                                                                                    \
+                                            hgl::network::NetLog(&_net_log_site __VA_OPT__(,) __VA_ARGS__);         \
+                                        }                                                                           \
+                                    }while(0)
+
+#define NET_LOG_INFO(fmt,...)       HGL_NETWORK_LOG(Info,   fmt __VA_OPT__(,) __VA_ARGS__)   ///<异步、限流的LOG_INFO，如 NET_LOG_INFO("recv failed,sock:{},errno:{}",sock,errno)
+#define NET_LOG_HINT(fmt,...)       HGL_NETWORK_LOG(Hint,   fmt __VA_OPT__(,) __VA_ARGS__)
+#define NET_LOG_PROBLEM(fmt,...)    HGL_NETWORK_LOG(Problem,fmt __VA_OPT__(,) __VA_ARGS__)
+#define NET_LOG_ERROR(fmt,...)      HGL_NETWORK_LOG(Error,  fmt __VA_OPT__(,) __VA_ARGS__)
+
+#endif//HGL_NETWORK_LOG_INCLUDE
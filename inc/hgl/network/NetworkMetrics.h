@@ -0,0 +1,180 @@
+﻿#ifndef HGL_NETWORK_METRICS_INCLUDE
+#define HGL_NETWORK_METRICS_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 单写者计数器<br>
+         * 只由所属线程写入，所以用relaxed的load+store代替fetch_add，不产生总线锁；其它线程读取时可能略有滞后
+         */
+        class MetricCounter
+        {
+            std::atomic<uint64> value{0};
+
+        public:
+
+            void Add(const uint64 n=1){value.store(value.load(std::memory_order_relaxed)+n,std::memory_order_relaxed);}
+            void Sub(const uint64 n=1){value.store(value.load(std::memory_order_relaxed)-n,std::memory_order_relaxed);}
+            void Max(const uint64 n){if(n>value.load(std::memory_order_relaxed))value.store(n,std::memory_order_relaxed);}
+            void Set(const uint64 n){value.store(n,std::memory_order_relaxed);}
+
+            const uint64 Get()const{return value.load(std::memory_order_relaxed);}
+        };//class MetricCounter
+
+        constexpr uint HGL_LATENCY_HISTOGRAM_BUCKETS=24;                                            ///<延迟直方图格数(按微秒2的幂划分，最后一格约8秒以上)
+
+        /**
+         * 延迟直方图快照
+         */
+        struct LatencyHistogramSnapshot
+        {
+            uint64 bucket[HGL_LATENCY_HISTOGRAM_BUCKETS];                                           ///<第0格<1us，第i格[2^(i-1),2^i)us
+            uint64 count;
+            uint64 total_us;
+
+        public:
+
+            const double GetAverage()const{return count?double(total_us)/count/1000000.0:0;}       ///<平均值(秒)
+                  double GetPercentile(const double p)const;                                        ///<取得百分位数(秒，按格子上限估算)
+
+            void Merge(const LatencyHistogramSnapshot &);
+        };//struct LatencyHistogramSnapshot
+
+        /**
+         * 延迟直方图(单写者)
+         */
+        class LatencyHistogram
+        {
+            MetricCounter bucket[HGL_LATENCY_HISTOGRAM_BUCKETS];
+            MetricCounter count;
+            MetricCounter total_us;
+
+        public:
+
+            void Add(const double seconds);                                                         ///<记录一次耗时(秒)
+            void GetSnapshot(LatencyHistogramSnapshot &)const;
+        };//class LatencyHistogram
+
+        /**
+         * SocketManage统计数据快照
+         */
+        struct SocketManageMetricsSnapshot
+        {
+            uint64 update_count;                                                                    ///<Update次数
+            uint64 event_count;                                                                     ///<处理的socket事件数
+            uint64 max_event_per_update;                                                            ///<单次Update最多事件数
+
+            uint64 recv_event_count;                                                                ///<可读事件数
+            uint64 recv_bytes;                                                                      ///<接收字节数
+
+            uint64 send_call_count;                                                                 ///<直接发送与队列刷新的调用次数
+            uint64 send_bytes;                                                                      ///<发送字节数
+            uint64 send_queued_bytes;                                                               ///<发不完存入发送队列的字节数
+            uint64 send_watch_count;                                                                ///<当前有数据待发(关注可写)的连接数
+
+            uint64 accept_count;                                                                    ///<接入连接数
+            uint64 error_count;                                                                     ///<出错(移出)的连接数
+            uint64 timer_count;                                                                     ///<到期的定时器数
+            uint64 connection_count;                                                                ///<当前连接数
+
+            LatencyHistogramSnapshot dispatch_time;                                                 ///<每次Update处理事件、定时器所用时间
+
+            LatencyHistogramSnapshot recv_latency;                                                  ///<内核收到数据到分发给OnRecvPacket的时间(延迟跟踪模式)
+            LatencyHistogramSnapshot reply_latency;                                                 ///<分发到回复全部交给内核的时间(延迟跟踪模式)
+
+            uint64 tcp_info_count;                                                                  ///<TCP_INFO采样次数
+            uint64 retrans_count;                                                                   ///<采样到的新增重传分段数
+            LatencyHistogramSnapshot rtt;                                                           ///<采样到的连接RTT
+
+        public:
+
+            const double GetBytesPerRecv()const{return recv_event_count?double(recv_bytes)/recv_event_count:0;}
+            const double GetBytesPerSend()const{return send_call_count?double(send_bytes)/send_call_count:0;}
+            const double GetEventsPerUpdate()const{return update_count?double(event_count)/update_count:0;}
+
+            void Merge(const SocketManageMetricsSnapshot &);                                        ///<累加另一个线程的数据
+        };//struct SocketManageMetricsSnapshot
+
+        /**
+         * SocketManage统计数据<br>
+         * 由SocketManage所在线程更新，其它线程随时可以调用GetSnapshot读取
+         */
+        struct SocketManageMetrics
+        {
+            MetricCounter update_count;
+            MetricCounter event_count;
+            MetricCounter max_event_per_update;
+
+            MetricCounter recv_event_count;
+            MetricCounter recv_bytes;
+
+            MetricCounter send_call_count;
+            MetricCounter send_bytes;
+            MetricCounter send_queued_bytes;
+            MetricCounter send_watch_count;
+
+            MetricCounter accept_count;
+            MetricCounter error_count;
+            MetricCounter timer_count;
+            MetricCounter connection_count;
+
+            LatencyHistogram dispatch_time;
+
+            LatencyHistogram recv_latency;
+            LatencyHistogram reply_latency;
+
+            MetricCounter tcp_info_count;
+            MetricCounter retrans_count;
+            LatencyHistogram rtt;
+
+        public:
+
+            void AddSend(const int64 bytes)
+            {
+                send_call_count.Add();
+
+                if(bytes>0)
+                    send_bytes.Add(bytes);
+            }
+
+            void GetSnapshot(SocketManageMetricsSnapshot &)const;
+        };//struct SocketManageMetrics
+
+        /**
+         * 接入线程统计数据快照
+         */
+        struct AcceptMetricsSnapshot
+        {
+            uint64 accept_count;                                                                    ///<接入成功次数
+            uint64 fail_count;                                                                      ///<接入失败/超时次数
+            uint64 reject_count;                                                                    ///<OnAccept拒绝(关闭)的次数
+
+            LatencyHistogramSnapshot handoff_time;                                                  ///<接入后交给处理线程所用时间
+
+        public:
+
+            void Merge(const AcceptMetricsSnapshot &);
+        };//struct AcceptMetricsSnapshot
+
+        /**
+         * 接入线程统计数据(由接入线程更新)
+         */
+        struct AcceptMetrics
+        {
+            MetricCounter accept_count;
+            MetricCounter fail_count;
+            MetricCounter reject_count;
+
+            LatencyHistogram handoff_time;
+
+        public:
+
+            void GetSnapshot(AcceptMetricsSnapshot &)const;
+        };//struct AcceptMetrics
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_METRICS_INCLUDE
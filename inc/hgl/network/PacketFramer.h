@@ -0,0 +1,227 @@
+﻿#ifndef HGL_NETWORK_PACKET_FRAMER_INCLUDE
+#define HGL_NETWORK_PACKET_FRAMER_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<string.h>
+#include<type_traits>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 包头中整数的字节序
+         */
+        enum class PacketByteOrder
+        {
+            Host,                                                           ///<本机字节序(直接复制，两端需相同)
+            Little,                                                         ///<小端
+            Big,                                                            ///<大端(网络字节序)
+        };//enum class PacketByteOrder
+
+        template<typename T,PacketByteOrder ORDER> inline T LoadPacketInt(const uchar *p)
+        {
+            if constexpr(ORDER==PacketByteOrder::Host||sizeof(T)==1)
+            {
+                T value;
+
+                memcpy(&value,p,sizeof(T));
+                return value;
+            }
+            else
+            {
+                T value=0;
+
+                for(uint i=0;i<sizeof(T);i++)                               //编译器会合并为一次读取(加bswap)
+                    if constexpr(ORDER==PacketByteOrder::Little)
+                        value|=T(p[i])<<(i*8);
+                    else
+                        value=T(value<<8)|T(p[i]);
+
+                return value;
+            }
+        }
+
+        template<typename T,PacketByteOrder ORDER> inline void StorePacketInt(uchar *p,const T value)
+        {
+            if constexpr(ORDER==PacketByteOrder::Host||sizeof(T)==1)
+            {
+                memcpy(p,&value,sizeof(T));
+            }
+            else
+            {
+                for(uint i=0;i<sizeof(T);i++)
+                    if constexpr(ORDER==PacketByteOrder::Little)
+                        p[i]=uchar(value>>(i*8));
+                    else
+                        p[i]=uchar(value>>((sizeof(T)-1-i)*8));
+            }
+        }
+
+        /**
+         * 定长包长前缀(1/2/4字节)
+         */
+        template<typename T,PacketByteOrder PREFIX_ORDER=PacketByteOrder::Little> struct FixedLengthPrefix
+        {
+            static_assert(std::is_unsigned_v<T>&&sizeof(T)<=4,"length prefix must be uint8/uint16/uint32");
+
+            static constexpr uint               MAX_BYTES   =sizeof(T);
+            static constexpr uint               MAX_LENGTH  =uint(T(~T(0)));
+            static constexpr PacketByteOrder    ORDER       =PREFIX_ORDER;
+
+            /**
+             * @return 包长前缀字节数，0表示还没收完整
+             */
+            static int Decode(const uchar *p,const uint size,uint &length)
+            {
+                if(size<sizeof(T))
+                    return(0);
+
+                length=LoadPacketInt<T,ORDER>(p);
+                return sizeof(T);
+            }
+
+            static uint Encode(uchar *p,const uint length)
+            {
+                StorePacketInt<T,ORDER>(p,T(length));
+                return sizeof(T);
+            }
+        };//struct FixedLengthPrefix
+
+        /**
+         * 变长包长前缀(LEB128，每字节7位，小于128的包只需1字节)
+         */
+        struct VarintLengthPrefix
+        {
+            static constexpr uint               MAX_BYTES   =5;
+            static constexpr uint               MAX_LENGTH  =0xFFFFFFFF;
+            static constexpr PacketByteOrder    ORDER       =PacketByteOrder::Little;   ///<类型字段使用的字节序
+
+            /**
+             * @return 包长前缀字节数，0表示还没收完整，-1表示格式错误
+             */
+            static int Decode(const uchar *p,const uint size,uint &length)
+            {
+                if(size>0&&p[0]<0x80)                                       //绝大多数包走这里
+                {
+                    length=p[0];
+                    return(1);
+                }
+
+                const uint count=(size<MAX_BYTES?size:MAX_BYTES);
+
+                uint value=0;
+
+                for(uint i=0;i<count;i++)
+                {
+                    value|=uint(p[i]&0x7F)<<(i*7);
+
+                    if(p[i]<0x80)
+                    {
+                        if(i==MAX_BYTES-1&&p[i]>0x0F)                       //超出32位
+                            return(-1);
+
+                        length=value;
+                        return int(i+1);
+                    }
+                }
+
+                return(count==MAX_BYTES?-1:0);
+            }
+
+            static uint Encode(uchar *p,uint length)
+            {
+                uint n=0;
+
+                while(length>=0x80)
+                {
+                    p[n++]=uchar(length|0x80);
+                    length>>=7;
+                }
+
+                p[n++]=uchar(length);
+                return n;
+            }
+        };//struct VarintLengthPrefix
+
+        /**
+         * 解析出的包头
+         */
+        struct PacketFrameHeader
+        {
+            uint size;                                                      ///<包体长度(不含包头)
+            uint type;                                                      ///<消息类型(没有类型字段时为0)
+        };//struct PacketFrameHeader
+
+        /**
+         * 封包格式<br>
+         * 包头为 包长前缀+可选的类型字段，包长只计算包体。全部在编译期确定，解析循环中没有格式相关的分支
+         * @param LENGTH_PREFIX 包长前缀(FixedLengthPrefix或VarintLengthPrefix)
+         * @param TYPE 类型字段的数据类型(void表示没有类型字段，字节序与包长前缀相同)
+         * @param MAX_SIZE 最大包体长度(0表示只受包长前缀限制)，收到更长的包视为出错
+         */
+        template<typename LENGTH_PREFIX,typename TYPE=void,uint MAX_SIZE=0> struct PacketFramer
+        {
+            using LengthPrefix=LENGTH_PREFIX;
+
+            static constexpr bool HAS_TYPE      =!std::is_void_v<TYPE>;
+            static constexpr uint TYPE_BYTES    =(HAS_TYPE?uint(sizeof(std::conditional_t<HAS_TYPE,TYPE,uint8>)):0);
+            static constexpr uint HEADER_MAX    =LENGTH_PREFIX::MAX_BYTES+TYPE_BYTES;
+            static constexpr uint MAX_BODY_SIZE =(MAX_SIZE>0&&MAX_SIZE<LENGTH_PREFIX::MAX_LENGTH?MAX_SIZE:LENGTH_PREFIX::MAX_LENGTH);
+
+            static_assert(!HAS_TYPE||(std::is_unsigned_v<TYPE>&&sizeof(TYPE)<=4),"type field must be uint8/uint16/uint32");
+
+            /**
+             * 解析包头
+             * @return 包头字节数，0表示还没收完整，-1表示格式错误或包太大
+             */
+            static int Decode(const uchar *p,const uint size,PacketFrameHeader &h)
+            {
+                const int ls=LENGTH_PREFIX::Decode(p,size,h.size);
+
+                if(ls<=0)
+                    return ls;
+
+                if constexpr(MAX_BODY_SIZE<LENGTH_PREFIX::MAX_LENGTH)
+                    if(h.size>MAX_BODY_SIZE)
+                        return(-1);
+
+                if constexpr(HAS_TYPE)
+                {
+                    if(size-ls<TYPE_BYTES)
+                        return(0);
+
+                    h.type=LoadPacketInt<TYPE,LENGTH_PREFIX::ORDER>(p+ls);
+                    return ls+TYPE_BYTES;
+                }
+                else
+                {
+                    h.type=0;
+                    return ls;
+                }
+            }
+
+            /**
+             * 编码包头
+             * @param p 至少HEADER_MAX字节
+             * @return 包头字节数
+             */
+            static uint Encode(uchar *p,const uint size,const uint type)
+            {
+                const uint ls=LENGTH_PREFIX::Encode(p,size);
+
+                if constexpr(HAS_TYPE)
+                {
+                    StorePacketInt<TYPE,LENGTH_PREFIX::ORDER>(p+ls,TYPE(type));
+                    return ls+TYPE_BYTES;
+                }
+                else
+                {
+                    return ls;
+                }
+            }
+        };//struct PacketFramer
+
+        using DefaultPacketFramer=PacketFramer<FixedLengthPrefix<uint32,PacketByteOrder::Host>>;   ///<TCPAcceptPacket原有格式：本机字节序uint32包长，没有类型字段
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_PACKET_FRAMER_INCLUDE
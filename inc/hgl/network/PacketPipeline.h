@@ -0,0 +1,252 @@
+﻿#ifndef HGL_NETWORK_PACKET_PIPELINE_INCLUDE
+#define HGL_NETWORK_PACKET_PIPELINE_INCLUDE
+
+#include<hgl/network/SPSCQueue.h>
+#include<hgl/network/MTTCPServer.h>
+#include<hgl/thread/Semaphore.h>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * IO/逻辑线程分离
+         *
+         * PipelineSocketManageThread:  IO线程，负责收发与切包
+         * PipelineLogicThread:         逻辑线程，与IO线程一一配对，执行PipelineAccept::OnLogicPacket
+         * PacketPipeline:              连接两个线程的一对SPSC无锁队列(inbound: IO->逻辑，outbound: 逻辑->IO)
+         *
+         * 关闭流程:
+         *          1.IO线程发现连接出错，向inbound压入Close消息，此后不再向该连接发包
+         *          2.逻辑线程处理完该连接之前的所有包后收到Close，调用OnLogicClose，并向outbound压回Close作为应答
+         *          3.IO线程收到应答时，逻辑线程已不会再引用该连接，这时才回收对象
+         */
+
+        constexpr uint HGL_PIPELINE_QUEUE_SIZE=HGL_SIZE_1KB*16;                                     ///<单个方向队列可容纳的消息数量
+
+        class PipelineAccept;
+
+        enum class PipeMessageType:uint8
+        {
+            Packet=0,                                                                               ///<数据包
+            Close,                                                                                  ///<连接关闭通知/应答
+        };
+
+        struct PipeMessage
+        {
+            PipeMessageType type;
+            PipelineAccept *accept;
+            uchar *data;                                                                            ///<包数据(new[]分配，由消费者delete[])
+            uint size;
+        };//struct PipeMessage
+
+        /**
+         * IO线程与逻辑线程之间的封包管道<br>
+         * 队列满时暂存到生产者线程自己的溢出列表中，下次Flush时再压入
+         */
+        class PacketPipeline
+        {
+            SPSCQueue<PipeMessage> inbound;
+            SPSCQueue<PipeMessage> outbound;
+
+            List<PipeMessage> inbound_overflow;                                                     ///<仅IO线程访问
+            List<PipeMessage> outbound_overflow;                                                    ///<仅逻辑线程访问
+
+            bool inbound_posted;
+            bool outbound_posted;
+
+            Semaphore logic_sem;                                                                    ///<唤醒逻辑线程
+            SocketManage *io_manage;                                                                ///<用于唤醒IO线程
+
+        public:
+
+            PacketPipeline(SocketManage *,uint queue_size=HGL_PIPELINE_QUEUE_SIZE);
+            ~PacketPipeline();
+
+        public: //IO线程调用
+
+            void PostInbound(const PipeMessage &);                                                  ///<向逻辑线程发送消息
+            void FlushInbound();                                                                    ///<压入溢出的消息并唤醒逻辑线程
+            bool PopOutbound(PipeMessage &);                                                        ///<取出逻辑线程发来的消息
+
+        public: //逻辑线程调用
+
+            void PostOutbound(const PipeMessage &);                                                 ///<向IO线程发送消息
+            void FlushOutbound();                                                                   ///<压入溢出的消息并唤醒IO线程
+            bool PopInbound(PipeMessage &);                                                         ///<取出IO线程发来的消息
+            bool WaitInbound(const double &);                                                       ///<等待IO线程发来消息
+        };//class PacketPipeline
+
+        /**
+         * 使用IO/逻辑线程分离的TCP封包接入对象<br>
+         * 收到的包在逻辑线程通过OnLogicPacket处理，逻辑线程中使用PostPacket发包
+         */
+        class PipelineAccept:public TCPAcceptPacket
+        {
+        protected:
+
+            template<typename> friend class PipelineSocketManageThread;
+
+            PacketPipeline *pipeline=nullptr;
+            bool pipe_closing=false;                                                                ///<已通知逻辑线程关闭，等待应答
+
+            bool OnRecvPacket(void *,const PACKET_SIZE_TYPE &) override final;                      ///<IO线程收包，转交逻辑线程
+
+        public:
+
+            using TCPAcceptPacket::TCPAcceptPacket;
+            virtual ~PipelineAccept()=default;
+
+            virtual bool UseSocket(int,const IPAddress *) override;
+
+        public: //逻辑线程
+
+            virtual bool OnLogicPacket(void *,const PACKET_SIZE_TYPE &)=0;                          ///<逻辑线程收包事件
+            virtual void OnLogicClose(){}                                                           ///<逻辑线程连接关闭事件(此后不会再收到该连接的包)
+
+                    bool PostPacket(const void *,const PACKET_SIZE_TYPE &);                         ///<从逻辑线程发包(数据会被复制)
+        };//class PipelineAccept:public TCPAcceptPacket
+
+        /**
+         * 逻辑线程
+         */
+        class PipelineLogicThread:public Thread
+        {
+            PacketPipeline *pipeline;
+            double wait_time;
+
+        public:
+
+            PipelineLogicThread(PacketPipeline *pp,const double wt=HGL_SOCKET_MANAGE_WAIT_TIME)
+            {
+                pipeline=pp;
+                wait_time=wt;
+            }
+
+            virtual ~PipelineLogicThread()=default;
+
+            bool Execute() override;
+        };//class PipelineLogicThread:public Thread
+
+        /**
+         * IO线程，自带一个配对的逻辑线程
+         */
+        template<typename USER_ACCEPT> class PipelineSocketManageThread:public SocketManageThread<USER_ACCEPT>
+        {
+            using BaseThread=SocketManageThread<USER_ACCEPT>;
+
+        protected:
+
+            PacketPipeline *pipeline;
+            PipelineLogicThread *logic_thread;
+
+        protected:
+
+            void OnPrepareJoin(USER_ACCEPT *us) override
+            {
+                us->pipeline=pipeline;
+                us->pipe_closing=false;
+            }
+
+            /**
+             * 连接出错时先通知逻辑线程，收到应答后才回收
+             */
+            void OnSocketError(USER_ACCEPT *us) override
+            {
+                if(us->pipe_closing)
+                    return;
+
+                us->pipe_closing=true;
+
+                PipeMessage msg;
+
+                msg.type=PipeMessageType::Close;
+                msg.accept=us;
+                msg.data=nullptr;
+                msg.size=0;
+
+                pipeline->PostInbound(msg);
+            }
+
+            /**
+             * 处理逻辑线程发来的包与关闭应答
+             */
+            void ProcOutbound()
+            {
+                PipeMessage msg;
+
+                while(pipeline->PopOutbound(msg))
+                {
+                    USER_ACCEPT *us=(USER_ACCEPT *)(msg.accept);
+
+                    if(msg.type==PipeMessageType::Packet)
+                    {
+                        if(!us->pipe_closing)
+                            us->SendPacket(msg.data,msg.size);
+
+                        delete[] msg.data;
+                    }
+                    else
+                    {
+                        BaseThread::OnSocketClear(us);                  //逻辑线程已经不会再引用它了
+                    }
+                }
+            }
+
+        public:
+
+            PipelineSocketManageThread(SocketManage *sm):BaseThread(sm)
+            {
+                pipeline=new PacketPipeline(sm);
+                logic_thread=new PipelineLogicThread(pipeline);
+            }
+
+            virtual ~PipelineSocketManageThread()
+            {
+                delete logic_thread;
+                delete pipeline;
+            }
+
+            bool ProcStartThread() override
+            {
+                return logic_thread->Start();
+            }
+
+            void ProcEndThread() override
+            {
+                logic_thread->Close();
+
+                //逻辑线程已经退出，剩下的消息由本线程处理
+                PipeMessage msg;
+
+                ProcOutbound();
+
+                pipeline->FlushInbound();
+
+                while(pipeline->PopInbound(msg))
+                {
+                    if(msg.type==PipeMessageType::Packet)
+                        delete[] msg.data;
+                    else
+                        BaseThread::OnSocketClear((USER_ACCEPT *)(msg.accept));
+                }
+
+                BaseThread::ProcEndThread();
+            }
+
+            bool Execute() override
+            {
+                BaseThread::Execute();
+
+                ProcOutbound();
+
+                pipeline->FlushInbound();           //本轮收到的包一次性通知逻辑线程
+
+                return(true);
+            }
+        };//template<typename USER_ACCEPT> class PipelineSocketManageThread
+
+        template<typename USER_ACCEPT>
+        using MTTCPServerPipeline=MTTCPServer<USER_ACCEPT,PipelineSocketManageThread<USER_ACCEPT>>;
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_PACKET_PIPELINE_INCLUDE
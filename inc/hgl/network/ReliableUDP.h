@@ -0,0 +1,245 @@
+﻿#ifndef HGL_NETWORK_RELIABLE_UDP_INCLUDE
+#define HGL_NETWORK_RELIABLE_UDP_INCLUDE
+
+#include<hgl/network/UdpSocket.h>
+#include<hgl/type/List.h>
+#include<hgl/type/Map.h>
+#include<hgl/type/DataArray.h>
+namespace hgl
+{
+    namespace network
+    {
+        constexpr uint HGL_RUDP_HEADER_SIZE     =22;                                                ///<每个分段的头长度
+        constexpr uint HGL_RUDP_DEFAULT_MTU     =1200;                                              ///<缺省数据报长度(移动网络与IPv6下均不会被分片)
+        constexpr uint HGL_RUDP_MAX_MTU         =1472;                                              ///<最大数据报长度(以太网1500减去IPv4与UDP头)
+        constexpr uint HGL_RUDP_MAX_FRAGMENT    =255;                                               ///<一条消息最多分段数
+
+        /**
+         * 可靠UDP会话参数
+         */
+        struct RUDPConfig
+        {
+            uint    mtu             =HGL_RUDP_DEFAULT_MTU;                                          ///<一个数据报的最大长度(含包头)
+
+            uint    send_window     =256;                                                           ///<发送窗口(分段数)
+            uint    recv_window     =256;                                                           ///<接收窗口(分段数，不能小于HGL_RUDP_MAX_FRAGMENT)
+
+            uint    interval        =10;                                                            ///<有数据在途时的刷新间隔(毫秒)
+            uint    min_rto         =30;                                                            ///<最小重传超时(毫秒)
+            uint    max_rto         =10000;                                                         ///<最大重传超时(毫秒)
+            uint    fast_resend     =2;                                                             ///<被后续分段的ACK跨过多少次后立即重传(0表示不使用快速重传)
+            uint    dead_link       =20;                                                            ///<同一分段重传多少次后视为断线
+
+            bool    congestion      =true;                                                          ///<是否使用拥塞控制(慢启动/拥塞避免，关闭则只受双方窗口限制)
+            bool    pacing          =true;                                                          ///<是否按估算的速率平滑发送(避免一个刷新间隔内突发整个窗口)
+
+            double  keep_alive      =1;                                                             ///<空闲多久发送一次心跳(秒)
+            double  idle_time_out   =10;                                                            ///<多久没有收到数据视为断线(秒，<=0表示不检测)
+        };//struct RUDPConfig
+
+        /**
+         * 可靠UDP会话统计
+         */
+        struct RUDPSessionStats
+        {
+            uint64 send_segments    =0;                                                             ///<首次发送的数据分段数
+            uint64 timeout_resend   =0;                                                             ///<超时重传次数
+            uint64 fast_resend      =0;                                                             ///<快速重传次数
+            uint64 recv_segments    =0;                                                             ///<收到的数据分段数
+            uint64 dup_segments     =0;                                                             ///<收到的重复分段数
+            uint64 send_datagrams   =0;                                                             ///<发出的数据报数
+            uint64 recv_datagrams   =0;                                                             ///<收到的数据报数
+        };//struct RUDPSessionStats
+
+        struct RUDPSegment;
+        class RUDPEndpoint;
+
+        /**
+         * 可靠UDP会话(KCP风格ARQ)<br>
+         * 每个分段独立确认(选择确认)，同时携带累计确认una；被后续ACK跨过fast_resend次的分段立即重传。<br>
+         * 有序消息按序号交付，无序消息到达即交付(仍然可靠，但不被前面丢失的分段阻塞)。<br>
+         * 会话由RUDPEndpoint持有与驱动，所有函数只能在RUDPEndpoint所在线程调用。
+         */
+        class RUDPSession
+        {
+            friend class RUDPEndpoint;
+
+            struct AckItem
+            {
+                uint32 sn;
+                uint32 ts;
+            };
+
+        protected:
+
+            RUDPEndpoint *endpoint=nullptr;
+            IPAddress *address=nullptr;                                                             ///<对方地址(收到同一会话号的数据报时跟随更新，以支持NAT重绑定/网络切换)
+            uint32 conv=0;                                                                          ///<会话号
+
+            RUDPConfig config;
+            uint mss=0;                                                                             ///<一个分段的最大数据长度
+
+            uint32 snd_una=0;                                                                       ///<最早未确认的序号
+            uint32 snd_nxt=0;                                                                       ///<下一个分配的序号
+            uint32 rcv_nxt=0;                                                                       ///<下一个等待交付的序号
+            uint32 rmt_wnd=0;                                                                       ///<对方剩余接收窗口
+
+            List<RUDPSegment *> snd_queue;                                                          ///<等待进入发送窗口的分段
+            List<RUDPSegment *> snd_buf;                                                            ///<已发出未确认的分段(按序号排列)
+            List<RUDPSegment *> rcv_buf;                                                            ///<已收到未交付的分段(按序号排列)
+            List<RUDPSegment *> free_list;                                                          ///<可重复使用的分段
+
+            List<AckItem> ack_list;                                                                 ///<待发送的ACK
+            DataArray<uint8> message;                                                               ///<正在重组的有序消息
+
+            int32  srtt=0;                                                                          ///<平滑RTT(毫秒)
+            int32  rttvar=0;
+            uint32 rto=0;                                                                           ///<当前重传超时(毫秒)
+
+            double cwnd=0;                                                                          ///<拥塞窗口(分段数)
+            double ssthresh=0;                                                                      ///<慢启动阈值(分段数)
+            uint32 recover=0;                                                                       ///<上次缩小窗口时的snd_nxt，una越过它之前不再缩小(一个窗口内的多个丢包只算一次)
+
+            double pacing_tokens=0;                                                                 ///<可发送的字节配额
+            uint32 pacing_time=0;                                                                   ///<上次补充配额的时间
+
+            uint32 last_recv_time=0;
+            uint32 last_ack_time=0;                                                                 ///<最近一次有新数据被确认的时间
+            uint32 last_send_time=0;
+            uint32 next_flush_time=0;
+
+            bool send_ping=false;
+            bool send_pong=false;
+            bool closed=false;                                                                      ///<已关闭，等待Endpoint移除
+            bool input_pending=false;                                                               ///<本批数据报中收到过数据，处理完这一批后统一Flush
+
+            RUDPSessionStats stats;
+
+        private:
+
+            RUDPSegment *AllocSegment();
+            void FreeSegment(RUDPSegment *);
+            void FreeList(List<RUDPSegment *> &);
+
+            void Attach(RUDPEndpoint *,uint32,const IPAddress *,const RUDPConfig &,uint32);
+
+            void UpdateRTT(int32);
+            int  ParseUna(uint32);
+            int  ParseAck(uint32);
+            void ParseFastAck(uint32);
+            bool ParseData(uint8,uint8,uint32,const uint8 *,uint);
+            bool Deliver(const uint8 *,uint);
+            void DeliverOrdered();
+
+            bool Input(const uint8 *,uint,uint32);
+            void Flush(uint32);
+            void Update(uint32);
+
+            uint32 GetWaitTime(uint32)const;
+
+        public: //事件函数
+
+            virtual bool OnRecvPacket(void *,uint)=0;                                               ///<收到一条完整消息(返回false关闭会话)
+            virtual void OnClose(){}                                                                ///<会话关闭(之后由Endpoint删除)
+
+        public:
+
+            RUDPSession()=default;
+            virtual ~RUDPSession();
+
+            const uint32            GetConv()const{return conv;}                                    ///<取得会话号
+            const IPAddress *       GetAddress()const{return address;}                              ///<取得对方当前地址
+            const RUDPSessionStats &GetStats()const{return stats;}                                  ///<取得统计数据
+
+            const int GetSRTT()const{return srtt;}                                                  ///<取得平滑RTT(毫秒)
+            const int GetRTO()const{return rto;}                                                    ///<取得当前重传超时(毫秒)
+            const int GetCWnd()const{return int(cwnd);}                                             ///<取得拥塞窗口(分段数)
+            const int GetWaitSendCount()const{return snd_queue.GetCount()+snd_buf.GetCount();}      ///<取得未确认与等待发送的分段数(可用于限制发送速度)
+            const uint GetMaxMessageSize()const{return mss*HGL_RUDP_MAX_FRAGMENT;}                  ///<取得一条有序消息的最大长度
+
+            const bool IsClosed()const{return closed;}
+
+            /**
+             * 发送一条消息
+             * @param data 数据
+             * @param size 长度
+             * @param ordered 是否有序(无序消息不能超过一个分段，即mtu-HGL_RUDP_HEADER_SIZE)
+             * @return 是否成功放入发送队列(在下一个刷新间隔或Flush时发出)
+             */
+            bool Send(const void *data,uint size,bool ordered=true);
+
+            void Flush();                                                                           ///<立即发送队列中的数据
+            void Close();                                                                           ///<关闭会话(通知对方，不等待未确认的数据)
+        };//class RUDPSession
+
+        /**
+         * 可靠UDP端点，一个UDPSocket上承载多个会话(按会话号区分)<br>
+         * 收发使用RecvPackets/SendPackets批量系统调用，可通过SocketManage::JoinDatagram与TCP连接共用同一个轮循线程，
+         * 重传与心跳由ProcUpdate驱动(SocketManage每次Update时调用)。<br>
+         * 服务端重载CreateSession接受新会话，客户端调用Connect加入自己创建的会话。会话对象由Endpoint持有。
+         */
+        class RUDPEndpoint:public UDPSocket
+        {
+            friend class RUDPSession;
+
+            RUDPConfig config;
+
+            Map<uint32,RUDPSession *> session_map;
+            List<RUDPSession *> session_list;
+
+            double start_time;
+
+            UDPPacket recv_list[HGL_UDP_BATCH_COUNT];
+            DataArray<uint8> recv_buffer;
+
+            UDPPacket send_list[HGL_UDP_BATCH_COUNT];
+            DataArray<uint8> send_buffer;
+            int send_count;
+
+        private:
+
+            const uint32 GetTime(const double)const;
+
+            uint8 *BeginDatagram();                                                                 ///<取得一个数据报的写入空间(mtu字节)
+            void EndDatagram(uint8 *,uint,IPAddress *);                                             ///<提交一个写好的数据报
+            void FlushDatagram();                                                                   ///<发出所有已提交的数据报
+
+            void Input(UDPPacket &,uint32);
+            void RemoveClosed();
+
+        protected:
+
+            /**
+             * 收到未知会话号的数据报时调用(服务端重载以接受新会话)
+             * @return 新建的会话对象(由Endpoint持有)，nullptr表示拒绝
+             */
+            virtual RUDPSession *CreateSession(uint32 conv,const IPAddress *addr){return nullptr;}
+
+        public:
+
+            RUDPEndpoint();
+            virtual ~RUDPEndpoint();
+
+            bool Create(const IPAddress *) override;
+
+            void SetConfig(const RUDPConfig &);                                                     ///<设置之后新加入的会话使用的参数
+            const RUDPConfig &GetConfig()const{return config;}
+
+            const int GetSessionCount()const{return session_list.GetCount();}
+
+            /**
+             * 加入一个客户端会话
+             * @param session 会话对象(之后由Endpoint持有)
+             * @param conv 会话号(双方一致，同一Endpoint中不能重复)
+             * @param addr 服务端地址
+             */
+            bool Connect(RUDPSession *session,uint32 conv,const IPAddress *addr);
+
+            RUDPSession *GetSession(uint32 conv)const;
+
+            int    ProcRecv(int=-1) override;                                                       ///<接收一批数据报并分发给各会话，返回收到的数据报数
+            double ProcUpdate(const double) override;                                               ///<处理重传、心跳与超时，返回距离下一次需要调用的时间(秒)
+        };//class RUDPEndpoint
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_RELIABLE_UDP_INCLUDE
@@ -1,7 +1,7 @@
 #ifndef HGL_NETWORK_SCTP_SOCKET_INCLUDE
 #define HGL_NETWORK_SCTP_SOCKET_INCLUDE
 
-#include<hgl/network/Socket.h>
+#include<hgl/network/DatagramSocket.h>
 #include<hgl/MemBlock.h>
 #include<netinet/sctp.h>
 namespace hgl
@@ -11,7 +11,7 @@ namespace hgl
         /**
          * sctp socket功能基类
          */
-        class SCTPSocket:public Socket
+        class SCTPSocket:public DatagramSocket
         {
         protected:
 
@@ -26,12 +26,6 @@ namespace hgl
             bool InitDataIOEvent();
             bool InitMsg(int out_stream=0,int in_stream=0,int attempts=0,int init_time_out=0);
 
-        protected:
-
-            void ProcDisconnect()=default;
-            int ProcRecv(int)=default;
-            int ProcSend(int,int &)=default;
-
         public:
 
             virtual bool SetNodelay(bool);                                                          ///<设置是否使用无延迟方式
@@ -0,0 +1,112 @@
+#ifndef HGL_NETWORK_SCTP_STREAM_SERVER_INCLUDE
+#define HGL_NETWORK_SCTP_STREAM_SERVER_INCLUDE
+
+#include<hgl/network/SCTPServer.h>
+#include<hgl/type/List.h>
+#include<hgl/type/DataArray.h>
+namespace hgl
+{
+    namespace network
+    {
+        constexpr uint HGL_SCTP_RECV_BLOCK_SIZE     =HGL_SIZE_1KB*64;       ///<SCTPStreamServer单次sctp_recvmsg使用的缓冲区大小
+        constexpr uint HGL_SCTP_MAX_MESSAGE_SIZE    =HGL_SIZE_1MB;          ///<缺省一条消息的最大长度(超过的关联会被中止)
+        constexpr uint HGL_SCTP_RECV_BATCH_COUNT    =64;                    ///<一次ProcRecv最多读取的消息数
+
+        /**
+         * 收到的一条SCTP消息
+         */
+        struct SCTPMessage
+        {
+            sctp_assoc_t        assoc;                                      ///<关联编号
+            uint16              stream;                                     ///<流编号
+            uint32              ppid;                                       ///<净荷协议标识符(已转为本机字节序)
+            bool                unordered;                                  ///<是否以无序方式发送
+
+            const sockaddr_in * from;                                       ///<来源地址(最后一个分片的来源)
+
+            void *              data;
+            uint                size;
+        };//struct SCTPMessage
+
+        /**
+         * 一个SCTP流的消息处理器
+         */
+        class SCTPStreamHandler
+        {
+        public:
+
+            virtual ~SCTPStreamHandler()=default;
+
+            virtual bool OnMessage(const SCTPMessage &)=0;                  ///<收到一条消息(数据只在本次调用中有效，返回false中止该关联)
+        };//class SCTPStreamHandler
+
+        /**
+         * SCTP一对多服务器，由SocketManage驱动<br>
+         * 通过SocketManage::JoinDatagram与TCP连接在同一个轮循中处理，按关联与流分发消息：设置了流处理器的流交给处理器，其余调用OnRecvMessage。<br>
+         * 使用SCTP_FRAGMENT_INTERLEAVE，不同关联、不同流的大消息分片可以交错到达，各自重组，一个流上的大消息不会阻塞其它流。<br>
+         * 完整到达的消息直接在复用的接收缓冲区中交付，只有被拆开的消息才会复制到重组缓冲区(重组缓冲区也会复用)。
+         */
+        class SCTPStreamServer:public SCTPO2MServer
+        {
+            struct PartialMessage
+            {
+                sctp_assoc_t assoc;
+                uint16 stream;
+                DataArray<char> data;
+            };
+
+            DataArray<char> recv_buffer;                                    ///<接收缓冲区(所有消息共用)
+            sockaddr_in recv_addr;
+
+            List<PartialMessage *> partial_list;                            ///<正在重组的消息
+            List<PartialMessage *> partial_pool;                            ///<可复用的重组缓冲区
+
+            List<SCTPStreamHandler *> handler_list;                         ///<按流编号索引的处理器(不持有)
+
+            uint max_message_size=HGL_SCTP_MAX_MESSAGE_SIZE;
+
+        private:
+
+            PartialMessage *FindPartial(sctp_assoc_t,uint16)const;
+            void ReleasePartial(PartialMessage *);
+            void ClearPartial(sctp_assoc_t);
+
+            void ProcNotification(const void *,int);
+            void ProcData(const sctp_sndrcvinfo &,int,int);
+            void Dispatch(SCTPMessage &);
+
+        public: //事件函数
+
+            virtual bool OnRecvMessage(const SCTPMessage &){return(true);}                          ///<收到没有设置处理器的流上的消息(返回false中止该关联)
+            virtual void OnAssocUp(sctp_assoc_t,uint16 out_streams,uint16 in_streams){}             ///<关联建立(或重启)
+            virtual void OnAssocDown(sctp_assoc_t){}                                                ///<关联断开
+
+        public:
+
+            SCTPStreamServer();
+            virtual ~SCTPStreamServer();
+
+            using SCTPO2MServer::CreateServer;
+
+            bool CreateServer(const sockaddr_in &,const uint ml=HGL_SERVER_LISTEN_COUNT) override;  ///<创建服务器(非阻塞，可加入SocketManage)
+            void CloseServer() override;
+
+            void SetMaxMessageSize(const uint size){max_message_size=size;}                         ///<设置一条消息的最大长度
+            void SetStreamHandler(const uint16 stream,SCTPStreamHandler *);                         ///<设置一个流的处理器(nullptr表示交给OnRecvMessage)
+
+            /**
+             * 向一个关联的指定流发送一条消息
+             * @param assoc 关联编号
+             * @param stream 流编号
+             * @param ordered 是否在流内保持顺序(无序消息到达即交付，不等待同一流中之前的消息)
+             * @param ppid 净荷协议标识符
+             */
+            bool Send(sctp_assoc_t assoc,uint16 stream,const void *data,int size,bool ordered=true,uint32 ppid=0);
+
+            void Abort(sctp_assoc_t);                                                               ///<中止一个关联
+
+            int ProcRecv(int=-1) override;                                                          ///<读取并分发一批消息，返回读取到的消息数
+        };//class SCTPStreamServer
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_SCTP_STREAM_SERVER_INCLUDE
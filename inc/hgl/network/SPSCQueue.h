@@ -0,0 +1,85 @@
+﻿#ifndef HGL_NETWORK_SPSC_QUEUE_INCLUDE
+#define HGL_NETWORK_SPSC_QUEUE_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 单生产者单消费者无锁环形队列<br>
+         * Push只能在一个线程中调用，Pop只能在另一个线程中调用
+         */
+        template<typename T> class SPSCQueue
+        {
+            T *ring;
+            uint capacity;                                                                          ///<容量(2的幂)
+            uint mask;
+
+            alignas(64) std::atomic<uint> head;                                                     ///<消费者读取位置
+            alignas(64) std::atomic<uint> tail;                                                     ///<生产者写入位置
+
+        public:
+
+            SPSCQueue(uint count)
+            {
+                capacity=1;
+
+                while(capacity<count)
+                    capacity<<=1;
+
+                mask=capacity-1;
+                ring=new T[capacity];
+
+                head.store(0,std::memory_order_relaxed);
+                tail.store(0,std::memory_order_relaxed);
+            }
+
+            ~SPSCQueue()
+            {
+                delete[] ring;
+            }
+
+            const uint GetCapacity()const{return capacity;}                                         ///<取得容量
+
+            /**
+             * 压入一个数据(生产者线程调用)
+             * @return 队列已满时返回false
+             */
+            bool Push(const T &value)
+            {
+                const uint t=tail.load(std::memory_order_relaxed);
+
+                if(t-head.load(std::memory_order_acquire)>=capacity)
+                    return(false);
+
+                ring[t&mask]=value;
+                tail.store(t+1,std::memory_order_release);
+                return(true);
+            }
+
+            /**
+             * 弹出一个数据(消费者线程调用)
+             * @return 队列为空时返回false
+             */
+            bool Pop(T &value)
+            {
+                const uint h=head.load(std::memory_order_relaxed);
+
+                if(h==tail.load(std::memory_order_acquire))
+                    return(false);
+
+                value=ring[h&mask];
+                head.store(h+1,std::memory_order_release);
+                return(true);
+            }
+
+            bool IsEmpty()const
+            {
+                return head.load(std::memory_order_acquire)==tail.load(std::memory_order_acquire);
+            }
+        };//template<typename T> class SPSCQueue
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_SPSC_QUEUE_INCLUDE
@@ -0,0 +1,97 @@
+﻿#ifndef HGL_NETWORK_SEND_QUEUE_INCLUDE
+#define HGL_NETWORK_SEND_QUEUE_INCLUDE
+
+#include<hgl/type/List.h>
+#include<hgl/network/SharedBuffer.h>
+namespace hgl
+{
+    namespace network
+    {
+        class SocketOutputStream;
+
+        constexpr uint HGL_SEND_QUEUE_BLOCK_SIZE=HGL_SIZE_1KB*16;                                  ///<发送队列单个数据块默认大小
+        constexpr uint HGL_ZERO_COPY_THRESHOLD  =HGL_SIZE_1KB*64;                                  ///<零拷贝发送缺省的最小数据长度(更小的数据复制的开销比锁定内存更低)
+
+        /**
+         * 发送队列<br>
+         * 非阻塞socket一次发不完的数据暂存于此，待socket可写时(EPOLLOUT)再继续发送。<br>
+         * 数据按块存放，小数据会追加到最后一块的剩余空间中，大数据单独占一块。<br>
+         * 共享数据块(SharedBuffer)直接作为一块挂入队列，只持有引用不复制，发完后释放引用。<br>
+         * 文件数据也作为一块挂入队列，轮到它时由SocketOutputStream::WriteFile直接从文件发出，与前后的内存数据保持顺序。<br>
+         * 开启零拷贝后，足够大的共享数据块以MSG_ZEROCOPY发出，队列为每次发送多持有一个引用，收到内核的完成通知后才释放。
+         */
+        class SendQueue
+        {
+            struct Block
+            {
+                uchar *data;
+                uint capacity;                                                                      ///<块容量
+                uint start;                                                                         ///<未发送数据起始位置
+                uint end;                                                                           ///<数据结束位置
+
+                SharedBuffer *shared;                                                               ///<共享数据块(不为nullptr时data指向其中，不可追加)
+
+                int file;                                                                           ///<文件句柄(>=0时为文件块，没有data)
+                int64 file_offset;                                                                  ///<文件中未发送数据的位置(<0表示从当前位置读取)
+                int64 file_left;                                                                    ///<文件中未发送的字节数
+                bool file_close;                                                                    ///<发完或清除时关闭文件
+
+            public:
+
+                const int64 GetBytes()const{return file>=0?file_left:int64(end-start);}           ///<未发送的字节数
+            };//struct Block
+
+            List<Block> block_list;
+            int first;                                                                              ///<第一个有数据的块
+
+            int64 total_bytes;                                                                      ///<队列中未发送的字节数
+
+            struct ZeroCopyItem
+            {
+                SharedBuffer *buffer;
+                uint32 seq;                                                                         ///<内核为这次发送分配的序号
+            };
+
+            uint zero_copy_threshold;                                                               ///<零拷贝发送的最小长度(0表示不使用)
+            uint32 zero_copy_seq;                                                                   ///<下一次零拷贝发送的序号(与内核的计数一致，每个socket从0开始)
+            List<ZeroCopyItem> zero_copy_list;                                                      ///<已发出还未收到完成通知的数据
+
+        private:
+
+            Block *AppendBlock(uint);
+            void Consume(int64);
+            void Compact();
+
+            static void FreeBlock(Block *);
+
+            void ClearZeroCopy();
+
+        public:
+
+            SendQueue();
+            ~SendQueue();
+
+            const   int64   GetBytes()const{return total_bytes;}                                    ///<取得队列中未发送的字节数
+            const   bool    IsEmpty()const{return total_bytes<=0;}                                  ///<队列是否为空
+
+                    bool    Append(const void *,const uint);                                        ///<追加数据到队列尾部
+                    bool    Append(SharedBuffer *,const uint offset=0);                             ///<以引用方式追加共享数据块(从offset开始的部分)
+                    bool    Append(SharedBuffer *,const uint start,const uint end);                 ///<以引用方式追加共享数据块中[start,end)的部分
+                    bool    AppendFile(int fd,int64 offset,int64 size,bool close_fd);               ///<追加文件中的一段数据(不读出，发送时直接从文件发出)
+
+                    int64   Flush(SocketOutputStream *);                                            ///<尽可能多的将队列中的数据发出(多块数据合并为一次writev)
+
+                    void    SetZeroCopy(uint threshold){zero_copy_threshold=threshold;}             ///<设置零拷贝发送的最小长度(0表示不使用，socket需已开启SO_ZEROCOPY)
+            const   uint    GetZeroCopyThreshold()const{return zero_copy_threshold;}
+            const   bool    IsZeroCopy()const{return zero_copy_threshold>0||!zero_copy_list.IsEmpty();}   ///<是否使用零拷贝或还有未完成的零拷贝发送
+            const   int     GetZeroCopyPending()const{return zero_copy_list.GetCount();}           ///<取得还未收到完成通知的零拷贝发送次数
+
+                    void    AddZeroCopy(SharedBuffer *);                                            ///<记录一次零拷贝发送(持有一个引用直到完成)
+                    int     CompleteZeroCopy(uint32 lo,uint32 hi);                                  ///<处理完成通知，释放序号在[lo,hi]之间的数据
+
+                    void    Clear();                                                                ///<清空队列(保留一个数据块以备再用，socket已关闭或更换时调用)
+                    void    Free();                                                                 ///<清空队列并释放所有数据块
+        };//class SendQueue
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_SEND_QUEUE_INCLUDE
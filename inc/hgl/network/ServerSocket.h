@@ -23,15 +23,19 @@ namespace hgl
             ServerSocket();
             virtual ~ServerSocket();
 
+            const   int        GetSocket()const{return ThisSocket;}                                 ///<取得监听socket
             const   IPAddress *GetServerAddress()const{return server_address;}                      ///<取得服务器IP地址
                     IPAddress *CreateIPAddress()const
                                 {return server_address?server_address->Create():nullptr;}           ///<创建一个空的IP地址空间
 
                     bool       CreateIPAddress(IPAddress **ip_buffer,int count)const;               ///<创建多个空的IP地址空间
 
-            virtual bool CreateServer(const IPAddress *,const uint ml=HGL_SERVER_LISTEN_COUNT,bool reuse=false);        ///<创建服务器
+            virtual bool CreateServer(const IPAddress *,const uint ml=HGL_SERVER_LISTEN_COUNT,bool reuse=false,bool reuse_port=false);  ///<创建服务器
             virtual void CloseServer();                                                                                 ///<关闭服务器
 
+                    bool AttachServer(int,const IPAddress *);                                       ///<使用一个已在监听的socket(如热重启时旧进程转交过来的)
+                    int  DetachServer();                                                            ///<放弃监听socket的所有权(不关闭)，返回该socket
+
                     /**
                     * 设置是否使用堵塞方式传输
                     * @param block 是否使用堵塞方式(true/false)
@@ -0,0 +1,160 @@
+﻿#ifndef HGL_NETWORK_SHARED_BUFFER_INCLUDE
+#define HGL_NETWORK_SHARED_BUFFER_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 引用计数的只读数据块<br>
+         * 用于广播:同一份已编码好的数据(WebSocket帧、数据包等)只生成一次，直接挂到多个连接的发送队列中，不再逐个复制。<br>
+         * 创建后先填写数据，交出去之后不可再修改。引用计数是原子的，可以跨线程共享。<br>
+         * Acquire从进程级的池中取得数据块(容量按2的幂分级)，引用全部释放后回到池中，可在任意线程释放。
+         */
+        class SharedBuffer
+        {
+            std::atomic<int> ref_count;
+            uint size;
+            uint pool_level;                                                                        ///<所属池的级别(0表示直接分配)
+            uint reserved;                                                                          ///<保持头部16字节，数据对齐
+
+        private:
+
+            SharedBuffer(uint s,uint level):ref_count(1),size(s),pool_level(level),reserved(0){}
+            ~SharedBuffer()=default;
+
+            friend class SharedBufferPool;
+
+        public:
+
+            static SharedBuffer *Create(const uint size);                                           ///<创建一个数据块(引用计数为1)
+            static SharedBuffer *Create(const void *data,const uint size);                          ///<创建一个数据块并复制数据进去(引用计数为1)
+            static SharedBuffer *Acquire(const uint size);                                          ///<从池中取得一个至少size字节的数据块(GetSize为实际容量，引用计数为1)
+
+                    uchar * GetData(){return (uchar *)(this+1);}                                    ///<取得数据指针(仅在交出去之前用于填写)
+            const   uchar * GetData()const{return (const uchar *)(this+1);}
+            const   uint    GetSize()const{return size;}
+
+            SharedBuffer *AddRef()
+            {
+                ref_count.fetch_add(1,std::memory_order_relaxed);
+                return this;
+            }
+
+            const bool IsShared()const{return ref_count.load(std::memory_order_acquire)>1;}        ///<是否还有其它引用(没有时持有者可以改写数据)
+
+            void Release();                                                                         ///<释放一个引用，为0时删除或回到池中
+        };//class SharedBuffer
+
+        /**
+         * 数据块中一段数据(一个包)的引用<br>
+         * 复制时增加数据块的引用计数，不复制数据，可以保存、放入队列、交给其它线程或直接挂到其它连接的发送队列中。
+         * 包头紧挨在数据之前，GetFrameData/GetFrameSize取得含包头的完整包，用于原样转发。
+         */
+        class PacketRef
+        {
+            SharedBuffer *block=nullptr;
+            uint offset=0;                                                                          ///<包体在数据块中的位置
+            uint size=0;                                                                            ///<包体长度
+            uint header_size=0;                                                                     ///<包体之前的包头长度
+            int64 recv_time=0;                                                                      ///<内核接收时间戳(纳秒，0表示没有)
+
+        public:
+
+            PacketRef()=default;
+            PacketRef(SharedBuffer *sb,const uint off,const uint s,const uint hs=0,const int64 rt=0)    ///<引用sb中的一段数据(增加一个引用)
+            {
+                block=(sb?sb->AddRef():nullptr);
+                offset=off;
+                size=s;
+                header_size=hs;
+                recv_time=rt;
+            }
+
+            PacketRef(const PacketRef &pr):PacketRef(pr.block,pr.offset,pr.size,pr.header_size,pr.recv_time){}
+            PacketRef(PacketRef &&pr)noexcept
+            {
+                block=pr.block;
+                offset=pr.offset;
+                size=pr.size;
+                header_size=pr.header_size;
+                recv_time=pr.recv_time;
+
+                pr.block=nullptr;
+                pr.size=0;
+            }
+
+            ~PacketRef(){Clear();}
+
+            PacketRef &operator=(const PacketRef &pr)
+            {
+                if(this!=&pr)
+                {
+                    if(pr.block)pr.block->AddRef();
+
+                    Clear();
+
+                    block=pr.block;
+                    offset=pr.offset;
+                    size=pr.size;
+                    header_size=pr.header_size;
+                    recv_time=pr.recv_time;
+                }
+
+                return *this;
+            }
+
+            PacketRef &operator=(PacketRef &&pr)noexcept
+            {
+                if(this!=&pr)
+                {
+                    Clear();
+
+                    block=pr.block;
+                    offset=pr.offset;
+                    size=pr.size;
+                    header_size=pr.header_size;
+                    recv_time=pr.recv_time;
+
+                    pr.block=nullptr;
+                    pr.size=0;
+                }
+
+                return *this;
+            }
+
+            void Clear()                                                                            ///<释放引用
+            {
+                if(block)
+                {
+                    block->Release();
+                    block=nullptr;
+                }
+
+                size=0;
+            }
+
+            const   bool            IsEmpty()const{return !block;}
+
+                    SharedBuffer *  GetBuffer()const{return block;}                                 ///<取得所在的数据块(不增加引用)
+            const   uint            GetOffset()const{return offset;}                                ///<取得包体在数据块中的位置
+            const   uint            GetHeaderSize()const{return header_size;}
+
+            const   uchar *         GetData()const{return block?block->GetData()+offset:nullptr;}  ///<取得包体
+            const   uint            GetSize()const{return size;}                                    ///<取得包体长度
+
+            const   uchar *         GetFrameData()const{return block?block->GetData()+offset-header_size:nullptr;}    ///<取得含包头的完整包
+            const   uint            GetFrameOffset()const{return offset-header_size;}
+            const   uint            GetFrameSize()const{return header_size+size;}
+
+            /**
+             * 取得内核接收时间戳(纳秒，CLOCK_REALTIME，需开启延迟跟踪，同一次recv读到的包相同)
+             * @return 0表示没有
+             */
+            const   int64           GetRecvTime()const{return recv_time;}
+        };//class PacketRef
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_SHARED_BUFFER_INCLUDE
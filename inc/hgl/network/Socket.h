@@ -69,6 +69,12 @@ namespace hgl
         constexpr uint HGL_SERVER_OVERLOAD_RESUME_TIME =10;                                         ///<服务器超载再恢复等待时间
 
         constexpr uint HGL_TCP_BUFFER_SIZE             =HGL_SIZE_1KB*256;                           ///<TCP缓冲区大小
+        constexpr double HGL_SOCKET_MANAGE_WAIT_TIME   =1;                                          ///<SocketManageThread缺省最长等待时间(秒)
+        constexpr uint HGL_ACCEPT_POOL_MAX_COUNT       =1024;                                       ///<每个SocketManageThread缓存的接入对象最大数量
+        constexpr uint HGL_CROSS_SEND_QUEUE_SIZE       =HGL_SIZE_1KB*4;                             ///<每个SocketManageThread跨线程发送队列的长度
+        constexpr uint HGL_TCP_MAX_PACKET_SIZE         =HGL_TCP_BUFFER_SIZE*64;                     ///<TCPAcceptPacket缺省的最大包长(含包头，超出视为出错)
+        constexpr uint HGL_TCP_RECV_BLOCK_SIZE         =HGL_SIZE_1KB*64;                            ///<TCPAcceptPacket单次recv使用的缓冲区大小
+        constexpr uint HGL_UDP_BATCH_COUNT             =64;                                         ///<UDPSocket单次recvmmsg/sendmmsg最多处理的包数
 
         typedef  int32 HGL_PACKET_SIZE;                                                             ///<包长度数据类型定义
         typedef uint32 HGL_PACKET_TYPE;                                                             ///<包类型数据类型定义
@@ -91,11 +97,18 @@ namespace hgl
         void CloseSocket(int);                                                                      ///<关闭socket
 
         bool Connect(int,IPAddress *);                                                              ///<连接一个地址
+        bool Connect(int,IPAddress *,const double time_out);                                        ///<在指定时间内连接一个地址(time_out<=0时为阻塞连接)
+        int  StartConnect(int,IPAddress *);                                                         ///<发起非阻塞连接(socket需已是非阻塞)，返回1已连接，0正在连接，<0失败
+        int  GetConnectError(int);                                                                  ///<取得非阻塞连接完成后的结果(0表示连接成功)
+        void SetSocketNonBlock(int ThisSocket,bool non_block);                                      ///<只设置是否非阻塞(不改变收发超时)
         void SetSocketBlock(int ThisSocket,bool block,double send_time_out=HGL_NETWORK_TIME_OUT,
                                                     double recv_time_out=HGL_NETWORK_TIME_OUT);     ///<设置socket是否使用阻塞方式
 
         void SetSocketLinger(int ThisSocket,int time_out);                                          ///<设置Socket关闭时的确认数据发送成功超时时间
 
+        bool SetSocketRecvTimestamp(int ThisSocket,bool enable);                                    ///<设置是否记录内核接收时间戳(SO_TIMESTAMPING软件与硬件，仅Linux，硬件时间戳需网卡已开启)
+        int64 GetSocketTimestampNow();                                                              ///<取得与内核接收时间戳同一时钟(CLOCK_REALTIME)的当前时间(纳秒)
+
         const os_char *GetSocketString(int);
 
         #define GetLastSocketErrorString() GetSocketString(GetLastSocketError())
@@ -110,7 +123,7 @@ namespace hgl
         {
         protected:
 
-            IPAddress *ThisAddress;                                                                     ///<本Socket地址
+            SocketAddress ThisAddress;                                                                  ///<本Socket地址(值类型，不分配内存)
 
             bool InitSocket(const IPAddress *);                                                         ///<创建Socket
 
@@ -124,7 +137,7 @@ namespace hgl
             Socket(int,const IPAddress *);
             virtual ~Socket();
 
-            const   IPAddress *GetAddress()const{return ThisAddress;}                                   ///<取得当前Socket的IP地址
+            const   SocketAddress *GetAddress()const{return ThisAddress.IsValid()?&ThisAddress:nullptr;} ///<取得当前Socket的IP地址
 
             virtual bool    UseSocket(int,const IPAddress *);                                           ///<使用这个Socket与地址
 
@@ -7,15 +7,29 @@ namespace hgl
 {
     namespace network
     {
+        class TCPAccept;
+        class DatagramSocket;
+
+        constexpr uint SOCKET_EVENT_RECV    =0x01;                              ///<可以读数据
+        constexpr uint SOCKET_EVENT_SEND    =0x02;                              ///<可以发数据
+        constexpr uint SOCKET_EVENT_HUP     =0x04;                              ///<对方已关闭(缓冲区中可能还有数据，需先读完)
+        constexpr uint SOCKET_EVENT_ERROR   =0x08;                              ///<出错
+
+        constexpr uint SOCKET_EVENT_CLOSE   =SOCKET_EVENT_HUP|SOCKET_EVENT_ERROR;
+
+        /**
+         * 一个socket在一次轮循中的所有就绪事件<br>
+         * 同一socket的读、写、关闭合并在一个事件中，SocketManage按读、写、关闭的顺序一次处理完
+         */
         struct SocketEvent
         {
             int sock;
+            TCPAccept *accept;          //Socket所属的TCPAccept对象(由内核事件直接带回，无需再查表)
+            DatagramSocket *datagram;   //Socket所属的DatagramSocket对象(与accept只有一个不为nullptr)
 
-            union
-            {
-                int size;           //数据长度(此属性为BSD系统独有)
-                int error;          //错误号
-            };
+            uint events;                //SOCKET_EVENT_*组合
+            int size;                   //可读/可写的数据长度(仅BSD系统有效，其它为0)
+            int error;                  //错误号(有SOCKET_EVENT_CLOSE时有效)
         };//struct SocketEvent
 
         using SocketEventList=List<SocketEvent>;
@@ -8,18 +8,39 @@ namespace hgl
 
     namespace network
     {
+        constexpr uint HGL_SOCKET_INPUT_BUFFER_SIZE=HGL_SIZE_1KB*16;                            ///<SocketInputStream缺省的预读缓冲区大小
+
         /**
-        * Socket输入流，用于TCP／SCTP协议在无包封装处理的情况下
+        * Socket输入流，用于TCP／SCTP协议在无包封装处理的情况下<br>
+        * 缺省每次Read直接recv到调用者的缓冲区中。SetBuffer开启预读后，小的读取先以一次recv尽量填满内部缓冲区，
+        * 之后从缓冲区中取出，DataInputStream逐个字段读取时不再每个字段一次系统调用；不小于缓冲区的读取仍直接recv。<br>
+        * 开启预读后数据可能已在缓冲区中而socket不再可读，等待可读(select等)之前需先检查GetBufferedBytes<br>
+        * SetTimestamp开启后Read改用recvmsg，取得内核接收时间戳(socket需已用SetSocketRecvTimestamp开启)
         */
         class SocketInputStream:public io::InputStream
         {
         protected:
 
             int sock;
-            DataArray<char> *mb;
+            DataArray<char> *mb;                                                            ///<未开启预读时Skip使用的临时缓冲区(用到时才创建)
 
             int64 total;            //累计字节数
 
+            char *  read_buffer;                                                            ///<预读缓冲区(nullptr表示不预读)
+            uint    read_buffer_size;
+            uint    read_pos;                                                               ///<缓冲区中未读数据的起始位置
+            uint    read_end;                                                               ///<缓冲区中数据的结束位置
+
+            bool    recv_timestamp;                                                         ///<是否取得内核接收时间戳
+            int64   last_timestamp;                                                         ///<最近一次recv取得的时间戳(纳秒，0表示没有)
+
+        private:
+
+            int64   RecvOnce(void *,int64);                                                 ///<ReadFully中的一次recv
+            int64   RecvTimestamp(void *,int64);                                            ///<以recvmsg接收并取出时间戳
+            int64   FillBuffer();                                                           ///<以一次recv向缓冲区中追加数据
+            int64   TakeBuffer(void *,int64);                                               ///<从缓冲区中取出数据
+
         public:
 
             SocketInputStream(int=0);
@@ -29,10 +50,27 @@ namespace hgl
             {
                 sock=s;
                 total=0;
+                read_pos=0;
+                read_end=0;
+                last_timestamp=0;
             }
 
+            bool    SetBuffer(const uint size=HGL_SOCKET_INPUT_BUFFER_SIZE);                ///<设置预读缓冲区大小(0表示关闭，缓冲区中还有数据时不能缩小到放不下)
+            const   uint GetBufferSize()const{return read_buffer_size;}                     ///<取得预读缓冲区大小
+            const   uint GetBufferedBytes()const{return read_end-read_pos;}                 ///<取得已预读还未取走的字节数
+
             int64   GetTotal()const{return total;}                                          ///<取得累计字节数
 
+            void    SetTimestamp(const bool t){recv_timestamp=t;last_timestamp=0;}          ///<设置是否取得内核接收时间戳
+            const   bool IsTimestamp()const{return recv_timestamp;}
+
+            /**
+             * 取得最近一次从socket读到的数据的内核接收时间(纳秒，CLOCK_REALTIME，有硬件时间戳时为网卡时钟)<br>
+             * TCP一次读到多个分段时为其中最后一个分段的时间
+             * @return 0表示没有时间戳
+             */
+            const   int64 GetRecvTimestamp()const{return last_timestamp;}
+
             void    Close(){}                                                               ///<关闭输入流
 
             int64   Read(void *,int64);                                                     ///<从socket中读取指定的字节数
@@ -49,7 +87,7 @@ namespace hgl
             int64   Seek(int64,io::SeekOrigin=io::SeekOrigin::Begin){return -1;}            ///<移动访问指针
             int64   Tell()const{return -1;}                                                 ///<返回当前访问位置
             int64   GetSize()const{return -1;}                                              ///<取得流长度
-            int64   Available()const;                                                       ///<剩下的可以不受阻塞访问的字节数
+            int64   Available()const;                                                       ///<剩下的可以不受阻塞访问的字节数(开启预读且缓冲区中有数据时为缓冲区中的字节数)
         };//class SocketInputStream
     }//namespace network
 }//namespace hgl
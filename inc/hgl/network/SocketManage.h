@@ -1,66 +1,247 @@
 ﻿#ifndef HGL_NETWORK_SOCKET_MANAGE_INCLUDE
 #define HGL_NETWORK_SOCKET_MANAGE_INCLUDE
 
-#include<hgl/type/Map.h>
-#include<hgl/type/SortedSet.h>
 #include<hgl/network/SocketEvent.h>
 #include<hgl/network/TCPAccept.h>
+#include<hgl/network/BufferPool.h>
+#include<hgl/network/TimerWheel.h>
+#include<hgl/network/NetworkMetrics.h>
 namespace hgl
 {
     namespace network
     {
         class SocketManageBase;
+        class AcceptServer;
+        class DatagramSocket;
+        class HotRestartSender;
 
-        using TCPAcceptSet=SortedSet<TCPAccept *>;
+
+        /**
+         * 由监听socket接入的新连接
+         */
+        struct AcceptedSocket
+        {
+            int sock;
+            SocketAddress address;                                              ///<对方地址(值类型，接入时不分配内存也不生成字符串)
+        };
+
+        using AcceptedSocketList=List<AcceptedSocket>;
+
+        /**
+         * 跨线程转交的广播请求，每一项持有buffer的一个引用，处理完后由接收方释放
+         */
+        struct BroadcastItem
+        {
+            SharedBuffer *buffer;
+            TCPAccept *target;                                                  ///<目标连接(nullptr表示该管理器中的所有连接)
+        };
+
+        using BroadcastList=List<BroadcastItem>;
+
+        /**
+         * 忙轮循参数<br>
+         * 没有事件时不睡眠，以0超时反复轮循；连续空轮循一段时间后逐步退让，最终退回普通的阻塞等待
+         */
+        struct SocketBusyPollConfig
+        {
+            uint    spin_count          =100000;                                ///<连续空轮循多少次后开始退让
+            uint    yield_count         =10000;                                 ///<每次空轮循前让出CPU(yield)多少次后进入阻塞等待(0表示不退让直接阻塞)
+            double  idle_wait_time      =0.001;                                 ///<退让结束后每次阻塞等待的最长时间(秒，<0表示使用Update传入的时间)
+
+            uint    busy_poll_usecs     =50;                                    ///<内核中忙轮循网卡队列的时间(微秒，SO_BUSY_POLL与epoll参数，0表示不设置)
+            uint    busy_poll_budget    =8;                                     ///<每次忙轮循最多处理的包数(SO_BUSY_POLL_BUDGET)
+            bool    prefer_busy_poll    =true;                                  ///<优先忙轮循，减少网卡中断(SO_PREFER_BUSY_POLL，需配合napi_defer_hard_irqs)
+        };//struct SocketBusyPollConfig
 
         /**
          * 最简单的服Socket管理类，直接在一个Update内处理socket的轮循和处理事件(不关心是recv还是send)<br>
+         * 事件中直接带回TCPAccept指针，conn_table仅用于加入/退出时的查重、句柄查找与清理，不参与事件分发<br>
          * 该类所有函数均为非线程安全，所以不可以直接在多线程中使用
          */
         class SocketManage
         {
         protected:
 
-            using SocketList=Map<int,TCPAccept *>;
+            ConnectionTable conn_table;                                         ///<所有连接(以socket为下标，同时记录本次Update出错的连接)
 
-        protected:
+            SocketManageBase *manage;                                           ///<实际的Socket管理器
 
-            SocketList socket_list;
+            SocketEventList sock_event_list;                                    ///<本次Update返回的事件(每个socket一项)
 
-            SocketManageBase *manage;                                           ///<实际的Socket管理器
+            AcceptServer *listen_server=nullptr;                                ///<加入到本管理器的监听Server
+            AcceptedSocketList accept_list;                                     ///<本次Update新接入的连接
+
+            List<DatagramSocket *> datagram_list;                               ///<加入到本管理器的DatagramSocket(不持有，由调用者释放)
+            double datagram_next_time=-1;                                       ///<DatagramSocket下一次需要ProcUpdate的时间(<0表示不需要)
 
-            SocketEventList sock_recv_list,
-                            sock_send_list,
-                            sock_error_list;
+            BufferPool buffer_pool;                                             ///<本管理器下所有TCPAccept共用的缓冲区池
 
-            TCPAcceptSet error_sets;
+            SocketManageMetrics metrics;                                        ///<统计数据(本线程写入，其它线程可随时读取快照)
+
+            List<TCPAccept *> batch_list;                                       ///<批量加入/分离时的临时列表
+
+            TimerWheel timer_wheel;                                             ///<接收超时与周期定时器共用的时间轮
+            TimerNodeList timer_expired_list;                                   ///<本次Update中到期的定时器
+
+            bool defer_send=false;                                              ///<延迟发送模式
+            List<ConnectionHandle> flush_list;                                  ///<延迟发送模式下有数据待发的连接
+
+            List<ConnectionHandle> resume_list;                                 ///<恢复接收的连接(接收缓冲区中可能还有暂停时留下的数据，按句柄保存以防期间被移出)
+            double idle_time_out=0;                                             ///<缺省接收超时时间(<=0表示不检测)
+            double cur_time=0;                                                  ///<本次Update的时间
+
+            int max_user;                                                       ///<最大连接数量(重新创建管理器时使用)
+
+            bool latency_trace=false;                                           ///<延迟跟踪模式
+
+            TrafficCapture *traffic_capture=nullptr;                            ///<流量录制
+
+            double tcp_info_interval=0;                                         ///<每个连接TCP_INFO采样的间隔(<=0表示不采样)
+            double tcp_info_time=0;                                             ///<上一次采样的时间
+            double tcp_info_credit=0;                                           ///<累积的可采样次数(不足1次的部分留到下次)
+            int tcp_info_cursor=0;                                              ///<下一个要采样的连接在列表中的位置
+
+            bool busy_poll=false;                                               ///<忙轮循模式
+            SocketBusyPollConfig busy_poll_config;
+            uint busy_poll_idle=0;                                              ///<忙轮循模式下连续没有事件的Update次数
 
         protected:
 
-            void ProcSocketRecvList();
-            void ProcSocketSendList();
-            void ProcSocketErrorList();
+            const double GetIdleTimeOut(const TCPAccept *s)const{return s->idle_time_out>0?s->idle_time_out:idle_time_out;}
+
+            void ProcTimer();
+            void ProcTCPInfo();
+            void ProcResumeList();
+            void ProcFlushList();
+
+            void OnJoined(TCPAccept *);
+            void OnUnjoined(TCPAccept *);
+            int  UnjoinBatch();
+
+            void ProcSocketEventList();
+
+            void ProcDatagram(SocketEvent *);
+            void ProcDatagramUpdate();
 
             void ProcErrorList();
 
+            void ProcAccept();
+            void ClearAcceptList();
+
         public:
 
-            const TCPAcceptSet &GetErrorSocketSet(){return error_sets;}         ///<获取错误SOCKET合集
+            const TCPAcceptList &GetErrorSocketSet(){return conn_table.GetErrorList();}    ///<获取错误SOCKET合集
+            const AcceptedSocketList &GetAcceptList(){return accept_list;}      ///<获取新接入的连接列表(socket由调用者接管，列表在下一次Update时清除)
+
+            const int GetCount()const{return conn_table.GetCount();}            ///<取得当前连接数量
+
+            void SetOwnerID(const uint id){conn_table.SetOwner(id);}            ///<设置本管理器编号(写入连接句柄，多个管理器时用于区分，需在加入连接前设置)
+            const uint GetOwnerID()const{return conn_table.GetOwner();}
+
+            TCPAccept *GetConnection(const ConnectionHandle h)const{return conn_table.Get(h);}   ///<按句柄取得连接(已失效返回nullptr，只能在本管理器所在线程调用)
+                  BufferPool *GetBufferPool(){return &buffer_pool;}             ///<取得缓冲区池
+            const BufferPoolStats &GetBufferPoolStats()const{return buffer_pool.GetStats();}    ///<取得缓冲区池统计数据
+
+                  SocketManageMetrics &GetMetrics(){return metrics;}            ///<取得统计数据(由本管理器下的TCPAccept在发送时更新)
+            void GetMetricsSnapshot(SocketManageMetricsSnapshot &sm)const{metrics.GetSnapshot(sm);}      ///<取得统计数据快照(可在其它线程调用)
 
         public:
 
             SocketManage(int max_user);
             virtual ~SocketManage();
 
-                    bool Join(TCPAccept *s);
-                     int Join(TCPAccept **s_list,int count);
+                    bool Join(TCPAccept *s);                                    ///<加入一个对象(socket需已是非阻塞模式)
+                     int Join(TCPAccept **s_list,int count);                    ///<批量加入，失败的对象在列表中被置为nullptr
 
                     bool Unjoin(TCPAccept *s);
-                     int Unjoin(TCPAccept **s_list,int count);
+                     int Unjoin(TCPAccept **s_list,int count);                  ///<批量分离
+
+                    bool JoinListen(AcceptServer *);                            ///<加入监听Server，由轮循驱动接入新连接
+                    void UnjoinListen();                                        ///<分离监听Server
+
+                    /**
+                     * 热重启：把连接转交给新进程(只能在本管理器所在线程调用，需在每次Update后反复调用直到返回0)<br>
+                     * 先暂停接收(之后到达的数据留在内核中随socket一起转交)，发送队列发完后保存状态(TCPAccept::SaveHandoffState)，
+                     * 把socket交给hs，从本管理器分离并关闭本进程中的socket(不shutdown)。<br>
+                     * 主动连接、TLS握手中、即将关闭的连接不转交，SaveHandoffState返回false的连接恢复接收，都留在本进程中
+                     * @param done 已转交的连接(socket已关闭，由调用者回收对象)
+                     * @return 还在等待发送队列发完的连接数量，<0表示hs出错(未转交的连接已恢复接收)
+                     */
+                     int Handoff(HotRestartSender *hs,TCPAcceptList &done);
+
+                    /**
+                     * 加入一个UDPSocket，与TCP连接在同一个轮循中处理<br>
+                     * 可读时反复调用其ProcRecv直到返回<=0(边缘模式，ProcRecv中需读到EAGAIN才能返回<=0，可在其中使用RecvPacket/RecvPackets/RecvBatch)<br>
+                     * 每次Update还会调用其ProcUpdate，等待时间不会超过它返回的时间(用于重传、心跳等定时处理)<br>
+                     * 对象仍由调用者持有，需在释放前调用UnjoinDatagram
+                     */
+                    bool JoinDatagram(DatagramSocket *);
+                    bool UnjoinDatagram(DatagramSocket *);                      ///<分离一个DatagramSocket
+            const   int  GetDatagramCount()const{return datagram_list.GetCount();}  ///<取得DatagramSocket数量
+
+                    bool Wake();                                                ///<唤醒正在Update中等待的线程(可在其它线程调用)
+
+                    bool SetSendWatch(TCPAccept *s,bool watch);                 ///<设置是否关注socket可写事件(由TCPAccept在发送队列非空/清空时调用)
+                    bool SetRecvWatch(TCPAccept *s,bool watch);                 ///<设置是否关注socket可读事件(由TCPAccept::PauseRecv/ResumeRecv调用)
+                    void ScheduleRecv(TCPAccept *s);                            ///<在Update中回调一次该连接的OnSocketRecv(没有可读事件)
+
+                    /**
+                     * 设置延迟发送模式<br>
+                     * 开启后连接的Send/SendPacket/SendShared/SendFile不再直接发送，只存入发送队列，
+                     * 在每次Update结束时(以及下一次等待之前)每个连接以一次writev发出，同一帧内的多个小包合并为尽量少的TCP分段
+                     */
+                    void SetDeferSend(const bool d){defer_send=d;}
+            const   bool IsDeferSend()const{return defer_send;}
+                    void DeferFlush(TCPAccept *s);                              ///<将连接加入待发送列表(由TCPAccept在延迟发送模式下调用)
+
+                    /**
+                     * 开启忙轮循模式(需在加入任何连接、监听与UDPSocket之前调用)<br>
+                     * 开启后Update不再睡眠等待，会一直占用一个CPU，只适用于对延迟非常敏感的少数线程。<br>
+                     * 当前管理器不支持内核忙轮循时会换用epoll，不支持epoll的平台只有用户空间的轮循
+                     */
+                    bool SetBusyPoll(const SocketBusyPollConfig &);
+            const   bool IsBusyPoll()const{return busy_poll;}
+
+                    /**
+                     * 设置延迟跟踪模式(之后加入的连接生效)<br>
+                     * 开启后socket记录内核接收时间戳(SO_TIMESTAMPING)，接收改用recvmsg，
+                     * 每个包分发时记录内核收到到分发的耗时，回复全部交给内核时记录分发到回复的耗时，
+                     * 统计在metrics的recv_latency/reply_latency中。每个包多一次取时间，只在需要排查延迟时开启
+                     */
+                    void SetLatencyTrace(const bool t){latency_trace=t;}
+            const   bool IsLatencyTrace()const{return latency_trace;}
+
+                    /**
+                     * 设置流量录制(之后加入的连接生效，nullptr表示关闭)<br>
+                     * 每个连接第一次加入时分配录制中的连接编号，之后分发的每个包/消息连同时间写入录制文件，
+                     * 连接释放或复用时记录结束。多个SocketManage可以共用同一个TrafficCapture
+                     */
+                    void SetTrafficCapture(TrafficCapture *tc){traffic_capture=tc;}
+                    TrafficCapture *GetTrafficCapture()const{return traffic_capture;}
+
+                    /**
+                     * 设置TCP_INFO采样间隔<br>
+                     * 每次Update按经过的时间轮流采样一部分连接，每个连接平均每interval秒采样一次，不会在同一次Update中采样所有连接。
+                     * 结果保存在TCPAccept::GetTCPInfo中并回调OnTCPInfo，RTT与重传计入metrics
+                     * @param interval 每个连接的采样间隔(秒，<=0表示不采样)
+                     */
+                    void SetTCPInfoInterval(const double interval);
+            const   double GetTCPInfoInterval()const{return tcp_info_interval;}
+
+                     int Broadcast(SharedBuffer *);                             ///<将共享数据块发给本管理器中的所有连接
+                     int Broadcast(SharedBuffer *,TCPAccept **s_list,int count);///<将共享数据块发给指定的连接(不属于本管理器的会被跳过)
+
+                    void SetIdleTimeOut(const double);                          ///<设置缺省接收超时时间(在此时间内未收到数据的连接将被视为出错)
+            const   double GetIdleTimeOut()const{return idle_time_out;}         ///<取得缺省接收超时时间
+
+                    void RestartIdleTimer(TCPAccept *s);                        ///<按当前设置重新开始接收超时计时
+                    void RestartUserTimer(TCPAccept *s);                        ///<按当前设置重新开始周期定时器
 
             /**
              * 刷新所有操作(删除错误Socket,轮循可用Socket，发送，接收<br>
-             * 需要注意的是，Update中轮循到的错误/关闭Socket列表，将在下一次Update时清除。所以在每次调用Update后，请调用GetErrorSocketSet获取错误Socket合集并处理出错Socket
+             * 需要注意的是，Update中轮循到的错误/关闭Socket列表，将在下一次Update时清除。所以在每次调用Update后，请调用GetErrorSocketSet获取错误Socket合集并处理出错Socket<br>
+             * 新接入的连接列表同理，请调用GetAcceptList获取并处理，其中的socket均由调用者接管<br>
+             * 有定时器时，等待时间不会超过下一个定时器的到期时间，接收超时的连接同样放入错误Socket合集
              */
             virtual  int Update(const double &time_out=HGL_NETWORK_TIME_OUT);
 
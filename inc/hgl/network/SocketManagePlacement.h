@@ -0,0 +1,86 @@
+﻿#ifndef HGL_NETWORK_SOCKET_MANAGE_PLACEMENT_INCLUDE
+#define HGL_NETWORK_SOCKET_MANAGE_PLACEMENT_INCLUDE
+
+#include<hgl/type/List.h>
+#include<atomic>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * SocketManageThread的负载数据<br>
+         * 由所属线程在每次Update后更新，接入线程读取，所以全部使用relaxed原子操作，只作为分配依据不要求精确
+         */
+        struct SocketManageLoad
+        {
+            std::atomic<int>    connection  {0};                                ///<当前连接数
+            std::atomic<int>    pending     {0};                                ///<已转交但尚未加入的连接数
+            std::atomic<uint>   event_load  {0};                                ///<最近每次Update事件数的滑动平均(x16定点)
+
+        public:
+
+            const int  GetConnectionLoad()const                                ///<连接负载(包含还在路上的)
+            {
+                const int p=pending.load(std::memory_order_relaxed);
+
+                return connection.load(std::memory_order_relaxed)+(p>0?p:0);
+            }
+
+            const uint GetEventLoad()const{return event_load.load(std::memory_order_relaxed);}
+
+            /**
+             * 记录一次Update的结果(仅所属线程调用)
+             * @param conn 当前连接数
+             * @param events 本次Update的事件数
+             */
+            void Update(const int conn,const int events)
+            {
+                const uint old=event_load.load(std::memory_order_relaxed);
+
+                connection.store(conn,std::memory_order_relaxed);
+                event_load.store(old-(old>>3)+uint(events>0?events:0)*2,std::memory_order_relaxed);    //old*7/8+events*16/8
+            }
+        };//struct SocketManageLoad
+
+        /**
+         * 新连接分配策略
+         */
+        enum class SocketPlacementPolicy
+        {
+            Fixed=0,                ///<接入线程固定交给对应的SocketManageThread(由accept()的竞争决定)
+            RoundRobin,             ///<轮流分配
+            LeastConnection,        ///<分给连接数最少的
+            LeastEventLoad,         ///<分给最近事件负载最低的(负载相同时比较连接数)
+        };//enum class SocketPlacementPolicy
+
+        /**
+         * 新连接分配器<br>
+         * 多个接入线程同时调用Select是安全的，负载数据由各SocketManageThread自行更新
+         */
+        class SocketManagePlacement
+        {
+            SocketPlacementPolicy policy=SocketPlacementPolicy::Fixed;
+
+            List<SocketManageLoad *> load_list;
+
+            std::atomic<uint> next{0};                                          ///<轮流分配/并列时的起始位置
+
+        public:
+
+            void SetPolicy(const SocketPlacementPolicy p){policy=p;}            ///<设置分配策略(需在启动前设置)
+            const SocketPlacementPolicy GetPolicy()const{return policy;}
+
+            void Add(SocketManageLoad *load){load_list.Add(load);}              ///<增加一个参与分配的线程(需在启动前设置)
+            const int GetCount()const{return load_list.GetCount();}
+
+            /**
+             * 为一个新连接选择线程，会同时增加目标线程的pending计数
+             * @param hint 接入线程的序号，Fixed策略下直接使用
+             * @return 选中的线程序号
+             * @return <0 没有可用线程
+             */
+            int Select(const int hint);
+        };//class SocketManagePlacement
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_SOCKET_MANAGE_PLACEMENT_INCLUDE
@@ -2,6 +2,11 @@
 #define HGL_NETWORK_SOCKET_MANAGE_THREAD_INCLUDE
 
 #include<hgl/network/SocketManage.h>
+#include<hgl/network/AcceptServer.h>
+#include<hgl/network/CPUAffinity.h>
+#include<hgl/network/SocketManagePlacement.h>
+#include<hgl/network/MPSCQueue.h>
+#include<hgl/network/HotRestart.h>
 #include<hgl/thread/Thread.h>
 #include<hgl/thread/SwapData.h>
 namespace hgl
@@ -9,7 +14,11 @@ namespace hgl
     namespace network
     {
         /**
-         * 简单的Socket管理器线程
+         * 简单的Socket管理器线程<br>
+         * 设置了AcceptServer时(SO_REUSEPORT分片模式)，监听socket会加入本线程的SocketManage，由轮循驱动接入新连接并直接加入，无需经过接入线程与JoinBegin/JoinEnd转交<br>
+         * 其它线程接入的socket可通过AcceptBegin/AcceptEnd转交，USER_ACCEPT对象在本线程创建<br>
+         * USER_ACCEPT对象使用对象池管理，清理时关闭socket后放回池中，复用时通过UseSocket重置<br>
+         * 线程阻塞在SocketManage::Update中，JoinEnd/UnjoinEnd/AcceptEnd会立即唤醒它，所以新连接不会有额外延迟
          */
         template<typename USER_ACCEPT> class SocketManageThread:public Thread
         {
@@ -21,12 +30,62 @@ namespace hgl
 
             SocketManage *sock_manage;
 
+
         protected:
 
             SemSwapData<AcceptSocketList> join_list;                            ///<待添加的Socket对象列表
             SemSwapData<AcceptSocketList> unjoin_list;                          ///<待移出的Socket对象列表
 
-            virtual void OnSocketClear(USER_ACCEPT *us){delete us;}             ///<Socket清理事件
+            SemSwapData<AcceptedSocketList> accepted_list;                      ///<其它线程接入的socket列表(地址由本线程释放)
+            SemSwapData<BroadcastList> broadcast_list;                          ///<其它线程提交的广播请求(引用由本线程释放)
+
+            AcceptSocketList accept_pool;                                       ///<可复用的USER_ACCEPT对象
+            AcceptSocketList accept_batch;                                      ///<本轮新接入，待批量加入的对象
+            List<TCPAccept *> join_batch;                                       ///<批量加入/分离时交给SocketManage的列表
+            int max_pool_count=HGL_ACCEPT_POOL_MAX_COUNT;                       ///<对象池最大数量
+
+            double wait_time=HGL_SOCKET_MANAGE_WAIT_TIME;                       ///<Update最长等待时间(<0表示无限等待)
+
+            SocketManageLoad load;                                              ///<本线程的负载数据(供新连接分配参考)
+
+            struct CrossSendItem
+            {
+                ConnectionHandle handle;
+                SharedBuffer *buffer;
+            };
+
+            MPSCQueue<CrossSendItem> cross_send_queue{HGL_CROSS_SEND_QUEUE_SIZE};  ///<其它线程提交的发送请求
+            std::atomic<bool> cross_send_wake{false};                           ///<已唤醒过本线程，还未处理发送请求
+
+            struct MigrateItem
+            {
+                USER_ACCEPT *accept;
+                SocketManageThread *target;
+            };
+
+            List<MigrateItem> migrate_list;                                     ///<本轮要迁移到其它线程的连接
+
+            std::atomic<HotRestartSender *> handoff_sender{nullptr};            ///<热重启时连接要转交的目标(其它线程设置，转交完成后清除)
+            std::atomic<bool> handoff_done{false};                              ///<转交是否已完成
+            std::atomic<int> handoff_count{0};                                  ///<已转交的连接数量
+            List<TCPAccept *> handoff_list;                                     ///<本轮已转交的连接
+
+            int bind_cpu=-1;                                                    ///<绑定的CPU(<0表示不绑定)
+            int memory_node=-1;                                                 ///<本线程分配内存优先使用的NUMA节点(<0表示缺省)
+
+            /**
+             * Socket清理事件，缺省关闭socket后放回对象池
+             */
+            virtual void OnSocketClear(USER_ACCEPT *us)
+            {
+                us->CloseSocket();
+
+                if(accept_pool.GetCount()<max_pool_count)
+                    accept_pool.Add(us);
+                else
+                    delete us;
+            }
+
             virtual void OnSocketError(USER_ACCEPT *us){OnSocketClear(us);}     ///<Socket出错处理事件
 
             template<typename ST>
@@ -44,25 +103,79 @@ namespace hgl
                 sl.ClearData();
             }
 
-            virtual bool Join(USER_ACCEPT *us){return sock_manage->Join(us);}     ///<单个工作对象接入处理函数
-            virtual bool Unjoin(USER_ACCEPT *us){return sock_manage->Unjoin(us);} ///<单个工作对象退出处理函数
+            virtual USER_ACCEPT *CreateUserAccept(int sock,const IPAddress *addr){return(new USER_ACCEPT(sock,addr));}    ///<创建接入对象
 
             /**
-             *处理要接入的工作对象列表
+             * 取得一个接入对象，优先从对象池中复用
              */
-            void ProcJoinList()
+            USER_ACCEPT *AcquireUserAccept(int sock,const IPAddress *addr)
             {
-                AcceptSocketList &usl=join_list.GetReceive();
+                const int count=accept_pool.GetCount();
 
-                const int count=usl.GetCount();
-                USER_ACCEPT **us=usl.GetData();
+                if(count>0)
+                {
+                    USER_ACCEPT *us=accept_pool.GetData()[count-1];
+
+                    if(us->UseSocket(sock,addr))
+                    {
+                        accept_pool.SetCount(count-1);
+                        return us;
+                    }
+                }
+
+                return CreateUserAccept(sock,addr);
+            }
+
+            /**
+             * 为新接入的socket取得接入对象，放入本轮待加入列表
+             */
+            void AddAcceptedSocket(int sock,const IPAddress *addr)
+            {
+                USER_ACCEPT *us=AcquireUserAccept(sock,addr);     //USER_ACCEPT会复制一份地址
+
+                if(!us)
+                    CloseSocket(sock);
+                else
+                    accept_batch.Add(us);
+            }
+
+            virtual void OnPrepareJoin(USER_ACCEPT *){}                         ///<工作对象加入SocketManage之前的处理函数
+
+            /**
+             * 将一批工作对象一次性加入SocketManage，加入失败的对象会被清理
+             */
+            void JoinBatch(USER_ACCEPT **us,const int count)
+            {
+                if(count<=0)return;
+
+                join_batch.SetCount(count);
+
+                TCPAccept **tp=join_batch.GetData();
 
                 for(int i=0;i<count;i++)
                 {
-                    Join(*us);
-                    ++us;
+                    OnPrepareJoin(us[i]);
+                    tp[i]=us[i];
                 }
 
+                sock_manage->Join(tp,count);
+
+                for(int i=0;i<count;i++)
+                {
+                    if(!tp[i])
+                        OnSocketClear(us[i]);
+                }
+            }
+
+            /**
+             * 处理要接入的工作对象列表
+             */
+            void ProcJoinList()
+            {
+                AcceptSocketList &usl=join_list.GetReceive();
+
+                JoinBatch(usl.GetData(),usl.GetCount());
+
                 usl.ClearData();
             }
 
@@ -74,17 +187,240 @@ namespace hgl
                 AcceptSocketList &usl=unjoin_list.GetReceive();
 
                 const int count=usl.GetCount();
-                USER_ACCEPT **us=usl.GetData();
 
-                for(int i=0;i<count;i++)
+                if(count>0)
                 {
-                    Unjoin(*us);
-                    ++us;
+                    join_batch.SetCount(count);
+
+                    TCPAccept **tp=join_batch.GetData();
+                    USER_ACCEPT **us=usl.GetData();
+
+                    for(int i=0;i<count;i++)
+                        tp[i]=us[i];
+
+                    sock_manage->Unjoin(tp,count);
                 }
 
                 usl.ClearData();
             }
 
+            /**
+             * 将本轮新接入的对象批量加入
+             */
+            void ProcAcceptBatch()
+            {
+                JoinBatch(accept_batch.GetData(),accept_batch.GetCount());
+
+                accept_batch.Clear();
+            }
+
+            /**
+             * 处理SocketManage本次Update中接入的新连接
+             */
+            void ProcAcceptList()
+            {
+                const AcceptedSocketList &asl=sock_manage->GetAcceptList();
+
+                const int count=asl.GetCount();
+                const AcceptedSocket *as=asl.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    AddAcceptedSocket(as->sock,&as->address);
+                    ++as;
+                }
+
+                ProcAcceptBatch();
+            }
+
+            /**
+             * 处理其它线程转交过来的新socket
+             */
+            void ProcAcceptedList()
+            {
+                AcceptedSocketList &asl=accepted_list.GetReceive();
+
+                const int count=asl.GetCount();
+                AcceptedSocket *as=asl.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    AddAcceptedSocket(as->sock,&as->address);
+                    ++as;
+                }
+
+                asl.Clear();
+
+                const int pending=load.pending.load(std::memory_order_relaxed);    //只有经过SocketManagePlacement分配的才计入了pending
+
+                if(pending>0)
+                    load.pending.fetch_sub(hgl_min(pending,count),std::memory_order_relaxed);
+
+                ProcAcceptBatch();
+            }
+
+            /**
+             * 处理其它线程提交的广播请求<br>
+             * 连续的同一数据块、指定了目标的请求合并成一次Broadcast
+             */
+            void ProcBroadcastList()
+            {
+                BroadcastList &bl=broadcast_list.GetReceive();
+
+                const int count=bl.GetCount();
+                BroadcastItem *bi=bl.GetData();
+
+                int i=0;
+
+                while(i<count)
+                {
+                    SharedBuffer *sb=bi[i].buffer;
+
+                    if(!bi[i].target)
+                    {
+                        sock_manage->Broadcast(sb);
+                        sb->Release();
+                        ++i;
+                        continue;
+                    }
+
+                    join_batch.SetCount(0);
+
+                    const int start=i;
+
+                    while(i<count&&bi[i].buffer==sb&&bi[i].target)
+                    {
+                        join_batch.Add(bi[i].target);
+                        ++i;
+                    }
+
+                    sock_manage->Broadcast(sb,join_batch.GetData(),join_batch.GetCount());
+
+                    for(int n=start;n<i;n++)                                    //每一项各持有一个引用
+                        sb->Release();
+                }
+
+                bl.Clear();
+            }
+
+            /**
+             * 将要迁移的连接从本线程分离，交给目标线程加入<br>
+             * 本轮已出错被清理的连接(已不在本线程的SocketManage中)会被跳过
+             */
+            void ProcMigrateList()
+            {
+                const int count=migrate_list.GetCount();
+
+                if(count<=0)return;
+
+                MigrateItem *mi=migrate_list.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    if(mi->accept->GetSocketManage()==sock_manage
+                     &&sock_manage->Unjoin(mi->accept))
+                    {
+                        mi->target->JoinBegin().Add(mi->accept);
+                        mi->target->JoinEnd();
+                    }
+
+                    ++mi;
+                }
+
+                migrate_list.Clear();
+            }
+
+            /**
+             * 热重启：把发送队列已发完的连接转交出去，已转交的对象放回对象池(socket已关闭)
+             */
+            void ProcHandoff()
+            {
+                HotRestartSender *hs=handoff_sender.load();
+
+                if(!hs)return;
+
+                sock_manage->UnjoinListen();                                    //分片模式下监听socket已交给新进程，本线程不再接入
+
+                const int result=sock_manage->Handoff(hs,handoff_list);
+
+                const int count=handoff_list.GetCount();
+                TCPAccept **sp=handoff_list.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    OnSocketClear(static_cast<USER_ACCEPT *>(*sp));
+                    ++sp;
+                }
+
+                handoff_list.Clear();
+                handoff_count.fetch_add(count);
+
+                if(result<=0)
+                {
+                    handoff_sender.store(nullptr);
+                    handoff_done.store(true);
+                }
+            }
+
+            /**
+             * 处理其它线程提交的发送请求，按句柄找到连接后发送，连接已不存在的直接丢弃
+             */
+            void ProcCrossSendQueue()
+            {
+                cross_send_wake.store(false);
+                std::atomic_thread_fence(std::memory_order_seq_cst);           //先清标记再取，之后压入的请求一定会再次唤醒
+
+                CrossSendItem item;
+
+                while(cross_send_queue.Pop(item))
+                {
+                    TCPAccept *s=sock_manage->GetConnection(item.handle);
+
+                    if(s)
+                        s->SendShared(item.buffer);
+
+                    item.buffer->Release();
+                }
+            }
+
+            void ClearCrossSendQueue()
+            {
+                CrossSendItem item;
+
+                while(cross_send_queue.Pop(item))
+                    item.buffer->Release();
+            }
+
+            template<typename ST>
+            void ClearBroadcastList(ST &bl)
+            {
+                const int count=bl.GetCount();
+                BroadcastItem *bi=bl.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    bi->buffer->Release();
+                    ++bi;
+                }
+
+                bl.Clear();
+            }
+
+            template<typename ST>
+            void CloseAcceptedList(ST &asl)
+            {
+                const int count=asl.GetCount();
+                AcceptedSocket *as=asl.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    CloseSocket(as->sock);
+                    ++as;
+                }
+
+                asl.Clear();
+            }
+
         public:
 
             SocketManageThread(SocketManage *sm)
@@ -94,15 +430,102 @@ namespace hgl
 
             virtual ~SocketManageThread()
             {
+                const int count=accept_pool.GetCount();
+                USER_ACCEPT **us=accept_pool.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    delete *us;
+                    ++us;
+                }
+
                 SAFE_CLEAR(sock_manage);
             }
 
+            void SetMaxPoolCount(int count){max_pool_count=count;}                ///<设置对象池最大数量
+
+            /**
+             * 设置Update最长等待时间<br>
+             * 有新的Join/Unjoin/Accept请求时会被立即唤醒，所以这个时间只影响线程检查退出请求的间隔。<br>
+             * 设为<0则无限等待，此时请求线程退出后需要调用Wake()
+             */
+            void SetWaitTime(const double t){wait_time=t;}
+
+            bool Wake(){return sock_manage->Wake();}                            ///<唤醒本线程
+
+            void SetIdleTimeOut(const double t){sock_manage->SetIdleTimeOut(t);}  ///<设置缺省接收超时时间(需在线程启动前调用)
+            void SetDeferSend(const bool d){sock_manage->SetDeferSend(d);}      ///<设置延迟发送模式(每次循环结束时每个连接合并发出一次，需在线程启动前调用)
+
+            /**
+             * 设置本线程使用忙轮循模式，需在线程启动前调用<br>
+             * 本线程会一直占用一个CPU(建议同时用SetCPU绑定)，只给对延迟最敏感的线程使用
+             */
+            bool SetBusyPoll(const SocketBusyPollConfig &cfg){return sock_manage->SetBusyPoll(cfg);}
+
+            void SetTCPInfoInterval(const double t){sock_manage->SetTCPInfoInterval(t);}  ///<设置每个连接TCP_INFO采样间隔(秒，<=0表示不采样，需在线程启动前调用)
+            void SetLatencyTrace(const bool t){sock_manage->SetLatencyTrace(t);}  ///<设置延迟跟踪模式(记录每个包的内核接收到分发、分发到回复的耗时，需在线程启动前调用)
+            void SetTrafficCapture(TrafficCapture *tc){sock_manage->SetTrafficCapture(tc);}       ///<设置流量录制(需在线程启动前调用)
+
+            /**
+             * 设置本线程独占的监听Server，需在线程启动前调用
+             */
+            bool SetAcceptServer(AcceptServer *as)
+            {
+                return sock_manage->JoinListen(as);
+            }
+
+            /**
+             * 加入由本线程驱动的UDPSocket，需在线程启动前调用(对象由调用者持有，需在线程退出后才能释放)
+             */
+            bool JoinDatagram(DatagramSocket *udp)
+            {
+                return sock_manage->JoinDatagram(udp);
+            }
+
+            /**
+             * 设置本线程绑定的CPU与内存所在NUMA节点，需在线程启动前调用<br>
+             * 线程启动时绑定，之后本线程中的分配(缓冲区池扩充、对象池等)优先使用该节点的内存
+             * @param cpu CPU编号(<0表示不绑定)
+             * @param node NUMA节点(<0表示使用cpu所在节点)
+             */
+            void SetCPU(const int cpu,const int node=-1)
+            {
+                bind_cpu=cpu;
+                memory_node=(node>=0?node:GetCPUNumaNode(cpu));
+            }
+
+            const int GetCPU()const{return bind_cpu;}                           ///<取得绑定的CPU
+            const int GetMemoryNode()const{return memory_node;}                 ///<取得内存所在NUMA节点
+
+            virtual bool ProcStartThread() override
+            {
+                if(bind_cpu>=0)
+                    BindThreadToCPU(bind_cpu);                                  //不支持的系统上失败也无所谓，仅影响性能
+
+                if(memory_node>=0)
+                    SetThreadMemoryNode(memory_node);
+
+                return(true);
+            }
+
             virtual void ProcEndThread() override
             {
+                migrate_list.Clear();                                           //还未迁移的仍在本线程的SocketManage中，随之清理
+
+                ClearCrossSendQueue();
+
                 ClearAcceptSocketList(join_list.GetReceive());
                 join_list.Swap();
                 ClearAcceptSocketList(join_list.GetReceive());
 
+                CloseAcceptedList(accepted_list.GetReceive());
+                accepted_list.Swap();
+                CloseAcceptedList(accepted_list.GetReceive());
+
+                ClearBroadcastList(broadcast_list.GetReceive());
+                broadcast_list.Swap();
+                ClearBroadcastList(broadcast_list.GetReceive());
+
                 sock_manage->Clear();
 
                 //unjoin_list中的理论上都已经在wo_list/join_list里了，所以不需要走Clear，直接清空列表
@@ -119,7 +542,17 @@ namespace hgl
                 if(unjoin_list.TrySemSwap())
                     ProcUnjoinList();
 
-                sock_manage->Update(0.1);         //这里写0.1秒，只是为了不卡住主轮循。这是个错误的设计，未来要将epoll(recv)完全独立一个线程跑
+                if(accepted_list.TrySemSwap())
+                    ProcAcceptedList();
+
+                if(broadcast_list.TrySemSwap())
+                    ProcBroadcastList();
+
+                ProcCrossSendQueue();
+
+                const int event_count=sock_manage->Update(wait_time);   //Join/Unjoin/Accept请求会唤醒它，不需要靠超时来轮循
+
+                ProcAcceptList();
 
                 const auto &error_set=sock_manage->GetErrorSocketSet();
                 USER_ACCEPT **us=(USER_ACCEPT **)error_set.GetData();
@@ -129,16 +562,150 @@ namespace hgl
                     OnSocketError(*us);
                     ++us;
                 }
+
+                ProcMigrateList();
+
+                ProcHandoff();
+
+                load.Update(sock_manage->GetCount(),event_count);
                 return(true);
             }
 
         public:
 
-            virtual AcceptSocketList &  JoinBegin(){return join_list.GetPost();}    ///<开始添加要接入的Socket对象
+            /**
+             * 取得缓冲区池统计数据<br>
+             * 统计数据由本线程更新，其它线程读取时仅作参考
+             */
+            const BufferPoolStats &GetBufferPoolStats()const{return sock_manage->GetBufferPoolStats();}
+
+                  SocketManageLoad *GetLoad(){return &load;}                    ///<取得本线程的负载数据(可在其它线程读取)
+
+            void GetMetricsSnapshot(SocketManageMetricsSnapshot &sm)const{sock_manage->GetMetricsSnapshot(sm);}    ///<取得统计数据快照(可在其它线程调用)
+
+            void SetOwnerID(const uint id){sock_manage->SetOwnerID(id);}       ///<设置本线程编号(写入连接句柄，需在线程启动前调用)
+
+            /**
+             * 向指定连接发送共享数据块(可在任意线程调用)<br>
+             * 请求放入无锁队列，本线程每轮处理一次；同一线程提交的请求按顺序发送。连接已关闭(句柄失效)时数据被丢弃
+             * @param h 连接句柄(TCPAccept::GetHandle)
+             * @param sb 共享数据块(会自行增加一个引用，调用者仍需释放自己的引用)
+             * @return 队列已满时返回false
+             */
+            bool Send(const ConnectionHandle h,SharedBuffer *sb)
+            {
+                if(h==HGL_INVALID_CONNECTION_HANDLE||!sb)return(false);
+
+                if(!cross_send_queue.Push({h,sb->AddRef()}))
+                {
+                    sb->Release();
+                    return(false);
+                }
+
+                if(!cross_send_wake.exchange(true))                             //本轮第一个请求才需要唤醒
+                    sock_manage->Wake();
+
+                return(true);
+            }
+
+            /**
+             * 将一个连接迁移到其它SocketManageThread(只能在本线程中调用，如在USER_ACCEPT的事件处理中)<br>
+             * 本轮Update处理完后才会真正分离，连接的发送队列、未处理的接收数据都会保留，由目标线程继续处理<br>
+             * 迁移后连接句柄会改变，旧句柄失效
+             * @param us 本线程的连接
+             * @param target 目标线程(需使用相同的USER_ACCEPT类型)
+             */
+            void Migrate(USER_ACCEPT *us,SocketManageThread *target)
+            {
+                if(!us||!target||target==this)return;
+
+                migrate_list.Add({us,target});
+            }
+
+            /**
+             * 热重启：请求本线程把连接转交给新进程(可在其它线程调用)<br>
+             * 本线程在每次Update后转交发送队列已发完的连接，直到没有需要等待的连接，期间不再接入新连接。完成后IsHandoffDone返回true
+             */
+            void Handoff(HotRestartSender *hs)
+            {
+                if(!hs)return;
+
+                handoff_done.store(false);
+                handoff_sender.store(hs);
+                sock_manage->Wake();
+            }
+
+            const bool IsHandoffDone()const{return handoff_done.load();}       ///<转交是否已完成
+            const int GetHandoffCount()const{return handoff_count.load();}     ///<取得已转交的连接数量
+
+            /**
+             * 新进程中加入一个旧进程转交过来的连接(可在其它线程调用)<br>
+             * 恢复收包状态后加入本线程，接收缓冲区中带过来的数据在加入后立即处理
+             * @param item 转交项(socket的所有权一并转交)
+             */
+            bool JoinHandoff(HandoffItem &item)
+            {
+                if(item.type!=HandoffType::Connection||item.sock<0)
+                    return(false);
+
+                SetSocketNonBlock(item.sock,true);
+
+                USER_ACCEPT *us=CreateUserAccept(item.sock,&item.address);
+
+                item.sock=-1;
+
+                if(!us)
+                    return(false);
+
+                if(us->LoadHandoffState(item.state.GetData(),uint(item.state.GetCount()))<0)
+                {
+                    us->CloseSocket();
+                    delete us;
+                    return(false);
+                }
+
+                JoinBegin().Add(us);
+                JoinEnd();
+                return(true);
+            }
+
+            virtual AcceptSocketList &  JoinBegin(){return join_list.GetPost();}    ///<开始添加要接入的Socket对象(socket需已是非阻塞模式)
             virtual void                JoinEnd()                                   ///<结束添加要接入的Socket对象
             {
                 join_list.ReleasePost();
                 join_list.PostSem();
+                sock_manage->Wake();
+            }
+
+            virtual AcceptedSocketList &AcceptBegin(){return accepted_list.GetPost();}    ///<开始添加其它线程接入的socket(地址所有权一并转交)
+            virtual void                AcceptEnd()                                 ///<结束添加其它线程接入的socket
+            {
+                accepted_list.ReleasePost();
+                accepted_list.PostSem();
+                sock_manage->Wake();
+            }
+
+            /**
+             * 开始提交广播请求，每一项需持有buffer的一个引用(SharedBuffer::AddRef)，由本线程发送后释放<br>
+             * 本线程在下一轮中一次性处理所有请求，target为nullptr时发给本线程的所有连接
+             */
+            virtual BroadcastList &     BroadcastBegin(){return broadcast_list.GetPost();}
+            virtual void                BroadcastEnd()                              ///<结束提交广播请求
+            {
+                broadcast_list.ReleasePost();
+                broadcast_list.PostSem();
+                sock_manage->Wake();
+            }
+
+            /**
+             * 将共享数据块广播给本线程的所有连接(会自行增加一个引用，调用者仍需释放自己的引用)
+             */
+            void Broadcast(SharedBuffer *sb)
+            {
+                if(!sb)return;
+
+                BroadcastBegin().Add({sb->AddRef(),nullptr});
+                BroadcastEnd();
             }
 
             virtual AcceptSocketList &  UnjoinBegin(){return unjoin_list.GetPost();}///<开始添加要退出的Socket对象
@@ -146,6 +713,7 @@ namespace hgl
             {
                 unjoin_list.ReleasePost();
                 unjoin_list.PostSem();
+                sock_manage->Wake();
             }
         };//template<typename USER_ACCEPT> class SocketManageThread:public Thread
     }//namespace network
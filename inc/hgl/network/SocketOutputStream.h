@@ -6,6 +6,18 @@ namespace hgl
 {
     namespace network
     {
+        constexpr int HGL_SOCKET_IOVEC_MAX=64;                                                      ///<WriteVector一次最多提交的数据段数量
+        constexpr int HGL_SOCKET_FILE_BUFFER_SIZE=HGL_SIZE_1KB*64;                                  ///<不支持sendfile的系统上WriteFile单次读取的最大字节数
+
+        /**
+        * 分散/聚集发送时的一段数据
+        */
+        struct SocketIOVec
+        {
+            const void *data;
+            int64 size;
+        };//struct SocketIOVec
+
         /**
         * Socket输出流，用于TCP／SCTP协议在无包封装处理的情况下
         */
@@ -39,6 +51,10 @@ namespace hgl
             int64   Write(const void *,int64);                                              ///<向socket中写入指定的字节数
             int64   WriteFully(const void *,int64);                                         ///<充分写入指定字节的数据
 
+            int64   WriteVector(const SocketIOVec *,int);                                   ///<一次系统调用写入多段数据
+            int64   WriteFile(int fd,int64 offset,int64 size);                              ///<将文件/管道中的数据直接写入socket(不经过用户空间)
+            int64   WriteZeroCopy(const void *,int64,bool &zero_copy);                      ///<以MSG_ZEROCOPY写入(需已开启SO_ZEROCOPY)
+
             bool    CanRestart()const{return false;}                                        ///<是否可以复位
             bool    CanSeek()const{return false;}                                           ///<是否可以定位
             bool    CanSize()const{return false;}                                           ///<是否可以取得尺寸
@@ -3,6 +3,12 @@
 
 #include<hgl/network/TCPSocket.h>
 #include<hgl/type/DataArray.h>
+#include<hgl/network/SendQueue.h>
+#include<hgl/network/BufferPool.h>
+#include<hgl/network/TimerWheel.h>
+#include<hgl/network/ConnectionTable.h>
+#include<hgl/network/PacketFramer.h>
+#include<hgl/network/TrafficCapture.h>
 namespace hgl
 {
     namespace network
@@ -14,11 +20,18 @@ namespace hgl
          * SocketManage:        服务器对批量TCPAccept进行管理的对象
          * SocketManageThread:  SocketManage的异步封装
          *
-         * 收包流程:
+         * 收包流程(TCPAcceptPacket):
          *          1.SocketManage通过OnSocketRecv函数通知TCPAccept接收数据
-         *          2.TCPAccept在收满4个字节的包长后，根据包长向MultiLevelMemoryPool申请缓冲区
-         *          3.TCPAccept收满一个包后，通过OnRecvPacket事件函数通知开发者有包了
-         *          4.TCPAccept将缓冲区送回BufferPool
+         *          2.TCPAcceptPacket向SocketManage的BufferPool借出接收缓冲区，每次recv都尽可能填满
+         *          3.在接收缓冲区上原地解析出所有完整的包，逐个通过OnRecvPacket事件函数通知开发者
+         *          4.不完整的剩余部分移到缓冲区头部，等待下一次接收(包比缓冲区大时换一个更大级别的缓冲区)
+         *          5.缓冲区中没有剩余数据时将缓冲区送回BufferPool，空闲连接不占用接收缓冲区
+         *
+         * 开启SetPacketRef后接收缓冲区改为从进程级池中取得的SharedBuffer，每个包以PacketRef回调，
+         * 回调中可以保存PacketRef、交给其它线程或直接SendShared给其它连接，都不复制数据。
+         * 回调返回后如果还有PacketRef引用着缓冲区，不完整的剩余部分复制到新的缓冲区中，旧的缓冲区在引用全部释放后回到池中
+         *
+         * 包头格式由TCPAcceptFramedPacket的FRAMER参数在编译期确定(见PacketFramer.h)，TCPAcceptPacket使用DefaultPacketFramer
          */
 
         using PACKET_SIZE_TYPE=uint32;                                          ///<描述包长度的数据类型
@@ -26,11 +39,23 @@ namespace hgl
 
         class SocketInputStream;
         class SocketOutputStream;
+        class SocketManage;
+        class TLSSession;
+        struct SocketIOVec;
 
         /**
          * TCP服务器接入用户处理基类，为各种Server管理器提供统一调用接口<br>
          * *******************************************************************<br>
-         * 收包和发包是可以在不同线程异步同时工作的，现在写一起只是暂时，未来分开
+         * 收包和发包是可以在不同线程异步同时工作的，现在写一起只是暂时，未来分开<br>
+         * *******************************************************************<br>
+         * 发送流程:<br>
+         *          1.Send先直接尝试非阻塞发送，发不完的部分存入send_queue<br>
+         *          2.send_queue不为空时通知SocketManage关注该socket的可写事件<br>
+         *          3.socket可写时SocketManage调用OnSocketSend继续发送，发完后取消关注可写事件<br>
+         * 加入SocketManage之前的发送全部存入send_queue(socket接入时即为非阻塞模式，不能在调用者线程中等待)，加入后由可写事件发出<br>
+         * SendFile的文件数据同样按顺序排在发送队列中，与前后的小包交错发出，只有轮到它时才从文件直接发到socket<br>
+         * StartTLS后先在收发事件中完成TLS握手，之后由内核(kTLS)加解密，以上各种发送方式不受影响<br>
+         * 设置了发送队列高水位时，队列达到高水位后的发送直接失败(已开始发送的数据不受影响)，降到低水位时调用OnSendQueueDrained
          */
         class TCPAccept:public TCPSocket
         {
@@ -39,45 +64,407 @@ namespace hgl
             SocketInputStream *sis=nullptr;
             SocketOutputStream *sos=nullptr;
 
+            SocketManage *sock_manage=nullptr;                                  ///<所属的SocketManage，由SocketManage在Join/Unjoin时设置
+            ConnectionHandle handle=HGL_INVALID_CONNECTION_HANDLE;              ///<在所属SocketManage中的句柄
+
+            SendQueue send_queue;                                               ///<未发完的数据
+            bool send_watch=false;                                              ///<是否正在关注可写事件
+            bool flush_pending=false;                                           ///<已在SocketManage的延迟发送列表中
+            bool connecting=false;                                              ///<主动发起的连接尚未完成(完成前发送的数据全部存入发送队列)
+            TLSSession *tls=nullptr;                                            ///<进行中的TLS握手(完成后释放，完成前发送的数据全部存入发送队列)
+
+            uint64 send_high_watermark=0;                                       ///<发送队列高水位(字节，0表示不限制)，达到后新的发送直接失败
+            uint64 send_low_watermark=0;                                        ///<发送队列低水位，达到过高水位后降到此值时调用OnSendQueueDrained
+            bool send_over_high=false;                                          ///<达到过高水位，等待降到低水位
+
+            bool recv_pause=false;                                              ///<暂停接收(不关注可读事件，数据留在内核缓冲区中由TCP流控挡住对方)
+            bool close_after_send=false;                                        ///<发送队列发完后关闭连接
+
+            TimerNode idle_timer;                                               ///<接收超时定时器(由SocketManage的时间轮驱动)
+            TimerNode user_timer;                                               ///<周期定时器(心跳等)
+
+            double idle_time_out=0;                                             ///<接收超时时间(<=0表示使用SocketManage的设置)
+            double last_recv_time=0;                                            ///<最后一次收到数据的时间
+            double timer_interval=0;                                            ///<周期定时器间隔(<=0表示不使用)
+
+            TCPConnectionInfo tcp_info{};                                       ///<最近一次采样的传输状态(SocketManage::SetTCPInfoInterval)
+
+            bool latency_trace=false;                                           ///<延迟跟踪模式(由SocketManage在加入时设置)
+            int64 trace_dispatch_time=0;                                        ///<最早一个还没发出回复的包的分发时间(纳秒，0表示没有)
+
+            bool handoff_refused=false;                                         ///<热重启时SaveHandoffState拒绝了转交，留在本进程
+
+            TrafficCapture *traffic_capture=nullptr;                            ///<流量录制(由SocketManage在第一次加入时设置)
+            uint32 capture_id=0;                                                ///<在录制中的连接编号(0表示不录制)
+
         protected://事件函数，由SocketManage调用
 
             friend class SocketManage;
 
             virtual int OnSocketRecv(int)=0;                                    ///<Socket接收处理函数
-            virtual int OnSocketSend(int){return 0;}                            ///<Socket发送处理函数
+            virtual int OnSocketSend(int);                                      ///<Socket发送处理函数
             virtual void OnSocketError(int)=0;                                  ///<Socket错误处理函数
+            virtual void OnSocketJoin(){}                                       ///<已加入SocketManage
+            virtual void OnSocketUnjoin(){}                                     ///<即将从SocketManage分离
+
+            /**
+             * 主动发起的连接已完成(第一次可写时检查连接结果)
+             * @return 是否正常，返回false则视为出错并被移出SocketManage
+             */
+            virtual bool OnConnected(){return(true);}
+
+            /**
+             * TLS握手完成(之后收发的都是明文，加解密由内核完成)，客户端握手完成后还会再调用OnConnected
+             * @return 是否正常，返回false则视为出错并被移出SocketManage
+             */
+            virtual bool OnTLSReady(){return(true);}
+
+            /**
+             * 发送队列达到过高水位后降到了低水位，可以继续发送
+             */
+            virtual void OnSendQueueDrained(){}
+
+                    int ProcTLSHandshake();                                     ///<继续TLS握手(1完成,0未完成,-1出错)
+
+            /**
+             * 周期定时器事件(心跳等)，由SetTimer设置
+             * @return 是否正常，返回false则视为出错并被移出SocketManage
+             */
+            virtual bool OnTimer(){return(true);}
+
+            /**
+             * 接收超时事件，缺省直接认为出错，返回true则从现在开始重新计时
+             */
+            virtual bool OnIdleTimeOut(){return(false);}
+
+            /**
+             * 传输状态采样事件(SocketManage按SetTCPInfoInterval轮流采样)，可在这里按RTT、重传等调整发送或断开质量太差的连接
+             * @return 是否正常，返回false则视为出错并被移出SocketManage
+             */
+            virtual bool OnTCPInfo(const TCPConnectionInfo &){return(true);}
+
+                    void WatchSend();                                           ///<发送队列中有了新数据
+
+                    bool Send(const void *,const uint);                         ///<发送原始数据
+                    bool Send(const SocketIOVec *,const int);                   ///<一次发送多段原始数据
+
+                    void ProcTraceDispatch();                                   ///<记录从内核收到数据到分发的耗时
+                    void TraceDispatch()                                        ///<即将分发一个包/消息(延迟跟踪模式下记录耗时)
+                    {
+                        if(latency_trace)
+                            ProcTraceDispatch();
+                    }
+
+                    void ProcTraceSend();                                       ///<记录从分发到回复全部交给内核的耗时
+                    void CheckTraceSend()                                       ///<发送队列已清空时记录回复耗时
+                    {
+                        if(trace_dispatch_time&&send_queue.IsEmpty())
+                            ProcTraceSend();
+                    }
+
+                    /**
+                     * 即将分发一个包/消息(开启流量录制时记录)
+                     * @param data 数据(含包头)
+                     * @param header_size 包头字节数
+                     * @param size 数据字节数(含包头)
+                     */
+                    void CaptureRecv(const TrafficCaptureKind kind,const uint type,const void *data,const uint header_size,const uint size,const bool fin=true)
+                    {
+                        if(capture_id)
+                            traffic_capture->Record(capture_id,kind,type,data,header_size,size,fin);
+                    }
 
-                    bool Send(void *,const uint);                               ///<发送原始数据
+                    void EndCapture();                                          ///<结束录制(记录连接结束)
 
         public:
 
             using TCPSocket::TCPSocket;
             virtual ~TCPAccept();
 
+            virtual bool UseSocket(int,const IPAddress *) override;             ///<使用指定socket(对象池复用时重置状态的入口，派生类请重载并调用基类)
+
+            SocketManage *GetSocketManage()const{return sock_manage;}           ///<取得所属的SocketManage
+            const ConnectionHandle GetHandle()const{return handle;}             ///<取得连接句柄(可交给其它线程使用，重新加入后会改变)
+            const int64 GetSendQueueBytes()const{return send_queue.GetBytes();} ///<取得尚未发出的数据字节数
+
+                    void SetSendWatermark(const uint64 high,const uint64 low=0);///<设置发送队列高/低水位(high为0表示不限制，low缺省为high的一半)
+            const   bool IsSendQueueFull()const                                 ///<发送队列是否已达到高水位
+                    {
+                        return send_high_watermark>0&&uint64(send_queue.GetBytes())>=send_high_watermark;
+                    }
+
+                    bool PauseRecv();                                           ///<暂停接收(如应用层积压过多时，只能在所属SocketManage的线程中调用)
+                    bool ResumeRecv();                                          ///<恢复接收(暂停期间留在接收缓冲区中的数据在本次Update中处理)
+            const   bool IsRecvPaused()const{return recv_pause;}
+
+                    void CloseAfterSend();                                      ///<不再接收，已发送的数据全部发出后关闭连接(如HTTP的Connection: close)
+            const   bool IsCloseAfterSend()const{return close_after_send;}
+            const bool IsConnecting()const{return connecting;}                  ///<主动发起的连接是否尚未完成
+
+                    bool StartTLS(TLSSession *);                                ///<开始TLS握手(接管握手对象，须在发送任何数据之前调用)
+            const   bool IsTLSHandshaking()const{return tls!=nullptr;}          ///<TLS握手是否尚未完成
+
+            virtual bool SendShared(SharedBuffer *,const uint offset,const uint size);  ///<发送共享数据块中的一段(发不完的部分以引用方式存入发送队列，不复制)
+                    bool SendShared(SharedBuffer *sb)                           ///<发送整个共享数据块
+                    {
+                        return sb&&SendShared(sb,0,sb->GetSize());
+                    }
+                    bool SendShared(const PacketRef &pr)                        ///<原样转发收到的包(含包头，不复制)
+                    {
+                        return SendShared(pr.GetBuffer(),pr.GetFrameOffset(),pr.GetFrameSize());
+                    }
+            virtual bool SendFile(int fd,int64 offset,int64 size,bool close_fd=false);  ///<发送文件中的一段数据(sendfile/splice，不经过用户空间)
+
+                    bool SetZeroCopy(const uint threshold=HGL_ZERO_COPY_THRESHOLD);  ///<开启零拷贝发送(仅Linux，不小于threshold的共享数据块以MSG_ZEROCOPY发出，0表示关闭)
+            const   bool IsZeroCopy()const{return send_queue.IsZeroCopy();}     ///<是否使用零拷贝发送或还有未完成的零拷贝发送
+                    int  ProcZeroCopyCompletion();                              ///<读取错误队列中的零拷贝完成通知(由SocketManageBase在出错事件中调用)
+
+                    void SetIdleTimeOut(const double);                          ///<设置接收超时时间(在此时间内未收到数据将被移出)
+                    void SetTimer(const double);                                ///<设置周期定时器间隔(<=0表示关闭)
+            const double GetLastRecvTime()const{return last_recv_time;}         ///<取得最后一次收到数据的时间
+
+            const bool IsLatencyTrace()const{return latency_trace;}             ///<是否开启了延迟跟踪(SocketManage::SetLatencyTrace)
+            const uint32 GetCaptureID()const{return capture_id;}                ///<取得流量录制中的连接编号(0表示没有录制)
+
+            const TCPConnectionInfo &GetTCPInfo()const{return tcp_info;}        ///<取得最近一次采样的传输状态(sample_time为0表示还没有采样)
+
+            /**
+             * 热重启时保存转交给新进程的状态(由SocketManage::Handoff在接收已暂停、发送队列已清空时调用)<br>
+             * 派生类先调用基类再在out后追加自己的数据，不能转交的状态返回false，连接将留在本进程中继续服务
+             */
+            virtual bool SaveHandoffState(DataArray<uchar> &){return(true);}
+
+            /**
+             * 新进程中恢复转交过来的状态(在加入SocketManage之前调用)<br>
+             * 派生类先调用基类，再从返回的位置之后读取自己的数据
+             * @return 已使用的字节数，<0表示数据错误
+             */
+            virtual int LoadHandoffState(const uchar *,const uint){return(0);}
+
         };//class TCPAccept:public TCPSocket
 
-        class TCPAcceptPacket:public TCPAccept
+        /**
+         * 封包收发基类(与封包格式无关的部分)：接收缓冲区的借还与收包循环
+         */
+        class TCPAcceptPacketBase:public TCPAccept
         {
         protected:
 
-            DataArray<uchar> recv_buffer;
-            uint            recv_length=0;
+            uchar *         recv_buffer=nullptr;                                ///<接收缓冲区，每次recv尽可能填满
+            uint            recv_buffer_size=0;                                 ///<接收缓冲区容量
+            BufferPool *    recv_pool=nullptr;                                  ///<接收缓冲区的来源，为nullptr表示自行分配
+            SharedBuffer *  recv_block=nullptr;                                 ///<引用模式下的接收缓冲区(recv_buffer指向其中)
+            bool            packet_ref=false;                                   ///<是否以PacketRef回调收到的包
+            uint            recv_length=0;                                      ///<接收缓冲区中尚未处理的数据长度
+            uint            max_packet_size=HGL_TCP_MAX_PACKET_SIZE;            ///<最大包长(含包头)，接收缓冲区不会为更长的包扩大
 
             uint64          recv_total=0;
 
+            int64           recv_timestamp=0;                                   ///<最近一次读到的数据的内核接收时间戳(延迟跟踪模式，纳秒)
+
+                    bool ResizeRecvBuffer(uint);                                ///<更换接收缓冲区(保留其中的数据)
+                    void FreeRecvBuffer();                                      ///<归还接收缓冲区
+
+            virtual void OnSocketJoin() override;
+            virtual void OnSocketUnjoin() override;
+
         protected:
 
             virtual int OnSocketRecv(int) override;                             ///<Socket接收处理函数
 
+            /**
+             * 从缓冲区中解析出所有完整的包
+             * @return 已处理的字节数(剩余不完整的包留待下次处理)，<0表示包格式错误
+             */
+            virtual int ParsePacket(uchar *,uint)=0;
+
+            /**
+             * 取得缓冲区前部不完整的包共需要的字节数(含包头)
+             * @return 0表示包头还没收完整
+             */
+            virtual uint64 GetPacketNeed(const uchar *,uint)const=0;
+
+                    bool ConsumeRecvBuffer();                                   ///<解析接收缓冲区并移除已处理的数据(包格式错误返回false)
+
+                    bool SendFrame(const void *,const uint,const void *,const uint);   ///<包头与包体合并为一次writev发出
+
+        public:
+
+            using TCPAccept::TCPAccept;
+            virtual ~TCPAcceptPacketBase();
+
+            virtual bool UseSocket(int,const IPAddress *) override;             ///<使用指定socket(重置收包状态)
+
+            virtual bool SaveHandoffState(DataArray<uchar> &) override;         ///<保存接收缓冲区中未处理的数据
+            virtual int  LoadHandoffState(const uchar *,const uint) override;   ///<恢复接收缓冲区中未处理的数据
+
+                    bool SetPacketRef(const bool);                              ///<设置是否以PacketRef回调收到的包(接收缓冲区改用可共享的数据块)
+            const   bool IsPacketRef()const{return packet_ref;}
+
+                    void SetMaxPacketSize(const uint size){max_packet_size=size;}   ///<设置最大包长(含包头，收到更长的包头时视为出错并关闭连接)
+            const   uint GetMaxPacketSize()const{return max_packet_size;}
+        };//class TCPAcceptPacketBase:public TCPAccept
+
+        /**
+         * 按编译期确定的封包格式收发包
+         * @param FRAMER 封包格式(PacketFramer)
+         */
+        template<typename FRAMER> class TCPAcceptFramedPacket:public TCPAcceptPacketBase
+        {
+        public:
+
+            using Framer=FRAMER;
+
+        protected:
+
+            int ParsePacket(uchar *data,uint size) override
+            {
+                uchar *p=data;
+                PacketFrameHeader h;
+
+                while(true)
+                {
+                    const int header_size=FRAMER::Decode(p,size,h);
+
+                    if(header_size<=0)
+                    {
+                        if(header_size<0)
+                            return(-1);
+
+                        break;
+                    }
+
+                    if(uint64(header_size)+h.size>max_packet_size)              //对方给出的包长不可信，超出的不为它扩大缓冲区
+                        return(-1);
+
+                    if(size-header_size<h.size)                                 //这个包还没收完整
+                        break;
+
+                    uchar *body=p+header_size;                                  //直接在接收缓冲区上回调，不再复制
+
+                    CaptureRecv(TrafficCaptureKind::Packet,h.type,p,header_size,header_size+h.size);
+                    TraceDispatch();
+
+                    if(recv_block)
+                    {
+                        const PacketRef pr(recv_block,uint(body-recv_block->GetData()),h.size,header_size,recv_timestamp);
+
+                        if constexpr(FRAMER::HAS_TYPE)
+                            OnRecvPacket(h.type,pr);
+                        else
+                            OnRecvPacket(pr);
+                    }
+                    else
+                    {
+                        if constexpr(FRAMER::HAS_TYPE)
+                            OnRecvPacket(h.type,body,h.size);
+                        else
+                            OnRecvPacket(body,h.size);
+                    }
+
+                    p   +=header_size+h.size;
+                    size-=header_size+h.size;
+
+                    if(recv_pause)                                              //回调中暂停了接收，剩下的包留到恢复后
+                        break;
+                }
+
+                return int(p-data);
+            }
+
+            uint64 GetPacketNeed(const uchar *data,uint size)const override
+            {
+                PacketFrameHeader h;
+
+                const int header_size=FRAMER::Decode(data,size,h);
+
+                return(header_size>0?uint64(header_size)+h.size:0);     //包长接近0xFFFFFFFF时不能回绕
+            }
+
+            bool SendFramedPacket(const uint type,const void *data,const PACKET_SIZE_TYPE size)
+            {
+                if(!data||size<=0)return(false);
+                if(size>FRAMER::MAX_BODY_SIZE)return(false);
+
+                uchar header[FRAMER::HEADER_MAX];
+
+                const uint header_size=FRAMER::Encode(header,size,type);
+
+                return SendFrame(header,header_size,data,size);
+            }
+
+        public:
+
+            using TCPAcceptPacketBase::TCPAcceptPacketBase;
+            virtual ~TCPAcceptFramedPacket()=default;
+
+            virtual bool SendPacket(void *data,const PACKET_SIZE_TYPE &size)    ///<发包
+            {
+                return SendFramedPacket(0,data,size);
+            }
+
+            bool SendPacket(const uint type,void *data,const PACKET_SIZE_TYPE &size)   ///<发带类型的包(封包格式需有类型字段)
+            {
+                static_assert(FRAMER::HAS_TYPE,"framer has no type field");
+
+                return SendFramedPacket(type,data,size);
+            }
+
+            /**
+             * 将一个包(含包头)编码到共享数据块中，用于广播
+             * @return 共享数据块(引用计数为1，由调用者释放)
+             */
+            static SharedBuffer *MakeSharedPacket(const void *data,const PACKET_SIZE_TYPE &size,const uint type=0)
+            {
+                if(!data||size<=0)return(nullptr);
+                if(size>FRAMER::MAX_BODY_SIZE)return(nullptr);
+
+                uchar header[FRAMER::HEADER_MAX];
+
+                const uint header_size=FRAMER::Encode(header,size,type);
+
+                SharedBuffer *sb=SharedBuffer::Create(header_size+size);
+
+                memcpy(sb->GetData(),header,header_size);
+                memcpy(sb->GetData()+header_size,data,size);
+
+                return sb;
+            }
+
+            virtual bool OnRecvPacket(void *,const PACKET_SIZE_TYPE &){return(false);}                 ///<接收包事件函数(没有类型字段的封包格式)
+            virtual bool OnRecvPacket(const uint,void *,const PACKET_SIZE_TYPE &){return(false);}      ///<接收包事件函数(有类型字段的封包格式)
+
+            /**
+             * 接收包事件函数(SetPacketRef模式，没有类型字段的封包格式)，缺省转为指针方式的回调
+             */
+            virtual bool OnRecvPacket(const PacketRef &pr)
+            {
+                return OnRecvPacket((void *)pr.GetData(),PACKET_SIZE_TYPE(pr.GetSize()));
+            }
+
+            /**
+             * 接收包事件函数(SetPacketRef模式，有类型字段的封包格式)，缺省转为指针方式的回调
+             */
+            virtual bool OnRecvPacket(const uint type,const PacketRef &pr)
+            {
+                return OnRecvPacket(type,(void *)pr.GetData(),PACKET_SIZE_TYPE(pr.GetSize()));
+            }
+        };//class TCPAcceptFramedPacket:public TCPAcceptPacketBase
+
+        /**
+         * 使用缺省封包格式(本机字节序uint32包长)的收发包对象
+         */
+        class TCPAcceptPacket:public TCPAcceptFramedPacket<DefaultPacketFramer>
+        {
         public:
 
             TCPAcceptPacket();                                                  ///<本类构造函数
-            TCPAcceptPacket(int,IPAddress *);                                   ///<本类构造函数
+            TCPAcceptPacket(int,const IPAddress *);                             ///<本类构造函数
             virtual ~TCPAcceptPacket()=default;
 
-            virtual bool SendPacket(void *,const PACKET_SIZE_TYPE &);           ///<发包
-            virtual bool OnRecvPacket(void *,const PACKET_SIZE_TYPE &)=0;       ///<接收包事件函数
-        };//class TCPAcceptPacket:public TCPAccept
+            using TCPAcceptFramedPacket<DefaultPacketFramer>::OnRecvPacket;
+            virtual bool OnRecvPacket(void *,const PACKET_SIZE_TYPE &) override=0;  ///<接收包事件函数
+        };//class TCPAcceptPacket:public TCPAcceptFramedPacket<DefaultPacketFramer>
     }//namespace network
 }//namespace hgl
 #endif//HGL_NETWORK_TCP_ACCEPT_INCLUDE
@@ -16,14 +16,13 @@ namespace hgl
             io::InputStream *sis;
             io::OutputStream *sos;
 
-            char *ipstr;
-
             virtual void InitPrivate(int);
 
         public:
 
             double Heart;                                                                               ///<心跳间隔时间(单位:秒，默认参见HGL_TCP_HEART_TIME)
             double TimeOut;                                                                             ///<超时时间(单位:秒，默认参见HGL_NETWORK_TIME_OUT)
+            double ConnectTimeOut;                                                                      ///<连接超时时间(单位:秒，默认为0，表示由系统决定)
 
         public:
 
@@ -36,7 +35,7 @@ namespace hgl
             virtual void Disconnect();                                                                  ///<断开连接
             virtual bool UseSocket(int,const IPAddress *addr) override;                                 ///<使用指定socket
 
-            const char *GetIPString()const{return ipstr;}                                               ///<取得IP可视字符串
+            const char *GetIPString()const{return ThisAddress.IsValid()?ThisAddress.GetString():nullptr;} ///<取得IP可视字符串(第一次调用时生成)
 
         public:
 
@@ -45,6 +44,31 @@ namespace hgl
         };//class TCPClient
 
         TCPClient *CreateTCPClient(IPAddress *);
+        TCPClient *CreateTCPClient(IPAddress *,const double time_out);                                  ///<在指定时间内连接，超时返回nullptr
+
+        /**
+         * 多地址连接参数(RFC 8305 Happy Eyeballs)
+         */
+        struct HappyEyeballsConfig
+        {
+            double  time_out        =HGL_NETWORK_TIME_OUT;                                              ///<整个连接过程的最长时间(秒)
+            double  attempt_delay   =0.25;                                                              ///<上一个尝试还没有结果时，开始下一个尝试的间隔(秒，RFC 8305建议250毫秒)
+            bool    prefer_ipv6     =true;                                                              ///<先尝试IPv6
+        };//struct HappyEyeballsConfig
+
+        /**
+         * 同时向多个地址发起连接，返回最先成功的连接<br>
+         * 地址按协议家族交错排列(IPv6、IPv4、IPv6...)，每隔attempt_delay或上一个尝试失败时开始下一个，
+         * 某一路由被黑洞时不会拖住整个连接过程。其余尝试在有一个成功后关闭。
+         * @param addr_list 地址列表(由调用者持有)
+         * @return 连接成功的TCPClient，超时或全部失败返回nullptr
+         */
+        TCPClient *CreateTCPClient(const List<IPAddress *> &addr_list,const HappyEyeballsConfig &cfg=HappyEyeballsConfig());
+
+        /**
+         * 解析域名的IPv6与IPv4地址(经过DNSCache)，再以Happy Eyeballs方式连接
+         */
+        TCPClient *CreateTCPClient(const char *host,ushort port,const HappyEyeballsConfig &cfg=HappyEyeballsConfig());
     }//namespace network
 
     using namespace network;
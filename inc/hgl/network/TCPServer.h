@@ -18,6 +18,10 @@ namespace hgl
 #if (HGL_OS != HGL_OS_Windows)&&(HGL_OS != HGL_OS_macOS)
             void SetDeferAccept(const int);                                                         ///<设置推迟Accept
 #endif//no windows&mac
+
+#if HGL_OS == HGL_OS_Linux
+            bool SetIncomingCPU(const int);                                                         ///<设置本监听socket优先接收哪个CPU上收到的连接
+#endif//HGL_OS == HGL_OS_Linux
         };//class TCPServer
     }//namespace network
 
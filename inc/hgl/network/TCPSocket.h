@@ -8,6 +8,31 @@ namespace hgl
     {
         int CreateTCPConnect(IPAddress *);                                                          ///<创建一个tcp连接
 
+        /**
+         * TCP连接的传输状态(TCP_INFO，仅Linux)
+         */
+        struct TCPConnectionInfo
+        {
+            double  sample_time;                                                                    ///<采样时间(0表示还没有采样)
+
+            uint32  rtt;                                                                            ///<平滑RTT(微秒)
+            uint32  rtt_var;                                                                        ///<RTT偏差(微秒)
+            uint32  rto;                                                                            ///<重传超时(微秒)
+
+            uint32  cwnd;                                                                           ///<拥塞窗口(分段数)
+            uint32  ssthresh;                                                                       ///<慢启动阈值(分段数)
+            uint32  mss;                                                                            ///<发送MSS
+
+            uint32  unacked;                                                                        ///<已发出还未确认的分段数
+            uint32  lost;                                                                           ///<估计已丢失的分段数
+            uint32  retransmits;                                                                    ///<当前连续超时重传次数(>0表示正在超时重传)
+            uint32  total_retrans;                                                                  ///<累计重传的分段数
+            uint32  send_queue_bytes;                                                               ///<内核发送缓冲区中的字节数(未确认的与还未发出的)
+
+            uint8   state;                                                                          ///<TCP状态(1为ESTABLISHED)
+            uint8   ca_state;                                                                       ///<拥塞控制状态(0 Open,1 Disorder,2 CWR,3 Recovery,4 Loss)
+        };//struct TCPConnectionInfo
+
         /**
         * TCP连接处理基类<br>
         * 提供统一的Recv/Send函数以及缓冲区，但请注意这个recv/send都只是针对缓冲区的，真正的send/recv在各自的派生类中。
@@ -30,6 +55,8 @@ namespace hgl
             bool SetNodelay(bool);                                                                  ///<设置是否使用无延迟方式
             void SetKeepAlive(bool,const int=7200,const int=75,const int=9);                        ///<设置自动保持连接机制
 
+            bool ReadTCPInfo(TCPConnectionInfo &)const;                                             ///<读取传输状态(不设置sample_time，不支持的系统返回false)
+
             virtual bool UseSocket(int,const IPAddress *) override;                                 ///<使用指定socket
 
             virtual bool IsConnect();                                                               ///<当前socket是否在连接状态
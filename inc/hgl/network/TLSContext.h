@@ -0,0 +1,83 @@
+﻿#ifndef HGL_NETWORK_TLS_CONTEXT_INCLUDE
+#define HGL_NETWORK_TLS_CONTEXT_INCLUDE
+
+#include<hgl/type/BaseString.h>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * TLS参数
+         */
+        struct TLSConfig
+        {
+            AnsiString  cert_file;                                          ///<证书链文件(PEM，服务器必须)
+            AnsiString  key_file;                                           ///<私钥文件(PEM，服务器必须)
+            AnsiString  ca_file;                                            ///<校验对方证书使用的CA文件(为空时使用系统缺省)
+
+            bool        verify_peer     =false;                             ///<是否校验对方证书(服务器要求客户端证书，客户端校验服务器证书)
+
+            AnsiString  cipher_list;                                        ///<TLS1.2密码套件(为空使用缺省，kTLS只支持AES-GCM与ChaCha20-Poly1305)
+            AnsiString  cipher_suites;                                      ///<TLS1.3密码套件(为空使用缺省)
+
+            bool        client_tls13    =false;                             ///<客户端是否使用TLS1.3(服务器握手后发来的NewSessionTicket在kTLS下会让接收出错，缺省限制为TLS1.2)
+        };//struct TLSConfig
+
+        /**
+         * 一个连接的TLS握手<br>
+         * 由TCPAccept::StartTLS接管，在SocketManage的收发事件中驱动，握手完成后即被释放，
+         * 之后的记录加解密全部由内核(kTLS)完成，socket上的收发、零拷贝、sendfile与明文TCP完全一样
+         */
+        class TLSSession
+        {
+        public:
+
+            virtual ~TLSSession()=default;
+
+            /**
+             * 继续握手(非阻塞)
+             * @return 1 握手完成且kTLS已开启
+             * @return 0 需要等待socket可读/可写
+             * @return -1 出错
+             */
+            virtual int Handshake()=0;
+
+            virtual const bool WantWrite()const=0;                          ///<上一次Handshake是否在等待socket可写
+            virtual const bool IsServer()const=0;                           ///<是否服务器端
+        };//class TLSSession
+
+        /**
+         * TLS上下文(OpenSSL SSL_CTX的封装，需要开启BUILD_NETWORK_TLS)<br>
+         * 握手在用户空间由OpenSSL完成，完成后对称加密交给内核(TCP_ULP "tls")，
+         * 要求OpenSSL 3.0以上并以kTLS方式编译，系统已加载tls模块，协商出的密码套件为kTLS支持的AEAD，
+         * 任何一项不满足时握手视为失败(不提供用户空间加解密的退路)。<br>
+         * kTLS下收到的非数据记录(alert、KeyUpdate等)会使recv出错，连接随之关闭。<br>
+         * 一个TLSContext可被多个线程同时用于CreateSession，但Init之后不能再修改。
+         */
+        class TLSContext
+        {
+            void *ctx=nullptr;                                              ///<SSL_CTX
+            bool server=true;
+
+        public:
+
+            TLSContext()=default;
+            ~TLSContext();
+
+            bool InitServer(const TLSConfig &);                             ///<初始化为服务器端(加载证书与私钥)
+            bool InitClient(const TLSConfig &);                             ///<初始化为客户端
+            void Close();
+
+            const bool IsServer()const{return server;}
+
+            /**
+             * 为一个socket创建TLS握手对象
+             * @param sock socket(须为非阻塞模式，或在加入SocketManage之前创建)
+             * @param host_name 客户端的SNI与证书校验主机名(可以为nullptr)
+             * @return 握手对象，交给TCPAccept::StartTLS
+             */
+            TLSSession *CreateSession(int sock,const char *host_name=nullptr)const;
+        };//class TLSContext
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_TLS_CONTEXT_INCLUDE
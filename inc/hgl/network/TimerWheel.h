@@ -0,0 +1,80 @@
+﻿#ifndef HGL_NETWORK_TIMER_WHEEL_INCLUDE
+#define HGL_NETWORK_TIMER_WHEEL_INCLUDE
+
+#include<hgl/type/List.h>
+namespace hgl
+{
+    namespace network
+    {
+        constexpr double HGL_TIMER_WHEEL_TICK       =0.01;                                          ///<时间轮缺省精度(秒)
+
+        constexpr uint   HGL_TIMER_WHEEL_ROOT_BITS  =8;                                             ///<第一级时间轮位数(256格)
+        constexpr uint   HGL_TIMER_WHEEL_LEVEL_BITS =6;                                             ///<其它级时间轮位数(64格)
+        constexpr uint   HGL_TIMER_WHEEL_LEVEL_COUNT=3;                                             ///<第一级之外的级数
+
+        constexpr uint   HGL_TIMER_WHEEL_ROOT_SIZE  =1<<HGL_TIMER_WHEEL_ROOT_BITS;
+        constexpr uint   HGL_TIMER_WHEEL_LEVEL_SIZE =1<<HGL_TIMER_WHEEL_LEVEL_BITS;
+
+        constexpr uint64 HGL_TIMER_WHEEL_MAX_TICKS  =(uint64(1)<<(HGL_TIMER_WHEEL_ROOT_BITS+HGL_TIMER_WHEEL_LEVEL_BITS*HGL_TIMER_WHEEL_LEVEL_COUNT))-1;   ///<最长定时(刻度数)，超出的按最长处理
+
+        /**
+         * 定时器节点，由使用者嵌入在自己的对象中，不需要额外分配内存
+         */
+        struct TimerNode
+        {
+            TimerNode *prev=nullptr;
+            TimerNode *next=nullptr;
+
+            uint64 expire=0;                                                                        ///<到期刻度
+            void *owner=nullptr;                                                                    ///<所属对象
+
+        public:
+
+            const bool IsActive()const{return prev!=nullptr;}                                       ///<是否在时间轮中
+        };//struct TimerNode
+
+        using TimerNodeList=List<TimerNode *>;
+
+        /**
+         * 分级时间轮<br>
+         * 加入、移除都是O(1)，每个刻度只处理当前格，高一级的格子在低一级转完一圈时才分散到低一级。<br>
+         * 缺省精度10ms，4级共26位，最长约7.7天。
+         */
+        class TimerWheel
+        {
+            TimerNode root[HGL_TIMER_WHEEL_ROOT_SIZE];                                              ///<各格的链表头(哨兵节点)
+            TimerNode level[HGL_TIMER_WHEEL_LEVEL_COUNT][HGL_TIMER_WHEEL_LEVEL_SIZE];
+
+            double tick_time;                                                                       ///<一个刻度的时间(秒)
+            double start_time;                                                                      ///<第0个刻度对应的时间
+
+            uint64 cur_tick;                                                                        ///<下一个要处理的刻度
+            int count;                                                                              ///<时间轮中的定时器数量
+
+        private:
+
+            void Link(TimerNode *);
+            void Cascade(uint,uint);
+
+            const uint64 ToTick(const double t)const;
+
+        public:
+
+            TimerWheel(const double tick=HGL_TIMER_WHEEL_TICK);
+            ~TimerWheel()=default;
+
+            void    Start(const double cur_time);                                                   ///<以指定时间为起点(清除所有定时器)
+
+            const   int     GetCount()const{return count;}                                          ///<取得定时器数量
+            const   double  GetTickTime()const{return tick_time;}                                   ///<取得精度
+
+                    void    Add(TimerNode *,const double expire_time);                              ///<加入一个定时器(到期时间为绝对时间)
+                    void    Remove(TimerNode *);                                                    ///<移除一个定时器
+
+                    int     Update(const double cur_time,TimerNodeList &expired_list);              ///<推进到当前时间，取出所有到期的定时器
+
+                    double  GetNextTimeOut(const double cur_time)const;                             ///<取得距离下一个定时器到期的时间(<0表示没有定时器)
+        };//class TimerWheel
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_TIMER_WHEEL_INCLUDE
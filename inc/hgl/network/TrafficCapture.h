@@ -0,0 +1,168 @@
+﻿#ifndef HGL_NETWORK_TRAFFIC_CAPTURE_INCLUDE
+#define HGL_NETWORK_TRAFFIC_CAPTURE_INCLUDE
+
+#include<hgl/platform/Platform.h>
+#include<hgl/thread/ThreadMutex.h>
+#include<atomic>
+#include<stdio.h>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 流量录制文件格式<br>
+         * 文件头之后是连续的记录，每条记录为TrafficCaptureRecord+数据，按8字节对齐，可以直接mmap后顺序遍历。
+         * 整数全部为录制机器的本机字节序(文件头中的byte_order用于检查)，记录按时间先后排列。
+         */
+        constexpr char      HGL_TRAFFIC_CAPTURE_MAGIC[8]    ={'H','G','L','T','C','A','P',0};
+        constexpr uint32    HGL_TRAFFIC_CAPTURE_VERSION     =1;
+        constexpr uint32    HGL_TRAFFIC_CAPTURE_BYTE_ORDER  =0x01020304;
+        constexpr uint      HGL_TRAFFIC_CAPTURE_ALIGN       =8;
+
+        enum class TrafficCaptureKind:uint8
+        {
+            Open=0,                                                         ///<连接加入(没有数据)
+            Close,                                                          ///<连接结束(没有数据)
+            Packet,                                                         ///<TCPAcceptFramedPacket收到的包(数据含包头，可原样重放)
+            WebSocketBinary,                                                ///<WebSocketAccept::OnBinary的数据(解掩码、解压后)
+            WebSocketText,                                                  ///<WebSocketAccept::OnText的数据(解掩码、解压后)
+        };//enum class TrafficCaptureKind
+
+        constexpr uint8 HGL_TRAFFIC_CAPTURE_FLAG_FIN=0x01;                  ///<消息的最后一段(WebSocket)
+
+        struct TrafficCaptureFileHeader
+        {
+            char    magic[8];
+            uint32  version;
+            uint32  byte_order;                                             ///<HGL_TRAFFIC_CAPTURE_BYTE_ORDER
+            int64   start_time;                                             ///<开始录制的墙钟时间(微秒，UNIX时间)
+            uint64  reserved;
+        };//struct TrafficCaptureFileHeader
+
+        struct TrafficCaptureRecord
+        {
+            uint64  time;                                                   ///<距开始录制的时间(纳秒，单调时钟)
+            uint32  connection;                                             ///<连接编号(从1开始，本次录制中唯一)
+            uint8   kind;                                                   ///<TrafficCaptureKind
+            uint8   flags;                                                  ///<HGL_TRAFFIC_CAPTURE_FLAG_*
+            uint16  header_size;                                            ///<数据中包头的字节数(Packet)
+            uint32  type;                                                   ///<消息类型(封包格式有类型字段时)
+            uint32  size;                                                   ///<数据字节数(含包头，不含对齐补齐)
+
+        public:
+
+            const uchar *GetData()const{return (const uchar *)(this+1);}
+            const uchar *GetBody()const{return GetData()+header_size;}
+            const uint   GetBodySize()const{return size-header_size;}
+            const bool   IsFin()const{return flags&HGL_TRAFFIC_CAPTURE_FLAG_FIN;}
+
+            const uint64 GetTotalSize()const                                ///<含数据与对齐补齐的整条记录长度
+            {
+                return (sizeof(TrafficCaptureRecord)+uint64(size)+HGL_TRAFFIC_CAPTURE_ALIGN-1)&~uint64(HGL_TRAFFIC_CAPTURE_ALIGN-1);
+            }
+        };//struct TrafficCaptureRecord
+
+        static_assert(sizeof(TrafficCaptureFileHeader)%HGL_TRAFFIC_CAPTURE_ALIGN==0,"capture file header must be aligned");
+        static_assert(sizeof(TrafficCaptureRecord)%HGL_TRAFFIC_CAPTURE_ALIGN==0,"capture record must be aligned");
+
+        /**
+         * 流量录制<br>
+         * 在TCPAccept的收包边界(TCPAcceptFramedPacket分发包、WebSocketAccept分发消息)记录收到的数据、时间与连接编号，
+         * 用于以真实的消息构成重放压力测试(见benchmark/TrafficReplay.cpp)。<br>
+         * 通过SocketManage::SetTrafficCapture(或MTTCPServer的InitInfomation::traffic_capture)开启，之后加入的连接生效。
+         * 多个SocketManage可以共用一个，每条记录加锁复制到缓冲区，缓冲区满时在调用者线程中写入文件，所以只在需要录制时开启。<br>
+         * 必须在使用它的所有连接释放之后才能销毁。
+         */
+        class TrafficCapture
+        {
+            ThreadMutex lock;
+
+            FILE *      fp=nullptr;
+
+            uchar *     buffer=nullptr;
+            uint        buffer_size=0;
+            uint        buffer_length=0;
+
+            uint64      max_bytes=0;                                        ///<文件最大长度(0表示不限制)
+            uint64      file_bytes=0;                                       ///<已写入(含缓冲区中)的长度
+            bool        full=false;
+
+            int64       start_time=0;                                       ///<开始录制的单调时钟时间(纳秒)
+
+            std::atomic<uint32> connection_serial{0};
+            std::atomic<uint64> record_count{0};
+            std::atomic<uint64> drop_count{0};
+
+        private:
+
+            bool FlushBuffer();
+            void Write(uint32,TrafficCaptureKind,uint8,uint,const void *,uint,uint);
+
+        public:
+
+            TrafficCapture()=default;
+            ~TrafficCapture();
+
+            /**
+             * 创建录制文件
+             * @param filename 文件名
+             * @param max_bytes 文件最大长度(超出后的记录被丢弃，0表示不限制)
+             * @param buffer_size 写入缓冲区大小
+             */
+            bool Create(const char *filename,const uint64 max_bytes=0,const uint buffer_size=HGL_SIZE_1MB*4);
+            void Close();                                                   ///<写完缓冲区并关闭文件
+            bool Flush();                                                   ///<将缓冲区写入文件
+
+            const bool IsOpen()const{return fp!=nullptr;}
+
+            const uint64 GetRecordCount()const{return record_count.load(std::memory_order_relaxed);}
+            const uint64 GetDropCount()const{return drop_count.load(std::memory_order_relaxed);}   ///<超出文件最大长度或写入失败而丢弃的记录数
+
+            uint32 OpenConnection();                                        ///<分配连接编号并记录连接加入
+            void CloseConnection(const uint32);                             ///<记录连接结束
+
+            /**
+             * 记录收到的一个包/消息
+             * @param connection 连接编号
+             * @param kind 记录类型
+             * @param type 消息类型
+             * @param data 数据(含包头)
+             * @param header_size 包头字节数
+             * @param size 数据字节数(含包头)
+             * @param fin 是否为消息的最后一段
+             */
+            void Record(const uint32 connection,const TrafficCaptureKind kind,const uint type,const void *data,const uint header_size,const uint size,const bool fin=true)
+            {
+                Write(connection,kind,fin?HGL_TRAFFIC_CAPTURE_FLAG_FIN:0,type,data,header_size,size);
+            }
+        };//class TrafficCapture
+
+        /**
+         * 录制文件读取(mmap整个文件，记录直接在映射的内存上访问)
+         */
+        class TrafficCaptureReader
+        {
+            uchar *     data=nullptr;
+            uint64      size=0;
+
+        public:
+
+            TrafficCaptureReader()=default;
+            ~TrafficCaptureReader(){Close();}
+
+            bool Open(const char *filename);                                ///<打开并检查文件头
+            void Close();
+
+            const TrafficCaptureFileHeader *GetHeader()const{return (const TrafficCaptureFileHeader *)data;}
+
+            const uint64 GetFirst()const{return sizeof(TrafficCaptureFileHeader);}                 ///<第一条记录的位置
+
+            /**
+             * 取得指定位置的记录并移到下一条
+             * @return 记录，到达文件尾或记录不完整(录制中途退出)时返回nullptr
+             */
+            const TrafficCaptureRecord *Next(uint64 &pos)const;
+        };//class TrafficCaptureReader
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_TRAFFIC_CAPTURE_INCLUDE
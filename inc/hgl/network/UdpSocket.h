@@ -2,23 +2,59 @@
 #define HGL_UDPSOCKET_INCLUDE
 
 #include<hgl/type/DataType.h>
-#include<hgl/network/Socket.h>
+#include<hgl/network/DatagramSocket.h>
 namespace hgl
 {
     namespace network
     {
+        /**
+         * 批量收发时的一个数据包
+         */
+        struct UDPPacket
+        {
+            void *      data        =nullptr;                                                       ///<接收:缓冲区 发送:数据
+            int         size        =0;                                                             ///<接收:缓冲区长度 发送:数据长度
+            IPAddress * addr        =nullptr;                                                       ///<接收:填入发送方地址(可为nullptr) 发送:目标地址(nullptr表示使用SetSendAddr设定的地址)
+
+            int         result      =0;                                                             ///<实际收到/发出的字节数
+            int         segment_size=0;                                                             ///<接收:开启GRO后被合并的每段长度(未合并时等于result，最后一段可能较短)
+
+        public:
+
+            const int GetSegmentCount()const                                                        ///<取得合并在一起的数据报数量
+            {
+                if(result<=0)return 0;
+                if(segment_size<=0||segment_size>=result)return 1;
+
+                return (result+segment_size-1)/segment_size;
+            }
+        };//struct UDPPacket
+
+        struct UDPBatch;
+
         /**
         * 这个类提供使用UDP协议的通信，但它并不提供可靠数据传输的支持。
         */
-        class UDPSocket:public Socket                                                               ///UDP通信类
+        class UDPSocket:public DatagramSocket                                                       ///UDP通信类
         {
             IPAddress *bind_addr;
             IPAddress *tar_addr;
 
+            UDPBatch *batch;                                                                        ///<批量收发用的消息头数组(第一次使用时创建，之后重复使用)
+
+            bool gso_support;                                                                       ///<是否可以使用UDP_SEGMENT(发送失败一次后不再尝试)
+            bool gro_enable;                                                                        ///<是否已开启UDP_GRO
+
+        protected:
+
+            bool reuse_port;                                                                        ///<Create时是否设置SO_REUSEPORT
+
+            bool ApplyReusePort();
+
         public: //事件函数
 
-            virtual int ProcRecv(int=-1){return -1;}
             virtual int ProcSend(int,int &left_bytes){return -1;}
+            virtual int ProcRecvBatch(UDPPacket *,int){return -1;}                                  ///<批量收到数据包(由RecvBatch调用)
 
         public:
 
@@ -28,13 +64,29 @@ namespace hgl
             virtual bool Create(const IPAddress *);                                                 ///<创建一个udp,并绑定一个IP地址与指定端口
 //          virtual bool Create(int family);                                                        ///<创建一个udp
 
+                    void SetReusePort(bool rp){reuse_port=rp;}                                      ///<设置是否允许多个socket绑定同一地址(SO_REUSEPORT，需在Create前调用，由内核按来源在它们之间分配数据报)
+#if HGL_OS == HGL_OS_Linux
+                    bool SetIncomingCPU(const int);                                                 ///<设置本socket优先接收哪个CPU上收到的数据报(SO_INCOMING_CPU)
+#endif//HGL_OS == HGL_OS_Linux
+
                     uint GetBindPort()const{return bind_addr->GetPort();}                           ///<取得绑定端口
+            const   IPAddress *GetBindAddr()const{return bind_addr;}                                ///<取得绑定地址
 
                     bool SetSendAddr(const IPAddress *);                                            ///<设定发送地址
 
                     int SendPacket(const void *,int);                                               ///<发送数据包
                     int SendPacket(IPAddress *,const void *,int);                                   ///<向指定地址发送数据包
                     int RecvPacket(void *,int,IPAddress *);                                         ///<接收数据包
+
+                    int SendPackets(UDPPacket *,int);                                               ///<批量发送数据包，返回发出的包数
+                    int RecvPackets(UDPPacket *,int);                                               ///<批量接收数据包，返回收到的包数
+                    int RecvBatch(UDPPacket *,int);                                                 ///<批量接收数据包并调用ProcRecvBatch
+
+                    bool SetGRO(bool);                                                              ///<设置接收合并(UDP_GRO，仅Linux)
+                    bool IsGRO()const{return gro_enable;}                                           ///<是否已开启接收合并
+                    int SendSegments(IPAddress *,const void *,int,int);                             ///<将数据按相同长度切分为多个数据报发给同一地址(UDP_SEGMENT)
+
+            static  int SplitSegments(const UDPPacket &,UDPPacket *,int);                           ///<将合并接收的数据包拆分成单个数据报
         };//class UDPSocket
 
         /**
@@ -62,12 +114,14 @@ namespace hgl
             DefEvent(void,  OnDisconnect,   (BASE *));
             DefEvent(int,   OnRecv,         (BASE *,int));
             DefEvent(int,   OnSend,         (BASE *,int,int &));
+            DefEvent(int,   OnRecvBatch,    (BASE *,UDPPacket *,int));
 
             virtual void ClearEvent()
             {
                 OnDisconnect=nullptr;
                 OnRecv      =nullptr;
                 OnSend      =nullptr;
+                OnRecvBatch =nullptr;
             }
 
         public:
@@ -93,6 +147,13 @@ namespace hgl
 
                 return OnSend(this,size,left_bytes);
             }
+
+            virtual int ProcRecvBatch(UDPPacket *list,int count)
+            {
+                if(OnRecvBatch==nullptr)return(-1);
+
+                return OnRecvBatch(this,list,count);
+            }
         };//class _UDPSocketCB
 
         using UDPSocketCB     =_UDPSocketCB<UDPSocket>;
@@ -2,12 +2,44 @@
 #define HGL_NETWORK_WEBSOCKET_INCLUDE
 
 #include<hgl/type/String.h>
+#include<hgl/network/SharedBuffer.h>
 namespace hgl
 {
     namespace network
     {
-        bool GetWebSocketInfo(U8String &sec_websocket_key,U8String &sec_websocket_protocol,uint &sec_websocket_version,const u8char *data,const uint size);
-        void MakeWebSocketAccept(U8String &result,const U8String &sec_websocket_key,const U8String &sec_websocket_protocol);
+        constexpr uint HGL_WEBSOCKET_FRAME_HEADER_MAX_SIZE=10;                                      ///<服务端发出的帧头最大长度(不带掩码)
+
+        bool GetWebSocketInfo(U8String &sec_websocket_key,U8String &sec_websocket_protocol,uint &sec_websocket_version,const u8char *data,const uint size,U8String *sec_websocket_extensions=nullptr);
+        void MakeWebSocketAccept(U8String &result,const U8String &sec_websocket_key,const U8String &sec_websocket_protocol,const U8String *sec_websocket_extensions=nullptr);
+
+        void WebSocketMask(void *data,uint64 size,const uint32 mask,const uint64 offset=0);        ///<WebSocket掩码/解码(SIMD加速，原地处理)
+
+        /**
+         * 流式UTF-8校验(RFC3629：拒绝过长编码、代理区及超出U+10FFFF的码点)<br>
+         * 多字节字符可以跨段，连续的ASCII部分按32/16字节SIMD批量跳过
+         */
+        struct UTF8Validator
+        {
+            uint8 pending=0;                                                                        ///<当前字符还需要的后续字节数
+            uint8 lower=0x80;                                                                       ///<下一个后续字节的最小值
+            uint8 upper=0xBF;                                                                       ///<下一个后续字节的最大值
+
+            void Reset(){pending=0;lower=0x80;upper=0xBF;}
+
+            bool Update(const void *data,uint64 size);                                              ///<校验一段数据(false表示出错，需Reset后才能再用)
+
+            const bool IsComplete()const{return pending==0;}                                        ///<当前位置是否没有未完成的字符(消息结束时调用)
+        };//struct UTF8Validator
+
+        inline bool IsValidUTF8(const void *data,uint64 size)                                      ///<校验一段完整的UTF-8数据
+        {
+            UTF8Validator v;
+
+            return v.Update(data,size)&&v.IsComplete();
+        }
+
+        uint MakeWebSocketFrameHeader(uint8 *header,const uint8 opcode,const uint64 size,const bool fin,const bool rsv1=false);  ///<生成帧头，返回帧头长度
+        SharedBuffer *MakeWebSocketFrame(const uint8 opcode,const void *data,const uint size,const bool fin=true);              ///<将一条消息编码为完整的帧，用于广播
     }//namespace network
 }//namespace hgl
 #endif//HGL_NETWORK_WEBSOCKET_INCLUDE
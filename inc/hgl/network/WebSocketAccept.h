@@ -2,13 +2,21 @@
 #define HGL_NETWORK_WEBSOCKET_ACCEPT_INCLUDE
 
 #include<hgl/network/TCPAccept.h>
+#include<hgl/network/WebSocketDeflate.h>
+#include<hgl/network/WebSocket.h>
+#include<hgl/network/HTTPRequest.h>
 #include<hgl/type/String.h>
 namespace hgl
 {
     namespace network
     {
+        constexpr uint HGL_WEBSOCKET_HANDSHAKE_MAX_SIZE=HGL_SIZE_1KB*8;                             ///<WebSocket握手HTTP头最大长度
+        constexpr uint HGL_WEBSOCKET_MAX_FRAME_SIZE    =HGL_SIZE_1MB*16;                            ///<整帧缓存的帧缺省最大长度(与WebSocketDeflateConfig::max_message_size相同)
+
         /**
-         * WebSocket接入管理
+         * WebSocket接入管理<br>
+         * wss://只需在加入SocketManage前StartTLS，TLS握手完成后才开始收到WebSocket握手请求<br>
+         * 握手前收到的普通HTTP请求(没有Sec-WebSocket-Key)交给OnHTTPRequest，健康检查等可以与WebSocket共用一个端口
          */
         class WebSocketAccept:public TCPAccept
         {
@@ -22,12 +30,47 @@ namespace hgl
 
             uint64          recv_total=0;
 
+            bool            handshake_done=false;                               ///<是否已完成握手
+            uint            handshake_scan_pos=0;                               ///<握手头已查找过结束符的位置
+            bool            http_keep_alive=true;                               ///<当前普通HTTP请求回应后是否保持连接
+
+            uint            stream_chunk_size=0;                                ///<流式分段大小(0表示不使用流式，整帧收完再回调)
+            uint            max_frame_size=HGL_WEBSOCKET_MAX_FRAME_SIZE;        ///<整帧缓存的帧最大长度(流式处理的帧不受限制)
+
+            WebSocketDeflateConfig  deflate_config;                             ///<permessage-deflate服务端配置
+            WebSocketDeflateConfig  deflate_param;                              ///<permessage-deflate协商结果
+            WebSocketDeflater *     deflater=nullptr;                           ///<当前使用的压缩器(保留上下文时一直占用)
+            WebSocketInflater *     inflater=nullptr;                           ///<当前使用的解压器(保留上下文时一直占用)
+            DataArray<uint8>        deflate_buffer;                             ///<压缩发送缓冲区
+            DataArray<uint8>        inflate_buffer;                             ///<解压接收缓冲区
+            uint64                  inflate_total=0;                            ///<当前消息已解压的字节数(跨分片累计，检查max_message_size)
+
+            uint            send_opcode=0;                                      ///<正在分片发送的消息类型(0表示没有)
+
+            bool            text_validate=true;                                 ///<是否校验文本消息为合法UTF-8(RFC6455要求，出错时关闭连接)
+            UTF8Validator   text_validator;                                     ///<当前文本消息的校验状态(跨帧、跨段)
+
+            uint            text_assemble_max=0;                                ///<分片文本消息合并后的最大长度(0表示不合并)
+            SharedBuffer *  text_block=nullptr;                                 ///<合并中的文本消息(从SharedBuffer池取得)
+            uint            text_length=0;                                      ///<text_block中已有的长度
+
         protected:
 
             virtual int OnSocketRecv(int) override;                                      ///<Socket接收处理函数
 
-            void WebSocketHandshake();
-            int SendFrame(uint8,void *,uint32,bool);
+            int  ProcHandshake();                                               ///<处理握手(可分多次收完)
+            int  ProcHTTPRequest(const HTTPRequest &);                          ///<处理握手前的普通HTTP请求
+            int SendFrame(uint8,const void *,uint64,bool,bool rsv1=false);
+            bool SendMessage(uint8,const void *,uint32,bool);                   ///<发送一条消息或其中一个分片(按需压缩)
+
+            int  ParseFrameHeader();                                            ///<解析帧头
+            bool ProcFrameData(char *,uint32,bool);                             ///<处理一段帧数据
+            bool ProcInflateData(char *,uint32,bool);                           ///<处理一段压缩的帧数据
+            bool DeliverData(char *,uint32,bool);                               ///<将消息数据交给OnBinary/OnText
+            bool AppendText(const char *,uint32);                               ///<将一段文本追加到text_block
+            void ReleaseTextBlock();
+            void ReleaseDeflate();                                              ///<释放压缩/解压器
+            void ConsumeRecvBuffer(uint);                                       ///<从接收缓冲区移除已处理的数据
 
         protected:
 
@@ -38,6 +81,14 @@ namespace hgl
             uint64  msg_length;
             uint64  msg_full_length;
 
+            bool    msg_header_done;                                            ///<当前帧的帧头是否已处理
+            bool    msg_stream;                                                 ///<当前帧是否以流式回调
+            uint32  msg_mask;
+            uint64  msg_recv_length;                                            ///<当前帧已处理的数据长度
+            uint    msg_data_opcode;                                            ///<当前帧所属消息的类型(1:text,2:binary)
+            bool    msg_compressed=false;                                       ///<当前消息是否压缩(RSV1)
+            bool    msg_partial=false;                                          ///<当前消息是否已以fin=false回调过
+
             uint    last_opcode;
 
         protected: //WebSocket支持
@@ -55,11 +106,63 @@ namespace hgl
                 return(true);
             }
 
+            /**
+             * 握手前收到了不是WebSocket握手的普通HTTP请求(不支持请求体，带请求体的回应413并关闭)<br>
+             * 可在其中用SendHTTPResponse回应，之后按请求的keep-alive继续等待下一个请求或发完后关闭
+             * @return 是否正常，缺省返回false直接关闭连接
+             */
+            virtual bool OnHTTPRequest(const HTTPRequest &){return(false);}
+
+            bool SendHTTPResponse(const uint status,const void *body,const uint size,const char *content_type=nullptr,const char *extra_headers=nullptr);   ///<回应OnHTTPRequest中的请求
+
         public:
 
             WebSocketAccept();                                                  ///<本类构造函数
-            WebSocketAccept(int,IPAddress *);                                   ///<本类构造函数
-            virtual ~WebSocketAccept()=default;
+            WebSocketAccept(int,const IPAddress *);                             ///<本类构造函数
+            virtual ~WebSocketAccept();
+
+            virtual bool UseSocket(int,const IPAddress *) override;             ///<使用指定socket(重置握手与收包状态)
+
+            virtual bool SaveHandoffState(DataArray<uchar> &) override;         ///<热重启时保存握手状态(只转交处于消息之间、未使用压缩的连接)
+            virtual int  LoadHandoffState(const uchar *,const uint) override;
+
+            /**
+             * 设定流式分段大小<br>
+             * 数据超过此长度的帧不会再整帧缓存，而是每收到一段就以fin=false回调OnBinary/OnText,
+             * 消息的最后一段才会以fin=true回调。每个连接的接收缓冲区因此不会超过此长度。
+             * @param size 分段大小(0表示关闭流式处理)
+             */
+            void SetStreamChunkSize(const uint size){stream_chunk_size=size;}
+
+            /**
+             * 设定整帧缓存的帧最大长度<br>
+             * 不使用流式处理(或帧不超过流式分段大小)时，帧会整帧收进接收缓冲区，更长的帧视为出错并关闭连接，
+             * 对方只发一个帧头就能让接收缓冲区扩大到多大由此限制
+             */
+            void SetMaxFrameSize(const uint size){max_frame_size=size;}
+
+            /**
+             * 设定permessage-deflate压缩(RFC7692)，需在握手前设定<br>
+             * 编译时需开启BUILD_NETWORK_WEBSOCKET_DEFLATE，否则不会协商压缩。<br>
+             * 压缩状态不是线程安全的，同一连接的Send*需在同一线程调用。
+             */
+            void SetDeflate(const WebSocketDeflateConfig &cfg){deflate_config=cfg;}
+
+            const bool IsDeflate()const{return deflate_param.enable;}                  ///<是否已协商使用压缩
+
+            /**
+             * 设定是否校验文本消息为合法UTF-8(缺省开启)<br>
+             * 在解掩码(或解压)后的数据上流式校验，字符可以跨帧、跨段，不合法时调用OnError并关闭连接
+             */
+            void SetTextValidate(const bool v){text_validate=v;}
+
+            /**
+             * 设定分片文本消息的合并<br>
+             * 开启后分片(包括流式分段)的文本消息不再逐段回调，而是在池中的数据块里拼好后以fin=true回调一次OnText，
+             * 未分片的消息依然直接使用接收缓冲区，不产生复制。
+             * @param max_size 合并后的最大长度(超出视为出错，0表示关闭合并)
+             */
+            void SetTextAssemble(const uint max_size){text_assemble_max=max_size;}
 
             virtual void OnPing(){}
             virtual void OnPong(){}
@@ -67,10 +170,13 @@ namespace hgl
             virtual bool OnText(char *,uint32,bool)=0;
             virtual void OnError(){}
 
+            using TCPAccept::SendShared;
+            virtual bool SendShared(SharedBuffer *,const uint,const uint) override;    ///<发送共享的完整帧(广播用)
+
             bool SendPing();
             bool SendPong();
-            bool SendBinary(void *,uint32,bool=true);
-            bool SendText(void *,uint32,bool=true);
+            bool SendBinary(const void *,uint32,bool=true);
+            bool SendText(const void *,uint32,bool=true);
 
             bool SendText(const U8String &str)
             {
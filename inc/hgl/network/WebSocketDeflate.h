@@ -0,0 +1,101 @@
+﻿#ifndef HGL_NETWORK_WEBSOCKET_DEFLATE_INCLUDE
+#define HGL_NETWORK_WEBSOCKET_DEFLATE_INCLUDE
+
+#include<hgl/type/String.h>
+#include<hgl/type/DataArray.h>
+
+struct z_stream_s;
+
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * WebSocket permessage-deflate(RFC7692)参数<br>
+         * 作为服务端配置时表示愿意接受的上限，协商完成后表示实际使用的参数
+         */
+        struct WebSocketDeflateConfig
+        {
+            bool enable                     =false;                                                 ///<是否启用
+
+            bool server_no_context_takeover =true;                                                  ///<服务端每条消息重置压缩器(可从线程池借用压缩器，大幅节省内存)
+            bool client_no_context_takeover =true;                                                  ///<要求客户端每条消息重置压缩器(客户端提出时才会生效)
+
+            uint server_max_window_bits     =15;                                                    ///<服务端压缩窗口位数(9-15)
+            uint client_max_window_bits     =15;                                                    ///<客户端压缩窗口位数(9-15)
+
+            int  compress_level             =6;                                                     ///<压缩级别(1-9)
+            uint min_compress_size          =256;                                                   ///<小于此长度的消息不压缩
+
+            uint max_message_size           =HGL_SIZE_1MB*16;                                       ///<解压后单条消息最大长度(分片消息按所有分片合计，流式处理的帧不计入)
+        };//struct WebSocketDeflateConfig
+
+        /**
+         * 解析Sec-WebSocket-Extensions并协商permessage-deflate参数
+         * @param result 协商结果
+         * @param response 需要回复的Sec-WebSocket-Extensions内容
+         * @param extensions 客户端发来的Sec-WebSocket-Extensions
+         * @param config 服务端配置
+         * @return 是否启用permessage-deflate
+         */
+        bool NegotiateWebSocketDeflate(WebSocketDeflateConfig &result,U8String &response,const U8String &extensions,const WebSocketDeflateConfig &config);
+
+        /**
+         * permessage-deflate压缩器
+         */
+        class WebSocketDeflater
+        {
+            z_stream_s *zs=nullptr;
+
+            int level;
+            int window_bits;
+
+        public:
+
+            WebSocketDeflater(int l,int wb);
+            ~WebSocketDeflater();
+
+            const bool IsMatch(int l,int wb)const{return level==l&&window_bits==wb;}
+
+            bool Compress(DataArray<uint8> &out,const void *data,const uint size);                 ///<压缩一条完整消息(已去掉结尾的00 00 FF FF)
+            void Reset();                                                                           ///<重置压缩上下文
+        };//class WebSocketDeflater
+
+        /**
+         * permessage-deflate解压器
+         */
+        class WebSocketInflater
+        {
+            z_stream_s *zs=nullptr;
+
+            int window_bits;
+
+        public:
+
+            WebSocketInflater(int wb);
+            ~WebSocketInflater();
+
+            const bool IsMatch(int wb)const{return window_bits==wb;}
+
+            /**
+             * 解压一段数据，结果追加到out
+             * @param finish 是否为消息的最后一段(会补上00 00 FF FF)
+             * @param max_size out的最大长度(0表示不限制)
+             * @return 是否成功
+             */
+            bool Decompress(DataArray<uint8> &out,const void *data,const uint size,const bool finish,const uint max_size=0);
+            void Reset();                                                                           ///<重置解压上下文
+        };//class WebSocketInflater
+
+        /**
+         * 从当前线程的压缩器池中借用/归还<br>
+         * 不保留上下文(no_context_takeover)的连接只在处理一条消息时才占用压缩器，同一线程内的所有连接共用很少的几个
+         */
+        WebSocketDeflater *AcquireWebSocketDeflater(int level,int window_bits);
+        void ReleaseWebSocketDeflater(WebSocketDeflater *);
+
+        WebSocketInflater *AcquireWebSocketInflater(int window_bits);
+        void ReleaseWebSocketInflater(WebSocketInflater *);
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_WEBSOCKET_DEFLATE_INCLUDE
@@ -1,5 +1,6 @@
 ﻿#include<hgl/network/AcceptServer.h>
 #include<hgl/log/LogInfo.h>
+#include<hgl/network/NetLog.h>
 #include<hgl/Time.h>
 
 namespace hgl
@@ -49,7 +50,7 @@ namespace hgl
                  )
                     return(0);
 
-                LOG_HINT(OS_TEXT("AcceptServer Accept error,errno=")+OSString::numberOf(err));
+                NET_LOG_HINT("AcceptServer Accept error,errno={}",err);
 
                 if(err==nseTooManyLink)    //太多的人accept
                 {
@@ -60,14 +61,49 @@ namespace hgl
                 return(-1);
             }
 
-            const int IP_STR_MAX_SIZE=server_address->GetIPStringMaxSize();
+            return(new_sock);
+        }
+
+        /**
+        * 以非阻塞方式接入一个socket连接，用于监听socket已加入SocketManage，就绪后循环调用直到返回0<br>
+        * Linux下使用accept4一次完成非阻塞与close-on-exec的设置
+        * @return >0 接入的socket(已是非阻塞模式)
+        * @return =0 暂时没有更多的连接
+        * @return <0 出错
+        */
+        int AcceptServer::AcceptNonBlock(IPAddress *addr)
+        {
+            if(!addr)
+                return(-1);
+
+            socklen_t sockaddr_size=server_address->GetSockAddrInSize();
 
-            if(!ipstr)
-                ipstr=new char[IP_STR_MAX_SIZE+1];
+#if HGL_OS == HGL_OS_Linux
+            const int new_sock=accept4(ThisSocket,addr->GetSockAddr(),&sockaddr_size,SOCK_NONBLOCK|SOCK_CLOEXEC);
+#else
+            const int new_sock=accept(ThisSocket,addr->GetSockAddr(),&sockaddr_size);
+#endif//HGL_OS == HGL_OS_Linux
 
-            addr->ToString(ipstr,IP_STR_MAX_SIZE);
+            if(new_sock<0)
+            {
+                const int err=GetLastSocketError();
+
+                if(err==nseWouldBlock
+                 ||err==nseInt
+                 ||err==nseNoError)
+                    return(0);
+
+                NET_LOG_HINT("AcceptServer AcceptNonBlock error,errno={}",err);
+
+                if(err==nseTooManyLink)                 //太多的人accept，本轮不再接入
+                    return(0);
+
+                return(-1);
+            }
 
-            LOG_INFO(U8_TEXT("AcceptServer Accept IP:")+U8String((u8char *)ipstr)+U8_TEXT(" ,sock:")+U8String::numberOf(new_sock));
+#if HGL_OS != HGL_OS_Linux
+            SetSocketBlock(new_sock,false);
+#endif//HGL_OS != HGL_OS_Linux
 
             return(new_sock);
         }
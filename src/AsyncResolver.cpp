@@ -0,0 +1,316 @@
+﻿#include<hgl/network/AsyncResolver.h>
+#include<hgl/network/DNSCache.h>
+#include<hgl/thread/Thread.h>
+#include<hgl/log/LogInfo.h>
+
+#if HGL_OS == HGL_OS_Linux
+#include<sys/eventfd.h>
+#elif HGL_OS != HGL_OS_Windows
+#include<fcntl.h>
+#endif//HGL_OS == HGL_OS_Linux
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            constexpr double RESOLVER_THREAD_WAIT_TIME=0.5;                 //解析线程等待请求的最长时间(用于检查退出)
+
+            template<typename InAddr> int ResolveFamily(List<InAddr> &addr_list,const DNSRequest *req)
+            {
+                if(req->use_cache)
+                    return GetDNSCache()->Resolve(addr_list,req->name.c_str(),req->socktype,req->protocol);
+
+                return GetAddrList(addr_list,req->name.c_str(),req->socktype,req->protocol);
+            }
+
+            void ResolveRequest(DNSRequest *req)
+            {
+                int count=0;
+
+                if(req->family!=AF_INET6)
+                {
+                    const int r=ResolveFamily(req->ipv4,req);
+
+                    if(r>0)count+=r;
+                }
+
+                if(req->family!=AF_INET)
+                {
+                    const int r=ResolveFamily(req->ipv6,req);
+
+                    if(r>0)count+=r;
+                }
+
+                req->result=(count>0?count:-1);
+            }
+
+        #if HGL_OS != HGL_OS_Windows && HGL_OS != HGL_OS_Linux
+            bool SetNonBlockCloExec(int fd)
+            {
+                const int flags=fcntl(fd,F_GETFL,0);
+
+                if(flags==-1)return(false);
+                if(fcntl(fd,F_SETFL,flags|O_NONBLOCK)==-1)return(false);
+
+                return(fcntl(fd,F_SETFD,FD_CLOEXEC)!=-1);
+            }
+        #endif//HGL_OS != HGL_OS_Windows && HGL_OS != HGL_OS_Linux
+        }//namespace
+
+        /**
+         * 解析线程，从AsyncResolver取出请求，调用阻塞的getaddrinfo
+         */
+        class ResolverThread:public Thread
+        {
+            AsyncResolver *resolver;
+
+        public:
+
+            ResolverThread(AsyncResolver *r){resolver=r;}
+
+            bool Execute() override
+            {
+                if(!resolver->request_sem.Acquire(RESOLVER_THREAD_WAIT_TIME))
+                    return !resolver->exit_flag.load(std::memory_order_acquire);
+
+                if(resolver->exit_flag.load(std::memory_order_acquire))
+                    return(false);
+
+                DNSRequest *req=resolver->PopRequest();
+
+                if(!req)
+                    return(true);
+
+                ResolveRequest(req);
+
+                resolver->PushDone(req);
+                return(true);
+            }
+        };//class ResolverThread
+
+        AsyncResolver::AsyncResolver()
+        {
+            ThisSocket=-1;
+            wake_fd=-1;
+        }
+
+        AsyncResolver::~AsyncResolver()
+        {
+            Close();
+        }
+
+        bool AsyncResolver::Init(const uint thread_count)
+        {
+            if(thread_list.GetCount()>0)return(false);
+            if(thread_count<=0)return(false);
+
+#if HGL_OS == HGL_OS_Linux
+            ThisSocket=eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+
+            if(ThisSocket==-1)
+            {
+                LOG_ERROR(OS_TEXT("AsyncResolver create eventfd failed,errno:")+OSString::numberOf(errno));
+                return(false);
+            }
+
+            wake_fd=ThisSocket;
+#elif HGL_OS != HGL_OS_Windows
+            int fds[2];
+
+            if(pipe(fds)==-1)
+            {
+                LOG_ERROR(OS_TEXT("AsyncResolver create pipe failed,errno:")+OSString::numberOf(errno));
+                return(false);
+            }
+
+            SetNonBlockCloExec(fds[0]);
+            SetNonBlockCloExec(fds[1]);
+
+            ThisSocket=fds[0];
+            wake_fd=fds[1];
+#endif//HGL_OS == HGL_OS_Linux
+
+            exit_flag.store(false,std::memory_order_release);
+
+            for(uint i=0;i<thread_count;i++)
+            {
+                ResolverThread *rt=new ResolverThread(this);
+
+                if(!rt->Start())
+                {
+                    delete rt;
+                    Close();
+                    return(false);
+                }
+
+                thread_list.Add(rt);
+            }
+
+            return(true);
+        }
+
+        void AsyncResolver::Close()
+        {
+            exit_flag.store(true,std::memory_order_release);
+
+            if(thread_list.GetCount()>0)
+            {
+                request_sem.Post(thread_list.GetCount());
+
+                for(ResolverThread *rt:thread_list)
+                {
+                    rt->Close();
+                    delete rt;
+                }
+
+                thread_list.Clear();
+            }
+
+            Update();                                                       //已解析完的正常回调
+
+            List<DNSRequest *> cancel_list;
+
+            request_lock.Lock();
+
+            for(DNSRequest *req:request_list)
+                cancel_list.Add(req);
+
+            request_list.Clear();
+            request_lock.Unlock();
+
+            for(DNSRequest *req:cancel_list)
+            {
+                req->result=-1;
+                req->OnResolved();
+            }
+
+#if HGL_OS != HGL_OS_Windows
+            if(wake_fd!=-1&&wake_fd!=ThisSocket)
+                close(wake_fd);
+#endif//HGL_OS != HGL_OS_Windows
+
+            wake_fd=-1;
+
+            CloseSocket();
+        }
+
+        bool AsyncResolver::Resolve(DNSRequest *req)
+        {
+            if(!req||req->name.IsEmpty())
+                return(false);
+
+            if(thread_list.GetCount()<=0||exit_flag.load(std::memory_order_acquire))
+                return(false);
+
+            req->ipv4.Clear();
+            req->ipv6.Clear();
+            req->result=0;
+
+            request_lock.Lock();
+            request_list.Add(req);
+            request_lock.Unlock();
+
+            request_sem.Post();
+            return(true);
+        }
+
+        DNSRequest *AsyncResolver::PopRequest()
+        {
+            DNSRequest *req=nullptr;
+
+            request_lock.Lock();
+
+            if(request_list.GetCount()>0)
+            {
+                req=request_list.GetData()[0];
+                request_list.DeleteMove(0);                                 //按提交顺序解析
+            }
+
+            request_lock.Unlock();
+            return req;
+        }
+
+        void AsyncResolver::PushDone(DNSRequest *req)
+        {
+            done_lock.Lock();
+
+            const bool need_notify=done_list.IsEmpty();                     //已有未回调的请求时，之前已经通知过
+
+            done_list.Add(req);
+            done_lock.Unlock();
+
+            if(need_notify)
+                Notify();
+        }
+
+        void AsyncResolver::Notify()
+        {
+            if(wake_fd==-1)
+                return;
+
+#if HGL_OS == HGL_OS_Linux
+            const uint64 value=1;
+
+            write(wake_fd,&value,sizeof(uint64));
+#elif HGL_OS != HGL_OS_Windows
+            const char value=1;
+
+            write(wake_fd,&value,1);
+#endif//HGL_OS == HGL_OS_Linux
+        }
+
+        void AsyncResolver::ClearNotify()
+        {
+            if(ThisSocket==-1)
+                return;
+
+#if HGL_OS == HGL_OS_Linux
+            uint64 value;
+
+            read(ThisSocket,&value,sizeof(uint64));
+#elif HGL_OS != HGL_OS_Windows
+            char buf[64];
+
+            while(read(ThisSocket,buf,sizeof(buf))>0);
+#endif//HGL_OS == HGL_OS_Linux
+        }
+
+        int AsyncResolver::Update()
+        {
+            List<DNSRequest *> dispatch_list;                               //不在锁内回调
+
+            done_lock.Lock();
+
+            if(done_list.IsEmpty())
+            {
+                done_lock.Unlock();
+                return(0);
+            }
+
+            for(DNSRequest *req:done_list)
+                dispatch_list.Add(req);
+
+            done_list.Clear();
+            done_lock.Unlock();
+
+            const int count=dispatch_list.GetCount();
+
+            for(DNSRequest *req:dispatch_list)                              //OnResolved中可以再提交或释放请求
+                req->OnResolved();
+
+            return count;
+        }
+
+        /**
+         * 通知句柄可读，先清除通知再取完成列表，之后完成的请求一定会再次通知
+         */
+        int AsyncResolver::ProcRecv(int)
+        {
+            ClearNotify();
+            Update();
+            return(0);
+        }
+    }//namespace network
+}//namespace hgl
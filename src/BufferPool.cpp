@@ -0,0 +1,133 @@
+﻿#include<hgl/network/BufferPool.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            /**
+             * 计算能容纳size字节的级别
+             */
+            uint GetLevel(uint size)
+            {
+                uint level=HGL_BUFFER_POOL_MIN_LEVEL;
+
+                while(level<=HGL_BUFFER_POOL_MAX_LEVEL&&(1U<<level)<size)
+                    ++level;
+
+                return level;
+            }
+        }//namespace
+
+        BufferPool::BufferPool(int64 mcb)
+        {
+            max_cache_bytes=mcb;
+            hgl_zero(stats);
+        }
+
+        BufferPool::~BufferPool()
+        {
+            Clear();
+        }
+
+        /**
+         * 借出一个缓冲区
+         * @param size 需要的字节数
+         * @param capacity 返回缓冲区的实际容量，归还时需要原样传回
+         * @return 缓冲区指针
+         */
+        uchar *BufferPool::Acquire(uint size,uint &capacity)
+        {
+            const uint level=GetLevel(size);
+
+            ++stats.acquire_count;
+
+            uchar *buf;
+
+            if(level>HGL_BUFFER_POOL_MAX_LEVEL)
+            {
+                ++stats.over_size_count;
+
+                capacity=size;
+                buf=new uchar[size];
+            }
+            else
+            {
+                List<uchar *> &fl=free_list[level-HGL_BUFFER_POOL_MIN_LEVEL];
+
+                capacity=1U<<level;
+
+                const int count=fl.GetCount();
+
+                if(count>0)
+                {
+                    ++stats.hit_count;
+
+                    buf=fl.GetData()[count-1];
+                    fl.SetCount(count-1);
+
+                    stats.cache_bytes-=capacity;
+                }
+                else
+                {
+                    ++stats.miss_count;
+
+                    buf=new uchar[capacity];
+                }
+            }
+
+            stats.lend_bytes+=capacity;
+
+            if(stats.lend_bytes>stats.peak_lend_bytes)
+                stats.peak_lend_bytes=stats.lend_bytes;
+
+            return buf;
+        }
+
+        /**
+         * 归还一个缓冲区
+         * @param buf 缓冲区指针
+         * @param capacity Acquire时得到的容量
+         */
+        void BufferPool::Release(uchar *buf,uint capacity)
+        {
+            if(!buf)return;
+
+            ++stats.release_count;
+            stats.lend_bytes-=capacity;
+
+            const uint level=GetLevel(capacity);
+
+            if(level>HGL_BUFFER_POOL_MAX_LEVEL                      //超大的不入池
+             ||(1U<<level)!=capacity                                //不是池里借出的
+             ||stats.cache_bytes+capacity>max_cache_bytes)          //池已满
+            {
+                delete[] buf;
+                return;
+            }
+
+            free_list[level-HGL_BUFFER_POOL_MIN_LEVEL].Add(buf);
+            stats.cache_bytes+=capacity;
+        }
+
+        void BufferPool::Clear()
+        {
+            for(uint i=0;i<HGL_BUFFER_POOL_LEVEL_COUNT;i++)
+            {
+                const int count=free_list[i].GetCount();
+                uchar **p=free_list[i].GetData();
+
+                for(int j=0;j<count;j++)
+                {
+                    delete[] *p;
+                    ++p;
+                }
+
+                free_list[i].Clear();
+            }
+
+            stats.cache_bytes=0;
+        }
+    }//namespace network
+}//namespace hgl
@@ -0,0 +1,203 @@
+﻿#include<hgl/network/CPUAffinity.h>
+#include<hgl/network/Socket.h>
+
+#if HGL_OS == HGL_OS_Windows
+    #include<windows.h>
+#else
+    #include<unistd.h>
+
+    #if HGL_OS == HGL_OS_Linux
+        #include<sched.h>
+        #include<dirent.h>
+        #include<stdio.h>
+        #include<stdlib.h>
+        #include<string.h>
+        #include<sys/syscall.h>
+    #elif defined(HGL_OS_BSD)
+        #include<sys/param.h>
+        #include<sys/cpuset.h>
+    #endif//HGL_OS == HGL_OS_Linux
+#endif//HGL_OS == HGL_OS_Windows
+
+namespace hgl
+{
+    namespace network
+    {
+#if HGL_OS == HGL_OS_Linux
+        namespace
+        {
+            constexpr int LINUX_MPOL_DEFAULT    =0;             //<linux/mempolicy.h>中的值，不依赖libnuma
+            constexpr int LINUX_MPOL_PREFERRED  =1;
+
+            constexpr int LINUX_MAX_NUMA_NODE   =1024;
+        }//namespace
+#endif//HGL_OS == HGL_OS_Linux
+
+        int GetCPUCount()
+        {
+#if HGL_OS == HGL_OS_Windows
+            SYSTEM_INFO si;
+
+            GetSystemInfo(&si);
+
+            return si.dwNumberOfProcessors;
+#else
+            const long count=sysconf(_SC_NPROCESSORS_ONLN);
+
+            return(count>0?int(count):1);
+#endif//HGL_OS == HGL_OS_Windows
+        }
+
+        /**
+         * 取得CPU所在的NUMA节点
+         * @param cpu CPU编号
+         * @return NUMA节点编号
+         * @return <0 未知(非NUMA系统或不支持查询)
+         */
+        int GetCPUNumaNode(const int cpu)
+        {
+            if(cpu<0)return(-1);
+
+#if HGL_OS == HGL_OS_Windows
+            USHORT node;
+            PROCESSOR_NUMBER pn;
+
+            pn.Group=WORD(cpu/64);
+            pn.Number=BYTE(cpu%64);
+            pn.Reserved=0;
+
+            if(!GetNumaProcessorNodeEx(&pn,&node)||node==0xFFFF)
+                return(-1);
+
+            return node;
+#elif HGL_OS == HGL_OS_Linux
+            char path[64];
+
+            snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu%d",cpu);
+
+            DIR *dir=opendir(path);                     //cpuN目录下有一个nodeM的链接
+
+            if(!dir)return(-1);
+
+            int node=-1;
+            dirent *de;
+
+            while((de=readdir(dir))!=nullptr)
+            {
+                if(strncmp(de->d_name,"node",4)==0
+                 &&de->d_name[4]>='0'&&de->d_name[4]<='9')
+                {
+                    node=atoi(de->d_name+4);
+                    break;
+                }
+            }
+
+            closedir(dir);
+            return node;
+#else
+            return(-1);
+#endif//HGL_OS == HGL_OS_Windows
+        }
+
+        /**
+         * 将当前线程绑定到指定CPU<br>
+         * macOS不支持绑定(只有亲缘性提示)，返回false
+         */
+        bool BindThreadToCPU(const int cpu)
+        {
+            if(cpu<0)return(false);
+
+#if HGL_OS == HGL_OS_Windows
+            GROUP_AFFINITY ga;
+
+            hgl_zero(ga);
+            ga.Group=WORD(cpu/64);
+            ga.Mask=KAFFINITY(1)<<(cpu%64);
+
+            return SetThreadGroupAffinity(GetCurrentThread(),&ga,nullptr);
+#elif HGL_OS == HGL_OS_Linux
+            cpu_set_t cs;
+
+            if(cpu>=CPU_SETSIZE)return(false);
+
+            CPU_ZERO(&cs);
+            CPU_SET(cpu,&cs);
+
+            return(sched_setaffinity(0,sizeof(cs),&cs)==0);
+#elif defined(HGL_OS_BSD)
+            cpuset_t cs;
+
+            CPU_ZERO(&cs);
+            CPU_SET(cpu,&cs);
+
+            return(cpuset_setaffinity(CPU_LEVEL_WHICH,CPU_WHICH_TID,-1,sizeof(cs),&cs)==0);
+#else
+            return(false);
+#endif//HGL_OS == HGL_OS_Windows
+        }
+
+        /**
+         * 设置当前线程之后分配内存时优先使用的NUMA节点(Linux下使用set_mempolicy(MPOL_PREFERRED))<br>
+         * 已经分配并使用过的内存不会迁移，所以需要在分配缓冲区之前设置。节点内存不足时仍会从其它节点分配。
+         * @param node NUMA节点，<0表示恢复缺省策略
+         * @return 是否成功(不支持的系统返回false，内存按系统缺省方式分配)
+         */
+        bool SetThreadMemoryNode(const int node)
+        {
+#if HGL_OS == HGL_OS_Linux && defined(SYS_set_mempolicy)
+            if(node<0)
+                return(syscall(SYS_set_mempolicy,LINUX_MPOL_DEFAULT,nullptr,0)==0);
+
+            if(node>=LINUX_MAX_NUMA_NODE)
+                return(false);
+
+            unsigned long mask[LINUX_MAX_NUMA_NODE/(sizeof(unsigned long)*8)];
+
+            hgl_zero(mask);
+            mask[node/(sizeof(unsigned long)*8)]=1UL<<(node%(sizeof(unsigned long)*8));
+
+            return(syscall(SYS_set_mempolicy,LINUX_MPOL_PREFERRED,mask,LINUX_MAX_NUMA_NODE+1)==0);
+#else
+            return(false);                              //Windows需要VirtualAllocExNuma逐块指定，这里不处理，依靠"首次访问"策略
+#endif//HGL_OS == HGL_OS_Linux
+        }
+
+        /**
+         * 取得socket最近一次收包时所在的CPU<br>
+         * 网卡开启RSS时，这就是该连接对应的接收队列中断所在CPU，可用于检查连接是否分给了正确的线程
+         */
+        int GetSocketIncomingCPU(const int sock)
+        {
+#if HGL_OS == HGL_OS_Linux && defined(SO_INCOMING_CPU)
+            int cpu=-1;
+            socklen_t len=sizeof(cpu);
+
+            if(getsockopt(sock,SOL_SOCKET,SO_INCOMING_CPU,&cpu,&len))
+                return(-1);
+
+            return cpu;
+#else
+            return(-1);
+#endif//SO_INCOMING_CPU
+        }
+
+        /**
+         * 取得socket所在接收队列的NAPI ID<br>
+         * 同一个NAPI ID对应网卡的同一个接收队列，可作为按队列分配连接(以及配合XPS设置发送队列)的依据
+         */
+        int GetSocketNapiID(const int sock)
+        {
+#if HGL_OS == HGL_OS_Linux && defined(SO_INCOMING_NAPI_ID)
+            int id=0;
+            socklen_t len=sizeof(id);
+
+            if(getsockopt(sock,SOL_SOCKET,SO_INCOMING_NAPI_ID,&id,&len))
+                return(-1);
+
+            return id;
+#else
+            return(-1);
+#endif//SO_INCOMING_NAPI_ID
+        }
+    }//namespace network
+}//namespace hgl
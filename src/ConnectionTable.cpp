@@ -0,0 +1,179 @@
+﻿#include<hgl/network/ConnectionTable.h>
+#include<hgl/network/TCPAccept.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            constexpr int CONNECTION_TABLE_MIN_SIZE=1024;
+
+            inline uint NextGeneration(const uint gen)
+            {
+                const uint next=(gen+1)&HGL_CONNECTION_GENERATION_MASK;
+
+                return(next?next:1);                                        //0留给无效句柄
+            }
+        }//namespace
+
+        ConnectionTable::Slot *ConnectionTable::GetSlot(const int sock)
+        {
+            if(sock<0||sock>=int(slot_list.GetCount()))
+                return(nullptr);
+
+            return slot_list.GetData()+sock;
+        }
+
+        const ConnectionTable::Slot *ConnectionTable::GetSlot(const int sock)const
+        {
+            if(sock<0||sock>=int(slot_list.GetCount()))
+                return(nullptr);
+
+            return slot_list.data()+sock;
+        }
+
+        /**
+         * 加入一个连接，需要时扩大槽位表(socket值由系统分配，通常是从小到大连续的)
+         * @return 连接句柄
+         */
+        ConnectionHandle ConnectionTable::Add(TCPAccept *s)
+        {
+            if(!s)return(HGL_INVALID_CONNECTION_HANDLE);
+
+            const int sock=s->ThisSocket;
+
+            if(sock<0)return(HGL_INVALID_CONNECTION_HANDLE);
+
+            const int old_count=int(slot_list.GetCount());
+
+            if(sock>=old_count)
+            {
+                int new_count=(old_count>0?old_count*2:CONNECTION_TABLE_MIN_SIZE);
+
+                while(new_count<=sock)
+                    new_count*=2;
+
+                slot_list.SetCount(new_count);
+
+                Slot *sp=slot_list.GetData()+old_count;
+
+                for(int i=old_count;i<new_count;i++)
+                {
+                    sp->accept=nullptr;
+                    sp->generation=1;
+                    sp->index=-1;
+                    sp->error=false;
+                    ++sp;
+                }
+            }
+
+            Slot *slot=slot_list.GetData()+sock;
+
+            if(slot->accept)
+                return(HGL_INVALID_CONNECTION_HANDLE);
+
+            slot->accept=s;
+            slot->index=active_list.GetCount();
+            slot->error=false;
+
+            active_list.Add(s);
+
+            return MakeConnectionHandle(owner_id,slot->generation,sock);
+        }
+
+        bool ConnectionTable::Remove(TCPAccept *s)
+        {
+            if(!s)return(false);
+
+            Slot *slot=GetSlot(s->ThisSocket);
+
+            if(!slot||slot->accept!=s)
+                return(false);
+
+            const int last=active_list.GetCount()-1;
+
+            if(slot->index!=last)                                           //用最后一个填补空位
+            {
+                TCPAccept *moved=active_list.GetData()[last];
+
+                active_list.GetData()[slot->index]=moved;
+                slot_list.GetData()[moved->ThisSocket].index=slot->index;
+            }
+
+            active_list.SetCount(last);
+
+            slot->accept=nullptr;
+            slot->generation=NextGeneration(slot->generation);              //旧句柄从此失效
+            slot->index=-1;
+            slot->error=false;
+
+            return(true);
+        }
+
+        TCPAccept *ConnectionTable::Get(const int sock)const
+        {
+            const Slot *slot=GetSlot(sock);
+
+            return(slot?slot->accept:nullptr);
+        }
+
+        TCPAccept *ConnectionTable::Get(const ConnectionHandle h)const
+        {
+            if(h==HGL_INVALID_CONNECTION_HANDLE)return(nullptr);
+            if(GetConnectionOwner(h)!=owner_id)return(nullptr);
+
+            const Slot *slot=GetSlot(GetConnectionSlot(h));
+
+            if(!slot||slot->generation!=GetConnectionGeneration(h))
+                return(nullptr);
+
+            return slot->accept;
+        }
+
+        /**
+         * 将连接加入错误列表，同一个连接在一次Update中只会加入一次
+         * @return 是否是新加入的
+         */
+        bool ConnectionTable::MarkError(TCPAccept *s)
+        {
+            if(!s)return(false);
+
+            Slot *slot=GetSlot(s->ThisSocket);
+
+            if(!slot||slot->accept!=s)
+            {
+                //不在表中(已被分离)的不需要再由管理器处理
+                return(false);
+            }
+
+            if(slot->error)
+                return(false);
+
+            slot->error=true;
+            error_list.Add(s);
+            return(true);
+        }
+
+        void ConnectionTable::Clear()
+        {
+            const int count=active_list.GetCount();
+            TCPAccept **sp=active_list.GetData();
+
+            for(int i=0;i<count;i++)
+            {
+                Slot *slot=slot_list.GetData()+(*sp)->ThisSocket;
+
+                slot->accept=nullptr;
+                slot->generation=NextGeneration(slot->generation);
+                slot->index=-1;
+                slot->error=false;
+
+                ++sp;
+            }
+
+            active_list.Clear();
+            error_list.Clear();
+        }
+    }//namespace network
+}//namespace hgl
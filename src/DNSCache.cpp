@@ -0,0 +1,366 @@
+﻿#include<hgl/network/DNSCache.h>
+#include<hgl/thread/Thread.h>
+#include<hgl/Time.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            List<in_addr>  &EntryList(List<in_addr> &v4,List<in6_addr> &,const in_addr *){return v4;}
+            List<in6_addr> &EntryList(List<in_addr> &,List<in6_addr> &v6,const in6_addr *){return v6;}
+
+            bool IsNumericAddr(int family,const char *name)
+            {
+                in6_addr addr;                                              //足够放下in_addr
+
+                return(inet_pton(family,name,&addr)==1);
+            }
+
+            struct RefreshItem
+            {
+                AnsiString name;
+                int family;
+                int socktype;
+                int protocol;
+            };
+        }//namespace
+
+        /**
+         * 后台刷新线程，定时让DNSCache重新解析快要到期的记录
+         */
+        class DNSRefreshThread:public Thread
+        {
+            DNSCache *cache;
+
+        public:
+
+            DNSRefreshThread(DNSCache *c){cache=c;}
+
+            bool Execute() override
+            {
+                cache->Refresh();
+
+                WaitTime(cache->GetConfig().refresh_interval);
+                return(true);
+            }
+        };//class DNSRefreshThread
+
+        DNSCache::~DNSCache()
+        {
+            StopRefresh();
+            Clear();
+        }
+
+        void DNSCache::SetConfig(const DNSCacheConfig &cfg)
+        {
+            lock.Lock();
+            config=cfg;
+            lock.Unlock();
+        }
+
+        /**
+         * 查找记录(需已加锁)
+         */
+        DNSCache::Entry *DNSCache::Find(int family,const char *name,int socktype,int protocol)
+        {
+            for(Entry *e:entry_list)
+                if(e->family==family
+                 &&e->socktype==socktype
+                 &&e->protocol==protocol
+                 &&strcmp(e->name.c_str(),name)==0)
+                    return e;
+
+            return(nullptr);
+        }
+
+        /**
+         * 创建记录(需已加锁)，缓存已满时复用最久没用过的记录
+         */
+        DNSCache::Entry *DNSCache::Create(int family,const char *name,int socktype,int protocol,const double now)
+        {
+            Entry *e=nullptr;
+
+            if(entry_list.GetCount()>=int(config.max_entries)&&entry_list.GetCount()>0)
+            {
+                for(Entry *old:entry_list)
+                    if(!old->refreshing
+                     &&(!e||old->last_use_time<e->last_use_time))
+                        e=old;
+            }
+
+            if(!e)
+            {
+                e=new Entry;
+                entry_list.Add(e);
+            }
+
+            e->name=name;
+            e->family=family;
+            e->socktype=socktype;
+            e->protocol=protocol;
+            e->ipv4.Clear();
+            e->ipv6.Clear();
+            e->negative=true;
+            e->expire_time=0;
+            e->last_use_time=now;
+            e->refreshing=false;
+
+            return e;
+        }
+
+        template<int FAMILY,typename InAddr> int DNSCache::Lookup(List<InAddr> &addr_list,const char *name,int socktype,int protocol)
+        {
+            if(!name)
+                return(-1);
+
+            if(!enable||IsNumericAddr(FAMILY,name))
+                return GetAddrList(addr_list,name,socktype,protocol);
+
+            const double now=GetDoubleTime();
+
+            lock.Lock();
+
+            Entry *e=Find(FAMILY,name,socktype,protocol);
+
+            if(e&&now<e->expire_time)
+            {
+                e->last_use_time=now;
+
+                int count=-1;
+
+                if(!e->negative)
+                {
+                    const List<InAddr> &cache_list=EntryList(e->ipv4,e->ipv6,(InAddr *)nullptr);
+
+                    count=cache_list.GetCount();
+
+                    for(const InAddr &ia:cache_list)
+                        addr_list.Add(ia);
+                }
+
+                lock.Unlock();
+                hit_count.fetch_add(1,std::memory_order_relaxed);
+                return(count);
+            }
+
+            lock.Unlock();
+            miss_count.fetch_add(1,std::memory_order_relaxed);
+
+            List<InAddr> result;
+
+            const int count=GetAddrList(result,name,socktype,protocol);    //解析时不持有锁
+
+            lock.Lock();
+
+            e=Find(FAMILY,name,socktype,protocol);
+
+            if(!e)
+                e=Create(FAMILY,name,socktype,protocol,now);
+
+            List<InAddr> &cache_list=EntryList(e->ipv4,e->ipv6,(InAddr *)nullptr);
+
+            cache_list.Clear();
+
+            for(const InAddr &ia:result)
+                cache_list.Add(ia);
+
+            e->negative=(count<=0);
+            e->expire_time=GetDoubleTime()+(e->negative?config.negative_ttl:config.ttl);
+            e->last_use_time=now;
+
+            lock.Unlock();
+
+            if(count<=0)
+                return(-1);
+
+            for(const InAddr &ia:result)
+                addr_list.Add(ia);
+
+            return(count);
+        }
+
+        int DNSCache::Resolve(List<in_addr> &addr_list,const char *name,int socktype,int protocol)
+        {
+            return Lookup<AF_INET,in_addr>(addr_list,name,socktype,protocol);
+        }
+
+        int DNSCache::Resolve(List<in6_addr> &addr_list,const char *name,int socktype,int protocol)
+        {
+            return Lookup<AF_INET6,in6_addr>(addr_list,name,socktype,protocol);
+        }
+
+        void DNSCache::Remove(const char *name)
+        {
+            if(!name)return;
+
+            lock.Lock();
+
+            for(int i=0;i<entry_list.GetCount();)
+            {
+                Entry *e=entry_list.GetData()[i];
+
+                if(strcmp(e->name.c_str(),name))
+                {
+                    ++i;
+                    continue;
+                }
+
+                if(e->refreshing)                                           //刷新线程解析完后还会访问，只让它过期
+                {
+                    e->expire_time=0;
+                    ++i;
+                    continue;
+                }
+
+                delete e;
+                entry_list.Delete(i);                                       //与最后一项交换，当前位置需要再检查一次
+            }
+
+            lock.Unlock();
+        }
+
+        void DNSCache::Clear()
+        {
+            lock.Lock();
+
+            for(int i=0;i<entry_list.GetCount();)
+            {
+                Entry *e=entry_list.GetData()[i];
+
+                if(e->refreshing)                                           //刷新线程解析完后还会访问
+                {
+                    e->expire_time=0;
+                    ++i;
+                    continue;
+                }
+
+                delete e;
+                entry_list.Delete(i);
+            }
+
+            lock.Unlock();
+        }
+
+        /**
+         * 重新解析快要到期且最近用过的记录，淘汰过期且长时间没用过的记录
+         */
+        void DNSCache::Refresh()
+        {
+            List<RefreshItem> item_list;
+
+            const double now=GetDoubleTime();
+
+            lock.Lock();
+
+            const double ahead=config.refresh_ahead;
+            const double idle=config.refresh_idle;
+
+            for(int i=0;i<entry_list.GetCount();)
+            {
+                Entry *e=entry_list.GetData()[i];
+
+                if(e->refreshing)
+                {
+                    ++i;
+                    continue;
+                }
+
+                if(now-e->last_use_time>=idle)
+                {
+                    if(now>=e->expire_time)
+                    {
+                        delete e;
+                        entry_list.Delete(i);
+                        continue;
+                    }
+                }
+                else
+                if(now>=e->expire_time-ahead)
+                {
+                    RefreshItem ri;
+
+                    ri.name=e->name;
+                    ri.family=e->family;
+                    ri.socktype=e->socktype;
+                    ri.protocol=e->protocol;
+
+                    item_list.Add(ri);
+                    e->refreshing=true;
+                }
+
+                ++i;
+            }
+
+            lock.Unlock();
+
+            for(const RefreshItem &ri:item_list)
+            {
+                List<in_addr> v4;
+                List<in6_addr> v6;
+
+                const int count=(ri.family==AF_INET?GetAddrList(v4,ri.name.c_str(),ri.socktype,ri.protocol)
+                                                   :GetAddrList(v6,ri.name.c_str(),ri.socktype,ri.protocol));
+
+                lock.Lock();
+
+                Entry *e=Find(ri.family,ri.name.c_str(),ri.socktype,ri.protocol);
+
+                if(e)
+                {
+                    e->refreshing=false;
+
+                    if(count>0&&e->expire_time>0)                           //刷新失败时保留旧结果，到期后由使用者重新解析；刷新期间被删除的不再恢复
+                    {
+                        e->ipv4.Clear();
+                        e->ipv6.Clear();
+
+                        for(const in_addr &ia:v4)e->ipv4.Add(ia);
+                        for(const in6_addr &ia:v6)e->ipv6.Add(ia);
+
+                        e->negative=false;
+                        e->expire_time=GetDoubleTime()+config.ttl;
+                    }
+                }
+
+                lock.Unlock();
+            }
+        }
+
+        bool DNSCache::StartRefresh()
+        {
+            if(refresh_thread)
+                return(true);
+
+            refresh_thread=new DNSRefreshThread(this);
+
+            if(!refresh_thread->Start())
+            {
+                delete refresh_thread;
+                refresh_thread=nullptr;
+                return(false);
+            }
+
+            return(true);
+        }
+
+        void DNSCache::StopRefresh()
+        {
+            if(!refresh_thread)
+                return;
+
+            refresh_thread->Close();
+
+            delete refresh_thread;
+            refresh_thread=nullptr;
+        }
+
+        DNSCache *GetDNSCache()
+        {
+            static DNSCache dns_cache;
+
+            return &dns_cache;
+        }
+    }//namespace network
+}//namespace hgl
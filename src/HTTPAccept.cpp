@@ -0,0 +1,201 @@
+﻿#include<hgl/network/HTTPAccept.h>
+#include<hgl/network/SocketInputStream.h>
+#include<hgl/network/SocketOutputStream.h>
+#include<hgl/log/LogInfo.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        bool HTTPAccept::UseSocket(int sock,const IPAddress *addr)
+        {
+            if(!TCPAcceptPacketBase::UseSocket(sock,addr))
+                RETURN_FALSE;
+
+            head_scan_pos=0;
+            request_need=0;
+            continue_sent=false;
+            request_count=0;
+            response_count=0;
+            last_request=false;
+            pipeline_pause=false;
+
+            return(true);
+        }
+
+        /**
+         * 未回应的请求在新进程中无法再回应，这样的连接留在本进程处理完；
+         * 不完整的请求只保存接收缓冲区中的数据，转交后从头重新解析
+         */
+        bool HTTPAccept::SaveHandoffState(DataArray<uchar> &out)
+        {
+            if(last_request||request_count>response_count)
+                return(false);
+
+            return TCPAcceptPacketBase::SaveHandoffState(out);
+        }
+
+        /**
+         * 请求有错，不再处理之后的数据<br>
+         * 前面的请求都已回应时回应错误状态，否则不再回应，等前面的回应发完后关闭
+         */
+        void HTTPAccept::ProcRequestError(const uint status)
+        {
+            LOG_PROBLEM(OS_TEXT("HTTPAccept,bad request,status:")+OSString::numberOf(status)+OS_TEXT(",sock:")+OSString::numberOf(ThisSocket));
+
+            last_request=true;
+            request_need=0;
+
+            if(request_count==response_count)
+            {
+                ++request_count;
+                SendResponse(status,nullptr,0);                 //last_request已设置，发完后关闭
+            }
+            else
+            {
+                CloseAfterSend();
+            }
+        }
+
+        /**
+         * 在接收缓冲区上原地解析出所有完整的请求
+         */
+        int HTTPAccept::ParsePacket(uchar *data,uint size)
+        {
+            const char *p=(const char *)data;
+            uint left=size;
+
+            request_need=0;
+
+            while(left>0)
+            {
+                if(last_request)                                                //最后一个请求之后的数据不再处理
+                    return int(size);
+
+                if(request_count-response_count>=HGL_HTTP_MAX_PIPELINE_REQUESTS)   //等回应赶上来再继续
+                {
+                    pipeline_pause=PauseRecv();
+                    break;
+                }
+
+                const uint head_size=FindHTTPHeadEnd(p,hgl_min(left,HGL_HTTP_REQUEST_HEAD_MAX_SIZE),head_scan_pos);
+
+                if(head_size==0)
+                {
+                    if(left>=HGL_HTTP_REQUEST_HEAD_MAX_SIZE)
+                    {
+                        ProcRequestError(431);
+                        return int(size);
+                    }
+
+                    break;
+                }
+
+                const int hr=ParseHTTPRequestHead(request,p,head_size);
+
+                if(hr<0)
+                {
+                    ProcRequestError(uint(-hr));
+                    return int(size);
+                }
+
+                if(request.content_length>max_body_size)
+                {
+                    ProcRequestError(413);
+                    return int(size);
+                }
+
+                const uint total=head_size+uint(request.content_length);
+
+                if(left<total)                                                  //请求体还没收完
+                {
+                    request_need=total;
+
+                    if(request.expect_continue&&!continue_sent
+                     &&request_count==response_count)                           //前面的回应都已发出才能插入100 Continue
+                    {
+                        constexpr char CONTINUE_STR[]="HTTP/1.1 100 Continue\r\n\r\n";
+
+                        continue_sent=Send(CONTINUE_STR,sizeof(CONTINUE_STR)-1);
+                    }
+
+                    head_scan_pos=head_size-1;                                  //下次从最后一个换行符开始，不用重新查找整个头
+                    break;
+                }
+
+                request.body=(request.content_length>0?p+head_size:nullptr);
+
+                ++request_count;
+                continue_sent=false;
+
+                if(!request.keep_alive)
+                    last_request=true;
+
+                TraceDispatch();
+
+                if(!OnRequest(request))
+                    return(-1);
+
+                p   +=total;
+                left-=total;
+
+                if(recv_pause)                                                  //回调中暂停了接收，剩下的请求留到恢复后
+                    break;
+            }
+
+            return int(p-(const char *)data);
+        }
+
+        /**
+         * 发出最早一个未回应请求的回应头与(可选的)回应体，合并为一次writev
+         */
+        bool HTTPAccept::SendResponseData(const uint status,const uint64 content_length,const char *content_type,const char *extra_headers,const void *body,const uint size)
+        {
+            if(response_count>=request_count)                                   //没有等待回应的请求
+                RETURN_FALSE;
+
+            char head[HGL_HTTP_RESPONSE_HEAD_MAX_SIZE];
+
+            const bool keep_alive=!(last_request&&response_count+1==request_count);
+            const uint head_size=MakeHTTPResponseHead(head,sizeof(head),status,content_length,content_type,keep_alive,extra_headers);
+
+            if(head_size==0)
+                RETURN_FALSE;
+
+            const SocketIOVec vec[2]=
+            {
+                {head,head_size},
+                {body,size}
+            };
+
+            if(!Send(vec,size>0?2:1))
+                return(false);
+
+            ++response_count;
+
+            if(!keep_alive)
+                CloseAfterSend();
+            else
+            if(pipeline_pause&&request_count-response_count<HGL_HTTP_MAX_PIPELINE_REQUESTS)
+            {
+                pipeline_pause=false;
+                ResumeRecv();                                                   //留在接收缓冲区中的请求在本次Update中继续处理
+            }
+
+            return(true);
+        }
+
+        bool HTTPAccept::SendResponseHead(const uint status,const uint64 content_length,const char *content_type,const char *extra_headers)
+        {
+            return SendResponseData(status,content_length,content_type,extra_headers,nullptr,0);
+        }
+
+        bool HTTPAccept::SendResponse(const uint status,const void *body,const uint size,const char *content_type,const char *extra_headers)
+        {
+            if(size>0&&!body)
+                RETURN_FALSE;
+
+            return SendResponseData(status,size,content_type,extra_headers,body,size);
+        }
+    }//namespace network
+}//namespace hgl
@@ -0,0 +1,354 @@
+﻿#include<hgl/network/HTTPAsyncClient.h>
+#include<hgl/log/LogInfo.h>
+#include<curl/curl.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace http
+        {
+            namespace
+            {
+                size_t async_write_to_request(void *ptr,size_t size,size_t number,void *user_data)
+                {
+                    AsyncRequest *req=(AsyncRequest *)user_data;
+
+                    const size_t ss=size*number;
+
+                    if(req->os)
+                        return(req->os->WriteFully(ptr,ss)==int64(ss)?ss:0);           //返回值不等于ss时curl中止传输
+
+                    const size_t old_size=req->response.GetCount();
+
+                    req->response.SetCount(old_size+ss);
+                    memcpy(req->response.data()+old_size,ptr,ss);
+
+                    return ss;
+                }
+
+                void share_lock_func(CURL *,curl_lock_data data,curl_lock_access,void *user_data)
+                {
+                    ((ThreadMutex *)user_data)[data].Lock();
+                }
+
+                void share_unlock_func(CURL *,curl_lock_data data,void *user_data)
+                {
+                    ((ThreadMutex *)user_data)[data].Unlock();
+                }
+            }//namespace
+
+            AsyncClient::AsyncClient(const AsyncClientConfig &cfg,void *sh):submit_queue(cfg.queue_size)
+            {
+                config=cfg;
+                share=sh;
+
+                if(config.max_concurrent<1)config.max_concurrent=1;
+
+                multi=curl_multi_init();
+
+                if(!multi)
+                {
+                    LOG_ERROR(OS_TEXT("AsyncClient curl_multi_init failed."));
+                    return;
+                }
+
+                if(config.max_host_connections)
+                    curl_multi_setopt(multi,CURLMOPT_MAX_HOST_CONNECTIONS,long(config.max_host_connections));
+
+                if(config.max_total_connections)
+                    curl_multi_setopt(multi,CURLMOPT_MAX_TOTAL_CONNECTIONS,long(config.max_total_connections));
+
+                curl_multi_setopt(multi,CURLMOPT_PIPELINING,long(config.multiplex?CURLPIPE_MULTIPLEX:CURLPIPE_NOTHING));
+            }
+
+            AsyncClient::~AsyncClient()
+            {
+                Cancel();
+
+                for(void *easy:easy_pool)
+                    curl_easy_cleanup(easy);
+
+                if(multi)
+                    curl_multi_cleanup(multi);
+            }
+
+            void *AsyncClient::AcquireEasy()
+            {
+                const int count=easy_pool.GetCount();
+
+                if(count<=0)
+                    return curl_easy_init();
+
+                void *easy=easy_pool.GetData()[count-1];
+                easy_pool.SetCount(count-1);
+
+                return easy;
+            }
+
+            /**
+             * 用完的easy句柄清除设置后放回池中(连接与DNS缓存在CURLM中，不受影响)
+             */
+            void AsyncClient::ReleaseEasy(void *easy)
+            {
+                if(easy_pool.GetCount()>=int(config.easy_cache))
+                {
+                    curl_easy_cleanup(easy);
+                    return;
+                }
+
+                curl_easy_reset(easy);
+                easy_pool.Add(easy);
+            }
+
+            bool AsyncClient::StartRequest(AsyncRequest *req)
+            {
+                void *easy=AcquireEasy();
+
+                if(!easy)
+                {
+                    FinishRequest(req,CURLE_FAILED_INIT);
+                    return(false);
+                }
+
+                curl_easy_setopt(easy,CURLOPT_URL,req->url.c_str());
+
+                if(!req->user_agent.IsEmpty())
+                curl_easy_setopt(easy,CURLOPT_USERAGENT,req->user_agent.c_str());
+
+                curl_easy_setopt(easy,CURLOPT_FOLLOWLOCATION,1L);              //重定向支持
+                curl_easy_setopt(easy,CURLOPT_TIMEOUT,req->time_out);
+                curl_easy_setopt(easy,CURLOPT_NOSIGNAL,1L);                    //多线程中不能用信号实现超时
+                curl_easy_setopt(easy,CURLOPT_TCP_KEEPALIVE,1L);
+                curl_easy_setopt(easy,CURLOPT_PRIVATE,req);
+                curl_easy_setopt(easy,CURLOPT_WRITEDATA,req);
+                curl_easy_setopt(easy,CURLOPT_WRITEFUNCTION,async_write_to_request);
+
+                if(config.multiplex)
+                curl_easy_setopt(easy,CURLOPT_PIPEWAIT,1L);                    //优先等待可复用的HTTP/2连接，而不是新建连接
+
+                if(share)
+                curl_easy_setopt(easy,CURLOPT_SHARE,share);
+
+                if(req->post_data)
+                {
+                    curl_easy_setopt(easy,CURLOPT_POSTFIELDS,req->post_data);
+                    curl_easy_setopt(easy,CURLOPT_POSTFIELDSIZE,long(req->post_data_size));
+                }
+
+                if(curl_multi_add_handle(multi,easy)!=CURLM_OK)
+                {
+                    ReleaseEasy(easy);
+                    FinishRequest(req,CURLE_FAILED_INIT);
+                    return(false);
+                }
+
+                active_list.Add(easy);
+                return(true);
+            }
+
+            void AsyncClient::FinishRequest(AsyncRequest *req,int result)
+            {
+                req->error=result;
+
+                if(result!=CURLE_OK)
+                    req->error_info=curl_easy_strerror(CURLcode(result));
+
+                req->OnFinish();
+
+                req->finished.store(true,std::memory_order_release);
+                req->done_sem.Post();                                           //此后不再访问req
+            }
+
+            /**
+             * 取出其它线程提交的请求，在并发数允许的范围内按提交顺序开始
+             */
+            void AsyncClient::ProcSubmit()
+            {
+                AsyncRequest *req;
+
+                while(submit_queue.Pop(req))
+                    wait_list.Add(req);
+
+                int start_count=0;
+
+                while(start_count<wait_list.GetCount()
+                    &&active_list.GetCount()<int(config.max_concurrent))
+                {
+                    StartRequest(wait_list.GetData()[start_count]);
+                    ++start_count;
+                }
+
+                if(start_count>0)
+                    wait_list.DeleteMove(0,start_count);
+            }
+
+            void AsyncClient::ProcDone()
+            {
+                CURLMsg *msg;
+                int left;
+
+                while((msg=curl_multi_info_read(multi,&left)))
+                {
+                    if(msg->msg!=CURLMSG_DONE)
+                        continue;
+
+                    void *easy=msg->easy_handle;
+                    const CURLcode result=msg->data.result;                     //remove_handle后msg不再有效
+                    AsyncRequest *req=nullptr;
+
+                    curl_easy_getinfo(easy,CURLINFO_PRIVATE,&req);
+                    curl_easy_getinfo(easy,CURLINFO_RESPONSE_CODE,&req->response_code);
+
+                    curl_multi_remove_handle(multi,easy);
+
+                    active_list.Delete(active_list.Find(easy));
+                    ReleaseEasy(easy);
+
+                    FinishRequest(req,result);
+                }
+            }
+
+            bool AsyncClient::Submit(AsyncRequest *req)
+            {
+                if(!multi||!req)
+                    return(false);
+
+                if(!submit_queue.Push(req))
+                    return(false);
+
+                curl_multi_wakeup(multi);                                       //打断Update中的等待
+                return(true);
+            }
+
+            int AsyncClient::Update(int wait_ms)
+            {
+                if(!multi)
+                    return(0);
+
+                int still_running;
+
+                ProcSubmit();
+
+                curl_multi_perform(multi,&still_running);
+
+                ProcDone();
+                ProcSubmit();                                                   //完成的传输腾出了位置
+
+                if(wait_ms>0)
+                    curl_multi_poll(multi,nullptr,0,wait_ms,nullptr);
+
+                return active_list.GetCount()+wait_list.GetCount();
+            }
+
+            void AsyncClient::Cancel()
+            {
+                for(void *easy:active_list)
+                {
+                    AsyncRequest *req=nullptr;
+
+                    curl_easy_getinfo(easy,CURLINFO_PRIVATE,&req);
+                    curl_multi_remove_handle(multi,easy);
+                    ReleaseEasy(easy);
+
+                    FinishRequest(req,CURLE_ABORTED_BY_CALLBACK);
+                }
+
+                active_list.Clear();
+
+                AsyncRequest *req;
+
+                while(submit_queue.Pop(req))
+                    wait_list.Add(req);
+
+                for(AsyncRequest *wr:wait_list)
+                    FinishRequest(wr,CURLE_ABORTED_BY_CALLBACK);
+
+                wait_list.Clear();
+            }
+
+            AsyncClientGroup::AsyncClientGroup()
+            {
+                share=nullptr;
+                share_lock=nullptr;
+            }
+
+            AsyncClientGroup::~AsyncClientGroup()
+            {
+                Close();
+            }
+
+            bool AsyncClientGroup::Init(const uint thread_count,const AsyncClientConfig &cfg)
+            {
+                if(thread_count<=0)return(false);
+                if(share)return(false);
+
+                share=curl_share_init();
+
+                if(!share)
+                {
+                    LOG_ERROR(OS_TEXT("AsyncClientGroup curl_share_init failed."));
+                    return(false);
+                }
+
+                share_lock=new ThreadMutex[CURL_LOCK_DATA_LAST];
+
+                curl_share_setopt(share,CURLSHOPT_LOCKFUNC,share_lock_func);
+                curl_share_setopt(share,CURLSHOPT_UNLOCKFUNC,share_unlock_func);
+                curl_share_setopt(share,CURLSHOPT_USERDATA,share_lock);
+                curl_share_setopt(share,CURLSHOPT_SHARE,CURL_LOCK_DATA_DNS);
+                curl_share_setopt(share,CURLSHOPT_SHARE,CURL_LOCK_DATA_SSL_SESSION);
+
+                for(uint i=0;i<thread_count;i++)
+                {
+                    AsyncClient *client=new AsyncClient(cfg,share);
+
+                    if(!client->IsValid())
+                    {
+                        delete client;
+                        Close();
+                        return(false);
+                    }
+
+                    client_manage.Add(client);
+                    client_list.Add(client);
+                }
+
+                if(!client_manage.Start())
+                {
+                    Close();
+                    return(false);
+                }
+
+                return(true);
+            }
+
+            void AsyncClientGroup::Close()
+            {
+                client_manage.Close();                                          //线程结束时中止各自剩余的请求
+                client_list.Clear();
+
+                if(share)
+                {
+                    curl_share_cleanup(share);
+                    share=nullptr;
+                }
+
+                delete[] share_lock;
+                share_lock=nullptr;
+            }
+
+            bool AsyncClientGroup::Submit(AsyncRequest *req)
+            {
+                const int count=client_list.GetCount();
+
+                if(count<=0)
+                    return(false);
+
+                const uint index=next_client.fetch_add(1,std::memory_order_relaxed)%count;
+
+                return client_list.GetData()[index]->Submit(req);
+            }
+        }//namespace http
+    }//namespace network
+}//namespace hgl
@@ -0,0 +1,143 @@
+﻿#include<hgl/network/HTTPConnectionPool.h>
+#include<hgl/network/TCPClient.h>
+#include<hgl/Time.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            /**
+             * 检查空闲连接是否还能使用<br>
+             * 服务器关闭了连接时可读且读到0字节；空闲连接上也不应该有任何数据
+             */
+            bool IsIdleAlive(int sock)
+            {
+                char c;
+
+                const int result=recv(sock,&c,1,MSG_PEEK);
+
+                if(result>=0)                                               //0为对方关闭，>0为多余的数据
+                    return(false);
+
+                return(GetLastSocketError()==nseWouldBlock);
+            }
+        }//namespace
+
+        void HTTPConnectionPool::Remove(int index)
+        {
+            delete idle_list.GetData()[index].tcp;
+
+            idle_list.DeleteMove(index);                                    //保持按时间排列
+        }
+
+        int HTTPConnectionPool::GetHostIdleCount(const IPAddress *addr)const
+        {
+            int count=0;
+
+            for(const IdleConnection &ic:idle_list)
+                if(ic.tcp->GetAddress()->Comp(addr))
+                    ++count;
+
+            return count;
+        }
+
+        TCPClient *HTTPConnectionPool::Acquire(IPAddress *addr,bool *reused)
+        {
+            if(!addr)return(nullptr);
+
+            ClearTimeOut();
+
+            for(int i=idle_list.GetCount()-1;i>=0;i--)                      //从最近放入的开始找，它最不可能已被服务器关闭
+            {
+                TCPClient *tcp=idle_list.GetData()[i].tcp;
+
+                if(!tcp->GetAddress()->Comp(addr))
+                    continue;
+
+                if(!IsIdleAlive(tcp->ThisSocket))
+                {
+                    Remove(i);
+                    continue;
+                }
+
+                idle_list.DeleteMove(i);
+
+                ++reuse_count;
+
+                if(reused)*reused=true;
+                return tcp;
+            }
+
+            if(reused)*reused=false;
+
+            TCPClient *tcp=CreateTCPClient(addr);
+
+            if(tcp)
+                ++create_count;
+
+            return tcp;
+        }
+
+        void HTTPConnectionPool::Release(TCPClient *tcp)
+        {
+            if(!tcp)return;
+
+            ClearTimeOut();
+
+            if(tcp->ThisSocket<0
+             ||config.max_idle_per_host==0
+             ||GetHostIdleCount(tcp->GetAddress())>=int(config.max_idle_per_host))
+            {
+                delete tcp;
+                return;
+            }
+
+            if(idle_list.GetCount()>=int(config.max_idle_total))
+            {
+                if(config.max_idle_total==0)
+                {
+                    delete tcp;
+                    return;
+                }
+
+                Remove(0);                                                  //关闭最早空闲的连接
+            }
+
+            IdleConnection ic;
+
+            ic.tcp=tcp;
+            ic.release_time=GetDoubleTime();
+
+            idle_list.Add(ic);
+        }
+
+        void HTTPConnectionPool::ClearTimeOut()
+        {
+            const double time_out=GetDoubleTime()-config.idle_time_out;
+
+            int count=0;
+
+            for(const IdleConnection &ic:idle_list)
+            {
+                if(ic.release_time>time_out)
+                    break;
+
+                delete ic.tcp;
+                ++count;
+            }
+
+            if(count>0)
+                idle_list.DeleteMove(0,count);
+        }
+
+        void HTTPConnectionPool::Clear()
+        {
+            for(const IdleConnection &ic:idle_list)
+                delete ic.tcp;
+
+            idle_list.Clear();
+        }
+    }//namespace network
+}//namespace hgl
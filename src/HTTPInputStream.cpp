@@ -1,5 +1,6 @@
 ﻿#include<hgl/network/HTTPInputStream.h>
 #include<hgl/network/TCPClient.h>
+#include<hgl/network/HTTPConnectionPool.h>
 #include<hgl/log/LogInfo.h>
 #include<hgl/type/Smart.h>
 
@@ -21,14 +22,77 @@ namespace hgl
             constexpr uint HTTP_REQUEST_HEADER_END_SIZE=sizeof(HTTP_REQUEST_HEADER_END)-1;
 
             constexpr uint HTTP_HEADER_BUFFER_SIZE=HGL_SIZE_1KB;
+
+            constexpr char HTTP_REQUEST_RANGE[]="\r\nRange: bytes=";
+            constexpr uint HTTP_REQUEST_RANGE_SIZE=sizeof(HTTP_REQUEST_RANGE)-1;
+
+            /**
+             * 写入一个十进制数
+             * @return 写入的字符数
+             */
+            int WriteNumber(char *str,int max_size,uint64 value)
+            {
+                char tmp[24];
+                int len=0;
+
+                do
+                {
+                    tmp[len++]='0'+char(value%10);
+                    value/=10;
+                }while(value);
+
+                if(len>max_size)return(0);
+
+                for(int i=0;i<len;i++)
+                    str[i]=tmp[len-1-i];
+
+                return len;
+            }
+
+            int HexValue(char c)
+            {
+                if(c>='0'&&c<='9')return c-'0';
+                if(c>='a'&&c<='f')return c-'a'+10;
+                if(c>='A'&&c<='F')return c-'A'+10;
+                return -1;
+            }
+
+            /**
+             * 比较一段字符与小写字符串是否相同(忽略大小写)
+             */
+            bool EqualNoCase(const char *str,int len,const char *lower_str,int lower_len)
+            {
+                if(len!=lower_len)return(false);
+
+                for(int i=0;i<len;i++)
+                {
+                    char c=str[i];
+
+                    if(c>='A'&&c<='Z')c+='a'-'A';
+
+                    if(c!=lower_str[i])return(false);
+                }
+
+                return(true);
+            }
         }
 
         HTTPInputStream::HTTPInputStream()
         {
             tcp=nullptr;
+            pool=nullptr;
+            keep_alive=false;
 
             pos=-1;
             filelength=-1;
+            total_length=-1;
+
+            chunked=false;
+            chunk_state=ChunkState::Size;
+            chunk_left=0;
+            chunk_line=0;
+            chunk_ext=false;
+            raw_pos=raw_size=0;
 
             tcp_is=nullptr;
 
@@ -48,9 +112,11 @@ namespace hgl
         * 创建流并打开一个文件
         * @param host 服务器地址 www.hyzgame.org.cn 或 127.0.0.1 之类
         * @param filename 路径及文件名 /download/hgl.rar 之类
+        * @param range_start 请求的起始字节(<0表示请求整个文件，否则服务器应返回206)
+        * @param range_end 请求的结束字节(含，<0表示到文件结尾)
         * @return 打开文件是否成功
         */
-        bool HTTPInputStream::Open(IPAddress *host_ip,const AnsiString &host_name,const AnsiString &filename)
+        bool HTTPInputStream::Open(IPAddress *host_ip,const AnsiString &host_name,const AnsiString &filename,int64 range_start,int64 range_end)
         {
             Close();
 
@@ -64,7 +130,9 @@ namespace hgl
             if(filename.IsEmpty())
                 RETURN_FALSE;
 
-            tcp=CreateTCPClient(host_ip);
+            bool reused=false;
+
+            tcp=(pool?pool->Acquire(host_ip,&reused):CreateTCPClient(host_ip));
 
             char *host_ip_str=host_ip->CreateString();
             SharedArray<char> self_clear(host_ip_str);
@@ -75,8 +143,9 @@ namespace hgl
                 RETURN_FALSE;
             }
 
-            //设定为非堵塞模式
-            tcp->SetBlock(false);
+            //设定为非堵塞模式(复用的连接已经是)
+            if(!reused)
+                tcp->SetBlock(false);
 
             //发送HTTP GET请求
             int len=0;
@@ -85,6 +154,17 @@ namespace hgl
             len+=strcpy(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,filename.c_str(),           filename.Length());
             len+=strcpy(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,HTTP_REQUEST_HEADER_BEGIN,  HTTP_REQUEST_HEADER_BEGIN_SIZE);
             len+=strcpy(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,host_name.c_str(),          host_name.Length());
+
+            if(range_start>=0)
+            {
+                len+=strcpy(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,HTTP_REQUEST_RANGE,     HTTP_REQUEST_RANGE_SIZE);
+                len+=WriteNumber(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,range_start);
+                len+=strcpy(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,"-",1);
+
+                if(range_end>=range_start)
+                    len+=WriteNumber(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,range_end);
+            }
+
             len+=strcpy(http_header+len,HTTP_HEADER_BUFFER_SIZE-len,HTTP_REQUEST_HEADER_END,    HTTP_REQUEST_HEADER_END_SIZE);
 
             OutputStream *tcp_os=tcp->GetOutputStream();
@@ -99,19 +179,88 @@ namespace hgl
 
             *http_header=0;
 
+            keep_alive=true;                    //HTTP/1.1缺省保持连接，收到响应头后再按Connection确定
+
             tcp_is=tcp->GetInputStream();
             return(true);
         }
 
         /**
-        * 关闭HTTP流
+        * 从一个已经发出请求的输入流中读取HTTP响应<br>
+        * 不经过TCPClient，流由调用者创建和释放，可用内存流在没有网络的情况下测试响应解析
+        * @param is 输入流
+        * @return 是否成功
+        */
+        bool HTTPInputStream::Open(InputStream *is)
+        {
+            Close();
+
+            response_code=0;
+            response_info.Clear();
+            response_list.Clear();
+
+            if(!is)
+                RETURN_FALSE;
+
+            tcp_is=is;
+            return(true);
+        }
+
+        /**
+        * 连接是否可以放回连接池(响应体已按Content-Length完整读完，且服务器允许保持连接)
+        */
+        bool HTTPInputStream::IsReusable()const
+        {
+            if(!pool||!tcp||!keep_alive)
+                return(false);
+
+            if(response_code!=200&&response_code!=206)
+                return(false);
+
+            if(chunked)
+                return(chunk_state==ChunkState::Finish&&raw_pos==raw_size);
+
+            return(filelength>=0&&pos==filelength);
+        }
+
+        const bool HTTPInputStream::IsFinished()const
+        {
+            if(chunked)
+                return(chunk_state==ChunkState::Finish);
+
+            return(filelength>=0&&pos>=filelength);
+        }
+
+        const int HTTPInputStream::GetSocket()const
+        {
+            return(tcp?tcp->ThisSocket:-1);
+        }
+
+        /**
+        * 关闭HTTP流，响应已完整读完时连接放回连接池
         */
         void HTTPInputStream::Close()
         {
+            if(IsReusable())
+            {
+                pool->Release(tcp);
+                tcp=nullptr;
+            }
+
             pos=0;
             filelength=-1;
+            total_length=-1;
+            keep_alive=false;
+
+            chunked=false;
+            chunk_state=ChunkState::Size;
+            chunk_left=0;
+            chunk_line=0;
+            chunk_ext=false;
+            raw_pos=raw_size=0;
 
             SAFE_CLEAR(tcp);
+            tcp_is=nullptr;
 
             *http_header=0;
             http_header_size=0;
@@ -134,6 +283,9 @@ namespace hgl
             if(!first)
                 return;
 
+            if(first-http_header!=8||!EqualNoCase(http_header,8,"http/1.1",8))     //HTTP/1.0缺省不保持连接
+                keep_alive=false;
+
             ++first;
             char *second=strchr(first,' ');
 
@@ -160,6 +312,20 @@ namespace hgl
                 value.fromString(first,second-first);
                 offset=second;
 
+                if(EqualNoCase(key.c_str(),key.Length(),"connection",10))
+                    keep_alive=!EqualNoCase(value.c_str(),value.Length(),"close",5);
+                else
+                if(EqualNoCase(key.c_str(),key.Length(),"transfer-encoding",17))
+                    chunked=EqualNoCase(value.c_str(),value.Length(),"chunked",7);
+                else
+                if(EqualNoCase(key.c_str(),key.Length(),"content-range",13))        //bytes start-end/total
+                {
+                    const char *slash=::strchr(value.c_str(),'/');
+
+                    if(slash&&slash[1]!='*')
+                        stou(slash+1,total_length);
+                }
+
                 response_list.CreateStringAttrib(key,value);
             }
         }
@@ -186,8 +352,18 @@ namespace hgl
 
             size=http_header_size-(offset-http_header)-HTTP_HEADER_FINISH_SIZE;
 
-            if(response_code==200)
+            if(response_code==200||response_code==206)
             {
+                if(chunked)                     //分块传输时忽略Content-Length，剩下的数据交给ReadChunked解码
+                {
+                    memmove(http_header,http_header+http_header_size-size,size);
+
+                    raw_pos=0;
+                    raw_size=size;
+                    pos=0;
+                    return(0);
+                }
+
                 offset=strstr(http_header,http_header_size,HTTP_CONTENT_LENGTH,HTTP_CONTENT_LENGTH_SIZE);
 
                 if(offset)
@@ -198,6 +374,9 @@ namespace hgl
 
                 //有些HTTP下载就是不提供文件长度
 
+                if(response_code==200)
+                    total_length=filelength;
+
                 pos=size;
                 return(pos);
             }
@@ -217,6 +396,7 @@ namespace hgl
 
             LOG_ERROR(OSString(OS_TEXT("Socket Error: "))+GetSocketString(err));
 
+            keep_alive=false;
             Close();
             RETURN_ERROR(-2);
         }
@@ -230,7 +410,7 @@ namespace hgl
         */
         int64 HTTPInputStream::Read(void *buf,int64 bufsize)
         {
-            if(!tcp)
+            if(!tcp_is)
                 RETURN_ERROR(-1);
 
             int readsize;
@@ -247,17 +427,35 @@ namespace hgl
                 readsize=PraseHttpHeader();
                 if(readsize==-1)
                 {
+                    keep_alive=false;
                     Close();
                     RETURN_ERROR(-3);
                 }
 
+                if(chunked)
+                    return ReadChunked(buf,bufsize);
+
                 if(pos>0)
                     memcpy(buf,http_header+http_header_size-pos,pos);
 
                 return(pos);
             }
             else
+            if(chunked)
+            {
+                return ReadChunked(buf,bufsize);
+            }
+            else
             {
+                if(filelength>=0)
+                {
+                    if(pos>=filelength)         //响应已读完，连接上不会再有这个响应的数据
+                        return(0);
+
+                    if(bufsize>filelength-pos)  //不读到下一个响应里去
+                        bufsize=filelength-pos;
+                }
+
                 readsize=tcp_is->Read((char *)buf,bufsize);
 
                 if(readsize<=0)
@@ -267,5 +465,157 @@ namespace hgl
                 return(readsize);
             }
         }
+
+        /**
+        * 解码分块传输的数据，原始数据放在http_header中(不会再用来存放响应头)
+        * @return >=0 解码出的数据长度(0表示暂时没有数据或已读完，参见IsFinished)
+        * @return <0 出错
+        */
+        int64 HTTPInputStream::ReadChunked(void *buf,int64 bufsize)
+        {
+            char *out=(char *)buf;
+            int64 total=0;
+            bool bad=false;
+
+            while(total<bufsize&&chunk_state!=ChunkState::Finish)
+            {
+                if(raw_pos>=raw_size)
+                {
+                    if(total>0)break;           //已经有数据了就先返回，不等待下一次recv
+
+                    const int readsize=tcp_is->Read(http_header,HTTP_HEADER_BUFFER_SIZE);
+
+                    if(readsize<=0)
+                        return ReturnError();
+
+                    raw_pos=0;
+                    raw_size=readsize;
+                }
+
+                if(chunk_state==ChunkState::Data)
+                {
+                    int64 size=raw_size-raw_pos;
+
+                    if(size>chunk_left)size=chunk_left;
+                    if(size>bufsize-total)size=bufsize-total;
+
+                    memcpy(out+total,http_header+raw_pos,size);
+
+                    raw_pos+=size;
+                    total+=size;
+                    chunk_left-=size;
+
+                    if(chunk_left==0)
+                        chunk_state=ChunkState::DataEnd;
+
+                    continue;
+                }
+
+                const char ch=http_header[raw_pos++];
+
+                if(chunk_state==ChunkState::Size)
+                {
+                    if(ch=='\n')
+                    {
+                        if(chunk_line==0)
+                        {
+                            bad=true;           //没有长度
+                            break;
+                        }
+
+                        chunk_state=(chunk_left>0?ChunkState::Data:ChunkState::Trailer);
+                        chunk_line=0;
+                        chunk_ext=false;
+                        continue;
+                    }
+
+                    if(chunk_ext||ch=='\r')
+                        continue;
+
+                    const int value=HexValue(ch);
+
+                    if(value<0)
+                    {
+                        if(chunk_line==0)       //长度之前不能有其它字符
+                        {
+                            bad=true;
+                            break;
+                        }
+
+                        chunk_ext=true;         //;扩展或空格，忽略到行尾
+                        continue;
+                    }
+
+                    if(++chunk_line>15)         //长度溢出
+                    {
+                        bad=true;
+                        break;
+                    }
+
+                    chunk_left=(chunk_left<<4)|value;
+                    continue;
+                }
+
+                if(chunk_state==ChunkState::DataEnd)
+                {
+                    if(ch=='\n')
+                    {
+                        chunk_state=ChunkState::Size;
+                        chunk_left=0;
+                        chunk_line=0;
+                    }
+                    else
+                    if(ch!='\r')
+                    {
+                        bad=true;               //分块数据后必须是CRLF
+                        break;
+                    }
+
+                    continue;
+                }
+
+                //ChunkState::Trailer
+                if(ch=='\n')
+                {
+                    if(chunk_line==0)
+                        chunk_state=ChunkState::Finish;
+                    else
+                        chunk_line=0;
+                }
+                else
+                if(ch!='\r')
+                    ++chunk_line;
+            }
+
+            if(bad)
+            {
+                LOG_ERROR("HTTP chunked data error.");
+
+                keep_alive=false;
+                Close();
+                RETURN_ERROR(-4);
+            }
+
+            pos+=total;
+            return(total);
+        }
+
+        int64 HTTPInputStream::Skip(int64 size)
+        {
+            char tmp[HGL_SIZE_1KB*4];
+            int64 left=size;
+
+            while(left>0)
+            {
+                const int64 readsize=Read(tmp,left<int64(sizeof(tmp))?left:int64(sizeof(tmp)));
+
+                if(readsize<=0)
+                    break;
+
+                left-=readsize;
+            }
+
+            return(size-left);
+        }
     }//namespace network
 }//namespace hgl
@@ -0,0 +1,611 @@
+﻿#include<hgl/network/HTTPRangeDownload.h>
+#include<hgl/network/HTTPConnectionPool.h>
+#include<hgl/log/LogInfo.h>
+#include<hgl/Time.h>
+
+namespace hgl
+{
+    void SetTimeVal(timeval &tv,const double t_sec);
+
+    namespace network
+    {
+        namespace
+        {
+            constexpr int64 RANGE_TAIL_BUFFER_SIZE=HGL_SIZE_1KB;           //HTTPInputStream一次最多交出1KB响应头后剩余的数据
+
+            /**
+             * 可读但读不到数据时，用MSG_PEEK确认服务器是否已关闭连接
+             */
+            bool IsPeerClosed(int sock)
+            {
+                if(sock<0)return(true);
+
+                char c;
+
+                const int result=recv(sock,&c,1,MSG_PEEK);
+
+                if(result==0)return(true);
+                if(result>0)return(false);
+
+                const int err=GetLastSocketError();
+
+                return(err!=nseWouldBlock&&err!=nseInt);
+            }
+        }//namespace
+
+        HTTPRangeDownload::HTTPRangeDownload(HTTPConnectionPool *p,const HTTPRangeDownloadConfig &cfg)
+        {
+            pool=p;
+            config=cfg;
+
+            if(config.connection_count<1)config.connection_count=1;
+            if(config.block_size<RANGE_TAIL_BUFFER_SIZE)config.block_size=RANGE_TAIL_BUFFER_SIZE;
+
+            addr=nullptr;
+            os=nullptr;
+
+            total_size=-1;
+            total_written=0;
+
+            next_block=0;
+            write_block=0;
+        }
+
+        HTTPRangeDownload::~HTTPRangeDownload()
+        {
+            Clear();
+
+            for(DataArray<char> *buf:buffer_pool)
+                delete buf;
+        }
+
+        void HTTPRangeDownload::Clear()
+        {
+            for(Worker *w:worker_list)
+            {
+                w->stream.Close();
+                delete w;
+            }
+
+            worker_list.Clear();
+
+            for(Block &b:block_list)
+                ReleaseBuffer(b);
+
+            block_list.Clear();
+
+            next_block=0;
+            write_block=0;
+        }
+
+        DataArray<char> *HTTPRangeDownload::AllocBuffer(int64 size)
+        {
+            DataArray<char> *buf;
+
+            const int pool_count=buffer_pool.GetCount();
+
+            if(pool_count>0)
+            {
+                buf=buffer_pool.GetData()[pool_count-1];
+                buffer_pool.SetCount(pool_count-1);
+            }
+            else
+            {
+                buf=new DataArray<char>;
+            }
+
+            buf->SetCount(size);
+            return buf;
+        }
+
+        void HTTPRangeDownload::ReleaseBuffer(Block &b)
+        {
+            if(!b.buffer)return;
+
+            buffer_pool.Add(b.buffer);
+            b.buffer=nullptr;
+        }
+
+        /**
+         * 让一个连接开始(或继续)下载指定分段，从分段中已收到的位置开始请求
+         */
+        bool HTTPRangeDownload::OpenBlock(Worker *w,int index)
+        {
+            Block &b=block_list.GetData()[index];
+
+            if(!b.buffer)
+                b.buffer=AllocBuffer(b.size);
+
+            w->block=index;
+            w->checked=false;
+            w->ready=false;
+
+            while(!w->stream.Open(addr,host_name,filename,b.start+b.recv,b.start+b.size-1))
+            {
+                if(++b.retry>config.max_retry)
+                {
+                    LOG_ERROR(OS_TEXT("HTTPRangeDownload connect failed,block: ")+OSString::numberOf(index));
+                    w->block=-1;
+                    return(false);
+                }
+            }
+
+            return(true);
+        }
+
+        /**
+         * 分段出错后关闭连接(不会归还连接池)，从已收到的位置重新请求
+         */
+        bool HTTPRangeDownload::RetryBlock(Worker *w)
+        {
+            Block &b=block_list.GetData()[w->block];
+
+            w->stream.Close();
+
+            if(++b.retry>config.max_retry)
+            {
+                LOG_ERROR(OS_TEXT("HTTPRangeDownload too many errors,block: ")+OSString::numberOf(w->block));
+                w->block=-1;
+                return(false);
+            }
+
+            LOG_INFO(OS_TEXT("HTTPRangeDownload retry block ")+OSString::numberOf(w->block)+OS_TEXT(" from ")+OSString::numberOf(b.start+b.recv));
+
+            return OpenBlock(w,w->block);
+        }
+
+        /**
+         * 从一个连接读取数据到它的分段缓存
+         * @return >0 读取到数据或有进展
+         * @return 0 暂时没有数据
+         * @return <0 出错(已关闭连接，需要重试)
+         */
+        int HTTPRangeDownload::ProcWorker(Worker *w)
+        {
+            Block &b=block_list.GetData()[w->block];
+
+            const int64 left=b.size-b.recv;
+            const uint old_code=w->stream.GetResponseCode();
+
+            int64 size;
+
+            if(left<RANGE_TAIL_BUFFER_SIZE)                                 //响应头后的数据可能一次交出1KB，不能直接读进分段缓存
+            {
+                char tail[RANGE_TAIL_BUFFER_SIZE];
+
+                size=w->stream.Read(tail,left);
+
+                if(size>left)
+                {
+                    LOG_ERROR(OS_TEXT("HTTPRangeDownload server sent more data than requested,block: ")+OSString::numberOf(w->block));
+                    w->stream.Close();
+                    return(-1);
+                }
+
+                if(size>0)
+                    memcpy(b.buffer->data()+b.recv,tail,size);
+            }
+            else
+            {
+                size=w->stream.Read(b.buffer->data()+b.recv,left);
+            }
+
+            if(size<0)
+                return(-1);
+
+            if(!w->checked&&w->stream.GetResponseCode()!=0)
+            {
+                if(w->stream.GetResponseCode()!=206
+                 ||w->stream.GetSize()!=left)
+                {
+                    LOG_ERROR(OS_TEXT("HTTPRangeDownload server did not return the requested range,block: ")+OSString::numberOf(w->block));
+                    w->stream.Close();
+                    return(-1);
+                }
+
+                w->checked=true;
+            }
+
+            b.recv+=size;
+
+            if(b.recv>=b.size)                                              //分段完成，连接归还连接池
+            {
+                w->stream.Close();
+                w->block=-1;
+                return(1);
+            }
+
+            if(size>0)return(1);
+
+            return(old_code!=w->stream.GetResponseCode()?1:0);
+        }
+
+        /**
+         * 按顺序写出已收到的数据：排在最前面的分段收到多少写多少，写完的分段释放缓存
+         */
+        bool HTTPRangeDownload::WriteBlocks()
+        {
+            while(write_block<block_list.GetCount())
+            {
+                Block &b=block_list.GetData()[write_block];
+
+                if(b.recv>b.written)
+                {
+                    const int64 size=b.recv-b.written;
+
+                    if(os->WriteFully(b.buffer->data()+b.written,size)!=size)
+                    {
+                        LOG_ERROR(OS_TEXT("HTTPRangeDownload write to OutputStream failed."));
+                        return(false);
+                    }
+
+                    b.written=b.recv;
+                    total_written+=size;
+                }
+
+                if(b.written<b.size)
+                    break;
+
+                ReleaseBuffer(b);
+                ++write_block;
+            }
+
+            return(true);
+        }
+
+        /**
+         * 等待任意一个正在下载的连接可读
+         * @return 可读的连接数量，0表示超时，<0表示出错
+         */
+        int HTTPRangeDownload::WaitRecv(double wait_time)
+        {
+            fd_set recv_set;
+            timeval tv;
+            int max_fd=-1;
+
+            FD_ZERO(&recv_set);
+
+            for(Worker *w:worker_list)
+            {
+                w->ready=false;
+
+                if(w->block<0)continue;
+
+                const int sock=w->stream.GetSocket();
+
+                if(sock<0)continue;
+
+                FD_SET(sock,&recv_set);
+
+                if(sock>max_fd)max_fd=sock;
+            }
+
+            if(max_fd<0)
+                return(0);
+
+            SetTimeVal(tv,wait_time);
+
+            const int result=select(max_fd+1,&recv_set,nullptr,nullptr,&tv);
+
+            if(result<=0)
+            {
+                if(result<0&&GetLastSocketError()==nseInt)
+                    return(0);
+
+                return(result);
+            }
+
+            for(Worker *w:worker_list)
+            {
+                if(w->block<0)continue;
+
+                const int sock=w->stream.GetSocket();
+
+                if(sock>=0&&FD_ISSET(sock,&recv_set))
+                    w->ready=true;
+            }
+
+            return(result);
+        }
+
+        /**
+         * 服务器不支持Range，把第一个分段已收到的数据写出后，用同一个连接顺序读完整个响应
+         */
+        int64 HTTPRangeDownload::DownloadWhole(Worker *w)
+        {
+            Block &b=block_list.GetData()[0];
+
+            if(b.recv>0)
+            {
+                if(os->WriteFully(b.buffer->data(),b.recv)!=b.recv)
+                    RETURN_ERROR(-1);
+
+                total_written+=b.recv;
+            }
+
+            total_size=w->stream.GetSize();
+
+            char *buf=b.buffer->data();
+            const int64 buf_size=b.buffer->GetCount();
+
+            double last_time=GetDoubleTime();
+
+            while(!w->stream.IsFinished())
+            {
+                const int64 size=w->stream.Read(buf,buf_size);
+
+                if(size<0)
+                    RETURN_ERROR(-1);
+
+                if(size>0)
+                {
+                    if(os->WriteFully(buf,size)!=size)
+                        RETURN_ERROR(-1);
+
+                    total_written+=size;
+                    last_time=GetDoubleTime();
+                    continue;
+                }
+
+                const int result=WaitRecv(config.time_out);
+
+                if(result<0)
+                    RETURN_ERROR(-1);
+
+                if(!w->ready)
+                {
+                    if(GetDoubleTime()-last_time>=config.time_out)
+                    {
+                        LOG_ERROR(OS_TEXT("HTTPRangeDownload time out."));
+                        RETURN_ERROR(-1);
+                    }
+
+                    continue;
+                }
+
+                if(IsPeerClosed(w->stream.GetSocket()))
+                {
+                    if(w->stream.GetSize()<0&&!w->stream.IsChunked())       //没有长度的响应以关闭连接结束
+                        break;
+
+                    LOG_ERROR(OS_TEXT("HTTPRangeDownload connection closed before the response finished."));
+                    RETURN_ERROR(-1);
+                }
+            }
+
+            w->stream.Close();
+
+            if(total_size<0)
+                total_size=total_written;
+
+            return total_written;
+        }
+
+        int64 HTTPRangeDownload::Download(io::OutputStream *out,IPAddress *host_ip,const AnsiString &hn,const AnsiString &fn)
+        {
+            if(!out||!host_ip)
+                RETURN_ERROR(-1);
+
+            Clear();
+
+            os=out;
+            addr=host_ip;
+            host_name=hn;
+            filename=fn;
+
+            total_size=-1;
+            total_written=0;
+
+            for(uint i=0;i<config.connection_count;i++)
+            {
+                Worker *w=new Worker;
+
+                w->stream.SetConnectionPool(pool);
+                w->block=-1;
+                w->checked=false;
+                w->ready=false;
+
+                worker_list.Add(w);
+            }
+
+            Worker *first=worker_list.GetData()[0];
+
+            {
+                Block b;
+
+                b.start=0;
+                b.size=config.block_size;
+                b.recv=0;
+                b.written=0;
+                b.retry=0;
+                b.buffer=nullptr;
+
+                block_list.Add(b);
+            }
+
+            if(!OpenBlock(first,0))
+                RETURN_ERROR(-1);
+
+            next_block=1;
+
+            double last_time=GetDoubleTime();
+
+            //探测：等到第一个分段的响应头解析完成
+
+            while(first->stream.GetResponseCode()==0)
+            {
+                Block &b=block_list.GetData()[0];
+
+                const int64 size=first->stream.Read(b.buffer->data(),b.size);
+
+                if(size<0)
+                    RETURN_ERROR(-1);
+
+                if(size>0)
+                    b.recv=size;
+
+                if(first->stream.GetResponseCode()!=0)
+                    break;
+
+                const int result=WaitRecv(config.time_out);
+
+                if(result<0)
+                    RETURN_ERROR(-1);
+
+                if(first->ready)
+                {
+                    if(IsPeerClosed(first->stream.GetSocket()))
+                    {
+                        LOG_ERROR(OS_TEXT("HTTPRangeDownload connection closed before the response header."));
+                        RETURN_ERROR(-1);
+                    }
+
+                    last_time=GetDoubleTime();
+                }
+                else
+                if(GetDoubleTime()-last_time>=config.time_out)
+                {
+                    LOG_ERROR(OS_TEXT("HTTPRangeDownload time out."));
+                    RETURN_ERROR(-1);
+                }
+            }
+
+            if(first->stream.GetResponseCode()==200)
+            {
+                LOG_INFO(OS_TEXT("HTTPRangeDownload server does not support Range,download with one connection."));
+                return DownloadWhole(first);
+            }
+
+            total_size=first->stream.GetTotalSize();
+
+            if(total_size<0)
+            {
+                LOG_ERROR(OS_TEXT("HTTPRangeDownload server did not return Content-Range total size."));
+                RETURN_ERROR(-1);
+            }
+
+            {
+                Block &b=block_list.GetData()[0];
+
+                if(b.size>total_size)
+                    b.size=total_size;
+
+                if(first->stream.GetSize()!=b.size||b.recv>b.size)
+                {
+                    LOG_ERROR(OS_TEXT("HTTPRangeDownload server did not return the requested range."));
+                    RETURN_ERROR(-1);
+                }
+
+                first->checked=true;
+
+                if(b.recv>=b.size)
+                {
+                    first->stream.Close();
+                    first->block=-1;
+                }
+            }
+
+            for(int64 start=config.block_size;start<total_size;start+=config.block_size)
+            {
+                Block b;
+
+                b.start=start;
+                b.size=hgl_min<int64>(config.block_size,total_size-start);
+                b.recv=0;
+                b.written=0;
+                b.retry=0;
+                b.buffer=nullptr;
+
+                block_list.Add(b);
+            }
+
+            const int block_count=block_list.GetCount();
+            const int max_ahead=int(config.connection_count)*2;            //最多缓存的分段数
+
+            while(write_block<block_count)
+            {
+                for(Worker *w:worker_list)                                  //空闲连接领取新的分段
+                {
+                    if(w->block>=0)continue;
+                    if(next_block>=block_count)break;
+                    if(next_block>=write_block+max_ahead)break;
+
+                    if(!OpenBlock(w,next_block))
+                        RETURN_ERROR(-1);
+
+                    ++next_block;
+                }
+
+                bool progress=false;
+
+                for(Worker *w:worker_list)
+                {
+                    if(w->block<0)continue;
+
+                    const int result=ProcWorker(w);
+
+                    if(result>0)
+                        progress=true;
+                    else
+                    if(result<0)
+                    {
+                        if(!RetryBlock(w))
+                            RETURN_ERROR(-1);
+                    }
+                }
+
+                if(!WriteBlocks())
+                    RETURN_ERROR(-1);
+
+                if(progress)
+                {
+                    last_time=GetDoubleTime();
+                    continue;
+                }
+
+                const int result=WaitRecv(config.time_out);
+
+                if(result<0)
+                    RETURN_ERROR(-1);
+
+                if(result==0)
+                {
+                    if(GetDoubleTime()-last_time>=config.time_out)
+                    {
+                        LOG_ERROR(OS_TEXT("HTTPRangeDownload time out."));
+                        RETURN_ERROR(-1);
+                    }
+
+                    continue;
+                }
+
+                for(Worker *w:worker_list)                                  //可读但读不到数据的连接可能已被服务器关闭
+                {
+                    if(!w->ready)continue;
+
+                    const int r=ProcWorker(w);
+
+                    if(r>0)
+                    {
+                        progress=true;
+                        continue;
+                    }
+
+                    if(r==0&&!IsPeerClosed(w->stream.GetSocket()))
+                        continue;
+
+                    if(w->block>=0&&!RetryBlock(w))
+                        RETURN_ERROR(-1);
+                }
+
+                if(progress)
+                    last_time=GetDoubleTime();
+            }
+
+            for(Worker *w:worker_list)
+                w->stream.Close();
+
+            return total_written;
+        }
+    }//namespace network
+}//namespace hgl
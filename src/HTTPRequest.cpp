@@ -0,0 +1,431 @@
+﻿#include<hgl/network/HTTPRequest.h>
+#include<hgl/type/StrChar.h>
+
+#if defined(__AVX2__)
+    #include<immintrin.h>
+#elif defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+    #define HGL_HTTP_SCAN_SSE2
+    #include<emmintrin.h>
+#elif defined(__aarch64__)||defined(_M_ARM64)
+    #define HGL_HTTP_SCAN_NEON
+    #include<arm_neon.h>
+#endif
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            /**
+             * 查找换行符，按32/16字节块比较，命中的块内再逐字节确定位置
+             * @return 换行符位置，没有时返回size
+             */
+            uint FindNewLine(const char *data,uint pos,const uint size)
+            {
+#if defined(__AVX2__)
+                {
+                    const __m256i nl=_mm256_set1_epi8('\n');
+
+                    while(size-pos>=32)
+                    {
+                        if(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data+pos)),nl)))
+                            break;
+
+                        pos+=32;
+                    }
+                }
+#endif//__AVX2__
+
+#if defined(__AVX2__)||defined(HGL_HTTP_SCAN_SSE2)
+                {
+                    const __m128i nl=_mm_set1_epi8('\n');
+
+                    while(size-pos>=16)
+                    {
+                        if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data+pos)),nl)))
+                            break;
+
+                        pos+=16;
+                    }
+                }
+#elif defined(HGL_HTTP_SCAN_NEON)
+                {
+                    const uint8x16_t nl=vdupq_n_u8('\n');
+
+                    while(size-pos>=16)
+                    {
+                        if(vmaxvq_u8(vceqq_u8(vld1q_u8((const uint8 *)(data+pos)),nl)))
+                            break;
+
+                        pos+=16;
+                    }
+                }
+#endif
+
+                while(pos<size&&data[pos]!='\n')
+                    ++pos;
+
+                return pos;
+            }
+
+            inline bool IsSpace(const char c){return c==' '||c=='\t';}
+
+            inline char ToLower(const char c){return (c>='A'&&c<='Z')?c+('a'-'A'):c;}
+
+            inline bool IsTokenChar(const char c)                           //RFC7230 tchar
+            {
+                if(c>='a'&&c<='z')return(true);
+                if(c>='A'&&c<='Z')return(true);
+                if(c>='0'&&c<='9')return(true);
+
+                return c&&::strchr("!#$%&'*+-.^_`|~",c);
+            }
+
+            HTTPString MakeString(const char *start,const char *end)
+            {
+                HTTPString s;
+
+                s.data=start;
+                s.size=uint(end-start);
+                return s;
+            }
+
+            HTTPString Trim(const char *start,const char *end)
+            {
+                while(start<end&&IsSpace(*start))++start;
+                while(end>start&&IsSpace(end[-1]))--end;
+
+                return MakeString(start,end);
+            }
+
+            /**
+             * 在逗号分隔的列表中查找一项(不区分大小写)
+             */
+            bool HasToken(const HTTPString &value,const char *lower_token)
+            {
+                const char *p=value.data;
+                const char *end=value.data+value.size;
+
+                while(p<end)
+                {
+                    const char *item=p;
+
+                    while(p<end&&*p!=',')++p;
+
+                    if(Trim(item,p).EqualNoCase(lower_token))
+                        return(true);
+
+                    ++p;
+                }
+
+                return(false);
+            }
+
+            bool ParseContentLength(const HTTPString &value,uint64 &length)
+            {
+                if(value.size<=0||value.size>19)                            //超过19位可能溢出
+                    return(false);
+
+                length=0;
+
+                for(uint i=0;i<value.size;i++)
+                {
+                    const char c=value.data[i];
+
+                    if(c<'0'||c>'9')
+                        return(false);
+
+                    length=length*10+(c-'0');
+                }
+
+                return(true);
+            }
+
+            uint AppendString(char *buf,uint pos,const uint buf_size,const char *str,const uint size)
+            {
+                if(pos+size>buf_size)return(buf_size+1);
+
+                memcpy(buf+pos,str,size);
+                return pos+size;
+            }
+
+            uint AppendString(char *buf,uint pos,const uint buf_size,const char *str)
+            {
+                return AppendString(buf,pos,buf_size,str,uint(strlen(str)));
+            }
+
+            uint AppendNumber(char *buf,uint pos,const uint buf_size,const uint64 value)
+            {
+                char str[24];
+
+                hgl::utos(str,sizeof(str),value);
+
+                return AppendString(buf,pos,buf_size,str);
+            }
+        }//namespace
+
+        bool HTTPString::EqualNoCase(const char *str)const
+        {
+            for(uint i=0;i<size;i++)
+            {
+                if(!str[i])return(false);
+                if(ToLower(data[i])!=str[i])return(false);
+            }
+
+            return str[size]==0;
+        }
+
+        const HTTPString *HTTPRequest::GetHeader(const char *lower_name)const
+        {
+            for(uint i=0;i<header_count;i++)
+                if(header[i].name.EqualNoCase(lower_name))
+                    return &(header[i].value);
+
+            return(nullptr);
+        }
+
+        uint FindHTTPHeadEnd(const char *data,const uint size,uint &scan_pos)
+        {
+            uint pos=scan_pos;
+
+            while(pos<size)
+            {
+                pos=FindNewLine(data,pos,size);
+
+                if(pos>=size)
+                    break;
+
+                if((pos>=1&&data[pos-1]=='\n')                              //兼容只用\n换行的客户端
+                 ||(pos>=2&&data[pos-1]=='\r'&&data[pos-2]=='\n'))
+                {
+                    scan_pos=0;
+                    return pos+1;
+                }
+
+                ++pos;
+            }
+
+            scan_pos=size;                                                  //回看的字节依然在缓冲区里，所以不用保留
+            return(0);
+        }
+
+        int ParseHTTPRequestHead(HTTPRequest &req,const char *data,const uint head_size)
+        {
+            req.header_count    =0;
+            req.head_size       =head_size;
+            req.content_length  =0;
+            req.keep_alive      =true;
+            req.upgrade_websocket=false;
+            req.expect_continue =false;
+            req.body            =nullptr;
+
+            if(!data||head_size<=0)
+                return(-400);
+
+            const char *end=data+head_size;
+            const char *p=data;
+
+            //请求行
+            const char *line_end=data+FindNewLine(data,0,head_size);
+            const char *next=line_end+1;
+
+            if(line_end>p&&line_end[-1]=='\r')--line_end;
+
+            {
+                const char *s=p;
+
+                while(s<line_end&&IsTokenChar(*s))++s;
+
+                if(s==p||s>=line_end||*s!=' ')
+                    return(-400);
+
+                req.method=MakeString(p,s);
+
+                p=++s;
+
+                while(s<line_end&&*s!=' ')++s;
+
+                if(s==p||s>=line_end)
+                    return(-400);
+
+                req.target=MakeString(p,s);
+
+                const HTTPString version=MakeString(s+1,line_end);
+
+                if(version.Equal("HTTP/1.1"))req.version_minor=1;else
+                if(version.Equal("HTTP/1.0"))req.version_minor=0;else
+                if(version.size>5&&memcmp(version.data,"HTTP/",5)==0)
+                    return(-505);
+                else
+                    return(-400);
+
+                const char *q=req.target.data;
+                const char *target_end=q+req.target.size;
+
+                while(q<target_end&&*q!='?')++q;
+
+                req.path=MakeString(req.target.data,q);
+                req.query=(q<target_end?MakeString(q+1,target_end):HTTPString());
+            }
+
+            bool has_length=false;
+            bool has_transfer_encoding=false;
+            bool conn_close=false;
+            bool conn_keep_alive=false;
+            bool conn_upgrade=false;
+            bool upgrade_websocket=false;
+
+            //头字段
+            p=next;
+
+            while(p<end)
+            {
+                line_end=data+FindNewLine(data,uint(p-data),head_size);
+                next=line_end+1;
+
+                if(line_end>p&&line_end[-1]=='\r')--line_end;
+
+                if(line_end==p)                                             //空行，头结束
+                    break;
+
+                if(IsSpace(*p))                                             //不接受已废弃的折行
+                    return(-400);
+
+                const char *colon=p;
+
+                while(colon<line_end&&IsTokenChar(*colon))++colon;
+
+                if(colon==p||colon>=line_end||*colon!=':')                  //名称与冒号之间不能有空格
+                    return(-400);
+
+                if(req.header_count>=HGL_HTTP_REQUEST_HEADER_MAX_COUNT)
+                    return(-431);
+
+                HTTPHeaderField &field=req.header[req.header_count++];
+
+                field.name=MakeString(p,colon);
+                field.value=Trim(colon+1,line_end);
+
+                if(field.name.EqualNoCase("content-length"))
+                {
+                    uint64 length;
+
+                    if(!ParseContentLength(field.value,length))
+                        return(-400);
+
+                    if(has_length&&length!=req.content_length)              //多个不同的长度
+                        return(-400);
+
+                    req.content_length=length;
+                    has_length=true;
+                }
+                else
+                if(field.name.EqualNoCase("transfer-encoding"))
+                {
+                    has_transfer_encoding=true;
+                }
+                else
+                if(field.name.EqualNoCase("connection"))
+                {
+                    if(HasToken(field.value,"close"))conn_close=true;
+                    if(HasToken(field.value,"keep-alive"))conn_keep_alive=true;
+                    if(HasToken(field.value,"upgrade"))conn_upgrade=true;
+                }
+                else
+                if(field.name.EqualNoCase("upgrade"))
+                {
+                    if(HasToken(field.value,"websocket"))upgrade_websocket=true;
+                }
+                else
+                if(field.name.EqualNoCase("expect"))
+                {
+                    if(field.value.EqualNoCase("100-continue"))req.expect_continue=true;
+                }
+
+                p=next;
+            }
+
+            if(has_transfer_encoding)                                       //同时有Content-Length时可能是请求走私
+                return(has_length?-400:-501);
+
+            req.keep_alive=(req.version_minor>=1?!conn_close:(conn_keep_alive&&!conn_close));
+            req.upgrade_websocket=(conn_upgrade&&upgrade_websocket);
+
+            return int(head_size);
+        }
+
+        const char *GetHTTPStatusText(const uint status)
+        {
+            switch(status)
+            {
+                case 100:return "Continue";
+                case 101:return "Switching Protocols";
+                case 200:return "OK";
+                case 201:return "Created";
+                case 202:return "Accepted";
+                case 204:return "No Content";
+                case 206:return "Partial Content";
+                case 301:return "Moved Permanently";
+                case 302:return "Found";
+                case 304:return "Not Modified";
+                case 400:return "Bad Request";
+                case 401:return "Unauthorized";
+                case 403:return "Forbidden";
+                case 404:return "Not Found";
+                case 405:return "Method Not Allowed";
+                case 408:return "Request Timeout";
+                case 411:return "Length Required";
+                case 413:return "Content Too Large";
+                case 414:return "URI Too Long";
+                case 415:return "Unsupported Media Type";
+                case 429:return "Too Many Requests";
+                case 431:return "Request Header Fields Too Large";
+                case 500:return "Internal Server Error";
+                case 501:return "Not Implemented";
+                case 502:return "Bad Gateway";
+                case 503:return "Service Unavailable";
+                case 505:return "HTTP Version Not Supported";
+                default: return "Unknown";
+            }
+        }
+
+        uint MakeHTTPResponseHead(char *buf,const uint buf_size,const uint status,const uint64 content_length,const char *content_type,const bool keep_alive,const char *extra_headers)
+        {
+            if(!buf||status<100||status>999)
+                return(0);
+
+            uint pos=0;
+
+            pos=AppendString(buf,pos,buf_size,"HTTP/1.1 ");
+            pos=AppendNumber(buf,pos,buf_size,status);
+            pos=AppendString(buf,pos,buf_size," ");
+            pos=AppendString(buf,pos,buf_size,GetHTTPStatusText(status));
+            pos=AppendString(buf,pos,buf_size,"\r\n");
+
+            if(content_type&&*content_type)
+            {
+                pos=AppendString(buf,pos,buf_size,"Content-Type: ");
+                pos=AppendString(buf,pos,buf_size,content_type);
+                pos=AppendString(buf,pos,buf_size,"\r\n");
+            }
+
+            if(status>=200&&status!=204)                                    //1xx与204不能带Content-Length
+            {
+                pos=AppendString(buf,pos,buf_size,"Content-Length: ");
+                pos=AppendNumber(buf,pos,buf_size,content_length);
+                pos=AppendString(buf,pos,buf_size,"\r\n");
+            }
+
+            if(status>=200)
+                pos=AppendString(buf,pos,buf_size,keep_alive?"Connection: keep-alive\r\n":"Connection: close\r\n");    //HTTP/1.0的客户端需要明确的keep-alive
+
+            if(extra_headers)
+                pos=AppendString(buf,pos,buf_size,extra_headers);
+
+            pos=AppendString(buf,pos,buf_size,"\r\n");
+
+            return(pos>buf_size?0:pos);
+        }
+    }//namespace network
+}//namespace hgl
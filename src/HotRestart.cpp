@@ -0,0 +1,454 @@
+﻿#include<hgl/network/HotRestart.h>
+#include<hgl/network/Socket.h>
+#include<hgl/log/LogInfo.h>
+#include<hgl/Time.h>
+
+#if HGL_OS != HGL_OS_Windows
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<unistd.h>
+#include<poll.h>
+#endif//HGL_OS != HGL_OS_Windows
+
+namespace hgl
+{
+    namespace network
+    {
+#if HGL_OS != HGL_OS_Windows
+        namespace
+        {
+            constexpr uint32 HANDOFF_MAGIC=0x46444E48;                          ///<'HNDF'
+
+            /**
+             * 每个转交项的头，与状态数据以一次sendmsg发出，socket放在SCM_RIGHTS中
+             */
+            struct HandoffHeader
+            {
+                uint32 magic;
+                uint32 type;
+                uint32 tag;
+                uint32 state_size;
+                sockaddr_storage address;
+            };//struct HandoffHeader
+
+            constexpr uint HANDOFF_MAX_STATE_SIZE=HGL_SIZE_1MB*64;
+
+            bool MakeUnixAddress(sockaddr_un &addr,const char *path)
+            {
+                if(!path||!*path)return(false);
+
+                const size_t len=strlen(path);
+
+                if(len>=sizeof(addr.sun_path))
+                {
+                    LOG_ERROR(OS_TEXT("HotRestart unix socket path is too long."));
+                    return(false);
+                }
+
+                hgl_zero(addr);
+                addr.sun_family=AF_UNIX;
+                memcpy(addr.sun_path,path,len);
+                return(true);
+            }
+
+            /**
+             * 等待socket可读
+             * @return 1 可读，0 超时，-1 出错
+             */
+            int WaitReadable(int sock,const double time_out)
+            {
+                pollfd pfd;
+
+                pfd.fd=sock;
+                pfd.events=POLLIN;
+                pfd.revents=0;
+
+                int result;
+
+                do
+                {
+                    result=poll(&pfd,1,time_out>0?int(time_out*1000):-1);
+                }while(result<0&&errno==EINTR);
+
+                return result<0?-1:(result>0?1:0);
+            }
+
+            /**
+             * 收满指定字节数
+             */
+            bool RecvAll(int sock,void *data,uint size,const double time_out)
+            {
+                char *p=(char *)data;
+
+                while(size>0)
+                {
+                    if(WaitReadable(sock,time_out)<=0)
+                        return(false);
+
+                    const ssize_t result=recv(sock,p,size,0);
+
+                    if(result<0)
+                    {
+                        if(errno==EINTR||errno==EAGAIN)continue;
+                        return(false);
+                    }
+
+                    if(result==0)
+                        return(false);
+
+                    p+=result;
+                    size-=result;
+                }
+
+                return(true);
+            }
+        }//namespace
+
+        void CloseHandoffSocket(int sock)
+        {
+            if(sock<0)return;
+
+            close(sock);                                                        //shutdown会作用到新进程手中同一个连接上
+        }
+
+        bool HotRestartSender::Listen(const char *unix_path)
+        {
+            Close();
+
+            sockaddr_un addr;
+
+            if(!MakeUnixAddress(addr,unix_path))
+                RETURN_FALSE;
+
+            listen_sock=socket(AF_UNIX,SOCK_STREAM,0);
+
+            if(listen_sock<0)
+            {
+                LOG_ERROR(OS_TEXT("HotRestart create unix socket failed,errno:")+OSString::numberOf(errno));
+                RETURN_FALSE;
+            }
+
+            unlink(unix_path);                                                  //上一次遗留的
+
+            if(bind(listen_sock,(sockaddr *)&addr,sizeof(addr))
+             ||listen(listen_sock,1))
+            {
+                LOG_ERROR(OS_TEXT("HotRestart listen unix socket failed,errno:")+OSString::numberOf(errno));
+                close(listen_sock);
+                listen_sock=-1;
+                RETURN_FALSE;
+            }
+
+            path=unix_path;
+            finished=false;
+            return(true);
+        }
+
+        bool HotRestartSender::WaitReceiver(const double time_out)
+        {
+            if(listen_sock==-1)
+                RETURN_FALSE;
+
+            if(peer_sock!=-1)
+                return(true);
+
+            if(WaitReadable(listen_sock,time_out)<=0)
+                return(false);
+
+            peer_sock=accept(listen_sock,nullptr,nullptr);
+
+            if(peer_sock<0)
+            {
+                peer_sock=-1;
+                RETURN_FALSE;
+            }
+
+            return(true);
+        }
+
+        void HotRestartSender::Close()
+        {
+            std::lock_guard<std::mutex> lg(lock);
+
+            if(peer_sock!=-1)
+            {
+                close(peer_sock);
+                peer_sock=-1;
+            }
+
+            if(listen_sock!=-1)
+            {
+                close(listen_sock);
+                listen_sock=-1;
+
+                unlink(path.c_str());
+            }
+
+            finished=true;
+        }
+
+        bool HotRestartSender::SendItem(HandoffType type,uint tag,int sock,const SocketAddress *addr,const void *state,uint size)
+        {
+            HandoffHeader header;
+
+            hgl_zero(header);
+            header.magic=HANDOFF_MAGIC;
+            header.type=uint32(type);
+            header.tag=tag;
+            header.state_size=size;
+
+            if(addr)
+                memcpy(&header.address,addr->GetSockAddr(),addr->GetSockAddrInSize());
+
+            iovec iov[2];
+
+            iov[0].iov_base=&header;
+            iov[0].iov_len=sizeof(header);
+            iov[1].iov_base=(void *)state;
+            iov[1].iov_len=size;
+
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+            msghdr msg;
+
+            hgl_zero(msg);
+            msg.msg_iov=iov;
+            msg.msg_iovlen=(size>0?2:1);
+
+            if(sock>=0)
+            {
+                msg.msg_control=control;
+                msg.msg_controllen=sizeof(control);
+
+                cmsghdr *cm=CMSG_FIRSTHDR(&msg);
+
+                cm->cmsg_level=SOL_SOCKET;
+                cm->cmsg_type=SCM_RIGHTS;
+                cm->cmsg_len=CMSG_LEN(sizeof(int));
+                memcpy(CMSG_DATA(cm),&sock,sizeof(int));
+            }
+
+            std::lock_guard<std::mutex> lg(lock);
+
+            if(finished||peer_sock==-1)
+                return(false);
+
+            const size_t total=sizeof(header)+size;
+            size_t sent=0;
+
+            while(sent<total)                                                   //socket只随第一段发出，余下的只是普通数据
+            {
+                const ssize_t result=sendmsg(peer_sock,&msg,MSG_NOSIGNAL);
+
+                if(result<0)
+                {
+                    if(errno==EINTR)continue;
+
+                    LOG_ERROR(OS_TEXT("HotRestart sendmsg failed,errno:")+OSString::numberOf(errno));
+                    finished=true;
+                    return(false);
+                }
+
+                sent+=result;
+
+                msg.msg_control=nullptr;
+                msg.msg_controllen=0;
+
+                size_t skip=result;
+
+                while(skip>0&&msg.msg_iovlen>0)
+                {
+                    if(skip<msg.msg_iov->iov_len)
+                    {
+                        msg.msg_iov->iov_base=(char *)msg.msg_iov->iov_base+skip;
+                        msg.msg_iov->iov_len-=skip;
+                        break;
+                    }
+
+                    skip-=msg.msg_iov->iov_len;
+                    ++msg.msg_iov;
+                    --msg.msg_iovlen;
+                }
+            }
+
+            return(true);
+        }
+
+        bool HotRestartSender::SendListen(int sock,const uint tag)
+        {
+            if(sock<0)return(false);
+
+            return SendItem(HandoffType::Listen,tag,sock,nullptr,nullptr,0);
+        }
+
+        bool HotRestartSender::SendConnection(int sock,const uint tag,const SocketAddress *addr,const void *state,const uint size)
+        {
+            if(sock<0)return(false);
+            if(size>HANDOFF_MAX_STATE_SIZE)return(false);
+
+            return SendItem(HandoffType::Connection,tag,sock,addr,state,size);
+        }
+
+        bool HotRestartSender::Finish()
+        {
+            if(!SendItem(HandoffType::End,0,-1,nullptr,nullptr,0))
+                return(false);
+
+            std::lock_guard<std::mutex> lg(lock);
+
+            finished=true;
+            return(true);
+        }
+
+        bool HotRestartReceiver::Connect(const char *unix_path,const double time_out)
+        {
+            Close();
+
+            sockaddr_un addr;
+
+            if(!MakeUnixAddress(addr,unix_path))
+                RETURN_FALSE;
+
+            const double end_time=GetDoubleTime()+time_out;
+
+            while(true)
+            {
+                sock=socket(AF_UNIX,SOCK_STREAM,0);
+
+                if(sock<0)
+                {
+                    sock=-1;
+                    RETURN_FALSE;
+                }
+
+                if(connect(sock,(sockaddr *)&addr,sizeof(addr))==0)
+                    return(true);
+
+                const int err=errno;
+
+                close(sock);
+                sock=-1;
+
+                if((err!=ENOENT&&err!=ECONNREFUSED)                             //旧进程还没有开始监听的话继续等
+                 ||GetDoubleTime()>=end_time)
+                {
+                    LOG_HINT(OS_TEXT("HotRestart connect unix socket failed,errno:")+OSString::numberOf(err));
+                    return(false);
+                }
+
+                WaitTime(0.05);
+            }
+        }
+
+        void HotRestartReceiver::Close()
+        {
+            if(sock==-1)return;
+
+            close(sock);
+            sock=-1;
+        }
+
+        bool HotRestartReceiver::Recv(HandoffItem &item,const double time_out)
+        {
+            if(sock==-1)
+                return(false);
+
+            item.sock=-1;
+            item.address.Clear();
+            item.state.SetCount(0);
+
+            HandoffHeader header;
+
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+            iovec iov;
+
+            iov.iov_base=&header;
+            iov.iov_len=sizeof(header);
+
+            msghdr msg;
+
+            hgl_zero(msg);
+            msg.msg_iov=&iov;
+            msg.msg_iovlen=1;
+            msg.msg_control=control;
+            msg.msg_controllen=sizeof(control);
+
+            if(WaitReadable(sock,time_out)<=0)
+                return(false);
+
+            ssize_t result;
+
+            do
+            {
+                result=recvmsg(sock,&msg,0);
+            }while(result<0&&errno==EINTR);
+
+            if(result<=0)
+                return(false);
+
+            for(cmsghdr *cm=CMSG_FIRSTHDR(&msg);cm;cm=CMSG_NXTHDR(&msg,cm))
+                if(cm->cmsg_level==SOL_SOCKET&&cm->cmsg_type==SCM_RIGHTS)
+                    memcpy(&item.sock,CMSG_DATA(cm),sizeof(int));
+
+            if(result<ssize_t(sizeof(header))                                   //socket只会在第一段中
+             &&!RecvAll(sock,(char *)&header+result,uint(sizeof(header)-result),time_out))
+            {
+                CloseHandoffSocket(item.sock);
+                return(false);
+            }
+
+            if(header.magic!=HANDOFF_MAGIC
+             ||header.state_size>HANDOFF_MAX_STATE_SIZE
+             ||(msg.msg_flags&MSG_CTRUNC))
+            {
+                LOG_ERROR(OS_TEXT("HotRestart recv a bad item."));
+                CloseHandoffSocket(item.sock);
+                item.sock=-1;
+                Close();
+                return(false);
+            }
+
+            item.type=HandoffType(header.type);
+            item.tag=header.tag;
+
+            if(header.address.ss_family==AF_INET||header.address.ss_family==AF_INET6)
+                memcpy(item.address.GetSockAddr(),&header.address,sizeof(header.address));
+
+            if(header.state_size>0)
+            {
+                item.state.SetCount(header.state_size);
+
+                if(!RecvAll(sock,item.state.GetData(),header.state_size,time_out))
+                {
+                    CloseHandoffSocket(item.sock);
+                    item.sock=-1;
+                    return(false);
+                }
+            }
+
+            if(item.type!=HandoffType::End&&item.sock<0)
+            {
+                LOG_ERROR(OS_TEXT("HotRestart recv a item without socket."));
+                return(false);
+            }
+
+            return(true);
+        }
+#else
+        void CloseHandoffSocket(int sock){CloseSocket(sock);}
+
+        bool HotRestartSender::Listen(const char *){return(false);}
+        bool HotRestartSender::WaitReceiver(const double){return(false);}
+        void HotRestartSender::Close(){}
+        bool HotRestartSender::SendItem(HandoffType,uint,int,const SocketAddress *,const void *,uint){return(false);}
+        bool HotRestartSender::SendListen(int,const uint){return(false);}
+        bool HotRestartSender::SendConnection(int,const uint,const SocketAddress *,const void *,const uint){return(false);}
+        bool HotRestartSender::Finish(){return(false);}
+
+        bool HotRestartReceiver::Connect(const char *,const double){return(false);}
+        void HotRestartReceiver::Close(){}
+        bool HotRestartReceiver::Recv(HandoffItem &,const double){return(false);}
+#endif//HGL_OS != HGL_OS_Windows
+    }//namespace network
+}//namespace hgl
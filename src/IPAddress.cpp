@@ -1,4 +1,5 @@
 ﻿#include<hgl/network/IP.h>
+#include<hgl/network/DNSCache.h>
 #include<hgl/log/LogInfo.h>
 
 namespace hgl
@@ -7,26 +8,18 @@ namespace hgl
     {
         bool FillAddr(sockaddr_in &addr,const char *name,int socktype,int protocol)
         {
+            hgl_zero(addr);
+
+            addr.sin_family=AF_INET;
+
             if(name)
             {
-                struct addrinfo hints, *answer;
-
-                hgl_zero(hints);
-                hints.ai_family = AF_INET;
-                hints.ai_socktype=socktype;
-                hints.ai_protocol=protocol;
+                List<in_addr> addr_list;
 
-                if (getaddrinfo(name, nullptr, &hints, &answer))         //此函数最低WindowsXP SP2
+                if(GetDNSCache()->Resolve(addr_list,name,socktype,protocol)<=0)
                     RETURN_FALSE;
 
-                memcpy(&addr,answer->ai_addr,sizeof(sockaddr_in));
-                freeaddrinfo(answer);
-            }
-            else
-            {
-                hgl_zero(addr);
-
-                addr.sin_family=AF_INET;
+                addr.sin_addr=addr_list.GetData()[0];
             }
 
             return(true);
@@ -34,26 +27,18 @@ namespace hgl
 
         bool FillAddr(sockaddr_in6 &addr,const char *name,int socktype,int protocol)
         {
+            hgl_zero(addr);
+
+            addr.sin6_family=AF_INET6;
+
             if(name)
             {
-                struct addrinfo hints, *answer;
-
-                hgl_zero(hints);
-                hints.ai_family = AF_INET6;
-                hints.ai_socktype=socktype;
-                hints.ai_protocol=protocol;
+                List<in6_addr> addr_list;
 
-                if (getaddrinfo(name, nullptr, &hints, &answer))         //此函数最低WindowsXP SP2
+                if(GetDNSCache()->Resolve(addr_list,name,socktype,protocol)<=0)
                     RETURN_FALSE;
 
-                memcpy(&addr,answer->ai_addr,sizeof(sockaddr_in6));
-                freeaddrinfo(answer);
-            }
-            else
-            {
-                hgl_zero(addr);
-
-                addr.sin6_family=AF_INET6;
+                addr.sin6_addr=addr_list.GetData()[0];
             }
 
             return(true);
@@ -132,6 +117,16 @@ namespace hgl
             return(count);
         }
 
+        int GetAddrList(List<in_addr> &addr_list,const char *name,int socktype,int protocol)
+        {
+            return GetIPList<AF_INET,in_addr,sockaddr_in>(addr_list,name,socktype,protocol);
+        }
+
+        int GetAddrList(List<in6_addr> &addr_list,const char *name,int socktype,int protocol)
+        {
+            return GetIPList<AF_INET6,in6_addr,sockaddr_in6>(addr_list,name,socktype,protocol);
+        }
+
         /**
          * 返回本机的IP支持情况
          * @return 支持的协议数量
@@ -310,7 +305,7 @@ namespace hgl
         */
         int IPv4Address::GetDomainIPList(List<in_addr> &addr_list,const char *domain,int socktype,int protocol)
         {
-            return GetIPList<AF_INET,in_addr,sockaddr_in>(addr_list,domain,socktype,protocol);
+            return GetDNSCache()->Resolve(addr_list,domain,socktype,protocol);
         }
 
         /**
@@ -338,7 +333,7 @@ namespace hgl
             if(ipa->GetFamily()!=AF_INET)return(false);
             if(ipa->GetProtocol()!=protocol)return(false);
 
-            return (memcmp(&addr,&(((IPv4Address *)ipa)->addr),sizeof(sockaddr_in))==0);
+            return (memcmp(&addr,const_cast<IPAddress *>(ipa)->GetSockAddr(),sizeof(sockaddr_in))==0);         //ipa可能是SocketAddress，不能直接强转取addr
         }
     }//namespace network
 
@@ -400,7 +395,7 @@ namespace hgl
         */
         int IPv6Address::GetDomainIPList(List<in6_addr> &addr_list,const char *domain,int socktype,int protocol)
         {
-            return GetIPList<AF_INET6,in6_addr,sockaddr_in6>(addr_list,domain,socktype,protocol);
+            return GetDNSCache()->Resolve(addr_list,domain,socktype,protocol);
         }
 
         /**
@@ -428,7 +423,185 @@ namespace hgl
             if(ipa->GetFamily()!=AF_INET6)return(false);
             if(ipa->GetProtocol()!=protocol)return(false);
 
-            return (memcmp(&addr,&(((IPv6Address *)ipa)->addr),sizeof(sockaddr_in6))==0);
+            return (memcmp(&addr,const_cast<IPAddress *>(ipa)->GetSockAddr(),sizeof(sockaddr_in6))==0);
+        }
+    }//namespace network
+
+    namespace network
+    {
+        bool SocketAddress::Set(const IPAddress *src)
+        {
+            Clear();
+
+            if(!src)
+                RETURN_FALSE;
+
+            const uint size=src->GetSockAddrInSize();
+
+            if(size>sizeof(sockaddr_storage))
+                RETURN_FALSE;
+
+            memcpy(&addr,const_cast<IPAddress *>(src)->GetSockAddr(),size);
+
+            if(socktype!=src->GetSocketType()||protocol!=src->GetProtocol())
+            {
+                socktype=src->GetSocketType();
+                protocol=src->GetProtocol();
+                RefreshProtocolName();
+            }
+
+            return(true);
+        }
+
+        bool SocketAddress::Set(const char *name,ushort port,int _socktype,int _protocol)
+        {
+            Clear();
+
+            socktype=_socktype;
+            protocol=_protocol;
+            RefreshProtocolName();
+
+            if(CheckIPType(name)==iptV6)
+            {
+                sockaddr_in6 *sa=(sockaddr_in6 *)&addr;
+
+                if(!FillAddr(*sa,name,socktype,protocol))
+                    RETURN_FALSE;
+
+                sa->sin6_port=htons(port);
+            }
+            else
+            {
+                sockaddr_in *sa=(sockaddr_in *)&addr;
+
+                if(!FillAddr(*sa,name,socktype,protocol))
+                    RETURN_FALSE;
+
+                sa->sin_port=htons(port);
+            }
+
+            return(true);
+        }
+
+        void SocketAddress::Set(ushort port)
+        {
+            const int family=(addr.ss_family==AF_INET6?AF_INET6:AF_INET);
+
+            Clear();
+
+            if(family==AF_INET6)
+            {
+                ((sockaddr_in6 *)&addr)->sin6_family=AF_INET6;
+                ((sockaddr_in6 *)&addr)->sin6_port=htons(port);
+            }
+            else
+            {
+                ((sockaddr_in *)&addr)->sin_family=AF_INET;
+                ((sockaddr_in *)&addr)->sin_port=htons(port);
+            }
+        }
+
+        bool SocketAddress::Bind(int ThisSocket,int reuse)const
+        {
+            if(addr.ss_family==AF_INET6)
+                return BindAddr<sockaddr,sockaddr_in6>(ThisSocket,*(const sockaddr_in6 *)&addr,reuse);
+
+            if(addr.ss_family==AF_INET)
+                return BindAddr<sockaddr,sockaddr_in>(ThisSocket,*(const sockaddr_in *)&addr,reuse);
+
+            RETURN_FALSE;
+        }
+
+        bool SocketAddress::GetHostname(AnsiString &name)const
+        {
+            if(!IsValid())
+                RETURN_FALSE;
+
+            return hgl::network::GetHostname(name,(const sockaddr *)&addr);
+        }
+
+        void *SocketAddress::GetIP()
+        {
+            if(addr.ss_family==AF_INET6)
+                return &(((sockaddr_in6 *)&addr)->sin6_addr);
+
+            return &(((sockaddr_in *)&addr)->sin_addr);
+        }
+
+        const ushort SocketAddress::GetPort()const
+        {
+            if(addr.ss_family==AF_INET6)
+                return ((const sockaddr_in6 *)&addr)->sin6_port;
+
+            return ((const sockaddr_in *)&addr)->sin_port;
+        }
+
+        void SocketAddress::ToString(char *out,const int max_size)const
+        {
+            if(!out||max_size<=0)
+                return;
+
+            const char *s=GetString();
+            const int len=hgl_min(int(strlen(s)),max_size-1);
+
+            memcpy(out,s,len);
+            out[len]=0;
+        }
+
+        /**
+         * 取得可视字符串(IPv4为"ip:port"，IPv6为"[ip]:port")<br>
+         * 接入时只复制sockaddr，真正需要打印或记录时才格式化
+         */
+        const char *SocketAddress::GetString()const
+        {
+            if(str[0])
+                return str;
+
+            if(!IsValid())
+                return str;
+
+            char *p=str;
+            const void *ip;
+            ushort port;
+
+            if(addr.ss_family==AF_INET6)
+            {
+                *p++='[';
+                ip  =&(((const sockaddr_in6 *)&addr)->sin6_addr);
+                port=ntohs(((const sockaddr_in6 *)&addr)->sin6_port);
+            }
+            else
+            {
+                ip  =&(((const sockaddr_in *)&addr)->sin_addr);
+                port=ntohs(((const sockaddr_in *)&addr)->sin_port);
+            }
+
+            if(!inet_ntop(addr.ss_family,ip,p,INET6_ADDRSTRLEN))
+            {
+                str[0]=0;
+                return str;
+            }
+
+            p+=strlen(p);
+
+            if(addr.ss_family==AF_INET6)
+                *p++=']';
+
+            *p++=':';
+
+            hgl::utos(p,int(sizeof(str)-(p-str)),port);
+            return str;
+        }
+
+        bool SocketAddress::Comp(const IPAddress *ipa)const
+        {
+            if(this==ipa)return(true);
+            if(!ipa)return(false);
+
+            if(ipa->GetFamily()!=addr.ss_family)return(false);
+            if(ipa->GetProtocol()!=protocol)return(false);
+
+            return (memcmp(&addr,const_cast<IPAddress *>(ipa)->GetSockAddr(),GetSockAddrInSize())==0);
         }
     }//namespace network
 }//namespace hgl
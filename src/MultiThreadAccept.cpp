@@ -1,25 +1,12 @@
 ﻿#include<hgl/network/MultiThreadAccept.h>
 #include<hgl/network/AcceptServer.h>
+#include<hgl/network/CPUAffinity.h>
 #include<hgl/Time.h>
 
 namespace hgl
 {
     namespace network
     {
-        namespace
-        {
-            void PreAlloc(IPAddressStack &ip_stack,ServerSocket *server)
-            {
-                int count=ip_stack.GetCount();
-
-                ip_stack.PreAlloc(count+1024);
-
-                server->CreateIPAddress(ip_stack.GetData()+count,1024);
-
-                ip_stack.SetCount(count+1024);
-            }
-        }//namespace
-
         AcceptThread::AcceptThread(AcceptServer *as,Semaphore *sem)
         {
             server=as;
@@ -28,26 +15,29 @@ namespace hgl
             if(!server)
                 return;
 
-            PreAlloc(ip_stack,server);
+            const IPAddress *server_ip=server->GetServerAddress();
+
+            if(server_ip)
+                client_ip=SocketAddress(server_ip->GetSocketType(),server_ip->GetProtocol());
         }
 
-        bool AcceptThread::Execute()
+        bool AcceptThread::ProcStartThread()
         {
-            if(!server)return(false);
+            if(bind_cpu>=0)
+                BindThreadToCPU(bind_cpu);          //接入的socket由对应的SocketManageThread处理，放在同一个CPU上
 
-            IPAddress *client_ip;
-            int client_sock;
-
-            if(ip_stack.GetCount()<=0)
-                PreAlloc(ip_stack,server);
+            return(true);
+        }
 
-            ip_stack.Pop(client_ip);
+        bool AcceptThread::Execute()
+        {
+            if(!server)return(false);
 
-            client_sock=server->Accept(client_ip);
+            const int client_sock=server->Accept(&client_ip);
 
             if(client_sock<0)
             {
-                ip_stack.Push(client_ip);
+                metrics.fail_count.Add();
                 return(false);
             }
 
@@ -55,8 +45,19 @@ namespace hgl
 
             if(client_sock>0)
             {
+                const double start_time=GetDoubleTime();
+
+                metrics.accept_count.Add();
+
+                SetSocketBlock(client_sock,false);      //在接入线程中设为非阻塞，SocketManage线程加入时不再处理
+
                 if(!OnAccept(client_sock,client_ip))
+                {
+                    metrics.reject_count.Add();
                     CloseSocket(client_sock);
+                }
+
+                metrics.handoff_time.Add(GetDoubleTime()-start_time);
             }
 
             return(true);
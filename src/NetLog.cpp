@@ -0,0 +1,301 @@
+﻿#include<hgl/network/NetLog.h>
+#include<hgl/network/SPSCQueue.h>
+#include<hgl/thread/Thread.h>
+#include<hgl/thread/ThreadMutex.h>
+#include<hgl/type/List.h>
+#include<hgl/log/LogInfo.h>
+#include<hgl/Time.h>
+#include<chrono>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            constexpr double NET_LOG_FLUSH_INTERVAL=0.05;                   ///<后台线程写出的间隔(秒)
+
+            struct NetLogRecord
+            {
+                NetLogSite *site;
+                uint        suppressed;                                     ///<此前被限流丢弃的条数
+                uint        arg_count;
+                int64       args[HGL_NETWORK_LOG_MAX_ARGS];
+            };//struct NetLogRecord
+
+            /**
+             * 一个线程的日志队列，线程退出后由后台线程写完再释放
+             */
+            struct NetLogRing
+            {
+                SPSCQueue<NetLogRecord> queue{HGL_NETWORK_LOG_RING_SIZE};
+                std::atomic<uint>       lost{0};                            ///<队列满丢弃的条数
+                std::atomic<bool>       closed{false};                      ///<所属线程已退出
+            };//struct NetLogRing
+
+            void WriteNetLog(const NetLogRecord &r)
+            {
+                OSString str;
+
+                const os_char *p=r.site->format;
+                const os_char *start=p;
+                uint index=0;
+
+                while(*p)
+                {
+                    if(p[0]=='{'&&p[1]=='}')
+                    {
+                        if(p>start)str+=OSString(start,int(p-start));
+
+                        if(index<r.arg_count)
+                            str+=OSString::numberOf(r.args[index++]);
+
+                        p+=2;
+                        start=p;
+                        continue;
+                    }
+
+                    ++p;
+                }
+
+                if(p>start)str+=OSString(start,int(p-start));
+
+                if(r.suppressed>0)
+                    str+=OS_TEXT(" (")+OSString::numberOf(r.suppressed)+OS_TEXT(" suppressed)");
+
+                switch(r.site->level)
+                {
+                    case NetLogLevel::Info:     LOG_INFO(str);break;
+                    case NetLogLevel::Hint:     LOG_HINT(str);break;
+                    case NetLogLevel::Problem:  LOG_PROBLEM(str);break;
+                    default:                    LOG_ERROR(str);break;
+                }
+            }
+
+            /**
+             * 按调用点限流：每秒最多site->rate条，多出的只计数
+             * @param suppressed 此前被丢弃的条数
+             */
+            bool AcquireSite(NetLogSite *site,uint &suppressed)
+            {
+                suppressed=0;
+
+                if(site->rate>0)
+                {
+                    const int64 sec=std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+                    int64 w=site->window.load(std::memory_order_relaxed);
+
+                    if(w!=sec&&site->window.compare_exchange_strong(w,sec,std::memory_order_relaxed))
+                        site->count.store(0,std::memory_order_relaxed);
+
+                    if(site->count.fetch_add(1,std::memory_order_relaxed)>=site->rate)
+                    {
+                        site->suppressed.fetch_add(1,std::memory_order_relaxed);
+                        return(false);
+                    }
+                }
+
+                if(site->suppressed.load(std::memory_order_relaxed)>0)
+                    suppressed=site->suppressed.exchange(0,std::memory_order_relaxed);
+
+                return(true);
+            }
+        }//namespace
+
+        class NetLogThread;
+
+        /**
+         * 所有线程的日志队列与后台写出线程
+         */
+        class NetLogManage
+        {
+            ThreadMutex lock;
+            List<NetLogRing *> ring_list;
+
+            NetLogThread *thread=nullptr;
+            std::atomic<bool> async{true};                                  ///<StopNetLog后改为同步写出
+
+        public:
+
+            ~NetLogManage();
+
+            const bool IsAsync()const{return async.load(std::memory_order_relaxed);}
+
+            NetLogRing *CreateRing()
+            {
+                NetLogRing *ring=new NetLogRing;
+
+                lock.Lock();
+                ring_list.Add(ring);
+                StartThread();
+                lock.Unlock();
+
+                return ring;
+            }
+
+            void StartThread();
+            void Stop();
+
+            /**
+             * 写出所有队列中的日志，释放所属线程已退出的队列
+             */
+            void Flush()
+            {
+                NetLogRecord r;
+
+                lock.Lock();
+
+                for(int i=ring_list.GetCount()-1;i>=0;i--)
+                {
+                    NetLogRing *ring=ring_list[i];
+
+                    const bool closed=ring->closed.load(std::memory_order_acquire);    //先取标记，之后一定能取完
+
+                    while(ring->queue.Pop(r))
+                        WriteNetLog(r);
+
+                    const uint lost=ring->lost.exchange(0,std::memory_order_relaxed);
+
+                    if(lost>0)
+                        LOG_PROBLEM(OS_TEXT("network log ring full, lost ")+OSString::numberOf(lost)+OS_TEXT(" records."));
+
+                    if(closed)
+                    {
+                        delete ring;
+                        ring_list.Delete(i);
+                    }
+                }
+
+                lock.Unlock();
+            }
+        };//class NetLogManage
+
+        class NetLogThread:public Thread
+        {
+            NetLogManage *manage;
+
+        public:
+
+            NetLogThread(NetLogManage *m){manage=m;}
+
+            bool Execute() override
+            {
+                manage->Flush();
+
+                WaitTime(NET_LOG_FLUSH_INTERVAL);
+                return(true);
+            }
+        };//class NetLogThread:public Thread
+
+        NetLogManage::~NetLogManage()
+        {
+            Stop();
+
+            for(NetLogRing *ring:ring_list)
+                delete ring;
+        }
+
+        /**
+         * 第一个队列创建时启动后台线程(需已加锁)
+         */
+        void NetLogManage::StartThread()
+        {
+            if(thread||!IsAsync())
+                return;
+
+            thread=new NetLogThread(this);
+
+            if(!thread->Start())
+            {
+                delete thread;
+                thread=nullptr;
+                async.store(false);                                         //起不来就同步写出
+            }
+        }
+
+        void NetLogManage::Stop()
+        {
+            async.store(false);
+
+            lock.Lock();
+            NetLogThread *t=thread;
+            thread=nullptr;
+            lock.Unlock();
+
+            if(t)
+            {
+                t->Close();
+                delete t;
+            }
+
+            Flush();
+        }
+
+        namespace
+        {
+            NetLogManage *GetNetLogManage()
+            {
+                static NetLogManage net_log_manage;
+
+                return &net_log_manage;
+            }
+
+            /**
+             * 线程的日志队列，第一次记录日志时创建，线程退出时交给后台线程写完后释放
+             */
+            struct NetLogThreadRing
+            {
+                NetLogRing *ring=nullptr;
+
+                ~NetLogThreadRing()
+                {
+                    if(ring)
+                        ring->closed.store(true,std::memory_order_release);
+                }
+            };//struct NetLogThreadRing
+
+            thread_local NetLogThreadRing thread_ring;
+        }//namespace
+
+        void PostNetLog(NetLogSite *site,const int64 *args,const uint arg_count)
+        {
+            if(!site)return;
+
+            NetLogRecord r;
+
+            if(!AcquireSite(site,r.suppressed))
+                return;
+
+            r.site=site;
+            r.arg_count=(arg_count<HGL_NETWORK_LOG_MAX_ARGS?arg_count:HGL_NETWORK_LOG_MAX_ARGS);
+
+            for(uint i=0;i<r.arg_count;i++)
+                r.args[i]=args[i];
+
+            NetLogManage *manage=GetNetLogManage();
+
+            if(!manage->IsAsync())
+            {
+                WriteNetLog(r);
+                return;
+            }
+
+            if(!thread_ring.ring)
+                thread_ring.ring=manage->CreateRing();
+
+            if(!thread_ring.ring->queue.Push(r))
+                thread_ring.ring->lost.fetch_add(1,std::memory_order_relaxed);
+        }
+
+        void FlushNetLog()
+        {
+            GetNetLogManage()->Flush();
+        }
+
+        void StopNetLog()
+        {
+            GetNetLogManage()->Stop();
+        }
+    }//namespace network
+}//namespace hgl
@@ -0,0 +1,142 @@
+﻿#include<hgl/network/NetworkMetrics.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            constexpr uint64 HGL_MICRO_SEC_PER_SEC=1000000;
+        }//namespace
+
+        /**
+         * 取得百分位数，按所在格子的上限估算
+         * @param p 百分比(0-1)
+         * @return 耗时(秒)
+         */
+        double LatencyHistogramSnapshot::GetPercentile(const double p)const
+        {
+            if(count<=0)return(0);
+
+            const uint64 target=uint64(double(count)*(p<0?0:p>1?1:p));
+
+            uint64 sum=0;
+
+            for(uint i=0;i<HGL_LATENCY_HISTOGRAM_BUCKETS;i++)
+            {
+                sum+=bucket[i];
+
+                if(sum>=target&&sum>0)
+                    return double(uint64(1)<<i)/HGL_MICRO_SEC_PER_SEC;
+            }
+
+            return double(uint64(1)<<(HGL_LATENCY_HISTOGRAM_BUCKETS-1))/HGL_MICRO_SEC_PER_SEC;
+        }
+
+        void LatencyHistogramSnapshot::Merge(const LatencyHistogramSnapshot &lhs)
+        {
+            for(uint i=0;i<HGL_LATENCY_HISTOGRAM_BUCKETS;i++)
+                bucket[i]+=lhs.bucket[i];
+
+            count+=lhs.count;
+            total_us+=lhs.total_us;
+        }
+
+        void LatencyHistogram::Add(const double seconds)
+        {
+            const uint64 us=(seconds>0?uint64(seconds*HGL_MICRO_SEC_PER_SEC):0);
+
+            uint index=0;
+
+            while(index<HGL_LATENCY_HISTOGRAM_BUCKETS-1&&(uint64(1)<<index)<=us)    //第i格的上限为2^i微秒
+                ++index;
+
+            bucket[index].Add();
+            count.Add();
+            total_us.Add(us);
+        }
+
+        void LatencyHistogram::GetSnapshot(LatencyHistogramSnapshot &lhs)const
+        {
+            for(uint i=0;i<HGL_LATENCY_HISTOGRAM_BUCKETS;i++)
+                lhs.bucket[i]=bucket[i].Get();
+
+            lhs.count=count.Get();
+            lhs.total_us=total_us.Get();
+        }
+
+        void SocketManageMetricsSnapshot::Merge(const SocketManageMetricsSnapshot &sm)
+        {
+            update_count        +=sm.update_count;
+            event_count         +=sm.event_count;
+            max_event_per_update =hgl_max(max_event_per_update,sm.max_event_per_update);
+
+            recv_event_count    +=sm.recv_event_count;
+            recv_bytes          +=sm.recv_bytes;
+
+            send_call_count     +=sm.send_call_count;
+            send_bytes          +=sm.send_bytes;
+            send_queued_bytes   +=sm.send_queued_bytes;
+            send_watch_count    +=sm.send_watch_count;
+
+            accept_count        +=sm.accept_count;
+            error_count         +=sm.error_count;
+            timer_count         +=sm.timer_count;
+            connection_count    +=sm.connection_count;
+
+            dispatch_time.Merge(sm.dispatch_time);
+            recv_latency.Merge(sm.recv_latency);
+            reply_latency.Merge(sm.reply_latency);
+
+            tcp_info_count      +=sm.tcp_info_count;
+            retrans_count       +=sm.retrans_count;
+            rtt.Merge(sm.rtt);
+        }
+
+        void SocketManageMetrics::GetSnapshot(SocketManageMetricsSnapshot &sm)const
+        {
+            sm.update_count         =update_count.Get();
+            sm.event_count          =event_count.Get();
+            sm.max_event_per_update =max_event_per_update.Get();
+
+            sm.recv_event_count     =recv_event_count.Get();
+            sm.recv_bytes           =recv_bytes.Get();
+
+            sm.send_call_count      =send_call_count.Get();
+            sm.send_bytes           =send_bytes.Get();
+            sm.send_queued_bytes    =send_queued_bytes.Get();
+            sm.send_watch_count     =send_watch_count.Get();
+
+            sm.accept_count         =accept_count.Get();
+            sm.error_count          =error_count.Get();
+            sm.timer_count          =timer_count.Get();
+            sm.connection_count     =connection_count.Get();
+
+            dispatch_time.GetSnapshot(sm.dispatch_time);
+            recv_latency.GetSnapshot(sm.recv_latency);
+            reply_latency.GetSnapshot(sm.reply_latency);
+
+            sm.tcp_info_count       =tcp_info_count.Get();
+            sm.retrans_count        =retrans_count.Get();
+            rtt.GetSnapshot(sm.rtt);
+        }
+
+        void AcceptMetricsSnapshot::Merge(const AcceptMetricsSnapshot &am)
+        {
+            accept_count    +=am.accept_count;
+            fail_count      +=am.fail_count;
+            reject_count    +=am.reject_count;
+
+            handoff_time.Merge(am.handoff_time);
+        }
+
+        void AcceptMetrics::GetSnapshot(AcceptMetricsSnapshot &am)const
+        {
+            am.accept_count =accept_count.Get();
+            am.fail_count   =fail_count.Get();
+            am.reject_count =reject_count.Get();
+
+            handoff_time.GetSnapshot(am.handoff_time);
+        }
+    }//namespace network
+}//namespace hgl
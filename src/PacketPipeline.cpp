@@ -0,0 +1,203 @@
+﻿#include<hgl/network/PacketPipeline.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            void FreeMessageList(List<PipeMessage> &ml)
+            {
+                const int count=ml.GetCount();
+                PipeMessage *msg=ml.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    delete[] msg->data;
+                    ++msg;
+                }
+
+                ml.Clear();
+            }
+
+            /**
+             * 将溢出列表中的消息尽可能压入队列
+             * @return 是否全部压入
+             */
+            bool FlushOverflow(SPSCQueue<PipeMessage> &queue,List<PipeMessage> &ml)
+            {
+                const int count=ml.GetCount();
+
+                if(count<=0)
+                    return(true);
+
+                PipeMessage *msg=ml.GetData();
+                int n=0;
+
+                while(n<count)
+                {
+                    if(!queue.Push(*msg))
+                        break;
+
+                    ++msg;
+                    ++n;
+                }
+
+                if(n<count)
+                    memmove(ml.GetData(),ml.GetData()+n,(count-n)*sizeof(PipeMessage));
+
+                ml.SetCount(count-n);
+                return(n==count);
+            }
+        }//namespace
+
+        PacketPipeline::PacketPipeline(SocketManage *sm,uint queue_size):inbound(queue_size),outbound(queue_size)
+        {
+            io_manage=sm;
+
+            inbound_posted=false;
+            outbound_posted=false;
+        }
+
+        PacketPipeline::~PacketPipeline()
+        {
+            PipeMessage msg;
+
+            while(inbound.Pop(msg))
+                delete[] msg.data;
+
+            while(outbound.Pop(msg))
+                delete[] msg.data;
+
+            FreeMessageList(inbound_overflow);
+            FreeMessageList(outbound_overflow);
+        }
+
+        void PacketPipeline::PostInbound(const PipeMessage &msg)
+        {
+            if(inbound_overflow.GetCount()>0                        //保证顺序，有溢出的就只能排在后面
+             ||!inbound.Push(msg))
+                inbound_overflow.Add(msg);
+
+            inbound_posted=true;
+        }
+
+        void PacketPipeline::FlushInbound()
+        {
+            FlushOverflow(inbound,inbound_overflow);
+
+            if(!inbound_posted)
+                return;
+
+            inbound_posted=false;
+            logic_sem.Post();
+        }
+
+        bool PacketPipeline::PopOutbound(PipeMessage &msg)
+        {
+            return outbound.Pop(msg);
+        }
+
+        void PacketPipeline::PostOutbound(const PipeMessage &msg)
+        {
+            if(outbound_overflow.GetCount()>0
+             ||!outbound.Push(msg))
+                outbound_overflow.Add(msg);
+
+            outbound_posted=true;
+        }
+
+        void PacketPipeline::FlushOutbound()
+        {
+            FlushOverflow(outbound,outbound_overflow);
+
+            if(!outbound_posted)
+                return;
+
+            outbound_posted=false;
+            io_manage->Wake();
+        }
+
+        bool PacketPipeline::PopInbound(PipeMessage &msg)
+        {
+            return inbound.Pop(msg);
+        }
+
+        bool PacketPipeline::WaitInbound(const double &time_out)
+        {
+            if(!inbound.IsEmpty())
+                return(true);
+
+            return logic_sem.Acquire(time_out);
+        }
+
+        bool PipelineAccept::UseSocket(int sock,const IPAddress *addr)
+        {
+            if(!TCPAcceptPacket::UseSocket(sock,addr))
+                RETURN_FALSE;
+
+            pipe_closing=false;
+            return(true);
+        }
+
+        bool PipelineAccept::OnRecvPacket(void *data,const PACKET_SIZE_TYPE &size)
+        {
+            if(!pipeline||pipe_closing)
+                return(false);
+
+            PipeMessage msg;
+
+            msg.type=PipeMessageType::Packet;
+            msg.accept=this;
+            msg.data=new uchar[size];
+            msg.size=size;
+
+            memcpy(msg.data,data,size);
+
+            pipeline->PostInbound(msg);
+            return(true);
+        }
+
+        bool PipelineAccept::PostPacket(const void *data,const PACKET_SIZE_TYPE &size)
+        {
+            if(!pipeline||!data)
+                return(false);
+
+            PipeMessage msg;
+
+            msg.type=PipeMessageType::Packet;
+            msg.accept=this;
+            msg.data=new uchar[size];
+            msg.size=size;
+
+            memcpy(msg.data,data,size);
+
+            pipeline->PostOutbound(msg);
+            return(true);
+        }
+
+        bool PipelineLogicThread::Execute()
+        {
+            pipeline->WaitInbound(wait_time);
+
+            PipeMessage msg;
+
+            while(pipeline->PopInbound(msg))
+            {
+                if(msg.type==PipeMessageType::Packet)
+                {
+                    msg.accept->OnLogicPacket(msg.data,msg.size);
+                    delete[] msg.data;
+                }
+                else
+                {
+                    msg.accept->OnLogicClose();
+                    pipeline->PostOutbound(msg);            //应答IO线程，之后本线程不会再引用该连接
+                }
+            }
+
+            pipeline->FlushOutbound();
+            return(true);
+        }
+    }//namespace network
+}//namespace hgl
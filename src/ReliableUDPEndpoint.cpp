@@ -0,0 +1,264 @@
+﻿#include<hgl/network/ReliableUDP.h>
+#include<hgl/log/LogInfo.h>
+#include<hgl/Time.h>
+#include"ReliableUDPProtocol.h"
+
+namespace hgl
+{
+    namespace network
+    {
+        RUDPEndpoint::RUDPEndpoint()
+        {
+            start_time=GetDoubleTime();
+            send_count=0;
+
+            for(UDPPacket &pk:recv_list)
+                pk.addr=nullptr;
+        }
+
+        RUDPEndpoint::~RUDPEndpoint()
+        {
+            for(RUDPSession *s:session_list)
+                delete s;
+
+            for(UDPPacket &pk:recv_list)
+                SAFE_CLEAR(pk.addr);
+        }
+
+        const uint32 RUDPEndpoint::GetTime(const double t)const
+        {
+            return uint32((t-start_time)*HGL_MILLI_SEC_PRE_SEC);
+        }
+
+        bool RUDPEndpoint::Create(const IPAddress *addr)
+        {
+            if(!UDPSocket::Create(addr))
+                RETURN_FALSE;
+
+            recv_buffer.SetCount(HGL_UDP_BATCH_COUNT*HGL_RUDP_MAX_MTU);
+            send_buffer.SetCount(HGL_UDP_BATCH_COUNT*HGL_RUDP_MAX_MTU);
+
+            uint8 *p=recv_buffer.data();
+
+            for(UDPPacket &pk:recv_list)
+            {
+                SAFE_CLEAR(pk.addr);
+
+                pk.data=p;
+                pk.size=HGL_RUDP_MAX_MTU;
+                pk.addr=GetBindAddr()->Create();
+
+                p+=HGL_RUDP_MAX_MTU;
+            }
+
+            return(true);
+        }
+
+        void RUDPEndpoint::SetConfig(const RUDPConfig &cfg)
+        {
+            config=cfg;
+        }
+
+        RUDPSession *RUDPEndpoint::GetSession(uint32 conv)const
+        {
+            RUDPSession *s;
+
+            if(!session_map.Get(conv,s))
+                return(nullptr);
+
+            return s;
+        }
+
+        bool RUDPEndpoint::Connect(RUDPSession *s,uint32 conv,const IPAddress *addr)
+        {
+            if(!s||!addr||ThisSocket==-1)RETURN_FALSE;
+
+            if(session_map.ContainsKey(conv))
+            {
+                LOG_ERROR(OS_TEXT("RUDPEndpoint::Connect() repeat conv:")+OSString::numberOf(conv));
+                return(false);
+            }
+
+            s->Attach(this,conv,addr,config,GetTime(GetDoubleTime()));
+
+            session_map.Add(conv,s);
+            session_list.Add(s);
+            return(true);
+        }
+
+        /**
+         * 取得一个数据报的写入空间，批量发送列表满了时先发出
+         */
+        uint8 *RUDPEndpoint::BeginDatagram()
+        {
+            if(uint(send_count)>=HGL_UDP_BATCH_COUNT)
+                FlushDatagram();
+
+            return send_buffer.data()+send_count*HGL_RUDP_MAX_MTU;
+        }
+
+        void RUDPEndpoint::EndDatagram(uint8 *buf,uint size,IPAddress *addr)
+        {
+            UDPPacket &pk=send_list[send_count];
+
+            pk.data=buf;
+            pk.size=size;
+            pk.addr=addr;
+            pk.result=0;
+
+            ++send_count;
+        }
+
+        /**
+         * 用一次SendPackets发出所有数据报，发送缓冲区满时直接丢弃(由重传负责)
+         */
+        void RUDPEndpoint::FlushDatagram()
+        {
+            int sent=0;
+
+            while(sent<send_count)
+            {
+                const int result=SendPackets(send_list+sent,send_count-sent);
+
+                if(result<=0)
+                    break;
+
+                sent+=result;
+            }
+
+            send_count=0;
+        }
+
+        /**
+         * 处理一个收到的数据报
+         */
+        void RUDPEndpoint::Input(UDPPacket &pk,uint32 now)
+        {
+            if(pk.result<int(HGL_RUDP_HEADER_SIZE))
+                return;
+
+            const uint8 *p=(const uint8 *)pk.data;
+            const uint32 conv=RUDPHeader::ReadU32(p);
+
+            RUDPSession *s;
+
+            if(!session_map.Get(conv,s))
+            {
+                if(p[4]!=RUDP_CMD_ORDERED&&p[4]!=RUDP_CMD_UNORDERED)        //只有数据才能建立新会话
+                    return;
+
+                s=CreateSession(conv,pk.addr);
+
+                if(!s)return;
+
+                s->Attach(this,conv,pk.addr,config,now);
+
+                session_map.Add(conv,s);
+                session_list.Add(s);
+            }
+            else
+            if(s->closed)
+            {
+                return;
+            }
+            else
+            if(!s->address->Comp(pk.addr))                                  //对方地址变了(NAT重绑定或切换网络)
+            {
+                SAFE_CLEAR(s->address);
+                s->address=pk.addr->CreateCopy();
+            }
+
+            if(!s->Input(p,pk.result,now))
+                LOG_INFO(OS_TEXT("RUDPEndpoint recv bad datagram,conv:")+OSString::numberOf(conv)+OS_TEXT(",size:")+OSString::numberOf(pk.result));
+
+            s->input_pending=true;
+        }
+
+        /**
+         * 接收一批数据报并分发，处理完这一批再统一Flush，同一会话的ACK合并发出
+         * @return 本次收到的数据报数量，0表示已经没有数据，<0表示出错
+         */
+        int RUDPEndpoint::ProcRecv(int)
+        {
+            for(UDPPacket &pk:recv_list)
+                pk.size=HGL_RUDP_MAX_MTU;
+
+            const int count=RecvPackets(recv_list,HGL_UDP_BATCH_COUNT);
+
+            if(count<=0)
+                return count;
+
+            const uint32 now=GetTime(GetDoubleTime());
+
+            for(int i=0;i<count;i++)
+                Input(recv_list[i],now);
+
+            for(RUDPSession *s:session_list)
+            {
+                if(!s->input_pending)
+                    continue;
+
+                s->input_pending=false;
+                s->Flush(now);
+            }
+
+            FlushDatagram();
+            return count;
+        }
+
+        /**
+         * 移除已关闭的会话
+         */
+        void RUDPEndpoint::RemoveClosed()
+        {
+            int count=session_list.GetCount();
+            RUDPSession **sp=session_list.GetData();
+
+            for(int i=0;i<count;)
+            {
+                if(!sp[i]->closed)
+                {
+                    ++i;
+                    continue;
+                }
+
+                session_map.DeleteByKey(sp[i]->conv);
+                delete sp[i];
+
+                session_list.Delete(i);                                     //与最后一项交换，当前位置需要再检查一次
+                --count;
+            }
+        }
+
+        double RUDPEndpoint::ProcUpdate(const double cur_time)
+        {
+            const uint32 now=GetTime(cur_time);
+
+            bool has_closed=false;
+            uint32 wait=RUDP_IDLE_WAIT_TIME;
+
+            for(RUDPSession *s:session_list)
+            {
+                s->Update(now);
+
+                if(s->closed)
+                {
+                    has_closed=true;
+                    continue;
+                }
+
+                wait=hgl_min(wait,s->GetWaitTime(now));
+            }
+
+            FlushDatagram();                                                //关闭通知也要在删除会话前发出
+
+            if(has_closed)
+                RemoveClosed();
+
+            if(session_list.IsEmpty())
+                return(-1);
+
+            return double(wait)/HGL_MILLI_SEC_PRE_SEC;
+        }
+    }//namespace network
+}//namespace hgl
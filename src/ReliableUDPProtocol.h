@@ -0,0 +1,105 @@
+﻿#ifndef HGL_NETWORK_RELIABLE_UDP_PROTOCOL_INCLUDE
+#define HGL_NETWORK_RELIABLE_UDP_PROTOCOL_INCLUDE
+
+#include<hgl/network/ReliableUDP.h>
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 分段命令
+         */
+        constexpr uint8 RUDP_CMD_ORDERED    =1;                                 ///<有序数据
+        constexpr uint8 RUDP_CMD_UNORDERED  =2;                                 ///<无序数据(仍然可靠)
+        constexpr uint8 RUDP_CMD_ACK        =3;                                 ///<确认一个分段(ts为被确认分段的发送时间)
+        constexpr uint8 RUDP_CMD_PING       =4;                                 ///<心跳/窗口探测，对方需回复PONG
+        constexpr uint8 RUDP_CMD_PONG       =5;
+        constexpr uint8 RUDP_CMD_CLOSE      =6;                                 ///<关闭会话
+
+        constexpr uint32 RUDP_INITIAL_RTO   =200;                               ///<还没有RTT样本时的重传超时(毫秒)
+        constexpr double RUDP_INITIAL_CWND  =4;                                 ///<初始拥塞窗口(分段数)
+        constexpr double RUDP_MIN_SSTHRESH  =2;
+        constexpr double RUDP_PACING_GAIN   =1.25;                              ///<速率略高于窗口/RTT，让窗口有机会增长
+        constexpr double RUDP_PACING_BURST  =4;                                 ///<允许的最小突发(数据报数)
+        constexpr int32  RUDP_IDLE_WAIT_TIME=1000;                              ///<不使用心跳时空闲会话的检查间隔(毫秒)
+
+        inline int32 SeqDiff(uint32 a,uint32 b){return int32(a-b);}             ///<序号/时间比较(允许回绕)
+
+        /**
+         * 分段头，固定为小端字节序<br>
+         * conv(4) cmd(1) frg(1) wnd(2) ts(4) sn(4) una(4) len(2)
+         */
+        struct RUDPHeader
+        {
+            uint32 conv;
+            uint8  cmd;
+            uint8  frg;                                                         ///<有序消息剩余分段数(0表示最后一段)
+            uint16 wnd;                                                         ///<发送方剩余接收窗口
+            uint32 ts;                                                          ///<发送时间(ACK时为被确认分段的发送时间)
+            uint32 sn;                                                          ///<序号
+            uint32 una;                                                         ///<发送方下一个等待的序号(之前的都已收到)
+            uint16 len;                                                         ///<数据长度
+
+        public:
+
+            void Set(uint32 c,uint8 cm,uint16 w,uint32 s,uint32 u,uint32 t=0,uint8 f=0,uint16 l=0)
+            {
+                conv=c;cmd=cm;frg=f;wnd=w;ts=t;sn=s;una=u;len=l;
+            }
+
+            static void WriteU16(uint8 *p,uint16 v){p[0]=uint8(v);p[1]=uint8(v>>8);}
+            static void WriteU32(uint8 *p,uint32 v){p[0]=uint8(v);p[1]=uint8(v>>8);p[2]=uint8(v>>16);p[3]=uint8(v>>24);}
+
+            static uint16 ReadU16(const uint8 *p){return uint16(p[0]|(p[1]<<8));}
+            static uint32 ReadU32(const uint8 *p){return uint32(p[0])|(uint32(p[1])<<8)|(uint32(p[2])<<16)|(uint32(p[3])<<24);}
+
+            void Write(uint8 *p)const
+            {
+                WriteU32(p,conv);
+                p[4]=cmd;
+                p[5]=frg;
+                WriteU16(p+6,wnd);
+                WriteU32(p+8,ts);
+                WriteU32(p+12,sn);
+                WriteU32(p+16,una);
+                WriteU16(p+20,len);
+            }
+
+            void Read(const uint8 *p)
+            {
+                conv=ReadU32(p);
+                cmd =p[4];
+                frg =p[5];
+                wnd =ReadU16(p+6);
+                ts  =ReadU32(p+8);
+                sn  =ReadU32(p+12);
+                una =ReadU32(p+16);
+                len =ReadU16(p+20);
+            }
+        };//struct RUDPHeader
+
+        static_assert(HGL_RUDP_HEADER_SIZE==22,"RUDPHeader::Write/Read assume a 22 byte header");
+
+        /**
+         * 一个数据分段
+         */
+        struct RUDPSegment
+        {
+            uint32 sn       =0;
+            uint32 ts       =0;                                                 ///<最近一次发送时间
+            uint32 resend_ts=0;                                                 ///<超时重传时间
+            uint32 rto      =0;
+
+            uint8  cmd      =RUDP_CMD_ORDERED;
+            uint8  frg      =0;
+
+            uint   xmit     =0;                                                 ///<发送次数
+            uint   fastack  =0;                                                 ///<被更大序号的ACK跨过的次数
+
+            bool   delivered=false;                                             ///<接收方:无序数据已交付，只占用序号
+
+            DataArray<uint8> data;
+        };//struct RUDPSegment
+    }//namespace network
+}//namespace hgl
+#endif//HGL_NETWORK_RELIABLE_UDP_PROTOCOL_INCLUDE
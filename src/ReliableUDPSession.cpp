@@ -0,0 +1,737 @@
+﻿#include<hgl/network/ReliableUDP.h>
+#include<hgl/log/LogInfo.h>
+#include<hgl/Time.h>
+#include"ReliableUDPProtocol.h"
+
+namespace hgl
+{
+    namespace network
+    {
+        RUDPSession::~RUDPSession()
+        {
+            FreeList(snd_queue);
+            FreeList(snd_buf);
+            FreeList(rcv_buf);
+            FreeList(free_list);
+
+            SAFE_CLEAR(address);
+        }
+
+        RUDPSegment *RUDPSession::AllocSegment()
+        {
+            const int count=free_list.GetCount();
+
+            if(count<=0)
+                return(new RUDPSegment);
+
+            RUDPSegment *seg=free_list.GetData()[count-1];
+
+            free_list.SetCount(count-1);
+            return seg;
+        }
+
+        void RUDPSession::FreeSegment(RUDPSegment *seg)
+        {
+            if(free_list.GetCount()>=int(config.send_window))               //保留的数量不超过一个窗口
+            {
+                delete seg;
+                return;
+            }
+
+            seg->data.Clear();                                              //保留已分配的空间
+            free_list.Add(seg);
+        }
+
+        void RUDPSession::FreeList(List<RUDPSegment *> &sl)
+        {
+            for(RUDPSegment *seg:sl)
+                delete seg;
+
+            sl.Clear();
+        }
+
+        void RUDPSession::Attach(RUDPEndpoint *ep,uint32 c,const IPAddress *addr,const RUDPConfig &cfg,uint32 now)
+        {
+            endpoint=ep;
+            conv=c;
+
+            SAFE_CLEAR(address);
+            address=addr->CreateCopy();
+
+            config=cfg;
+
+            if(config.mtu>HGL_RUDP_MAX_MTU)config.mtu=HGL_RUDP_MAX_MTU;
+            if(config.mtu<HGL_RUDP_HEADER_SIZE*2)config.mtu=HGL_RUDP_HEADER_SIZE*2;
+            if(config.recv_window<HGL_RUDP_MAX_FRAGMENT)config.recv_window=HGL_RUDP_MAX_FRAGMENT;       //否则最大的消息永远收不全
+            if(config.send_window<1)config.send_window=1;
+            if(config.recv_window>0xFFFF)config.recv_window=0xFFFF;          //窗口在包头中只有16位
+            if(config.interval<1)config.interval=1;
+
+            mss=config.mtu-HGL_RUDP_HEADER_SIZE;
+
+            rmt_wnd=config.recv_window;                                     //假定对方与自己相同，收到对方数据后更新
+            rto=RUDP_INITIAL_RTO;
+
+            cwnd=RUDP_INITIAL_CWND;
+            ssthresh=config.send_window;
+
+            pacing_tokens=config.mtu*RUDP_PACING_BURST;
+            pacing_time=now;
+
+            last_recv_time=now;
+            last_ack_time=now;
+            last_send_time=now;
+            next_flush_time=now;
+        }
+
+        /**
+         * RFC6298的RTT估算
+         */
+        void RUDPSession::UpdateRTT(int32 rtt)
+        {
+            if(rtt<0)return;
+
+            if(srtt==0)
+            {
+                srtt=rtt;
+                rttvar=rtt/2;
+            }
+            else
+            {
+                const int32 delta=rtt>srtt?rtt-srtt:srtt-rtt;
+
+                rttvar=(3*rttvar+delta)/4;
+                srtt=(7*srtt+rtt)/8;
+
+                if(srtt<1)srtt=1;
+            }
+
+            const uint32 r=srtt+hgl_max<int32>(int32(config.interval),4*rttvar);
+
+            rto=hgl_min<uint32>(hgl_max<uint32>(r,config.min_rto),config.max_rto);
+        }
+
+        /**
+         * 累计确认，una之前的分段都已收到
+         * @return 本次确认的分段数
+         */
+        int RUDPSession::ParseUna(uint32 una)
+        {
+            int count=0;
+
+            for(RUDPSegment *seg:snd_buf)
+            {
+                if(SeqDiff(una,seg->sn)<=0)
+                    break;
+
+                FreeSegment(seg);
+                ++count;
+            }
+
+            if(count<=0)
+                return(0);
+
+            RUDPSegment **sp=snd_buf.GetData();
+
+            memmove(sp,sp+count,(snd_buf.GetCount()-count)*sizeof(RUDPSegment *));
+            snd_buf.SetCount(snd_buf.GetCount()-count);
+            return count;
+        }
+
+        /**
+         * 单个分段的选择确认
+         * @return 本次确认的分段数(0或1)
+         */
+        int RUDPSession::ParseAck(uint32 sn)
+        {
+            if(SeqDiff(sn,snd_una)<0||SeqDiff(sn,snd_nxt)>=0)
+                return(0);
+
+            const int count=snd_buf.GetCount();
+            RUDPSegment **sp=snd_buf.GetData();
+
+            for(int i=0;i<count;i++)
+            {
+                const int32 diff=SeqDiff(sn,sp[i]->sn);
+
+                if(diff<0)break;
+                if(diff>0)continue;
+
+                FreeSegment(sp[i]);
+                snd_buf.DeleteMove(i);
+                return(1);
+            }
+
+            return(0);
+        }
+
+        /**
+         * 被更大序号的ACK跨过的分段计数，达到fast_resend次时在Flush中立即重传
+         */
+        void RUDPSession::ParseFastAck(uint32 max_ack)
+        {
+            if(SeqDiff(max_ack,snd_una)<0||SeqDiff(max_ack,snd_nxt)>=0)
+                return;
+
+            for(RUDPSegment *seg:snd_buf)
+            {
+                if(SeqDiff(max_ack,seg->sn)<=0)
+                    break;
+
+                ++seg->fastack;
+            }
+        }
+
+        bool RUDPSession::Deliver(const uint8 *data,uint size)
+        {
+            if(closed)return(false);
+
+            if(!OnRecvPacket((void *)data,size))
+            {
+                Close();
+                return(false);
+            }
+
+            return(true);
+        }
+
+        /**
+         * 收到一个数据分段
+         * @return 是否缓存了该分段(false表示重复或已直接交付)
+         */
+        bool RUDPSession::ParseData(uint8 cmd,uint8 frg,uint32 sn,const uint8 *data,uint size)
+        {
+            ++stats.recv_segments;
+
+            //正好是下一个且是完整的一条消息，直接从数据报交付，不需要复制
+            if(sn==rcv_nxt&&frg==0&&message.GetCount()==0)
+            {
+                ++rcv_nxt;
+                Deliver(data,size);
+                DeliverOrdered();
+                return(false);
+            }
+
+            const int count=rcv_buf.GetCount();
+            RUDPSegment **sp=rcv_buf.GetData();
+
+            int pos=count;
+
+            while(pos>0&&SeqDiff(sp[pos-1]->sn,sn)>0)                       //通常是追加在最后，所以从后往前找
+                --pos;
+
+            if(pos>0&&sp[pos-1]->sn==sn)
+            {
+                ++stats.dup_segments;
+                return(false);
+            }
+
+            RUDPSegment *seg=AllocSegment();
+
+            seg->sn=sn;
+            seg->cmd=cmd;
+            seg->frg=frg;
+            seg->delivered=false;
+
+            if(cmd==RUDP_CMD_UNORDERED)                                     //无序消息直接交付，只留下序号占位
+            {
+                seg->data.Clear();
+                seg->delivered=true;
+            }
+            else
+            {
+                seg->data.SetCount(size);
+                memcpy(seg->data.data(),data,size);
+            }
+
+            rcv_buf.Add(seg);
+            sp=rcv_buf.GetData();
+
+            if(pos<count)
+            {
+                memmove(sp+pos+1,sp+pos,(count-pos)*sizeof(RUDPSegment *));
+                sp[pos]=seg;
+            }
+
+            if(cmd==RUDP_CMD_UNORDERED)
+                Deliver(data,size);
+
+            DeliverOrdered();
+            return(true);
+        }
+
+        /**
+         * 将rcv_buf中连续的分段按序重组交付
+         */
+        void RUDPSession::DeliverOrdered()
+        {
+            int count=0;
+
+            for(RUDPSegment *seg:rcv_buf)
+            {
+                if(seg->sn!=rcv_nxt)
+                    break;
+
+                ++rcv_nxt;
+                ++count;
+
+                if(seg->delivered)
+                    continue;
+
+                if(seg->frg==0&&message.GetCount()==0)
+                {
+                    Deliver(seg->data.data(),seg->data.GetCount());
+                    continue;
+                }
+
+                const size_t offset=message.GetCount();
+
+                message.SetCount(offset+seg->data.GetCount());
+                memcpy(message.data()+offset,seg->data.data(),seg->data.GetCount());
+
+                if(seg->frg==0)
+                {
+                    Deliver(message.data(),message.GetCount());
+                    message.Clear();
+                }
+            }
+
+            if(count<=0)
+                return;
+
+            RUDPSegment **sp=rcv_buf.GetData();
+
+            for(int i=0;i<count;i++)
+                FreeSegment(sp[i]);
+
+            memmove(sp,sp+count,(rcv_buf.GetCount()-count)*sizeof(RUDPSegment *));
+            rcv_buf.SetCount(rcv_buf.GetCount()-count);
+        }
+
+        /**
+         * 处理属于本会话的一个数据报，其中可以有多个分段
+         * @return 数据报格式是否正确
+         */
+        bool RUDPSession::Input(const uint8 *p,uint size,uint32 now)
+        {
+            int acked=0;
+
+            bool has_ack=false;
+            uint32 max_ack=0;
+
+            ++stats.recv_datagrams;
+
+            while(size>=HGL_RUDP_HEADER_SIZE)
+            {
+                RUDPHeader h;
+
+                h.Read(p);
+
+                p+=HGL_RUDP_HEADER_SIZE;
+                size-=HGL_RUDP_HEADER_SIZE;
+
+                if(h.conv!=conv||h.len>size)
+                    return(false);
+
+                rmt_wnd=h.wnd;
+
+                acked+=ParseUna(h.una);
+
+                if(h.cmd==RUDP_CMD_ACK)
+                {
+                    if(SeqDiff(now,h.ts)>=0)
+                        UpdateRTT(SeqDiff(now,h.ts));
+
+                    acked+=ParseAck(h.sn);
+
+                    if(!has_ack||SeqDiff(h.sn,max_ack)>0)
+                    {
+                        max_ack=h.sn;
+                        has_ack=true;
+                    }
+                }
+                else
+                if(h.cmd==RUDP_CMD_ORDERED||h.cmd==RUDP_CMD_UNORDERED)
+                {
+                    if(SeqDiff(h.sn,rcv_nxt+config.recv_window)<0)              //超出接收窗口的不确认，由对方重传
+                    {
+                        ack_list.Add({h.sn,h.ts});
+
+                        if(SeqDiff(h.sn,rcv_nxt)>=0)
+                            ParseData(h.cmd,h.frg,h.sn,p,h.len);
+                        else
+                            ++stats.dup_segments;                               //ACK丢了，对方在重传
+                    }
+                }
+                else
+                if(h.cmd==RUDP_CMD_PING)
+                {
+                    send_pong=true;
+                }
+                else
+                if(h.cmd==RUDP_CMD_CLOSE)
+                {
+                    if(!closed)
+                    {
+                        closed=true;
+                        OnClose();
+                    }
+                }
+                else
+                if(h.cmd!=RUDP_CMD_PONG)
+                    return(false);
+
+                p+=h.len;
+                size-=h.len;
+            }
+
+            last_recv_time=now;
+
+            if(!snd_buf.IsEmpty())
+                snd_una=snd_buf.GetData()[0]->sn;
+            else
+                snd_una=snd_nxt;
+
+            if(has_ack)
+                ParseFastAck(max_ack);
+
+            if(acked>0)
+                last_ack_time=now;
+
+            if(config.congestion&&acked>0)                                 //有新的数据被确认(含选择确认)
+            {
+                if(cwnd<ssthresh)
+                    cwnd+=acked;                                            //慢启动
+                else
+                    cwnd+=acked/cwnd;                                       //拥塞避免，每个RTT加1
+
+                if(cwnd>config.send_window)
+                    cwnd=config.send_window;
+            }
+
+            return(size==0);
+        }
+
+        bool RUDPSession::Send(const void *data,uint size,bool ordered)
+        {
+            if(closed||!endpoint||!data)
+                return(false);
+
+            if(!ordered&&size>mss)
+                return(false);
+
+            const uint count=size==0?1:(size+mss-1)/mss;
+
+            if(count>HGL_RUDP_MAX_FRAGMENT)
+                return(false);
+
+            const uint8 *p=(const uint8 *)data;
+
+            for(uint i=0;i<count;i++)
+            {
+                const uint len=hgl_min(size,mss);
+
+                RUDPSegment *seg=AllocSegment();
+
+                seg->cmd=ordered?RUDP_CMD_ORDERED:RUDP_CMD_UNORDERED;
+                seg->frg=uint8(count-i-1);                                  //倒数，0表示最后一段
+                seg->xmit=0;
+                seg->fastack=0;
+                seg->delivered=false;
+
+                seg->data.SetCount(len);
+                memcpy(seg->data.data(),p,len);
+
+                snd_queue.Add(seg);
+
+                p+=len;
+                size-=len;
+            }
+
+            return(true);
+        }
+
+        void RUDPSession::Close()
+        {
+            if(closed)return;
+
+            closed=true;
+
+            if(endpoint)                                                    //通知对方，只发一次，丢了对方靠超时发现
+            {
+                uint8 *buf=endpoint->BeginDatagram();
+
+                RUDPHeader h;
+
+                h.Set(conv,RUDP_CMD_CLOSE,uint16(config.recv_window-hgl_min<uint>(rcv_buf.GetCount(),config.recv_window)),snd_nxt,rcv_nxt);
+                h.Write(buf);
+
+                endpoint->EndDatagram(buf,HGL_RUDP_HEADER_SIZE,address);
+                ++stats.send_datagrams;
+            }
+
+            OnClose();
+        }
+
+        void RUDPSession::Flush()
+        {
+            if(!endpoint)return;
+
+            Flush(endpoint->GetTime(GetDoubleTime()));
+            endpoint->FlushDatagram();
+        }
+
+        /**
+         * 将ACK、心跳、新数据与需要重传的数据写入数据报，多个分段合并在同一个数据报中
+         */
+        void RUDPSession::Flush(uint32 now)
+        {
+            if(closed||!endpoint)return;
+
+            const uint16 wnd=uint16(config.recv_window-hgl_min<uint>(rcv_buf.GetCount(),config.recv_window));
+
+            uint8 *buf=nullptr;
+            uint pos=0;
+
+            auto reserve=[&](uint need)                                     //当前数据报放不下时提交，再取一个新的
+            {
+                if(buf&&pos+need>config.mtu)
+                {
+                    endpoint->EndDatagram(buf,pos,address);
+                    ++stats.send_datagrams;
+                    buf=nullptr;
+                }
+
+                if(!buf)
+                {
+                    buf=endpoint->BeginDatagram();
+                    pos=0;
+                }
+            };
+
+            RUDPHeader h;
+
+            for(const AckItem &ai:ack_list)
+            {
+                reserve(HGL_RUDP_HEADER_SIZE);
+
+                h.Set(conv,RUDP_CMD_ACK,wnd,ai.sn,rcv_nxt,ai.ts);
+                h.Write(buf+pos);
+                pos+=HGL_RUDP_HEADER_SIZE;
+            }
+
+            ack_list.Clear();
+
+            if(rmt_wnd==0&&snd_buf.IsEmpty()&&!snd_queue.IsEmpty())        //对方窗口为0，靠心跳取得新的窗口
+                send_ping=true;
+
+            if(send_ping||send_pong)
+            {
+                if(send_ping)
+                {
+                    reserve(HGL_RUDP_HEADER_SIZE);
+
+                    h.Set(conv,RUDP_CMD_PING,wnd,snd_nxt,rcv_nxt,now);
+                    h.Write(buf+pos);
+                    pos+=HGL_RUDP_HEADER_SIZE;
+                }
+
+                if(send_pong)
+                {
+                    reserve(HGL_RUDP_HEADER_SIZE);
+
+                    h.Set(conv,RUDP_CMD_PONG,wnd,snd_nxt,rcv_nxt,now);
+                    h.Write(buf+pos);
+                    pos+=HGL_RUDP_HEADER_SIZE;
+                }
+
+                send_ping=false;
+                send_pong=false;
+            }
+
+            //序号不能超出发送窗口，在途(未被确认，已选择确认的不算)的分段数不能超过对方窗口与拥塞窗口
+            uint32 window=rmt_wnd;
+
+            if(config.congestion)
+                window=hgl_min<uint32>(window,hgl_max<uint32>(1,uint32(cwnd)));
+
+            while(!snd_queue.IsEmpty()
+                &&SeqDiff(snd_nxt,snd_una+config.send_window)<0
+                &&uint32(snd_buf.GetCount())<window)
+            {
+                RUDPSegment *seg=snd_queue.GetData()[0];
+
+                snd_queue.DeleteMove(0);
+
+                seg->sn=snd_nxt++;
+                seg->xmit=0;
+                seg->fastack=0;
+
+                snd_buf.Add(seg);
+            }
+
+            //速率配额: 一个RTT发完一个窗口，允许少量突发
+            if(config.pacing)
+            {
+                const double rtt=hgl_max<int32>(srtt>0?srtt:RUDP_INITIAL_RTO,int32(config.interval));
+                const double rate=RUDP_PACING_GAIN*double(window)*config.mtu/rtt;          //字节/毫秒
+                const double burst=hgl_max<double>(config.mtu*RUDP_PACING_BURST,rate*config.interval*2);
+
+                pacing_tokens+=rate*SeqDiff(now,pacing_time);
+                pacing_time=now;
+
+                if(pacing_tokens>burst)
+                    pacing_tokens=burst;
+            }
+
+            bool lost=false;
+            bool change=false;
+            uint32 inflight=0;
+
+            for(RUDPSegment *seg:snd_buf)
+            {
+                bool send=false;
+
+                if(seg->xmit==0)
+                {
+                    if(config.pacing&&pacing_tokens<seg->data.GetCount()+HGL_RUDP_HEADER_SIZE)
+                        break;                                              //配额用完，剩下的新数据下次再发
+
+                    send=true;
+                    seg->rto=rto;
+                    seg->resend_ts=now+seg->rto;
+                    ++stats.send_segments;
+                }
+                else
+                if(SeqDiff(now,seg->resend_ts)>=0)
+                {
+                    send=true;
+
+                    if(SeqDiff(last_ack_time,seg->ts)>0)                    //发出之后还收到过新的确认，链路仍通畅(多为尾部丢包)，按快速重传处理
+                        change=true;
+                    else
+                        lost=true;
+
+                    seg->rto=hgl_min<uint32>(seg->rto+seg->rto/2,config.max_rto);   //退避
+                    seg->resend_ts=now+seg->rto;
+                    ++stats.timeout_resend;
+                }
+                else
+                if(config.fast_resend>0&&seg->fastack>=config.fast_resend&&seg->xmit==1)  //快速重传只做一次，再丢由超时处理
+                {
+                    send=true;
+                    change=true;
+                    seg->fastack=0;
+                    seg->resend_ts=now+seg->rto;
+                    ++stats.fast_resend;
+                }
+
+                ++inflight;
+
+                if(!send)continue;
+
+                const uint len=seg->data.GetCount();
+
+                reserve(HGL_RUDP_HEADER_SIZE+len);
+
+                seg->ts=now;
+                ++seg->xmit;
+
+                h.Set(conv,seg->cmd,wnd,seg->sn,rcv_nxt,now,seg->frg,uint16(len));
+                h.Write(buf+pos);
+                pos+=HGL_RUDP_HEADER_SIZE;
+
+                memcpy(buf+pos,seg->data.data(),len);
+                pos+=len;
+
+                if(config.pacing)
+                    pacing_tokens-=HGL_RUDP_HEADER_SIZE+len;
+
+                if(seg->xmit>config.dead_link)
+                {
+                    LOG_INFO(OS_TEXT("RUDPSession dead link,conv:")+OSString::numberOf(conv));
+                    closed=true;
+                }
+            }
+
+            if(buf)                                                         //取得空间后一定写入过内容
+            {
+                endpoint->EndDatagram(buf,pos,address);
+                ++stats.send_datagrams;
+                last_send_time=now;
+            }
+
+            if(config.congestion&&(change||lost)&&SeqDiff(snd_una,recover)>=0)
+            {
+                recover=snd_nxt;
+
+                if(lost)                                                    //超时，回到慢启动
+                {
+                    ssthresh=hgl_max<double>(cwnd/2,RUDP_MIN_SSTHRESH);
+                    cwnd=1;
+                }
+                else                                                        //快速重传，窗口减半
+                {
+                    ssthresh=hgl_max<double>(inflight/2.0,RUDP_MIN_SSTHRESH);
+                    cwnd=ssthresh+config.fast_resend;
+                }
+            }
+
+            if(closed)
+                OnClose();
+        }
+
+        /**
+         * 按时间驱动：刷新间隔到了就Flush，同时检查心跳与超时
+         */
+        void RUDPSession::Update(uint32 now)
+        {
+            if(closed)return;
+
+            if(config.idle_time_out>0
+             &&SeqDiff(now,last_recv_time)>int32(config.idle_time_out*HGL_MILLI_SEC_PRE_SEC))
+            {
+                LOG_INFO(OS_TEXT("RUDPSession recv timeout,conv:")+OSString::numberOf(conv));
+                closed=true;
+                OnClose();
+                return;
+            }
+
+            if(config.keep_alive>0
+             &&SeqDiff(now,last_send_time)>=int32(config.keep_alive*HGL_MILLI_SEC_PRE_SEC))
+                send_ping=true;
+
+            if(SeqDiff(now,next_flush_time)<0&&!send_ping&&ack_list.IsEmpty())
+                return;
+
+            Flush(now);
+
+            next_flush_time=now+config.interval;
+        }
+
+        /**
+         * 取得距离下一次需要Update的时间(毫秒)<br>
+         * 没有在途与待发数据时只需要按心跳/超时时间唤醒
+         */
+        uint32 RUDPSession::GetWaitTime(uint32 now)const
+        {
+            if(closed)return(0);
+
+            if(!ack_list.IsEmpty())return(0);
+
+            if(!snd_buf.IsEmpty()||!snd_queue.IsEmpty())
+            {
+                const int32 t=SeqDiff(next_flush_time,now);
+
+                return t>0?uint32(t):0;
+            }
+
+            int32 t=config.keep_alive>0?int32(config.keep_alive*HGL_MILLI_SEC_PRE_SEC)-SeqDiff(now,last_send_time):RUDP_IDLE_WAIT_TIME;
+
+            if(config.idle_time_out>0)
+                t=hgl_min(t,int32(config.idle_time_out*HGL_MILLI_SEC_PRE_SEC)-SeqDiff(now,last_recv_time)+1);
+
+            return t>0?uint32(t):0;
+        }
+    }//namespace network
+}//namespace hgl
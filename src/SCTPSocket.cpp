@@ -78,7 +78,7 @@ namespace hgl
             out_max_stream=ms;
             in_max_stream=ms;
 
-            return InitMsg(ThisSocket,ms,ms);
+            return InitMsg(ms,ms);
         }
 
         void SCTPSocket::UseSocket(int s,const sockaddr_in *sa)
@@ -0,0 +1,306 @@
+#include<hgl/network/SCTPStreamServer.h>
+#include<hgl/log/LogInfo.h>
+#include<string.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        SCTPStreamServer::SCTPStreamServer()
+        {
+            memset(&recv_addr,0,sizeof(sockaddr_in));
+        }
+
+        SCTPStreamServer::~SCTPStreamServer()
+        {
+            for(PartialMessage *pm:partial_list)
+                delete pm;
+
+            for(PartialMessage *pm:partial_pool)
+                delete pm;
+        }
+
+        /**
+         * 创建服务器，订阅数据与关联事件，开启分片交错，并设为非阻塞模式
+         */
+        bool SCTPStreamServer::CreateServer(const sockaddr_in &addr,const uint max_listen)
+        {
+            if(!SCTPO2MServer::CreateServer(addr,max_listen))
+                return(false);
+
+            struct sctp_event_subscribe events;
+
+            hgl_zero(events);
+
+            events.sctp_data_io_event=1;                                    //需要sctp_sndrcvinfo取得关联与流编号
+            events.sctp_association_event=1;
+
+            if(setsockopt(ThisSocket,IPPROTO_SCTP,SCTP_EVENTS,(const void *)&events,sizeof(events))==-1)
+            {
+                LOG_ERROR(OS_TEXT("SCTPStreamServer set SCTP_EVENTS failed! errno: ")+OSString::numberOf(GetLastSocketError()));
+                CloseSocket();
+                return(false);
+            }
+
+        #ifdef SCTP_FRAGMENT_INTERLEAVE
+            const int interleave=2;                                         //不同关联、不同流的分片可以交错交付
+
+            if(setsockopt(ThisSocket,IPPROTO_SCTP,SCTP_FRAGMENT_INTERLEAVE,&interleave,sizeof(interleave))==-1)
+                LOG_HINT(OS_TEXT("SCTPStreamServer set SCTP_FRAGMENT_INTERLEAVE failed,large messages will block other streams. errno: ")+OSString::numberOf(GetLastSocketError()));
+        #endif//SCTP_FRAGMENT_INTERLEAVE
+
+            recv_buffer.SetCount(HGL_SCTP_RECV_BLOCK_SIZE);
+
+            SetBlock(false);
+            return(true);
+        }
+
+        void SCTPStreamServer::CloseServer()
+        {
+            SCTPO2MServer::CloseServer();
+
+            for(PartialMessage *pm:partial_list)
+                ReleasePartial(pm);
+
+            partial_list.Clear();
+        }
+
+        void SCTPStreamServer::SetStreamHandler(const uint16 stream,SCTPStreamHandler *h)
+        {
+            if(stream>=handler_list.GetCount())
+            {
+                if(!h)return;
+
+                const int old_count=handler_list.GetCount();
+
+                handler_list.SetCount(stream+1);
+
+                for(int i=old_count;i<=stream;i++)
+                    handler_list.GetData()[i]=nullptr;
+            }
+
+            handler_list.GetData()[stream]=h;
+        }
+
+        bool SCTPStreamServer::Send(sctp_assoc_t assoc,uint16 stream,const void *data,int size,bool ordered,uint32 ppid)
+        {
+            if(!data||size<=0)
+                return(false);
+
+            struct sctp_sndrcvinfo sri;
+
+            hgl_zero(sri);
+
+            sri.sinfo_stream    =stream;
+            sri.sinfo_flags     =(ordered?0:SCTP_UNORDERED);
+            sri.sinfo_ppid      =htonl(ppid);
+            sri.sinfo_assoc_id  =assoc;
+
+            return(sctp_send(ThisSocket,data,size,&sri,0)==size);
+        }
+
+        void SCTPStreamServer::Abort(sctp_assoc_t assoc)
+        {
+            struct sctp_sndrcvinfo sri;
+
+            hgl_zero(sri);
+
+            sri.sinfo_flags     =SCTP_ABORT;
+            sri.sinfo_assoc_id  =assoc;
+
+            sctp_send(ThisSocket,nullptr,0,&sri,0);
+
+            ClearPartial(assoc);
+        }
+
+        SCTPStreamServer::PartialMessage *SCTPStreamServer::FindPartial(sctp_assoc_t assoc,uint16 stream)const
+        {
+            for(PartialMessage *pm:partial_list)
+                if(pm->assoc==assoc&&pm->stream==stream)
+                    return pm;
+
+            return(nullptr);
+        }
+
+        /**
+         * 重组缓冲区放回池中(不从partial_list中移除)
+         */
+        void SCTPStreamServer::ReleasePartial(PartialMessage *pm)
+        {
+            pm->data.SetCount(0);
+            partial_pool.Add(pm);
+        }
+
+        /**
+         * 丢弃一个关联所有未完成的消息
+         */
+        void SCTPStreamServer::ClearPartial(sctp_assoc_t assoc)
+        {
+            for(int i=0;i<partial_list.GetCount();)
+            {
+                PartialMessage *pm=partial_list.GetData()[i];
+
+                if(pm->assoc!=assoc)
+                {
+                    ++i;
+                    continue;
+                }
+
+                ReleasePartial(pm);
+                partial_list.Delete(i);                                     //与最后一项交换，当前位置需要再检查一次
+            }
+        }
+
+        void SCTPStreamServer::ProcNotification(const void *buf,int size)
+        {
+            const sctp_notification *sn=(const sctp_notification *)buf;
+
+            if(size<int(sizeof(sn->sn_header)))
+                return;
+
+            if(sn->sn_header.sn_type!=SCTP_ASSOC_CHANGE)
+                return;
+
+            const sctp_assoc_change &sac=sn->sn_assoc_change;
+
+            switch(sac.sac_state)
+            {
+                case SCTP_COMM_UP:
+                case SCTP_RESTART:          ClearPartial(sac.sac_assoc_id);
+                                            OnAssocUp(sac.sac_assoc_id,sac.sac_outbound_streams,sac.sac_inbound_streams);
+                                            break;
+
+                case SCTP_COMM_LOST:
+                case SCTP_SHUTDOWN_COMP:
+                case SCTP_CANT_STR_ASSOC:   ClearPartial(sac.sac_assoc_id);
+                                            OnAssocDown(sac.sac_assoc_id);
+                                            break;
+            }
+        }
+
+        void SCTPStreamServer::Dispatch(SCTPMessage &msg)
+        {
+            SCTPStreamHandler *h=(msg.stream<handler_list.GetCount()?handler_list.GetData()[msg.stream]:nullptr);
+
+            const bool result=(h?h->OnMessage(msg):OnRecvMessage(msg));
+
+            if(!result)
+            {
+                LOG_INFO(OS_TEXT("SCTPStreamServer abort assoc:")+OSString::numberOf(int(msg.assoc))+OS_TEXT(",stream:")+OSString::numberOf(msg.stream));
+                Abort(msg.assoc);
+            }
+        }
+
+        /**
+         * 处理读到的一段数据，完整的消息直接交付，被拆开的消息按关联与流分别重组
+         */
+        void SCTPStreamServer::ProcData(const sctp_sndrcvinfo &sri,int flags,int len)
+        {
+            SCTPMessage msg;
+
+            msg.assoc       =sri.sinfo_assoc_id;
+            msg.stream      =sri.sinfo_stream;
+            msg.ppid        =ntohl(sri.sinfo_ppid);
+            msg.unordered   =(sri.sinfo_flags&SCTP_UNORDERED);
+            msg.from        =&recv_addr;
+
+            PartialMessage *pm=(partial_list.IsEmpty()?nullptr:FindPartial(msg.assoc,msg.stream));
+
+            if(!pm&&(flags&MSG_EOR))                                        //完整消息，不需要复制
+            {
+                msg.data=recv_buffer.data();
+                msg.size=len;
+
+                Dispatch(msg);
+                return;
+            }
+
+            if(!pm)
+            {
+                const int pool_count=partial_pool.GetCount();
+
+                if(pool_count>0)
+                {
+                    pm=partial_pool.GetData()[pool_count-1];
+                    partial_pool.SetCount(pool_count-1);
+                }
+                else
+                {
+                    pm=new PartialMessage;
+                }
+
+                pm->assoc=msg.assoc;
+                pm->stream=msg.stream;
+
+                partial_list.Add(pm);
+            }
+
+            const uint old_size=pm->data.GetCount();
+
+            if(old_size+len>max_message_size)
+            {
+                LOG_INFO(OS_TEXT("SCTPStreamServer message too large,assoc:")+OSString::numberOf(int(msg.assoc))+OS_TEXT(",stream:")+OSString::numberOf(msg.stream));
+                Abort(msg.assoc);
+                return;
+            }
+
+            pm->data.SetCount(old_size+len);
+            memcpy(pm->data.data()+old_size,recv_buffer.data(),len);
+
+            if(!(flags&MSG_EOR))
+                return;
+
+            partial_list.Delete(partial_list.Find(pm));
+
+            msg.data=pm->data.data();
+            msg.size=pm->data.GetCount();
+
+            Dispatch(msg);
+
+            ReleasePartial(pm);
+        }
+
+        /**
+         * 读取并分发一批消息(边缘模式下由SocketManage反复调用直到返回<=0)
+         * @return 读取到的消息与通知数量，0表示已经没有数据，<0表示出错
+         */
+        int SCTPStreamServer::ProcRecv(int)
+        {
+            struct sctp_sndrcvinfo sri;
+            int count=0;
+
+            while(count<int(HGL_SCTP_RECV_BATCH_COUNT))
+            {
+                socklen_t sal=sizeof(sockaddr_in);
+                int flags=0;
+
+                hgl_zero(sri);
+
+                const int len=sctp_recvmsg(ThisSocket,recv_buffer.data(),recv_buffer.GetCount(),
+                                           (sockaddr *)&recv_addr,&sal,
+                                           &sri,&flags);
+
+                if(len<0)
+                {
+                    if(count>0)break;
+
+                    const int err=GetLastSocketError();
+
+                    return((err==nseWouldBlock||err==nseInt)?0:-1);
+                }
+
+                if(len==0&&!(flags&MSG_EOR))
+                    break;
+
+                ++count;
+
+                if(flags&MSG_NOTIFICATION)
+                    ProcNotification(recv_buffer.data(),len);
+                else
+                    ProcData(sri,flags,len);
+            }
+
+            return count;
+        }
+    }//namespace network
+}//namespace hgl
@@ -0,0 +1,447 @@
+﻿#include<hgl/network/SendQueue.h>
+#include<hgl/network/SocketOutputStream.h>
+
+#if HGL_OS == HGL_OS_Windows
+#include<io.h>
+#else
+#include<unistd.h>
+#endif//HGL_OS == HGL_OS_Windows
+
+namespace hgl
+{
+    namespace network
+    {
+        SendQueue::SendQueue()
+        {
+            first=0;
+            total_bytes=0;
+
+            zero_copy_threshold=0;
+            zero_copy_seq=0;
+        }
+
+        SendQueue::~SendQueue()
+        {
+            Free();
+        }
+
+        SendQueue::Block *SendQueue::AppendBlock(uint size)
+        {
+            Block b;
+
+            b.capacity=(size>HGL_SEND_QUEUE_BLOCK_SIZE?size:HGL_SEND_QUEUE_BLOCK_SIZE);
+            b.data=new uchar[b.capacity];
+            b.start=0;
+            b.end=0;
+            b.shared=nullptr;
+            b.file=-1;
+
+            block_list.Add(b);
+
+            return block_list.GetData()+block_list.GetCount()-1;
+        }
+
+        void SendQueue::FreeBlock(Block *b)
+        {
+            if(b->file>=0)
+            {
+                if(b->file_close)
+                #if HGL_OS == HGL_OS_Windows
+                    _close(b->file);
+                #else
+                    close(b->file);
+                #endif//HGL_OS == HGL_OS_Windows
+            }
+            else
+            if(b->shared)
+                b->shared->Release();
+            else
+                delete[] b->data;
+        }
+
+        /**
+         * 将已经发完的块从列表中移除
+         */
+        void SendQueue::Compact()
+        {
+            if(first<=0)return;
+
+            const int count=block_list.GetCount();
+            Block *p=block_list.GetData();
+
+            if(count>first)
+                memmove(p,p+first,(count-first)*sizeof(Block));
+
+            block_list.SetCount(count-first);
+            first=0;
+        }
+
+        /**
+         * 追加数据到队列尾部
+         * @param data 数据指针
+         * @param size 数据长度
+         * @return 是否成功
+         */
+        bool SendQueue::Append(const void *data,const uint size)
+        {
+            if(!data||size<=0)return(false);
+
+            const uchar *p=(const uchar *)data;
+            uint left=size;
+
+            if(block_list.GetCount()>first)                     //先填满最后一块的剩余空间
+            {
+                Block *last=block_list.GetData()+block_list.GetCount()-1;
+
+                const uint free_bytes=(last->shared?0:last->capacity-last->end);
+
+                if(free_bytes>0)
+                {
+                    const uint n=(free_bytes<left?free_bytes:left);
+
+                    memcpy(last->data+last->end,p,n);
+                    last->end+=n;
+
+                    p+=n;
+                    left-=n;
+                }
+            }
+
+            if(left>0)
+            {
+                Block *b=AppendBlock(left);
+
+                memcpy(b->data,p,left);
+                b->end=left;
+            }
+
+            total_bytes+=size;
+            return(true);
+        }
+
+        /**
+         * 以引用方式追加共享数据块，数据不复制
+         * @param sb 共享数据块(队列会增加一个引用)
+         * @param offset 从数据块的哪个位置开始(之前已发出的部分)
+         * @return 是否成功
+         */
+        bool SendQueue::Append(SharedBuffer *sb,const uint offset)
+        {
+            if(!sb)return(false);
+
+            return Append(sb,offset,sb->GetSize());
+        }
+
+        /**
+         * 以引用方式追加共享数据块中的一段(如接收缓冲区中的一个包)，数据不复制
+         * @param sb 共享数据块(队列会增加一个引用)
+         * @param start 起始位置
+         * @param end 结束位置(不含)
+         * @return 是否成功
+         */
+        bool SendQueue::Append(SharedBuffer *sb,const uint start,const uint end)
+        {
+            if(!sb||start>=end||end>sb->GetSize())return(false);
+
+            Block b;
+
+            b.data=sb->GetData();
+            b.capacity=sb->GetSize();
+            b.start=start;
+            b.end=end;
+            b.shared=sb->AddRef();
+            b.file=-1;
+
+            block_list.Add(b);
+
+            total_bytes+=b.end-b.start;
+            return(true);
+        }
+
+        /**
+         * 追加文件中的一段数据，数据不读出，轮到它时直接从文件发到socket
+         * @param fd 文件句柄(也可以是管道)
+         * @param offset 数据在文件中的位置(<0表示从fd的当前位置读取，用于管道)
+         * @param size 数据长度
+         * @param close_fd 发完或清除队列时是否关闭fd
+         * @return 是否成功
+         */
+        bool SendQueue::AppendFile(int fd,int64 offset,int64 size,bool close_fd)
+        {
+            if(fd<0||size<=0)return(false);
+
+            Block b;
+
+            b.data=nullptr;
+            b.capacity=0;
+            b.start=0;
+            b.end=0;
+            b.shared=nullptr;
+            b.file=fd;
+            b.file_offset=offset;
+            b.file_left=size;
+            b.file_close=close_fd;
+
+            block_list.Add(b);
+
+            total_bytes+=size;
+            return(true);
+        }
+
+        /**
+         * 从队列头部移除已经发出的数据，发完的块会被释放
+         */
+        void SendQueue::Consume(int64 bytes)
+        {
+            const int count=block_list.GetCount();
+            Block *b=block_list.GetData()+first;
+
+            while(first<count)
+            {
+                const int64 size=b->GetBytes();
+
+                if(size>bytes)
+                {
+                    if(b->file>=0)
+                    {
+                        if(b->file_offset>=0)
+                            b->file_offset+=bytes;
+
+                        b->file_left-=bytes;
+                    }
+                    else
+                    {
+                        b->start+=uint(bytes);
+                    }
+
+                    break;
+                }
+
+                bytes-=size;
+
+                if(first==count-1                               //最后一块保留下来给后面的数据用
+                 &&!b->shared                                   //共享块不属于本队列
+                 &&b->file<0                                    //文件块没有内存
+                 &&b->capacity<=HGL_SEND_QUEUE_BLOCK_SIZE)      //超大块则不保留
+                {
+                    b->start=0;
+                    b->end=0;
+                    break;
+                }
+
+                FreeBlock(b);
+                ++first;
+                ++b;
+            }
+
+            Compact();
+        }
+
+        /**
+         * 记录一次以MSG_ZEROCOPY发出的共享数据块，收到完成通知前保持一个引用
+         */
+        void SendQueue::AddZeroCopy(SharedBuffer *sb)
+        {
+            zero_copy_list.Add({sb->AddRef(),zero_copy_seq});
+
+            ++zero_copy_seq;
+        }
+
+        /**
+         * 处理内核的零拷贝完成通知(一次通知可以覆盖连续多次发送)
+         * @param lo 起始序号
+         * @param hi 结束序号(含)
+         * @return 释放的数据块数量
+         */
+        int SendQueue::CompleteZeroCopy(uint32 lo,uint32 hi)
+        {
+            const int count=zero_copy_list.GetCount();
+            ZeroCopyItem *src=zero_copy_list.GetData();
+            ZeroCopyItem *dst=src;
+
+            const uint32 range=hi-lo;                                   //序号会回绕，按差值比较
+
+            for(int i=0;i<count;i++)
+            {
+                if(uint32(src->seq-lo)<=range)
+                    src->buffer->Release();
+                else
+                    *dst++=*src;                                        //保持原有顺序
+
+                ++src;
+            }
+
+            const int keep=int(dst-zero_copy_list.GetData());
+
+            zero_copy_list.SetCount(keep);
+            return count-keep;
+        }
+
+        /**
+         * 释放所有未完成的零拷贝数据的引用<br>
+         * 只在socket已关闭或更换时调用，内核不会再向该socket报告完成，序号也重新从0计算
+         */
+        void SendQueue::ClearZeroCopy()
+        {
+            for(ZeroCopyItem &zi:zero_copy_list)
+                zi.buffer->Release();
+
+            zero_copy_list.Clear();
+            zero_copy_seq=0;
+        }
+
+        /**
+         * 尽可能多的将队列中的数据发出，直到队列为空或socket缓冲区已满<br>
+         * 多个内存块会合并为一次WriteVector发出，遇到文件块时单独以WriteFile发出
+         * @param sos 输出流
+         * @return 本次发出的字节数
+         * @return -1 出错
+         */
+        int64 SendQueue::Flush(SocketOutputStream *sos)
+        {
+            if(!sos)return(-1);
+
+            SocketIOVec vec[HGL_SOCKET_IOVEC_MAX];
+            int64 total=0;
+
+            while(total_bytes>0)
+            {
+                const int count=block_list.GetCount();
+                const Block *b=block_list.GetData()+first;
+
+                int i=first;
+
+                while(i<count&&b->file<0&&b->end<=b->start)     //跳过空的内存块
+                {
+                    ++i;
+                    ++b;
+                }
+
+                if(i>=count)
+                    break;
+
+                int64 want=0;
+                int64 result;
+
+                if(b->file>=0)
+                {
+                    want=b->file_left;
+                    result=sos->WriteFile(b->file,b->file_offset,want);
+                }
+                else
+                if(b->shared
+                 &&zero_copy_threshold>0
+                 &&b->end-b->start>=zero_copy_threshold)
+                {
+                    bool zero_copy;
+
+                    want=b->end-b->start;
+                    result=sos->WriteZeroCopy(b->data+b->start,want,zero_copy);
+
+                    if(zero_copy)
+                        AddZeroCopy(b->shared);                         //Consume会释放队列自己的引用
+                }
+                else
+                {
+                    int vec_count=0;
+
+                    for(;i<count&&vec_count<HGL_SOCKET_IOVEC_MAX;i++)
+                    {
+                        if(b->file>=0)                          //文件块之前的内存数据先发完
+                            break;
+
+                        if(b->shared                            //要零拷贝发出的块单独发
+                         &&zero_copy_threshold>0
+                         &&b->end-b->start>=zero_copy_threshold)
+                            break;
+
+                        if(b->end>b->start)
+                        {
+                            vec[vec_count].data=b->data+b->start;
+                            vec[vec_count].size=b->end-b->start;
+
+                            want+=vec[vec_count].size;
+                            ++vec_count;
+                        }
+
+                        ++b;
+                    }
+
+                    result=sos->WriteVector(vec,vec_count);
+                }
+
+                if(result<0)
+                    return(-1);
+
+                if(result>0)
+                {
+                    Consume(result);
+
+                    total_bytes-=result;
+                    total+=result;
+                }
+
+                if(result<want)                                 //socket缓冲区满了，等下一次可写
+                    break;
+            }
+
+            return total;
+        }
+
+        void SendQueue::Clear()
+        {
+            const int count=block_list.GetCount();
+            Block *b=block_list.GetData();
+
+            int keep=-1;
+
+            for(int i=0;i<count;i++)
+            {
+                if(keep==-1&&!b->shared&&b->file<0&&b->capacity<=HGL_SEND_QUEUE_BLOCK_SIZE)
+                    keep=i;
+                else
+                    FreeBlock(b);
+
+                ++b;
+            }
+
+            if(keep==-1)
+            {
+                block_list.Clear();
+            }
+            else
+            {
+                b=block_list.GetData();
+
+                b[0]=b[keep];
+                b[0].start=0;
+                b[0].end=0;
+
+                block_list.SetCount(1);
+            }
+
+            first=0;
+            total_bytes=0;
+
+            ClearZeroCopy();
+        }
+
+        void SendQueue::Free()
+        {
+            const int count=block_list.GetCount();
+            Block *b=block_list.GetData();
+
+            for(int i=0;i<count;i++)
+            {
+                FreeBlock(b);
+                ++b;
+            }
+
+            block_list.Clear();
+            first=0;
+            total_bytes=0;
+
+            ClearZeroCopy();
+        }
+    }//namespace network
+}//namespace hgl
@@ -42,9 +42,10 @@ namespace hgl
         * @param addr 服务器地址
         * @param max_listen 最大监听数量(指同一时间在未处理的情况下，最多有多少个连接可以被处理。注：并非越大越好)
         * @param reuse 是否可以复用这个IP地址，默认为假
+        * @param reuse_port 是否允许多个socket监听同一端口(SO_REUSEPORT，由内核在它们之间分配新连接)，默认为假
         * @return 创建服务器是否成功
         */
-        bool ServerSocket::CreateServer(const IPAddress *addr,const uint max_listen,bool reuse)
+        bool ServerSocket::CreateServer(const IPAddress *addr,const uint max_listen,bool reuse,bool reuse_port)
         {
             ThisSocket=CreateServerSocket();
 
@@ -54,6 +55,24 @@ namespace hgl
                 return(false);
             }
 
+            if(reuse_port)
+            {
+#ifdef SO_REUSEPORT
+                const int val=1;
+
+                if(setsockopt(ThisSocket,SOL_SOCKET,SO_REUSEPORT,&val,sizeof(int)))
+                {
+                    LOG_HINT(OS_TEXT("Set SO_REUSEPORT Failed! errno: ")+OSString::numberOf(GetLastSocketError()));
+                    CloseSocket(ThisSocket);
+                    return(false);
+                }
+#else
+                LOG_HINT(OS_TEXT("SO_REUSEPORT isn't supported on this platform!"));
+                CloseSocket(ThisSocket);
+                return(false);
+#endif//SO_REUSEPORT
+            }
+
             if(!addr->Bind(ThisSocket,reuse))
             {
                 CloseSocket(ThisSocket);
@@ -74,6 +93,36 @@ namespace hgl
             SAFE_CLEAR(server_address);
         }
 
+        /**
+         * 使用一个已经bind并listen的socket作为服务器
+         * @param sock 监听socket(所有权转交给本对象)
+         * @param addr 服务器地址
+         */
+        bool ServerSocket::AttachServer(int sock,const IPAddress *addr)
+        {
+            if(sock<0||!addr)
+                RETURN_FALSE;
+
+            CloseServer();
+
+            ThisSocket=sock;
+            server_address=addr->CreateCopy();
+            return(true);
+        }
+
+        /**
+         * 放弃监听socket的所有权，本对象不再关闭它<br>
+         * 热重启转交出去的监听socket不能再走CloseServer(shutdown会让新进程中的同一个socket也停止监听)，需由调用者CloseHandoffSocket
+         */
+        int ServerSocket::DetachServer()
+        {
+            const int sock=ThisSocket;
+
+            ThisSocket=-1;
+            SAFE_CLEAR(server_address);
+            return sock;
+        }
+
         bool ServerSocket::SetIPv6Only(bool only)
         {
             if (ThisSocket == -1)return(false);
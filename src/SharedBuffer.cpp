@@ -0,0 +1,130 @@
+﻿#include<hgl/network/SharedBuffer.h>
+#include<hgl/thread/ThreadMutex.h>
+#include<new>
+
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * 进程级的共享数据块池<br>
+         * 数据块的最后一个引用可能在任意线程释放，所以需要加锁；每级只缓存有限数量，多出的直接删除
+         */
+        class SharedBufferPool
+        {
+            static constexpr uint MIN_SHIFT     =12;                                                ///<最小4KB
+            static constexpr uint MAX_SHIFT     =22;                                                ///<最大4MB，更大的直接分配
+            static constexpr uint64 MAX_CACHE   =64*1024*1024;                                      ///<最多缓存的字节数
+
+            ThreadMutex lock;
+
+            SharedBuffer *free_list[MAX_SHIFT-MIN_SHIFT+1]={};                                      ///<空闲块链表(借用数据区的头部存放next)
+            uint64 cache_bytes=0;
+
+        public:
+
+            static SharedBufferPool &Instance()
+            {
+                static SharedBufferPool *pool=new SharedBufferPool;                                 //不析构，进程退出时其它静态对象中可能还持有数据块
+
+                return *pool;
+            }
+
+            SharedBuffer *Acquire(const uint size)
+            {
+                uint shift=MIN_SHIFT;
+
+                while(shift<=MAX_SHIFT&&(1u<<shift)<size)
+                    ++shift;
+
+                if(shift>MAX_SHIFT)
+                    return SharedBuffer::Create(size);
+
+                const uint capacity=1u<<shift;
+                const uint level=shift-MIN_SHIFT+1;
+
+                lock.Lock();
+
+                SharedBuffer *sb=free_list[level-1];
+
+                if(sb)
+                {
+                    memcpy(&free_list[level-1],(uchar *)(sb+1),sizeof(SharedBuffer *));
+                    cache_bytes-=capacity;
+                }
+
+                lock.Unlock();
+
+                if(sb)
+                    return new(sb) SharedBuffer(capacity,level);
+
+                uchar *mem=new uchar[sizeof(SharedBuffer)+capacity];
+
+                return new(mem) SharedBuffer(capacity,level);
+            }
+
+            void Release(SharedBuffer *sb)
+            {
+                const uint level=sb->pool_level;
+                const uint capacity=sb->size;
+
+                sb->~SharedBuffer();
+
+                lock.Lock();
+
+                if(cache_bytes+capacity<=MAX_CACHE)
+                {
+                    memcpy((uchar *)(sb+1),&free_list[level-1],sizeof(SharedBuffer *));
+                    free_list[level-1]=sb;
+                    cache_bytes+=capacity;
+                    sb=nullptr;
+                }
+
+                lock.Unlock();
+
+                if(sb)
+                    delete[] (uchar *)sb;
+            }
+        };//class SharedBufferPool
+
+        /**
+         * 创建一个数据块，头部与数据在同一次分配中
+         */
+        SharedBuffer *SharedBuffer::Create(const uint size)
+        {
+            uchar *mem=new uchar[sizeof(SharedBuffer)+size];
+
+            return new(mem) SharedBuffer(size,0);
+        }
+
+        SharedBuffer *SharedBuffer::Acquire(const uint size)
+        {
+            return SharedBufferPool::Instance().Acquire(size);
+        }
+
+        SharedBuffer *SharedBuffer::Create(const void *data,const uint size)
+        {
+            SharedBuffer *sb=Create(size);
+
+            if(data&&size>0)
+                memcpy(sb->GetData(),data,size);
+
+            return sb;
+        }
+
+        void SharedBuffer::Release()
+        {
+            if(ref_count.fetch_sub(1,std::memory_order_acq_rel)!=1)
+                return;
+
+            if(pool_level)
+            {
+                SharedBufferPool::Instance().Release(this);
+                return;
+            }
+
+            this->~SharedBuffer();
+            delete[] (uchar *)this;
+        }
+    }//namespace network
+}//namespace hgl
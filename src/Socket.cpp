@@ -1,6 +1,7 @@
 ﻿#include<hgl/network/Socket.h>
 #include<hgl/log/LogInfo.h>
 #include<time.h>
+#include<chrono>
 #include<iostream>
 
 #if HGL_OS != HGL_OS_Windows
@@ -11,6 +12,10 @@
 #endif//HGL_OS == HGL_OS_Solaris
 #endif//HGL_OS != HGL_OS_Windows
 
+#if HGL_OS == HGL_OS_Linux
+#include<linux/net_tstamp.h>
+#endif//HGL_OS == HGL_OS_Linux
+
 //setsockopt函数的Windows下使用参数格式请参见http://msdn.microsoft.com/en-us/library/windows/desktop/ms740476(v=vs.85).aspx
 
 namespace hgl
@@ -85,11 +90,83 @@ namespace hgl
             return(true);
         }
 
+        int StartConnect(int sock,IPAddress *addr)
+        {
+            if(sock<0||!addr)
+                return(-1);
+
+            if(connect(sock,addr->GetSockAddr(),addr->GetSockAddrInSize())==0)
+                return(1);
+
+            const int err=GetLastSocketError();
+
+        #if HGL_OS == HGL_OS_Windows
+            if(err==WSAEWOULDBLOCK||err==WSAEINPROGRESS)
+        #else
+            if(err==EINPROGRESS||err==nseInt)                               //被信号打断时连接仍在后台进行
+        #endif//HGL_OS == HGL_OS_Windows
+                return(0);
+
+            return(-err);
+        }
+
+        int GetConnectError(int sock)
+        {
+            int err=0;
+            socklen_t len=sizeof(err);
+
+            if(getsockopt(sock,SOL_SOCKET,SO_ERROR,(char *)&err,&len))
+                return GetLastSocketError();
+
+            return err;
+        }
+
+        /**
+         * 在指定时间内连接一个地址，连接期间socket为非阻塞，完成后恢复为阻塞
+         * @param sock socket
+         * @param addr 地址
+         * @param time_out 超时时间(秒)，<=0时直接阻塞连接，由系统决定超时
+         * @return 是否连接成功
+         */
+        bool Connect(int sock,IPAddress *addr,const double time_out)
+        {
+            if(time_out<=0)
+                return Connect(sock,addr);
+
+            if(sock<0||!addr)
+                RETURN_FALSE;
+
+            SetSocketNonBlock(sock,true);
+
+            int result=StartConnect(sock,addr);
+
+            if(result==0)
+            {
+                fd_set write_set,err_set;
+                timeval tv;
+
+                FD_ZERO(&write_set);
+                FD_ZERO(&err_set);
+                FD_SET(sock,&write_set);
+                FD_SET(sock,&err_set);                                      //Windows下连接失败在异常集合中返回
+
+                SetTimeVal(tv,time_out);
+
+                if(select(sock+1,nullptr,&write_set,&err_set,&tv)>0)
+                    result=(GetConnectError(sock)==0?1:-1);
+                else
+                    result=-1;                                              //超时或出错
+            }
+
+            SetSocketNonBlock(sock,false);
+
+            return(result>0);
+        }
+
 //        static atom_int socket_count=0;
 
         Socket::Socket()
         {
-            ThisAddress=nullptr;
             ThisSocket=-1;
 
 //            LOG_INFO(u8"Socket Count ++: "+U8String(++socket_count));
@@ -100,9 +177,7 @@ namespace hgl
             ThisSocket=sock;
 
             if(addr)
-                ThisAddress=addr->CreateCopy();
-            else
-                ThisAddress=nullptr;
+                ThisAddress.Set(addr);
         }
 
         Socket::~Socket()
@@ -117,7 +192,7 @@ namespace hgl
             if(!addr)
                 RETURN_FALSE;
 
-            SAFE_CLEAR(ThisAddress);
+            ThisAddress.Clear();
 
             #if HGL_OS == HGL_OS_Windows
             if(!InitWinSocket())
@@ -129,7 +204,7 @@ namespace hgl
             if(ThisSocket<0)
                 RETURN_FALSE;
 
-            ThisAddress=addr->CreateCopy();
+            ThisAddress.Set(addr);
             return(true);
         }
 
@@ -141,10 +216,8 @@ namespace hgl
             if(sock<0||!addr)
                 RETURN_FALSE;
 
-            SAFE_CLEAR(ThisAddress);
-
             ThisSocket=sock;
-            ThisAddress=addr->CreateCopy();
+            ThisAddress.Set(addr);
 
             return(true);
         }
@@ -154,13 +227,13 @@ namespace hgl
          */
         bool Socket::ReCreateSocket()
         {
-            if(!ThisAddress)
+            if(!ThisAddress.IsValid())
                 RETURN_FALSE;
 
             if(ThisSocket!=-1)
                 hgl::CloseSocket(ThisSocket);
 
-            ThisSocket=CreateSocket(ThisAddress);
+            ThisSocket=CreateSocket(&ThisAddress);
 
             if(ThisSocket!=-1)
                 return(true);
@@ -477,6 +550,19 @@ namespace hgl
             #endif//HGL_OS == HGL_OS_Windows
         }
 
+        void SetSocketNonBlock(int ThisSocket,bool non_block)
+        {
+            #if HGL_OS == HGL_OS_Windows
+                u_long par=(non_block?1:0);
+
+                ioctlsocket(ThisSocket,FIONBIO,&par);
+            #else
+                int par=(non_block?1:0);
+
+                ioctl(ThisSocket,FIONBIO,&par);
+            #endif//HGL_OS == HGL_OS_Windows
+        }
+
         void SetSocketLinger(int ThisSocket,int time_out)
         {
             struct linger so_linger;
@@ -493,5 +579,28 @@ namespace hgl
 
             setsockopt(ThisSocket,SOL_SOCKET,SO_LINGER,(const char *)&so_linger,sizeof(linger));
         }
+
+        /**
+         * 设置是否记录内核接收时间戳<br>
+         * 开启后以recvmsg接收时可取得数据到达时的时间，网卡开启了硬件时间戳(SIOCSHWTSTAMP)时同时取得硬件时间
+         */
+        bool SetSocketRecvTimestamp(int ThisSocket,bool enable)
+        {
+        #if HGL_OS == HGL_OS_Linux
+            const int flags=(enable?SOF_TIMESTAMPING_RX_SOFTWARE
+                                   |SOF_TIMESTAMPING_RX_HARDWARE
+                                   |SOF_TIMESTAMPING_SOFTWARE
+                                   |SOF_TIMESTAMPING_RAW_HARDWARE:0);
+
+            return(setsockopt(ThisSocket,SOL_SOCKET,SO_TIMESTAMPING,&flags,sizeof(int))==0);
+        #else
+            return(false);
+        #endif//HGL_OS == HGL_OS_Linux
+        }
+
+        int64 GetSocketTimestampNow()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();   //Linux下即CLOCK_REALTIME(vDSO)
+        }
     }//namespace network
 }//namespace hgl
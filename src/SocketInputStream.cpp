@@ -3,6 +3,11 @@
 #include<hgl/network/TCPSocket.h>
 #include<hgl/type/DataArray.h>
 #include<hgl/log/LogInfo.h>
+#include<hgl/network/NetLog.h>
+
+#if HGL_OS == HGL_OS_Linux
+#include<linux/errqueue.h>
+#endif//HGL_OS == HGL_OS_Linux
 
 namespace hgl
 {
@@ -23,8 +28,14 @@ namespace hgl
         {
 //            LOG_INFO(OS_TEXT("SocketInputStream::SocketInputStream(")+OSString(s)+OS_TEXT(")"));
 
+            mb=nullptr;
+
+            read_buffer=nullptr;
+            read_buffer_size=0;
+
+            recv_timestamp=false;
+
             SetSocket(s);
-            mb=new DataArray<char>();
         }
 
         SocketInputStream::~SocketInputStream()
@@ -32,10 +43,152 @@ namespace hgl
 //            LOG_INFO(OS_TEXT("SocketInputStream::~SocketInputStream(")+OSString::numberOf(sock)+OS_TEXT(")"));
 
             SAFE_CLEAR(mb);
+            delete[] read_buffer;
+        }
+
+        /**
+        * 设置预读缓冲区大小
+        * @param size 缓冲区大小(0表示关闭预读)
+        * @return 是否成功(缓冲区中已有的数据放不下时失败)
+        */
+        bool SocketInputStream::SetBuffer(const uint size)
+        {
+            const uint buffered=read_end-read_pos;
+
+            if(size<buffered)
+                RETURN_FALSE;
+
+            if(size==read_buffer_size)
+                return(true);
+
+            char *buf=(size>0?new char[size]:nullptr);
+
+            if(buffered>0)
+                memcpy(buf,read_buffer+read_pos,buffered);
+
+            delete[] read_buffer;
+
+            read_buffer=buf;
+            read_buffer_size=size;
+            read_pos=0;
+            read_end=buffered;
+            return(true);
+        }
+
+        /**
+        * 一次recv
+        * @return 读取的字节数，非阻塞模式下没有数据返回0，<0表示出错
+        */
+        int64 SocketInputStream::RecvOnce(void *buf,int64 size)
+        {
+            const int64 result=(recv_timestamp?RecvTimestamp(buf,size):recv(sock,(char *)buf,size,0));
+
+            if(result<0)
+            {
+                int err=GetLastSocketError();
+
+                if(err==nseWouldBlock)
+                    return 0;
+
+                NET_LOG_INFO("Socket {} recv {} bytes failed,error: {}",sock,size,err);
+            }
+
+            return(result);
         }
 
         /**
-        * 从socket中读取指定的字节数
+        * 以recvmsg接收，并从控制消息中取出内核接收时间戳(优先使用网卡硬件时间)
+        */
+        int64 SocketInputStream::RecvTimestamp(void *buf,int64 size)
+        {
+        #if HGL_OS == HGL_OS_Linux
+            iovec iov;
+            msghdr msg;
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping))];
+
+            iov.iov_base=buf;
+            iov.iov_len=size;
+
+            hgl_zero(msg);
+            msg.msg_iov=&iov;
+            msg.msg_iovlen=1;
+            msg.msg_control=control;
+            msg.msg_controllen=sizeof(control);
+
+            const int64 result=recvmsg(sock,&msg,0);
+
+            if(result<=0)
+                return(result);
+
+            last_timestamp=0;
+
+            for(cmsghdr *cm=CMSG_FIRSTHDR(&msg);cm;cm=CMSG_NXTHDR(&msg,cm))
+            {
+                if(cm->cmsg_level!=SOL_SOCKET||cm->cmsg_type!=SCM_TIMESTAMPING)
+                    continue;
+
+                scm_timestamping ts;
+
+                memcpy(&ts,CMSG_DATA(cm),sizeof(scm_timestamping));
+
+                const timespec &t=(ts.ts[2].tv_sec||ts.ts[2].tv_nsec)?ts.ts[2]:ts.ts[0];   //ts[2]为网卡硬件时间，ts[0]为软件时间
+
+                last_timestamp=int64(t.tv_sec)*HGL_NANO_SEC_PER_SEC+t.tv_nsec;
+            }
+
+            return(result);
+        #else
+            return recv(sock,(char *)buf,size,0);
+        #endif//HGL_OS == HGL_OS_Linux
+        }
+
+        /**
+        * 以一次recv向预读缓冲区中追加数据(未读数据先移到缓冲区头部)
+        * @return 本次读取的字节数，与RecvOnce相同
+        */
+        int64 SocketInputStream::FillBuffer()
+        {
+            if(read_pos>=read_end)
+            {
+                read_pos=0;
+                read_end=0;
+            }
+            else if(read_pos>0)
+            {
+                memmove(read_buffer,read_buffer+read_pos,read_end-read_pos);
+                read_end-=read_pos;
+                read_pos=0;
+            }
+
+            if(read_end>=read_buffer_size)
+                return(0);
+
+            const int64 result=RecvOnce(read_buffer+read_end,read_buffer_size-read_end);
+
+            if(result>0)
+                read_end+=result;
+
+            return(result);
+        }
+
+        /**
+        * 从预读缓冲区中取出最多size字节
+        */
+        int64 SocketInputStream::TakeBuffer(void *buf,int64 size)
+        {
+            const int64 n=hgl_min<int64>(size,read_end-read_pos);
+
+            if(n<=0)return(0);
+
+            memcpy(buf,read_buffer+read_pos,n);
+            read_pos+=n;
+
+            return(n);
+        }
+
+        /**
+        * 从socket中读取指定的字节数<br>
+        * 开启预读时优先从缓冲区中取，缓冲区为空且读取量小于缓冲区时先以一次recv填充缓冲区
         * @param buf 数据保存缓冲区
         * @param size 预想读取的字节数
         * @return 成功读取的字节数
@@ -45,46 +198,55 @@ namespace hgl
         {
             if(sock==-1)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::Read() fatal error,sock=-1"));
+                NET_LOG_ERROR("SocketInputStream::Read() fatal error,sock=-1");
                 return(-1);
             }
 
             if(size==0)return(0);
             if(size<0)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::Read() fatal error,size<0,sock=")+OSString::numberOf(sock));
+                NET_LOG_ERROR("SocketInputStream::Read() fatal error,size<0,sock={}",sock);
                 return(-3);
             }
 
             if(!buf)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::Read() fatal error,buf=nullptr,sock=")+OSString::numberOf(sock));
+                NET_LOG_ERROR("SocketInputStream::Read() fatal error,buf=nullptr,sock={}",sock);
                 return(-2);
             }
 
-            const int64 result=recv(sock,(char *)buf,size,0);
+            int64 result;
 
-            if(result>0)
+            if(read_buffer&&(read_pos<read_end||size<read_buffer_size))
             {
-                total+=result;
+                if(read_pos>=read_end)
+                {
+                    result=FillBuffer();
 
-//                LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" recv ")+OSString::numberOf(size)+OS_TEXT(" bytes ok,result ")+OSString(result)+OS_TEXT(" total recv ")+OSString(total)+OS_TEXT(" bytes."));
+                    if(result<=0)
+                        return(result);
+                }
+
+                result=TakeBuffer(buf,size);
             }
-            else if(result<0)
+            else
             {
-                int err=GetLastSocketError();
+                result=RecvOnce(buf,size);
+            }
 
-                if(err==nseWouldBlock)
-                    return 0;
+            if(result>0)
+            {
+                total+=result;
 
-                LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" recv ")+OSString::numberOf(size)+OS_TEXT(" bytes failed,error: ")+OSString::numberOf(err)+OS_TEXT(",")+GetSocketString(err));
+//                LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" recv ")+OSString::numberOf(size)+OS_TEXT(" bytes ok,result ")+OSString(result)+OS_TEXT(" total recv ")+OSString(total)+OS_TEXT(" bytes."));
             }
 
             return(result);
         }
 
         /**
-        * 从socket中读取指定的字节数，但不从缓存队列中删除
+        * 从socket中读取指定的字节数，但不从缓存队列中删除<br>
+        * 开启预读时数据读入缓冲区，最多可预览缓冲区大小的数据
         * @param buf 数据保存缓冲区
         * @param size 预想读取的字节数
         * @return 成功读取的字节数
@@ -94,27 +256,44 @@ namespace hgl
         {
             if(sock==-1)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::Peek() fatal error,sock=-1"));
+                NET_LOG_ERROR("SocketInputStream::Peek() fatal error,sock=-1");
                 return(-1);
             }
 
             if(!buf)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::Peek() fatal error,buf=nullptr,sock=")+OSString::numberOf(sock));
+                NET_LOG_ERROR("SocketInputStream::Peek() fatal error,buf=nullptr,sock={}",sock);
                 return(-2);
             }
 
             if(size<=0)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::Peek() fatal error,size<=0,sock=")+OSString::numberOf(sock));
+                NET_LOG_ERROR("SocketInputStream::Peek() fatal error,size<=0,sock={}",sock);
                 return(-3);
             }
 
-            return recv(sock,(char *)buf,size,MSG_PEEK);
+            if(!read_buffer)
+                return recv(sock,(char *)buf,size,MSG_PEEK);
+
+            if(read_end-read_pos<size)                                  //不够时再读一次，已有的数据不受影响
+            {
+                const int64 result=FillBuffer();
+
+                if(result<0&&read_pos>=read_end)
+                    return(result);
+            }
+
+            const int64 n=hgl_min<int64>(size,read_end-read_pos);
+
+            if(n>0)
+                memcpy(buf,read_buffer+read_pos,n);
+
+            return(n);
         }
 
         /**
-        * 从socket中充分读取指定的字节数，无视超时，直接读满指定字节数为止
+        * 从socket中充分读取指定的字节数，无视超时，直接读满指定字节数为止<br>
+        * 开启预读时先取缓冲区中的数据，剩余部分小于缓冲区时经缓冲区读取(多读到的数据留给下一次)，否则直接读到调用者的缓冲区中
         * @param buf 数据保存缓冲区
         * @param size 预想读取的字节数
         * @return 成功读取的字节数
@@ -124,26 +303,25 @@ namespace hgl
         {
             if(sock==-1)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::ReadFully() fatal error,sock=-1"));
+                NET_LOG_ERROR("SocketInputStream::ReadFully() fatal error,sock=-1");
                 return(-1);
             }
 
             if(size==0)return(0);
             if(size<0)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::ReadFully() fatal error,size<0,sock=")+OSString::numberOf(sock));
+                NET_LOG_ERROR("SocketInputStream::ReadFully() fatal error,size<0,sock={}",sock);
                 return(-3);
             }
 
             if(!buf)
             {
-                LOG_ERROR(OS_TEXT("SocketInputStream::ReadFully() fatal error,buf=nullptr,sock=")+OSString::numberOf(sock));
+                NET_LOG_ERROR("SocketInputStream::ReadFully() fatal error,buf=nullptr,sock={}",sock);
                 return(-2);
             }
 
             bool to_first=true;
             int err;
-            const os_char *err_str;
             char *p=(char *)buf;
 
 #if HGL_OS == HGL_OS_Windows
@@ -154,13 +332,26 @@ namespace hgl
             size_t left_bytes = size;
 #endif//HGL_OS == HGL_OS_Windows
 
+            if(read_buffer)
+            {
+                const int64 n=TakeBuffer(p,left_bytes);
+
+                p+=n;
+                left_bytes-=n;
+            }
+
 //             const double start_time=GetDoubleTime();
 
             while(left_bytes>0)
             {
+                const bool use_buffer=(read_buffer&&left_bytes<read_buffer_size);      //缓冲区此时一定是空的
+
                 //如果最后一个参数使用MSG_WAITALL，则无论是否阻塞模式，都会永远阻塞
                 //使用0则会得出一个11号nseTryAgain错误
-                result=recv(sock,p,left_bytes,0);            //似乎windows 2003才开始支持MSG_WAITALL
+                if(use_buffer)
+                    result=recv(sock,read_buffer,read_buffer_size,0);
+                else
+                    result=recv(sock,p,left_bytes,0);            //似乎windows 2003才开始支持MSG_WAITALL
 
                 if(result==0)                               //linux下返回0即为对方断开连接,win/bsd下未验证
                 {
@@ -189,22 +380,24 @@ namespace hgl
 //                             continue;
 //                         }
 
-                        LOG_ERROR(OS_TEXT("SocketInputStream::ReadFully TimeOut,Socket:")+OSString::numberOf(sock));
+                        NET_LOG_ERROR("SocketInputStream::ReadFully TimeOut,Socket:{}",sock);
                     }
 
-                    err_str=GetSocketString(err);
-                    if(err_str)
-                    {
-                        LOG_ERROR(OS_TEXT("SocketInputStream::ReadFully error,Socket:")+OSString::numberOf(sock)+OS_TEXT(",error code=")+OSString::numberOf(err)+OS_TEXT(":")+OSString(err_str));
-                    }
-                    else
-                    {
-                        LOG_ERROR(OS_TEXT("SocketInputStream::ReadFully error,Socket:")+OSString::numberOf(sock)+OS_TEXT(",error code=")+OSString::numberOf(err));
-                    }
+                    NET_LOG_ERROR("SocketInputStream::ReadFully error,Socket:{},error code={}",sock,err);
 
                     sock=-1;
                     break;
                 }
+                else if(use_buffer)
+                {
+                    read_pos=0;
+                    read_end=result;
+
+                    const int64 n=TakeBuffer(p,left_bytes);
+
+                    p+=n;
+                    left_bytes-=n;
+                }
                 else
                 {
                     p+=result;
@@ -232,6 +425,33 @@ namespace hgl
         {
             if(n<=0)return(n);
 
+            if(read_buffer)
+            {
+                const int64 buffered=hgl_min<int64>(n,read_end-read_pos);      //缓冲区中的直接丢弃
+
+                read_pos+=buffered;
+                total+=buffered;
+
+                int64 left=n-buffered;
+
+                while(left>0)                                               //其余的读入缓冲区后丢弃，多读到的留给下一次
+                {
+                    if(FillBuffer()<=0)
+                        break;
+
+                    const int64 drop=hgl_min<int64>(left,read_end-read_pos);
+
+                    read_pos+=drop;
+                    total+=drop;
+                    left-=drop;
+                }
+
+                return(n-left);
+            }
+
+            if(!mb)
+                mb=new DataArray<char>();
+
             mb->SetCount(n);
 
             return ReadFully(mb->data(),n);
@@ -239,6 +459,9 @@ namespace hgl
 
         int64 SocketInputStream::Available()const
         {
+            if(read_pos<read_end)
+                return read_end-read_pos;
+
             int recv_buf_size=0;
             socklen_t len=sizeof(int);
 
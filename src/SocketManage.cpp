@@ -1,156 +1,558 @@
 ﻿#include<hgl/network/SocketManage.h>
+#include<hgl/network/AcceptServer.h>
+#include<hgl/network/DatagramSocket.h>
+#include<hgl/network/HotRestart.h>
 #include<hgl/log/LogInfo.h>
+#include<hgl/network/NetLog.h>
+#include<hgl/Time.h>
 #include"SocketManageBase.h"
+#include<thread>
 
 namespace hgl
 {
     namespace network
     {
-        SocketManage::SocketManage(int max_user)
+        namespace
         {
+            /**
+             * 移除列表中已处理的前count项，保留处理期间新加入的
+             */
+            void RemoveFront(List<ConnectionHandle> &handle_list,const int count)
+            {
+                const int left=handle_list.GetCount()-count;
+
+                if(left>0)
+                    memmove(handle_list.GetData(),handle_list.GetData()+count,left*sizeof(ConnectionHandle));
+
+                handle_list.SetCount(left);
+            }
+        }//namespace
+
+        SocketManage::SocketManage(int mu)
+        {
+            max_user=mu;
             manage=CreateSocketManageBase(max_user);
+
+            cur_time=GetDoubleTime();
+            timer_wheel.Start(cur_time);
         }
 
         SocketManage::~SocketManage()
         {
+            ClearAcceptList();
+
             delete manage;
         }
 
-        void SocketManage::ProcSocketRecvList()
+        /**
+         * 处理本次Update返回的所有socket事件<br>
+         * 同一socket的可写、可读、关闭在同一项中，依次处理：先发送上一帧遗留的数据，再读完剩余数据，最后才处理关闭
+         */
+        void SocketManage::ProcSocketEventList()
         {
-            const int count=sock_recv_list.GetCount();
+            const int count=sock_event_list.GetCount();
 
             if(count<=0)return;
 
-            SocketEvent *se=sock_recv_list.GetData();
-            TCPAccept *sock;
+            SocketEvent *se=sock_event_list.GetData();
 
-            for(int i=0;i<count;i++)
+            metrics.event_count.Add(count);
+            metrics.max_event_per_update.Max(count);
+
+            for(int i=0;i<count;i++,se++)
             {
-                if(socket_list.Get(se->sock,sock))
+                if(se->datagram)
+                {
+                    ProcDatagram(se);
+                    continue;
+                }
+
+                if(se->accept->tls                          //TLS握手期间的可读事件交给握手处理
+                 &&!se->accept->connecting
+                 &&(se->events&SOCKET_EVENT_RECV))
                 {
-                    if(sock->OnSocketRecv(se->error)<0)
+                    const int result=se->accept->ProcTLSHandshake();
+
+                    if(result<0)
                     {
-                        LOG_INFO(OS_TEXT("OnSocketRecv return Error,sock:")+OSString::numberOf(se->sock));
-                        error_sets.Add(sock);
+                        NET_LOG_INFO("TLS handshake failed,sock:{}",se->sock);
+                        conn_table.MarkError(se->accept);
+                        continue;
                     }
+
+                    if(result==0)
+                        se->events&=~SOCKET_EVENT_RECV;
+                    else
+                        se->events|=SOCKET_EVENT_SEND;      //刚完成握手，接着收可能已到达的数据，并发出握手期间存入队列的数据
                 }
-                else
+
+                if(se->events&SOCKET_EVENT_SEND)
                 {
-                    LOG_ERROR(OS_TEXT("Fatal error,can't find socket in SocketList,sock is ")+OSString::numberOf(se->sock));
+                    if(se->accept->OnSocketSend(se->size)<0)
+                    {
+                        NET_LOG_INFO("OnSocketSend return Error,sock:{}",se->sock);
+                        conn_table.MarkError(se->accept);
+                        continue;
+                    }
                 }
 
-                ++se;
+                if(se->events&SOCKET_EVENT_RECV)
+                {
+                    se->accept->last_recv_time=cur_time;    //只记录时间，接收超时定时器到期时再检查，不需要每次都调整时间轮
+
+                    const int result=se->accept->OnSocketRecv(se->size);
+
+                    if(result<0)
+                    {
+                        NET_LOG_INFO("OnSocketRecv return Error,sock:{}",se->sock);
+                        conn_table.MarkError(se->accept);
+                        continue;
+                    }
+
+                    metrics.recv_event_count.Add();             //一次可读事件中会一直读到没有数据为止，这里统计的是每次事件的字节数
+                    metrics.recv_bytes.Add(result);
+                }
+
+                if(se->events&SOCKET_EVENT_CLOSE)
+                {
+                    NET_LOG_INFO("SocketError,sock:{},errno:{}",se->sock,se->error);
+                    se->accept->OnSocketError(se->error);
+                    conn_table.MarkError(se->accept);
+                }
             }
 
-            sock_recv_list.Clear();
+            sock_event_list.Clear();
         }
 
-        void SocketManage::ProcSocketSendList()
+        /**
+         * 处理UDPSocket的事件<br>
+         * UDP的错误通常只是之前发出的数据报收到了ICMP错误(如端口不可达)，读出并清除SO_ERROR后继续使用，不移出管理器
+         */
+        void SocketManage::ProcDatagram(SocketEvent *se)
         {
-            const int count=sock_send_list.GetCount();
+            DatagramSocket *udp=se->datagram;
+
+            if(se->events&SOCKET_EVENT_ERROR)
+            {
+                int err=0;
+                socklen_t len=sizeof(err);
+
+                getsockopt(udp->ThisSocket,SOL_SOCKET,SO_ERROR,(char *)&err,&len);
+
+                NET_LOG_INFO("DatagramSocket error,sock:{},errno:{}",se->sock,err?err:se->error);
+            }
+
+            if(!(se->events&SOCKET_EVENT_RECV))
+                return;
+
+            metrics.recv_event_count.Add();
+
+            while(udp->ProcRecv(se->size)>0);           //边缘模式，一直处理到没有数据为止
+        }
+
+        /**
+         * 给每个UDPSocket一次定时处理的机会，记录最早需要再次处理的时间
+         */
+        void SocketManage::ProcDatagramUpdate()
+        {
+            datagram_next_time=-1;
+
+            for(DatagramSocket *udp:datagram_list)
+            {
+                const double t=udp->ProcUpdate(cur_time);
+
+                if(t<0)continue;
+
+                if(datagram_next_time<0||cur_time+t<datagram_next_time)
+                    datagram_next_time=cur_time+t;
+            }
+        }
+
+        void SocketManage::ProcErrorList()
+        {
+            const TCPAcceptList &error_list=conn_table.GetErrorList();
+
+            const int count=error_list.GetCount();
 
             if(count<=0)return;
 
-            SocketEvent *se=sock_send_list.GetData();
-            TCPAccept *sock;
+            TCPAccept **sp=error_list.GetData();
+
+            metrics.error_count.Add(count);
 
             for(int i=0;i<count;i++)
             {
-                if(socket_list.Get(se->sock,sock))
-                {
-                    if(sock->OnSocketSend(se->size)<0)
-                    {
-                        LOG_INFO(OS_TEXT("OnSocketSend return Error,sock:")+OSString::numberOf(se->sock));
-                        error_sets.Add(sock);
-                    }
-                }
-                else
-                {
-                    LOG_ERROR(OS_TEXT("Fatal error,can't find socket in SocketList,sock is ")+OSString::numberOf(se->sock));
-                }
+                Unjoin(*sp);
+                ++sp;
+            }
+
+            //错误列表不在这里清除，在主循环的一开始，参见那里的注释
+        }
+
+        /**
+         * 监听socket就绪，接入所有等待中的连接(边缘模式，必须一直accept到没有为止)
+         */
+        void SocketManage::ProcAccept()
+        {
+            const IPAddress *server_ip=listen_server->GetServerAddress();
+
+            AcceptedSocket as;
 
-                ++se;
+            as.address=SocketAddress(server_ip->GetSocketType(),server_ip->GetProtocol());
+
+            while(true)
+            {
+                as.sock=listen_server->AcceptNonBlock(&as.address);     //直接写入as.address，不再需要地址池
+
+                if(as.sock<=0)
+                    break;
+
+                accept_list.Add(as);
+                metrics.accept_count.Add();
             }
+        }
 
-            sock_send_list.Clear();
+        void SocketManage::ClearAcceptList()
+        {
+            accept_list.Clear();
         }
 
-        void SocketManage::ProcSocketErrorList()
+        bool SocketManage::JoinListen(AcceptServer *as)
         {
-            const int count=sock_error_list.GetCount();
+            if(!as||listen_server)
+                return(false);
 
-            if(count<=0)return;
+            if(!manage->JoinListen(as->GetSocket()))
+                return(false);
 
-            SocketEvent *se=sock_error_list.GetData();
-            TCPAccept *sock;
+            listen_server=as;
+            return(true);
+        }
 
-            for(int i=0;i<count;i++)
+        void SocketManage::UnjoinListen()
+        {
+            if(!listen_server)
+                return;
+
+            manage->UnjoinListen();
+            listen_server=nullptr;
+        }
+
+        int SocketManage::Handoff(HotRestartSender *hs,TCPAcceptList &done)
+        {
+            if(!hs)return(-1);
+
+            if(hs->IsFinished())                            //等待超时，还没转交的连接留在本进程继续服务
             {
-                if(socket_list.Get(se->sock,sock))
+                for(int i=0;i<conn_table.GetCount();i++)
+                    conn_table.GetData()[i]->ResumeRecv();
+
+                return(-1);
+            }
+
+            DataArray<uchar> state;
+
+            int wait_count=0;
+
+            for(int i=conn_table.GetCount()-1;i>=0;i--)     //分离时会用最后一个填补，所以倒着处理
+            {
+                TCPAccept *s=conn_table.GetData()[i];
+
+                if(s->handoff_refused
+                 ||s->connecting
+                 ||s->tls
+                 ||s->close_after_send)
+                    continue;
+
+                s->PauseRecv();
+
+                if(!s->send_queue.IsEmpty()
+                 ||s->send_queue.GetZeroCopyPending()>0)    //内核还在引用零拷贝发送的数据
                 {
-                    LOG_INFO(OS_TEXT("SocketError,sock:")+OSString::numberOf(se->sock)+OS_TEXT(",errno:")+OSString::numberOf(se->error));
-                    sock->OnSocketError(se->error);
-                    error_sets.Add(sock);
+                    ++wait_count;
+                    continue;
                 }
-                else
+
+                state.SetCount(0);
+
+                if(!s->SaveHandoffState(state))
+                {
+                    s->handoff_refused=true;
+                    s->ResumeRecv();
+                    continue;
+                }
+
+                if(!hs->SendConnection(s->ThisSocket,conn_table.GetOwner(),s->GetAddress(),state.GetData(),uint(state.GetCount())))
                 {
-                    LOG_ERROR(OS_TEXT("Fatal error,can't find socket in SocketList,sock is ")+OSString::numberOf(se->sock));
+                    for(int n=0;n<conn_table.GetCount();n++)    //新进程已不能接收，全部留在本进程继续服务
+                        conn_table.GetData()[n]->ResumeRecv();
+
+                    return(-1);
                 }
 
-                ++se;
+                const int sock=s->ThisSocket;
+
+                Unjoin(s);                                  //先从epoll等中移除，socket在新进程中仍然有效，关闭前不移除会一直收到它的事件
+
+                s->ThisSocket=-1;
+                CloseHandoffSocket(sock);
+
+                done.Add(s);
             }
 
-            sock_error_list.Clear();
+            return wait_count;
         }
 
-        void SocketManage::ProcErrorList()
+        void SocketManage::OnJoined(TCPAccept *s)
         {
-            const int count=error_sets.GetCount();
+            s->sock_manage=this;
+            s->send_watch=false;
 
-            if(count<=0)return;
+            if(s->connecting                                //主动发起的连接，可写时即连接完成
+             ||!s->send_queue.IsEmpty())                    //加入前就有未发完的数据
+                s->send_watch=SetSendWatch(s,true);
+            else
+            if(s->recv_pause)                               //加入前就暂停了接收
+                manage->Change(s,false,false);
+
+            s->idle_timer.owner=s;
+            s->user_timer.owner=s;
+            s->last_recv_time=GetDoubleTime();
+
+            s->latency_trace=latency_trace;
+            s->trace_dispatch_time=0;
+
+            if(latency_trace)
+                SetSocketRecvTimestamp(s->ThisSocket,true);
+
+            if(traffic_capture&&!s->capture_id)             //迁移过来的连接保留原来的编号
+            {
+                s->traffic_capture=traffic_capture;
+                s->capture_id=traffic_capture->OpenConnection();
+            }
+
+            RestartIdleTimer(s);
+            RestartUserTimer(s);
+
+            s->OnSocketJoin();
+        }
 
-            TCPAccept **sp=error_sets.GetData();
+        void SocketManage::OnUnjoined(TCPAccept *s)
+        {
+            timer_wheel.Remove(&s->idle_timer);
+            timer_wheel.Remove(&s->user_timer);
+
+            if(s->send_watch)
+                metrics.send_watch_count.Sub();
+
+            s->OnSocketUnjoin();                            //在这里归还借用本管理器的资源
+            s->sock_manage=nullptr;
+            s->handle=HGL_INVALID_CONNECTION_HANDLE;
+            s->send_watch=false;
+            s->flush_pending=false;
+        }
+
+        void SocketManage::RestartIdleTimer(TCPAccept *s)
+        {
+            if(!s||s->sock_manage!=this)return;
+
+            const double to=GetIdleTimeOut(s);
+
+            if(to>0)
+                timer_wheel.Add(&s->idle_timer,s->last_recv_time+to);
+            else
+                timer_wheel.Remove(&s->idle_timer);
+        }
+
+        void SocketManage::RestartUserTimer(TCPAccept *s)
+        {
+            if(!s||s->sock_manage!=this)return;
+
+            if(s->timer_interval>0)
+                timer_wheel.Add(&s->user_timer,GetDoubleTime()+s->timer_interval);
+            else
+                timer_wheel.Remove(&s->user_timer);
+        }
+
+        /**
+         * 设置缺省接收超时时间，对已加入且未单独设置超时的连接同样生效
+         * @param to 超时时间(秒)，<=0表示不检测
+         */
+        void SocketManage::SetIdleTimeOut(const double to)
+        {
+            idle_time_out=to;
+
+            const int count=conn_table.GetCount();
+            TCPAccept **sp=conn_table.GetData();
 
             for(int i=0;i<count;i++)
             {
-                Unjoin(*sp);
+                if((*sp)->idle_time_out<=0)
+                    RestartIdleTimer(*sp);
+
                 ++sp;
             }
+        }
+
+        /**
+         * 处理到期的定时器<br>
+         * 接收超时定时器到期时，如果期间收到过数据则按最后接收时间重新加入，否则视为出错
+         */
+        void SocketManage::ProcTimer()
+        {
+            if(timer_wheel.GetCount()<=0)return;
+
+            timer_expired_list.Clear();
+
+            const int count=timer_wheel.Update(cur_time,timer_expired_list);
+
+            if(count<=0)return;
+
+            metrics.timer_count.Add(count);
 
-            //error_set不在这里ClearData，在主循环的一开始，参见那里的注释
+            TimerNode **tp=timer_expired_list.GetData();
+
+            for(int i=0;i<count;i++)
+            {
+                TimerNode *node=*tp;
+                TCPAccept *s=(TCPAccept *)(node->owner);
+
+                ++tp;
+
+                if(node==&s->idle_timer)
+                {
+                    const double to=GetIdleTimeOut(s);
+
+                    if(to<=0)continue;
+
+                    if(s->recv_pause)                           //暂停接收期间不算空闲
+                    {
+                        timer_wheel.Add(node,cur_time+to);
+                        continue;
+                    }
+
+                    if(s->last_recv_time+to>cur_time)           //期间收到过数据
+                    {
+                        timer_wheel.Add(node,s->last_recv_time+to);
+                        continue;
+                    }
+
+                    if(s->OnIdleTimeOut())
+                    {
+                        s->last_recv_time=cur_time;
+                        timer_wheel.Add(node,cur_time+to);
+                    }
+                    else
+                    {
+                        NET_LOG_INFO("Socket recv timeout,sock:{}",s->ThisSocket);
+                        conn_table.MarkError(s);
+                    }
+                }
+                else
+                {
+                    if(!s->OnTimer())
+                    {
+                        conn_table.MarkError(s);
+                        continue;
+                    }
+
+                    if(s->timer_interval>0&&!node->IsActive())  //OnTimer中可能已经重新设置过
+                        timer_wheel.Add(node,cur_time+s->timer_interval);
+                }
+            }
+
+            timer_expired_list.Clear();
         }
 
         bool SocketManage::Join(TCPAccept *s)
         {
             if(!s)return(false);
 
-            if(!socket_list.Add(s->ThisSocket,s))
+            const ConnectionHandle h=conn_table.Add(s);
+
+            if(h==HGL_INVALID_CONNECTION_HANDLE)
             {
-                LOG_ERROR(OS_TEXT("repeat append socket to manage,sock:")+OSString::numberOf(s->ThisSocket));
+                NET_LOG_ERROR("repeat append socket to manage,sock:{}",s->ThisSocket);
                 return(false);
             }
 
-            if(!manage->Join(s->ThisSocket))
+            if(!manage->Join(s))
             {
-                socket_list.DeleteByKey(s->ThisSocket);
+                conn_table.Remove(s);
                 return(false);
             }
 
+            s->handle=h;
+
+            OnJoined(s);
             return(true);
         }
 
+        /**
+         * 批量加入，查重表只扩容一次，并交由SocketManageBase合并系统调用
+         * @param s_list 要加入的对象列表，加入失败的对象会被置为nullptr
+         * @param count 对象数量
+         * @return 成功加入的数量
+         */
         int SocketManage::Join(TCPAccept **s_list,int count)
         {
             if(!s_list||count<=0)
                 return(-1);
 
-            int total=0;
+            conn_table.PreAlloc(conn_table.GetCount()+count);
+            batch_list.SetCount(0);
+
+            int repeat=0;
+
+            for(int i=0;i<count;i++)
+            {
+                TCPAccept *s=s_list[i];
+
+                if(!s)continue;
+
+                const ConnectionHandle h=conn_table.Add(s);
+
+                if(h==HGL_INVALID_CONNECTION_HANDLE)
+                {
+                    s_list[i]=nullptr;
+                    ++repeat;
+                    continue;
+                }
+
+                s->handle=h;
+
+                batch_list.Add(s);
+            }
+
+            if(repeat>0)
+                NET_LOG_ERROR("repeat append socket to manage,count:{}",repeat);
+
+            const int batch_count=batch_list.GetCount();
+
+            if(batch_count<=0)
+                return(0);
+
+            const int total=manage->Join(batch_list.GetData(),batch_count);
+
+            //batch_list与s_list中非空的项一一对应，失败的项已被SocketManageBase置为nullptr
+            TCPAccept **bp=batch_list.GetData();
 
             for(int i=0;i<count;i++)
             {
-                if(this->Join(s_list[i]))
-                    ++total;
+                if(!s_list[i])continue;
+
+                if(*bp)
+                {
+                    OnJoined(*bp);
+                }
+                else
+                {
+                    conn_table.Remove(s_list[i]);
+                    s_list[i]->handle=HGL_INVALID_CONNECTION_HANDLE;
+                    s_list[i]=nullptr;
+                }
+
+                ++bp;
             }
 
             return total;
@@ -160,64 +562,501 @@ namespace hgl
         {
             if(!s)return(false);
 
-            if(!socket_list.DeleteByKey(s->ThisSocket))
+            if(!conn_table.Remove(s))
             {
-                LOG_ERROR(OS_TEXT("socket don't in SocketManage,sock:")+OSString::numberOf(s->ThisSocket));
+                NET_LOG_ERROR("socket don't in SocketManage,sock:{}",s->ThisSocket);
                 return(false);
             }
 
-            manage->Unjoin(s->ThisSocket);      //unjoin理论上不存在失败
+            manage->Unjoin(s);                  //unjoin理论上不存在失败
 
+            OnUnjoined(s);
             return(true);
         }
 
+        /**
+         * 批量分离，不在本管理器中的对象会被跳过
+         * @return 成功分离的数量
+         */
         int SocketManage::Unjoin(TCPAccept **s_list,int count)
         {
             if(!s_list||count<=0)
                 return(-1);
 
-            int total=0;
+            batch_list.SetCount(0);
 
             for(int i=0;i<count;i++)
             {
-                if(this->Unjoin(s_list[i]))
-                    ++total;
+                TCPAccept *s=s_list[i];
+
+                if(!s)continue;
+
+                if(conn_table.Remove(s))
+                    batch_list.Add(s);
             }
 
-            return total;
+            const int batch_count=batch_list.GetCount();
+
+            if(batch_count<count)
+                NET_LOG_ERROR("socket don't in SocketManage,count:{}",count-batch_count);
+
+            if(batch_count<=0)
+                return(0);
+
+            return UnjoinBatch();
         }
 
-        int SocketManage::Update(const double &time_out)
+        /**
+         * 将batch_list中的对象从SocketManageBase中分离(已从conn_table中移除)
+         */
+        int SocketManage::UnjoinBatch()
+        {
+            const int batch_count=batch_list.GetCount();
+            TCPAccept **bp=batch_list.GetData();
+
+            manage->Unjoin(bp,batch_count);
+
+            for(int i=0;i<batch_count;i++)
+            {
+                OnUnjoined(*bp);
+                ++bp;
+            }
+
+            batch_list.SetCount(0);
+            return batch_count;
+        }
+
+        bool SocketManage::JoinDatagram(DatagramSocket *udp)
+        {
+            if(!udp||udp->ThisSocket<0)return(false);
+
+            if(datagram_list.Find(udp)!=-1)
+            {
+                NET_LOG_ERROR("repeat append DatagramSocket to manage,sock:{}",udp->ThisSocket);
+                return(false);
+            }
+
+            if(!manage->JoinDatagram(udp))
+                return(false);
+
+            datagram_list.Add(udp);
+            return(true);
+        }
+
+        bool SocketManage::UnjoinDatagram(DatagramSocket *udp)
+        {
+            if(!udp)return(false);
+
+            const int index=datagram_list.Find(udp);
+
+            if(index==-1)
+            {
+                NET_LOG_ERROR("DatagramSocket don't in SocketManage,sock:{}",udp->ThisSocket);
+                return(false);
+            }
+
+            manage->UnjoinDatagram(udp);
+            datagram_list.Delete(index);
+            return(true);
+        }
+
+        bool SocketManage::Wake()
+        {
+            return manage->Wake();
+        }
+
+        bool SocketManage::SetSendWatch(TCPAccept *s,bool watch)
+        {
+            if(!s)return(false);
+
+            const bool result=manage->Change(s,!s->recv_pause,watch);
+
+            if(!watch)
+                metrics.send_watch_count.Sub();             //只有之前关注成功的才会取消
+            else
+            if(result)
+                metrics.send_watch_count.Add();
+
+            return result;
+        }
+
+        bool SocketManage::SetRecvWatch(TCPAccept *s,bool watch)
+        {
+            if(!s)return(false);
+
+            if(!manage->Change(s,watch,s->send_watch))
+                return(false);
+
+            if(watch)
+                resume_list.Add(s->handle);                 //暂停时留在接收缓冲区中的数据不会再有可读事件通知
+
+            return(true);
+        }
+
+        /**
+         * 在Update中以一次没有可读事件的OnSocketRecv回调该连接(如在事件循环中开始处理一个刚加入的连接)<br>
+         * 可在Update之外调用，下一次Update不会等待
+         */
+        void SocketManage::ScheduleRecv(TCPAccept *s)
+        {
+            if(!s||s->sock_manage!=this)return;
+
+            resume_list.Add(s->handle);
+        }
+
+        /**
+         * 处理恢复接收的连接：以一次没有可读事件的OnSocketRecv处理接收缓冲区中留下的数据，并继续读socket
+         */
+        void SocketManage::ProcResumeList()
+        {
+            const int count=resume_list.GetCount();         //回调中新恢复的连接留到下一次
+
+            for(int i=0;i<count;i++)
+            {
+                TCPAccept *s=conn_table.Get(resume_list.GetData()[i]);
+
+                if(!s||s->recv_pause)                       //已被移出或又暂停了
+                    continue;
+
+                const int result=s->OnSocketRecv(0);
+
+                if(result<0)
+                {
+                    NET_LOG_INFO("OnSocketRecv return Error,sock:{}",s->ThisSocket);
+                    conn_table.MarkError(s);
+                    continue;
+                }
+
+                if(result>0)
+                {
+                    s->last_recv_time=cur_time;
+                    metrics.recv_bytes.Add(result);
+                }
+            }
+
+            RemoveFront(resume_list,count);
+        }
+
+        /**
+         * 延迟发送模式下，将连接加入待发送列表，在本次Update结束时统一发出
+         */
+        void SocketManage::DeferFlush(TCPAccept *s)
         {
-            //将error_set放在这里，是为了保留它给外面的调用者使用
-            error_sets.Clear();
+            if(s->flush_pending)return;
 
-            const int count=manage->Update(time_out,sock_recv_list,sock_send_list,sock_error_list);
+            s->flush_pending=true;
+            flush_list.Add(s->handle);
+        }
+
+        void SocketManage::SetTCPInfoInterval(const double interval)
+        {
+            tcp_info_interval=interval;
+            tcp_info_time=GetDoubleTime();
+            tcp_info_credit=0;
+        }
+
+        /**
+         * 轮流采样一部分连接的TCP_INFO，采样数量按经过的时间平摊，连接很多时每次Update也只多几次getsockopt
+         */
+        void SocketManage::ProcTCPInfo()
+        {
+            const int count=conn_table.GetCount();
 
             if(count<=0)
+            {
+                tcp_info_time=cur_time;
+                tcp_info_credit=0;
+                return;
+            }
+
+            tcp_info_credit+=count*(cur_time-tcp_info_time)/tcp_info_interval;
+            tcp_info_time=cur_time;
+
+            if(tcp_info_credit<1)
+                return;
+
+            int n=int(tcp_info_credit);
+
+            if(n>count)                                     //长时间没有Update时，每个连接最多采样一次
+            {
+                n=count;
+                tcp_info_credit=0;
+            }
+            else
+            {
+                tcp_info_credit-=n;
+            }
+
+            for(int i=0;i<n;i++)
+            {
+                if(tcp_info_cursor>=conn_table.GetCount())  //连接被移出时列表会用最后一个填补，顺序变化也不要紧
+                    tcp_info_cursor=0;
+
+                if(conn_table.GetCount()<=0)
+                    break;
+
+                TCPAccept *s=conn_table.GetData()[tcp_info_cursor++];
+
+                if(s->connecting||s->tls)
+                    continue;
+
+                const uint32 old_retrans=s->tcp_info.total_retrans;
+
+                if(!s->ReadTCPInfo(s->tcp_info))
+                    continue;
+
+                s->tcp_info.sample_time=cur_time;
+
+                metrics.tcp_info_count.Add();
+                metrics.rtt.Add(double(s->tcp_info.rtt)/HGL_MICRO_SEC_PER_SEC);
+
+                if(s->tcp_info.total_retrans>old_retrans)
+                    metrics.retrans_count.Add(s->tcp_info.total_retrans-old_retrans);
+
+                if(!s->OnTCPInfo(s->tcp_info))
+                    conn_table.MarkError(s);
+            }
+        }
+
+        bool SocketManage::SetBusyPoll(const SocketBusyPollConfig &cfg)
+        {
+            if(!manage)
+                RETURN_FALSE;
+
+            if(!manage->SetBusyPoll(cfg))                   //当前管理器没有内核忙轮循
+            {
+                if(conn_table.GetCount()>0||listen_server||datagram_list.GetCount()>0)
+                {
+                    LOG_ERROR(OS_TEXT("SocketManage::SetBusyPoll() must be called before any socket joined."));
+                    return(false);
+                }
+
+                SocketManageBase *bp=CreateSocketManageBusyPoll(max_user,cfg);
+
+                if(bp)
+                {
+                    delete manage;
+                    manage=bp;
+                }
+                else
+                {
+                    LOG_INFO(OS_TEXT("SocketManage::SetBusyPoll() kernel busy poll unsupported,only spin in user space."));
+                }
+            }
+
+            busy_poll=true;
+            busy_poll_config=cfg;
+            busy_poll_idle=0;
+            return(true);
+        }
+
+        /**
+         * 发出延迟发送列表中各连接积攒的数据，每个连接一次writev<br>
+         * 发不完的部分照常关注可写事件
+         */
+        void SocketManage::ProcFlushList()
+        {
+            const int count=flush_list.GetCount();          //回调中新加入的留到下一次
+
+            for(int i=0;i<count;i++)
+            {
+                TCPAccept *s=conn_table.Get(flush_list.GetData()[i]);
+
+                if(!s)continue;                             //已被移出
+
+                s->flush_pending=false;
+
+                if(s->connecting||s->tls||s->send_watch)    //连接/握手完成或可写时会发出
+                    continue;
+
+                if(s->OnSocketSend(0)<0)
+                {
+                    NET_LOG_INFO("OnSocketSend return Error,sock:{}",s->ThisSocket);
+                    conn_table.MarkError(s);
+                    continue;
+                }
+
+                if(!s->send_queue.IsEmpty()&&!s->send_watch)
+                    s->send_watch=SetSendWatch(s,true);
+            }
+
+            RemoveFront(flush_list,count);
+        }
+
+        /**
+         * 将共享数据块发给本管理器中的所有连接，数据只有一份，发不完的部分各连接的发送队列只持有引用
+         * @param sb 共享数据块(调用者仍持有自己的引用)
+         * @return 成功发出或存入发送队列的连接数量
+         */
+        int SocketManage::Broadcast(SharedBuffer *sb)
+        {
+            if(!sb)return(-1);
+
+            const int count=conn_table.GetCount();
+            TCPAccept **sp=conn_table.GetData();
+
+            int result=0;
+
+            for(int i=0;i<count;i++)
+            {
+                if((*sp)->SendShared(sb))
+                    ++result;
+
+                ++sp;
+            }
+
+            return result;
+        }
+
+        /**
+         * 将共享数据块发给指定的连接，不属于本管理器的连接会被跳过
+         * @return 成功发出或存入发送队列的连接数量
+         */
+        int SocketManage::Broadcast(SharedBuffer *sb,TCPAccept **s_list,int count)
+        {
+            if(!sb||!s_list||count<=0)return(-1);
+
+            int result=0;
+
+            for(int i=0;i<count;i++)
+            {
+                TCPAccept *s=s_list[i];
+
+                if(!s||s->sock_manage!=this)
+                    continue;
+
+                if(s->SendShared(sb))
+                    ++result;
+            }
+
+            return result;
+        }
+
+        int SocketManage::Update(const double &time_out)
+        {
+            //将error_set/accept_list放在这里，是为了保留它给外面的调用者使用
+            conn_table.ClearErrorList();
+            ClearAcceptList();
+
+            double wait_time=time_out;
+
+            if(timer_wheel.GetCount()>0)    //不能睡过下一个定时器
+            {
+                const double next=timer_wheel.GetNextTimeOut(GetDoubleTime());
+
+                if(wait_time<0||next<wait_time)
+                    wait_time=next;
+            }
+
+            if(datagram_next_time>=0)       //DatagramSocket的重传/心跳
+            {
+                const double next=hgl_max(datagram_next_time-GetDoubleTime(),0.0);
+
+                if(wait_time<0||next<wait_time)
+                    wait_time=next;
+            }
+
+            if(flush_list.GetCount()>0)     //上次Update之后(如Join、跨线程发送、广播时)积攒的数据，在等待前发出
+                ProcFlushList();
+
+            if(resume_list.GetCount()>0)    //恢复接收的连接需要马上处理
+                wait_time=0;
+
+            if(busy_poll&&wait_time!=0)     //忙轮循：先空转，再逐步退让，长时间没有事件才阻塞
+            {
+                const SocketBusyPollConfig &bp=busy_poll_config;
+
+                if(busy_poll_idle<bp.spin_count)
+                {
+                    wait_time=0;
+                }
+                else if(busy_poll_idle-bp.spin_count<bp.yield_count)
+                {
+                    std::this_thread::yield();
+                    wait_time=0;
+                }
+                else if(bp.idle_wait_time>=0&&(wait_time<0||bp.idle_wait_time<wait_time))
+                {
+                    wait_time=bp.idle_wait_time;
+                }
+            }
+
+            const int count=manage->Update(wait_time,sock_event_list);
+
+            if(count<0)
                 return(count);
 
-            ProcSocketSendList();       //这是上一帧的，所以先发。未来可能考虑改成另建一批线程发送
-            ProcSocketRecvList();
-            ProcSocketErrorList();
+            if(busy_poll)
+            {
+                if(count>0)
+                    busy_poll_idle=0;
+                else if(busy_poll_idle<0xFFFFFFFF)
+                    ++busy_poll_idle;
+            }
+
+            cur_time=GetDoubleTime();
+
+            if(count>0)
+            {
+                if(listen_server&&manage->CheckListenReady())
+                    ProcAccept();
+
+                ProcSocketEventList();      //每个socket先发上一帧遗留的数据，再收，最后处理关闭
+            }
+
+            ProcTimer();
+
+            if(tcp_info_interval>0)
+                ProcTCPInfo();
+
+            if(resume_list.GetCount()>0)
+                ProcResumeList();
+
+            if(flush_list.GetCount()>0)     //本次Update中各事件、定时器里发送的数据，每个连接合并为一次发出
+                ProcFlushList();
+
+            if(datagram_list.GetCount()>0)
+                ProcDatagramUpdate();
+
             ProcErrorList();            //这里仅仅是将Socket从列表中移除，并没有删掉。
 
+            metrics.update_count.Add();
+            metrics.connection_count.Set(conn_table.GetCount());
+
+            if(count>0)
+                metrics.dispatch_time.Add(GetDoubleTime()-cur_time);
+
             return count;
         }
 
         void SocketManage::Clear()
         {
-            const int count=socket_list.GetCount();
-            auto **us=socket_list.GetDataList();
-
-            for(int i=0;i<count;i++)
             {
-                Unjoin((*us)->value);
+                DatagramSocket **up=datagram_list.GetData();
+
+                for(int i=0;i<datagram_list.GetCount();i++)
+                {
+                    manage->UnjoinDatagram(*up);
+                    ++up;
+                }
 
-                ++us;
+                datagram_list.Clear();
             }
 
-            socket_list.Clear();
+            resume_list.Clear();
+            flush_list.Clear();
+
+            const int count=conn_table.GetCount();
+
+            if(count<=0)return;
+
+            batch_list.SetCount(count);
+
+            memcpy(batch_list.GetData(),conn_table.GetData(),count*sizeof(TCPAccept *));
+
+            conn_table.Clear();                 //先清空连接表，不在遍历中逐个删除
+
+            UnjoinBatch();
         }
     }//namespace network
 }//namespace hgl
@@ -6,30 +6,103 @@ namespace hgl
 {
     namespace network
     {
+        class TCPAccept;
+        class DatagramSocket;
+        struct SocketBusyPollConfig;
+
         /**
-         * Socket基础管理
+         * Socket基础管理<br>
+         * 加入时记录TCPAccept指针，轮循得到的SocketEvent会直接带回该指针，上层分发时无需再按socket查表
          */
         class SocketManageBase
         {
+        protected:
+
+            bool listen_ready=false;                                                                ///<Update中监听socket是否有新连接
+
         public:
 
             virtual ~SocketManageBase()=default;
 
-            virtual bool Join(int)=0;                                                               ///<加入一个Socket
-//            virtual bool Join(const int *,int)=0;                                                 ///<加入一批Socket
-            virtual bool Unjoin(int)=0;                                                             ///<分离一个Socket
-//            virtual bool Unjoin(const int *,int)=0;                                               ///<分离一批Socket
+            virtual bool Join(TCPAccept *)=0;                                                       ///<加入一个Socket(socket需已是非阻塞模式)
+            virtual bool Unjoin(TCPAccept *)=0;                                                     ///<分离一个Socket
+
+            /**
+             * 加入一批Socket，缺省逐个加入，能合并系统调用的管理器自行重载
+             * @return 成功加入的数量，失败的对象在列表中被置为nullptr
+             */
+            virtual int Join(TCPAccept **sock_list,int count)
+            {
+                int total=0;
+
+                for(int i=0;i<count;i++)
+                {
+                    if(Join(sock_list[i]))
+                        ++total;
+                    else
+                        sock_list[i]=nullptr;
+                }
+
+                return total;
+            }
+
+            /**
+             * 分离一批Socket，缺省逐个分离
+             * @return 成功分离的数量
+             */
+            virtual int Unjoin(TCPAccept **sock_list,int count)
+            {
+                int total=0;
+
+                for(int i=0;i<count;i++)
+                    if(Unjoin(sock_list[i]))
+                        ++total;
+
+                return total;
+            }
+
+            virtual bool Change(TCPAccept *,bool recv,bool send)=0;                                 ///<修改一个Socket需要关注的事件
+
+            virtual bool Wake()=0;                                                                  ///<唤醒正在Update中等待的线程(可在其它线程调用)
+
+            /**
+             * 设置内核忙轮循参数(需在加入socket之前调用)
+             * @return 不支持内核忙轮循的管理器返回false
+             */
+            virtual bool SetBusyPoll(const SocketBusyPollConfig &){return(false);}
+
+            /**
+             * 加入一个UDPSocket，仅关注可读(边缘模式，收到事件后需一直读到EAGAIN为止)<br>
+             * 事件中由SocketEvent::datagram带回该对象，不计入GetCount
+             */
+            virtual bool JoinDatagram(DatagramSocket *)=0;
+            virtual bool UnjoinDatagram(DatagramSocket *)=0;                                        ///<分离一个DatagramSocket
+
+            virtual bool JoinListen(int)=0;                                                         ///<加入监听Socket(仅支持一个)
+            virtual void UnjoinListen()=0;                                                          ///<分离监听Socket
+
+            /**
+             * 取得并清除监听socket的就绪标记(上一次Update中是否有新连接)
+             */
+                    bool CheckListenReady()
+                    {
+                        const bool result=listen_ready;
+                        listen_ready=false;
+                        return result;
+                    }
 
             virtual int GetCount()const=0;                                                          ///<取得Socket数量
             virtual void Clear()=0;                                                                 ///<清除所有Socket
 
-            virtual int Update(const double &,
-                               SocketEventList &,
-                               SocketEventList &,
-                               SocketEventList &)=0;                                                ///<轮循刷新所有socket
+            /**
+             * 轮循刷新所有socket，每个就绪的socket在列表中只有一项(读、写、关闭以标记合并)
+             * @return 就绪的事件数量(含监听与唤醒)，<0表示出错
+             */
+            virtual int Update(const double &,SocketEventList &)=0;
         };//class SocketManageBase
 
         SocketManageBase *CreateSocketManageBase(int max_user);                                     ///<创建一个Socket基础管理器
+        SocketManageBase *CreateSocketManageBusyPoll(int max_user,const SocketBusyPollConfig &);    ///<创建一个支持内核忙轮循的Socket基础管理器(不支持的平台返回nullptr)
     }//namespace network
 }//namespace hgl
 #endif//HGL_NETWORK_SERVER_ACCEPT_MANAGE_BASE_INCLUDE
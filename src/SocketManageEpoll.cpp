@@ -1,14 +1,57 @@
 ﻿#include"SocketManageBase.h"
-#include<hgl/network/Socket.h>
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/DatagramSocket.h>
+#include<hgl/network/SocketManage.h>
 #include<hgl/LogInfo.h>
+#include<hgl/network/NetLog.h>
 
 #include<unistd.h>
 #include<sys/epoll.h>
+#include<sys/eventfd.h>
+#include<sys/ioctl.h>
+#include<sys/socket.h>
+#include<math.h>
 
 namespace hgl
 {
     namespace network
     {
+        namespace
+        {
+            /**
+             * epoll_event.data.u64的低2位用于区分对象类型(TCPAccept指针至少4字节对齐，低2位恒为0)
+             */
+            constexpr uint64 EPOLL_TAG_MASK     =3;
+            constexpr uint64 EPOLL_TAG_ACCEPT   =0;                 ///<TCPAccept对象指针
+            constexpr uint64 EPOLL_TAG_LISTEN   =1;                 ///<监听socket(高位存放socket)
+            constexpr uint64 EPOLL_TAG_WAKE     =2;                 ///<唤醒用eventfd
+            constexpr uint64 EPOLL_TAG_DATAGRAM =3;                 ///<DatagramSocket对象指针
+
+            constexpr int EPOLL_EXTRA_EVENT_COUNT=4;                ///<监听socket等内部socket预留的事件数量
+
+            /**
+             * epoll忙轮循参数(Linux 6.9开始支持，与内核中的struct epoll_params一致，老的头文件中没有)
+             */
+            struct EpollBusyPollParams
+            {
+                uint32 busy_poll_usecs;
+                uint16 busy_poll_budget;
+                uint8 prefer_busy_poll;
+                uint8 pad;
+            };
+
+            constexpr unsigned long EPOLL_IOC_SET_PARAMS=_IOW(0x8A,0x01,EpollBusyPollParams);
+
+        #ifndef SO_BUSY_POLL
+            constexpr int SO_BUSY_POLL          =46;
+        #endif//SO_BUSY_POLL
+
+        #ifndef SO_PREFER_BUSY_POLL
+            constexpr int SO_PREFER_BUSY_POLL   =69;
+            constexpr int SO_BUSY_POLL_BUDGET   =70;
+        #endif//SO_PREFER_BUSY_POLL
+        }//namespace
+
         class SocketManageEpoll:public SocketManageBase
         {
         protected:
@@ -18,21 +61,51 @@ namespace hgl
 
             int max_connect;
             int cur_count;
+            int datagram_count;
+
+            int listen_sock;
+            int wake_fd;                                            ///<用于从其它线程唤醒epoll_wait的eventfd
 
         protected:
 
             epoll_event *event_list;
 
+            int busy_poll_usecs=0;                                  ///<每个socket的SO_BUSY_POLL(0表示不设置)
+            int busy_poll_budget=0;
+            int prefer_busy_poll=0;
+            bool busy_poll_failed=false;                            ///<已输出过设置失败的日志
+
         private:
 
-            bool epoll_add(int sock)
+            /**
+             * 设置socket的忙轮循参数，增大SO_BUSY_POLL需要CAP_NET_ADMIN，失败不影响正常收发
+             */
+            void SetSocketBusyPoll(int sock)
+            {
+                if(busy_poll_usecs<=0)return;
+
+                if(setsockopt(sock,SOL_SOCKET,SO_BUSY_POLL,&busy_poll_usecs,sizeof(int))==0)
+                {
+                    setsockopt(sock,SOL_SOCKET,SO_PREFER_BUSY_POLL,&prefer_busy_poll,sizeof(int));
+                    setsockopt(sock,SOL_SOCKET,SO_BUSY_POLL_BUDGET,&busy_poll_budget,sizeof(int));
+                    return;
+                }
+
+                if(!busy_poll_failed)
+                {
+                    LOG_ERROR(OS_TEXT("SocketManageEpoll set SO_BUSY_POLL failed(need CAP_NET_ADMIN),errno:")+OSString::numberOf(errno));
+                    busy_poll_failed=true;
+                }
+            }
+
+            bool epoll_add(int sock,uint64 data,uint events)
             {
                 epoll_event ev;
 
                 hgl_zero(ev);
 
-                ev.data.fd= sock;
-                ev.events=  user_event  //要处理的事件
+                ev.data.u64=data;       //直接存放对象指针，事件返回时不用再查表
+                ev.events=  events      //要处理的事件
                             |EPOLLET    //边缘模式(即读/写时，需要一直读/写直到出错为止；相对LT模式是只要有数据就会一直通知)
                             |EPOLLERR   //出错
                             |EPOLLRDHUP //对方挂断
@@ -41,6 +114,22 @@ namespace hgl
                 return(epoll_ctl(epoll_fd,EPOLL_CTL_ADD,sock,&ev)==0);
             }
 
+            bool epoll_mod(int sock,TCPAccept *sock_obj,uint events)
+            {
+                epoll_event ev;
+
+                hgl_zero(ev);
+
+                ev.data.u64=(uint64)sock_obj|EPOLL_TAG_ACCEPT;
+                ev.events=  events
+                            |EPOLLET
+                            |EPOLLERR
+                            |EPOLLRDHUP
+                            |EPOLLHUP;
+
+                return(epoll_ctl(epoll_fd,EPOLL_CTL_MOD,sock,&ev)==0);
+            }
+
             bool epoll_del(int sock)
             {
                 //在内核版本 2.6.9 之前，EPOLL_CTL_DEL 要求一个 event 是非空的指针，尽管这个参数会被忽略。
@@ -58,85 +147,210 @@ namespace hgl
 
                 max_connect=mc;
                 cur_count=0;
+                datagram_count=0;
+
+                listen_sock=-1;
+
+                event_list=new epoll_event[max_connect+EPOLL_EXTRA_EVENT_COUNT];
 
-                event_list=new epoll_event[max_connect];
+                wake_fd=eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+
+                if(wake_fd!=-1)
+                if(!epoll_add(wake_fd,((uint64)wake_fd<<2)|EPOLL_TAG_WAKE,EPOLLIN))
+                {
+                    close(wake_fd);
+                    wake_fd=-1;
+                }
+
+                if(wake_fd==-1)
+                    LOG_ERROR(OS_TEXT("SocketManageEpoll create wake eventfd failed,errno:")+OSString::numberOf(errno));
             }
 
             ~SocketManageEpoll()
             {
                 delete[] event_list;
 
-                close(epoll_fd);
+                if(wake_fd!=-1)
+                    close(wake_fd);
+
+                if(epoll_fd!=-1)
+                    close(epoll_fd);
             }
 
-            bool Join(int sock) override
+            bool Wake() override
             {
-                epoll_add(sock);
+                if(wake_fd==-1)
+                    return(false);
 
-                SetSocketBlock(sock,false);
+                const uint64 value=1;
+
+                return(write(wake_fd,&value,sizeof(uint64))==sizeof(uint64));
+            }
+
+            bool SetBusyPoll(const SocketBusyPollConfig &cfg) override
+            {
+                busy_poll_usecs =int(cfg.busy_poll_usecs);
+                busy_poll_budget=int(cfg.busy_poll_budget);
+                prefer_busy_poll=cfg.prefer_busy_poll?1:0;
+
+                if(epoll_fd==-1||cfg.busy_poll_usecs==0)
+                    return(true);
+
+                EpollBusyPollParams ebp;
+
+                hgl_zero(ebp);
+
+                ebp.busy_poll_usecs =cfg.busy_poll_usecs;
+                ebp.busy_poll_budget=uint16(cfg.busy_poll_budget);
+                ebp.prefer_busy_poll=prefer_busy_poll;
+
+                if(ioctl(epoll_fd,EPOLL_IOC_SET_PARAMS,&ebp)!=0)    //老内核没有，只能依靠net.core.busy_poll
+                    LOG_INFO(OS_TEXT("SocketManageEpoll set epoll busy poll params failed(need Linux 6.9),errno:")+OSString::numberOf(errno));
+
+                return(true);
+            }
+
+            bool Join(TCPAccept *sock_obj) override
+            {
+                const int sock=sock_obj->ThisSocket;
+
+                if(!epoll_add(sock,(uint64)sock_obj|EPOLL_TAG_ACCEPT,user_event))
+                {
+                    NET_LOG_ERROR("SocketManageEpoll::Join() epoll_ctl failed,Socket:{},errno:{}",sock,errno);
+                    return(false);
+                }
+
+                SetSocketBusyPoll(sock);
 
                 ++cur_count;
 
-                LOG_INFO(OS_TEXT("SocketManageEpoll::Join() Socket:")+OSString(sock));
+                return(true);
+            }
+
+            /**
+             * 批量加入，socket在接入时已设为非阻塞，这里只有epoll_ctl，不输出逐个socket的日志
+             */
+            int Join(TCPAccept **sock_list,int count) override
+            {
+                int total=0;
+                int err=0;
+
+                for(int i=0;i<count;i++)
+                {
+                    if(epoll_add(sock_list[i]->ThisSocket,(uint64)sock_list[i]|EPOLL_TAG_ACCEPT,user_event))
+                    {
+                        SetSocketBusyPoll(sock_list[i]->ThisSocket);
+                        ++total;
+                    }
+                    else
+                    {
+                        sock_list[i]=nullptr;
+                        err=errno;
+                    }
+                }
+
+                if(total<count)
+                    NET_LOG_ERROR("SocketManageEpoll::Join() epoll_ctl failed {} of {},last errno:{}",count-total,count,err);
+
+                cur_count+=total;
+                return total;
+            }
+
+            bool JoinDatagram(DatagramSocket *udp) override
+            {
+                const int sock=udp->ThisSocket;
+
+                if(!epoll_add(sock,(uint64)udp|EPOLL_TAG_DATAGRAM,EPOLLIN))
+                {
+                    NET_LOG_ERROR("SocketManageEpoll::JoinDatagram() epoll_ctl failed,Socket:{},errno:{}",sock,errno);
+                    return(false);
+                }
+
+                SetSocketBusyPoll(sock);
+
+                ++datagram_count;
+                return(true);
+            }
+
+            bool UnjoinDatagram(DatagramSocket *udp) override
+            {
+                if(epoll_fd==-1)
+                    return(false);
+
+                if(!epoll_del(udp->ThisSocket))
+                    return(false);
+
+                --datagram_count;
+                return(true);
+            }
+
+            bool JoinListen(int sock) override
+            {
+                if(listen_sock!=-1)
+                    return(false);
+
+                SetSocketBlock(sock,false);
+
+                //监听socket同样使用边缘模式，有新连接时需一直accept到EAGAIN为止
+                if(!epoll_add(sock,((uint64)sock<<2)|EPOLL_TAG_LISTEN,EPOLLIN))
+                {
+                    NET_LOG_ERROR("SocketManageEpoll::JoinListen() epoll_ctl failed,Socket:{},errno:{}",sock,errno);
+                    return(false);
+                }
 
+                listen_sock=sock;
                 return(true);
             }
 
-//             bool Join(const int *sock_list,int count) override
-//             {
-//                 if(count<=0)return(false);
-//
-//                 for(int i=0;i<count;i++)
-//                 {
-//                     epoll_add(*sock_list);
-//
-//                     SetSocketBlock(*sock_list,false);
-//
-//                     ++sock_list;
-//                 }
-//
-//                 cur_count+=count;
-//
-//                 return(true);
-//             }
-
-            bool Unjoin(int sock) override
+            void UnjoinListen() override
+            {
+                if(listen_sock==-1)
+                    return;
+
+                epoll_del(listen_sock);
+                listen_sock=-1;
+            }
+
+            bool Unjoin(TCPAccept *sock_obj) override
             {
                 if(epoll_fd==-1)
                 {
-                    LOG_ERROR(OS_TEXT("SocketManageEpoll::Unjoin() epoll_fd==-1)"));
+                    NET_LOG_ERROR("SocketManageEpoll::Unjoin() epoll_fd==-1)");
                     return(false);
                 }
 
+                const int sock=sock_obj->ThisSocket;
+
                 --cur_count;
                 epoll_del(sock);
 
-                LOG_INFO(OS_TEXT("SocketManageEpoll::Unjoin() Socket:")+OSString(sock));
-
                 return(true);
             }
 
-//             bool Unjoin(const int *sock_list,int count) override
-//             {
-//                 if(epoll_fd==-1)
-//                 {
-//                     LOG_ERROR(OS_TEXT("SocketManageEpoll::Unjoin() epoll_fd==-1)"));
-//                     return(false);
-//                 }
-//
-//                 if(!sock_list||count<=0)return(false);
-//
-//                 for(int i=0;i<count;i++)
-//                 {
-//                     epoll_del(*sock_list);
-//                     ++sock_list;
-//                 }
-//
-//                 cur_count-=count;
-//                 LOG_INFO(OS_TEXT("SocketManageEpoll::Unjoin() Socket count:")+OSString(count));
-//
-//                 return(true);
-//             }
+            int Unjoin(TCPAccept **sock_list,int count) override
+            {
+                if(epoll_fd==-1)
+                    return(0);
+
+                for(int i=0;i<count;i++)
+                    epoll_del(sock_list[i]->ThisSocket);
+
+                cur_count-=count;
+                return count;
+            }
+
+            bool Change(TCPAccept *sock_obj,bool recv,bool send) override
+            {
+                if(epoll_fd==-1)
+                    return(false);
+
+                uint events=0;
+
+                if(recv)events|=EPOLLIN;
+                if(send)events|=EPOLLOUT;
+
+                return epoll_mod(sock_obj->ThisSocket,sock_obj,events);
+            }
 
             int GetCount()const override
             {
@@ -151,27 +365,40 @@ namespace hgl
                     epoll_fd=-1;
                 }
 
+                if(wake_fd!=-1)
+                {
+                    close(wake_fd);
+                    wake_fd=-1;
+                }
+
                 cur_count=0;
+                datagram_count=0;
+                listen_sock=-1;
             }
 
-            int Update(const double &time_out,SocketEventList &recv_list,SocketEventList &send_list,SocketEventList &error_list) override
+            int Update(const double &time_out,SocketEventList &sel) override
             {
                 int event_count=0;
 
                 if(epoll_fd==-1)
                     return(-1);
 
-                if(cur_count<=0)
+                int wait_count=cur_count+datagram_count+(listen_sock!=-1?1:0)+(wake_fd!=-1?1:0);
+
+                if(wait_count<=0)
                     return(0);
 
-                event_count=epoll_wait(epoll_fd,event_list,cur_count,time_out<0?-1:time_out*HGL_MILLI_SEC_PRE_SEC);
+                if(wait_count>max_connect+EPOLL_EXTRA_EVENT_COUNT)
+                    wait_count=max_connect+EPOLL_EXTRA_EVENT_COUNT;
+
+                event_count=epoll_wait(epoll_fd,event_list,wait_count,time_out<0?-1:int(ceil(time_out*HGL_MILLI_SEC_PRE_SEC)));     //向上取整，不足1毫秒的等待不能变成0而空转
 
                 if(event_count==0)
                     return(0);
 
                 if(event_count<0)
                 {
-                    LOG_INFO(OS_TEXT("epoll return -1,errno: ")+OSString(errno));
+                    NET_LOG_INFO("epoll return -1,errno: {}",errno);
 
                     if(errno==EBADF
                      ||errno==EFAULT
@@ -181,56 +408,95 @@ namespace hgl
                     return(0);
                 }
 
-                recv_list.PreMalloc(event_count);
-                send_list.PreMalloc(event_count);
-                error_list.PreMalloc(event_count);
+                sel.PreMalloc(event_count);
 
                 epoll_event *ee=this->event_list;
+                SocketEvent *se=sel.GetData();
 
-                SocketEvent *rp=recv_list.GetData();
-                SocketEvent *sp=send_list.GetData();
-                SocketEvent *ep=error_list.GetData();
-
-                int recv_num=0;
-                int send_num=0;
-                int error_num=0;
+                int num=0;
 
                 for(int i=0;i<event_count;i++)
                 {
-                    if(ee->events&( EPOLLERR|           //出错了
-                                    EPOLLRDHUP|         //对方关了
-                                    EPOLLHUP))          //我方强制关了
+                    const uint64 tag=ee->data.u64&EPOLL_TAG_MASK;
+
+                    if(tag==EPOLL_TAG_LISTEN)
                     {
-                        LOG_ERROR("SocketManageEpoll Error,socket:"+OSString(ee->data.fd)+",epoll event:"+OSString(ee->events));
+                        listen_ready=true;                  //有新连接
+                        ++ee;
+                        continue;
+                    }
+
+                    if(tag==EPOLL_TAG_WAKE)                 //被其它线程唤醒，读掉计数即可
+                    {
+                        uint64 value;
+
+                        while(read(wake_fd,&value,sizeof(uint64))>0);
 
-                        ep->sock=ee->data.fd;
-                        ep->error=ee->events;
-                        ++ep;
-                        ++error_num;
+                        ++ee;
+                        continue;
                     }
-                    else
-                    if(ee->events&EPOLLIN)              //可以读数据
+
+                    const uint events=ee->events;
+
+                    if(tag==EPOLL_TAG_DATAGRAM)
                     {
-                        rp->sock=ee->data.fd;
-                        rp->size=0;
-                        ++rp;
-                        ++recv_num;
+                        DatagramSocket *udp=(DatagramSocket *)(ee->data.u64&~EPOLL_TAG_MASK);
+
+                        se->sock=udp->ThisSocket;
+                        se->accept=nullptr;
+                        se->datagram=udp;
+                        se->events=((events&EPOLLIN)?SOCKET_EVENT_RECV:0)
+                                  |((events&EPOLLERR)?SOCKET_EVENT_ERROR:0);    //UDP收到ICMP错误时也会有EPOLLERR，并不表示socket不可用
+                        se->size=0;
+                        se->error=0;
+                        ++se;
+                        ++num;
+
+                        ++ee;
+                        continue;
                     }
-                    else
-                    if(ee->events&EPOLLOUT)             //可以发数据
+
+                    TCPAccept *sock_obj=(TCPAccept *)(ee->data.u64&~EPOLL_TAG_MASK);
+
+                    uint flags=0;
+
+                    if(events&EPOLLIN)      flags|=SOCKET_EVENT_RECV;           //可以读数据(对方半关闭时也会有，剩余数据需读完)
+                    if(events&EPOLLOUT)     flags|=SOCKET_EVENT_SEND;           //可以发数据(边缘模式下读写事件可能同时到达)
+                    if(events&(EPOLLRDHUP|
+                               EPOLLHUP))   flags|=SOCKET_EVENT_HUP;            //对方关了/我方强制关了
+
+                    if(events&EPOLLERR)
                     {
-                        sp->sock=ee->data.fd;
-                        sp->size=0;
-                        ++sp;
-                        ++send_num;
+                        if(sock_obj->IsZeroCopy()                               //零拷贝发送的完成通知也以EPOLLERR报告
+                         &&sock_obj->ProcZeroCopyCompletion()>=0)
+                        {
+                            if(!flags)                                          //只是完成通知
+                            {
+                                ++ee;
+                                continue;
+                            }
+                        }
+                        else
+                        {
+                            flags|=SOCKET_EVENT_ERROR;                          //出错了
+
+                            NET_LOG_ERROR("SocketManageEpoll Error,socket:{},epoll event:{}",sock_obj->ThisSocket,events);
+                        }
                     }
 
+                    se->sock=sock_obj->ThisSocket;
+                    se->accept=sock_obj;
+                    se->datagram=nullptr;
+                    se->events=flags;
+                    se->size=0;
+                    se->error=(flags&SOCKET_EVENT_CLOSE)?int(events):0;
+                    ++se;
+                    ++num;
+
                     ++ee;
                 }
 
-                recv_list.SetCount(recv_num);
-                send_list.SetCount(send_num);
-                error_list.SetCount(error_num);
+                sel.SetCount(num);
 
                 return(event_count);
             }
@@ -248,8 +514,28 @@ namespace hgl
                 return(nullptr);
             }
 
-            return(new SocketManageEpoll(epoll_fd,EPOLLIN,max_user));           //暂时只处理recv。。。至于send则直接强制发完，不走epoll
-            //return(new SocketManageEpoll(epoll_fd,EPOLLIN|EPOLLOUT,max_user));
+            return(new SocketManageEpoll(epoll_fd,EPOLLIN,max_user));           //默认只关注recv，有数据待发时由Change()临时打开EPOLLOUT
+        }
+
+        /**
+         * 忙轮循只能使用epoll(内核的忙轮循在epoll_wait中进行)
+         */
+        SocketManageBase *CreateSocketManageBusyPoll(int max_user,const SocketBusyPollConfig &cfg)
+        {
+            if(max_user<=0)return(nullptr);
+
+            int epoll_fd=epoll_create(max_user);
+
+            if(epoll_fd<0)
+            {
+                LOG_ERROR(OS_TEXT("epoll_create return error,errno is")+OSString(errno));
+                return(nullptr);
+            }
+
+            SocketManageBase *sm=new SocketManageEpoll(epoll_fd,EPOLLIN,max_user);
+
+            sm->SetBusyPoll(cfg);
+            return sm;
         }
     }//namespace network
 }//namespace hgl
@@ -0,0 +1,686 @@
+﻿#include"SocketManageBase.h"
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/DatagramSocket.h>
+#include<hgl/type/Map.h>
+#include<hgl/log/LogInfo.h>
+#include<math.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            /**
+             * 完成端口的CompletionKey用于区分对象类型
+             */
+            constexpr ULONG_PTR IOCP_KEY_ACCEPT =0;                 ///<TCPAccept/DatagramSocket对象(由OVERLAPPED找到IOCPContext)
+            constexpr ULONG_PTR IOCP_KEY_LISTEN =1;                 ///<监听socket有新连接
+            constexpr ULONG_PTR IOCP_KEY_WAKE   =2;                 ///<被其它线程唤醒
+
+            constexpr int IOCP_EXTRA_EVENT_COUNT=4;                 ///<监听socket等内部事件预留的数量
+            constexpr int IOCP_OP_PER_SOCKET=2;                     ///<每个socket最多同时有recv/send两个请求
+
+            constexpr DWORD IOCP_CLOSE_WAIT_TIME=100;               ///<析构时等待已取消请求返回的时间(毫秒)
+
+            constexpr DWORD IOCP_STATUS_BUFFER_OVERFLOW=0x80000005; ///<STATUS_BUFFER_OVERFLOW(ntstatus.h中定义，这里不引用)
+
+            /**
+             * AFD poll(afd.sys的IOCTL_AFD_POLL，未公开，wepoll/libuv/mio等取得socket就绪通知的方法)
+             */
+            constexpr DWORD AFD_IOCTL_POLL          =0x00012024;
+            constexpr ULONG AFD_POLL_SEND           =0x0004;
+            constexpr ULONG AFD_POLL_ABORT          =0x0010;
+            constexpr ULONG AFD_POLL_LOCAL_CLOSE    =0x0020;
+            constexpr ULONG AFD_POLL_CONNECT_FAIL   =0x0100;
+
+            struct AFDPollHandleInfo
+            {
+                HANDLE handle;
+                ULONG events;
+                LONG status;                                        ///<NTSTATUS
+            };//struct AFDPollHandleInfo
+
+            struct AFDPollInfo
+            {
+                LARGE_INTEGER timeout;
+                ULONG handle_count;
+                ULONG exclusive;
+                AFDPollHandleInfo handles[1];
+            };//struct AFDPollInfo
+
+            struct IOCPContext;
+
+            struct IOCPOverlapped
+            {
+                OVERLAPPED ov;
+                IOCPContext *ctx;
+                bool is_recv;
+            };//struct IOCPOverlapped
+
+            /**
+             * 每个socket的完成端口上下文<br>
+             * 投递出去的OVERLAPPED在完成前必须一直有效，所以Unjoin后如果还有未返回的请求，由完成事件负责释放
+             */
+            struct IOCPContext
+            {
+                IOCPOverlapped recv_ov;
+                IOCPOverlapped send_ov;
+
+                AFDPollInfo send_poll;                              ///<等待可写的AFD poll参数与结果，完成前必须一直有效
+
+                int sock;
+                TCPAccept *sock_obj;
+                DatagramSocket *datagram;                           ///<UDP时不为nullptr，0字节WSARecv需带MSG_PEEK，否则会丢掉一个数据报
+
+                bool recv_watch;
+                bool send_watch;
+
+                bool recv_pending;                                  ///<已投递0字节WSARecv，尚未返回
+                bool send_pending;                                  ///<已投递等待可写的AFD poll，尚未返回
+
+                bool rearm;                                         ///<已在重新投递列表中
+                bool closed;                                        ///<已Unjoin，只等待未返回的请求
+
+                uint event_serial;                                  ///<最近一次产生事件的Update序号
+                int event_index;                                    ///<在该次Update事件列表中的序号
+
+            private:
+
+                void Init(int s)
+                {
+                    hgl_zero(recv_ov);
+                    hgl_zero(send_ov);
+                    hgl_zero(send_poll);
+
+                    recv_ov.ctx=this;
+                    recv_ov.is_recv=true;
+                    send_ov.ctx=this;
+                    send_ov.is_recv=false;
+
+                    sock=s;
+                    sock_obj=nullptr;
+                    datagram=nullptr;
+
+                    recv_watch=true;
+                    send_watch=false;
+
+                    recv_pending=false;
+                    send_pending=false;
+
+                    rearm=false;
+                    closed=false;
+
+                    event_serial=0;
+                    event_index=-1;
+                }
+
+            public:
+
+                IOCPContext(TCPAccept *obj)
+                {
+                    Init(obj->ThisSocket);
+                    sock_obj=obj;
+                }
+
+                IOCPContext(DatagramSocket *udp)
+                {
+                    Init(udp->ThisSocket);
+                    datagram=udp;
+                }
+
+                bool IsIdle()const{return !recv_pending&&!send_pending;}
+            };//struct IOCPContext
+
+            VOID CALLBACK OnListenEvent(PVOID iocp,BOOLEAN)
+            {
+                PostQueuedCompletionStatus((HANDLE)iocp,0,IOCP_KEY_LISTEN,nullptr);
+            }
+        }//namespace
+
+        /**
+         * 基于完成端口的Socket管理<br>
+         * 为每个socket投递0字节的WSARecv，关注可写时再投递AFD poll，请求完成即代表socket可读/可写，之后仍由TCPAccept自行非阻塞读写到WSAEWOULDBLOCK为止。<br>
+         * 0字节WSASend不等待发送缓冲区有空间，会立即完成，用它等待可写会在对方接收慢时空转，所以可写通知使用AFD poll。<br>
+         * 这样不需要为每个连接预留接收缓冲区，对上层的行为与epoll边缘模式一致。<br>
+         * 监听socket使用WSAEventSelect(FD_ACCEPT)+RegisterWaitForSingleObject，有新连接时向完成端口投递一个事件。
+         */
+        class SocketManageIOCP:public SocketManageBase
+        {
+            HANDLE iocp;
+
+            int max_connect;
+            int cur_count;
+
+            int listen_sock;
+            HANDLE listen_event;
+            HANDLE listen_wait;
+
+            Map<int,IOCPContext *> ctx_list;                        ///<已加入的socket
+            List<IOCPContext *> rearm_list;                         ///<下一次Update前需要重新投递请求的socket
+            int closing_count;                                      ///<已Unjoin但还未释放的上下文数量
+
+            uint update_serial;                                     ///<Update序号，用于合并同一socket的读写完成事件
+
+            OVERLAPPED_ENTRY *entry_list;
+
+        private:
+
+            /**
+             * 取得socket在本次Update中的事件，recv/send两个请求分别完成时合并到同一项
+             */
+            SocketEvent *GetEvent(SocketEventList &sel,IOCPContext *ctx)
+            {
+                if(ctx->event_serial==update_serial)
+                    return sel.GetData()+ctx->event_index;
+
+                const int index=sel.GetCount();
+
+                sel.SetCount(index+1);
+
+                SocketEvent *se=sel.GetData()+index;
+
+                se->sock=ctx->sock;
+                se->accept=ctx->sock_obj;
+                se->datagram=ctx->datagram;
+                se->events=0;
+                se->size=0;
+                se->error=0;
+
+                ctx->event_serial=update_serial;
+                ctx->event_index=index;
+
+                return se;
+            }
+
+            /**
+             * 投递0字节WSARecv，socket有数据可读时完成
+             */
+            bool PostRecv(IOCPContext *ctx)
+            {
+                if(ctx->recv_pending)return(true);
+
+                WSABUF buf;
+                DWORD bytes=0;
+                DWORD flags=ctx->datagram?MSG_PEEK:0;
+
+                buf.buf=nullptr;
+                buf.len=0;
+
+                hgl_zero(ctx->recv_ov.ov);
+
+                if(WSARecv(ctx->sock,&buf,1,&bytes,&flags,&ctx->recv_ov.ov,nullptr)==SOCKET_ERROR
+                 &&WSAGetLastError()!=WSA_IO_PENDING)
+                    return(false);
+
+                ctx->recv_pending=true;                             //立即完成时也会进入完成端口，统一在那里处理
+                return(true);
+            }
+
+            /**
+             * 投递AFD poll等待socket可写，发送缓冲区有空间时完成(投递时已有空间则立即完成)，连接出错或socket关闭时也会完成<br>
+             * 请求在socket自身上发出，完成事件进入socket所关联的完成端口(要求socket就是afd的句柄，即没有安装非IFS的LSP，否则投递失败报告为出错)
+             */
+            bool PostSend(IOCPContext *ctx)
+            {
+                if(ctx->send_pending)return(true);
+
+                AFDPollInfo &pi=ctx->send_poll;
+
+                pi.timeout.QuadPart=INT64_MAX;                      //不超时
+                pi.handle_count=1;
+                pi.exclusive=FALSE;
+                pi.handles[0].handle=(HANDLE)(ULONG_PTR)ctx->sock;
+                pi.handles[0].events=AFD_POLL_SEND|AFD_POLL_ABORT|AFD_POLL_LOCAL_CLOSE|AFD_POLL_CONNECT_FAIL;
+                pi.handles[0].status=0;
+
+                hgl_zero(ctx->send_ov.ov);
+
+                if(!DeviceIoControl((HANDLE)(ULONG_PTR)ctx->sock,AFD_IOCTL_POLL,&pi,sizeof(pi),&pi,sizeof(pi),nullptr,&ctx->send_ov.ov)
+                 &&GetLastError()!=ERROR_IO_PENDING)
+                    return(false);
+
+                ctx->send_pending=true;
+                return(true);
+            }
+
+            void AddRearm(IOCPContext *ctx)
+            {
+                if(ctx->rearm)return;
+
+                ctx->rearm=true;
+                rearm_list.Add(ctx);
+            }
+
+            void ReleaseContext(IOCPContext *ctx)
+            {
+                delete ctx;
+                --closing_count;
+            }
+
+            /**
+             * 重新投递上一次Update中已返回的请求<br>
+             * 放在这里而不是完成时立即投递，是因为上层要到ProcSocketEventList中才会把数据读完，立即投递会马上再次完成
+             */
+            void Rearm(SocketEventList &sel)
+            {
+                const int count=rearm_list.GetCount();
+
+                if(count<=0)return;
+
+                IOCPContext **cp=rearm_list.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    IOCPContext *ctx=*cp;
+
+                    ++cp;
+                    ctx->rearm=false;
+
+                    if(ctx->closed)
+                    {
+                        if(ctx->IsIdle())                           //Unjoin时还在列表中，延迟到这里释放
+                            ReleaseContext(ctx);
+
+                        continue;
+                    }
+
+                    if((ctx->recv_watch&&!PostRecv(ctx))
+                     ||(ctx->send_watch&&!PostSend(ctx)))
+                    {
+                        SocketEvent *se=GetEvent(sel,ctx);
+
+                        se->events|=SOCKET_EVENT_ERROR;
+                        se->error=WSAGetLastError();
+                    }
+                }
+
+                rearm_list.Clear();
+            }
+
+            /**
+             * 取消socket上所有未返回的请求，无请求且不在重新投递列表中时直接释放上下文
+             */
+            void CloseContext(IOCPContext *ctx)
+            {
+                ctx->closed=true;
+                ctx->sock_obj=nullptr;
+                ctx->datagram=nullptr;
+
+                ++closing_count;
+
+                if(!ctx->IsIdle())
+                    CancelIoEx((HANDLE)(ULONG_PTR)ctx->sock,nullptr);
+                else
+                if(!ctx->rearm)
+                    ReleaseContext(ctx);
+            }
+
+            /**
+             * 处理一个完成事件<br>
+             * @param sel 事件列表，为nullptr时表示只回收已关闭的上下文
+             */
+            void ProcCompletion(const OVERLAPPED_ENTRY &entry,SocketEventList *sel)
+            {
+                if(entry.lpCompletionKey==IOCP_KEY_LISTEN)
+                {
+                    WSANETWORKEVENTS ne;
+
+                    if(listen_sock!=-1)
+                        WSAEnumNetworkEvents(listen_sock,listen_event,&ne);     //重置事件
+
+                    listen_ready=true;
+                    return;
+                }
+
+                if(entry.lpCompletionKey==IOCP_KEY_WAKE
+                 ||!entry.lpOverlapped)
+                    return;
+
+                const IOCPOverlapped *io=CONTAINING_RECORD(entry.lpOverlapped,IOCPOverlapped,ov);
+                IOCPContext *ctx=io->ctx;
+
+                if(io->is_recv)
+                    ctx->recv_pending=false;
+                else
+                    ctx->send_pending=false;
+
+                if(ctx->closed)
+                {
+                    if(ctx->IsIdle()&&!ctx->rearm)
+                        ReleaseContext(ctx);
+
+                    return;
+                }
+
+                if(!sel)return;
+
+                DWORD status=(DWORD)entry.lpOverlapped->Internal;           //NTSTATUS，0为成功
+
+                if(ctx->datagram&&io->is_recv&&status==IOCP_STATUS_BUFFER_OVERFLOW)  //0字节MSG_PEEK收到数据报时返回缓冲区不足，也代表可读
+                    status=0;
+
+                if(status==0
+                 &&(io->is_recv?!ctx->recv_watch:!ctx->send_watch))         //请求返回前已不再关注
+                    return;
+
+                if(status==0&&!io->is_recv)
+                {
+                    const AFDPollHandleInfo &hi=ctx->send_poll.handles[0];
+
+                    if(hi.events&(AFD_POLL_ABORT|AFD_POLL_CONNECT_FAIL))    //连接已断开或连接失败
+                        status=(hi.status?(DWORD)hi.status:(DWORD)WSAECONNRESET);
+                    else
+                    if(!(hi.events&AFD_POLL_SEND))                          //socket已在本地关闭
+                        return;
+                }
+
+                SocketEvent *se=GetEvent(*sel,ctx);
+
+                if(status!=0)
+                {
+                    se->events|=SOCKET_EVENT_ERROR;
+                    se->error=(int)status;
+
+                    if(ctx->datagram)                               //UDP收到ICMP错误时也会走到这里，socket依然可用
+                        AddRearm(ctx);
+
+                    return;
+                }
+
+                se->events|=(io->is_recv?SOCKET_EVENT_RECV:SOCKET_EVENT_SEND);
+                AddRearm(ctx);
+            }
+
+        public:
+
+            SocketManageIOCP(HANDLE cp,int mc)
+            {
+                iocp=cp;
+
+                max_connect=mc;
+                cur_count=0;
+
+                listen_sock=-1;
+                listen_event=nullptr;
+                listen_wait=nullptr;
+
+                closing_count=0;
+                update_serial=0;
+
+                entry_list=new OVERLAPPED_ENTRY[max_connect*IOCP_OP_PER_SOCKET+IOCP_EXTRA_EVENT_COUNT];
+            }
+
+            ~SocketManageIOCP()
+            {
+                Clear();
+
+                {
+                    SocketEventList dummy;
+
+                    Rearm(dummy);                                   //释放仍在重新投递列表中的已关闭上下文
+                }
+
+                //等待已取消的请求返回，之后才能释放OVERLAPPED
+                while(closing_count>0)
+                {
+                    OVERLAPPED_ENTRY entry;
+                    ULONG removed=0;
+
+                    if(!GetQueuedCompletionStatusEx(iocp,&entry,1,&removed,IOCP_CLOSE_WAIT_TIME,FALSE)||removed==0)
+                        break;
+
+                    ProcCompletion(entry,nullptr);
+                }
+
+                delete[] entry_list;
+
+                if(iocp)
+                    CloseHandle(iocp);
+            }
+
+            bool Wake() override
+            {
+                return PostQueuedCompletionStatus(iocp,0,IOCP_KEY_WAKE,nullptr);
+            }
+
+            bool Join(TCPAccept *sock_obj) override
+            {
+                const int sock=sock_obj->ThisSocket;
+
+                if(ctx_list.ContainsKey(sock))
+                    return(false);
+
+                //完成端口与socket的关联无法解除，但socket关闭后自动失效，所以对象池复用TCPAccept时不受影响
+                if(CreateIoCompletionPort((HANDLE)(ULONG_PTR)sock,iocp,IOCP_KEY_ACCEPT,0)!=iocp)
+                {
+                    LOG_ERROR(OS_TEXT("SocketManageIOCP::Join() CreateIoCompletionPort failed,Socket:")+OSString::numberOf(sock)+OS_TEXT(",errno:")+OSString::numberOf((int)GetLastError()));
+                    return(false);
+                }
+
+                IOCPContext *ctx=new IOCPContext(sock_obj);
+
+                if(!PostRecv(ctx))
+                {
+                    LOG_ERROR(OS_TEXT("SocketManageIOCP::Join() WSARecv failed,Socket:")+OSString::numberOf(sock)+OS_TEXT(",errno:")+OSString::numberOf(WSAGetLastError()));
+                    delete ctx;
+                    return(false);
+                }
+
+                ctx_list.Add(sock,ctx);
+                ++cur_count;
+
+                return(true);
+            }
+
+            bool JoinDatagram(DatagramSocket *udp) override
+            {
+                const int sock=udp->ThisSocket;
+
+                if(ctx_list.ContainsKey(sock))
+                    return(false);
+
+                if(CreateIoCompletionPort((HANDLE)(ULONG_PTR)sock,iocp,IOCP_KEY_ACCEPT,0)!=iocp)
+                {
+                    LOG_ERROR(OS_TEXT("SocketManageIOCP::JoinDatagram() CreateIoCompletionPort failed,Socket:")+OSString::numberOf(sock)+OS_TEXT(",errno:")+OSString::numberOf((int)GetLastError()));
+                    return(false);
+                }
+
+                IOCPContext *ctx=new IOCPContext(udp);
+
+                if(!PostRecv(ctx))
+                {
+                    LOG_ERROR(OS_TEXT("SocketManageIOCP::JoinDatagram() WSARecv failed,Socket:")+OSString::numberOf(sock)+OS_TEXT(",errno:")+OSString::numberOf(WSAGetLastError()));
+                    delete ctx;
+                    return(false);
+                }
+
+                ctx_list.Add(sock,ctx);
+                return(true);
+            }
+
+            bool UnjoinDatagram(DatagramSocket *udp) override
+            {
+                IOCPContext *ctx;
+
+                if(!ctx_list.Get(udp->ThisSocket,ctx))
+                    return(false);
+
+                if(ctx->datagram!=udp)
+                    return(false);
+
+                ctx_list.DeleteByKey(ctx->sock);
+                CloseContext(ctx);
+                return(true);
+            }
+
+            bool JoinListen(int sock) override
+            {
+                if(listen_sock!=-1)
+                    return(false);
+
+                listen_event=WSACreateEvent();
+
+                if(listen_event==WSA_INVALID_EVENT)
+                {
+                    listen_event=nullptr;
+                    return(false);
+                }
+
+                //WSAEventSelect会将socket设为非阻塞；FD_ACCEPT在accept返回WSAEWOULDBLOCK后才会再次触发，与边缘模式一致
+                if(WSAEventSelect(sock,listen_event,FD_ACCEPT)==SOCKET_ERROR
+                 ||!RegisterWaitForSingleObject(&listen_wait,listen_event,OnListenEvent,iocp,INFINITE,WT_EXECUTEINWAITTHREAD))
+                {
+                    LOG_ERROR(OS_TEXT("SocketManageIOCP::JoinListen() failed,Socket:")+OSString::numberOf(sock)+OS_TEXT(",errno:")+OSString::numberOf(WSAGetLastError()));
+
+                    WSAEventSelect(sock,nullptr,0);
+                    WSACloseEvent(listen_event);
+                    listen_event=nullptr;
+                    listen_wait=nullptr;
+                    return(false);
+                }
+
+                listen_sock=sock;
+                return(true);
+            }
+
+            void UnjoinListen() override
+            {
+                if(listen_sock==-1)
+                    return;
+
+                UnregisterWaitEx(listen_wait,INVALID_HANDLE_VALUE);     //等待回调结束
+                WSAEventSelect(listen_sock,nullptr,0);
+                WSACloseEvent(listen_event);
+
+                listen_wait=nullptr;
+                listen_event=nullptr;
+                listen_sock=-1;
+            }
+
+            bool Unjoin(TCPAccept *sock_obj) override
+            {
+                IOCPContext *ctx;
+
+                if(!ctx_list.Get(sock_obj->ThisSocket,ctx))
+                    return(false);
+
+                if(ctx->sock_obj!=sock_obj)
+                    return(false);
+
+                ctx_list.DeleteByKey(ctx->sock);
+                CloseContext(ctx);
+
+                --cur_count;
+                return(true);
+            }
+
+            bool Change(TCPAccept *sock_obj,bool recv,bool send) override
+            {
+                IOCPContext *ctx;
+
+                if(!ctx_list.Get(sock_obj->ThisSocket,ctx)
+                 ||ctx->sock_obj!=sock_obj)
+                    return(false);
+
+                ctx->recv_watch=recv;
+                ctx->send_watch=send;
+
+                if((recv&&!ctx->recv_pending)
+                 ||(send&&!ctx->send_pending))
+                    AddRearm(ctx);                                  //与下一次Update一起投递
+
+                return(true);
+            }
+
+            int GetCount()const override
+            {
+                return cur_count;
+            }
+
+            void Clear() override
+            {
+                const int count=ctx_list.GetCount();
+                auto **cp=ctx_list.GetDataList();
+
+                for(int i=0;i<count;i++)
+                {
+                    CloseContext((*cp)->value);
+                    ++cp;
+                }
+
+                ctx_list.Clear();
+
+                UnjoinListen();
+
+                cur_count=0;
+            }
+
+            int Update(const double &time_out,SocketEventList &sel) override
+            {
+                if(!iocp)
+                    return(-1);
+
+                const int max_entry=max_connect*IOCP_OP_PER_SOCKET+IOCP_EXTRA_EVENT_COUNT;
+
+                sel.PreMalloc(rearm_list.GetCount()+max_entry);
+                sel.SetCount(0);
+
+                ++update_serial;
+
+                Rearm(sel);
+
+                ULONG removed=0;
+
+                if(!GetQueuedCompletionStatusEx(iocp,
+                                                entry_list,
+                                                max_entry,
+                                                &removed,
+                                                time_out<0?INFINITE:DWORD(ceil(time_out*HGL_MILLI_SEC_PRE_SEC)),      //向上取整，不足1毫秒的等待不能变成0而空转
+                                                FALSE))
+                {
+                    const DWORD err=GetLastError();
+
+                    if(err!=WAIT_TIMEOUT)
+                    {
+                        LOG_INFO(OS_TEXT("GetQueuedCompletionStatusEx return false,errno: ")+OSString::numberOf((int)err));
+
+                        if(err==ERROR_INVALID_HANDLE
+                         ||err==ERROR_ABANDONED_WAIT_0)
+                            return(-1);
+                    }
+
+                    return(sel.GetCount());
+                }
+
+                const OVERLAPPED_ENTRY *entry=entry_list;
+
+                for(ULONG i=0;i<removed;i++)
+                {
+                    ProcCompletion(*entry,&sel);
+                    ++entry;
+                }
+
+                return(sel.GetCount());
+            }
+        };//class SocketManageIOCP:public SocketManageBase
+
+        /**
+         * 创建完成端口版Socket管理器
+         */
+        SocketManageBase *CreateSocketManageIOCP(int max_user)
+        {
+            if(max_user<=0)return(nullptr);
+
+            HANDLE iocp=CreateIoCompletionPort(INVALID_HANDLE_VALUE,nullptr,0,1);      //每个SocketManage只在一个线程中Update
+
+            if(!iocp)
+            {
+                LOG_ERROR(OS_TEXT("CreateIoCompletionPort return error,errno is")+OSString::numberOf((int)GetLastError()));
+                return(nullptr);
+            }
+
+            return(new SocketManageIOCP(iocp,max_user));
+        }
+    }//namespace network
+}//namespace hgl
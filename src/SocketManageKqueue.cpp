@@ -0,0 +1,596 @@
+﻿#include"SocketManageBase.h"
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/DatagramSocket.h>
+#include<hgl/LogInfo.h>
+#include<hgl/network/NetLog.h>
+
+#include<unistd.h>
+#include<fcntl.h>
+#include<sys/types.h>
+#include<sys/event.h>
+#include<sys/time.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            /**
+             * kevent.udata的低2位用于区分对象类型(TCPAccept指针至少4字节对齐，低2位恒为0)
+             */
+            constexpr uintptr_t KQUEUE_TAG_MASK     =3;
+            constexpr uintptr_t KQUEUE_TAG_ACCEPT   =0;             ///<TCPAccept对象指针
+            constexpr uintptr_t KQUEUE_TAG_LISTEN   =1;             ///<监听socket
+            constexpr uintptr_t KQUEUE_TAG_WAKE     =2;             ///<唤醒用管道
+            constexpr uintptr_t KQUEUE_TAG_DATAGRAM =3;             ///<DatagramSocket对象指针(只有读过滤器)
+
+            constexpr int KQUEUE_EXTRA_EVENT_COUNT=4;               ///<监听socket等内部socket预留的事件数量
+
+            /**
+             * kqueue的读、写是两个独立的过滤器，每个socket最多同时返回两个事件
+             */
+            constexpr int KQUEUE_FILTER_PER_SOCKET=2;
+
+            inline void *MakeUData(TCPAccept *sock_obj)
+            {
+                return (void *)((uintptr_t)sock_obj|KQUEUE_TAG_ACCEPT);
+            }
+
+            inline void *MakeUData(DatagramSocket *udp)
+            {
+                return (void *)((uintptr_t)udp|KQUEUE_TAG_DATAGRAM);
+            }
+
+            inline void *MakeUData(int sock,uintptr_t tag)
+            {
+                return (void *)(((uintptr_t)sock<<2)|tag);
+            }
+        }//namespace
+
+        /**
+         * 基于kqueue的Socket管理(macOS/FreeBSD/OpenBSD/NetBSD)<br>
+         * 与epoll版相同，全部使用边缘模式(EV_CLEAR)，收到事件后需要一直读/写到EAGAIN为止。<br>
+         * 读事件的SocketEvent::size为kevent.data给出的可读字节数，写事件的size为发送缓冲区剩余空间。
+         */
+        class SocketManageKqueue:public SocketManageBase
+        {
+        protected:
+
+            int kqueue_fd;
+
+            int max_connect;
+            int cur_count;
+            int datagram_count;
+
+            int listen_sock;
+            int wake_pipe[2];                                       ///<用于从其它线程唤醒kevent的管道
+
+        protected:
+
+            struct kevent *event_list;
+
+            List<struct kevent> change_list;                        ///<批量加入/分离时使用的修改列表(同时用于接收EV_RECEIPT结果)
+
+        private:
+
+            bool kqueue_change(struct kevent *change_list,int count)
+            {
+                return(kevent(kqueue_fd,change_list,count,nullptr,0,nullptr)!=-1);
+            }
+
+            static bool SetNonBlockCloExec(int fd)
+            {
+                const int flags=fcntl(fd,F_GETFL,0);
+
+                if(flags==-1)return(false);
+                if(fcntl(fd,F_SETFL,flags|O_NONBLOCK)==-1)return(false);
+
+                return(fcntl(fd,F_SETFD,FD_CLOEXEC)!=-1);
+            }
+
+            void CreateWakePipe()
+            {
+                wake_pipe[0]=wake_pipe[1]=-1;
+
+                //EVFILT_USER在部分BSD上不可用，所以统一使用管道
+                if(pipe(wake_pipe)==-1)
+                {
+                    wake_pipe[0]=wake_pipe[1]=-1;
+                    LOG_ERROR(OS_TEXT("SocketManageKqueue create wake pipe failed,errno:")+OSString::numberOf(errno));
+                    return;
+                }
+
+                SetNonBlockCloExec(wake_pipe[0]);
+                SetNonBlockCloExec(wake_pipe[1]);
+
+                struct kevent ev;
+
+                EV_SET(&ev,wake_pipe[0],EVFILT_READ,EV_ADD|EV_CLEAR,0,0,MakeUData(wake_pipe[0],KQUEUE_TAG_WAKE));
+
+                if(!kqueue_change(&ev,1))
+                {
+                    LOG_ERROR(OS_TEXT("SocketManageKqueue add wake pipe failed,errno:")+OSString::numberOf(errno));
+                    CloseWakePipe();
+                }
+            }
+
+            void CloseWakePipe()
+            {
+                if(wake_pipe[0]!=-1)close(wake_pipe[0]);
+                if(wake_pipe[1]!=-1)close(wake_pipe[1]);
+
+                wake_pipe[0]=wake_pipe[1]=-1;
+            }
+
+        public:
+
+            SocketManageKqueue(int kqfd,int mc)
+            {
+                kqueue_fd=kqfd;
+
+                max_connect=mc;
+                cur_count=0;
+                datagram_count=0;
+
+                listen_sock=-1;
+
+                event_list=new struct kevent[max_connect*KQUEUE_FILTER_PER_SOCKET+KQUEUE_EXTRA_EVENT_COUNT];
+
+                CreateWakePipe();
+            }
+
+            ~SocketManageKqueue()
+            {
+                delete[] event_list;
+
+                CloseWakePipe();
+
+                if(kqueue_fd!=-1)
+                    close(kqueue_fd);
+            }
+
+            bool Wake() override
+            {
+                if(wake_pipe[1]==-1)
+                    return(false);
+
+                const char value=1;
+
+                const ssize_t result=write(wake_pipe[1],&value,1);
+
+                return(result==1||errno==EAGAIN);                   //管道满了说明已经有未处理的唤醒
+            }
+
+            bool Join(TCPAccept *sock_obj) override
+            {
+                const int sock=sock_obj->ThisSocket;
+
+                struct kevent ev[2];
+
+                //写过滤器先以禁用状态加入，有数据待发时由Change()打开
+                EV_SET(ev  ,sock,EVFILT_READ ,EV_ADD|EV_CLEAR           ,0,0,MakeUData(sock_obj));
+                EV_SET(ev+1,sock,EVFILT_WRITE,EV_ADD|EV_CLEAR|EV_DISABLE,0,0,MakeUData(sock_obj));
+
+                if(!kqueue_change(ev,2))
+                {
+                    NET_LOG_ERROR("SocketManageKqueue::Join() kevent failed,Socket:{},errno:{}",sock,errno);
+                    return(false);
+                }
+
+                ++cur_count;
+
+                return(true);
+            }
+
+            /**
+             * 批量加入，所有socket的读写过滤器通过一次kevent提交<br>
+             * 使用EV_RECEIPT取得每一项的结果，失败的对象在列表中被置为nullptr
+             */
+            int Join(TCPAccept **sock_list,int count) override
+            {
+                if(count<=0)return(0);
+
+                const int change_count=count*KQUEUE_FILTER_PER_SOCKET;
+
+                change_list.SetCount(change_count);
+
+                struct kevent *ev=change_list.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    EV_SET(ev  ,sock_list[i]->ThisSocket,EVFILT_READ ,EV_ADD|EV_CLEAR|EV_RECEIPT           ,0,0,MakeUData(sock_list[i]));
+                    EV_SET(ev+1,sock_list[i]->ThisSocket,EVFILT_WRITE,EV_ADD|EV_CLEAR|EV_RECEIPT|EV_DISABLE,0,0,MakeUData(sock_list[i]));
+
+                    ev+=KQUEUE_FILTER_PER_SOCKET;
+                }
+
+                ev=change_list.GetData();
+
+                const int result=kevent(kqueue_fd,ev,change_count,ev,change_count,nullptr);       //修改列表与结果列表可以是同一个数组
+
+                if(result<0)
+                {
+                    NET_LOG_ERROR("SocketManageKqueue::Join() kevent failed,count:{},errno:{}",count,errno);
+
+                    for(int i=0;i<count;i++)
+                        sock_list[i]=nullptr;
+
+                    return(0);
+                }
+
+                int fail=0;
+                int err=0;
+
+                for(int i=0;i<result;i++)
+                {
+                    if((ev->flags&EV_ERROR)&&ev->data!=0)
+                    {
+                        const TCPAccept *obj=(const TCPAccept *)((uintptr_t)ev->udata&~KQUEUE_TAG_MASK);
+
+                        for(int j=0;j<count;j++)                    //失败是少数情况，直接查找
+                        {
+                            if(sock_list[j]!=obj)continue;
+
+                            struct kevent del[2];
+
+                            EV_SET(del  ,obj->ThisSocket,EVFILT_READ ,EV_DELETE,0,0,nullptr);
+                            EV_SET(del+1,obj->ThisSocket,EVFILT_WRITE,EV_DELETE,0,0,nullptr);
+
+                            kqueue_change(del,2);
+
+                            sock_list[j]=nullptr;
+                            ++fail;
+                            err=(int)ev->data;
+                            break;
+                        }
+                    }
+
+                    ++ev;
+                }
+
+                if(fail>0)
+                    NET_LOG_ERROR("SocketManageKqueue::Join() failed {} of {},last errno:{}",fail,count,err);
+
+                cur_count+=count-fail;
+                return count-fail;
+            }
+
+            bool JoinDatagram(DatagramSocket *udp) override
+            {
+                const int sock=udp->ThisSocket;
+
+                struct kevent ev;
+
+                EV_SET(&ev,sock,EVFILT_READ,EV_ADD|EV_CLEAR,0,0,MakeUData(udp));
+
+                if(!kqueue_change(&ev,1))
+                {
+                    NET_LOG_ERROR("SocketManageKqueue::JoinDatagram() kevent failed,Socket:{},errno:{}",sock,errno);
+                    return(false);
+                }
+
+                ++datagram_count;
+                return(true);
+            }
+
+            bool UnjoinDatagram(DatagramSocket *udp) override
+            {
+                if(kqueue_fd==-1)
+                    return(false);
+
+                struct kevent ev;
+
+                EV_SET(&ev,udp->ThisSocket,EVFILT_READ,EV_DELETE,0,0,nullptr);
+
+                if(!kqueue_change(&ev,1))
+                    return(false);
+
+                --datagram_count;
+                return(true);
+            }
+
+            bool JoinListen(int sock) override
+            {
+                if(listen_sock!=-1)
+                    return(false);
+
+                SetSocketBlock(sock,false);
+
+                struct kevent ev;
+
+                //监听socket同样使用边缘模式，有新连接时需一直accept到EAGAIN为止
+                EV_SET(&ev,sock,EVFILT_READ,EV_ADD|EV_CLEAR,0,0,MakeUData(sock,KQUEUE_TAG_LISTEN));
+
+                if(!kqueue_change(&ev,1))
+                {
+                    NET_LOG_ERROR("SocketManageKqueue::JoinListen() kevent failed,Socket:{},errno:{}",sock,errno);
+                    return(false);
+                }
+
+                listen_sock=sock;
+                return(true);
+            }
+
+            void UnjoinListen() override
+            {
+                if(listen_sock==-1)
+                    return;
+
+                struct kevent ev;
+
+                EV_SET(&ev,listen_sock,EVFILT_READ,EV_DELETE,0,0,nullptr);
+
+                kqueue_change(&ev,1);
+                listen_sock=-1;
+            }
+
+            bool Unjoin(TCPAccept *sock_obj) override
+            {
+                if(kqueue_fd==-1)
+                {
+                    NET_LOG_ERROR("SocketManageKqueue::Unjoin() kqueue_fd==-1)");
+                    return(false);
+                }
+
+                struct kevent ev[2];
+
+                EV_SET(ev  ,sock_obj->ThisSocket,EVFILT_READ ,EV_DELETE,0,0,nullptr);
+                EV_SET(ev+1,sock_obj->ThisSocket,EVFILT_WRITE,EV_DELETE,0,0,nullptr);
+
+                --cur_count;
+                kqueue_change(ev,2);
+
+                return(true);
+            }
+
+            /**
+             * 批量分离，一次kevent提交所有删除
+             */
+            int Unjoin(TCPAccept **sock_list,int count) override
+            {
+                if(kqueue_fd==-1||count<=0)
+                    return(0);
+
+                const int change_count=count*KQUEUE_FILTER_PER_SOCKET;
+
+                change_list.SetCount(change_count);
+
+                struct kevent *ev=change_list.GetData();
+
+                for(int i=0;i<count;i++)
+                {
+                    EV_SET(ev  ,sock_list[i]->ThisSocket,EVFILT_READ ,EV_DELETE|EV_RECEIPT,0,0,nullptr);
+                    EV_SET(ev+1,sock_list[i]->ThisSocket,EVFILT_WRITE,EV_DELETE|EV_RECEIPT,0,0,nullptr);
+
+                    ev+=KQUEUE_FILTER_PER_SOCKET;
+                }
+
+                ev=change_list.GetData();
+
+                kevent(kqueue_fd,ev,change_count,ev,change_count,nullptr);     //有EV_RECEIPT时个别失败不会中断其它项
+
+                cur_count-=count;
+                return count;
+            }
+
+            bool Change(TCPAccept *sock_obj,bool recv,bool send) override
+            {
+                if(kqueue_fd==-1)
+                    return(false);
+
+                struct kevent ev[2];
+
+                EV_SET(ev  ,sock_obj->ThisSocket,EVFILT_READ ,EV_ADD|EV_CLEAR|(recv?EV_ENABLE:EV_DISABLE),0,0,MakeUData(sock_obj));
+                EV_SET(ev+1,sock_obj->ThisSocket,EVFILT_WRITE,EV_ADD|EV_CLEAR|(send?EV_ENABLE:EV_DISABLE),0,0,MakeUData(sock_obj));
+
+                return kqueue_change(ev,2);
+            }
+
+            int GetCount()const override
+            {
+                return cur_count;
+            }
+
+            void Clear() override
+            {
+                if(kqueue_fd!=-1)
+                {
+                    close(kqueue_fd);
+                    kqueue_fd=-1;
+                }
+
+                CloseWakePipe();
+
+                cur_count=0;
+                datagram_count=0;
+                listen_sock=-1;
+            }
+
+            int Update(const double &time_out,SocketEventList &sel) override
+            {
+                int event_count=0;
+
+                if(kqueue_fd==-1)
+                    return(-1);
+
+                int wait_count=cur_count*KQUEUE_FILTER_PER_SOCKET+datagram_count+(listen_sock!=-1?1:0)+(wake_pipe[0]!=-1?1:0);
+
+                if(wait_count<=0)
+                    return(0);
+
+                if(wait_count>max_connect*KQUEUE_FILTER_PER_SOCKET+KQUEUE_EXTRA_EVENT_COUNT)
+                    wait_count=max_connect*KQUEUE_FILTER_PER_SOCKET+KQUEUE_EXTRA_EVENT_COUNT;
+
+                if(time_out<0)
+                {
+                    event_count=kevent(kqueue_fd,nullptr,0,event_list,wait_count,nullptr);
+                }
+                else
+                {
+                    struct timespec ts;
+
+                    ts.tv_sec=(time_t)time_out;
+                    ts.tv_nsec=(long)((time_out-ts.tv_sec)*HGL_NANO_SEC_PER_SEC);
+
+                    event_count=kevent(kqueue_fd,nullptr,0,event_list,wait_count,&ts);
+                }
+
+                if(event_count==0)
+                    return(0);
+
+                if(event_count<0)
+                {
+                    NET_LOG_INFO("kevent return -1,errno: {}",errno);
+
+                    if(errno==EBADF
+                     ||errno==EFAULT
+                     ||errno==EINVAL)
+                        return(-1);
+
+                    return(0);
+                }
+
+                sel.PreMalloc(event_count);
+
+                struct kevent *ke=this->event_list;
+
+                SocketEvent *se=sel.GetData();
+                SocketEvent *last=nullptr;
+
+                int num=0;
+
+                TCPAccept *sock_obj;
+
+                for(int i=0;i<event_count;i++)
+                {
+                    const uintptr_t tag=(uintptr_t)ke->udata&KQUEUE_TAG_MASK;
+
+                    if(tag==KQUEUE_TAG_LISTEN)
+                    {
+                        listen_ready=true;                  //有新连接
+                        ++ke;
+                        continue;
+                    }
+
+                    if(tag==KQUEUE_TAG_WAKE)                //被其它线程唤醒，读空管道即可
+                    {
+                        char buf[64];
+
+                        while(read(wake_pipe[0],buf,sizeof(buf))>0);
+
+                        ++ke;
+                        continue;
+                    }
+
+                    if(tag==KQUEUE_TAG_DATAGRAM)            //UDP只有读过滤器，不需要合并
+                    {
+                        DatagramSocket *udp=(DatagramSocket *)((uintptr_t)ke->udata&~KQUEUE_TAG_MASK);
+
+                        se->sock=udp->ThisSocket;
+                        se->accept=nullptr;
+                        se->datagram=udp;
+                        se->events=0;
+                        se->size=0;
+                        se->error=0;
+
+                        if(ke->flags&EV_ERROR)
+                        {
+                            se->events=SOCKET_EVENT_ERROR;
+                            se->error=(int)ke->data;
+                        }
+                        else
+                        if(ke->data>0)
+                        {
+                            se->events=SOCKET_EVENT_RECV;
+                            se->size=(int)ke->data;
+                        }
+
+                        last=nullptr;
+                        ++se;
+                        ++num;
+                        ++ke;
+                        continue;
+                    }
+
+                    sock_obj=(TCPAccept *)((uintptr_t)ke->udata&~KQUEUE_TAG_MASK);
+
+                    SocketEvent *ev;
+
+                    if(last&&last->accept==sock_obj)        //读写两个filter是分开返回的，通常相邻，合并到同一项
+                    {
+                        ev=last;
+                    }
+                    else
+                    {
+                        ev=se;
+                        ev->sock=sock_obj->ThisSocket;
+                        ev->accept=sock_obj;
+                        ev->datagram=nullptr;
+                        ev->events=0;
+                        ev->size=0;
+                        ev->error=0;
+
+                        last=ev;
+                        ++se;
+                        ++num;
+                    }
+
+                    if(ke->flags&EV_ERROR)                  //出错了，data为错误号
+                    {
+                        NET_LOG_ERROR("SocketManageKqueue Error,socket:{},errno:{}",sock_obj->ThisSocket,(int)ke->data);
+
+                        ev->events|=SOCKET_EVENT_ERROR;
+                        ev->error=(int)ke->data;
+                    }
+                    else
+                    if(ke->filter==EVFILT_READ)
+                    {
+                        if(ke->data>0)                      //可以读数据
+                        {
+                            ev->events|=SOCKET_EVENT_RECV;
+                            ev->size=(int)ke->data;         //socket缓冲区中可读的字节数
+                        }
+
+                        if(ke->flags&EV_EOF)                //对方关了，SocketManage会先读完剩余数据
+                        {
+                            ev->events|=SOCKET_EVENT_HUP;
+                            ev->error=(int)ke->fflags;      //EV_EOF时fflags为socket错误号
+                        }
+                    }
+                    else
+                    if(ke->filter==EVFILT_WRITE)            //可以发数据
+                    {
+                        ev->events|=SOCKET_EVENT_SEND;      //size只记录可读长度，发送缓冲区剩余空间不需要
+                    }
+
+                    ++ke;
+                }
+
+                sel.SetCount(num);
+
+                return(event_count);
+            }
+        };//class SocketManageKqueue:public SocketManageBase
+
+        SocketManageBase *CreateSocketManageBase(int max_user)
+        {
+            if(max_user<=0)return(nullptr);
+
+            int kqueue_fd=kqueue();
+
+            if(kqueue_fd<0)
+            {
+                LOG_ERROR(OS_TEXT("kqueue return error,errno is")+OSString::numberOf(errno));
+                return(nullptr);
+            }
+
+            return(new SocketManageKqueue(kqueue_fd,max_user));
+        }
+
+        SocketManageBase *CreateSocketManageBusyPoll(int,const SocketBusyPollConfig &)
+        {
+            return(nullptr);                                                    //kqueue没有内核忙轮循
+        }
+    }//namespace network
+}//namespace hgl
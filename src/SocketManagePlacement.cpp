@@ -0,0 +1,70 @@
+﻿#include<hgl/network/SocketManagePlacement.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        int SocketManagePlacement::Select(const int hint)
+        {
+            const int count=load_list.GetCount();
+
+            if(count<=0)return(-1);
+
+            SocketManageLoad **ll=load_list.GetData();
+
+            int index;
+
+            if(policy==SocketPlacementPolicy::Fixed)
+            {
+                index=(hint>=0?hint%count:0);
+            }
+            else
+            {
+                const uint start=next.fetch_add(1,std::memory_order_relaxed)%count;      //并列时从不同位置开始，避免都涌向第一个
+
+                index=start;
+
+                if(policy==SocketPlacementPolicy::LeastConnection)
+                {
+                    int min_load=ll[start]->GetConnectionLoad();
+
+                    for(int i=1;i<count;i++)
+                    {
+                        const int n=(start+i)%count;
+                        const int load=ll[n]->GetConnectionLoad();
+
+                        if(load<min_load)
+                        {
+                            min_load=load;
+                            index=n;
+                        }
+                    }
+                }
+                else
+                if(policy==SocketPlacementPolicy::LeastEventLoad)
+                {
+                    uint min_event=ll[start]->GetEventLoad();
+                    int  min_conn =ll[start]->GetConnectionLoad();
+
+                    for(int i=1;i<count;i++)
+                    {
+                        const int n=(start+i)%count;
+                        const uint event=ll[n]->GetEventLoad();
+                        const int  conn =ll[n]->GetConnectionLoad();
+
+                        if(event<min_event
+                         ||(event==min_event&&conn<min_conn))
+                        {
+                            min_event=event;
+                            min_conn=conn;
+                            index=n;
+                        }
+                    }
+                }
+            }
+
+            ll[index]->pending.fetch_add(1,std::memory_order_relaxed);          //目标线程加入后减去，避免同一时刻的连接都分给同一个线程
+            return index;
+        }
+    }//namespace network
+}//namespace hgl
@@ -1,8 +1,11 @@
 ﻿#include"SocketManageBase.h"
-#include<hgl/network/Socket.h>
+#include<hgl/network/TCPAccept.h>
+#include<hgl/network/DatagramSocket.h>
 #include<hgl/Time.h>
 #include<hgl/type/SortedSet.h>
+#include<hgl/type/Map.h>
 #include<hgl/log/LogInfo.h>
+#include<hgl/network/NetLog.h>
 
 namespace hgl
 {
@@ -17,16 +20,68 @@ namespace hgl
 
             int max_fd;
 
+            int listen_sock;
+            int wake_sock;                                          ///<唤醒用的本地回环UDP socket(连接到自己)
+
             SortedSet<int> sock_id_list;
+            Map<int,TCPAccept *> sock_obj_list;     //select只能返回socket，所以这里自行保留对应关系
+            Map<int,DatagramSocket *> datagram_list;     //加入的DatagramSocket，只关注recv
 
             fd_set  fd_sock_list;       //完整的sock列表
+            fd_set  fd_recv_watch;      //需要关注recv的sock列表
+            fd_set  fd_send_watch;      //需要关注send的sock列表(仅有数据待发时加入，否则select会一直返回可写)
 
             fd_set  fd_recv_list;
             fd_set  fd_send_list;
             fd_set  fd_error_list;
 
+            Map<int,int> event_index;               //本次Update中socket对应的事件序号，同一socket的读/写/错误合并到同一项
+
             timeval time_out,*time_par;
 
+        private:
+
+            bool CreateWakeSocket()
+            {
+                wake_sock=socket(AF_INET,SOCK_DGRAM,IPPROTO_UDP);
+
+                if(wake_sock<0)
+                {
+                    wake_sock=-1;
+                    return(false);
+                }
+
+                sockaddr_in addr;
+                socklen_t addr_size=sizeof(addr);
+
+                hgl_zero(addr);
+                addr.sin_family=AF_INET;
+                addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+                addr.sin_port=0;
+
+                if(bind(wake_sock,(sockaddr *)&addr,sizeof(addr))
+                 ||getsockname(wake_sock,(sockaddr *)&addr,&addr_size)
+                 ||connect(wake_sock,(sockaddr *)&addr,sizeof(addr)))
+                {
+                    hgl::CloseSocket(wake_sock);
+                    wake_sock=-1;
+                    return(false);
+                }
+
+                SetSocketBlock(wake_sock,false);
+                return(true);
+            }
+
+            void AddWakeSocket()
+            {
+                if(wake_sock==-1)return;
+
+                FD_SET(wake_sock,&fd_recv_watch);
+
+                if(wake_sock>max_fd)
+                    max_fd=wake_sock;
+            }
+
         public:
 
             SocketManageSelect(int mc)
@@ -34,37 +89,123 @@ namespace hgl
                 cur_count=0;
                 max_connect=mc;
                 max_fd=0;
+                listen_sock=-1;
+
+                if(!CreateWakeSocket())
+                    LOG_ERROR(OS_TEXT("SocketManageSelect create wake socket failed,errno:")+OSString::numberOf(GetLastSocketError()));
 
                 Clear();
             }
 
-            bool Join(int sock) override
+            ~SocketManageSelect()
+            {
+                if(wake_sock!=-1)
+                    hgl::CloseSocket(wake_sock);
+            }
+
+            bool Wake() override
+            {
+                if(wake_sock==-1)
+                    return(false);
+
+                const char value=0;
+
+                return(send(wake_sock,&value,1,0)==1);
+            }
+
+            bool Join(TCPAccept *sock_obj) override
             {
+                const int sock=sock_obj->ThisSocket;
+
                 FD_SET(sock,&fd_sock_list);
+                FD_SET(sock,&fd_recv_watch);
 
                 sock_id_list.Add(sock);
+                sock_obj_list.Add(sock,sock_obj);
 
                 if(sock>max_fd)
                     max_fd=sock;
 
+                cur_count++;
+
+                return(true);
+            }
+
+            bool JoinDatagram(DatagramSocket *udp) override
+            {
+                const int sock=udp->ThisSocket;
+
+                if(sock_obj_list.ContainsKey(sock)||datagram_list.ContainsKey(sock))
+                    return(false);
+
+                FD_SET(sock,&fd_recv_watch);
+
+                datagram_list.Add(sock,udp);
+
+                if(sock>max_fd)
+                    max_fd=sock;
+
+                return(true);
+            }
+
+            bool UnjoinDatagram(DatagramSocket *udp) override
+            {
+                const int sock=udp->ThisSocket;
+
+                if(!datagram_list.DeleteByKey(sock))
+                    return(false);
+
+                FD_CLR(sock,&fd_recv_watch);
+                return(true);
+            }
+
+            bool JoinListen(int sock) override
+            {
+                if(listen_sock!=-1)
+                    return(false);
+
                 SetSocketBlock(sock,false);
 
-                cur_count++;
+                FD_SET(sock,&fd_recv_watch);
 
-                LOG_INFO(OS_TEXT("Join ")+OSString::numberOf(sock)+OS_TEXT(" to SocketManageSelect"));
+                if(sock>max_fd)
+                    max_fd=sock;
 
+                listen_sock=sock;
                 return(true);
             }
 
-            bool Unjoin(int sock) override
+            void UnjoinListen() override
             {
+                if(listen_sock==-1)
+                    return;
+
+                FD_CLR(listen_sock,&fd_recv_watch);
+                listen_sock=-1;
+            }
+
+            bool Unjoin(TCPAccept *sock_obj) override
+            {
+                const int sock=sock_obj->ThisSocket;
+
                 cur_count--;
 
                 FD_CLR(sock,&fd_sock_list);
+                FD_CLR(sock,&fd_recv_watch);
+                FD_CLR(sock,&fd_send_watch);
 
                 sock_id_list.Delete(sock);
+                sock_obj_list.DeleteByKey(sock);
 
-                LOG_INFO(OS_TEXT("Unjoin ")+OSString::numberOf(sock)+OS_TEXT(" from SocketManageSelect"));
+                return(true);
+            }
+
+            bool Change(TCPAccept *sock_obj,bool recv,bool send) override
+            {
+                const int sock=sock_obj->ThisSocket;
+
+                if(recv)FD_SET(sock,&fd_recv_watch);else FD_CLR(sock,&fd_recv_watch);
+                if(send)FD_SET(sock,&fd_send_watch);else FD_CLR(sock,&fd_send_watch);
 
                 return(true);
             }
@@ -81,30 +222,78 @@ namespace hgl
                 max_fd=0;
 
                 FD_ZERO(&fd_sock_list);
+                FD_ZERO(&fd_recv_watch);
+                FD_ZERO(&fd_send_watch);
                 FD_ZERO(&fd_recv_list);
                 FD_ZERO(&fd_send_list);
                 FD_ZERO(&fd_error_list);
+
+                sock_id_list.Clear();
+                sock_obj_list.Clear();
+                datagram_list.Clear();
+
+                listen_sock=-1;
+
+                AddWakeSocket();
             }
 
-            int ConvertList(SocketEventList &sel,const fd_set &fs)
+            void ConvertList(SocketEventList &sel,const fd_set &fs,const uint flag)
             {
-                sel.SetCount(fs.fd_count);
-
-                SocketEvent *p=sel.GetData();
+                TCPAccept *sock_obj;
+                DatagramSocket *udp=nullptr;
+                int index;
 
                 for(uint i=0;i<fs.fd_count;i++)
                 {
-                    p->sock=fs.fd_array[i];
+                    const int sock=fs.fd_array[i];
+
+                    if(sock==listen_sock)                   //监听socket有新连接
+                    {
+                        listen_ready=true;
+                        continue;
+                    }
+
+                    if(sock==wake_sock)                     //被其它线程唤醒，读掉数据即可
+                    {
+                        char buf[64];
+
+                        while(recv(wake_sock,buf,sizeof(buf),0)>0);
+                        continue;
+                    }
+
+                    if(event_index.Get(sock,index))
+                    {
+                        sel.GetData()[index].events|=flag;
+                        continue;
+                    }
+
+                    if(!sock_obj_list.Get(sock,sock_obj))
+                    {
+                        sock_obj=nullptr;
+
+                        if(!datagram_list.Get(sock,udp))
+                            continue;
+                    }
+
+                    index=sel.GetCount();
+                    sel.SetCount(index+1);
+
+                    SocketEvent *p=sel.GetData()+index;
+
+                    p->sock=sock;
+                    p->accept=sock_obj;
+                    p->datagram=sock_obj?nullptr:udp;
+                    p->events=flag;
                     p->size=-1;
-                    ++p;
-                }
+                    p->error=0;
 
-                return fs.fd_count;
+                    event_index.Add(sock,index);
+                }
             }
 
-            int Update(const double &to,SocketEventList &recv_list,SocketEventList &send_list,SocketEventList &error_list) override
+            int Update(const double &to,SocketEventList &sel) override
             {
-                if(cur_count<=0)
+                if(cur_count<=0&&datagram_list.GetCount()<=0&&listen_sock==-1&&wake_sock==-1)
                     return(0);
 
                 if(to<=0)
@@ -116,13 +305,13 @@ namespace hgl
                     time_par=&time_out;
                 }
 
-                memcpy(&fd_recv_list,   &fd_sock_list,sizeof(fd_sock_list));
-                memcpy(&fd_send_list,   &fd_sock_list,sizeof(fd_sock_list));
+                memcpy(&fd_recv_list,   &fd_recv_watch,sizeof(fd_recv_watch));
+                memcpy(&fd_send_list,   &fd_send_watch,sizeof(fd_send_watch));
                 memcpy(&fd_error_list,  &fd_sock_list,sizeof(fd_sock_list));
 
                 if(select(max_fd+1,&fd_recv_list,&fd_send_list,&fd_error_list,time_par)<0)
                 {
-                    LOG_INFO(OS_TEXT("select return -1,errno: ")+OSString::numberOf(errno));
+                    NET_LOG_INFO("select return -1,errno: {}",errno);
 
                     if(errno==EBADF
                      ||errno==EFAULT
@@ -132,19 +321,34 @@ namespace hgl
                     return(0);
                 }
 
-                ConvertList(recv_list,fd_recv_list);
-                ConvertList(send_list,fd_send_list);
-                ConvertList(error_list,fd_error_list);
+                sel.PreMalloc(fd_recv_list.fd_count+fd_send_list.fd_count+fd_error_list.fd_count);
+                sel.SetCount(0);
 
-                return(fd_recv_list.fd_count
-                      +fd_send_list.fd_count
-                      +fd_error_list.fd_count);
+                event_index.Clear();
+
+                ConvertList(sel,fd_recv_list,  SOCKET_EVENT_RECV);
+                ConvertList(sel,fd_send_list,  SOCKET_EVENT_SEND);
+                ConvertList(sel,fd_error_list, SOCKET_EVENT_ERROR);
+
+                return(sel.GetCount());
             }
         };//class SocketManageSelect:public SocketManageBase
 
+        SocketManageBase *CreateSocketManageIOCP(int max_user);
+
         SocketManageBase *CreateSocketManageBase(int max_user)
         {
+            SocketManageBase *sm=CreateSocketManageIOCP(max_user);     //优先使用完成端口，select受FD_SETSIZE限制仅作为后备
+
+            if(sm)
+                return(sm);
+
             return(new SocketManageSelect(max_user));
         }
+
+        SocketManageBase *CreateSocketManageBusyPoll(int,const SocketBusyPollConfig &)
+        {
+            return(nullptr);                                                    //Windows没有内核忙轮循
+        }
     }//namespace network
 }//namespace hgl
@@ -2,6 +2,21 @@
 #include<hgl/io/DataOutputStream.h>
 #include<hgl/network/TCPSocket.h>
 #include<hgl/log/LogInfo.h>
+
+#if HGL_OS != HGL_OS_Windows
+#include<sys/uio.h>
+#include<unistd.h>
+#else
+#include<io.h>
+#endif//HGL_OS != HGL_OS_Windows
+
+#if HGL_OS == HGL_OS_Linux
+#include<sys/sendfile.h>
+#include<fcntl.h>
+#elif (HGL_OS == HGL_OS_FreeBSD)||(HGL_OS == HGL_OS_macOS)
+#include<sys/types.h>
+#include<sys/socket.h>
+#endif//HGL_OS == HGL_OS_Linux
 namespace hgl
 {
     namespace network
@@ -26,7 +41,7 @@ namespace hgl
         * 向socket中写入指定的字节数
         * @param buf 数据缓冲区
         * @param size 预想写入的字节数
-        * @return 成功写入的字节数
+        * @return 成功写入的字节数(非阻塞socket缓冲区已满时返回0)
         * @return -1 失败
         */
         int64 SocketOutputStream::Write(const void *buf,int64 size)
@@ -62,6 +77,10 @@ namespace hgl
             {
                 int err=GetLastSocketError();
 
+                if(err==nseWouldBlock
+                 ||err==nseInt)         //非阻塞socket缓冲区已满或被信号中断，并不是错误
+                    return(0);
+
                 LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" send ")+OSString::numberOf(size)+OS_TEXT(" bytes failed,,error: ")+OSString::numberOf(err)+OS_TEXT(",")+GetSocketString(err));
             }
 
@@ -165,6 +184,216 @@ namespace hgl
             return(p-(char *)buf);
         }
 
+        /**
+        * 以一次系统调用(writev/WSASend)向socket中写入多段数据，超过HGL_SOCKET_IOVEC_MAX段的部分本次不写
+        * @param vec 数据段列表
+        * @param count 数据段数量
+        * @return 成功写入的字节数(非阻塞socket缓冲区已满时返回0)
+        * @return -1 失败
+        */
+        int64 SocketOutputStream::WriteVector(const SocketIOVec *vec,int count)
+        {
+            if(sock==-1)
+            {
+                LOG_ERROR(OS_TEXT("SocketOutputStream::WriteVector() fatal error,sock=-1"));
+                return(-1);
+            }
+
+            if(!vec||count<=0)return(0);
+
+            if(count>HGL_SOCKET_IOVEC_MAX)
+                count=HGL_SOCKET_IOVEC_MAX;
+
+#if HGL_OS == HGL_OS_Windows
+            WSABUF buf_list[HGL_SOCKET_IOVEC_MAX];
+
+            for(int i=0;i<count;i++)
+            {
+                buf_list[i].buf=(CHAR *)(vec[i].data);
+                buf_list[i].len=(ULONG)(vec[i].size);
+            }
+
+            DWORD send_bytes=0;
+
+            const int64 result=(WSASend(sock,buf_list,count,&send_bytes,0,nullptr,nullptr)==SOCKET_ERROR?-1:send_bytes);
+#else
+            iovec buf_list[HGL_SOCKET_IOVEC_MAX];
+
+            for(int i=0;i<count;i++)
+            {
+                buf_list[i].iov_base=(void *)(vec[i].data);
+                buf_list[i].iov_len=vec[i].size;
+            }
+
+            const int64 result=writev(sock,buf_list,count);
+#endif//HGL_OS == HGL_OS_Windows
+
+            if(result>=0)
+            {
+                total+=result;
+                return(result);
+            }
+
+            int err=GetLastSocketError();
+
+            if(err==nseWouldBlock
+             ||err==nseInt)
+                return(0);
+
+            LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" writev ")+OSString::numberOf(count)+OS_TEXT(" segments failed,error: ")+OSString::numberOf(err)+OS_TEXT(",")+GetSocketString(err));
+            return(-1);
+        }
+
+        /**
+        * 将文件或管道中的数据直接写入socket，数据不复制到用户空间<br>
+        * Linux使用sendfile(管道使用splice)，FreeBSD/macOS使用sendfile，
+        * 其它系统(包括Windows，TransmitFile会绕过SocketManage的完成端口)退化为读入临时缓冲区再发送，此时只支持指定偏移的文件
+        * @param fd 文件句柄
+        * @param offset 文件偏移(不改变fd的当前位置)，<0表示从fd的当前位置读取(管道)
+        * @param size 最多写入的字节数
+        * @return 成功写入的字节数(非阻塞socket缓冲区已满时返回0)
+        * @return -1 失败(包括文件数据不足size字节)
+        */
+        int64 SocketOutputStream::WriteFile(int fd,int64 offset,int64 size)
+        {
+            if(sock==-1)
+            {
+                LOG_ERROR(OS_TEXT("SocketOutputStream::WriteFile() fatal error,sock=-1"));
+                return(-1);
+            }
+
+            if(fd<0)return(-1);
+            if(size<=0)return(0);
+
+            int64 result;
+
+#if HGL_OS == HGL_OS_Linux
+            if(offset>=0)
+            {
+                off_t off=offset;
+
+                result=sendfile(sock,fd,&off,size_t(size));
+            }
+            else
+            {
+                result=splice(fd,nullptr,sock,nullptr,size_t(size),SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+                if(result<0&&errno==EINVAL)                                             //fd不是管道，从当前位置sendfile
+                    result=sendfile(sock,fd,nullptr,size_t(size));
+            }
+#elif (HGL_OS == HGL_OS_FreeBSD)||(HGL_OS == HGL_OS_macOS)
+            if(offset<0)
+            {
+                LOG_ERROR(OS_TEXT("SocketOutputStream::WriteFile() need offset,sock=")+OSString::numberOf(sock));
+                return(-1);
+            }
+
+    #if HGL_OS == HGL_OS_FreeBSD
+            off_t sent=0;
+
+            const int r=sendfile(fd,sock,offset,size_t(size),nullptr,&sent,0);
+    #else
+            off_t sent=size;
+
+            const int r=sendfile(fd,sock,offset,&sent,nullptr,0);
+    #endif//HGL_OS == HGL_OS_FreeBSD
+
+            result=(sent>0?int64(sent):(r==0?0:-1));                                    //缓冲区满时返回EAGAIN，但可能已发出一部分
+#else
+            if(offset<0)                                                                //读出后发不完的部分无法放回管道
+            {
+                LOG_ERROR(OS_TEXT("SocketOutputStream::WriteFile() need offset,sock=")+OSString::numberOf(sock));
+                return(-1);
+            }
+
+            char buf[HGL_SOCKET_FILE_BUFFER_SIZE];
+
+            const int want=int(size<HGL_SOCKET_FILE_BUFFER_SIZE?size:HGL_SOCKET_FILE_BUFFER_SIZE);
+
+        #if HGL_OS == HGL_OS_Windows
+            if(_lseeki64(fd,offset,SEEK_SET)!=offset)
+                return(-1);
+
+            const int64 read_size=_read(fd,buf,want);
+        #else
+            const int64 read_size=pread(fd,buf,want,offset);
+        #endif//HGL_OS == HGL_OS_Windows
+
+            if(read_size<0)
+                return(-1);
+
+            result=(read_size>0?send(sock,buf,int(read_size),0):0);
+#endif//HGL_OS == HGL_OS_Linux
+
+            if(result>0)
+            {
+                total+=result;
+                return(result);
+            }
+
+            if(result==0)                                                               //数据不足(文件已到结尾/管道已关闭)
+            {
+                LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" send file, fd ")+OSString::numberOf(fd)+OS_TEXT(" end of file."));
+                return(-1);
+            }
+
+            int err=GetLastSocketError();
+
+            if(err==nseWouldBlock
+             ||err==nseInt)
+                return(0);
+
+            LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" send file failed, fd ")+OSString::numberOf(fd)+OS_TEXT(",error: ")+OSString::numberOf(err)+OS_TEXT(",")+GetSocketString(err));
+            return(-1);
+        }
+
+        /**
+        * 以MSG_ZEROCOPY写入数据，内核直接引用这块内存而不复制，完成后从错误队列通知<br>
+        * 收到完成通知前数据不能被修改或释放。不支持的系统上，或内核暂时不能再锁定内存(ENOBUFS)时，按普通方式写入
+        * @param buf 数据缓冲区
+        * @param size 预想写入的字节数
+        * @param zero_copy 返回本次是否以零拷贝方式写入(为true时会有一个对应的完成通知)
+        * @return 成功写入的字节数(非阻塞socket缓冲区已满时返回0)
+        * @return -1 失败
+        */
+        int64 SocketOutputStream::WriteZeroCopy(const void *buf,int64 size,bool &zero_copy)
+        {
+            zero_copy=false;
+
+#if (HGL_OS == HGL_OS_Linux)&&defined(MSG_ZEROCOPY)
+            if(sock==-1)
+            {
+                LOG_ERROR(OS_TEXT("SocketOutputStream::WriteZeroCopy() fatal error,sock=-1"));
+                return(-1);
+            }
+
+            if(!buf||size<=0)return(0);
+
+            const int64 result=send(sock,buf,size,MSG_ZEROCOPY);
+
+            if(result>=0)
+            {
+                total+=result;
+                zero_copy=(result>0);
+                return(result);
+            }
+
+            if(errno!=ENOBUFS)
+            {
+                const int err=GetLastSocketError();
+
+                if(err==nseWouldBlock
+                 ||err==nseInt)
+                    return(0);
+
+                LOG_INFO(OS_TEXT("Socket ")+OSString::numberOf(sock)+OS_TEXT(" zerocopy send ")+OSString::numberOf(size)+OS_TEXT(" bytes failed,error: ")+OSString::numberOf(err)+OS_TEXT(",")+GetSocketString(err));
+                return(-1);
+            }
+#endif//(HGL_OS == HGL_OS_Linux)&&defined(MSG_ZEROCOPY)
+
+            return Write(buf,size);
+        }
+
         int64 SocketOutputStream::Available()const
         {
             int send_buf_size=0;
@@ -1,34 +1,696 @@
 ﻿#include<hgl/network/TCPAccept.h>
 #include<hgl/network/SocketInputStream.h>
 #include<hgl/network/SocketOutputStream.h>
+#include<hgl/network/SocketManage.h>
+#include<hgl/network/TLSContext.h>
 #include<hgl/io/DataInputStream.h>
 #include<hgl/io/DataOutputStream.h>
 #include<hgl/type/StrChar.h>
+#include<hgl/log/LogInfo.h>
+
+#if HGL_OS == HGL_OS_Windows
+#include<io.h>
+#else
+#include<unistd.h>
+#endif//HGL_OS == HGL_OS_Windows
+
+#if HGL_OS == HGL_OS_Linux
+#include<linux/errqueue.h>
+#endif//HGL_OS == HGL_OS_Linux
 
 namespace hgl
 {
     namespace network
     {
+        namespace
+        {
+            void CloseFile(int fd)
+            {
+            #if HGL_OS == HGL_OS_Windows
+                _close(fd);
+            #else
+                close(fd);
+            #endif//HGL_OS == HGL_OS_Windows
+            }
+        }//namespace
+
         TCPAccept::~TCPAccept()
         {
+            EndCapture();
+
+            SAFE_CLEAR(tls);
             SAFE_CLEAR(sos);
             SAFE_CLEAR(sis);
         }
 
-        bool TCPAccept::Send(void *data,const uint size)
+        /**
+         * 使用指定socket<br>
+         * 对象池复用本对象时调用，输入/输出流对象保留并改为指向新的socket，发送队列清空
+         */
+        bool TCPAccept::UseSocket(int sock,const IPAddress *addr)
+        {
+            EndCapture();                                   //上一个连接到此结束
+
+            if(!TCPSocket::UseSocket(sock,addr))
+                RETURN_FALSE;
+
+            if(sis)sis->SetSocket(sock);
+            if(sos)sos->SetSocket(sock);
+
+            send_queue.Clear();
+            send_queue.SetZeroCopy(0);                      //新的socket还没有开启SO_ZEROCOPY
+            send_watch=false;
+            connecting=false;
+            SAFE_CLEAR(tls);
+
+            send_high_watermark=0;
+            send_low_watermark=0;
+            send_over_high=false;
+            recv_pause=false;
+            close_after_send=false;
+            flush_pending=false;
+
+            idle_time_out=0;
+            last_recv_time=0;
+            timer_interval=0;
+
+            latency_trace=false;
+            trace_dispatch_time=0;
+
+            hgl_zero(tcp_info);
+
+            handoff_refused=false;
+
+            return(true);
+        }
+
+        /**
+         * 结束流量录制，在连接对象释放或复用于新连接时调用(在不同SocketManage之间迁移不算结束)
+         */
+        void TCPAccept::EndCapture()
+        {
+            if(!capture_id)return;
+
+            traffic_capture->CloseConnection(capture_id);
+            traffic_capture=nullptr;
+            capture_id=0;
+        }
+
+        /**
+         * 记录从内核收到数据到分发给回调的耗时，并记下最早一个待回复的包的分发时间<br>
+         * 同一次recv读到的多个包共用一个时间戳，排在后面的包还包含了前面的包的处理时间
+         */
+        void TCPAccept::ProcTraceDispatch()
+        {
+            const int64 now=GetSocketTimestampNow();
+            const int64 recv_time=(sis?sis->GetRecvTimestamp():0);
+
+            if(recv_time>0&&sock_manage)
+                sock_manage->GetMetrics().recv_latency.Add(double(now-recv_time)/HGL_NANO_SEC_PER_SEC);
+
+            if(!trace_dispatch_time)
+                trace_dispatch_time=now;
+        }
+
+        /**
+         * 之前分发的包的回复已全部交给内核，记录这段耗时(包括在发送队列中等待可写的时间)
+         */
+        void TCPAccept::ProcTraceSend()
+        {
+            if(sock_manage)
+                sock_manage->GetMetrics().reply_latency.Add(double(GetSocketTimestampNow()-trace_dispatch_time)/HGL_NANO_SEC_PER_SEC);
+
+            trace_dispatch_time=0;
+        }
+
+        /**
+         * 设置接收超时时间，已加入SocketManage时立即生效
+         * @param to 超时时间(秒)，<=0表示使用SocketManage的设置
+         */
+        void TCPAccept::SetIdleTimeOut(const double to)
+        {
+            idle_time_out=to;
+
+            if(sock_manage)
+                sock_manage->RestartIdleTimer(this);
+        }
+
+        /**
+         * 设置周期定时器，已加入SocketManage时立即生效
+         * @param interval 间隔时间(秒)，<=0表示关闭
+         */
+        void TCPAccept::SetTimer(const double interval)
+        {
+            timer_interval=interval;
+
+            if(sock_manage)
+                sock_manage->RestartUserTimer(this);
+        }
+
+        /**
+         * 设置发送队列高/低水位<br>
+         * 发送队列达到高水位后，新的Send/SendShared/SendFile直接返回false，直到队列降到低水位并调用OnSendQueueDrained。
+         * 只在发送前检查，一次发送不会被截断，所以队列最多超过高水位一次发送的长度
+         * @param high 高水位(字节，0表示不限制)
+         * @param low 低水位(字节，0或不小于high时使用high的一半)
+         */
+        void TCPAccept::SetSendWatermark(const uint64 high,const uint64 low)
+        {
+            send_high_watermark=high;
+            send_low_watermark=(low>0&&low<high)?low:high/2;
+
+            if(high==0)
+                send_over_high=false;
+        }
+
+        /**
+         * 暂停接收，不再关注可读事件<br>
+         * 已在接收缓冲区中的完整包也不再回调(当前正在回调的包之后的包留到恢复后)
+         */
+        bool TCPAccept::PauseRecv()
+        {
+            if(recv_pause)return(true);
+
+            recv_pause=true;
+
+            if(sock_manage)
+                return sock_manage->SetRecvWatch(this,false);
+
+            return(true);
+        }
+
+        bool TCPAccept::ResumeRecv()
+        {
+            if(!recv_pause)return(true);
+
+            recv_pause=false;
+
+            if(sock_manage)
+                return sock_manage->SetRecvWatch(this,true);
+
+            return(true);
+        }
+
+        /**
+         * 不再接收数据，发送队列中的数据全部发出后关闭连接<br>
+         * 关闭由OnSocketSend返回-1完成，队列已经为空时借延迟发送列表在本次Update结束前触发一次，只能在所属SocketManage的线程中调用
+         */
+        void TCPAccept::CloseAfterSend()
+        {
+            if(close_after_send)return;
+
+            close_after_send=true;
+            PauseRecv();
+
+            if(!sock_manage)                                //未加入SocketManage
+            {
+                if(send_queue.IsEmpty())
+                    CloseSocket();                          //否则加入后由OnSocketSend发完再关闭
+
+                return;
+            }
+
+            if(send_queue.IsEmpty()&&!send_watch)
+                sock_manage->DeferFlush(this);
+        }
+
+        /**
+         * 发送队列中有了新数据，关注可写事件，延迟发送模式下则等本次Update结束时统一发出
+         */
+        void TCPAccept::WatchSend()
+        {
+            if(send_watch)                                  //可写时会一起发出
+                return;
+
+            if(sock_manage->IsDeferSend())
+                sock_manage->DeferFlush(this);
+            else
+                send_watch=sock_manage->SetSendWatch(this,true);
+        }
+
+        /**
+         * 发送数据<br>
+         * 发送队列为空时先直接尝试发送，发不完的部分存入发送队列，待socket可写时再由OnSocketSend继续发送
+         * @param data 数据指针
+         * @param size 数据长度
+         * @return 是否成功(成功仅表示数据已发出或已存入发送队列)
+         */
+        bool TCPAccept::Send(const void *data,const uint size)
         {
             if(!data)return(false);
             if(size<=0)return(false);
 
+            const SocketIOVec vec={data,size};
+
+            return Send(&vec,1);
+        }
+
+        /**
+         * 发送多段数据，发送队列为空时多段数据以一次系统调用发出(如包头+包体)
+         * @param vec 数据段列表
+         * @param count 数据段数量
+         * @return 是否成功(成功仅表示数据已发出或已存入发送队列)
+         */
+        bool TCPAccept::Send(const SocketIOVec *vec,const int count)
+        {
+            if(!vec||count<=0)return(false);
+
             if(!sos)
                 sos=new SocketOutputStream(ThisSocket);
 
-            int result=sos->WriteFully(data,size);
+            if(IsSendQueueFull())                           //达到高水位，拒绝新数据直到队列降到低水位
+            {
+                send_over_high=true;
+                return(false);
+            }
 
-            if(result!=size)
+            int64 sent=0;
+
+            if(sock_manage                                  //未加入SocketManage时直接存入队列，加入时会关注可写事件
+             &&!connecting&&!tls                            //连接或TLS握手还未完成时直接存入队列
+             &&!sock_manage->IsDeferSend()                  //延迟发送模式下在本次Update结束时统一发出
+             &&send_queue.IsEmpty()                         //队列中有数据时必须排在后面，不能直接发
+             &&count<=HGL_SOCKET_IOVEC_MAX)
+            {
+                sent=sos->WriteVector(vec,count);
+
+                if(sent<0)
+                    return(false);
+
+                sock_manage->GetMetrics().AddSend(sent);
+            }
+
+            bool append=false;
+            uint64 queued=0;
+
+            for(int i=0;i<count;i++)                        //跳过已发出的部分，剩下的存入队列
+            {
+                if(sent>=vec[i].size)
+                {
+                    sent-=vec[i].size;
+                    continue;
+                }
+
+                if(!send_queue.Append((const uchar *)(vec[i].data)+sent,vec[i].size-sent))
+                    return(false);
+
+                queued+=vec[i].size-sent;
+
+                sent=0;
+                append=true;
+            }
+
+            if(append)
+            {
+                if(sock_manage)
+                    sock_manage->GetMetrics().send_queued_bytes.Add(queued);
+
+                if(IsSendQueueFull())
+                    send_over_high=true;
+            }
+
+            if(!sock_manage)
+                return(true);
+
+            if(append)
+                WatchSend();
+            else
+                CheckTraceSend();
+
+            return(true);
+        }
+
+        /**
+         * 发送共享数据块<br>
+         * 与Send相同先尝试直接发送，发不完的部分以引用方式挂入发送队列，多个连接共用同一份数据
+         * @param sb 共享数据块(调用者仍持有自己的引用)
+         * @param offset 要发送的数据在数据块中的位置
+         * @param size 要发送的数据长度
+         * @return 是否成功(成功仅表示数据已发出或已存入发送队列)
+         */
+        bool TCPAccept::SendShared(SharedBuffer *sb,const uint offset,const uint size)
+        {
+            if(!sb||size<=0||offset>sb->GetSize()||size>sb->GetSize()-offset)return(false);
+
+            const uchar *data=sb->GetData()+offset;
+
+            if(!sos)
+                sos=new SocketOutputStream(ThisSocket);
+
+            if(IsSendQueueFull())
+            {
+                send_over_high=true;
                 return(false);
+            }
+
+            int64 sent=0;
+
+            if(sock_manage                                  //未加入SocketManage时直接存入队列
+             &&!connecting&&!tls&&!sock_manage->IsDeferSend()&&send_queue.IsEmpty())
+            {
+                const uint zero_copy_threshold=send_queue.GetZeroCopyThreshold();
 
+                if(zero_copy_threshold>0&&size>=zero_copy_threshold)
+                {
+                    bool zero_copy;
+
+                    sent=sos->WriteZeroCopy(data,size,zero_copy);
+
+                    if(zero_copy)
+                        send_queue.AddZeroCopy(sb);         //内核引用着这块内存，完成前不能释放
+                }
+                else
+                {
+                    sent=sos->Write(data,size);
+                }
+
+                if(sent<0)
+                    return(false);
+
+                sock_manage->GetMetrics().AddSend(sent);
+
+                if(sent>=size)
+                {
+                    CheckTraceSend();
+                    return(true);
+                }
+            }
+
+            if(!send_queue.Append(sb,offset+uint(sent),offset+size))
+                return(false);
+
+            if(IsSendQueueFull())
+                send_over_high=true;
+
+            if(!sock_manage)
+                return(true);
+
+            sock_manage->GetMetrics().send_queued_bytes.Add(size-sent);
+
+            WatchSend();
             return(true);
         }
+
+        /**
+         * 发送文件中的一段数据<br>
+         * 与Send相同先尝试直接发送，发不完的部分作为文件块存入发送队列(只记录位置，不读出数据)，轮到它时再从文件直接发出<br>
+         * 发送完成前文件内容不能被修改，文件数据不足size字节时视为出错
+         * @param fd 文件句柄(也可以是管道)
+         * @param offset 数据在文件中的位置(<0表示从fd的当前位置读取，用于管道，管道中的数据需已写入)
+         * @param size 数据长度
+         * @param close_fd 是否由本对象在发完后关闭fd(为true时失败也会关闭)
+         * @return 是否成功(成功仅表示数据已发出或已存入发送队列)
+         */
+        bool TCPAccept::SendFile(int fd,int64 offset,int64 size,bool close_fd)
+        {
+            if(fd<0)return(false);
+
+            if(size<=0||ThisSocket==-1)
+            {
+                if(close_fd)CloseFile(fd);
+                return(false);
+            }
+
+            if(!sos)
+                sos=new SocketOutputStream(ThisSocket);
+
+            int64 sent=0;
+
+            if(IsSendQueueFull())
+            {
+                send_over_high=true;
+
+                if(close_fd)CloseFile(fd);
+                return(false);
+            }
+
+            if(sock_manage                                  //未加入SocketManage时整块存入队列，不会只发出一部分
+             &&!connecting&&!tls&&!sock_manage->IsDeferSend()&&send_queue.IsEmpty())
+            {
+                sent=sos->WriteFile(fd,offset,size);
+
+                if(sent<0)
+                {
+                    if(close_fd)CloseFile(fd);
+                    return(false);
+                }
+
+                sock_manage->GetMetrics().AddSend(sent);
+
+                if(sent>=size)
+                {
+                    if(close_fd)CloseFile(fd);
+
+                    CheckTraceSend();
+                    return(true);
+                }
+            }
+
+            if(!send_queue.AppendFile(fd,offset>=0?offset+sent:offset,size-sent,close_fd))
+            {
+                if(close_fd)CloseFile(fd);
+                return(false);
+            }
+
+            if(IsSendQueueFull())
+                send_over_high=true;
+
+            if(!sock_manage)
+                return(true);
+
+            sock_manage->GetMetrics().send_queued_bytes.Add(size-sent);
+
+            WatchSend();
+            return(true);
+        }
+
+        /**
+         * 开启零拷贝发送<br>
+         * 不小于threshold的共享数据块(SendShared/广播)以MSG_ZEROCOPY发出，内核直接引用数据块的内存，
+         * 完成通知经错误队列返回(表现为出错事件)，由SocketManageBase读取后才释放数据块的引用。
+         * 小数据复制的开销比锁定内存、处理完成通知更低，所以只对大数据块使用
+         * @param threshold 零拷贝发送的最小长度(0表示关闭)
+         * @return 是否成功(内核不支持SO_ZEROCOPY时返回false，仍按普通方式发送)
+         */
+        bool TCPAccept::SetZeroCopy(const uint threshold)
+        {
+            if(threshold==0)
+            {
+                send_queue.SetZeroCopy(0);                  //已发出的仍会收到完成通知
+                return(true);
+            }
+
+#if (HGL_OS == HGL_OS_Linux)&&defined(SO_ZEROCOPY)
+            const int on=1;
+
+            if(setsockopt(ThisSocket,SOL_SOCKET,SO_ZEROCOPY,&on,sizeof(on)))
+            {
+                LOG_INFO(OS_TEXT("setsockopt SO_ZEROCOPY failed,sock:")+OSString::numberOf(ThisSocket)+OS_TEXT(",errno:")+OSString::numberOf(errno));
+                return(false);
+            }
+
+            send_queue.SetZeroCopy(threshold);
+            return(true);
+#else
+            return(false);
+#endif//(HGL_OS == HGL_OS_Linux)&&defined(SO_ZEROCOPY)
+        }
+
+        /**
+         * 读出错误队列中所有的零拷贝完成通知，释放对应的数据块<br>
+         * 内核实际上复制了数据时(如发往本机)，零拷贝没有好处，自动关闭
+         * @return 处理的通知数量
+         * @return -1 socket确实出错了
+         */
+        int TCPAccept::ProcZeroCopyCompletion()
+        {
+#if (HGL_OS == HGL_OS_Linux)&&defined(SO_EE_ORIGIN_ZEROCOPY)
+            int count=0;
+            bool error=false;
+
+            char control[CMSG_SPACE(sizeof(sock_extended_err))*4];
+
+            while(true)
+            {
+                msghdr msg;
+
+                hgl_zero(msg);
+                msg.msg_control=control;
+                msg.msg_controllen=sizeof(control);
+
+                if(recvmsg(ThisSocket,&msg,MSG_ERRQUEUE|MSG_DONTWAIT)==-1)
+                    break;                                  //EAGAIN：已读完
+
+                for(cmsghdr *cm=CMSG_FIRSTHDR(&msg);cm;cm=CMSG_NXTHDR(&msg,cm))
+                {
+                    if(!((cm->cmsg_level==SOL_IP&&cm->cmsg_type==IP_RECVERR)
+                       ||(cm->cmsg_level==SOL_IPV6&&cm->cmsg_type==IPV6_RECVERR)))
+                        continue;
+
+                    const sock_extended_err *ee=(const sock_extended_err *)CMSG_DATA(cm);
+
+                    if(ee->ee_origin!=SO_EE_ORIGIN_ZEROCOPY)
+                    {
+                        error=true;
+                        continue;
+                    }
+
+                    send_queue.CompleteZeroCopy(ee->ee_info,ee->ee_data);
+                    ++count;
+
+                    if(ee->ee_code&SO_EE_CODE_ZEROCOPY_COPIED)
+                        send_queue.SetZeroCopy(0);
+                }
+            }
+
+            if(error||GetConnectError(ThisSocket))          //同时检查socket本身的错误
+                return(-1);
+
+            return count;
+#else
+            return(-1);
+#endif//(HGL_OS == HGL_OS_Linux)&&defined(SO_EE_ORIGIN_ZEROCOPY)
+        }
+
+        /**
+         * 开始TLS握手<br>
+         * 服务器端在加入SocketManage前调用即可，客户端可以在连接完成前调用，连接完成后自动开始握手。
+         * 握手完成前发送的数据全部存入发送队列，完成后按顺序发出
+         * @param session 由TLSContext::CreateSession创建的握手对象(无论成功与否都由本对象接管)
+         */
+        bool TCPAccept::StartTLS(TLSSession *session)
+        {
+            if(!session)return(false);
+
+            if(ThisSocket==-1||tls)
+            {
+                delete session;
+                return(false);
+            }
+
+            tls=session;
+
+            if(sock_manage&&!connecting)                    //已在SocketManage中，客户端需要先发出ClientHello
+                return(ProcTLSHandshake()>=0);
+
+            return(true);
+        }
+
+        /**
+         * 继续TLS握手，由SocketManage在握手期间的可读/可写事件中调用<br>
+         * 握手期间只在OpenSSL需要时关注可写事件，完成后释放握手对象，并发出握手期间存入队列的数据
+         * @return 1 握手完成
+         * @return 0 未完成
+         * @return -1 出错
+         */
+        int TCPAccept::ProcTLSHandshake()
+        {
+            const int result=tls->Handshake();
+
+            if(result<0)
+                return(-1);
+
+            if(result==0)
+            {
+                const bool want_write=tls->WantWrite();
+
+                if(sock_manage&&want_write!=send_watch)
+                {
+                    if(want_write)
+                    {
+                        send_watch=sock_manage->SetSendWatch(this,true);
+                    }
+                    else
+                    {
+                        sock_manage->SetSendWatch(this,false);
+                        send_watch=false;
+                    }
+                }
+
+                return(0);
+            }
+
+            const bool client=!tls->IsServer();
+
+            SAFE_CLEAR(tls);
+
+            if(!OnTLSReady())
+                return(-1);
+
+            if(client&&!OnConnected())
+                return(-1);
+
+            if(sock_manage&&!send_queue.IsEmpty()&&!send_watch)
+                send_watch=sock_manage->SetSendWatch(this,true);
+
+            return(1);
+        }
+
+        /**
+         * socket可写时由SocketManage调用，继续发送队列中的数据<br>
+         * 主动发起的连接第一次可写时先取得连接结果，成功后再发出连接期间存入队列的数据
+         * @return 本次发出的字节数
+         * @return <0 出错
+         */
+        int TCPAccept::OnSocketSend(int)
+        {
+            int64 result=0;
+
+            if(connecting)
+            {
+                const int err=GetConnectError(ThisSocket);
+
+                if(err)
+                {
+                    LOG_INFO(OS_TEXT("Connect failed,sock:")+OSString::numberOf(ThisSocket)+OS_TEXT(",errno:")+OSString::numberOf(err));
+                    return(-1);
+                }
+
+                connecting=false;
+
+                if(!tls&&!OnConnected())                    //TLS连接在握手完成后再通知
+                    return(-1);
+            }
+
+            if(tls)
+            {
+                const int r=ProcTLSHandshake();
+
+                if(r<=0)
+                    return(r);
+            }
+
+            if(!send_queue.IsEmpty())
+            {
+                result=send_queue.Flush(sos);
+
+                if(result<0)
+                    return(-1);
+
+                if(sock_manage)
+                    sock_manage->GetMetrics().AddSend(result);
+
+                CheckTraceSend();
+            }
+
+            if(send_over_high&&uint64(send_queue.GetBytes())<=send_low_watermark)
+            {
+                send_over_high=false;
+                OnSendQueueDrained();                       //这里可以继续发送，下面再决定是否还要关注可写事件
+            }
+
+            if(close_after_send&&send_queue.IsEmpty())      //要发的都发完了，交给SocketManage移出并关闭
+                return(-1);
+
+            if(send_queue.IsEmpty()&&send_watch)            //发完了，不再关注可写事件
+            {
+                if(sock_manage)
+                    sock_manage->SetSendWatch(this,false);
+
+                send_watch=false;
+            }
+
+            return(result);
+        }
     }//namespace network
 }//namespace hgl
@@ -1,104 +1,340 @@
 ﻿#include<hgl/network/TCPAccept.h>
 #include<hgl/network/SocketInputStream.h>
 #include<hgl/network/SocketOutputStream.h>
+#include<hgl/network/SocketManage.h>
 #include<hgl/io/DataInputStream.h>
 #include<hgl/io/DataOutputStream.h>
 #include<hgl/type/StrChar.h>
+#include<hgl/log/LogInfo.h>
 
 namespace hgl
 {
     namespace network
     {
-        TCPAcceptPacket::TCPAcceptPacket():TCPAccept(),recv_buffer(HGL_TCP_BUFFER_SIZE)
+        TCPAcceptPacket::TCPAcceptPacket():TCPAcceptFramedPacket<DefaultPacketFramer>()
         {
         }
 
-        TCPAcceptPacket::TCPAcceptPacket(int s,IPAddress *ip):TCPAccept(s,ip),recv_buffer(HGL_TCP_BUFFER_SIZE)
+        TCPAcceptPacket::TCPAcceptPacket(int s,const IPAddress *ip):TCPAcceptFramedPacket<DefaultPacketFramer>(s,ip)
         {
         }
 
+        TCPAcceptPacketBase::~TCPAcceptPacketBase()
+        {
+            FreeRecvBuffer();
+        }
+
+        bool TCPAcceptPacketBase::UseSocket(int sock,const IPAddress *addr)
+        {
+            if(!TCPAccept::UseSocket(sock,addr))
+                RETURN_FALSE;
+
+            FreeRecvBuffer();
+            recv_length=0;
+            recv_total=0;
+            recv_timestamp=0;
+
+            return(true);
+        }
+
         /**
-         * 从socket接收数据回调函数<br>此写法有待改良
+         * 设置是否以PacketRef回调收到的包，已有接收缓冲区时换成对应的类型(保留其中的数据)
          */
-        int TCPAcceptPacket::OnSocketRecv(int /*size*/)
+        bool TCPAcceptPacketBase::SetPacketRef(const bool ref)
         {
-            if(!sis)
+            if(packet_ref==ref)
+                return(true);
+
+            packet_ref=ref;
+
+            if(!recv_buffer)
+                return(true);
+
+            return ResizeRecvBuffer(recv_buffer_size);
+        }
+
+        /**
+         * 更换一个至少size字节的接收缓冲区，原有数据会复制过去<br>
+         * 引用模式下从进程级的SharedBuffer池取得，加入了SocketManage时从它的BufferPool借出，否则自行分配
+         */
+        bool TCPAcceptPacketBase::ResizeRecvBuffer(uint size)
+        {
+            BufferPool *pool=(sock_manage&&!packet_ref?sock_manage->GetBufferPool():nullptr);
+            SharedBuffer *block=nullptr;
+
+            uint capacity;
+            uchar *buf;
+
+            if(packet_ref)
             {
-                sis=new SocketInputStream(ThisSocket);
-                recv_total=0;
-                recv_length=0;
+                block=SharedBuffer::Acquire(size);
+                buf=block->GetData();
+                capacity=block->GetSize();
+            }
+            else
+            if(pool)
+            {
+                buf=pool->Acquire(size,capacity);
+            }
+            else
+            {
+                capacity=size;
+                buf=new uchar[size];
             }
 
-            int total=0;
+            if(!buf)
+                RETURN_FALSE;
 
-            while(true)
+            if(recv_length>0)
+                memcpy(buf,recv_buffer,recv_length);
+
+            FreeRecvBuffer();
+
+            recv_buffer=buf;
+            recv_buffer_size=capacity;
+            recv_pool=pool;
+            recv_block=block;
+            return(true);
+        }
+
+        void TCPAcceptPacketBase::FreeRecvBuffer()
+        {
+            if(!recv_buffer)return;
+
+            if(recv_block)
             {
-                if(recv_length<PACKET_SIZE_TYPE_BYTES)       //头都没收完
-                {
-                    int result=sis->Read(recv_buffer.data()+recv_length,PACKET_SIZE_TYPE_BYTES-recv_length);
+                recv_block->Release();                          //还有PacketRef时由最后一个释放者送回池中
+                recv_block=nullptr;
+            }
+            else
+            if(recv_pool)
+                recv_pool->Release(recv_buffer,recv_buffer_size);
+            else
+                delete[] recv_buffer;
+
+            recv_buffer=nullptr;
+            recv_buffer_size=0;
+            recv_pool=nullptr;
+        }
 
-                    if(result<0)
-                        return(result);
+        /**
+         * 热重启时保存接收缓冲区中还没有处理的数据(uint32长度+数据)
+         */
+        bool TCPAcceptPacketBase::SaveHandoffState(DataArray<uchar> &out)
+        {
+            if(!TCPAccept::SaveHandoffState(out))
+                return(false);
 
-                    if(result==0)
-                        return total;
+            const uint32 length=recv_length;
+            const int64 pos=out.GetCount();
 
-                    recv_length+=result;
-                    recv_total+=result;
-                    total+=result;
-                }
+            out.SetCount(pos+sizeof(uint32)+length);
 
-                if(recv_length<PACKET_SIZE_TYPE_BYTES)      //已经有头了
-                    continue;
+            memcpy(out.GetData()+pos,&length,sizeof(uint32));
 
-                PACKET_SIZE_TYPE pack_size=*(PACKET_SIZE_TYPE *)(recv_buffer.data());
+            if(length>0)
+                memcpy(out.GetData()+pos+sizeof(uint32),recv_buffer,length);
 
-                recv_buffer.SetCount(PACKET_SIZE_TYPE_BYTES+pack_size);
+            return(true);
+        }
 
-                int result=sis->Read(recv_buffer.data()+recv_length,pack_size-(recv_length-PACKET_SIZE_TYPE_BYTES));
+        int TCPAcceptPacketBase::LoadHandoffState(const uchar *data,const uint size)
+        {
+            const int used=TCPAccept::LoadHandoffState(data,size);
 
-                if(result<0)
-                    return(result);
+            if(used<0||size-used<sizeof(uint32))
+                return(-1);
 
-                if(result==0)
-                    return total;
+            uint32 length;
 
-                recv_length+=result;
-                recv_total+=result;
-                total+=result;
+            memcpy(&length,data+used,sizeof(uint32));
 
-                if(recv_length<pack_size+PACKET_SIZE_TYPE_BYTES)                //这个包还没收完整
-                    return(total);                                                      //证明socket缓冲区里没有数据了，直接返回
+            if(size-used-sizeof(uint32)<length)
+                return(-1);
 
-                OnRecvPacket(recv_buffer.data()+PACKET_SIZE_TYPE_BYTES,pack_size);  //调用回调
+            recv_length=0;
 
-                recv_buffer.Clear();
-                recv_length=0;
+            if(length>0)
+            {
+                if(!ResizeRecvBuffer(length))                                   //还没加入SocketManage，自行分配，加入后的第一次接收会按需更换
+                    return(-1);
+
+                memcpy(recv_buffer,data+used+sizeof(uint32),length);
+                recv_length=length;
             }
+
+            return used+sizeof(uint32)+length;
+        }
+
+        /**
+         * 加入SocketManage时接收缓冲区中还有数据(迁移、热重启转交过来的)，不等可读事件，在本次Update中先处理掉
+         */
+        void TCPAcceptPacketBase::OnSocketJoin()
+        {
+            if(recv_length>0)
+                sock_manage->ScheduleRecv(this);
         }
 
-        bool TCPAcceptPacket::SendPacket(void *data,const PACKET_SIZE_TYPE &size)
+        /**
+         * 从SocketManage分离时，把借用它BufferPool的接收缓冲区还回去，还有未处理的数据则转存到自行分配的缓冲区中
+         */
+        void TCPAcceptPacketBase::OnSocketUnjoin()
         {
-            if(!data)return(false);
-            if(size<=0)return(false);
+            if(!recv_pool)return;
 
-            //$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$$4
-            //直接发，，，，正式版 本当然不能这样写，，，但现在先这样了
+            if(recv_length<=0)
+            {
+                FreeRecvBuffer();
+                return;
+            }
 
-            if(!sos)
-                sos=new SocketOutputStream(ThisSocket);
+            uchar *buf=new uchar[recv_length];
 
-            int result=sos->WriteFully(&size,sizeof(PACKET_SIZE_TYPE));
+            memcpy(buf,recv_buffer,recv_length);
 
-            if(result!=sizeof(PACKET_SIZE_TYPE))
-                return(false);
+            FreeRecvBuffer();
 
-            result=sos->WriteFully(data,size);
+            recv_buffer=buf;
+            recv_buffer_size=recv_length;
+        }
 
-            if(result!=size)
+        /**
+         * 解析接收缓冲区中的完整包，不完整的部分移到缓冲区头部
+         */
+        bool TCPAcceptPacketBase::ConsumeRecvBuffer()
+        {
+            const int used=ParsePacket(recv_buffer,recv_length);
+
+            if(used<0)
+            {
+                LOG_PROBLEM(OS_TEXT("TCPAcceptPacket,bad packet header,sock:")+OSString::numberOf(ThisSocket));
                 return(false);
+            }
+
+            if(used==0)
+                return(true);
+
+            recv_length-=used;
+
+            if(recv_block&&recv_block->IsShared())             //回调中保存了PacketRef，已处理的包不能被覆盖
+            {
+                if(recv_length==0)
+                {
+                    FreeRecvBuffer();
+                    return(true);
+                }
+
+                SharedBuffer *block=SharedBuffer::Acquire(recv_buffer_size);
+
+                memcpy(block->GetData(),recv_buffer+used,recv_length);
+
+                recv_block->Release();
+
+                recv_block=block;
+                recv_buffer=block->GetData();
+                recv_buffer_size=block->GetSize();
+                return(true);
+            }
+
+            if(recv_length>0)
+                memmove(recv_buffer,recv_buffer+used,recv_length);
 
             return(true);
         }
+
+        /**
+         * 从socket接收数据回调函数<br>
+         * 每次recv都尽可能填满接收缓冲区，然后在缓冲区上原地解析出所有完整的包，小包密集时可大幅减少recv次数
+         */
+        int TCPAcceptPacketBase::OnSocketRecv(int /*size*/)
+        {
+            if(!sis)
+                sis=new SocketInputStream(ThisSocket);
+
+            if(sis->IsTimestamp()!=latency_trace)
+                sis->SetTimestamp(latency_trace);
+
+            int total=0;
+
+            if(recv_pause)
+                return(0);
+
+            if(recv_length>0)                                           //恢复接收时，先处理暂停时留在缓冲区中的包
+            {
+                if(!ConsumeRecvBuffer())
+                    return(-1);
+
+                if(recv_pause)
+                    return(0);
+            }
+
+            while(true)
+            {
+                uint need=HGL_TCP_RECV_BLOCK_SIZE;
+
+                if(recv_length>0)                                       //已经有包头了，确保缓冲区放得下整个包
+                {
+                    const uint64 pack_need=GetPacketNeed(recv_buffer,recv_length);
+
+                    if(pack_need>max_packet_size)
+                    {
+                        LOG_PROBLEM(OS_TEXT("TCPAcceptPacket,packet too large,sock:")+OSString::numberOf(ThisSocket)+OS_TEXT(",size:")+OSString::numberOf(pack_need));
+                        return(-1);
+                    }
+
+                    if(pack_need>need)
+                        need=uint(pack_need);
+                }
+
+                if(need>recv_buffer_size)
+                    if(!ResizeRecvBuffer(need))
+                        return(-1);
+
+                const uint free_bytes=recv_buffer_size-recv_length;
+
+                int result=sis->Read(recv_buffer+recv_length,free_bytes);
+
+                if(result<=0)
+                {
+                    if(recv_length==0)                                  //没有残留数据，缓冲区还回去
+                        FreeRecvBuffer();
+
+                    return(result<0?result:total);
+                }
+
+                recv_length+=result;
+                recv_total+=result;
+                total+=result;
+
+                if(latency_trace)
+                    recv_timestamp=sis->GetRecvTimestamp();
+
+                if(!ConsumeRecvBuffer())
+                    return(-1);
+
+                if(recv_pause                                           //暂停接收，其余数据留在socket缓冲区中
+                 ||uint(result)<free_bytes)                             //没有读满，证明socket缓冲区里没有数据了，直接返回
+                {
+                    if(recv_length==0)
+                        FreeRecvBuffer();
+
+                    return(total);
+                }
+            }
+        }
+
+        /**
+         * 发出一个包，包头与包体合并为一次writev发出，发不完的部分由TCPAccept::Send存入发送队列，可写时再发
+         */
+        bool TCPAcceptPacketBase::SendFrame(const void *header,const uint header_size,const void *data,const uint size)
+        {
+            const SocketIOVec vec[2]=
+            {
+                {header,header_size},
+                {data,size}
+            };
+
+            return Send(vec,2);
+        }
     }//namespace network
 }//namespace hgl
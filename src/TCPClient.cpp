@@ -2,6 +2,8 @@
 #include<hgl/log/LogInfo.h>
 #include<hgl/network/SocketInputStream.h>
 #include<hgl/network/SocketOutputStream.h>
+#include<hgl/network/DNSCache.h>
+#include<hgl/Time.h>
 
 /*
 发送数据
@@ -35,16 +37,17 @@
 
 namespace hgl
 {
+    void SetTimeVal(timeval &tv,const double t_sec);
+
     namespace network
     {
         void TCPClient::InitPrivate(int sock)
         {
             TimeOut=HGL_NETWORK_TIME_OUT;
+            ConnectTimeOut=0;
 
             sis=new SocketInputStream(sock);
             sos=new SocketOutputStream(sock);
-
-            ipstr = nullptr;
         }
 
         /**
@@ -65,7 +68,6 @@ namespace hgl
             Disconnect();
             SAFE_CLEAR(sis);
             SAFE_CLEAR(sos);
-            SAFE_CLEAR_ARRAY(ipstr);
         }
 
         /**
@@ -74,14 +76,11 @@ namespace hgl
          */
         bool TCPClient::Connect()
         {
-            if(ThisSocket<0||!ThisAddress)RETURN_FALSE;
+            if(ThisSocket<0||!ThisAddress.IsValid())RETURN_FALSE;
 
-            if(connect(ThisSocket,ThisAddress->GetSockAddr(),ThisAddress->GetSockAddrInSize()))
+            if(!hgl::network::Connect(ThisSocket,&ThisAddress,ConnectTimeOut))
             {
-                SAFE_CLEAR(ipstr);
-                ipstr=ThisAddress->CreateString();
-
-                LOG_HINT(U8_TEXT("Don't Connect to TCPServer ")+U8String((u8char *)ipstr));
+                LOG_HINT(U8_TEXT("Don't Connect to TCPServer ")+U8String((u8char *)ThisAddress.GetString()));
                 this->CloseSocket();
                 return(false);
             }
@@ -118,8 +117,6 @@ namespace hgl
         */
         void TCPClient::Disconnect()
         {
-            SAFE_CLEAR_ARRAY(ipstr);
-
             if(ThisSocket==-1)
                 return;
 
@@ -163,5 +160,234 @@ namespace hgl
 
             return(new TCPClient(sock,addr));
         }
+
+        TCPClient *CreateTCPClient(IPAddress *addr,const double time_out)
+        {
+            if(!addr)RETURN_ERROR_NULL;
+
+            if(!addr->IsTCP())
+                RETURN_ERROR_NULL;
+
+            int sock=CreateSocket(addr);
+
+            if(sock<0)
+                RETURN_ERROR_NULL;
+
+            if(!Connect(sock,addr,time_out))
+            {
+                CloseSocket(sock);
+                RETURN_ERROR_NULL;
+            }
+
+            return(new TCPClient(sock,addr));
+        }
+
+        namespace
+        {
+            struct ConnectAttempt
+            {
+                int sock;
+                IPAddress *addr;
+            };
+
+            /**
+             * 按RFC 8305交错排列两种协议家族的地址，同一家族内保持原有顺序
+             */
+            void SortAddressByFamily(List<IPAddress *> &result,const List<IPAddress *> &addr_list,bool prefer_ipv6)
+            {
+                List<IPAddress *> first,second;
+
+                const int first_family=(prefer_ipv6?AF_INET6:AF_INET);
+
+                for(IPAddress *addr:addr_list)
+                {
+                    if(!addr||!addr->IsTCP())continue;
+
+                    if(addr->GetFamily()==first_family)
+                        first.Add(addr);
+                    else
+                        second.Add(addr);
+                }
+
+                const int count=hgl_max(first.GetCount(),second.GetCount());
+
+                for(int i=0;i<count;i++)
+                {
+                    if(i<first.GetCount())result.Add(first.GetData()[i]);
+                    if(i<second.GetCount())result.Add(second.GetData()[i]);
+                }
+            }
+
+            void CloseAttempts(List<ConnectAttempt> &attempt_list)
+            {
+                for(ConnectAttempt &ca:attempt_list)
+                    CloseSocket(ca.sock);
+
+                attempt_list.Clear();
+            }
+
+            TCPClient *CreateConnectedClient(int sock,IPAddress *addr)
+            {
+                SetSocketNonBlock(sock,false);
+
+                return(new TCPClient(sock,addr));
+            }
+        }//namespace
+
+        TCPClient *CreateTCPClient(const List<IPAddress *> &addr_list,const HappyEyeballsConfig &cfg)
+        {
+            List<IPAddress *> sorted_list;
+
+            SortAddressByFamily(sorted_list,addr_list,cfg.prefer_ipv6);
+
+            const int addr_count=sorted_list.GetCount();
+
+            if(addr_count<=0)
+                RETURN_ERROR_NULL;
+
+            List<ConnectAttempt> attempt_list;
+
+            const double deadline=GetDoubleTime()+cfg.time_out;
+            double next_start_time=0;
+            int next=0;
+
+            while(true)
+            {
+                double now=GetDoubleTime();
+
+                if(now>=deadline)
+                    break;
+
+                if(next<addr_count
+                 &&(now>=next_start_time||attempt_list.IsEmpty()))          //开始下一个尝试
+                {
+                    IPAddress *addr=sorted_list.GetData()[next++];
+
+                    const int sock=CreateSocket(addr);
+
+                    if(sock<0)
+                        continue;
+
+                    SetSocketNonBlock(sock,true);
+
+                    const int result=StartConnect(sock,addr);
+
+                    if(result>0)
+                    {
+                        CloseAttempts(attempt_list);
+                        return CreateConnectedClient(sock,addr);
+                    }
+
+                    if(result<0)                                            //立即失败，马上尝试下一个
+                    {
+                        CloseSocket(sock);
+                        next_start_time=now;
+                        continue;
+                    }
+
+                    ConnectAttempt ca;
+
+                    ca.sock=sock;
+                    ca.addr=addr;
+
+                    attempt_list.Add(ca);
+
+                    next_start_time=now+cfg.attempt_delay;
+                }
+
+                if(attempt_list.IsEmpty())
+                {
+                    if(next>=addr_count)
+                        break;                                              //全部失败
+
+                    continue;
+                }
+
+                fd_set write_set,err_set;
+                int max_fd=-1;
+
+                FD_ZERO(&write_set);
+                FD_ZERO(&err_set);
+
+                for(const ConnectAttempt &ca:attempt_list)
+                {
+                    FD_SET(ca.sock,&write_set);
+                    FD_SET(ca.sock,&err_set);                               //Windows下连接失败在异常集合中返回
+
+                    if(ca.sock>max_fd)max_fd=ca.sock;
+                }
+
+                double wait_time=deadline-now;
+
+                if(next<addr_count&&next_start_time-now<wait_time)
+                    wait_time=next_start_time-now;
+
+                timeval tv;
+
+                SetTimeVal(tv,wait_time>0?wait_time:0);
+
+                if(select(max_fd+1,nullptr,&write_set,&err_set,&tv)<=0)
+                    continue;                                               //超时(到了开始下一个尝试的时间)或被打断
+
+                now=GetDoubleTime();
+
+                for(int i=0;i<attempt_list.GetCount();)
+                {
+                    ConnectAttempt &ca=attempt_list.GetData()[i];
+
+                    if(!FD_ISSET(ca.sock,&write_set)
+                     &&!FD_ISSET(ca.sock,&err_set))
+                    {
+                        ++i;
+                        continue;
+                    }
+
+                    if(GetConnectError(ca.sock)==0)
+                    {
+                        const int sock=ca.sock;
+                        IPAddress *addr=ca.addr;
+
+                        attempt_list.Delete(i);
+                        CloseAttempts(attempt_list);
+
+                        return CreateConnectedClient(sock,addr);
+                    }
+
+                    CloseSocket(ca.sock);
+                    attempt_list.Delete(i);                                 //与最后一项交换，当前位置需要再检查一次
+
+                    next_start_time=now;                                    //有尝试失败时立即开始下一个
+                }
+            }
+
+            CloseAttempts(attempt_list);
+            RETURN_ERROR_NULL;
+        }
+
+        TCPClient *CreateTCPClient(const char *host,ushort port,const HappyEyeballsConfig &cfg)
+        {
+            if(!host)RETURN_ERROR_NULL;
+
+            List<in6_addr> ipv6_list;
+            List<in_addr> ipv4_list;
+
+            GetDNSCache()->Resolve(ipv6_list,host,SOCK_STREAM,IPPROTO_TCP);
+            GetDNSCache()->Resolve(ipv4_list,host,SOCK_STREAM,IPPROTO_TCP);
+
+            List<IPAddress *> addr_list;
+
+            for(const in6_addr &ia:ipv6_list)
+                addr_list.Add(CreateIPv6TCP(&ia,port));
+
+            for(const in_addr &ia:ipv4_list)
+                addr_list.Add(CreateIPv4TCP(ia.s_addr,port));
+
+            TCPClient *tcp=CreateTCPClient(addr_list,cfg);                  //TCPClient会复制地址
+
+            for(IPAddress *addr:addr_list)
+                delete addr;
+
+            return tcp;
+        }
     }//namespace network
 }//namespace hgl
@@ -0,0 +1,68 @@
+﻿#include<hgl/network/MTTCPClient.h>
+#include<random>
+
+namespace hgl
+{
+    namespace network
+    {
+        TCPConnectPacket::~TCPConnectPacket()
+        {
+            SAFE_CLEAR(target);
+        }
+
+        bool TCPConnectPacket::SetTarget(const IPAddress *addr)
+        {
+            if(!addr||!addr->IsTCP())
+                RETURN_FALSE;
+
+            SAFE_CLEAR(target);
+            target=addr->CreateCopy();
+
+            return(true);
+        }
+
+        /**
+         * 计算下一次重连前的等待时间<br>
+         * min_delay*factor^(连续失败次数-1)，不超过max_delay，再随机减少最多jitter比例，让同时断开的大量连接错开重连
+         */
+        double TCPConnectPacket::GetRetryDelay()
+        {
+            const ReconnectConfig &rc=reconnect_config;
+
+            double delay=rc.min_delay;
+
+            for(uint i=1;i<retry_count&&delay<rc.max_delay;i++)
+                delay*=rc.factor;
+
+            if(delay>rc.max_delay)
+                delay=rc.max_delay;
+
+            if(rc.jitter>0&&delay>0)
+            {
+                thread_local std::minstd_rand rand_engine(std::random_device{}());
+
+                std::uniform_real_distribution<double> dist(0,rc.jitter>1?1:rc.jitter);
+
+                delay*=1.0-dist(rand_engine);
+            }
+
+            return(delay>0?delay:0);
+        }
+
+        bool TCPConnectPacket::SendPacket(void *data,const PACKET_SIZE_TYPE &size)
+        {
+            if(!sock_manage)                                                //等待重连，socket已关闭
+                return(false);
+
+            return TCPAcceptPacket::SendPacket(data,size);
+        }
+
+        bool TCPConnectPacket::SendShared(SharedBuffer *sb,const uint offset,const uint size)
+        {
+            if(!sock_manage)
+                return(false);
+
+            return TCPAcceptPacket::SendShared(sb,offset,size);
+        }
+    }//namespace network
+}//namespace hgl
@@ -30,5 +30,20 @@ namespace hgl
         #endif//bsd&mac
         }
 #endif//no windows&mac
+
+#if HGL_OS == HGL_OS_Linux
+        /**
+         * 设置SO_INCOMING_CPU，多个SO_REUSEPORT监听socket时，内核会优先把该CPU上收到的连接交给本socket
+         * @param cpu CPU编号
+         */
+        bool TCPServer::SetIncomingCPU(const int cpu)
+        {
+        #ifdef SO_INCOMING_CPU
+            return(setsockopt(this->ThisSocket,SOL_SOCKET,SO_INCOMING_CPU,&cpu,sizeof(cpu))==0);
+        #else
+            return(false);
+        #endif//SO_INCOMING_CPU
+        }
+#endif//HGL_OS == HGL_OS_Linux
     }//namespace network
 }//namespace hgl
@@ -5,6 +5,11 @@
 #include<netinet/tcp.h>
 #endif//HGL_OS != HGL_OS_Windows
 
+#if HGL_OS == HGL_OS_Linux
+#include<sys/ioctl.h>
+#include<linux/sockios.h>
+#endif//HGL_OS == HGL_OS_Linux
+
 namespace hgl
 {
     void SetTimeVal(timeval &tv,const double t_sec);
@@ -51,6 +56,44 @@ namespace hgl
 #endif//HGL_OS_Windows
         }
 
+        /**
+         * 读取TCP_INFO中调度与排查需要的部分，另加一次SIOCOUTQ取得内核发送缓冲区中的字节数
+         */
+        bool TCPSocket::ReadTCPInfo(TCPConnectionInfo &info)const
+        {
+#if HGL_OS == HGL_OS_Linux
+            tcp_info ti;
+            socklen_t len=sizeof(tcp_info);
+
+            if(getsockopt(ThisSocket,IPPROTO_TCP,TCP_INFO,&ti,&len)!=0)
+                return(false);
+
+            info.rtt            =ti.tcpi_rtt;
+            info.rtt_var        =ti.tcpi_rttvar;
+            info.rto            =ti.tcpi_rto;
+
+            info.cwnd           =ti.tcpi_snd_cwnd;
+            info.ssthresh       =ti.tcpi_snd_ssthresh;
+            info.mss            =ti.tcpi_snd_mss;
+
+            info.unacked        =ti.tcpi_unacked;
+            info.lost           =ti.tcpi_lost;
+            info.retransmits    =ti.tcpi_retransmits;
+            info.total_retrans  =ti.tcpi_total_retrans;
+
+            info.state          =ti.tcpi_state;
+            info.ca_state       =ti.tcpi_ca_state;
+
+            int queued=0;
+
+            info.send_queue_bytes=(ioctl(ThisSocket,SIOCOUTQ,&queued)==0?uint32(queued):0);
+
+            return(true);
+#else
+            return(false);
+#endif//HGL_OS == HGL_OS_Linux
+        }
+
         void TCPSocket::ResetConnect()
         {
             FD_ZERO(&local_set);
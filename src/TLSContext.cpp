@@ -0,0 +1,242 @@
+﻿#include<hgl/network/TLSContext.h>
+#include<hgl/log/LogInfo.h>
+
+#include<openssl/ssl.h>
+#include<openssl/err.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            void LogSSLError(const os_char *info,const int sock)
+            {
+                const unsigned long err=ERR_get_error();
+
+                LOG_ERROR(OSString(info)+OS_TEXT(",sock:")+OSString::numberOf(sock)+OS_TEXT(",ssl error:")+OSString::numberOf(uint64(err)));
+
+                ERR_clear_error();
+            }
+
+            /**
+             * 检查握手完成后两个方向是否都已交给内核
+             */
+            bool IsKTLSEnabled(SSL *ssl)
+            {
+            #if defined(SSL_OP_ENABLE_KTLS)&&!defined(OPENSSL_NO_KTLS)
+                return BIO_get_ktls_send(SSL_get_wbio(ssl))
+                     &&BIO_get_ktls_recv(SSL_get_rbio(ssl));
+            #else
+                return(false);
+            #endif//defined(SSL_OP_ENABLE_KTLS)&&!defined(OPENSSL_NO_KTLS)
+            }
+
+            SSL_CTX *CreateContext(const TLSConfig &cfg,const bool server)
+            {
+            #if !defined(SSL_OP_ENABLE_KTLS)||defined(OPENSSL_NO_KTLS)
+                LOG_ERROR(OS_TEXT("OpenSSL was built without kTLS support."));
+                return(nullptr);
+            #else
+                SSL_CTX *ctx=SSL_CTX_new(server?TLS_server_method():TLS_client_method());
+
+                if(!ctx)
+                {
+                    LogSSLError(OS_TEXT("SSL_CTX_new failed"),-1);
+                    return(nullptr);
+                }
+
+                SSL_CTX_set_min_proto_version(ctx,TLS1_2_VERSION);
+
+                if(!server&&!cfg.client_tls13)
+                    SSL_CTX_set_max_proto_version(ctx,TLS1_2_VERSION);
+
+                SSL_CTX_set_options(ctx,SSL_OP_ENABLE_KTLS);
+                SSL_CTX_set_read_ahead(ctx,0);                              //不能预读握手之后的记录，否则接收方向无法交给内核
+
+                if(server)
+                    SSL_CTX_set_num_tickets(ctx,0);                         //握手后不再发送用户空间的记录
+
+                if(!cfg.cipher_list.IsEmpty()
+                 &&!SSL_CTX_set_cipher_list(ctx,cfg.cipher_list.c_str()))
+                {
+                    LogSSLError(OS_TEXT("TLS set cipher list failed"),-1);
+                    SSL_CTX_free(ctx);
+                    return(nullptr);
+                }
+
+                if(!cfg.cipher_suites.IsEmpty()
+                 &&!SSL_CTX_set_ciphersuites(ctx,cfg.cipher_suites.c_str()))
+                {
+                    LogSSLError(OS_TEXT("TLS set cipher suites failed"),-1);
+                    SSL_CTX_free(ctx);
+                    return(nullptr);
+                }
+
+                if(!cfg.cert_file.IsEmpty())
+                {
+                    if(!SSL_CTX_use_certificate_chain_file(ctx,cfg.cert_file.c_str())
+                     ||!SSL_CTX_use_PrivateKey_file(ctx,(cfg.key_file.IsEmpty()?cfg.cert_file:cfg.key_file).c_str(),SSL_FILETYPE_PEM)
+                     ||!SSL_CTX_check_private_key(ctx))
+                    {
+                        LogSSLError(OS_TEXT("TLS load certificate/private key failed"),-1);
+                        SSL_CTX_free(ctx);
+                        return(nullptr);
+                    }
+                }
+                else if(server)
+                {
+                    LOG_ERROR(OS_TEXT("TLS server need a certificate."));
+                    SSL_CTX_free(ctx);
+                    return(nullptr);
+                }
+
+                if(cfg.verify_peer)
+                {
+                    const int r=(cfg.ca_file.IsEmpty()?SSL_CTX_set_default_verify_paths(ctx)
+                                                      :SSL_CTX_load_verify_locations(ctx,cfg.ca_file.c_str(),nullptr));
+
+                    if(!r)
+                    {
+                        LogSSLError(OS_TEXT("TLS load CA failed"),-1);
+                        SSL_CTX_free(ctx);
+                        return(nullptr);
+                    }
+
+                    SSL_CTX_set_verify(ctx,server?SSL_VERIFY_PEER|SSL_VERIFY_FAIL_IF_NO_PEER_CERT:SSL_VERIFY_PEER,nullptr);
+                }
+
+                return ctx;
+            #endif//!defined(SSL_OP_ENABLE_KTLS)||defined(OPENSSL_NO_KTLS)
+            }
+
+            class OpenSSLSession:public TLSSession
+            {
+                SSL *ssl;
+                int sock;
+                bool server;
+                bool want_write=false;
+
+            public:
+
+                OpenSSLSession(SSL *s,int fd,bool svr)
+                {
+                    ssl=s;
+                    sock=fd;
+                    server=svr;
+                }
+
+                ~OpenSSLSession()
+                {
+                    SSL_free(ssl);                                          //socket BIO不关闭fd，内核中的kTLS状态随socket保留
+                }
+
+                int Handshake() override
+                {
+                    want_write=false;
+
+                    ERR_clear_error();
+
+                    const int r=SSL_do_handshake(ssl);
+
+                    if(r==1)
+                    {
+                        if(IsKTLSEnabled(ssl))
+                            return(1);
+
+                        LOG_ERROR(OS_TEXT("TLS handshake finished but kTLS is not enabled(tls module/cipher unsupported),sock:")+OSString::numberOf(sock));
+                        return(-1);
+                    }
+
+                    const int err=SSL_get_error(ssl,r);
+
+                    if(err==SSL_ERROR_WANT_READ)
+                        return(0);
+
+                    if(err==SSL_ERROR_WANT_WRITE)
+                    {
+                        want_write=true;
+                        return(0);
+                    }
+
+                    LogSSLError(OS_TEXT("TLS handshake failed"),sock);
+                    return(-1);
+                }
+
+                const bool WantWrite()const override{return want_write;}
+                const bool IsServer()const override{return server;}
+            };//class OpenSSLSession
+        }//namespace
+
+        TLSContext::~TLSContext()
+        {
+            Close();
+        }
+
+        void TLSContext::Close()
+        {
+            if(!ctx)return;
+
+            SSL_CTX_free((SSL_CTX *)ctx);
+            ctx=nullptr;
+        }
+
+        bool TLSContext::InitServer(const TLSConfig &cfg)
+        {
+            Close();
+
+            ctx=CreateContext(cfg,true);
+            server=true;
+
+            return(ctx!=nullptr);
+        }
+
+        bool TLSContext::InitClient(const TLSConfig &cfg)
+        {
+            Close();
+
+            ctx=CreateContext(cfg,false);
+            server=false;
+
+            return(ctx!=nullptr);
+        }
+
+        TLSSession *TLSContext::CreateSession(int sock,const char *host_name)const
+        {
+            if(!ctx||sock<0)
+                return(nullptr);
+
+            SSL *ssl=SSL_new((SSL_CTX *)ctx);
+
+            if(!ssl)
+            {
+                LogSSLError(OS_TEXT("SSL_new failed"),sock);
+                return(nullptr);
+            }
+
+            if(!SSL_set_fd(ssl,sock))
+            {
+                LogSSLError(OS_TEXT("SSL_set_fd failed"),sock);
+                SSL_free(ssl);
+                return(nullptr);
+            }
+
+            if(server)
+            {
+                SSL_set_accept_state(ssl);
+            }
+            else
+            {
+                if(host_name&&*host_name)
+                {
+                    SSL_set_tlsext_host_name(ssl,host_name);
+                    SSL_set1_host(ssl,host_name);                           //开启verify_peer时校验证书中的主机名
+                }
+
+                SSL_set_connect_state(ssl);
+            }
+
+            return(new OpenSSLSession(ssl,sock,server));
+        }
+    }//namespace network
+}//namespace hgl
@@ -0,0 +1,244 @@
+﻿#include<hgl/network/TimerWheel.h>
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            constexpr uint64 ROOT_MASK =HGL_TIMER_WHEEL_ROOT_SIZE-1;
+            constexpr uint64 LEVEL_MASK=HGL_TIMER_WHEEL_LEVEL_SIZE-1;
+
+            inline void InitHead(TimerNode *head)
+            {
+                head->prev=head;
+                head->next=head;
+            }
+
+            inline bool IsEmpty(const TimerNode *head)
+            {
+                return head->next==head;
+            }
+
+            inline uint LevelShift(uint lv)
+            {
+                return HGL_TIMER_WHEEL_ROOT_BITS+lv*HGL_TIMER_WHEEL_LEVEL_BITS;
+            }
+        }//namespace
+
+        TimerWheel::TimerWheel(const double tick)
+        {
+            tick_time=(tick>0?tick:HGL_TIMER_WHEEL_TICK);
+
+            Start(0);
+        }
+
+        /**
+         * 以指定时间为起点重新开始，已加入的定时器全部丢弃(节点不会被修改，调用者需自行保证它们已不再使用)
+         */
+        void TimerWheel::Start(const double cur_time)
+        {
+            for(uint i=0;i<HGL_TIMER_WHEEL_ROOT_SIZE;i++)
+                InitHead(root+i);
+
+            for(uint lv=0;lv<HGL_TIMER_WHEEL_LEVEL_COUNT;lv++)
+                for(uint i=0;i<HGL_TIMER_WHEEL_LEVEL_SIZE;i++)
+                    InitHead(level[lv]+i);
+
+            start_time=cur_time;
+            cur_tick=0;
+            count=0;
+        }
+
+        const uint64 TimerWheel::ToTick(const double t)const
+        {
+            if(t<=start_time)
+                return 0;
+
+            return uint64((t-start_time)/tick_time);
+        }
+
+        /**
+         * 按到期刻度放入对应的格子
+         */
+        void TimerWheel::Link(TimerNode *node)
+        {
+            uint64 expire=node->expire;
+
+            if(expire<cur_tick)                                 //已过期，放在下一个要处理的格子
+                expire=cur_tick;
+
+            uint64 offset=expire-cur_tick;
+
+            if(offset>HGL_TIMER_WHEEL_MAX_TICKS)
+            {
+                offset=HGL_TIMER_WHEEL_MAX_TICKS;
+                expire=cur_tick+offset;
+                node->expire=expire;
+            }
+
+            TimerNode *head;
+
+            if(offset<HGL_TIMER_WHEEL_ROOT_SIZE)
+            {
+                head=root+(expire&ROOT_MASK);
+            }
+            else
+            {
+                uint lv=0;
+
+                while(lv<HGL_TIMER_WHEEL_LEVEL_COUNT-1
+                    &&offset>=(uint64(1)<<LevelShift(lv+1)))
+                    ++lv;
+
+                head=level[lv]+((expire>>LevelShift(lv))&LEVEL_MASK);
+            }
+
+            node->prev=head->prev;
+            node->next=head;
+            head->prev->next=node;
+            head->prev=node;
+        }
+
+        /**
+         * 将高一级的一个格子分散到低一级
+         */
+        void TimerWheel::Cascade(uint lv,uint index)
+        {
+            TimerNode *head=level[lv]+index;
+
+            if(IsEmpty(head))
+                return;
+
+            TimerNode *node=head->next;
+
+            InitHead(head);
+
+            while(node!=head)
+            {
+                TimerNode *next=node->next;
+
+                Link(node);
+                node=next;
+            }
+        }
+
+        /**
+         * 加入一个定时器，已在时间轮中的会先移除
+         * @param node 定时器节点
+         * @param expire_time 到期时间(与Start/Update使用同一时间基准)
+         */
+        void TimerWheel::Add(TimerNode *node,const double expire_time)
+        {
+            if(!node)return;
+
+            if(node->IsActive())
+                Remove(node);
+
+            node->expire=ToTick(expire_time);
+
+            Link(node);
+            ++count;
+        }
+
+        void TimerWheel::Remove(TimerNode *node)
+        {
+            if(!node||!node->IsActive())
+                return;
+
+            node->prev->next=node->next;
+            node->next->prev=node->prev;
+
+            node->prev=nullptr;
+            node->next=nullptr;
+
+            --count;
+        }
+
+        /**
+         * 推进到当前时间
+         * @param cur_time 当前时间
+         * @param expired_list 到期的定时器会被移出时间轮并加入此列表
+         * @return 到期的定时器数量
+         */
+        int TimerWheel::Update(const double cur_time,TimerNodeList &expired_list)
+        {
+            const uint64 target_tick=ToTick(cur_time);
+
+            if(count<=0)                                        //没有定时器，直接跳到当前刻度
+            {
+                if(target_tick>=cur_tick)
+                    cur_tick=target_tick+1;
+
+                return 0;
+            }
+
+            int result=0;
+
+            while(cur_tick<=target_tick&&count>0)
+            {
+                const uint index=uint(cur_tick&ROOT_MASK);
+
+                if(index==0)                                    //第一级转完一圈，从高一级取下一格下来
+                {
+                    for(uint lv=0;lv<HGL_TIMER_WHEEL_LEVEL_COUNT;lv++)
+                    {
+                        const uint li=uint((cur_tick>>LevelShift(lv))&LEVEL_MASK);
+
+                        Cascade(lv,li);
+
+                        if(li!=0)
+                            break;
+                    }
+                }
+
+                TimerNode *head=root+index;
+
+                while(!IsEmpty(head))
+                {
+                    TimerNode *node=head->next;
+
+                    Remove(node);
+                    expired_list.Add(node);
+                    ++result;
+                }
+
+                ++cur_tick;
+            }
+
+            if(count<=0&&target_tick>=cur_tick)
+                cur_tick=target_tick+1;
+
+            return result;
+        }
+
+        /**
+         * 取得距离下一个定时器到期的时间<br>
+         * 只检查第一级(最多256格)，定时器都在高级别时返回第一级转完一圈的时间，此时Update会把它们分散下来
+         * @return 距离到期的时间(秒)，已到期返回0
+         * @return <0 没有定时器
+         */
+        double TimerWheel::GetNextTimeOut(const double cur_time)const
+        {
+            if(count<=0)
+                return(-1);
+
+            uint64 tick=cur_tick;
+
+            for(uint i=0;i<HGL_TIMER_WHEEL_ROOT_SIZE;i++)
+            {
+                if((tick&ROOT_MASK)==0)                         //这一刻度需要从高一级分散下来
+                    break;
+
+                if(!IsEmpty(root+(tick&ROOT_MASK)))
+                    break;
+
+                ++tick;
+            }
+
+            const double t=start_time+tick*tick_time-cur_time;
+
+            return(t>0?t:0);
+        }
+    }//namespace network
+}//namespace hgl
@@ -0,0 +1,320 @@
+﻿#include<hgl/network/TrafficCapture.h>
+#include<hgl/log/LogInfo.h>
+#include<string.h>
+#include<errno.h>
+#include<chrono>
+
+#if HGL_OS == HGL_OS_Windows
+#include<windows.h>
+#else
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+#endif//HGL_OS == HGL_OS_Windows
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            int64 GetCaptureClock()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+        }//namespace
+
+        TrafficCapture::~TrafficCapture()
+        {
+            Close();
+        }
+
+        bool TrafficCapture::Create(const char *filename,const uint64 mb,const uint bs)
+        {
+            Close();
+
+            if(!filename||!*filename||bs<sizeof(TrafficCaptureRecord)*2)
+                RETURN_FALSE;
+
+            fp=fopen(filename,"wb");
+
+            if(!fp)
+            {
+                LOG_ERROR(OS_TEXT("TrafficCapture create file failed,errno:")+OSString::numberOf(errno));
+                return(false);
+            }
+
+            setvbuf(fp,nullptr,_IONBF,0);                                   //自行缓冲
+
+            buffer=new uchar[bs];
+            buffer_size=bs;
+            buffer_length=0;
+
+            max_bytes=mb;
+            full=false;
+
+            connection_serial=0;
+            record_count=0;
+            drop_count=0;
+
+            TrafficCaptureFileHeader header;
+
+            hgl_zero(header);
+            memcpy(header.magic,HGL_TRAFFIC_CAPTURE_MAGIC,sizeof(header.magic));
+            header.version      =HGL_TRAFFIC_CAPTURE_VERSION;
+            header.byte_order   =HGL_TRAFFIC_CAPTURE_BYTE_ORDER;
+            header.start_time   =std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+            memcpy(buffer,&header,sizeof(header));
+            buffer_length=sizeof(header);
+            file_bytes=sizeof(header);
+
+            start_time=GetCaptureClock();
+            return(true);
+        }
+
+        bool TrafficCapture::FlushBuffer()
+        {
+            if(buffer_length==0)
+                return(true);
+
+            const bool result=(fwrite(buffer,1,buffer_length,fp)==buffer_length);
+
+            buffer_length=0;
+
+            if(!result)
+            {
+                LOG_ERROR(OS_TEXT("TrafficCapture write file failed,errno:")+OSString::numberOf(errno));
+                full=true;                                                  //不再继续写入，已写出的记录依然完整可读
+            }
+
+            return result;
+        }
+
+        bool TrafficCapture::Flush()
+        {
+            lock.Lock();
+
+            const bool result=(fp?FlushBuffer():false);
+
+            if(fp)
+                fflush(fp);
+
+            lock.Unlock();
+            return result;
+        }
+
+        void TrafficCapture::Close()
+        {
+            lock.Lock();
+
+            if(fp)
+            {
+                FlushBuffer();
+                fclose(fp);
+                fp=nullptr;
+            }
+
+            delete[] buffer;
+            buffer=nullptr;
+            buffer_size=0;
+            buffer_length=0;
+
+            lock.Unlock();
+        }
+
+        void TrafficCapture::Write(const uint32 connection,const TrafficCaptureKind kind,const uint8 flags,const uint type,const void *data,const uint header_size,const uint size)
+        {
+            TrafficCaptureRecord rec;
+
+            rec.connection  =connection;
+            rec.kind        =uint8(kind);
+            rec.flags       =flags;
+            rec.header_size =uint16(header_size);
+            rec.type        =type;
+            rec.size        =size;
+
+            const uint64 total=rec.GetTotalSize();
+
+            lock.Lock();
+
+            if(!fp||full||(max_bytes>0&&file_bytes+total>max_bytes))
+            {
+                full=(fp!=nullptr);                                         //超出后整体停止，不留下时间上不连续的记录
+                lock.Unlock();
+
+                drop_count.fetch_add(1,std::memory_order_relaxed);
+                return;
+            }
+
+            rec.time=uint64(GetCaptureClock()-start_time);                  //在锁内取时间，保证文件中的记录按时间排列
+
+            const uchar *src[2]={(const uchar *)&rec,(const uchar *)data};
+            uint64 src_size[2]={sizeof(rec),size};
+
+            for(int i=0;i<2;i++)
+            {
+                while(src_size[i]>0)
+                {
+                    if(buffer_length==buffer_size&&!FlushBuffer())
+                        break;
+
+                    const uint n=uint(hgl_min<uint64>(src_size[i],buffer_size-buffer_length));
+
+                    memcpy(buffer+buffer_length,src[i],n);
+                    buffer_length+=n;
+                    src[i]+=n;
+                    src_size[i]-=n;
+                }
+            }
+
+            uint pad=uint(total-sizeof(rec)-size);                          //补齐到8字节，缓冲区大小不一定是8的倍数
+
+            while(pad>0&&!full)
+            {
+                if(buffer_length==buffer_size&&!FlushBuffer())
+                    break;
+
+                const uint n=hgl_min(pad,buffer_size-buffer_length);
+
+                memset(buffer+buffer_length,0,n);
+                buffer_length+=n;
+                pad-=n;
+            }
+
+            if(full)                                                        //写入失败，这条记录不完整
+            {
+                lock.Unlock();
+
+                drop_count.fetch_add(1,std::memory_order_relaxed);
+                return;
+            }
+
+            file_bytes+=total;
+
+            lock.Unlock();
+
+            record_count.fetch_add(1,std::memory_order_relaxed);
+        }
+
+        uint32 TrafficCapture::OpenConnection()
+        {
+            const uint32 id=connection_serial.fetch_add(1,std::memory_order_relaxed)+1;
+
+            Write(id,TrafficCaptureKind::Open,0,0,nullptr,0,0);
+            return id;
+        }
+
+        void TrafficCapture::CloseConnection(const uint32 id)
+        {
+            Write(id,TrafficCaptureKind::Close,0,0,nullptr,0,0);
+        }
+
+        bool TrafficCaptureReader::Open(const char *filename)
+        {
+            Close();
+
+            if(!filename||!*filename)
+                RETURN_FALSE;
+
+        #if HGL_OS == HGL_OS_Windows
+            HANDLE file=CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+
+            if(file==INVALID_HANDLE_VALUE)
+                RETURN_FALSE;
+
+            LARGE_INTEGER file_size;
+
+            if(!GetFileSizeEx(file,&file_size)||uint64(file_size.QuadPart)<sizeof(TrafficCaptureFileHeader))
+            {
+                CloseHandle(file);
+                RETURN_FALSE;
+            }
+
+            HANDLE mapping=CreateFileMappingA(file,nullptr,PAGE_READONLY,0,0,nullptr);
+
+            CloseHandle(file);
+
+            if(!mapping)
+                RETURN_FALSE;
+
+            data=(uchar *)MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+
+            CloseHandle(mapping);                                           //映射的视图会保持文件映射对象
+
+            if(!data)
+                RETURN_FALSE;
+
+            size=uint64(file_size.QuadPart);
+        #else
+            const int fd=open(filename,O_RDONLY);
+
+            if(fd<0)
+                RETURN_FALSE;
+
+            struct stat st;
+
+            if(fstat(fd,&st)||uint64(st.st_size)<sizeof(TrafficCaptureFileHeader))
+            {
+                close(fd);
+                RETURN_FALSE;
+            }
+
+            void *p=mmap(nullptr,size_t(st.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+
+            close(fd);
+
+            if(p==MAP_FAILED)
+                RETURN_FALSE;
+
+            madvise(p,size_t(st.st_size),MADV_SEQUENTIAL);
+
+            data=(uchar *)p;
+            size=uint64(st.st_size);
+        #endif//HGL_OS == HGL_OS_Windows
+
+            const TrafficCaptureFileHeader *header=GetHeader();
+
+            if(memcmp(header->magic,HGL_TRAFFIC_CAPTURE_MAGIC,sizeof(header->magic))
+             ||header->version!=HGL_TRAFFIC_CAPTURE_VERSION
+             ||header->byte_order!=HGL_TRAFFIC_CAPTURE_BYTE_ORDER)
+            {
+                LOG_ERROR(OS_TEXT("TrafficCaptureReader: not a capture file, or recorded with another version/byte order."));
+                Close();
+                return(false);
+            }
+
+            return(true);
+        }
+
+        void TrafficCaptureReader::Close()
+        {
+            if(!data)return;
+
+        #if HGL_OS == HGL_OS_Windows
+            UnmapViewOfFile(data);
+        #else
+            munmap(data,size_t(size));
+        #endif//HGL_OS == HGL_OS_Windows
+
+            data=nullptr;
+            size=0;
+        }
+
+        const TrafficCaptureRecord *TrafficCaptureReader::Next(uint64 &pos)const
+        {
+            if(!data||pos<sizeof(TrafficCaptureFileHeader)||pos+sizeof(TrafficCaptureRecord)>size)
+                return(nullptr);
+
+            const TrafficCaptureRecord *rec=(const TrafficCaptureRecord *)(data+pos);
+
+            if(pos+sizeof(TrafficCaptureRecord)+rec->size>size
+             ||rec->header_size>rec->size)
+                return(nullptr);
+
+            pos+=rec->GetTotalSize();
+            return rec;
+        }
+    }//namespace network
+}//namespace hgl
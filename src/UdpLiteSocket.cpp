@@ -1,4 +1,4 @@
-#include<hgl/LogInfo.h>
+﻿#include<hgl/LogInfo.h>
 #include<hgl/network/UdpSocket.h>
 #include <string.h>
 
@@ -44,6 +44,12 @@ namespace hgl
 
             socket_protocols=IPPROTO_UDPLITE;
 
+            if(!ApplyReusePort())
+            {
+                hgl::CloseSocket(ThisSocket);
+                return(false);
+            }
+
             if(!addr->Bind(ThisSocket))
             {
                 hgl::CloseSocket(ThisSocket);
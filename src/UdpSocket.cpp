@@ -5,11 +5,49 @@
 #if HGL_OS != HGL_OS_Windows
 #include<netinet/udp.h>
 #endif//HGL_OS != HGL_OS_Windows
+
+#if HGL_OS == HGL_OS_Linux
+#include<sys/socket.h>
+#define HGL_UDP_MMSG                                    //使用recvmmsg/sendmmsg
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif//UDP_SEGMENT
+
+#ifndef UDP_GRO
+#define UDP_GRO     104
+#endif//UDP_GRO
+
+#define HGL_UDP_OFFLOAD                                 //使用UDP_SEGMENT/UDP_GRO
+#endif//HGL_OS == HGL_OS_Linux
 //--------------------------------------------------------------------------------------------------
 namespace hgl
 {
     namespace network
     {
+        /**
+         * 批量收发用的消息头数组，每个UDPSocket一份，避免每次调用都在栈上准备
+         */
+        struct UDPBatch
+        {
+        #ifdef HGL_UDP_MMSG
+            mmsghdr msg[HGL_UDP_BATCH_COUNT];
+            iovec   iov[HGL_UDP_BATCH_COUNT];
+
+            union
+            {
+                cmsghdr align;
+                char    buf[CMSG_SPACE(sizeof(int))];
+            }control[HGL_UDP_BATCH_COUNT];                  ///<接收UDP_GRO段长用
+        #endif//HGL_UDP_MMSG
+        };//struct UDPBatch
+
+        namespace
+        {
+            constexpr int UDP_GSO_MAX_SEGMENTS  =64;        ///<一次UDP_SEGMENT发送最多段数(内核限制)
+            constexpr int UDP_GSO_MAX_BYTES     =65000;     ///<一次UDP_SEGMENT发送最多字节数(需小于64KB减去包头)
+        }//namespace
+
         /**
         * 本类构造函数
         */
@@ -18,6 +56,16 @@ namespace hgl
             ThisSocket=-1;
             bind_addr=nullptr;
             tar_addr=nullptr;
+            batch=nullptr;
+
+        #ifdef HGL_UDP_OFFLOAD
+            gso_support=true;
+        #else
+            gso_support=false;
+        #endif//HGL_UDP_OFFLOAD
+
+            gro_enable=false;
+            reuse_port=false;
         }
 
         /**
@@ -29,6 +77,7 @@ namespace hgl
 
             SAFE_CLEAR(tar_addr);
             SAFE_CLEAR(bind_addr);
+            SAFE_CLEAR(batch);
         }
 
         /**
@@ -46,6 +95,12 @@ namespace hgl
             if(!Socket::InitSocket(addr))
                 RETURN_FALSE;
 
+            if(!ApplyReusePort())
+            {
+                hgl::CloseSocket(ThisSocket);
+                RETURN_FALSE;
+            }
+
             bind_addr=addr->CreateCopy();
 
             if(!bind_addr->Bind(ThisSocket))
@@ -58,6 +113,45 @@ namespace hgl
             return(true);
         }
 
+        /**
+         * 在绑定前按reuse_port设置SO_REUSEPORT
+         */
+        bool UDPSocket::ApplyReusePort()
+        {
+            if(!reuse_port)
+                return(true);
+
+#ifdef SO_REUSEPORT
+            const int val=1;
+
+            if(setsockopt(ThisSocket,SOL_SOCKET,SO_REUSEPORT,(const char *)&val,sizeof(int)))
+            {
+                LOG_HINT(OS_TEXT("Set UDP SO_REUSEPORT Failed! errno: ")+OSString::numberOf(GetLastSocketError()));
+                return(false);
+            }
+
+            return(true);
+#else
+            LOG_HINT(OS_TEXT("SO_REUSEPORT isn't supported on this platform!"));
+            return(false);
+#endif//SO_REUSEPORT
+        }
+
+#if HGL_OS == HGL_OS_Linux
+        /**
+         * 设置SO_INCOMING_CPU，多个SO_REUSEPORT的socket绑定同一地址时，内核会优先把该CPU上收到的数据报交给本socket
+         * @param cpu CPU编号
+         */
+        bool UDPSocket::SetIncomingCPU(const int cpu)
+        {
+        #ifdef SO_INCOMING_CPU
+            return(setsockopt(ThisSocket,SOL_SOCKET,SO_INCOMING_CPU,&cpu,sizeof(cpu))==0);
+        #else
+            return(false);
+        #endif//SO_INCOMING_CPU
+        }
+#endif//HGL_OS == HGL_OS_Linux
+
 //         /**
 //         * 创建一个UDP连接
 //         */
@@ -151,8 +245,6 @@ namespace hgl
             }
     #endif//
 
-            static
-
     #if HGL_OS == HGL_OS_Windows
             int
     #else
@@ -162,6 +254,432 @@ namespace hgl
 
             return(recvfrom(ThisSocket,(char *)buf,size,0,remote_addr->GetSockAddr(),&sas));
         }
+
+        /**
+        * 批量发送数据包<br>
+        * Linux下使用sendmmsg，每次系统调用最多发送HGL_UDP_BATCH_COUNT个包，其它系统逐个sendto
+        * @param list 数据包列表(每个包的result填入发出的字节数)
+        * @param count 数据包数量
+        * @return 发出的包数(发送缓冲区满时可能少于count)
+        * @return -1 出错
+        */
+        int UDPSocket::SendPackets(UDPPacket *list,int count)
+        {
+            if(ThisSocket==-1)return(-1);
+            if(!list||count<=0)return(0);
+
+            int total=0;
+
+#ifdef HGL_UDP_MMSG
+            if(!batch)
+                batch=new UDPBatch;
+
+            while(total<count)
+            {
+                UDPPacket *pack=list+total;
+
+                const int n=hgl_min<int>(count-total,HGL_UDP_BATCH_COUNT);
+
+                for(int i=0;i<n;i++)
+                {
+                    IPAddress *addr=(pack[i].addr?pack[i].addr:tar_addr);
+
+                    if(!addr)
+                        return(total>0?total:-1);
+
+                    iovec &iov=batch->iov[i];
+                    msghdr &mh=batch->msg[i].msg_hdr;
+
+                    iov.iov_base=pack[i].data;
+                    iov.iov_len =pack[i].size;
+
+                    memset(&mh,0,sizeof(msghdr));
+
+                    mh.msg_name     =addr->GetSockAddr();
+                    mh.msg_namelen  =addr->GetSockAddrInSize();
+                    mh.msg_iov      =&iov;
+                    mh.msg_iovlen   =1;
+
+                    pack[i].result=0;
+                }
+
+                const int result=sendmmsg(ThisSocket,batch->msg,n,0);
+
+                if(result<=0)
+                {
+                    if(total>0)break;
+
+                    return(result<0&&GetLastSocketError()!=nseWouldBlock?-1:0);
+                }
+
+                for(int i=0;i<result;i++)
+                    pack[i].result=batch->msg[i].msg_len;
+
+                total+=result;
+
+                if(result<n)                            //发送缓冲区满了
+                    break;
+            }
+#else
+            for(;total<count;total++)
+            {
+                UDPPacket &pack=list[total];
+                IPAddress *addr=(pack.addr?pack.addr:tar_addr);
+
+                if(!addr)
+                    return(total>0?total:-1);
+
+                const int result=sendto(ThisSocket,(char *)pack.data,pack.size,0,addr->GetSockAddr(),addr->GetSockAddrInSize());
+
+                if(result<0)
+                {
+                    if(total>0)break;
+
+                    return(GetLastSocketError()!=nseWouldBlock?-1:0);
+                }
+
+                pack.result=result;
+            }
+#endif//HGL_UDP_MMSG
+
+            return(total);
+        }
+
+        /**
+        * 批量接收数据包<br>
+        * Linux下使用recvmmsg，每次系统调用最多接收HGL_UDP_BATCH_COUNT个包，其它系统逐个recvfrom<br>
+        * 阻塞模式下只等待第一个包，之后有多少收多少
+        * @param list 数据包列表(每个包的result填入收到的字节数，addr不为nullptr时填入发送方地址)
+        * @param count 数据包数量
+        * @return 收到的包数(暂时没有数据返回0)
+        * @return -1 出错
+        */
+        int UDPSocket::RecvPackets(UDPPacket *list,int count)
+        {
+            if(ThisSocket==-1)return(-1);
+            if(!list||count<=0)return(0);
+
+            int total=0;
+
+#ifdef HGL_UDP_MMSG
+            if(!batch)
+                batch=new UDPBatch;
+
+            while(total<count)
+            {
+                UDPPacket *pack=list+total;
+
+                const int n=hgl_min<int>(count-total,HGL_UDP_BATCH_COUNT);
+
+                for(int i=0;i<n;i++)
+                {
+                    iovec &iov=batch->iov[i];
+                    msghdr &mh=batch->msg[i].msg_hdr;
+
+                    iov.iov_base=pack[i].data;
+                    iov.iov_len =pack[i].size;
+
+                    memset(&mh,0,sizeof(msghdr));
+
+                    if(pack[i].addr)                            //直接收到IPAddress内部，不再复制
+                    {
+                        mh.msg_name     =pack[i].addr->GetSockAddr();
+                        mh.msg_namelen  =pack[i].addr->GetSockAddrInSize();
+                    }
+
+                    mh.msg_iov      =&iov;
+                    mh.msg_iovlen   =1;
+
+                    if(gro_enable)
+                    {
+                        mh.msg_control      =batch->control[i].buf;
+                        mh.msg_controllen   =sizeof(batch->control[i].buf);
+                    }
+
+                    pack[i].result=0;
+                    pack[i].segment_size=0;
+                }
+
+                const int result=recvmmsg(ThisSocket,batch->msg,n,(total>0?MSG_DONTWAIT:MSG_WAITFORONE),nullptr);
+
+                if(result<=0)
+                {
+                    if(total>0)break;
+
+                    return(result<0&&GetLastSocketError()!=nseWouldBlock?-1:0);
+                }
+
+                for(int i=0;i<result;i++)
+                {
+                    pack[i].result=batch->msg[i].msg_len;
+                    pack[i].segment_size=pack[i].result;
+
+                    if(!gro_enable)continue;
+
+                    msghdr *mh=&batch->msg[i].msg_hdr;
+
+                    for(cmsghdr *cm=CMSG_FIRSTHDR(mh);cm;cm=CMSG_NXTHDR(mh,cm))
+                    {
+                        if(cm->cmsg_level==SOL_UDP&&cm->cmsg_type==UDP_GRO)     //被合并的包，取得每段长度
+                        {
+                            int gso_size;
+
+                            memcpy(&gso_size,CMSG_DATA(cm),sizeof(int));
+
+                            if(gso_size>0)
+                                pack[i].segment_size=gso_size;
+                            break;
+                        }
+                    }
+                }
+
+                total+=result;
+
+                if(result<n)                                    //已经没有数据了
+                    break;
+            }
+#else
+            for(;total<count;total++)
+            {
+                UDPPacket &pack=list[total];
+
+            #if HGL_OS == HGL_OS_Windows
+                int
+            #else
+                socklen_t
+            #endif//
+                sas=(pack.addr?pack.addr->GetSockAddrInSize():0);
+
+            #if HGL_OS == HGL_OS_Windows
+                if(total>0)                                     //阻塞模式下只等待第一个包
+                {
+                    u_long bytes=0;
+
+                    if(ioctlsocket(ThisSocket,FIONREAD,&bytes)!=0||bytes==0)
+                        break;
+                }
+
+                const int flags=0;
+            #else
+                const int flags=(total>0?MSG_DONTWAIT:0);       //阻塞模式下只等待第一个包
+            #endif//HGL_OS == HGL_OS_Windows
+
+                const int result=recvfrom(ThisSocket,(char *)pack.data,pack.size,flags,pack.addr?pack.addr->GetSockAddr():nullptr,pack.addr?&sas:nullptr);
+
+                if(result<0)
+                {
+                    if(total>0)break;
+
+                    return(GetLastSocketError()!=nseWouldBlock?-1:0);
+                }
+
+                pack.result=result;
+                pack.segment_size=result;
+            }
+#endif//HGL_UDP_MMSG
+
+            return(total);
+        }
+
+        /**
+        * 批量接收数据包，收到后调用ProcRecvBatch
+        * @return 收到的包数
+        * @return -1 出错
+        */
+        int UDPSocket::RecvBatch(UDPPacket *list,int count)
+        {
+            const int result=RecvPackets(list,count);
+
+            if(result>0)
+                ProcRecvBatch(list,result);
+
+            return(result);
+        }
+
+        /**
+        * 设置接收合并(UDP_GRO)<br>
+        * 开启后内核会把同一来源、长度相同的连续数据报合并成一个交给RecvPackets，每段长度在UDPPacket::segment_size中，
+        * 接收缓冲区应有64KB才能收下合并后的数据，可用SplitSegments拆开
+        * @return 是否成功(非Linux或内核不支持返回false)
+        */
+        bool UDPSocket::SetGRO(bool enable)
+        {
+#ifdef HGL_UDP_OFFLOAD
+            if(ThisSocket==-1)RETURN_FALSE;
+
+            const int opt=(enable?1:0);
+
+            if(setsockopt(ThisSocket,SOL_UDP,UDP_GRO,&opt,sizeof(opt))!=0)
+                RETURN_FALSE;
+
+            gro_enable=enable;
+            return(true);
+#else
+            gro_enable=false;
+            return(!enable);
+#endif//HGL_UDP_OFFLOAD
+        }
+
+        /**
+        * 将一块数据按相同长度切分为多个数据报发给同一地址<br>
+        * Linux下使用UDP_SEGMENT由内核(或网卡)切分，一次系统调用最多发出64段，不支持时改用SendPackets逐个发送
+        * @param addr 目标地址(nullptr表示使用SetSendAddr设定的地址)
+        * @param data 数据
+        * @param size 数据长度
+        * @param segment_size 每个数据报的长度(最后一个可以较短)
+        * @return 已发出的字节数(发送缓冲区满时可能少于size，总是整段)
+        * @return -1 出错
+        */
+        int UDPSocket::SendSegments(IPAddress *addr,const void *data,int size,int segment_size)
+        {
+            if(ThisSocket==-1)return(-1);
+            if(!addr)addr=tar_addr;
+            if(!addr||!data||size<=0||segment_size<=0)return(-1);
+
+            if(size<=segment_size)
+                return SendPacket(addr,data,size);
+
+            const char *p=(const char *)data;
+            int total=0;
+
+#ifdef HGL_UDP_OFFLOAD
+            if(gso_support)
+            {
+                const int max_bytes=hgl_min<int>(UDP_GSO_MAX_SEGMENTS,hgl_max<int>(1,UDP_GSO_MAX_BYTES/segment_size))*segment_size;
+
+                union
+                {
+                    cmsghdr align;
+                    char    buf[CMSG_SPACE(sizeof(uint16_t))];
+                }control;
+
+                while(total<size)
+                {
+                    const int bytes=hgl_min<int>(size-total,max_bytes);
+
+                    iovec iov;
+                    msghdr mh;
+
+                    iov.iov_base=(void *)(p+total);
+                    iov.iov_len =bytes;
+
+                    memset(&mh,0,sizeof(msghdr));
+
+                    mh.msg_name     =addr->GetSockAddr();
+                    mh.msg_namelen  =addr->GetSockAddrInSize();
+                    mh.msg_iov      =&iov;
+                    mh.msg_iovlen   =1;
+
+                    if(bytes>segment_size)                      //只有一段时不需要切分
+                    {
+                        mh.msg_control      =control.buf;
+                        mh.msg_controllen   =sizeof(control.buf);
+
+                        cmsghdr *cm=CMSG_FIRSTHDR(&mh);
+
+                        cm->cmsg_level  =SOL_UDP;
+                        cm->cmsg_type   =UDP_SEGMENT;
+                        cm->cmsg_len    =CMSG_LEN(sizeof(uint16_t));
+
+                        const uint16_t gso_size=uint16_t(segment_size);
+
+                        memcpy(CMSG_DATA(cm),&gso_size,sizeof(uint16_t));
+                    }
+
+                    const int result=sendmsg(ThisSocket,&mh,0);
+
+                    if(result<0)
+                    {
+                        const int err=GetLastSocketError();
+
+                        if(err==nseWouldBlock)
+                            return(total);
+
+                        if(total==0&&(err==EIO||err==EINVAL||err==ENOPROTOOPT||err==EOPNOTSUPP))    //内核或网卡不支持，以后都逐个发送
+                        {
+                            LOG_HINT(OS_TEXT("UDPSocket::SendSegments() UDP_SEGMENT not supported,errno:")+OSString::numberOf(err));
+
+                            gso_support=false;
+                            break;
+                        }
+
+                        return(total>0?total:-1);
+                    }
+
+                    total+=result;
+                }
+
+                if(gso_support)
+                    return(total);
+            }
+#endif//HGL_UDP_OFFLOAD
+
+            UDPPacket pack[HGL_UDP_BATCH_COUNT];
+
+            while(total<size)
+            {
+                int n=0;
+                int bytes=0;
+
+                while(n<int(HGL_UDP_BATCH_COUNT)&&total+bytes<size)
+                {
+                    pack[n].data=(void *)(p+total+bytes);
+                    pack[n].size=hgl_min<int>(segment_size,size-total-bytes);
+                    pack[n].addr=addr;
+
+                    bytes+=pack[n].size;
+                    ++n;
+                }
+
+                const int result=SendPackets(pack,n);
+
+                if(result<0)
+                    return(total>0?total:-1);
+
+                for(int i=0;i<result;i++)
+                    total+=pack[i].size;
+
+                if(result<n)
+                    break;
+            }
+
+            return(total);
+        }
+
+        /**
+        * 将一个合并接收的数据包(GRO)拆分成单个数据报，拆分后的数据仍指向原缓冲区
+        * @param pack 收到的数据包
+        * @param list 拆分结果
+        * @param max_count list最多可以放的数量
+        * @return 拆分出的数据报数量
+        */
+        int UDPSocket::SplitSegments(const UDPPacket &pack,UDPPacket *list,int max_count)
+        {
+            if(!list||max_count<=0||pack.result<=0)return(0);
+
+            const int seg=(pack.segment_size>0?pack.segment_size:pack.result);
+
+            char *p=(char *)pack.data;
+            int left=pack.result;
+            int count=0;
+
+            while(left>0&&count<max_count)
+            {
+                const int size=hgl_min<int>(seg,left);
+
+                list[count].data        =p;
+                list[count].size        =size;
+                list[count].addr        =pack.addr;
+                list[count].result      =size;
+                list[count].segment_size=size;
+
+                p+=size;
+                left-=size;
+                ++count;
+            }
+
+            return(count);
+        }
     }//namespace network
 }//namespace hgl
 
@@ -1,103 +1,258 @@
 ﻿#include<hgl/type/StrChar.h>
 #include<hgl/type/String.h>
-#include<hgl/io/MemoryOutputStream.h>
 #include<hgl/util/hash/Hash.h>
+#include<hgl/network/WebSocket.h>
 
 namespace hgl
 {
     namespace network
     {
+        namespace
+        {
+            constexpr u8char SEC_WEBSOCKET_KEY[]        =U8_TEXT("Sec-WebSocket-Key");
+            constexpr u8char SEC_WEBSOCKET_PROTOCOL[]   =U8_TEXT("Sec-WebSocket-Protocol");
+            constexpr u8char SEC_WEBSOCKET_VERSION[]    =U8_TEXT("Sec-WebSocket-Version");
+            constexpr u8char SEC_WEBSOCKET_EXTENSIONS[] =U8_TEXT("Sec-WebSocket-Extensions");
+
+            constexpr char WEBSOCKET_GUID[]="258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+            /**
+             * 比较HTTP头名称(不区分大小写)
+             */
+            template<uint N>
+            inline bool IsHeaderName(const u8char *name,const uint size,const u8char (&str)[N])
+            {
+                if(size!=N-1)return(false);                                 //sizeof带\0所以要-1
+
+                for(uint i=0;i<size;i++)
+                {
+                    u8char c=name[i];
+
+                    if(c>='A'&&c<='Z')c+='a'-'A';
+
+                    u8char t=str[i];
+
+                    if(t>='A'&&t<='Z')t+='a'-'A';
+
+                    if(c!=t)return(false);
+                }
+
+                return(true);
+            }
+
+            inline bool IsSpace(const u8char c){return c==' '||c=='\t';}
+
+            constexpr char BASE64_CHARS[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            /**
+             * Base64编码(仅用于握手回复，数据很短)
+             */
+            void Base64Encode(U8String &result,const uint8 *data,const uint size)
+            {
+                u8char str[((20+2)/3)*4+1];                                 //SHA1结果为20字节
+                uint len=0;
+                uint i=0;
+
+                for(;i+3<=size;i+=3)
+                {
+                    const uint32 v=(uint32(data[i])<<16)|(uint32(data[i+1])<<8)|data[i+2];
+
+                    str[len++]=BASE64_CHARS[(v>>18)&0x3F];
+                    str[len++]=BASE64_CHARS[(v>>12)&0x3F];
+                    str[len++]=BASE64_CHARS[(v>> 6)&0x3F];
+                    str[len++]=BASE64_CHARS[ v     &0x3F];
+                }
+
+                if(i<size)
+                {
+                    uint32 v=uint32(data[i])<<16;
+
+                    if(i+1<size)
+                        v|=uint32(data[i+1])<<8;
+
+                    str[len++]=BASE64_CHARS[(v>>18)&0x3F];
+                    str[len++]=BASE64_CHARS[(v>>12)&0x3F];
+                    str[len++]=(i+1<size)?BASE64_CHARS[(v>>6)&0x3F]:'=';
+                    str[len++]='=';
+                }
+
+                result=U8String(str,len);
+            }
+        }//namespace
+
         /**
-         * 获取WebSocket信息
-         * @param data 输入的信息头
+         * 获取WebSocket信息<br>
+         * 逐行扫描一遍HTTP头，头名称不区分大小写
+         * @param data 输入的信息头(需包含结尾的空行)
          * @param size 信息头长度
+         * @param sec_websocket_extensions 需要扩展信息时传入(多行会以逗号合并)
          * @return 是否解晰成功
          */
-        bool GetWebSocketInfo(U8String &sec_websocket_key,U8String &sec_websocket_protocol,uint &sec_websocket_version,const u8char *data,const uint size)
+        bool GetWebSocketInfo(U8String &sec_websocket_key,U8String &sec_websocket_protocol,uint &sec_websocket_version,const u8char *data,const uint size,U8String *sec_websocket_extensions)
         {
-            constexpr u8char SEC_WEBSOCKET_KEY[]=U8_TEXT("Sec-WebSocket-Key: ");
-            constexpr uint SEC_WEBSOCKET_KEY_SIZE=sizeof(SEC_WEBSOCKET_KEY)-1;      //sizeof的带\0所以要-1
-
-            constexpr u8char SEC_WEBSOCKET_PROTOCOL[]=U8_TEXT("Sec-WebSocket-Protocol: ");
-            constexpr uint SEC_WEBSOCKET_PROTOCOL_SIZE=sizeof(SEC_WEBSOCKET_PROTOCOL)-1;
+            if(!data||size<40)return(false);
 
-            constexpr u8char SEC_WEBSOCKET_VERSION[]=U8_TEXT("Sec-WebSocket-Version: ");
-            constexpr uint SEC_WEBSOCKET_VERSION_SIZE=sizeof(SEC_WEBSOCKET_VERSION)-1;
+            const u8char *p=data;
+            const u8char *end=data+size;
 
-            if(!data||size<40)return(false);
+            bool has_key=false;
 
-            const u8char *end;
+            while(p<end&&*p!='\n')++p;                                     //跳过请求行
+            ++p;
 
+            while(p<end)
             {
-                const u8char *key=hgl::strstr(data,size,SEC_WEBSOCKET_KEY,SEC_WEBSOCKET_KEY_SIZE);
+                const u8char *line=p;
 
-                if(!key)return(false);
+                while(p<end&&*p!='\n')++p;
 
-                key+=SEC_WEBSOCKET_KEY_SIZE;
+                const u8char *line_end=p;
 
-                end=key;
-                while(*end!='\r')++end;
+                ++p;
 
-                sec_websocket_key=U8String(key,end-key);
-            }
+                if(line_end>line&&line_end[-1]=='\r')
+                    --line_end;
 
-            {
-                const u8char *protocol=hgl::strstr(data,size,SEC_WEBSOCKET_PROTOCOL,SEC_WEBSOCKET_PROTOCOL_SIZE);
+                if(line_end==line)                                          //空行，头结束
+                    break;
+
+                const u8char *colon=line;
+
+                while(colon<line_end&&*colon!=':')++colon;
+
+                if(colon>=line_end)
+                    continue;
+
+                const u8char *value=colon+1;
 
-                if(protocol)        //也有可能是不存在的
+                while(value<line_end&&IsSpace(*value))++value;
+
+                const u8char *value_end=line_end;
+
+                while(value_end>value&&IsSpace(value_end[-1]))--value_end;
+
+                const uint name_size=colon-line;
+
+                if(IsHeaderName(line,name_size,SEC_WEBSOCKET_KEY))
+                {
+                    sec_websocket_key=U8String(value,value_end-value);
+                    has_key=true;
+                }
+                else
+                if(IsHeaderName(line,name_size,SEC_WEBSOCKET_PROTOCOL))     //也有可能是不存在的
+                {
+                    sec_websocket_protocol.fromString(value,value_end-value);
+                }
+                else
+                if(IsHeaderName(line,name_size,SEC_WEBSOCKET_VERSION))
                 {
-                    protocol+=SEC_WEBSOCKET_PROTOCOL_SIZE;
-                    end=protocol;
-                    while(*end!='\r')++end;
+                    uint v=0;
 
-                    sec_websocket_protocol.fromString(protocol,end-protocol);
+                    for(const u8char *vp=value;vp<value_end&&*vp>='0'&&*vp<='9';++vp)
+                        v=v*10+(*vp-'0');
+
+                    sec_websocket_version=v;
+                }
+                else
+                if(sec_websocket_extensions
+                 &&IsHeaderName(line,name_size,SEC_WEBSOCKET_EXTENSIONS))
+                {
+                    if(!sec_websocket_extensions->IsEmpty())
+                        *sec_websocket_extensions+=U8_TEXT(",");
+
+                    *sec_websocket_extensions+=U8String(value,value_end-value);
                 }
             }
 
+            return has_key;
+        }
+
+        /**
+         * 生成服务端发出的帧头(不带掩码)
+         * @param header 帧头存放位置(至少HGL_WEBSOCKET_FRAME_HEADER_MAX_SIZE字节)
+         * @return 帧头长度
+         */
+        uint MakeWebSocketFrameHeader(uint8 *header,const uint8 opcode,const uint64 size,const bool fin,const bool rsv1)
+        {
+            header[0]=opcode&0xF;
+            if(fin)
+                header[0]|=1<<7;
+            if(rsv1)
+                header[0]|=1<<6;
+
+            if(size<=125)
             {
-                const u8char *version=hgl::strstr(data,size,SEC_WEBSOCKET_VERSION,SEC_WEBSOCKET_VERSION_SIZE);
+                header[1]=size;
+                return 2;
+            }
 
-                if(version)
-                {
-                    version+=SEC_WEBSOCKET_VERSION_SIZE;
-                    end=version;
-                    while(*end!='\r')++end;
+            if(size<=65535)
+            {
+                header[1]=126;
+                header[2]=(size>>8)&0xFF;
+                header[3]= size    &0xFF;
 
-                    hgl::stou(version,sec_websocket_version);
-                }
+                return 4;
             }
 
-            return(true);
+            header[1]=127;
+
+            for(uint i=0;i<8;i++)
+                header[2+i]=(size>>((7-i)*8))&0xFF;
+
+            return 10;
         }
 
-        ///**
-        /// 这函数可以用，只是这版SDK没有base64_encode,所以暂时屏蔽
-        // * 生成WebSocket回复头
-        // * @param result 回复头存放字符串
-        // */
-        //void MakeWebSocketAccept(U8String &result,const U8String &sec_websocket_key,const U8String &sec_websocket_protocol)
-        //{
-        //    const U8String key_mask=sec_websocket_key+"258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        /**
+         * 将一条消息编码为完整的WebSocket帧(帧头+数据)，之后可用SendShared或SocketManage::Broadcast发给多个连接<br>
+         * 广播帧不压缩，协商了permessage-deflate的连接同样可以接收不带RSV1的帧
+         * @return 共享数据块(引用计数为1，由调用者释放)
+         */
+        SharedBuffer *MakeWebSocketFrame(const uint8 opcode,const void *data,const uint size,const bool fin)
+        {
+            uint8 header[HGL_WEBSOCKET_FRAME_HEADER_MAX_SIZE];
 
-        //    util::HashCodeSHA1 hc;
+            const uint header_size=MakeWebSocketFrameHeader(header,opcode,size,fin);
 
-        //    CountSHA1(key_mask.c_str(),key_mask.Length(),hc);
+            SharedBuffer *sb=SharedBuffer::Create(header_size+size);
 
-        //    io::MemoryOutputStream mos;
+            memcpy(sb->GetData(),header,header_size);
 
-        //    base64_encode(&mos,hc.code,hc.size());
+            if(data&&size>0)
+                memcpy(sb->GetData()+header_size,data,size);
 
-        //    const U8String sec_websocket_accept((char *)mos.GetData(),mos.GetSize());
+            return sb;
+        }
 
-        //    result="HTTP/1.1 101 Switching Protocols\r\n"
-        //           "Upgrade: websocket\r\n"
-        //           "Connection: Upgrade\r\n"
-        //           "Sec-WebSocket-Accept: "+sec_websocket_accept;
+        /**
+         * 生成WebSocket回复头
+         * @param result 回复头存放字符串
+         * @param sec_websocket_extensions 接受的扩展(可以为nullptr)
+         */
+        void MakeWebSocketAccept(U8String &result,const U8String &sec_websocket_key,const U8String &sec_websocket_protocol,const U8String *sec_websocket_extensions)
+        {
+            const U8String key_mask=sec_websocket_key+WEBSOCKET_GUID;
+
+            util::HashCodeSHA1 hc;
+
+            CountSHA1(key_mask.c_str(),key_mask.Length(),hc);
+
+            U8String sec_websocket_accept;
 
-        //    if(!sec_websocket_protocol.IsEmpty())
-        //        result+="\r\nSec-WebSocket-Protocol: "+sec_websocket_protocol;
+            Base64Encode(sec_websocket_accept,hc.code,hc.size());
 
-        //    result+="\r\n\r\n";
-        //}
+            result="HTTP/1.1 101 Switching Protocols\r\n"
+                   "Upgrade: websocket\r\n"
+                   "Connection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: "+sec_websocket_accept;
+
+            if(!sec_websocket_protocol.IsEmpty())
+                result+="\r\nSec-WebSocket-Protocol: "+sec_websocket_protocol;
+
+            if(sec_websocket_extensions&&!sec_websocket_extensions->IsEmpty())
+                result+="\r\nSec-WebSocket-Extensions: "+*sec_websocket_extensions;
+
+            result+="\r\n\r\n";
+        }
     }//namespace network
 }//namespace hgl
@@ -14,313 +14,718 @@ namespace hgl
         {
         }
 
-        WebSocketAccept::WebSocketAccept(int s,IPAddress *ip):TCPAccept(s,ip),recv_buffer(HGL_TCP_BUFFER_SIZE)
+        WebSocketAccept::WebSocketAccept(int s,const IPAddress *ip):TCPAccept(s,ip),recv_buffer(HGL_TCP_BUFFER_SIZE)
         {
         }
 
-        void WebSocketAccept::WebSocketHandshake()
+        WebSocketAccept::~WebSocketAccept()
+        {
+            ReleaseDeflate();
+            ReleaseTextBlock();
+        }
+
+        void WebSocketAccept::ReleaseTextBlock()
+        {
+            if(text_block)
+            {
+                text_block->Release();
+                text_block=nullptr;
+            }
+
+            text_length=0;
+        }
+
+        void WebSocketAccept::ReleaseDeflate()
+        {
+            ReleaseWebSocketDeflater(deflater);
+            ReleaseWebSocketInflater(inflater);
+
+            deflater=nullptr;
+            inflater=nullptr;
+            inflate_total=0;
+
+            deflate_param.enable=false;
+        }
+
+        bool WebSocketAccept::UseSocket(int sock,const IPAddress *addr)
+        {
+            if(!TCPAccept::UseSocket(sock,addr))
+                RETURN_FALSE;
+
+            recv_buffer.Clear();
+            recv_length=0;
+            recv_total=0;
+            handshake_done=false;
+            handshake_scan_pos=0;
+            msg_header_done=false;
+            msg_recv_length=0;
+            msg_compressed=false;
+            msg_partial=false;
+            last_opcode=0;
+            send_opcode=0;
+            text_validator.Reset();
+
+            ReleaseDeflate();
+            ReleaseTextBlock();
+
+            return(true);
+        }
+
+        /**
+         * 压缩上下文、分片中的消息都无法转交，只有握手完成、正处于两条消息之间的连接才能转交给新进程，此时只需要记下已握手
+         */
+        bool WebSocketAccept::SaveHandoffState(DataArray<uchar> &out)
+        {
+            if(!handshake_done
+             ||IsDeflate()
+             ||recv_length>0
+             ||msg_header_done
+             ||last_opcode
+             ||send_opcode
+             ||text_block)
+                return(false);
+
+            if(!TCPAccept::SaveHandoffState(out))
+                return(false);
+
+            const int64 pos=out.GetCount();
+
+            out.SetCount(pos+1);
+            out.GetData()[pos]=1;
+            return(true);
+        }
+
+        int WebSocketAccept::LoadHandoffState(const uchar *data,const uint size)
+        {
+            const int used=TCPAccept::LoadHandoffState(data,size);
+
+            if(used<0||uint(used)>=size||data[used]!=1)
+                return(-1);
+
+            handshake_done=true;
+            return used+1;
+        }
+
+        /**
+         * 处理握手<br>
+         * 握手头直接收在recv_buffer中，每次只读取socket里已有的数据，收不完则等下一次可读事件继续，不会阻塞所在线程
+         * @return 1 握手完成，头后多收的数据留在recv_buffer中
+         * @return 0 握手头还未收完
+         * @return -1 出错
+         */
+        int WebSocketAccept::ProcHandshake()
         {
             constexpr u8char HTTP_HEADER_END_STR[4]={'\r','\n','\r','\n'};        //别用"\r\n\r\n"，不然sizeof会得出来5
             constexpr int HTTP_HEADER_END_SIZE=sizeof(HTTP_HEADER_END_STR);
 
-            DataArray<u8char>  ws_header(1024);
+            recv_buffer.SetCount(HGL_WEBSOCKET_HANDSHAKE_MAX_SIZE);
 
-            int pos=0;
-            int total=0;
-            int size=0;
-
-            const u8char *end;
+            bool rescan=false;                                      //缓冲区中还留有上一个普通HTTP请求之后的数据
 
             while(true)
             {
-                size=sis->Read(ws_header.data()+pos,1024);
-
-                if(size==0)continue;
-                if(size<0)
+                if(!rescan)
                 {
-                    LOG_ERROR(OS_TEXT("WebSocketAccept::WebSocketHandshake() read data error"));
-                    break;
+                    if(recv_length>=HGL_WEBSOCKET_HANDSHAKE_MAX_SIZE)
+                    {
+                        LOG_ERROR(OS_TEXT("WebSocketAccept::ProcHandshake() header too large,socket:")+OSString::numberOf(ThisSocket));
+                        return(-1);
+                    }
+
+                    const int size=sis->Read(recv_buffer.data()+recv_length,HGL_WEBSOCKET_HANDSHAKE_MAX_SIZE-recv_length);
+
+                    if(size<0)
+                    {
+                        LOG_ERROR(OS_TEXT("WebSocketAccept::ProcHandshake() read data error"));
+                        return(-1);
+                    }
+
+                    if(size==0)                                     //socket里暂时没数据了，等下一次可读
+                        return(0);
+
+                    recv_total+=size;
+                    recv_length+=size;
                 }
 
-                recv_total+=size;
-                pos+=size;
+                rescan=false;
 
-                end=hgl::strrstr<const u8char>(ws_header.data(),pos,HTTP_HEADER_END_STR,HTTP_HEADER_END_SIZE);
+                const u8char *data=(const u8char *)recv_buffer.data();
+                const u8char *end=hgl::strstr(data+handshake_scan_pos,recv_length-handshake_scan_pos,HTTP_HEADER_END_STR,HTTP_HEADER_END_SIZE);
 
                 if(!end)
+                {
+                    if(recv_length>=HTTP_HEADER_END_SIZE)           //已查找过的部分不再重复查找，保留3字节以防结束符被拆开
+                        handshake_scan_pos=recv_length-(HTTP_HEADER_END_SIZE-1);
+
                     continue;
+                }
 
-                end+=HTTP_HEADER_END_SIZE;
-                total=end-ws_header.data();
+                const uint total=(end+HTTP_HEADER_END_SIZE)-data;
+
+                {
+                    HTTPRequest req;
+
+                    if(ParseHTTPRequestHead(req,(const char *)data,total)>0
+                     &&!req.GetHeader("sec-websocket-key"))                 //普通HTTP请求
+                    {
+                        const int hr=ProcHTTPRequest(req);
+
+                        if(hr<=0)
+                            return hr;
+
+                        ConsumeRecvBuffer(total);
+                        handshake_scan_pos=0;
+                        rescan=(recv_length>0);
+                        continue;
+                    }
+                }
 
                 U8String key;
                 U8String ws_protocol;
-                uint       ws_version;
+                uint     ws_version=0;
+                U8String ws_extensions;
 
                 U8String ws_accept_protocol;
+                U8String ws_accept_extensions;
 
-                if(GetWebSocketInfo(key,ws_protocol,ws_version,ws_header.data(),total))
-                    if(OnHandshake(ws_accept_protocol,ws_protocol,ws_version))
-                    {
-                        U8String ws_return;
+                if(!GetWebSocketInfo(key,ws_protocol,ws_version,data,total,&ws_extensions))
+                    return(-1);
 
-                        MakeWebSocketAccept(ws_return,key,ws_accept_protocol);
+                if(!OnHandshake(ws_accept_protocol,ws_protocol,ws_version))
+                    return(-1);
 
-                        if(Send(ws_return.c_str(),ws_return.Length()))
-                        {
-                            size=pos-total;
+                if(deflate_config.enable)
+                    NegotiateWebSocketDeflate(deflate_param,ws_accept_extensions,ws_extensions,deflate_config);
 
-                            if(size>0)
-                                memcpy(recv_buffer.data(),end,size);
+                U8String ws_return;
 
-                            recv_length=size;
-                            return;
-                        }
-                    }
+                MakeWebSocketAccept(ws_return,key,ws_accept_protocol,&ws_accept_extensions);
 
-                break;
-            }
+                if(!Send(ws_return.c_str(),ws_return.Length()))
+                    return(-1);
 
-            CloseSocket();
+                ConsumeRecvBuffer(total);
+                handshake_scan_pos=0;
+                return(1);
+            }
         }
 
         /**
-         * 从socket接收数据回调函数<br>此写法有待改良
+         * 处理握手前的普通HTTP请求
+         * @return 1 继续等待下一个请求
+         * @return 0 回应发出后关闭
+         * @return -1 出错
          */
-        int WebSocketAccept::OnSocketRecv(int /*size*/)
+        int WebSocketAccept::ProcHTTPRequest(const HTTPRequest &req)
         {
-            int total=0;
+            http_keep_alive=req.keep_alive;
 
-            if(!sis)
+            if(req.content_length>0)                                    //请求体不在握手缓冲区的处理范围内
+            {
+                http_keep_alive=false;
+
+                if(!SendHTTPResponse(413,nullptr,0))
+                    return(-1);
+            }
+            else
+            if(!OnHTTPRequest(req))
+                return(-1);
+
+            if(!http_keep_alive)
+            {
+                CloseAfterSend();
+                return(0);
+            }
+
+            return(1);
+        }
+
+        bool WebSocketAccept::SendHTTPResponse(const uint status,const void *body,const uint size,const char *content_type,const char *extra_headers)
+        {
+            if(handshake_done)
+                RETURN_FALSE;
+
+            if(size>0&&!body)
+                RETURN_FALSE;
+
+            char head[HGL_HTTP_RESPONSE_HEAD_MAX_SIZE];
+
+            const uint head_size=MakeHTTPResponseHead(head,sizeof(head),status,size,content_type,http_keep_alive,extra_headers);
+
+            if(head_size==0)
+                RETURN_FALSE;
+
+            const SocketIOVec vec[2]=
+            {
+                {head,head_size},
+                {body,size}
+            };
+
+            return Send(vec,size>0?2:1);
+        }
+
+        namespace
+        {
+            constexpr uint WEBSOCKET_MAX_HEADER_SIZE=14;                        ///<2字节基本头+8字节长度+4字节掩码
+        }//namespace
+
+        /**
+         * 从接收缓冲区前部移除已处理完的数据，剩下的数据前移
+         */
+        void WebSocketAccept::ConsumeRecvBuffer(uint size)
+        {
+            if(size>=recv_length)
             {
-                sis=new SocketInputStream(ThisSocket);
-                recv_total=0;
                 recv_length=0;
-                WebSocketHandshake();
+                return;
+            }
+
+            recv_length-=size;
+            memmove(recv_buffer.data(),recv_buffer.data()+size,recv_length);
+        }
 
-                total+=recv_total;
+        /**
+         * 解析recv_buffer前部的帧头
+         * @return 1 帧头已完整并从缓冲区移除
+         * @return 0 帧头还未收完整，msg_header_size为需要的长度
+         * @return -1 帧头错误
+         */
+        int WebSocketAccept::ParseFrameHeader()
+        {
+            if(recv_length<2)
+            {
+                msg_header_size=2;
+                return(0);
             }
 
-            while(true)
+            const uint8 *p=recv_buffer.data();
+
+            msg_opcode  =p[0]&0xF;
+
+            const uint rsv=(p[0]>>4)&0x7;
+            msg_fin     =(p[0]>>7)&0x1;
+            msg_masked  =(p[1]>>7)&0x1;
+
+            const uint length_field=p[1]&0x7F;
+
+            msg_header_size=2;
+
+            if(length_field==126)msg_header_size+=2;else
+            if(length_field==127)msg_header_size+=8;
+
+            if(msg_masked)
+                msg_header_size+=4;
+
+            if(recv_length<msg_header_size)
+                return(0);
+
+            if(length_field<=125)
             {
-                if(recv_length==0)
-                {
-                    msg_header_size=2;                  //最小头2字节
-                    msg_full_length=0;
-                    msg_length=0;
-                    msg_opcode=0;
-                    msg_fin=0;
-                    msg_masked=0;
-                }
+                msg_length=length_field;
+            }
+            else
+            if(length_field==126)       //16 bit msg_length
+            {
+                msg_length=(uint64(p[2])<<8)|p[3];
+            }
+            else                        //64 bit msg_length
+            {
+                msg_length=0;
 
-                if(recv_length<msg_header_size)         //头都没收完
-                {
-                    int result=sis->Read(recv_buffer.data()+recv_length,msg_header_size-recv_length);
+                for(uint i=2;i<10;i++)
+                    msg_length=(msg_length<<8)|p[i];
 
-                    if(result<0)
-                        RETURN_ERROR(result);
+                if(msg_length>>63)      //RFC6455规定最高位必须为0
+                    return(-1);
+            }
 
-                    if(result==0)
-                        return(total);
+            if(msg_masked)
+                memcpy(&msg_mask,p+msg_header_size-4,4);
+            else
+                msg_mask=0;
 
-                    recv_length+=result;
-                    recv_total+=result;
-                    total+=result;
-                }
+            msg_full_length=msg_length;
 
-                if(recv_length<msg_header_size)      //已经有头了
-                    continue;
+            if(msg_masked)
+                msg_full_length+=4;
 
-                uint8 *p=recv_buffer.data();
+            if(msg_opcode>=8)           //控制帧不可分片且最长125字节
+            {
+                if(!msg_fin||msg_length>125)
+                    return(-1);
 
-                msg_opcode  =p[0]&0x7;
+                msg_data_opcode=msg_opcode;
+            }
+            else
+            if(msg_opcode==0)
+            {
+                if(last_opcode==0)      //没有可以接续的消息
+                    return(-1);
 
-                if(msg_opcode==8)   //close
-                {
-                    this->CloseSocket();
+                msg_data_opcode=last_opcode;
+
+                if(rsv)                 //RSV1只能出现在消息的第一帧
                     return(-1);
-                }
+            }
+            else
+            {
+                msg_data_opcode=msg_opcode;
+                msg_compressed=(rsv==0x4);
+            }
+
+            if(rsv&&!(rsv==0x4&&deflate_param.enable&&msg_opcode>0&&msg_opcode<8))     //只有协商了压缩的数据帧可以使用RSV1
+                return(-1);
 
-                msg_fin     =(p[0]>>7)&0x1;
-                msg_masked  =(p[1]>>7)&0x1;
+            msg_stream=(stream_chunk_size>0
+                      &&msg_opcode<8
+                      &&msg_length>stream_chunk_size);
 
-                uint length_field=p[1]&0x7F;
+            if(!msg_stream&&msg_length>max_frame_size)              //整帧缓存的帧不能让对方随意扩大接收缓冲区
+            {
+                LOG_PROBLEM(OS_TEXT("WebSocketAccept,frame too large,socket:")+OSString::numberOf(ThisSocket)+OS_TEXT(",length:")+OSString::numberOf(msg_length));
+                return(-1);
+            }
 
-                msg_header_size=2;
+            ConsumeRecvBuffer(msg_header_size);
 
-                if(length_field<=125)
+            msg_recv_length=0;
+            msg_header_done=true;
+            return(1);
+        }
+
+        /**
+         * 将消息数据交给OnBinary/OnText
+         * @param fin 是否为消息的最后一段
+         */
+        bool WebSocketAccept::DeliverData(char *data,uint32 size,bool fin)
+        {
+            if(msg_data_opcode==1)
+            {
+                if(text_validate)
                 {
-                    msg_length=length_field;
+                    if(!text_validator.Update(data,size)
+                     ||(fin&&!text_validator.IsComplete()))
+                    {
+                        LOG_PROBLEM(OS_TEXT("WebSocketAccept,invalid UTF-8 text,socket:")+OSString::numberOf(ThisSocket));
+                        text_validator.Reset();
+                        OnError();
+                        return(false);
+                    }
                 }
-                else
-                if(length_field==126)       //16 bit msg_length
+
+                if(text_assemble_max>0
+                 &&(!fin||text_length>0))                               //未分片的消息直接交出，不复制
                 {
-                    msg_header_size+=2;
+                    if(!AppendText(data,size))
+                    {
+                        LOG_PROBLEM(OS_TEXT("WebSocketAccept,text message too large,socket:")+OSString::numberOf(ThisSocket));
+                        OnError();
+                        return(false);
+                    }
 
-                    if(recv_length<msg_header_size)
-                        return(total);
+                    if(!fin)
+                        return(true);
 
-                    msg_length=ntohs(*(uint16 *)(p+2));
+                    CaptureRecv(TrafficCaptureKind::WebSocketText,0,text_block->GetData(),0,text_length);
+                    TraceDispatch();
+                    OnText((char *)text_block->GetData(),text_length,true);
+                    ReleaseTextBlock();                                 //还给池，空闲连接不占用
+                    return(true);
                 }
-                else
-                if(length_field==127)       //64 bit msg_length
+            }
+
+            if(size==0&&!(fin&&msg_partial))                            //之前回调过未结束的分段，空的结束段也要通知消息结束
+                return(true);
+
+            msg_partial=!fin;
+
+            CaptureRecv(msg_data_opcode==2?TrafficCaptureKind::WebSocketBinary:TrafficCaptureKind::WebSocketText,0,data,0,size,fin);
+            TraceDispatch();
+
+            if(msg_data_opcode==2)
+            {
+            #ifdef _DEBUG
+                if(size>0)
                 {
-                    msg_header_size+=8;
+                    data_out_str.SetCount(size*3);
 
-                    if(recv_length<msg_header_size)
-                        return(total);
+                    DataToLowerHexStr(data_out_str.data(),(uint8 *)data,size,u8char(','));
 
-                    msg_length=ntohl(*(uint32 *)(p+2));
+                    LOG_INFO(U8_TEXT("WebSocket[")+U8String::numberOf(ThisSocket)+U8_TEXT("] Recv binary [")+U8String::numberOf(size)+U8_TEXT("]: ")+U8String(data_out_str.data()));
                 }
+            #endif//_DEBUG
 
-                msg_full_length=msg_length;
+                OnBinary(data,size,fin);
+                return(true);
+            }
 
-                if(msg_masked)
-                    msg_full_length+=4;
+            OnText(data,size,fin);
+            return(true);
+        }
 
-                recv_buffer.SetCount(msg_full_length);
+        /**
+         * 将一段文本追加到text_block，容量不足时从池中取得更大的块
+         */
+        bool WebSocketAccept::AppendText(const char *data,uint32 size)
+        {
+            const uint64 need=uint64(text_length)+size;
 
-                int result=sis->Read(recv_buffer.data()+recv_length,msg_full_length-(recv_length-msg_header_size));
+            if(need>text_assemble_max)
+                return(false);
 
-                if(result<0)
-                    RETURN_ERROR(result);
+            if(!text_block||text_block->GetSize()<need)
+            {
+                const uint64 grow=text_block?uint64(text_block->GetSize())*2:0;        //超出池的最大级别后直接分配，仍按倍数增长
 
-                if(result==0)
-                    return total;
+                SharedBuffer *sb=SharedBuffer::Acquire(uint(hgl_min<uint64>(hgl_max<uint64>(need,grow),text_assemble_max)));
 
-                recv_length+=result;
-                recv_total+=result;
-                total+=result;
+                if(text_length>0)
+                    memcpy(sb->GetData(),text_block->GetData(),text_length);
 
-                if(recv_length<msg_full_length+msg_header_size)                          //这个包还没收完整
-                    return(total);                                                      //证明socket缓冲区里没有数据了，直接返回
+                if(text_block)
+                    text_block->Release();
 
-                //收完了
+                text_block=sb;
+            }
 
-                char *pack;
+            memcpy(text_block->GetData()+text_length,data,size);
+            text_length+=size;
+            return(true);
+        }
 
-                p+=msg_header_size;
+        /**
+         * 处理一段压缩的帧数据，解压结果整段交出<br>
+         * 解压后的长度按整条消息累计，分片消息的所有分片合计不能超过max_message_size
+         */
+        bool WebSocketAccept::ProcInflateData(char *data,uint32 size,bool last)
+        {
+            const bool fin=(last&&msg_fin);
+            const uint64 max_size=(msg_stream?0:deflate_param.max_message_size);
 
-                if(msg_masked)
-                {
-                    uint32 mask=*(uint32 *)p;
+            if(!inflater)
+                inflater=AcquireWebSocketInflater(deflate_param.client_max_window_bits);
 
-                    p+=4;
-                    pack=(char *)p;
+            inflate_buffer.Clear();
 
-                    for(uint i=0;i<msg_length;i++)
-                    {
-                        *p=(*p)^((uchar *)(&mask))[i%4];
-                        ++p;
-                    }
-                }
-                else
+            uint limit=0;
+
+            if(max_size)                                                //只给本段剩下的额度，用完时给1字节，超出由下面的检查发现
+                limit=(inflate_total<max_size?uint(max_size-inflate_total):1);
+
+            if(!inflater->Decompress(inflate_buffer,data,size,fin,limit))
+            {
+                LOG_PROBLEM(OS_TEXT("WebSocketAccept,inflate error,socket:")+OSString::numberOf(ThisSocket));
+                OnError();
+                return(false);
+            }
+
+            if(max_size)
+            {
+                inflate_total+=inflate_buffer.GetCount();
+
+                if(inflate_total>max_size)
                 {
-                    pack=(char *)p;
+                    LOG_PROBLEM(OS_TEXT("WebSocketAccept,inflated message too large,socket:")+OSString::numberOf(ThisSocket));
+                    OnError();
+                    return(false);
                 }
+            }
+
+            if(fin)
+                inflate_total=0;
+
+            if(fin&&deflate_param.client_no_context_takeover)          //不保留上下文，消息结束就还给线程池
+            {
+                ReleaseWebSocketInflater(inflater);
+                inflater=nullptr;
+            }
+
+            return DeliverData((char *)inflate_buffer.data(),inflate_buffer.GetCount(),fin);
+        }
+
+        /**
+         * 处理一段已解码的帧数据
+         * @param data 数据
+         * @param size 数据长度
+         * @param last 是否为当前帧的最后一段
+         */
+        bool WebSocketAccept::ProcFrameData(char *data,uint32 size,bool last)
+        {
+            if(msg_data_opcode==0xA){OnPong();return(true);}
+            if(msg_data_opcode==0x9){OnPing();return(true);}
+
+            if(msg_data_opcode==1
+             ||msg_data_opcode==2)
+            {
+                if(msg_compressed)
+                    return ProcInflateData(data,size,last);
+
+                return DeliverData(data,size,last&&msg_fin);
+            }
 
-                if(msg_opcode==0xA)OnPong();else
-                if(msg_opcode==0x9)OnPing();else
-                if(msg_opcode>=3
-                 &&msg_opcode<=7)
+            LOG_PROBLEM(OS_TEXT("WebSocketAccept,opcode error,opcode:")+OSString::numberOf(msg_opcode)+OS_TEXT(",length:")+OSString::numberOf(msg_length));
+            OnError();
+            return(false);
+        }
+
+        /**
+         * 从socket接收数据回调函数<br>
+         * 普通帧整帧收完后回调，开启流式处理(SetStreamChunkSize)后超长的数据帧按段回调
+         */
+        int WebSocketAccept::OnSocketRecv(int /*size*/)
+        {
+            int total=0;
+
+            if(!sis)
+                sis=new SocketInputStream(ThisSocket);
+
+            if(sis->IsTimestamp()!=latency_trace)
+                sis->SetTimestamp(latency_trace);
+
+            if(!handshake_done)
+            {
+                const uint64 old_total=recv_total;
+                const int result=ProcHandshake();
+
+                total+=recv_total-old_total;
+
+                if(result<0)
                 {
+                    CloseSocket();
+                    return(-1);
                 }
-                else
-                if(msg_opcode==2)
+
+                if(result==0)
+                    return(total);
+
+                handshake_done=true;
+                msg_header_done=false;
+            }
+
+            while(true)
+            {
+                if(recv_pause)                                          //暂停接收，未读的数据留在socket缓冲区中
+                    return(total);
+
+                if(!msg_header_done)
                 {
-                    if(msg_length>0)
+                    const int hr=ParseFrameHeader();
+
+                    if(hr<0)
                     {
-                    #ifdef _DEBUG
-                        data_out_str.SetCount(msg_length*3);
+                        LOG_PROBLEM(OS_TEXT("WebSocketAccept,frame header error,socket:")+OSString::numberOf(ThisSocket));
+                        OnError();
+                        CloseSocket();
+                        return(-1);
+                    }
 
-                        DataToLowerHexStr(data_out_str.data(),(uint8 *)pack,msg_length,u8char(','));
+                    if(hr==0)                                           //头都没收完
+                    {
+                        recv_buffer.SetCount(WEBSOCKET_MAX_HEADER_SIZE);
 
-                        LOG_INFO(U8_TEXT("WebSocket[")+U8String::numberOf(ThisSocket)+U8_TEXT("] Recv binary [")+U8String::numberOf(msg_length)+U8_TEXT("]: ")+U8String(data_out_str.data()));
-                    #endif//_DEBUG
+                        int result=sis->Read(recv_buffer.data()+recv_length,msg_header_size-recv_length);
 
-                        OnBinary(pack,msg_length,msg_fin);
+                        if(result<0)
+                            RETURN_ERROR(result);
+
+                        if(result==0)
+                            return(total);
+
+                        recv_length+=result;
+                        recv_total+=result;
+                        total+=result;
+                        continue;
                     }
 
-                    if(!msg_fin)
-                        last_opcode=2;
-                    else
-                        last_opcode=0;
+                    if(msg_opcode==8)   //close
+                    {
+                        this->CloseSocket();
+                        return(-1);
+                    }
                 }
-                else
-                if(msg_opcode==1){if(msg_length>0)OnText(pack,msg_length,msg_fin);if(!msg_fin)last_opcode=2;else last_opcode=0;}else
-                if(msg_opcode==0)
+
+                const uint64 left=msg_length-msg_recv_length;                               //本帧还未处理的数据长度
+                const uint need=uint(msg_stream?hgl_min<uint64>(left,stream_chunk_size):left);  //本次需要在缓冲区内凑齐的长度
+
+                if(recv_length<need)
                 {
-                    if(msg_length>0)
+                    if(recv_buffer.GetCount()<need)
+                        recv_buffer.SetCount(need);
+
+                    int result=sis->Read(recv_buffer.data()+recv_length,need-recv_length);
+
+                    if(result<0)
+                        RETURN_ERROR(result);
+
+                    recv_length+=result;
+                    recv_total+=result;
+                    total+=result;
+
+                    if(recv_length<need)
                     {
-                        if(last_opcode==1)
-                            OnText(pack,msg_length,msg_fin);
-                        else
-                        if(last_opcode==2)
-                            OnBinary(pack,msg_length,msg_fin);
+                        if(!msg_stream||result==0)
+                            return(total);                                          //证明socket缓冲区里没有数据了，直接返回
                     }
                 }
-                else
+
+                const uint size=hgl_min<uint>(recv_length,need);                     //流式处理时有多少就先交出去多少
+                char *pack=(char *)recv_buffer.data();
+
+                if(msg_masked)
+                    WebSocketMask(pack,size,msg_mask,msg_recv_length);
+
+                msg_recv_length+=size;
+
+                const bool last=(msg_recv_length>=msg_length);
+
+                if(!ProcFrameData(pack,size,last))
                 {
-                    LOG_PROBLEM(OS_TEXT("WebSocketAccept,opcode error,opcode:")+OSString::numberOf(msg_opcode)+OS_TEXT(",length:")+OSString::numberOf(msg_length));
-                    OnError();
+                    CloseSocket();
+                    return(-1);
                 }
 
-                recv_buffer.Clear();
-                recv_length=0;
+                ConsumeRecvBuffer(size);
+
+                if(!last)
+                    continue;
+
+                if(msg_opcode<8)                                                    //控制帧可以插在分片消息中间，不影响消息状态
+                    last_opcode=msg_fin?0:msg_data_opcode;
+
+                msg_header_done=false;
             }//while
         }
 
-        int WebSocketAccept::SendFrame(uint8 opcode,void *msg,uint32 size,bool fin)
+        int WebSocketAccept::SendFrame(uint8 opcode,const void *msg,uint64 size,bool fin,bool rsv1)
         {
-            uint8 header[14];
-            uint header_size;
-
-            header[0]=opcode&0xF;
-            if(fin)
-                header[0]|=1<<7;
+            uint8 header[HGL_WEBSOCKET_FRAME_HEADER_MAX_SIZE];
 
-            if(size<=125)
-            {
-                header[1]=size;
-                header_size=2;
-            }
-            else
-            if(size<=65535)
-            {
-                header[1]=126;
-                header[2]=(size&0xFF00)>>8;
-                header[3]= size&0xFF;
+            const uint header_size=MakeWebSocketFrameHeader(header,opcode,size,fin,rsv1);
 
-                header_size=4;
-            }
-            else
+            const SocketIOVec vec[2]=                               //帧头与数据合并为一次writev发出
             {
-                header[1]=127;
-                header[2]=0;
-                header[3]=0;
-                header[4]=0;
-                header[5]=0;
-                header[6]=(size&0xFF000000)>>24;
-                header[7]=(size&0xFF0000)>>16;
-                header[8]=(size&0xFF00)>>8;
-                header[9]= size&0xFF;
-
-                header_size=10;
-            }
+                {header,header_size},
+                {msg,int64(size)}
+            };
 
-            if(!sos)
-                sos=new SocketOutputStream(ThisSocket);
-
-            if(sos->WriteFully(header,header_size)!=header_size)
-                return(-1);
-
-            if(size>0)
-            if(sos->WriteFully(msg,size)!=size)
+            if(!Send(vec,size>0?2:1))
                 return(-1);
 
             return header_size+size;
         }
 
+        /**
+         * 发送共享的完整帧(由MakeWebSocketFrame生成)<br>
+         * 握手未完成或正在分片发送消息时不能插入数据帧
+         */
+        bool WebSocketAccept::SendShared(SharedBuffer *sb,const uint offset,const uint size)
+        {
+            if(!handshake_done||send_opcode!=0)
+                return(false);
+
+            return TCPAccept::SendShared(sb,offset,size);
+        }
+
         bool WebSocketAccept::SendPing()
         {
             return SendFrame(0x9,nullptr,0,true)>0;
@@ -331,22 +736,63 @@ namespace hgl
             return SendFrame(0xA,nullptr,0,true)>0;
         }
 
-        bool WebSocketAccept::SendBinary(void *data,uint32 size,bool fin)
+        bool WebSocketAccept::SendBinary(const void *data,uint32 size,bool fin)
         {
         #ifdef _DEBUG
             data_out_str.SetCount(size*3);
 
-            DataToLowerHexStr(data_out_str.data(),(uint8 *)data,size,u8char(','));
+            DataToLowerHexStr(data_out_str.data(),(const uint8 *)data,size,u8char(','));
 
             LOG_INFO(U8_TEXT("WebSocket[")+U8String::numberOf(ThisSocket)+U8_TEXT("] Send binary [")+U8String::numberOf(size)+U8_TEXT("]: ")+U8String(data_out_str.data()));
         #endif//_DEBUG
 
-            return SendFrame(0x2,data,size,fin)>0;
+            return SendMessage(0x2,data,size,fin);
         }
 
-        bool WebSocketAccept::SendText(void *text,uint32 size,bool fin)
+        bool WebSocketAccept::SendText(const void *text,uint32 size,bool fin)
         {
-            return SendFrame(0x1,text,size,fin)>0;
+            return SendMessage(0x1,text,size,fin);
+        }
+
+        /**
+         * 发送一条消息或其中一个分片<br>
+         * 分片发送时后续分片自动使用continuation帧；协商了压缩时，不分片且不小于min_compress_size的消息会压缩发送
+         */
+        bool WebSocketAccept::SendMessage(uint8 opcode,const void *data,uint32 size,bool fin)
+        {
+            const bool first=(send_opcode==0);
+
+            send_opcode=fin?0:opcode;
+
+            if(!first)
+                return SendFrame(0x0,data,size,fin)>0;
+
+            if(!deflate_param.enable
+             ||!fin
+             ||size<deflate_param.min_compress_size)
+                return SendFrame(opcode,data,size,fin)>0;
+
+            if(!deflater)
+                deflater=AcquireWebSocketDeflater(deflate_param.compress_level,deflate_param.server_max_window_bits);
+
+            const bool result=deflater->Compress(deflate_buffer,data,size);
+
+            if(deflate_param.server_no_context_takeover)                //不保留上下文，用完就还给线程池
+            {
+                ReleaseWebSocketDeflater(deflater);
+                deflater=nullptr;
+
+                if(!result||deflate_buffer.GetCount()>=size)            //压缩无效时发原文，不影响后续消息
+                    return SendFrame(opcode,data,size,fin)>0;
+            }
+            else
+            if(!result)                                                 //保留上下文时压缩器状态已不可信
+            {
+                LOG_PROBLEM(OS_TEXT("WebSocketAccept,deflate error,socket:")+OSString::numberOf(ThisSocket));
+                return(false);
+            }
+
+            return SendFrame(opcode,deflate_buffer.data(),deflate_buffer.GetCount(),fin,true)>0;
         }
     }//namespace network
 }//namespace hgl
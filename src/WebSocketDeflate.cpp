@@ -0,0 +1,501 @@
+﻿#include<hgl/network/WebSocketDeflate.h>
+#include<hgl/type/List.h>
+
+#ifdef HGL_NETWORK_WEBSOCKET_DEFLATE
+#include<zlib.h>
+#endif//HGL_NETWORK_WEBSOCKET_DEFLATE
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            constexpr uint  DEFLATE_MIN_WINDOW_BITS =9;                         //zlib的raw deflate不支持8
+            constexpr uint  DEFLATE_MAX_WINDOW_BITS =15;
+            constexpr int   DEFLATE_POOL_MAX_FREE   =4;                         //每个线程最多缓存的空闲压缩器/解压器数量
+
+            constexpr uint8 DEFLATE_TAIL[4]={0x00,0x00,0xFF,0xFF};
+
+            inline bool IsSpace(const u8char c){return c==' '||c=='\t';}
+
+            inline void Trim(const u8char *&start,const u8char *&end)
+            {
+                while(start<end&&IsSpace(*start))++start;
+                while(end>start&&IsSpace(end[-1]))--end;
+
+                if(end-start>=2&&*start=='"'&&end[-1]=='"')        //参数值可以带引号
+                {
+                    ++start;
+                    --end;
+                }
+            }
+
+            inline bool IsToken(const u8char *start,const u8char *end,const char *str)
+            {
+                const uint len=::strlen(str);
+
+                if(uint(end-start)!=len)
+                    return(false);
+
+                return memcmp(start,str,len)==0;
+            }
+
+            /**
+             * 解析窗口位数参数
+             * @return 0 参数错误
+             */
+            uint ParseWindowBits(const u8char *start,const u8char *end)
+            {
+                if(start>=end||end-start>2)
+                    return 0;
+
+                uint v=0;
+
+                for(const u8char *p=start;p<end;p++)
+                {
+                    if(*p<'0'||*p>'9')return 0;
+
+                    v=v*10+(*p-'0');
+                }
+
+                if(v<8||v>DEFLATE_MAX_WINDOW_BITS)
+                    return 0;
+
+                return v;
+            }
+
+            /**
+             * 处理一个permessage-deflate提议
+             * @return 是否可以接受
+             */
+            bool NegotiateOffer(WebSocketDeflateConfig &result,U8String &response,const u8char *start,const u8char *end,const WebSocketDeflateConfig &config)
+            {
+                bool server_no_context_takeover=false;
+                bool client_no_context_takeover=false;
+                bool has_client_max_window_bits=false;
+                uint server_max_window_bits=0;
+                uint client_max_window_bits=0;
+
+                const u8char *p=start;
+
+                while(p<end&&*p!=';')++p;
+
+                {
+                    const u8char *name=start;
+                    const u8char *name_end=p;
+
+                    Trim(name,name_end);
+
+                    if(!IsToken(name,name_end,"permessage-deflate"))
+                        return(false);
+                }
+
+                while(p<end)
+                {
+                    const u8char *param=++p;
+
+                    while(p<end&&*p!=';')++p;
+
+                    const u8char *param_end=p;
+                    const u8char *value=param_end;
+                    const u8char *value_end=param_end;
+
+                    for(const u8char *eq=param;eq<param_end;eq++)
+                        if(*eq=='=')
+                        {
+                            value=eq+1;
+                            param_end=eq;
+                            break;
+                        }
+
+                    Trim(param,param_end);
+                    Trim(value,value_end);
+
+                    if(param==param_end)
+                        continue;
+
+                    const bool has_value=(value<value_end);
+
+                    if(IsToken(param,param_end,"server_no_context_takeover"))
+                    {
+                        if(has_value||server_no_context_takeover)return(false);        //参数重复或带值都是非法的
+                        server_no_context_takeover=true;
+                    }
+                    else
+                    if(IsToken(param,param_end,"client_no_context_takeover"))
+                    {
+                        if(has_value||client_no_context_takeover)return(false);
+                        client_no_context_takeover=true;
+                    }
+                    else
+                    if(IsToken(param,param_end,"server_max_window_bits"))
+                    {
+                        if(server_max_window_bits)return(false);
+
+                        server_max_window_bits=ParseWindowBits(value,value_end);
+
+                        if(!server_max_window_bits)return(false);
+                    }
+                    else
+                    if(IsToken(param,param_end,"client_max_window_bits"))
+                    {
+                        if(has_client_max_window_bits)return(false);
+
+                        has_client_max_window_bits=true;
+
+                        if(has_value)
+                        {
+                            client_max_window_bits=ParseWindowBits(value,value_end);
+
+                            if(!client_max_window_bits)return(false);
+                        }
+                    }
+                    else
+                        return(false);                                                  //未知参数，不接受这个提议
+                }
+
+                result=config;
+
+                //服务端压缩参数，服务端可以自行决定更严格的设定
+                result.server_no_context_takeover=(server_no_context_takeover||config.server_no_context_takeover);
+
+                result.server_max_window_bits=hgl_min<uint>(config.server_max_window_bits,DEFLATE_MAX_WINDOW_BITS);
+
+                if(server_max_window_bits)
+                    result.server_max_window_bits=hgl_min(result.server_max_window_bits,server_max_window_bits);
+
+                if(result.server_max_window_bits<DEFLATE_MIN_WINDOW_BITS)
+                {
+                    if(server_max_window_bits)                                          //客户端要求8位窗口，zlib无法满足
+                        return(false);
+
+                    result.server_max_window_bits=DEFLATE_MIN_WINDOW_BITS;
+                }
+
+                //客户端压缩参数，只有客户端提出了才能回复
+                result.client_no_context_takeover=(client_no_context_takeover&&config.client_no_context_takeover);
+
+                if(has_client_max_window_bits)
+                {
+                    result.client_max_window_bits=hgl_min<uint>(config.client_max_window_bits,client_max_window_bits?client_max_window_bits:DEFLATE_MAX_WINDOW_BITS);      //解压器会按不小于9位创建，回复8位也没有问题
+                }
+                else
+                {
+                    result.client_max_window_bits=DEFLATE_MAX_WINDOW_BITS;
+                }
+
+                result.enable=true;
+
+                response="permessage-deflate";
+
+                if(result.server_no_context_takeover)
+                    response+="; server_no_context_takeover";
+
+                if(result.client_no_context_takeover)
+                    response+="; client_no_context_takeover";
+
+                if(server_max_window_bits||result.server_max_window_bits<DEFLATE_MAX_WINDOW_BITS)
+                    response+="; server_max_window_bits="+U8String::numberOf(result.server_max_window_bits);
+
+                if(has_client_max_window_bits)
+                    response+="; client_max_window_bits="+U8String::numberOf(result.client_max_window_bits);
+
+                return(true);
+            }
+
+            /**
+             * 线程内的压缩器池
+             */
+            template<typename T> struct DeflatePool
+            {
+                List<T *> free_list;
+
+            public:
+
+                ~DeflatePool()
+                {
+                    const int count=free_list.GetCount();
+
+                    for(int i=0;i<count;i++)
+                        delete free_list[i];
+                }
+            };//struct DeflatePool
+
+            thread_local DeflatePool<WebSocketDeflater> deflater_pool;
+            thread_local DeflatePool<WebSocketInflater> inflater_pool;
+        }//namespace
+
+        /**
+         * 解析Sec-WebSocket-Extensions并协商permessage-deflate参数<br>
+         * 客户端可以按优先级给出多个提议(逗号分隔)，使用第一个可以接受的
+         */
+        bool NegotiateWebSocketDeflate(WebSocketDeflateConfig &result,U8String &response,const U8String &extensions,const WebSocketDeflateConfig &config)
+        {
+            result=config;
+            result.enable=false;
+            response.Clear();
+
+        #ifndef HGL_NETWORK_WEBSOCKET_DEFLATE
+            return(false);                                                              //编译时未使用zlib
+        #else
+            if(!config.enable||extensions.IsEmpty())
+                return(false);
+
+            const u8char *p=extensions.c_str();
+            const u8char *end=p+extensions.Length();
+
+            while(p<end)
+            {
+                const u8char *start=p;
+
+                while(p<end&&*p!=',')++p;
+
+                if(NegotiateOffer(result,response,start,p,config))
+                    return(true);
+
+                ++p;
+            }
+
+            result=config;
+            result.enable=false;
+            return(false);
+        #endif//HGL_NETWORK_WEBSOCKET_DEFLATE
+        }
+
+#ifdef HGL_NETWORK_WEBSOCKET_DEFLATE
+        WebSocketDeflater::WebSocketDeflater(int l,int wb)
+        {
+            level=l;
+            window_bits=wb;
+
+            zs=new z_stream;
+            hgl_zero(*zs);
+
+            if(deflateInit2(zs,level,Z_DEFLATED,-window_bits,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+            {
+                delete zs;
+                zs=nullptr;
+            }
+        }
+
+        WebSocketDeflater::~WebSocketDeflater()
+        {
+            if(!zs)return;
+
+            deflateEnd(zs);
+            delete zs;
+        }
+
+        /**
+         * 压缩一条完整消息
+         * @param out 压缩结果(覆盖原内容)
+         */
+        bool WebSocketDeflater::Compress(DataArray<uint8> &out,const void *data,const uint size)
+        {
+            if(!zs)return(false);
+
+            uint out_size=deflateBound(zs,size)+16;                                     //SYNC_FLUSH会额外产生几个字节
+
+            out.SetCount(out_size);
+
+            zs->next_in     =(Bytef *)data;
+            zs->avail_in    =size;
+            zs->next_out    =out.data();
+            zs->avail_out   =out_size;
+
+            while(true)
+            {
+                const int result=deflate(zs,Z_SYNC_FLUSH);
+
+                if(result!=Z_OK&&result!=Z_BUF_ERROR)
+                    return(false);
+
+                if(zs->avail_in==0&&zs->avail_out>0)
+                    break;
+
+                const uint used=out_size-zs->avail_out;                                 //输出空间不足，扩大后继续
+
+                out_size*=2;
+                out.SetCount(out_size);
+
+                zs->next_out    =out.data()+used;
+                zs->avail_out   =out_size-used;
+            }
+
+            uint total=out_size-zs->avail_out;
+
+            if(total>=4&&memcmp(out.data()+total-4,DEFLATE_TAIL,4)==0)                 //RFC7692 7.2.1: 去掉结尾的00 00 FF FF
+                total-=4;
+
+            out.SetCount(total);
+            return(true);
+        }
+
+        void WebSocketDeflater::Reset()
+        {
+            if(zs)
+                deflateReset(zs);
+        }
+
+        WebSocketInflater::WebSocketInflater(int wb)
+        {
+            window_bits=hgl_max<int>(wb,DEFLATE_MIN_WINDOW_BITS);
+
+            zs=new z_stream;
+            hgl_zero(*zs);
+
+            if(inflateInit2(zs,-window_bits)!=Z_OK)
+            {
+                delete zs;
+                zs=nullptr;
+            }
+        }
+
+        WebSocketInflater::~WebSocketInflater()
+        {
+            if(!zs)return;
+
+            inflateEnd(zs);
+            delete zs;
+        }
+
+        bool WebSocketInflater::Decompress(DataArray<uint8> &out,const void *data,const uint size,const bool finish,const uint max_size)
+        {
+            if(!zs)return(false);
+
+            for(int pass=0;pass<2;pass++)                                               //第二遍处理消息结尾补上的00 00 FF FF
+            {
+                if(pass==0)
+                {
+                    zs->next_in =(Bytef *)data;
+                    zs->avail_in=size;
+                }
+                else
+                {
+                    if(!finish)break;
+
+                    zs->next_in =(Bytef *)DEFLATE_TAIL;
+                    zs->avail_in=4;
+                }
+
+                bool more=(zs->avail_in>0);
+
+                while(more)
+                {
+                    uint used=out.GetCount();
+                    uint grow=hgl_max<uint>(zs->avail_in*4,HGL_SIZE_1KB*4);
+
+                    if(max_size&&used+grow>max_size)
+                    {
+                        if(used>=max_size)
+                            return(false);                                              //超出单条消息最大长度
+
+                        grow=max_size-used;
+                    }
+
+                    out.SetCount(used+grow);
+
+                    zs->next_out    =out.data()+used;
+                    zs->avail_out   =grow;
+
+                    const int result=inflate(zs,Z_SYNC_FLUSH);
+
+                    out.SetCount(used+grow-zs->avail_out);
+
+                    if(result==Z_STREAM_END)
+                        break;
+
+                    if(result!=Z_OK&&result!=Z_BUF_ERROR)
+                        return(false);
+
+                    if(result==Z_BUF_ERROR&&zs->avail_out>0)                           //没有任何进展
+                        return(false);
+
+                    more=(zs->avail_in>0||zs->avail_out==0);                            //输出空间用完时zlib里可能还有未输出的数据
+                }
+            }
+
+            return(true);
+        }
+
+        void WebSocketInflater::Reset()
+        {
+            if(zs)
+                inflateReset(zs);
+        }
+#else
+        WebSocketDeflater::WebSocketDeflater(int l,int wb){level=l;window_bits=wb;}
+        WebSocketDeflater::~WebSocketDeflater()=default;
+        bool WebSocketDeflater::Compress(DataArray<uint8> &,const void *,const uint){return(false);}
+        void WebSocketDeflater::Reset(){}
+
+        WebSocketInflater::WebSocketInflater(int wb){window_bits=wb;}
+        WebSocketInflater::~WebSocketInflater()=default;
+        bool WebSocketInflater::Decompress(DataArray<uint8> &,const void *,const uint,const bool,const uint){return(false);}
+        void WebSocketInflater::Reset(){}
+#endif//HGL_NETWORK_WEBSOCKET_DEFLATE
+
+        WebSocketDeflater *AcquireWebSocketDeflater(int level,int window_bits)
+        {
+            List<WebSocketDeflater *> &fl=deflater_pool.free_list;
+
+            for(int i=fl.GetCount()-1;i>=0;i--)
+            {
+                WebSocketDeflater *d=fl[i];
+
+                if(!d->IsMatch(level,window_bits))
+                    continue;
+
+                fl.Delete(i);
+                return d;
+            }
+
+            return(new WebSocketDeflater(level,window_bits));
+        }
+
+        void ReleaseWebSocketDeflater(WebSocketDeflater *d)
+        {
+            if(!d)return;
+
+            d->Reset();
+
+            if(deflater_pool.free_list.GetCount()>=DEFLATE_POOL_MAX_FREE)
+                delete d;
+            else
+                deflater_pool.free_list.Add(d);
+        }
+
+        WebSocketInflater *AcquireWebSocketInflater(int window_bits)
+        {
+            window_bits=hgl_max<int>(window_bits,DEFLATE_MIN_WINDOW_BITS);
+
+            List<WebSocketInflater *> &fl=inflater_pool.free_list;
+
+            for(int i=fl.GetCount()-1;i>=0;i--)
+            {
+                WebSocketInflater *inf=fl[i];
+
+                if(!inf->IsMatch(window_bits))
+                    continue;
+
+                fl.Delete(i);
+                return inf;
+            }
+
+            return(new WebSocketInflater(window_bits));
+        }
+
+        void ReleaseWebSocketInflater(WebSocketInflater *inf)
+        {
+            if(!inf)return;
+
+            inf->Reset();
+
+            if(inflater_pool.free_list.GetCount()>=DEFLATE_POOL_MAX_FREE)
+                delete inf;
+            else
+                inflater_pool.free_list.Add(inf);
+        }
+    }//namespace network
+}//namespace hgl
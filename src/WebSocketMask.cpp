@@ -0,0 +1,106 @@
+﻿#include<hgl/network/WebSocket.h>
+
+#if defined(__AVX2__)
+    #include<immintrin.h>
+#elif defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+    #define HGL_WEBSOCKET_MASK_SSE2
+    #include<emmintrin.h>
+#elif defined(__ARM_NEON)||defined(__ARM_NEON__)
+    #include<arm_neon.h>
+#endif
+
+namespace hgl
+{
+    namespace network
+    {
+        /**
+         * WebSocket掩码处理(掩码与解码是同一个操作)<br>
+         * 将4字节掩码扩展为32/16/8字节宽度后按块异或，不足的尾部逐字节处理
+         * @param data 数据(原地修改)
+         * @param size 数据长度
+         * @param mask 帧头中的4字节掩码(按内存中的原始字节顺序读取)
+         * @param offset data在整个帧负载中的偏移，用于分段处理同一帧
+         */
+        void WebSocketMask(void *data,uint64 size,const uint32 mask,const uint64 offset)
+        {
+            if(!data||size<=0)return;
+
+            uint8 *p=(uint8 *)data;
+
+            uint8 mb[4];
+            uint8 rb[4];
+
+            memcpy(mb,&mask,4);
+
+            for(uint i=0;i<4;i++)                                   //按偏移旋转掩码，使rb[0]对应p[0]
+                rb[i]=mb[(offset+i)&3];
+
+            uint32 m32;
+
+            memcpy(&m32,rb,4);
+
+#if defined(__AVX2__)
+            {
+                const __m256i m256=_mm256_set1_epi32(int(m32));
+
+                while(size>=32)
+                {
+                    __m256i v=_mm256_loadu_si256((const __m256i *)p);
+
+                    _mm256_storeu_si256((__m256i *)p,_mm256_xor_si256(v,m256));
+
+                    p+=32;
+                    size-=32;
+                }
+            }
+#endif//__AVX2__
+
+#if defined(__AVX2__)||defined(HGL_WEBSOCKET_MASK_SSE2)
+            {
+                const __m128i m128=_mm_set1_epi32(int(m32));
+
+                while(size>=16)
+                {
+                    __m128i v=_mm_loadu_si128((const __m128i *)p);
+
+                    _mm_storeu_si128((__m128i *)p,_mm_xor_si128(v,m128));
+
+                    p+=16;
+                    size-=16;
+                }
+            }
+#elif defined(__ARM_NEON)||defined(__ARM_NEON__)
+            {
+                const uint8x16_t m128=vreinterpretq_u8_u32(vdupq_n_u32(m32));
+
+                while(size>=16)
+                {
+                    vst1q_u8(p,veorq_u8(vld1q_u8(p),m128));
+
+                    p+=16;
+                    size-=16;
+                }
+            }
+#endif
+
+            {
+                const uint64 m64=(uint64(m32)<<32)|m32;             //两份相同的掩码，字节顺序与大小端无关
+
+                uint64 v;
+
+                while(size>=8)
+                {
+                    memcpy(&v,p,8);
+                    v^=m64;
+                    memcpy(p,&v,8);
+
+                    p+=8;
+                    size-=8;
+                }
+            }
+
+            for(uint i=0;i<size;i++)                                //以上每次处理的都是4的倍数，尾部依然从rb[0]开始
+                p[i]^=rb[i&3];
+        }
+    }//namespace network
+}//namespace hgl
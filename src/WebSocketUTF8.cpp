@@ -0,0 +1,138 @@
+﻿#include<hgl/network/WebSocket.h>
+
+#if defined(__AVX2__)
+    #include<immintrin.h>
+#elif defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+    #define HGL_WEBSOCKET_UTF8_SSE2
+    #include<emmintrin.h>
+#elif defined(__aarch64__)||defined(_M_ARM64)
+    #define HGL_WEBSOCKET_UTF8_NEON
+    #include<arm_neon.h>
+#endif
+
+namespace hgl
+{
+    namespace network
+    {
+        namespace
+        {
+            /**
+             * 计算开头连续的ASCII字节数<br>
+             * 按块检查最高位，遇到含非ASCII字节的块即交给逐字节处理，所以最多多看一块
+             */
+            uint64 SkipASCII(const uint8 *p,const uint64 size)
+            {
+                uint64 n=0;
+
+#if defined(__AVX2__)
+                while(size-n>=32)
+                {
+                    if(_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(p+n))))
+                        break;
+
+                    n+=32;
+                }
+#endif//__AVX2__
+
+#if defined(__AVX2__)||defined(HGL_WEBSOCKET_UTF8_SSE2)
+                while(size-n>=16)
+                {
+                    if(_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(p+n))))
+                        break;
+
+                    n+=16;
+                }
+#elif defined(HGL_WEBSOCKET_UTF8_NEON)
+                while(size-n>=16)
+                {
+                    if(vmaxvq_u8(vld1q_u8(p+n))>=0x80)
+                        break;
+
+                    n+=16;
+                }
+#endif
+
+                {
+                    uint64 v;
+
+                    while(size-n>=8)
+                    {
+                        memcpy(&v,p+n,8);
+
+                        if(v&0x8080808080808080ULL)
+                            break;
+
+                        n+=8;
+                    }
+                }
+
+                while(n<size&&p[n]<0x80)
+                    ++n;
+
+                return n;
+            }
+        }//namespace
+
+        /**
+         * 校验一段数据，可以分多次传入同一条消息的各段
+         */
+        bool UTF8Validator::Update(const void *data,uint64 size)
+        {
+            if(!data||size<=0)return(true);
+
+            const uint8 *p=(const uint8 *)data;
+            const uint8 *end=p+size;
+
+            while(p<end)
+            {
+                if(pending)
+                {
+                    if(*p<lower||*p>upper)
+                        return(false);
+
+                    ++p;
+                    --pending;
+                    lower=0x80;
+                    upper=0xBF;
+                    continue;
+                }
+
+                if(*p<0x80)
+                {
+                    p+=SkipASCII(p,end-p);
+                    continue;
+                }
+
+                const uint8 c=*p++;
+
+                if(c<0xC2)                                  //孤立的后续字节或过长的2字节编码
+                    return(false);
+
+                if(c<0xE0)
+                {
+                    pending=1;
+                }
+                else
+                if(c<0xF0)
+                {
+                    pending=2;
+
+                    if(c==0xE0)lower=0xA0;else              //过长的3字节编码
+                    if(c==0xED)upper=0x9F;                  //代理区U+D800~U+DFFF
+                }
+                else
+                if(c<0xF5)
+                {
+                    pending=3;
+
+                    if(c==0xF0)lower=0x90;else              //过长的4字节编码
+                    if(c==0xF4)upper=0x8F;                  //超出U+10FFFF
+                }
+                else
+                    return(false);
+            }
+
+            return(true);
+        }
+    }//namespace network
+}//namespace hgl